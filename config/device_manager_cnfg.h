@@ -41,15 +41,26 @@
  */
 #define DEVICE_MANAGER_MAX_APPLICATIONS  1
 
+/**
+ * @brief Peripheral links the SoftDevice takes at once.
+ *
+ * @details S132 as shipped takes one; sd_ble_enable() of this version has no setting for more.
+ *          The host build (host/Makefile) sets 2, for its simulated SoftDevice configured with
+ *          two links.
+ */
+#ifndef PERIPHERAL_LINK_COUNT
+#define PERIPHERAL_LINK_COUNT            1
+#endif
+
 /**
  * @brief Maximum connections that Device Manager should simultaneously manage.
  *
  * @details Maximum connections that Device Manager should simultaneously manage.
  *          Minimum value : 1
  *          Maximum value : Maximum links supported by SoftDevice.
- *          Dependencies  : None.
+ *          Dependencies  : PERIPHERAL_LINK_COUNT.
  */
-#define DEVICE_MANAGER_MAX_CONNECTIONS   1
+#define DEVICE_MANAGER_MAX_CONNECTIONS   PERIPHERAL_LINK_COUNT
 
 
 /**
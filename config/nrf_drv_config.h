@@ -125,7 +125,7 @@
 #define SPI0_ENABLED 1
 
 #if (SPI0_ENABLED == 1)
-#define SPI0_USE_EASY_DMA 0
+#define SPI0_USE_EASY_DMA 1
 
 #define SPI0_CONFIG_SCK_PIN         2
 #define SPI0_CONFIG_MOSI_PIN        3
@@ -176,10 +176,10 @@
 #define UART0_CONFIG_PSEL_RTS 5
 #define UART0_CONFIG_IRQ_PRIORITY APP_IRQ_PRIORITY_LOW
 #ifdef NRF52
-#define UART0_CONFIG_USE_EASY_DMA false
+#define UART0_CONFIG_USE_EASY_DMA true
 //Compile time flag
 #define UART_EASY_DMA_SUPPORT     1
-#define UART_LEGACY_SUPPORT       1
+#define UART_LEGACY_SUPPORT       0
 #endif //NRF52
 #endif
 
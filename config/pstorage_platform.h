@@ -46,7 +46,8 @@ static __INLINE uint32_t pstorage_flash_page_end()
 
 #define PSTORAGE_FLASH_PAGE_END     pstorage_flash_page_end()
 
-#define PSTORAGE_NUM_OF_PAGES       2                                                           /**< Number of flash pages allocated for the pstorage module excluding the swap page, configurable based on system requirements. */
+#define PSTORAGE_NUM_OF_PAGES       26                                                          /**< Number of flash pages allocated for the pstorage module excluding the swap page: Device Manager (2), notification inbox (2), settings (2), history (4) and asset store (16), from the top down in registration order. */
+#define PSTORAGE_FIRST_MODULE_PAGES 2                                                           /**< Pages of the first module registered, the Device Manager, right below the swap page. Keeps its bonds where firmware with only the Device Manager had them, 0x7D000. */
 #define PSTORAGE_MIN_BLOCK_SIZE     0x0010                                                      /**< Minimum size of block that can be registered with the module. Should be configured based on system requirements, recommendation is not have this value to be at least size of word. */
 
 #define PSTORAGE_DATA_START_ADDR    ((PSTORAGE_FLASH_PAGE_END - PSTORAGE_NUM_OF_PAGES - 1) \
@@ -56,6 +57,7 @@ static __INLINE uint32_t pstorage_flash_page_end()
 
 #define PSTORAGE_MAX_BLOCK_SIZE     PSTORAGE_FLASH_PAGE_SIZE                                    /**< Maximum size of block that can be registered with the module. Should be configured based on system requirements. And should be greater than or equal to the minimum size. */
 #define PSTORAGE_CMD_QUEUE_SIZE     10                                                          /**< Maximum number of flash access commands that can be maintained by the module for all applications. Configurable. */
+#define PSTORAGE_COALESCE_SIZE      256                                                         /**< Size of the RAM buffer used to merge adjoining queued stores into one flash write; 0 disables merging. */
 
 
 /** Abstracts persistently memory block identifier. */
@@ -0,0 +1,16 @@
+/* Host version of the delay functions, for the simulation build: busy waits in simulated time. */
+
+#include "nrf_delay.h"
+#include "sim.h"
+
+
+void nrf_delay_us(uint32_t volatile number_of_us)
+{
+    sim_busy_wait(SIM_US(number_of_us));
+}
+
+
+void nrf_delay_ms(uint32_t volatile number_of_ms)
+{
+    sim_busy_wait(SIM_MS(number_of_ms));
+}
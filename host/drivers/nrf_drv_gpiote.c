@@ -0,0 +1,189 @@
+/* Host version of the GPIOTE driver, for the simulation build: input pins on the PORT event, which
+ * the GPIO model of host/sim/sim_periph.c raises when a sensed pin changes.
+ *
+ * As the low power mode of the SDK driver, each pin with its event enabled is sensed, and the
+ * handler is called for the pins whose level changed in the configured direction. The task and
+ * output functions are not used by the firmware and are left out.
+ */
+
+#include <string.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nrf_gpio.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_drv_config.h"
+#include "app_util_platform.h"
+#include "sim_periph.h"
+
+#define PINS_MAX   GPIOTE_CONFIG_NUM_OF_LOW_POWER_EVENTS
+
+typedef struct
+{
+    nrf_drv_gpiote_pin_t         pin;
+    nrf_gpiote_polarity_t        sense;
+    nrf_drv_gpiote_evt_handler_t handler;
+    bool                         enabled;
+    bool                         level;    /**< Level when last sensed. */
+} pin_cb_t;
+
+static bool     m_initialized;
+static pin_cb_t m_pins[PINS_MAX];
+static uint8_t  m_pin_count;
+
+
+static pin_cb_t * pin_find(nrf_drv_gpiote_pin_t pin)
+{
+    uint8_t i;
+
+    for (i = 0; i < m_pin_count; i++)
+    {
+        if (m_pins[i].pin == pin)
+        {
+            return &m_pins[i];
+        }
+    }
+    return NULL;
+}
+
+
+static void sense_update(void)
+{
+    uint32_t mask = 0;
+    uint8_t  i;
+
+    for (i = 0; i < m_pin_count; i++)
+    {
+        if (m_pins[i].enabled)
+        {
+            mask |= 1UL << m_pins[i].pin;
+        }
+    }
+    sim_gpio_sense_set(mask);
+}
+
+
+void GPIOTE_IRQHandler(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < m_pin_count; i++)
+    {
+        pin_cb_t * p_pin = &m_pins[i];
+        bool       level = nrf_gpio_pin_read(p_pin->pin) != 0;
+
+        if (!p_pin->enabled || (level == p_pin->level))
+        {
+            continue;
+        }
+        p_pin->level = level;
+
+        if ((p_pin->sense == NRF_GPIOTE_POLARITY_TOGGLE) ||
+            ((p_pin->sense == NRF_GPIOTE_POLARITY_LOTOHI) && level) ||
+            ((p_pin->sense == NRF_GPIOTE_POLARITY_HITOLO) && !level))
+        {
+            p_pin->handler(p_pin->pin, p_pin->sense);
+        }
+    }
+}
+
+
+ret_code_t nrf_drv_gpiote_init(void)
+{
+    if (m_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    memset(m_pins, 0, sizeof(m_pins));
+    m_pin_count   = 0;
+    m_initialized = true;
+
+    NVIC_SetPriority(GPIOTE_IRQn, GPIOTE_CONFIG_IRQ_PRIORITY);
+    NVIC_EnableIRQ(GPIOTE_IRQn);
+    return NRF_SUCCESS;
+}
+
+
+bool nrf_drv_gpiote_is_init(void)
+{
+    return m_initialized;
+}
+
+
+void nrf_drv_gpiote_uninit(void)
+{
+    NVIC_DisableIRQ(GPIOTE_IRQn);
+    sim_gpio_sense_set(0);
+    m_pin_count   = 0;
+    m_initialized = false;
+}
+
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t         pin,
+                                  nrf_drv_gpiote_in_config_t * p_config,
+                                  nrf_drv_gpiote_evt_handler_t evt_handler)
+{
+    pin_cb_t * p_pin;
+
+    if (pin_find(pin) != NULL)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_config->hi_accuracy || (m_pin_count == PINS_MAX))
+    {
+        // IN events are not modelled; the firmware only uses the PORT event.
+        return NRF_ERROR_NO_MEM;
+    }
+
+    nrf_gpio_cfg_input(pin, p_config->pull);
+
+    p_pin          = &m_pins[m_pin_count++];
+    p_pin->pin     = pin;
+    p_pin->sense   = p_config->sense;
+    p_pin->handler = evt_handler;
+    p_pin->enabled = false;
+    return NRF_SUCCESS;
+}
+
+
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin)
+{
+    pin_cb_t * p_pin = pin_find(pin);
+
+    if (p_pin != NULL)
+    {
+        *p_pin = m_pins[--m_pin_count];
+        sense_update();
+    }
+}
+
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable)
+{
+    pin_cb_t * p_pin = pin_find(pin);
+
+    if (p_pin != NULL)
+    {
+        p_pin->level   = nrf_gpio_pin_read(pin) != 0;
+        p_pin->enabled = int_enable;
+        sense_update();
+    }
+}
+
+
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin)
+{
+    pin_cb_t * p_pin = pin_find(pin);
+
+    if (p_pin != NULL)
+    {
+        p_pin->enabled = false;
+        sense_update();
+    }
+}
+
+
+bool nrf_drv_gpiote_in_is_set(nrf_drv_gpiote_pin_t pin)
+{
+    return nrf_gpio_pin_read(pin) != 0;
+}
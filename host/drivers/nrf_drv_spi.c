@@ -0,0 +1,95 @@
+/* Host version of the SPI master driver, for the simulation build: SPIM0 with the SSD1351 model of
+ * host/sim/sim_display.c on its bus.
+ *
+ * Only the blocking mode is supported, which is the one the firmware uses. A transfer takes the time
+ * of its bytes at the configured frequency, during which the interrupts of the firmware keep
+ * running; the display model samples the chip select and D/C pins as each byte goes out.
+ */
+
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nordic_common.h"
+#include "nrf_drv_spi.h"
+#include "sim.h"
+#include "sim_periph.h"
+#include "sim_display.h"
+
+static bool     m_initialized;
+static uint64_t m_byte_time;
+
+
+/**@brief Function for getting the time of a byte at a FREQUENCY register value. */
+static uint64_t byte_time_get(nrf_drv_spi_frequency_t frequency)
+{
+    uint32_t khz;
+
+    switch (frequency)
+    {
+        case NRF_DRV_SPI_FREQ_125K: khz = 125;  break;
+        case NRF_DRV_SPI_FREQ_250K: khz = 250;  break;
+        case NRF_DRV_SPI_FREQ_500K: khz = 500;  break;
+        case NRF_DRV_SPI_FREQ_1M:   khz = 1000; break;
+        case NRF_DRV_SPI_FREQ_2M:   khz = 2000; break;
+        case NRF_DRV_SPI_FREQ_4M:   khz = 4000; break;
+        default:                    khz = 8000; break;
+    }
+    return SIM_MS(8) / khz;
+}
+
+
+ret_code_t nrf_drv_spi_init(nrf_drv_spi_t const * const p_instance,
+                            nrf_drv_spi_config_t const * p_config,
+                            nrf_drv_spi_handler_t handler)
+{
+    if (m_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (handler != NULL)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+
+    m_byte_time   = byte_time_get(p_config->frequency);
+    m_initialized = true;
+    return NRF_SUCCESS;
+}
+
+
+void nrf_drv_spi_uninit(nrf_drv_spi_t const * const p_instance)
+{
+    m_initialized = false;
+}
+
+
+ret_code_t nrf_drv_spi_transfer(nrf_drv_spi_t const * const p_instance,
+                                uint8_t const * p_tx_buffer,
+                                uint8_t         tx_buffer_length,
+                                uint8_t       * p_rx_buffer,
+                                uint8_t         rx_buffer_length)
+{
+    uint8_t length = MAX(tx_buffer_length, rx_buffer_length);
+    uint8_t i;
+
+    if (!m_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    // Pin writes done before the transfer take effect first.
+    sim_periph_sync();
+
+    for (i = 0; i < length; i++)
+    {
+        sim_busy_wait(m_byte_time);
+        if (i < tx_buffer_length)
+        {
+            sim_display_spi_byte(p_tx_buffer[i]);
+        }
+        if (i < rx_buffer_length)
+        {
+            p_rx_buffer[i] = 0xFF;   // The display has no MISO output.
+        }
+    }
+    return NRF_SUCCESS;
+}
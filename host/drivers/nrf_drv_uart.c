@@ -0,0 +1,231 @@
+/* Host version of the UART driver, for the simulation build: the UARTE peripheral in EasyDMA mode,
+ * on a line to the terminal of host/sim/sim_uart.c.
+ *
+ * A transfer takes the time of its bytes at the baud rate, then the driver raises its done event
+ * from the UART interrupt. Bytes received while no reception is armed wait in the 4-byte FIFO of
+ * the peripheral; the next ones are an overrun error.
+ */
+
+#include <string.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nrf_drv_uart.h"
+#include "app_util_platform.h"
+#include "sim.h"
+#include "sim_uart.h"
+
+#define RX_FIFO_SIZE   4
+
+static struct
+{
+    bool                     initialized;
+    bool                     rx_enabled;
+    nrf_uart_event_handler_t handler;
+    void                   * p_context;
+    uint64_t                 byte_time;
+    uint8_t const          * p_tx;
+    uint8_t                  tx_len;
+    bool                     tx_done;
+    uint8_t                * p_rx;
+    uint8_t                  rx_len;
+    uint8_t                  rx_count;
+    bool                     rx_done;
+    uint8_t                  rx_fifo[RX_FIFO_SIZE];
+    uint8_t                  rx_fifo_count;
+    uint32_t                 errors;
+} m_cb;
+
+
+/**@brief Function for getting the time of a byte on the line, 8N1, from a BAUDRATE register value. */
+static uint64_t byte_time_get(nrf_uart_baudrate_t baudrate)
+{
+    // BAUDRATE is the baud rate in units of 16 MHz / 2^32.
+    uint64_t baud = ((uint64_t)baudrate * 16000000ULL) >> 32;
+
+    return SIM_S(10) / ((baud != 0) ? baud : 1);
+}
+
+
+static void tx_end(void * p_context)
+{
+    sim_uart_tx(m_cb.p_tx, m_cb.tx_len);
+    m_cb.tx_done = true;
+    sim_irq_pend(UARTE0_UART0_IRQn);
+}
+
+
+/**@brief Function for taking a byte from the line, or into the FIFO while no reception is armed. */
+static void rx_byte(uint8_t byte)
+{
+    if (!m_cb.initialized || !m_cb.rx_enabled)
+    {
+        return;
+    }
+
+    if ((m_cb.p_rx != NULL) && !m_cb.rx_done)
+    {
+        m_cb.p_rx[m_cb.rx_count++] = byte;
+        if (m_cb.rx_count == m_cb.rx_len)
+        {
+            m_cb.rx_done = true;
+            sim_irq_pend(UARTE0_UART0_IRQn);
+        }
+    }
+    else if (m_cb.rx_fifo_count < RX_FIFO_SIZE)
+    {
+        m_cb.rx_fifo[m_cb.rx_fifo_count++] = byte;
+    }
+    else
+    {
+        m_cb.errors |= NRF_UART_ERROR_OVERRUN_MASK;
+        sim_irq_pend(UARTE0_UART0_IRQn);
+    }
+}
+
+
+void UARTE0_UART0_IRQHandler(void)
+{
+    nrf_drv_uart_event_t event;
+
+    if (m_cb.errors != 0)
+    {
+        event.type                  = NRF_DRV_UART_EVT_ERROR;
+        event.data.error.error_mask = m_cb.errors;
+        event.data.error.rxtx.bytes = 0;
+        event.data.error.rxtx.p_data = m_cb.p_rx;
+        m_cb.errors = 0;
+        m_cb.handler(&event, m_cb.p_context);
+    }
+
+    if (m_cb.rx_done)
+    {
+        event.type             = NRF_DRV_UART_EVT_RX_DONE;
+        event.data.rxtx.p_data = m_cb.p_rx;
+        event.data.rxtx.bytes  = m_cb.rx_count;
+        m_cb.p_rx    = NULL;
+        m_cb.rx_done = false;
+        m_cb.handler(&event, m_cb.p_context);
+    }
+
+    if (m_cb.tx_done)
+    {
+        event.type             = NRF_DRV_UART_EVT_TX_DONE;
+        event.data.rxtx.p_data = (uint8_t *)m_cb.p_tx;
+        event.data.rxtx.bytes  = m_cb.tx_len;
+        m_cb.p_tx    = NULL;
+        m_cb.tx_done = false;
+        m_cb.handler(&event, m_cb.p_context);
+    }
+}
+
+
+ret_code_t nrf_drv_uart_init(nrf_drv_uart_config_t const * p_config,
+                             nrf_uart_event_handler_t      event_handler)
+{
+    if (m_cb.initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (event_handler == NULL)
+    {
+        // The blocking mode is not used by the firmware.
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+
+    memset(&m_cb, 0, sizeof(m_cb));
+    m_cb.handler     = event_handler;
+    m_cb.p_context   = p_config->p_context;
+    m_cb.byte_time   = byte_time_get(p_config->baudrate);
+    m_cb.initialized = true;
+
+    sim_uart_rx_handler_set(rx_byte, m_cb.byte_time);
+    NVIC_SetPriority(UARTE0_UART0_IRQn, p_config->interrupt_priority);
+    NVIC_EnableIRQ(UARTE0_UART0_IRQn);
+    return NRF_SUCCESS;
+}
+
+
+void nrf_drv_uart_uninit(void)
+{
+    NVIC_DisableIRQ(UARTE0_UART0_IRQn);
+    memset(&m_cb, 0, sizeof(m_cb));
+}
+
+
+ret_code_t nrf_drv_uart_tx(uint8_t const * const p_data, uint8_t length)
+{
+    if (m_cb.p_tx != NULL)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if (length == 0)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    // EasyDMA reads the buffer as the bytes go out; it must stay valid until the done event.
+    m_cb.p_tx   = p_data;
+    m_cb.tx_len = length;
+    (void)sim_at(sim_time() + length * m_cb.byte_time, SIM_OWNER_DEVICE, tx_end, NULL);
+    return NRF_SUCCESS;
+}
+
+
+void nrf_drv_uart_tx_abort(void)
+{
+}
+
+
+ret_code_t nrf_drv_uart_rx(uint8_t * p_data, uint8_t length)
+{
+    if ((m_cb.p_rx != NULL) || m_cb.rx_done)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if (length == 0)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    m_cb.p_rx     = p_data;
+    m_cb.rx_len   = length;
+    m_cb.rx_count = 0;
+
+    // Bytes waiting in the FIFO go first.
+    while ((m_cb.rx_fifo_count > 0) && (m_cb.rx_count < length))
+    {
+        p_data[m_cb.rx_count++] = m_cb.rx_fifo[0];
+        memmove(&m_cb.rx_fifo[0], &m_cb.rx_fifo[1], --m_cb.rx_fifo_count);
+    }
+    if (m_cb.rx_count == length)
+    {
+        m_cb.rx_done = true;
+        sim_irq_pend(UARTE0_UART0_IRQn);
+    }
+    return NRF_SUCCESS;
+}
+
+
+void nrf_drv_uart_rx_enable(void)
+{
+    m_cb.rx_enabled = true;
+}
+
+
+void nrf_drv_uart_rx_disable(void)
+{
+    m_cb.rx_enabled = false;
+}
+
+
+void nrf_drv_uart_rx_abort(void)
+{
+    m_cb.p_rx    = NULL;
+    m_cb.rx_done = false;
+}
+
+
+uint32_t nrf_drv_uart_errorsrc_get(void)
+{
+    return 0;
+}
@@ -0,0 +1,25 @@
+/* Host replacement of the SDK compiler abstraction, for the simulation build. The SDK version
+ * reads the stack pointer through an ARM register variable.
+ */
+
+#ifndef _COMPILER_ABSTRACTION_H
+#define _COMPILER_ABSTRACTION_H
+
+#include <stdint.h>
+
+#ifndef __ASM
+    #define __ASM               __asm
+#endif
+#ifndef __INLINE
+    #define __INLINE            inline
+#endif
+#ifndef __WEAK
+    #define __WEAK              __attribute__((weak))
+#endif
+#ifndef __ALIGN
+    #define __ALIGN(n)          __attribute__((aligned(n)))
+#endif
+
+#define GET_SP()                ((unsigned int)(uintptr_t)__builtin_frame_address(0))
+
+#endif /* _COMPILER_ABSTRACTION_H */
@@ -0,0 +1,104 @@
+/* Host replacement of the CMSIS Cortex-M4 core header, for the simulation build.
+ *
+ * The core peripherals the firmware reads are plain structures kept by the simulation, and the
+ * NVIC functions and the interrupt masking intrinsics go to its interrupt model (host/sim/sim.c).
+ * Only what the firmware and the SDK modules built for the host use is provided.
+ */
+
+#ifndef CORE_CM4_H__
+#define CORE_CM4_H__
+
+#include <stdint.h>
+
+/* The models of the peripherals define SIM_REGISTERS_WRITABLE to set the read-only registers. */
+#ifdef SIM_REGISTERS_WRITABLE
+#define __I     volatile
+#else
+#define __I     volatile const
+#endif
+#define __O     volatile
+#define __IO    volatile
+
+#define __STATIC_INLINE  static inline
+
+
+/**@brief System Control Block. */
+typedef struct
+{
+    __I  uint32_t CPUID;
+    __IO uint32_t ICSR;
+    __IO uint32_t VTOR;
+    __IO uint32_t AIRCR;
+    __IO uint32_t SCR;
+    __IO uint32_t CCR;
+    __IO uint8_t  SHP[12];
+    __IO uint32_t SHCSR;
+    __IO uint32_t CFSR;
+    __IO uint32_t HFSR;
+    __IO uint32_t DFSR;
+    __IO uint32_t MMFAR;
+    __IO uint32_t BFAR;
+    __IO uint32_t AFSR;
+} SCB_Type;
+
+#define SCB_ICSR_VECTACTIVE_Pos     0
+#define SCB_ICSR_VECTACTIVE_Msk     (0x1FFUL << SCB_ICSR_VECTACTIVE_Pos)
+#define SCB_SCR_SEVONPEND_Pos       4
+#define SCB_SCR_SEVONPEND_Msk       (1UL << SCB_SCR_SEVONPEND_Pos)
+#define SCB_SCR_SLEEPDEEP_Pos       2
+#define SCB_SCR_SLEEPDEEP_Msk       (1UL << SCB_SCR_SLEEPDEEP_Pos)
+
+/**@brief Data Watchpoint and Trace unit, the cycle counter only. */
+typedef struct
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+#define DWT_CTRL_CYCCNTENA_Pos      0
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << DWT_CTRL_CYCCNTENA_Pos)
+
+/**@brief Core Debug registers. */
+typedef struct
+{
+    __IO uint32_t DHCSR;
+    __O  uint32_t DCRSR;
+    __IO uint32_t DCRDR;
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define CoreDebug_DEMCR_TRCENA_Pos  24
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << CoreDebug_DEMCR_TRCENA_Pos)
+
+SCB_Type       * sim_scb(void);
+DWT_Type       * sim_dwt(void);
+CoreDebug_Type * sim_core_debug(void);
+
+#define SCB        (sim_scb())
+#define DWT        (sim_dwt())
+#define CoreDebug  (sim_core_debug())
+
+
+void     NVIC_EnableIRQ(IRQn_Type IRQn);
+void     NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void     NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void     NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetActive(IRQn_Type IRQn);
+void     NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type IRQn);
+void     NVIC_SystemReset(void) __attribute__((noreturn));
+
+void     __disable_irq(void);
+void     __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void     __set_PRIMASK(uint32_t primask);
+uint32_t __get_IPSR(void);
+
+__STATIC_INLINE void __NOP(void) {}
+__STATIC_INLINE void __DSB(void) {}
+__STATIC_INLINE void __ISB(void) {}
+__STATIC_INLINE void __DMB(void) {}
+__STATIC_INLINE void __SEV(void) {}
+
+#endif /* CORE_CM4_H__ */
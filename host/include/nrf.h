@@ -0,0 +1,43 @@
+/* Host replacement of the SDK device header, for the simulation build.
+ *
+ * The SDK header leaves out the device headers on a host. This one includes them, and points the
+ * peripherals the firmware uses at register blocks kept by the simulation (host/sim/sim_periph.c).
+ * Each access goes through a function that first brings the block up to date with the simulated
+ * time and applies the tasks written since the last access.
+ */
+
+#ifndef NRF_H
+#define NRF_H
+
+#include "compiler_abstraction.h"
+#include "nrf52.h"
+#include "nrf52_bitfields.h"
+#include "nrf51_to_nrf52.h"
+
+NRF_RTC_Type   * sim_rtc1(void);
+NRF_TIMER_Type * sim_timer1(void);
+NRF_GPIO_Type  * sim_gpio(void);
+NRF_POWER_Type * sim_power(void);
+NRF_CLOCK_Type * sim_clock(void);
+NRF_FICR_Type  * sim_ficr(void);
+NRF_UICR_Type  * sim_uicr(void);
+
+#undef NRF_RTC1
+#undef NRF_TIMER1
+#undef NRF_P0
+#undef NRF_GPIO
+#undef NRF_POWER
+#undef NRF_CLOCK
+#undef NRF_FICR
+#undef NRF_UICR
+
+#define NRF_RTC1    (sim_rtc1())
+#define NRF_TIMER1  (sim_timer1())
+#define NRF_P0      (sim_gpio())
+#define NRF_GPIO    (sim_gpio())
+#define NRF_POWER   (sim_power())
+#define NRF_CLOCK   (sim_clock())
+#define NRF_FICR    (sim_ficr())
+#define NRF_UICR    (sim_uicr())
+
+#endif /* NRF_H */
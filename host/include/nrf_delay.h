@@ -0,0 +1,13 @@
+/* Host replacement of the SDK delay functions, for the simulation build. A delay advances the
+ * simulated time, running the interrupts that come due meanwhile.
+ */
+
+#ifndef _NRF_DELAY_H
+#define _NRF_DELAY_H
+
+#include <stdint.h>
+
+void nrf_delay_us(uint32_t volatile number_of_us);
+void nrf_delay_ms(uint32_t volatile number_of_ms);
+
+#endif /* _NRF_DELAY_H */
@@ -0,0 +1,739 @@
+/* Simulation core: virtual time, timed events, the interrupt controller and resets. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include "sim.h"
+#include "sim_periph.h"
+
+#define EVENTS_MAX          1024
+#define HOOKS_MAX           16
+#define IRQS_MAX            48
+#define ACTIVE_MAX          16
+#define PRIORITY_THREAD     256       /**< Priority of thread mode, below all interrupts. */
+#define PRIORITY_DEFAULT    0         /**< Priority of an interrupt never set, as on the chip. */
+#define FW_STACK_SIZE       (256 * 1024)
+
+
+/**@brief Timed event. Ordered by time, then by scheduling order. */
+typedef struct
+{
+    uint64_t          time;
+    uint64_t          seq;
+    uint32_t          id;
+    sim_owner_t       owner;
+    sim_evt_handler_t handler;
+    void            * p_context;
+} event_t;
+
+/**@brief Interrupt handlers of the firmware. Weak, as not every build has all of them. */
+extern void RTC1_IRQHandler(void) __attribute__((weak));
+extern void SWI0_EGU0_IRQHandler(void) __attribute__((weak));
+extern void SWI1_EGU1_IRQHandler(void) __attribute__((weak));
+extern void SWI2_EGU2_IRQHandler(void) __attribute__((weak));
+extern void GPIOTE_IRQHandler(void) __attribute__((weak));
+extern void UARTE0_UART0_IRQHandler(void) __attribute__((weak));
+
+/**@brief Data sections of the firmware, renamed by the host Makefile so a reset can find them. */
+extern uint8_t __start_fw_data[] __attribute__((weak));
+extern uint8_t __stop_fw_data[] __attribute__((weak));
+extern uint8_t __start_fw_bss[] __attribute__((weak));
+extern uint8_t __stop_fw_bss[] __attribute__((weak));
+extern uint8_t __start_fw_noinit[] __attribute__((weak));
+extern uint8_t __stop_fw_noinit[] __attribute__((weak));
+
+static event_t  m_events[EVENTS_MAX];          /**< Binary heap. */
+static uint32_t m_event_count;
+static uint64_t m_event_seq;
+static uint32_t m_event_id;
+static uint64_t m_now;
+static uint64_t m_end = SIM_TIME_NEVER;
+
+static sim_reset_hook_t m_hooks[HOOKS_MAX];
+static uint32_t         m_hook_count;
+
+static bool     m_irq_enabled[IRQS_MAX];
+static bool     m_irq_pending[IRQS_MAX];
+static uint32_t m_irq_priority[IRQS_MAX];
+static int32_t  m_active[ACTIVE_MAX];          /**< Interrupts being handled, innermost last. */
+static uint32_t m_active_count;
+static bool     m_primask;
+static bool     m_sd_critical;                 /**< In a SoftDevice critical region. */
+static bool     m_evt_flag;
+
+static SCB_Type       m_scb;
+static DWT_Type       m_dwt;
+static CoreDebug_Type m_core_debug;
+
+static ucontext_t  m_host_context;
+static ucontext_t  m_fw_context;
+static uint8_t   * mp_fw_stack;
+static void     (* mp_entry)(void);
+static bool        m_running;
+static bool        m_reset_requested;
+static sim_reset_t m_reset;
+static sim_reset_t m_last_reset = SIM_RESET_POWER_ON;
+static uint32_t    m_boot_count;
+static int         m_status;
+static uint8_t   * mp_data_image;
+
+static uint32_t m_rand_state = 0x12345678;
+
+
+static void (* irq_handler_get(int32_t irq))(void)
+{
+    switch (irq)
+    {
+        case RTC1_IRQn:         return RTC1_IRQHandler;
+        case SWI0_EGU0_IRQn:    return SWI0_EGU0_IRQHandler;
+        case SWI1_EGU1_IRQn:    return SWI1_EGU1_IRQHandler;
+        case SWI2_EGU2_IRQn:    return SWI2_EGU2_IRQHandler;
+        case GPIOTE_IRQn:       return GPIOTE_IRQHandler;
+        case UARTE0_UART0_IRQn: return UARTE0_UART0_IRQHandler;
+        default:                return NULL;
+    }
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Timed events.
+ */
+
+static bool event_before(event_t const * p_a, event_t const * p_b)
+{
+    return (p_a->time < p_b->time) || ((p_a->time == p_b->time) && (p_a->seq < p_b->seq));
+}
+
+
+static void heap_swap(uint32_t a, uint32_t b)
+{
+    event_t tmp = m_events[a];
+
+    m_events[a] = m_events[b];
+    m_events[b] = tmp;
+}
+
+
+static void heap_up(uint32_t i)
+{
+    while ((i > 0) && event_before(&m_events[i], &m_events[(i - 1) / 2]))
+    {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+
+static void heap_down(uint32_t i)
+{
+    for (;;)
+    {
+        uint32_t smallest = i;
+        uint32_t left     = 2 * i + 1;
+        uint32_t right    = 2 * i + 2;
+
+        if ((left < m_event_count) && event_before(&m_events[left], &m_events[smallest]))
+        {
+            smallest = left;
+        }
+        if ((right < m_event_count) && event_before(&m_events[right], &m_events[smallest]))
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+
+static void heap_remove(uint32_t i)
+{
+    m_event_count--;
+    if (i != m_event_count)
+    {
+        m_events[i] = m_events[m_event_count];
+        heap_up(i);
+        heap_down(i);
+    }
+}
+
+
+uint64_t sim_time(void)
+{
+    return m_now;
+}
+
+
+uint32_t sim_at(uint64_t time, sim_owner_t owner, sim_evt_handler_t handler, void * p_context)
+{
+    event_t * p_event;
+
+    if (m_event_count == EVENTS_MAX)
+    {
+        fprintf(stderr, "sim: too many timed events\n");
+        abort();
+    }
+
+    if (++m_event_id == 0)
+    {
+        m_event_id = 1;
+    }
+
+    p_event            = &m_events[m_event_count];
+    p_event->time      = (time < m_now) ? m_now : time;
+    p_event->seq       = m_event_seq++;
+    p_event->id        = m_event_id;
+    p_event->owner     = owner;
+    p_event->handler   = handler;
+    p_event->p_context = p_context;
+
+    heap_up(m_event_count++);
+    return m_event_id;
+}
+
+
+void sim_cancel(uint32_t id)
+{
+    uint32_t i;
+
+    for (i = 0; (id != 0) && (i < m_event_count); i++)
+    {
+        if (m_events[i].id == id)
+        {
+            heap_remove(i);
+            return;
+        }
+    }
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Interrupt controller. Handlers run when an interrupt of higher priority than the running code
+ * is pended or unmasked, so the firmware is preempted at those points only. The SoftDevice
+ * critical region masks all application interrupts, as they all have application priorities.
+ */
+
+static uint32_t priority_current(void)
+{
+    return (m_active_count == 0) ? PRIORITY_THREAD : m_irq_priority[m_active[m_active_count - 1]];
+}
+
+
+static void irq_dispatch(void)
+{
+    for (;;)
+    {
+        uint32_t current = priority_current();
+        int32_t  best    = -1;
+        int32_t  irq;
+
+        if (m_primask || m_sd_critical)
+        {
+            return;
+        }
+
+        for (irq = 0; irq < IRQS_MAX; irq++)
+        {
+            if (m_irq_pending[irq] && m_irq_enabled[irq] && (m_irq_priority[irq] < current) &&
+                ((best < 0) || (m_irq_priority[irq] < m_irq_priority[best])))
+            {
+                best = irq;
+            }
+        }
+        if (best < 0)
+        {
+            return;
+        }
+
+        if (m_active_count == ACTIVE_MAX)
+        {
+            fprintf(stderr, "sim: interrupt nesting too deep\n");
+            abort();
+        }
+
+        m_irq_pending[best]        = false;
+        m_active[m_active_count++] = best;
+        m_evt_flag                 = true;
+
+        if (irq_handler_get(best) != NULL)
+        {
+            irq_handler_get(best)();
+        }
+
+        m_active_count--;
+        m_evt_flag = true;
+    }
+}
+
+
+void sim_irq_pend(IRQn_Type irq)
+{
+    m_irq_pending[irq] = true;
+    m_evt_flag         = true;
+    irq_dispatch();
+}
+
+
+void sim_irq_priority_set(IRQn_Type irq, uint32_t priority)
+{
+    m_irq_priority[irq] = priority;
+}
+
+
+void sim_irq_dispatch(void)
+{
+    irq_dispatch();
+}
+
+
+void sim_sd_critical_region_set(bool active)
+{
+    m_sd_critical = active;
+    irq_dispatch();
+}
+
+
+bool sim_sd_critical_region_get(void)
+{
+    return m_sd_critical;
+}
+
+
+bool sim_in_irq(void)
+{
+    return m_active_count > 0;
+}
+
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    m_irq_enabled[IRQn] = true;
+    irq_dispatch();
+}
+
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    m_irq_enabled[IRQn] = false;
+}
+
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+    return m_irq_pending[IRQn];
+}
+
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    sim_irq_pend(IRQn);
+}
+
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    m_irq_pending[IRQn] = false;
+}
+
+
+uint32_t NVIC_GetActive(IRQn_Type IRQn)
+{
+    uint32_t i;
+
+    for (i = 0; i < m_active_count; i++)
+    {
+        if (m_active[i] == IRQn)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    m_irq_priority[IRQn] = priority & 0x07;
+}
+
+
+uint32_t NVIC_GetPriority(IRQn_Type IRQn)
+{
+    return m_irq_priority[IRQn];
+}
+
+
+void NVIC_SystemReset(void)
+{
+    sim_reset(SIM_RESET_SOFT);
+}
+
+
+void __disable_irq(void)
+{
+    m_primask = true;
+}
+
+
+void __enable_irq(void)
+{
+    m_primask = false;
+    irq_dispatch();
+}
+
+
+uint32_t __get_PRIMASK(void)
+{
+    return m_primask;
+}
+
+
+void __set_PRIMASK(uint32_t primask)
+{
+    m_primask = (primask & 1) != 0;
+    irq_dispatch();
+}
+
+
+uint32_t __get_IPSR(void)
+{
+    return (m_active_count == 0) ? 0 : (uint32_t)(m_active[m_active_count - 1] + 16);
+}
+
+
+SCB_Type * sim_scb(void)
+{
+    m_scb.ICSR = (m_scb.ICSR & ~SCB_ICSR_VECTACTIVE_Msk) | __get_IPSR();
+    return &m_scb;
+}
+
+
+DWT_Type * sim_dwt(void)
+{
+    struct timespec ts;
+
+    // The cycle counter follows the CPU time of the host, scaled to the 64 MHz of the chip: the
+    // costs it measures compare between builds run on the same host.
+    if (m_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)
+    {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        m_dwt.CYCCNT = (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec) * 64 / 1000);
+    }
+    return &m_dwt;
+}
+
+
+CoreDebug_Type * sim_core_debug(void)
+{
+    return &m_core_debug;
+}
+
+
+bool sim_evt_flag_take(void)
+{
+    bool flag = m_evt_flag;
+
+    m_evt_flag = false;
+    return flag;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Passing of time.
+ */
+
+/**@brief Function for running the first timed event, if it is due by the given time. */
+static bool event_run_next(uint64_t until)
+{
+    event_t event;
+
+    if ((m_event_count == 0) || (m_events[0].time > until))
+    {
+        return false;
+    }
+
+    event = m_events[0];
+    heap_remove(0);
+
+    m_now = event.time;
+    event.handler(event.p_context);
+    irq_dispatch();
+    return true;
+}
+
+
+bool sim_step(void)
+{
+    sim_periph_sync();
+
+    if ((m_event_count == 0) || (m_events[0].time > m_end))
+    {
+        return false;
+    }
+    return event_run_next(m_end);
+}
+
+
+void sim_busy_wait(uint64_t duration)
+{
+    uint64_t until = m_now + duration;
+
+    sim_periph_sync();
+
+    if (until > m_end)
+    {
+        until = m_end;
+    }
+    while (event_run_next(until))
+    {
+    }
+    m_now = until;
+    sim_periph_sync();
+    irq_dispatch();
+
+    if (m_now >= m_end)
+    {
+        sim_stop(0);
+    }
+}
+
+
+bool sim_run_until(bool (*condition)(void), uint64_t timeout)
+{
+    uint64_t until = (timeout > SIM_TIME_NEVER - m_now) ? SIM_TIME_NEVER : m_now + timeout;
+    uint64_t limit = (until < m_end) ? until : m_end;
+
+    sim_periph_sync();
+    irq_dispatch();
+
+    while (!condition())
+    {
+        if (!event_run_next(limit))
+        {
+            if (limit == m_end)
+            {
+                // The end of the simulation, or nothing left that could ever wake the firmware.
+                if (m_end != SIM_TIME_NEVER)
+                {
+                    m_now = m_end;
+                }
+                sim_stop(0);
+            }
+            m_now = until;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool never(void)
+{
+    return false;
+}
+
+
+void sim_run_for(uint64_t duration)
+{
+    (void)sim_run_until(never, duration);
+}
+
+
+void sim_end_set(uint64_t time)
+{
+    m_end = time;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Running the firmware, and resets.
+ */
+
+void sim_reset_hook_add(sim_reset_hook_t hook)
+{
+    if (m_hook_count < HOOKS_MAX)
+    {
+        m_hooks[m_hook_count++] = hook;
+    }
+}
+
+
+uint32_t sim_boot_count(void)
+{
+    return m_boot_count;
+}
+
+
+sim_reset_t sim_last_reset(void)
+{
+    return m_last_reset;
+}
+
+
+/**@brief Function for putting the chip in its state after a reset. */
+static void device_reset(sim_reset_t reset)
+{
+    uint32_t i;
+
+    // Pending work of the chip is lost; the world goes on.
+    for (i = 0; i < m_event_count; )
+    {
+        if (m_events[i].owner == SIM_OWNER_DEVICE)
+        {
+            heap_remove(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    memset(m_irq_enabled, 0, sizeof(m_irq_enabled));
+    memset(m_irq_pending, 0, sizeof(m_irq_pending));
+    memset(m_irq_priority, PRIORITY_DEFAULT, sizeof(m_irq_priority));
+    m_active_count = 0;
+    m_primask      = false;
+    m_sd_critical  = false;
+    m_evt_flag     = false;
+    memset(&m_scb, 0, sizeof(m_scb));
+    memset(&m_dwt, 0, sizeof(m_dwt));
+    memset(&m_core_debug, 0, sizeof(m_core_debug));
+
+    if (__start_fw_data != NULL)
+    {
+        memcpy(__start_fw_data, mp_data_image, __stop_fw_data - __start_fw_data);
+    }
+    if (__start_fw_bss != NULL)
+    {
+        memset(__start_fw_bss, 0, __stop_fw_bss - __start_fw_bss);
+    }
+    if ((__start_fw_noinit != NULL) && (reset == SIM_RESET_POWER_ON))
+    {
+        // RAM content after power-up is undefined.
+        for (i = 0; i < (uint32_t)(__stop_fw_noinit - __start_fw_noinit); i++)
+        {
+            __start_fw_noinit[i] = (uint8_t)sim_rand();
+        }
+    }
+
+    for (i = 0; i < m_hook_count; i++)
+    {
+        m_hooks[i](reset);
+    }
+}
+
+
+static void fw_main(void)
+{
+    mp_entry();
+    m_status = 0;
+}
+
+
+int sim_run(void (*p_entry)(void))
+{
+    if (mp_fw_stack == NULL)
+    {
+        // In the low 4 GB, as the firmware keeps pointers to its stack in 32-bit words too.
+        mp_fw_stack = mmap(NULL, FW_STACK_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+        if (mp_fw_stack == MAP_FAILED)
+        {
+            perror("sim: firmware stack");
+            exit(1);
+        }
+    }
+    if ((mp_data_image == NULL) && (__start_fw_data != NULL))
+    {
+        mp_data_image = malloc(__stop_fw_data - __start_fw_data + 1);
+        memcpy(mp_data_image, __start_fw_data, __stop_fw_data - __start_fw_data);
+    }
+
+    mp_entry          = p_entry;
+    m_running         = true;
+    m_status          = 0;
+    m_reset_requested = false;
+    m_reset           = SIM_RESET_POWER_ON;
+
+    for (;;)
+    {
+        // A run starts with a power-on, restarts are of the kind requested.
+        m_last_reset = m_reset;
+        device_reset(m_reset);
+        m_boot_count++;
+
+        getcontext(&m_fw_context);
+        m_fw_context.uc_stack.ss_sp   = mp_fw_stack;
+        m_fw_context.uc_stack.ss_size = FW_STACK_SIZE;
+        m_fw_context.uc_link          = &m_host_context;
+        makecontext(&m_fw_context, fw_main, 0);
+
+        swapcontext(&m_host_context, &m_fw_context);
+
+        if (!m_reset_requested)
+        {
+            break;
+        }
+        m_reset_requested = false;
+    }
+
+    m_running = false;
+    return m_status;
+}
+
+
+void sim_reset(sim_reset_t reset)
+{
+    if (!m_running)
+    {
+        fprintf(stderr, "sim: reset outside of sim_run()\n");
+        abort();
+    }
+    m_reset_requested = true;
+    m_reset           = reset;
+    setcontext(&m_host_context);
+    abort();
+}
+
+
+void sim_stop(int status)
+{
+    if (!m_running)
+    {
+        fprintf(stderr, "sim: stop outside of sim_run()\n");
+        abort();
+    }
+    m_status = status;
+    setcontext(&m_host_context);
+    abort();
+}
+
+
+void sim_seed(uint32_t seed)
+{
+    m_rand_state = (seed != 0) ? seed : 1;
+}
+
+
+uint32_t sim_rand(void)
+{
+    // xorshift32.
+    m_rand_state ^= m_rand_state << 13;
+    m_rand_state ^= m_rand_state >> 17;
+    m_rand_state ^= m_rand_state << 5;
+    return m_rand_state;
+}
+
+
+bool sim_chance(uint32_t ppm)
+{
+    return (ppm != 0) && ((sim_rand() % 1000000) < ppm);
+}
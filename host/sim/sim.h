@@ -0,0 +1,146 @@
+/* Simulation core: virtual time, timed events, the interrupt controller and resets.
+ *
+ * The firmware runs unmodified on the host against models of the peripherals and the SoftDevice.
+ * Time is virtual: it only advances when the firmware waits (sd_app_evt_wait(), delays, blocking
+ * transfers), by jumping to the next timed event, so a simulated hour takes seconds. Code runs in
+ * zero time. Hardware models act through timed events: an event sets flags and pends interrupts,
+ * and the pended interrupt handlers of the firmware run in priority order as on the Cortex-M4.
+ *
+ * The firmware runs on its own stack, placed in the low 4 GB like all of its data, as it stores
+ * pointers in 32-bit words. A reset restores its initialized data, clears its zero-initialized
+ * data, keeps its no-init RAM and restarts it from its entry function.
+ */
+
+#ifndef SIM_H__
+#define SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf.h"
+
+#define SIM_US(us)  ((uint64_t)(us) * 1000ULL)            /**< Microseconds to simulated time. */
+#define SIM_MS(ms)  ((uint64_t)(ms) * 1000000ULL)         /**< Milliseconds to simulated time. */
+#define SIM_S(s)    ((uint64_t)(s)  * 1000000000ULL)      /**< Seconds to simulated time. */
+
+#define SIM_TIME_NEVER  UINT64_MAX
+
+/**@brief Owners of timed events. Device events belong to the chip and are dropped by a reset;
+ *        world events (script, peers) are not.
+ */
+typedef enum
+{
+    SIM_OWNER_DEVICE,
+    SIM_OWNER_WORLD,
+} sim_owner_t;
+
+/**@brief Kinds of reset, each with the RESETREAS value the firmware sees after it. */
+typedef enum
+{
+    SIM_RESET_POWER_ON,   /**< Power loss and power-on: no-init RAM is lost, RESETREAS is 0. */
+    SIM_RESET_SOFT,       /**< NVIC_SystemReset(). */
+    SIM_RESET_PIN,        /**< Reset pin. */
+    SIM_RESET_DOG,        /**< Watchdog. */
+    SIM_RESET_LOCKUP,     /**< CPU lock-up. */
+} sim_reset_t;
+
+typedef void (*sim_evt_handler_t)(void * p_context);
+typedef void (*sim_reset_hook_t)(sim_reset_t reset);
+
+/**@brief Function for getting the simulated time, in nanoseconds since the simulation started. */
+uint64_t sim_time(void);
+
+/**@brief Function for scheduling a timed event.
+ *
+ * @return Event id for sim_cancel(), never 0.
+ */
+uint32_t sim_at(uint64_t time, sim_owner_t owner, sim_evt_handler_t handler, void * p_context);
+
+/**@brief Function for cancelling a timed event. Ids of events that already ran are ignored. */
+void sim_cancel(uint32_t id);
+
+/**@brief Function for pending an interrupt from a hardware model. Handlers run at once if the
+ *        interrupt is enabled and of higher priority than the running code.
+ */
+void sim_irq_pend(IRQn_Type irq);
+
+/**@brief Function for setting the interrupt priority of the SoftDevice event interrupt and the
+ *        like, set by the SoftDevice rather than the application.
+ */
+void sim_irq_priority_set(IRQn_Type irq, uint32_t priority);
+
+/**@brief Function for entering or leaving the SoftDevice critical region, which masks all
+ *        application interrupts.
+ */
+void sim_sd_critical_region_set(bool active);
+
+/**@brief Function for checking whether the firmware is in the SoftDevice critical region. */
+bool sim_sd_critical_region_get(void);
+
+/**@brief Function for running the interrupt handlers that are pending and unmasked. */
+void sim_irq_dispatch(void);
+
+/**@brief Function for running the next timed event and the interrupts it pends.
+ *
+ * @return false if there is none before the end of the simulation.
+ */
+bool sim_step(void);
+
+/**@brief Function for letting time pass while the CPU is busy, e.g. in a blocking transfer.
+ *        Events due meanwhile run, and so do the interrupts of higher priority than the caller.
+ */
+void sim_busy_wait(uint64_t duration);
+
+/**@brief Function for letting time pass until a condition holds, as sd_app_evt_wait() would.
+ *
+ * @return true if the condition held before the timeout.
+ */
+bool sim_run_until(bool (*condition)(void), uint64_t timeout);
+
+/**@brief Function for letting time pass, as sd_app_evt_wait() would. */
+void sim_run_for(uint64_t duration);
+
+/**@brief Function for checking and clearing the event register of sd_app_evt_wait(): set by
+ *        every interrupt pended or run.
+ */
+bool sim_evt_flag_take(void);
+
+/**@brief Function for registering a function called at each reset, before the firmware
+ *        restarts. Models reset their device side state there.
+ */
+void sim_reset_hook_add(sim_reset_hook_t hook);
+
+/**@brief Function for resetting the chip. Does not return. */
+void sim_reset(sim_reset_t reset) __attribute__((noreturn));
+
+/**@brief Function for getting the number of times the firmware was started, 1 on the first boot. */
+uint32_t sim_boot_count(void);
+
+/**@brief Function for getting the kind of the last reset. */
+sim_reset_t sim_last_reset(void);
+
+/**@brief Function for running firmware from its entry function until it calls sim_stop(), its
+ *        entry function returns or the end time is reached. Resets restart the entry function.
+ *
+ * @return Status passed to sim_stop(), 0 otherwise.
+ */
+int sim_run(void (*p_entry)(void));
+
+/**@brief Function for ending sim_run(). Must be called from the firmware. Does not return. */
+void sim_stop(int status) __attribute__((noreturn));
+
+/**@brief Function for setting the time at which sim_run() ends. SIM_TIME_NEVER by default. */
+void sim_end_set(uint64_t time);
+
+/**@brief Function for checking whether the code runs in an interrupt handler. */
+bool sim_in_irq(void);
+
+/**@brief Function for seeding the pseudo-random generator of the models. */
+void sim_seed(uint32_t seed);
+
+/**@brief Function for getting a pseudo-random number. Deterministic for a given seed. */
+uint32_t sim_rand(void);
+
+/**@brief Function for drawing a probability, in parts per million. */
+bool sim_chance(uint32_t ppm);
+
+#endif /* SIM_H__ */
@@ -0,0 +1,3791 @@
+/* Model of the BLE part of the SoftDevice. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "ble.h"
+#include "ble_hci.h"
+#include "nrf_error.h"
+#include "nrf.h"
+#include "nordic_common.h"
+#include "sim.h"
+#include "sim_soc.h"
+#include "sim_ble.h"
+
+#define EVT_QUEUE_SIZE        32
+#define EVT_SIZE_MAX          128
+#define PACKET_QUEUE_SIZE     32
+#define CENTRALS_MAX          8
+#define ATTRS_MAX             96
+#define CCCDS_MAX             16
+#define WHITELIST_MAX         8
+#define ATTR_TAB_SIZE_DEFAULT 0x600
+#define ATTR_OVERHEAD         8                 /**< Stack memory of an attribute besides its value. */
+
+#define ADV_EVENT_TIME        SIM_US(1200)      /**< Advertising event on three channels. */
+#define ADV_DELAY_MAX_US      10000             /**< Random delay added to each advertising interval. */
+#define ADV_HIGH_DUTY_TIME    SIM_US(3750)      /**< Interval of high duty directed advertising. */
+#define ADV_HIGH_DUTY_TIMEOUT SIM_MS(1280)
+#define CONN_FIRST_EVENT      SIM_US(2500)      /**< From the connect request to the first event. */
+#define EXCHANGE_OVERHEAD_US  380               /**< Empty packet each way and the spacing. */
+#define BYTE_TIME_US          8                 /**< At 1 Mbit/s. */
+#define L2CAP_HEADER_LEN      4
+#define PAIRING_EVENTS        4                 /**< Connection events of the pairing exchange. */
+#define CONN_UPDATE_INSTANT   6                 /**< Events from the update request to the instant. */
+
+#define UNITS_1250_US(n)      ((uint64_t)(n) * SIM_US(1250))
+#define UNITS_625_US(n)       ((uint64_t)(n) * SIM_US(625))
+#define UNITS_10_MS(n)        ((uint64_t)(n) * SIM_MS(10))
+
+#define EVT_SIZE_COMMON       (offsetof(ble_evt_t, evt) + sizeof(ble_common_evt_t))
+#define EVT_SIZE_GAP          (offsetof(ble_evt_t, evt) + sizeof(ble_gap_evt_t))
+#define EVT_SIZE_GATTC        (offsetof(ble_evt_t, evt) + sizeof(ble_gattc_evt_t))
+#define EVT_SIZE_GATTS        (offsetof(ble_evt_t, evt) + sizeof(ble_gatts_evt_t))
+#define EVT_SIZE_AT(field, n) (offsetof(ble_evt_t, field) + (n))
+
+/**@brief Attribute of the GATT server. The handle of an attribute is its index plus one. */
+typedef struct
+{
+    ble_uuid_t              type;
+    uint8_t                 kind;           /**< BLE_GATTS_ATTR_TYPE_*. */
+    uint8_t               * p_value;
+    uint16_t                len;
+    uint16_t                max_len;
+    bool                    vlen;
+    bool                    rd_auth;
+    bool                    wr_auth;
+    ble_gap_conn_sec_mode_t read_perm;
+    ble_gap_conn_sec_mode_t write_perm;
+    uint8_t                 props;          /**< Properties of its characteristic. */
+    ble_uuid_t              srvc_uuid;
+    uint16_t                srvc_handle;
+    uint16_t                value_handle;   /**< Value of its characteristic. */
+    int8_t                  cccd;           /**< Index in the CCCD values of a link, or -1. */
+} attr_t;
+
+/**@brief Packet of a link: an ATT PDU. */
+typedef struct
+{
+    uint8_t pdu[SIM_BLE_ATT_MTU];
+    uint8_t len;
+    bool    tx_buffer;                      /**< Took an application transmission buffer. */
+} packet_t;
+
+typedef struct
+{
+    packet_t items[PACKET_QUEUE_SIZE];
+    uint32_t read;
+    uint32_t write;
+} packet_queue_t;
+
+typedef enum
+{
+    SEC_IDLE,
+    SEC_PAIR_REQUEST,       /**< The central asked to pair. */
+    SEC_PARAMS_WAIT,        /**< Waiting for sd_ble_gap_sec_params_reply(). */
+    SEC_PAIRING,
+    SEC_KEYS,               /**< Encrypted, keys being distributed. */
+    SEC_PAIR_REJECT,
+    SEC_ENC_REQUEST,        /**< The central asked to encrypt. */
+    SEC_INFO_WAIT,          /**< Waiting for sd_ble_gap_sec_info_reply(). */
+    SEC_ENCRYPTING,
+    SEC_ENC_REJECT,
+} sec_state_t;
+
+typedef enum
+{
+    CPU_IDLE,
+    CPU_REQUEST,            /**< Connection parameter update request to send. */
+    CPU_RESPONSE,           /**< Request sent, the central answers. */
+    CPU_INSTANT,            /**< Accepted, waiting for the instant. */
+} cpu_state_t;
+
+typedef enum
+{
+    HELD_NONE,
+    HELD_SYS_ATTR,          /**< Waiting for sd_ble_gatts_sys_attr_set(). */
+    HELD_AUTH,              /**< Waiting for sd_ble_gatts_rw_authorize_reply(). */
+} held_t;
+
+typedef struct
+{
+    bool                  connected;
+    bool                  attrs_kept;       /**< System attributes still readable after the link. */
+    sim_ble_central_t   * p_central;
+    ble_gap_addr_t        peer_addr;
+    uint16_t              interval;
+    uint16_t              latency;
+    uint16_t              sup_timeout;
+    uint64_t              anchor;           /**< Start of the next connection event. */
+    uint64_t              last_rx;          /**< Last packet received from the central. */
+    uint32_t              event_counter;
+    uint32_t              prepare_id;
+    uint8_t               exchanged;        /**< Packets through each way in the event held. */
+    packet_queue_t        to_central;
+    packet_queue_t        to_device;
+    uint8_t               tx_free;
+    bool                  local_terminate;
+    uint8_t               local_reason;
+    bool                  remote_terminate;
+    uint8_t               remote_reason;
+
+    /* GATT client. */
+    uint8_t               gattc_op;         /**< Request awaiting its response, 0 if none. */
+    ble_uuid_t            gattc_uuid;
+    uint16_t              gattc_handle;
+    uint16_t              gattc_offset;
+    uint8_t               gattc_write_op;
+    uint8_t               gattc_data[SIM_BLE_ATT_MTU];
+    uint16_t              gattc_len;
+
+    /* GATT server. */
+    bool                  sys_attr_known;
+    bool                  sys_attr_missing_sent;
+    uint16_t              cccds[CCCDS_MAX];
+    held_t                held;
+    uint8_t               held_pdu[SIM_BLE_ATT_MTU];
+    uint16_t              held_len;
+    uint16_t              hvi_handle;       /**< Indication awaiting its confirmation, 0 if none. */
+
+    /* Security. */
+    sec_state_t           sec_state;
+    uint8_t               sec_events;
+    uint8_t               sec_status;
+    bool                  sec_request;      /**< Security request to send to the central. */
+    bool                  sec_bond;
+    ble_gap_sec_params_t  sec_peer;
+    ble_gap_sec_params_t  sec_own;
+    ble_gap_sec_keyset_t  keyset;
+    ble_gap_conn_sec_t    conn_sec;
+
+    /* Connection parameter update. */
+    cpu_state_t           cpu_state;
+    uint32_t              cpu_instant;
+    ble_gap_conn_params_t cpu_params;
+} link_t;
+
+/**@brief State of the chip side, lost at a reset. */
+static struct
+{
+    bool                  enabled;
+    bool                  service_changed;
+    uint32_t              attr_tab_size;
+    uint32_t              attr_tab_used;
+
+    ble_uuid128_t         vs_uuids[BLE_UUID_VS_MAX_COUNT];
+    uint8_t               vs_count;
+
+    attr_t                attrs[ATTRS_MAX];
+    uint16_t              attr_count;
+    uint8_t               attr_mem[ATTR_TAB_SIZE_DEFAULT * 2];
+    uint8_t               cccd_count;
+    uint16_t              name_handle;
+    uint16_t              appearance_handle;
+    uint16_t              ppcp_handle;
+    uint16_t              sc_handle;        /**< Service changed value, 0 if absent. */
+
+    uint32_t              evts[EVT_QUEUE_SIZE][EVT_SIZE_MAX / 4];
+    uint16_t              evt_lens[EVT_QUEUE_SIZE];
+    uint32_t              evt_read;
+    uint32_t              evt_write;
+    uint32_t              model_depth;      /**< Model code running, which pends the interrupt last. */
+    bool                  evt_irq_due;
+
+    uint64_t              radio_free;       /**< End of the last radio event reserved. */
+    uint32_t              radio_holders;    /**< Radio events reserved and not ended. */
+
+    link_t                links[SIM_BLE_LINKS_MAX];
+} m_ble;
+
+/**@brief Advertising, lost at a reset. */
+static struct
+{
+    bool                  active;
+    uint32_t              generation;       /**< Tells events of an earlier advertising set. */
+    ble_gap_adv_params_t  params;
+    ble_gap_addr_t        peer_addr;
+    ble_gap_addr_t        wl_addrs[WHITELIST_MAX];
+    uint8_t               wl_addr_count;
+    ble_gap_irk_t         wl_irks[WHITELIST_MAX];
+    uint8_t               wl_irk_count;
+    uint64_t              next;             /**< Start of the next advertising event. */
+    uint32_t              prepare_id;
+    uint32_t              timeout_id;
+    uint8_t               data[BLE_GAP_ADV_MAX_SIZE];
+    uint8_t               dlen;
+    uint8_t               sr_data[BLE_GAP_ADV_MAX_SIZE];
+    uint8_t               srdlen;
+} m_adv;
+
+/* World side, kept across resets. */
+static sim_ble_config_t    m_config;
+static sim_ble_stats_t     m_stats;
+static sim_ble_central_t * mp_centrals[CENTRALS_MAX];
+static uint32_t            m_central_count;
+
+
+static uint16_t get16(uint8_t const * p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+
+static void put16(uint8_t * p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+
+/**@brief CRC-16-CCITT of the system attributes, as the SoftDevice stores them. */
+static uint16_t crc16(uint8_t const * p_data, uint32_t size)
+{
+    uint16_t crc = 0xFFFF;
+    uint32_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        crc  = (uint8_t)(crc >> 8) | (crc << 8);
+        crc ^= p_data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+    return crc;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Events to the firmware. Model code queues them while it runs and pends the event interrupt when
+ * it is done, so the handlers of the firmware never run in the middle of a model update.
+ */
+
+static void model_enter(void)
+{
+    m_ble.model_depth++;
+}
+
+
+static void model_exit(void)
+{
+    if ((--m_ble.model_depth == 0) && m_ble.evt_irq_due)
+    {
+        m_ble.evt_irq_due = false;
+        sim_soc_evt_irq_pend();
+    }
+}
+
+
+static ble_evt_t * evt_new(uint16_t evt_id)
+{
+    static uint32_t scratch[EVT_SIZE_MAX / 4];
+    ble_evt_t     * p_evt = (ble_evt_t *)scratch;
+
+    memset(scratch, 0, sizeof(scratch));
+    p_evt->header.evt_id = evt_id;
+    return p_evt;
+}
+
+
+static void evt_push(ble_evt_t * p_evt, size_t size)
+{
+    uint32_t slot = m_ble.evt_write % EVT_QUEUE_SIZE;
+
+    if (m_ble.evt_write - m_ble.evt_read == EVT_QUEUE_SIZE)
+    {
+        fprintf(stderr, "sim: BLE event queue full, the firmware does not read its events\n");
+        abort();
+    }
+    if (size < sizeof(ble_evt_hdr_t) + sizeof(uint16_t))
+    {
+        size = sizeof(ble_evt_hdr_t) + sizeof(uint16_t);
+    }
+
+    p_evt->header.evt_len = (uint16_t)(size - sizeof(ble_evt_hdr_t));
+    memcpy(m_ble.evts[slot], p_evt, size);
+    m_ble.evt_lens[slot] = (uint16_t)size;
+    m_ble.evt_write++;
+
+    if (m_ble.model_depth > 0)
+    {
+        m_ble.evt_irq_due = true;
+    }
+    else
+    {
+        sim_soc_evt_irq_pend();
+    }
+}
+
+
+static void gap_evt_push(uint16_t evt_id, uint16_t conn_handle, void const * p_params, size_t len)
+{
+    ble_evt_t * p_evt = evt_new(evt_id);
+
+    p_evt->evt.gap_evt.conn_handle = conn_handle;
+    memcpy(&p_evt->evt.gap_evt.params, p_params, len);
+    evt_push(p_evt, EVT_SIZE_GAP);
+}
+
+
+uint32_t sd_ble_evt_get(uint8_t * p_dest, uint16_t * p_len)
+{
+    uint32_t slot = m_ble.evt_read % EVT_QUEUE_SIZE;
+
+    if (p_len == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (m_ble.evt_read == m_ble.evt_write)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (p_dest == NULL)
+    {
+        *p_len = m_ble.evt_lens[slot];
+        return NRF_SUCCESS;
+    }
+    if (*p_len < m_ble.evt_lens[slot])
+    {
+        *p_len = m_ble.evt_lens[slot];
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    *p_len = m_ble.evt_lens[slot];
+    memcpy(p_dest, m_ble.evts[slot], *p_len);
+    m_ble.evt_read++;
+    return NRF_SUCCESS;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * UUIDs.
+ */
+
+static ble_uuid128_t const m_bt_base_uuid =
+{
+    {0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+
+/**@brief Function for encoding a UUID, little endian. Returns its length, 0 if its type is unknown. */
+static uint8_t uuid_encode(ble_uuid_t const * p_uuid, uint8_t * p_out)
+{
+    if (p_uuid->type == BLE_UUID_TYPE_BLE)
+    {
+        put16(p_out, p_uuid->uuid);
+        return 2;
+    }
+    if ((p_uuid->type >= BLE_UUID_TYPE_VENDOR_BEGIN) &&
+        (p_uuid->type < BLE_UUID_TYPE_VENDOR_BEGIN + m_ble.vs_count))
+    {
+        memcpy(p_out, m_ble.vs_uuids[p_uuid->type - BLE_UUID_TYPE_VENDOR_BEGIN].uuid128, 16);
+        put16(&p_out[12], p_uuid->uuid);
+        return 16;
+    }
+    return 0;
+}
+
+
+static void uuid_decode(uint8_t const * p_in, uint8_t len, ble_uuid_t * p_uuid)
+{
+    uint8_t i;
+
+    p_uuid->type = BLE_UUID_TYPE_UNKNOWN;
+    p_uuid->uuid = 0;
+
+    if (len == 2)
+    {
+        p_uuid->type = BLE_UUID_TYPE_BLE;
+        p_uuid->uuid = get16(p_in);
+        return;
+    }
+    if (len != 16)
+    {
+        return;
+    }
+    for (i = 0; i < m_ble.vs_count; i++)
+    {
+        uint8_t const * p_base = m_ble.vs_uuids[i].uuid128;
+
+        if ((memcmp(p_in, p_base, 12) == 0) && (memcmp(&p_in[14], &p_base[14], 2) == 0))
+        {
+            p_uuid->type = BLE_UUID_TYPE_VENDOR_BEGIN + i;
+            p_uuid->uuid = get16(&p_in[12]);
+            return;
+        }
+    }
+}
+
+
+/**@brief Function for comparing UUIDs given in 2 or 16 bytes, as ATT does. */
+static bool uuid_bytes_equal(uint8_t const * p_a, uint8_t a_len, uint8_t const * p_b, uint8_t b_len)
+{
+    uint8_t a[16];
+    uint8_t b[16];
+
+    if (a_len == b_len)
+    {
+        return memcmp(p_a, p_b, a_len) == 0;
+    }
+
+    memcpy(a, m_bt_base_uuid.uuid128, 16);
+    memcpy(b, m_bt_base_uuid.uuid128, 16);
+    if (a_len == 2)
+    {
+        memcpy(&a[12], p_a, 2);
+    }
+    else
+    {
+        memcpy(a, p_a, 16);
+    }
+    if (b_len == 2)
+    {
+        memcpy(&b[12], p_b, 2);
+    }
+    else
+    {
+        memcpy(b, p_b, 16);
+    }
+    return memcmp(a, b, 16) == 0;
+}
+
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    ble_uuid128_t base;
+    uint8_t       i;
+
+    if ((p_vs_uuid == NULL) || (p_uuid_type == NULL))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    // Bytes 12 and 13 hold the 16-bit UUIDs of the base; the SoftDevice ignores them.
+    base = *p_vs_uuid;
+    base.uuid128[12] = 0;
+    base.uuid128[13] = 0;
+
+    for (i = 0; i < m_ble.vs_count; i++)
+    {
+        if (memcmp(&m_ble.vs_uuids[i], &base, sizeof(base)) == 0)
+        {
+            *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + i;
+            return NRF_SUCCESS;
+        }
+    }
+    if (m_ble.vs_count == BLE_UUID_VS_MAX_COUNT)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_ble.vs_uuids[m_ble.vs_count] = base;
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + m_ble.vs_count++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_encode(ble_uuid_t const * p_uuid, uint8_t * p_uuid_le_len, uint8_t * p_uuid_le)
+{
+    uint8_t buf[16];
+    uint8_t len;
+
+    if ((p_uuid == NULL) || (p_uuid_le_len == NULL))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    len = uuid_encode(p_uuid, buf);
+    if (len == 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_uuid_le != NULL)
+    {
+        memcpy(p_uuid_le, buf, len);
+    }
+    *p_uuid_le_len = len;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_decode(uint8_t uuid_le_len, uint8_t const * p_uuid_le, ble_uuid_t * p_uuid)
+{
+    if ((p_uuid_le == NULL) || (p_uuid == NULL))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if ((uuid_le_len != 2) && (uuid_le_len != 16))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    uuid_decode(p_uuid_le, uuid_le_len, p_uuid);
+    return (p_uuid->type == BLE_UUID_TYPE_UNKNOWN) ? NRF_ERROR_NOT_FOUND : NRF_SUCCESS;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Attribute table of the GATT server.
+ */
+
+static attr_t * attr_get(uint16_t handle)
+{
+    return ((handle == 0) || (handle > m_ble.attr_count)) ? NULL : &m_ble.attrs[handle - 1];
+}
+
+
+static uint8_t * attr_mem_alloc(uint16_t size)
+{
+    uint8_t * p_mem;
+
+    if (m_ble.attr_tab_used + size + ATTR_OVERHEAD > m_ble.attr_tab_size)
+    {
+        return NULL;
+    }
+    p_mem = &m_ble.attr_mem[m_ble.attr_tab_used];
+    m_ble.attr_tab_used += size + ATTR_OVERHEAD;
+    return p_mem;
+}
+
+
+/**@brief Function for adding an attribute with its value in stack memory.
+ *
+ * @return Handle of the attribute, 0 if the table is full.
+ */
+static uint16_t attr_add(uint16_t type16, uint8_t type_type, uint8_t kind, uint16_t max_len,
+                         uint8_t const * p_init, uint16_t init_len)
+{
+    attr_t  * p_attr;
+    uint8_t * p_mem;
+
+    if (m_ble.attr_count == ATTRS_MAX)
+    {
+        return 0;
+    }
+    p_mem = attr_mem_alloc(max_len);
+    if (p_mem == NULL)
+    {
+        return 0;
+    }
+
+    p_attr = &m_ble.attrs[m_ble.attr_count++];
+    memset(p_attr, 0, sizeof(*p_attr));
+    p_attr->type.uuid  = type16;
+    p_attr->type.type  = type_type;
+    p_attr->kind       = kind;
+    p_attr->p_value    = p_mem;
+    p_attr->max_len    = max_len;
+    p_attr->len        = init_len;
+    p_attr->cccd       = -1;
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&p_attr->read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&p_attr->write_perm);
+    if ((p_init != NULL) && (init_len > 0))
+    {
+        memcpy(p_mem, p_init, init_len);
+    }
+    if (m_ble.attr_count > 1)
+    {
+        attr_t const * p_prev = &m_ble.attrs[m_ble.attr_count - 2];
+
+        p_attr->srvc_handle = p_prev->srvc_handle;
+        p_attr->srvc_uuid   = p_prev->srvc_uuid;
+    }
+    return m_ble.attr_count;
+}
+
+
+static uint16_t service_decl_add(uint8_t type, ble_uuid_t const * p_uuid)
+{
+    uint8_t  value[16];
+    uint8_t  len = uuid_encode(p_uuid, value);
+    uint16_t handle;
+
+    handle = attr_add((type == BLE_GATTS_SRVC_TYPE_PRIMARY) ? BLE_UUID_SERVICE_PRIMARY : BLE_UUID_SERVICE_SECONDARY,
+                      BLE_UUID_TYPE_BLE, (type == BLE_GATTS_SRVC_TYPE_PRIMARY) ? BLE_GATTS_ATTR_TYPE_PRIM_SRVC_DECL
+                                                                               : BLE_GATTS_ATTR_TYPE_SEC_SRVC_DECL,
+                      len, value, len);
+    if (handle != 0)
+    {
+        attr_get(handle)->srvc_handle = handle;
+        attr_get(handle)->srvc_uuid   = *p_uuid;
+    }
+    return handle;
+}
+
+
+static uint8_t props_encode(ble_gatt_char_props_t const * p_props, ble_gatt_char_ext_props_t const * p_ext)
+{
+    return (uint8_t)((p_props->broadcast      << 0) |
+                     (p_props->read           << 1) |
+                     (p_props->write_wo_resp  << 2) |
+                     (p_props->write          << 3) |
+                     (p_props->notify         << 4) |
+                     (p_props->indicate       << 5) |
+                     (p_props->auth_signed_wr << 6) |
+                     (((p_ext != NULL) && (p_ext->reliable_wr || p_ext->wr_aux)) ? 0x80 : 0));
+}
+
+
+/**@brief Function for adding a characteristic declaration and its value attribute.
+ *
+ * @return Handle of the value, 0 if the table is full.
+ */
+static uint16_t char_add(uint8_t props, ble_uuid_t const * p_uuid, uint16_t max_len, bool vlen,
+                         uint8_t const * p_init, uint16_t init_len)
+{
+    uint8_t  decl[3 + 16];
+    uint8_t  uuid_len = uuid_encode(p_uuid, &decl[3]);
+    uint16_t decl_handle;
+    uint16_t value_handle;
+    attr_t * p_value;
+
+    decl[0] = props;
+    put16(&decl[1], m_ble.attr_count + 2);
+    decl_handle = attr_add(BLE_UUID_CHARACTERISTIC, BLE_UUID_TYPE_BLE, BLE_GATTS_ATTR_TYPE_CHAR_DECL,
+                           3 + uuid_len, decl, 3 + uuid_len);
+    if (decl_handle == 0)
+    {
+        return 0;
+    }
+    value_handle = attr_add(p_uuid->uuid, p_uuid->type, BLE_GATTS_ATTR_TYPE_CHAR_VAL, max_len, p_init, init_len);
+    if (value_handle == 0)
+    {
+        return 0;
+    }
+
+    p_value               = attr_get(value_handle);
+    p_value->vlen         = vlen;
+    p_value->props        = props;
+    p_value->value_handle = value_handle;
+    attr_get(decl_handle)->value_handle = value_handle;
+    return value_handle;
+}
+
+
+static uint16_t cccd_add(uint16_t value_handle, ble_gatts_attr_md_t const * p_md)
+{
+    uint16_t handle;
+    attr_t * p_attr;
+
+    if (m_ble.cccd_count == CCCDS_MAX)
+    {
+        return 0;
+    }
+    handle = attr_add(BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG, BLE_UUID_TYPE_BLE, BLE_GATTS_ATTR_TYPE_DESC, 2, NULL, 2);
+    if (handle == 0)
+    {
+        return 0;
+    }
+
+    p_attr               = attr_get(handle);
+    p_attr->value_handle = value_handle;
+    p_attr->cccd         = (int8_t)m_ble.cccd_count++;
+    if (p_md != NULL)
+    {
+        p_attr->read_perm  = p_md->read_perm;
+        p_attr->write_perm = p_md->write_perm;
+    }
+    else
+    {
+        BLE_GAP_CONN_SEC_MODE_SET_OPEN(&p_attr->write_perm);
+    }
+    return handle;
+}
+
+
+/**@brief Function for finding the CCCD of a characteristic value, NULL if it has none. */
+static attr_t * cccd_find(uint16_t value_handle)
+{
+    uint16_t i;
+
+    for (i = 0; i < m_ble.attr_count; i++)
+    {
+        if ((m_ble.attrs[i].cccd >= 0) && (m_ble.attrs[i].value_handle == value_handle))
+        {
+            return &m_ble.attrs[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for adding the services of the SoftDevice itself, GAP and GATT. */
+static void builtin_services_add(void)
+{
+    static const uint8_t default_name[] = "nRF5x";
+    ble_uuid_t           uuid           = {.type = BLE_UUID_TYPE_BLE};
+    ble_gap_conn_sec_mode_t open;
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&open);
+
+    uuid.uuid = BLE_UUID_GAP;
+    (void)service_decl_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &uuid);
+    uuid.uuid         = BLE_UUID_GAP_CHARACTERISTIC_DEVICE_NAME;
+    m_ble.name_handle = char_add(0x02, &uuid, BLE_GAP_DEVNAME_MAX_LEN, true, default_name,
+                                 sizeof(default_name) - 1);
+    uuid.uuid               = BLE_UUID_GAP_CHARACTERISTIC_APPEARANCE;
+    m_ble.appearance_handle = char_add(0x02, &uuid, 2, false, NULL, 2);
+    uuid.uuid               = BLE_UUID_GAP_CHARACTERISTIC_PPCP;
+    m_ble.ppcp_handle       = char_add(0x02, &uuid, 8, false, NULL, 8);
+
+    uuid.uuid = BLE_UUID_GATT;
+    (void)service_decl_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &uuid);
+    if (m_ble.service_changed)
+    {
+        uuid.uuid       = BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED;
+        m_ble.sc_handle = char_add(0x20, &uuid, 4, false, NULL, 4);
+        (void)cccd_add(m_ble.sc_handle, NULL);
+    }
+}
+
+
+uint32_t sd_ble_enable(ble_enable_params_t * p_ble_enable_params)
+{
+    if (p_ble_enable_params == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (!sim_soc_enabled() || m_ble.enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    m_ble.attr_tab_size = p_ble_enable_params->gatts_enable_params.attr_tab_size;
+    if (m_ble.attr_tab_size == BLE_GATTS_ATTR_TAB_SIZE_DEFAULT)
+    {
+        m_ble.attr_tab_size = ATTR_TAB_SIZE_DEFAULT;
+    }
+    if ((m_ble.attr_tab_size < BLE_GATTS_ATTR_TAB_SIZE_MIN) ||
+        (m_ble.attr_tab_size > sizeof(m_ble.attr_mem)))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    m_ble.service_changed = p_ble_enable_params->gatts_enable_params.service_changed;
+    m_ble.enabled         = true;
+
+    builtin_services_add();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_tx_buffer_count_get(uint8_t * p_count)
+{
+    if (p_count == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    *p_count = SIM_BLE_TX_BUFFERS;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle)
+{
+    uint8_t buf[16];
+
+    if ((p_uuid == NULL) || (p_handle == NULL))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (!m_ble.enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if ((type != BLE_GATTS_SRVC_TYPE_PRIMARY) && (type != BLE_GATTS_SRVC_TYPE_SECONDARY))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (uuid_encode(p_uuid, buf) == 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    *p_handle = service_decl_add(type, p_uuid);
+    return (*p_handle != 0) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle,
+                                         ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const * p_attr_char_value,
+                                         ble_gatts_char_handles_t * p_handles)
+{
+    ble_gatts_attr_md_t const * p_md;
+    attr_t const              * p_srvc = attr_get(service_handle);
+    uint8_t                     props;
+    uint16_t                    value_handle;
+    attr_t                    * p_value;
+    ble_uuid_t                  uuid = {.type = BLE_UUID_TYPE_BLE};
+    uint8_t                     buf[16];
+
+    if ((p_char_md == NULL) || (p_attr_char_value == NULL) || (p_handles == NULL) ||
+        (p_attr_char_value->p_uuid == NULL) || (p_attr_char_value->p_attr_md == NULL))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (!m_ble.enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if ((p_srvc == NULL) || (p_srvc->srvc_handle != service_handle) ||
+        (m_ble.attrs[m_ble.attr_count - 1].srvc_handle != service_handle))
+    {
+        // Characteristics go to the last service added.
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_md = p_attr_char_value->p_attr_md;
+    if ((uuid_encode(p_attr_char_value->p_uuid, buf) == 0) ||
+        (p_md->vloc == BLE_GATTS_VLOC_INVALID) ||
+        (p_attr_char_value->max_len > (p_md->vlen ? BLE_GATTS_VAR_ATTR_LEN_MAX : BLE_GATTS_FIX_ATTR_LEN_MAX)) ||
+        (p_attr_char_value->init_len > p_attr_char_value->max_len) ||
+        ((p_md->vloc == BLE_GATTS_VLOC_USER) && (p_attr_char_value->p_value == NULL)))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    memset(p_handles, 0, sizeof(*p_handles));
+    props        = props_encode(&p_char_md->char_props, &p_char_md->char_ext_props);
+    value_handle = char_add(props, p_attr_char_value->p_uuid,
+                            (p_md->vloc == BLE_GATTS_VLOC_USER) ? 0 : p_attr_char_value->max_len,
+                            p_md->vlen, NULL, 0);
+    if (value_handle == 0)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_value             = attr_get(value_handle);
+    p_value->max_len    = p_attr_char_value->max_len;
+    p_value->len        = p_attr_char_value->init_len;
+    p_value->read_perm  = p_md->read_perm;
+    p_value->write_perm = p_md->write_perm;
+    p_value->rd_auth    = p_md->rd_auth;
+    p_value->wr_auth    = p_md->wr_auth;
+    if (p_md->vloc == BLE_GATTS_VLOC_USER)
+    {
+        p_value->p_value = p_attr_char_value->p_value;
+    }
+    else if (p_attr_char_value->p_value != NULL)
+    {
+        memcpy(p_value->p_value, p_attr_char_value->p_value, p_attr_char_value->init_len);
+    }
+    p_handles->value_handle = value_handle;
+
+    if (p_char_md->p_char_user_desc != NULL)
+    {
+        uuid.uuid = BLE_UUID_DESCRIPTOR_CHAR_USER_DESC;
+        p_handles->user_desc_handle = attr_add(uuid.uuid, BLE_UUID_TYPE_BLE, BLE_GATTS_ATTR_TYPE_DESC,
+                                               p_char_md->char_user_desc_max_size,
+                                               p_char_md->p_char_user_desc, p_char_md->char_user_desc_size);
+        if (p_handles->user_desc_handle == 0)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        attr_get(p_handles->user_desc_handle)->value_handle = value_handle;
+    }
+    if (p_char_md->p_char_pf != NULL)
+    {
+        uint8_t  pf[7];
+        uint16_t handle;
+
+        pf[0] = p_char_md->p_char_pf->format;
+        pf[1] = (uint8_t)p_char_md->p_char_pf->exponent;
+        put16(&pf[2], p_char_md->p_char_pf->unit);
+        pf[4] = p_char_md->p_char_pf->name_space;
+        put16(&pf[5], p_char_md->p_char_pf->desc);
+        handle = attr_add(BLE_UUID_DESCRIPTOR_CHAR_PRESENTATION_FORMAT, BLE_UUID_TYPE_BLE,
+                          BLE_GATTS_ATTR_TYPE_DESC, sizeof(pf), pf, sizeof(pf));
+        if (handle == 0)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        attr_get(handle)->value_handle = value_handle;
+    }
+    if (p_char_md->char_props.notify || p_char_md->char_props.indicate)
+    {
+        p_handles->cccd_handle = cccd_add(value_handle, p_char_md->p_cccd_md);
+        if (p_handles->cccd_handle == 0)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Links: lookup and packet queues.
+ */
+
+static link_t * link_get(uint16_t conn_handle)
+{
+    if ((conn_handle >= SIM_BLE_LINKS_MAX) || !m_ble.links[conn_handle].connected)
+    {
+        return NULL;
+    }
+    return &m_ble.links[conn_handle];
+}
+
+
+static uint16_t link_handle(link_t const * p_link)
+{
+    return (uint16_t)(p_link - m_ble.links);
+}
+
+
+static uint32_t link_count(void)
+{
+    uint32_t count = 0;
+    uint32_t i;
+
+    for (i = 0; i < SIM_BLE_LINKS_MAX; i++)
+    {
+        count += m_ble.links[i].connected ? 1 : 0;
+    }
+    return count;
+}
+
+
+/**@brief Function for getting the link of a central, NULL if it has none. */
+static link_t * central_link(sim_ble_central_t const * p_central)
+{
+    link_t * p_link = link_get(p_central->conn_handle);
+
+    return ((p_link != NULL) && (p_link->p_central == p_central)) ? p_link : NULL;
+}
+
+
+static uint32_t queue_count(packet_queue_t const * p_queue)
+{
+    return p_queue->write - p_queue->read;
+}
+
+
+static bool queue_put(packet_queue_t * p_queue, uint8_t const * p_pdu, uint16_t len, bool tx_buffer)
+{
+    packet_t * p_packet;
+
+    if ((queue_count(p_queue) == PACKET_QUEUE_SIZE) || (len > SIM_BLE_ATT_MTU))
+    {
+        return false;
+    }
+    p_packet = &p_queue->items[p_queue->write++ % PACKET_QUEUE_SIZE];
+    memcpy(p_packet->pdu, p_pdu, len);
+    p_packet->len       = (uint8_t)len;
+    p_packet->tx_buffer = tx_buffer;
+    return true;
+}
+
+
+static packet_t const * queue_peek(packet_queue_t const * p_queue, uint32_t index)
+{
+    return &p_queue->items[(p_queue->read + index) % PACKET_QUEUE_SIZE];
+}
+
+
+static void device_send(link_t * p_link, uint8_t const * p_pdu, uint16_t len, bool tx_buffer)
+{
+    if (!queue_put(&p_link->to_central, p_pdu, len, tx_buffer))
+    {
+        fprintf(stderr, "sim: BLE packet queue of link %u full\n", link_handle(p_link));
+        abort();
+    }
+}
+
+
+static void att_error_send(link_t * p_link, uint8_t req, uint16_t handle, uint16_t status)
+{
+    uint8_t pdu[5];
+
+    pdu[0] = SIM_ATT_ERROR_RSP;
+    pdu[1] = req;
+    put16(&pdu[2], handle);
+    pdu[4] = (uint8_t)status;
+    device_send(p_link, pdu, sizeof(pdu), false);
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * GATT server: requests of the centrals.
+ */
+
+/**@brief Function for getting the value of an attribute as a link sees it. */
+static void attr_value(link_t const * p_link, attr_t const * p_attr, uint8_t const ** pp_value, uint16_t * p_len)
+{
+    static uint8_t cccd[2];
+
+    if (p_attr->cccd >= 0)
+    {
+        put16(cccd, p_link->cccds[(uint8_t)p_attr->cccd]);
+        *pp_value = cccd;
+        *p_len    = 2;
+        return;
+    }
+    *pp_value = p_attr->p_value;
+    *p_len    = p_attr->len;
+}
+
+
+/**@brief Function for checking an access against a permission. Returns 0 or an ATT error. */
+static uint16_t perm_check(link_t const * p_link, ble_gap_conn_sec_mode_t perm, bool write)
+{
+    if ((perm.sm == 0) && (perm.lv == 0))
+    {
+        return write ? BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED : BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED;
+    }
+    if ((perm.lv > 1) && (p_link->conn_sec.sec_mode.lv < perm.lv))
+    {
+        // The central then pairs, or encrypts with its bond.
+        return BLE_GATT_STATUS_ATTERR_INSUF_AUTHENTICATION;
+    }
+    return 0;
+}
+
+
+static void attr_context(attr_t const * p_attr, ble_gatts_attr_context_t * p_context)
+{
+    attr_t const * p_value = attr_get(p_attr->value_handle);
+
+    memset(p_context, 0, sizeof(*p_context));
+    p_context->srvc_uuid    = p_attr->srvc_uuid;
+    p_context->srvc_handle  = p_attr->srvc_handle;
+    p_context->value_handle = p_attr->value_handle;
+    p_context->type         = p_attr->kind;
+    if (p_value != NULL)
+    {
+        p_context->char_uuid = p_value->type;
+    }
+    if (p_attr->kind == BLE_GATTS_ATTR_TYPE_DESC)
+    {
+        p_context->desc_uuid = p_attr->type;
+    }
+}
+
+
+/**@brief Function for holding a request of a central until the system attributes of the link are
+ *        known. The SoftDevice asks for them once per link.
+ */
+static void request_hold(link_t * p_link, held_t reason, uint8_t const * p_pdu, uint16_t len)
+{
+    p_link->held     = reason;
+    p_link->held_len = len;
+    memcpy(p_link->held_pdu, p_pdu, len);
+
+    if ((reason == HELD_SYS_ATTR) && !p_link->sys_attr_missing_sent)
+    {
+        ble_evt_t * p_evt = evt_new(BLE_GATTS_EVT_SYS_ATTR_MISSING);
+
+        p_link->sys_attr_missing_sent = true;
+        p_evt->evt.gatts_evt.conn_handle = link_handle(p_link);
+        evt_push(p_evt, EVT_SIZE_GATTS);
+    }
+}
+
+
+static void server_find_info(link_t * p_link, uint8_t const * p_pdu)
+{
+    uint16_t start  = get16(&p_pdu[1]);
+    uint16_t end    = get16(&p_pdu[3]);
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t len    = 2;
+    uint8_t  format = 0;
+    uint32_t handle;
+
+    if ((start == 0) || (start > end))
+    {
+        att_error_send(p_link, SIM_ATT_FIND_INFO_REQ, start, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE);
+        return;
+    }
+    for (handle = start; (handle <= end) && (handle <= m_ble.attr_count); handle++)
+    {
+        uint8_t uuid[16];
+        uint8_t uuid_len = uuid_encode(&attr_get(handle)->type, uuid);
+        uint8_t f        = (uuid_len == 2) ? 1 : 2;
+
+        if (((format != 0) && (f != format)) || (len + 2 + uuid_len > SIM_BLE_ATT_MTU))
+        {
+            break;
+        }
+        format = f;
+        put16(&rsp[len], handle);
+        memcpy(&rsp[len + 2], uuid, uuid_len);
+        len += 2 + uuid_len;
+    }
+    if (format == 0)
+    {
+        att_error_send(p_link, SIM_ATT_FIND_INFO_REQ, start, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND);
+        return;
+    }
+    rsp[0] = SIM_ATT_FIND_INFO_RSP;
+    rsp[1] = format;
+    device_send(p_link, rsp, len, false);
+}
+
+
+/**@brief Function for getting the last handle of the service of a declaration: 0xFFFF for the
+ *        last service, as the SoftDevice reports it.
+ */
+static uint16_t service_end(uint16_t decl_handle)
+{
+    uint16_t handle;
+
+    for (handle = decl_handle + 1; handle <= m_ble.attr_count; handle++)
+    {
+        if (attr_get(handle)->srvc_handle == handle)
+        {
+            return handle - 1;
+        }
+    }
+    return 0xFFFF;
+}
+
+
+static bool is_service_decl(attr_t const * p_attr, bool primary_only)
+{
+    return (p_attr->kind == BLE_GATTS_ATTR_TYPE_PRIM_SRVC_DECL) ||
+           (!primary_only && (p_attr->kind == BLE_GATTS_ATTR_TYPE_SEC_SRVC_DECL));
+}
+
+
+static void server_find_by_type(link_t * p_link, uint8_t const * p_pdu, uint16_t pdu_len)
+{
+    uint16_t start = get16(&p_pdu[1]);
+    uint16_t end   = get16(&p_pdu[3]);
+    uint16_t type  = get16(&p_pdu[5]);
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t len   = 1;
+    uint32_t handle;
+
+    if ((start == 0) || (start > end))
+    {
+        att_error_send(p_link, SIM_ATT_FIND_BY_TYPE_REQ, start, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE);
+        return;
+    }
+    for (handle = start; (handle <= end) && (handle <= m_ble.attr_count); handle++)
+    {
+        attr_t const * p_attr = attr_get(handle);
+
+        if ((type != BLE_UUID_SERVICE_PRIMARY) || !is_service_decl(p_attr, true) ||
+            (p_attr->len != pdu_len - 7) || (memcmp(p_attr->p_value, &p_pdu[7], p_attr->len) != 0))
+        {
+            continue;
+        }
+        if (len + 4 > SIM_BLE_ATT_MTU)
+        {
+            break;
+        }
+        put16(&rsp[len], handle);
+        put16(&rsp[len + 2], service_end(handle));
+        len += 4;
+    }
+    if (len == 1)
+    {
+        att_error_send(p_link, SIM_ATT_FIND_BY_TYPE_REQ, start, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND);
+        return;
+    }
+    rsp[0] = SIM_ATT_FIND_BY_TYPE_RSP;
+    device_send(p_link, rsp, len, false);
+}
+
+
+/**@brief Function for answering Read By Type and Read By Group Type requests. */
+static void server_read_by_type(link_t * p_link, uint8_t const * p_pdu, uint16_t pdu_len)
+{
+    uint8_t  req        = p_pdu[0];
+    bool     group      = (req == SIM_ATT_READ_BY_GROUP_REQ);
+    uint16_t start      = get16(&p_pdu[1]);
+    uint16_t end        = get16(&p_pdu[3]);
+    uint8_t  type_len   = (uint8_t)(pdu_len - 5);
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t len        = 2;
+    uint8_t  entry_len  = 0;
+    uint32_t handle;
+
+    if ((start == 0) || (start > end) || ((type_len != 2) && (type_len != 16)))
+    {
+        att_error_send(p_link, req, start, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE);
+        return;
+    }
+    if (group && ((type_len != 2) || (get16(&p_pdu[5]) != BLE_UUID_SERVICE_PRIMARY)))
+    {
+        att_error_send(p_link, req, start, BLE_GATT_STATUS_ATTERR_UNSUPPORTED_GROUP_TYPE);
+        return;
+    }
+
+    for (handle = start; (handle <= end) && (handle <= m_ble.attr_count); handle++)
+    {
+        attr_t const  * p_attr = attr_get(handle);
+        uint8_t         uuid[16] = {0};
+        uint8_t         uuid_len = uuid_encode(&p_attr->type, uuid);
+        uint8_t const * p_value;
+        uint16_t        value_len;
+        uint16_t        status;
+        uint8_t         head = group ? 4 : 2;
+
+        if (!uuid_bytes_equal(uuid, uuid_len, &p_pdu[5], type_len))
+        {
+            continue;
+        }
+
+        status = perm_check(p_link, p_attr->read_perm, false);
+        if ((status == 0) && p_attr->rd_auth)
+        {
+            status = BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED;
+        }
+        if (status != 0)
+        {
+            if (entry_len == 0)
+            {
+                att_error_send(p_link, req, handle, status);
+                return;
+            }
+            break;
+        }
+        if ((p_attr->cccd >= 0) && !p_link->sys_attr_known)
+        {
+            request_hold(p_link, HELD_SYS_ATTR, p_pdu, pdu_len);
+            return;
+        }
+
+        attr_value(p_link, p_attr, &p_value, &value_len);
+        if (value_len > SIM_BLE_ATT_MTU - 2 - head)
+        {
+            value_len = SIM_BLE_ATT_MTU - 2 - head;
+        }
+        if (entry_len == 0)
+        {
+            entry_len = (uint8_t)(head + value_len);
+        }
+        else if ((head + value_len != entry_len) || (len + entry_len > SIM_BLE_ATT_MTU))
+        {
+            break;
+        }
+
+        put16(&rsp[len], handle);
+        if (group)
+        {
+            put16(&rsp[len + 2], service_end(handle));
+        }
+        memcpy(&rsp[len + head], p_value, value_len);
+        len += entry_len;
+        if (group)
+        {
+            handle = service_end(handle);
+        }
+    }
+    if (entry_len == 0)
+    {
+        att_error_send(p_link, req, start, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND);
+        return;
+    }
+    rsp[0] = (uint8_t)(req + 1);
+    rsp[1] = entry_len;
+    device_send(p_link, rsp, len, false);
+}
+
+
+static void read_rsp_send(link_t * p_link, uint8_t req, attr_t const * p_attr, uint16_t offset)
+{
+    uint8_t         rsp[SIM_BLE_ATT_MTU];
+    uint8_t const * p_value;
+    uint16_t        value_len;
+
+    attr_value(p_link, p_attr, &p_value, &value_len);
+    if (offset > value_len)
+    {
+        att_error_send(p_link, req, (uint16_t)(p_attr - m_ble.attrs + 1), BLE_GATT_STATUS_ATTERR_INVALID_OFFSET);
+        return;
+    }
+    value_len -= offset;
+    if (value_len > SIM_BLE_ATT_MTU - 1)
+    {
+        value_len = SIM_BLE_ATT_MTU - 1;
+    }
+    rsp[0] = (uint8_t)(req + 1);
+    memcpy(&rsp[1], p_value + offset, value_len);
+    device_send(p_link, rsp, 1 + value_len, false);
+}
+
+
+static void server_read(link_t * p_link, uint8_t const * p_pdu, uint16_t pdu_len)
+{
+    uint8_t        req    = p_pdu[0];
+    uint16_t       handle = get16(&p_pdu[1]);
+    uint16_t       offset = (req == SIM_ATT_READ_BLOB_REQ) ? get16(&p_pdu[3]) : 0;
+    attr_t const * p_attr = attr_get(handle);
+    uint16_t       status;
+
+    if (p_attr == NULL)
+    {
+        att_error_send(p_link, req, handle, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE);
+        return;
+    }
+    status = perm_check(p_link, p_attr->read_perm, false);
+    if (status != 0)
+    {
+        att_error_send(p_link, req, handle, status);
+        return;
+    }
+    if ((p_attr->cccd >= 0) && !p_link->sys_attr_known)
+    {
+        request_hold(p_link, HELD_SYS_ATTR, p_pdu, pdu_len);
+        return;
+    }
+    if (p_attr->rd_auth)
+    {
+        ble_evt_t                            * p_evt = evt_new(BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST);
+        ble_gatts_evt_rw_authorize_request_t * p_req = &p_evt->evt.gatts_evt.params.authorize_request;
+
+        request_hold(p_link, HELD_AUTH, p_pdu, pdu_len);
+        p_evt->evt.gatts_evt.conn_handle = link_handle(p_link);
+        p_req->type                = BLE_GATTS_AUTHORIZE_TYPE_READ;
+        p_req->request.read.handle = handle;
+        p_req->request.read.offset = offset;
+        attr_context(p_attr, &p_req->request.read.context);
+        evt_push(p_evt, EVT_SIZE_GATTS);
+        return;
+    }
+    read_rsp_send(p_link, req, p_attr, offset);
+}
+
+
+static void server_read_multi(link_t * p_link, uint8_t const * p_pdu, uint16_t pdu_len)
+{
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t len = 1;
+    uint16_t i;
+
+    for (i = 1; i + 1 < pdu_len; i += 2)
+    {
+        uint16_t        handle = get16(&p_pdu[i]);
+        attr_t const  * p_attr = attr_get(handle);
+        uint8_t const * p_value;
+        uint16_t        value_len;
+        uint16_t        status;
+
+        if (p_attr == NULL)
+        {
+            att_error_send(p_link, SIM_ATT_READ_MULTI_REQ, handle, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE);
+            return;
+        }
+        status = perm_check(p_link, p_attr->read_perm, false);
+        if ((status == 0) && p_attr->rd_auth)
+        {
+            status = BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED;
+        }
+        if (status != 0)
+        {
+            att_error_send(p_link, SIM_ATT_READ_MULTI_REQ, handle, status);
+            return;
+        }
+        if ((p_attr->cccd >= 0) && !p_link->sys_attr_known)
+        {
+            request_hold(p_link, HELD_SYS_ATTR, p_pdu, pdu_len);
+            return;
+        }
+        attr_value(p_link, p_attr, &p_value, &value_len);
+        if (len + value_len > SIM_BLE_ATT_MTU)
+        {
+            value_len = SIM_BLE_ATT_MTU - len;
+        }
+        memcpy(&rsp[len], p_value, value_len);
+        len += value_len;
+    }
+    rsp[0] = SIM_ATT_READ_MULTI_RSP;
+    device_send(p_link, rsp, len, false);
+}
+
+
+/**@brief Function for applying a write of a central to an attribute, with its event. */
+static void attr_write(link_t * p_link, attr_t * p_attr, uint8_t op, uint8_t const * p_data, uint16_t len)
+{
+    ble_evt_t             * p_evt  = evt_new(BLE_GATTS_EVT_WRITE);
+    ble_gatts_evt_write_t * p_write = &p_evt->evt.gatts_evt.params.write;
+    uint16_t                handle  = (uint16_t)(p_attr - m_ble.attrs + 1);
+
+    if (p_attr->cccd >= 0)
+    {
+        p_link->cccds[(uint8_t)p_attr->cccd] = get16(p_data);
+    }
+    else
+    {
+        memcpy(p_attr->p_value, p_data, len);
+        if (p_attr->vlen || (len > p_attr->len))
+        {
+            p_attr->len = len;
+        }
+    }
+
+    p_evt->evt.gatts_evt.conn_handle = link_handle(p_link);
+    p_write->handle = handle;
+    p_write->op     = op;
+    p_write->offset = 0;
+    p_write->len    = len;
+    attr_context(p_attr, &p_write->context);
+    memcpy(p_write->data, p_data, len);
+    evt_push(p_evt, EVT_SIZE_AT(evt.gatts_evt.params.write.data, len));
+}
+
+
+static void server_write(link_t * p_link, uint8_t const * p_pdu, uint16_t pdu_len)
+{
+    uint8_t  req    = p_pdu[0];
+    bool     cmd    = (req == SIM_ATT_WRITE_CMD);
+    uint16_t handle = get16(&p_pdu[1]);
+    uint16_t len    = pdu_len - 3;
+    attr_t * p_attr = attr_get(handle);
+    uint16_t status;
+
+    if (p_attr == NULL)
+    {
+        status = BLE_GATT_STATUS_ATTERR_INVALID_HANDLE;
+    }
+    else
+    {
+        status = perm_check(p_link, p_attr->write_perm, true);
+        if ((status == 0) && ((len > p_attr->max_len) || ((p_attr->cccd >= 0) && (len != 2))))
+        {
+            status = BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+        }
+    }
+    if (status != 0)
+    {
+        // Commands get no answer, errors included.
+        if (!cmd)
+        {
+            att_error_send(p_link, req, handle, status);
+        }
+        return;
+    }
+
+    if ((p_attr->cccd >= 0) && !p_link->sys_attr_known)
+    {
+        request_hold(p_link, HELD_SYS_ATTR, p_pdu, pdu_len);
+        return;
+    }
+    if (p_attr->wr_auth && !cmd)
+    {
+        ble_evt_t                            * p_evt = evt_new(BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST);
+        ble_gatts_evt_rw_authorize_request_t * p_req = &p_evt->evt.gatts_evt.params.authorize_request;
+
+        request_hold(p_link, HELD_AUTH, p_pdu, pdu_len);
+        p_evt->evt.gatts_evt.conn_handle = link_handle(p_link);
+        p_req->type                 = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+        p_req->request.write.handle = handle;
+        p_req->request.write.op     = BLE_GATTS_OP_WRITE_REQ;
+        p_req->request.write.len    = len;
+        attr_context(p_attr, &p_req->request.write.context);
+        memcpy(p_req->request.write.data, &p_pdu[3], len);
+        evt_push(p_evt, EVT_SIZE_AT(evt.gatts_evt.params.authorize_request.request.write.data, len));
+        return;
+    }
+    if (p_attr->wr_auth)
+    {
+        // Commands to an attribute that needs authorization are dropped.
+        return;
+    }
+
+    attr_write(p_link, p_attr, cmd ? BLE_GATTS_OP_WRITE_CMD : BLE_GATTS_OP_WRITE_REQ, &p_pdu[3], len);
+    if (!cmd)
+    {
+        uint8_t rsp = SIM_ATT_WRITE_RSP;
+
+        device_send(p_link, &rsp, 1, false);
+    }
+}
+
+
+static void server_confirm(link_t * p_link)
+{
+    ble_evt_t * p_evt;
+    uint16_t    handle = p_link->hvi_handle;
+
+    if (handle == 0)
+    {
+        return;
+    }
+    p_link->hvi_handle = 0;
+
+    p_evt = evt_new((handle == m_ble.sc_handle) ? BLE_GATTS_EVT_SC_CONFIRM : BLE_GATTS_EVT_HVC);
+    p_evt->evt.gatts_evt.conn_handle    = link_handle(p_link);
+    p_evt->evt.gatts_evt.params.hvc.handle = handle;
+    evt_push(p_evt, EVT_SIZE_GATTS);
+}
+
+
+/**@brief Function for handling a request or command of a central to the GATT server. */
+static void server_request(link_t * p_link, uint8_t const * p_pdu, uint16_t len)
+{
+    uint8_t op = p_pdu[0];
+
+    if ((p_link->held != HELD_NONE) && !(op & SIM_ATT_CMD_FLAG))
+    {
+        // A central waits for the answer to a request before the next one.
+        fprintf(stderr, "sim: ATT request 0x%02x while another is pending, dropped\n", op);
+        return;
+    }
+
+    switch (op)
+    {
+        case SIM_ATT_MTU_REQ:
+        {
+            uint8_t rsp[3] = {SIM_ATT_MTU_RSP};
+
+            put16(&rsp[1], SIM_BLE_ATT_MTU);
+            device_send(p_link, rsp, sizeof(rsp), false);
+            break;
+        }
+
+        case SIM_ATT_FIND_INFO_REQ:
+            if (len == 5)
+            {
+                server_find_info(p_link, p_pdu);
+                return;
+            }
+            break;
+
+        case SIM_ATT_FIND_BY_TYPE_REQ:
+            if (len >= 7)
+            {
+                server_find_by_type(p_link, p_pdu, len);
+                return;
+            }
+            break;
+
+        case SIM_ATT_READ_BY_TYPE_REQ:
+        case SIM_ATT_READ_BY_GROUP_REQ:
+            if ((len == 7) || (len == 21))
+            {
+                server_read_by_type(p_link, p_pdu, len);
+                return;
+            }
+            break;
+
+        case SIM_ATT_READ_REQ:
+        case SIM_ATT_READ_BLOB_REQ:
+            if (len == ((op == SIM_ATT_READ_REQ) ? 3 : 5))
+            {
+                server_read(p_link, p_pdu, len);
+                return;
+            }
+            break;
+
+        case SIM_ATT_READ_MULTI_REQ:
+            if ((len >= 5) && ((len & 1) != 0))
+            {
+                server_read_multi(p_link, p_pdu, len);
+                return;
+            }
+            break;
+
+        case SIM_ATT_WRITE_REQ:
+        case SIM_ATT_WRITE_CMD:
+            if (len >= 3)
+            {
+                server_write(p_link, p_pdu, len);
+                return;
+            }
+            break;
+
+        case SIM_ATT_HVC:
+            server_confirm(p_link);
+            return;
+
+        default:
+            // Queued writes need user memory this model does not give.
+            if (!(op & SIM_ATT_CMD_FLAG))
+            {
+                att_error_send(p_link, op, 0, BLE_GATT_STATUS_ATTERR_REQUEST_NOT_SUPPORTED);
+            }
+            return;
+    }
+    if (op != SIM_ATT_MTU_REQ)
+    {
+        att_error_send(p_link, op, 0, BLE_GATT_STATUS_ATTERR_INVALID_PDU);
+    }
+}
+
+
+/**@brief Function for going on with a request held for the system attributes. */
+static void held_resume(link_t * p_link)
+{
+    uint8_t  pdu[SIM_BLE_ATT_MTU];
+    uint16_t len = p_link->held_len;
+
+    if (p_link->held != HELD_SYS_ATTR)
+    {
+        return;
+    }
+    memcpy(pdu, p_link->held_pdu, len);
+    p_link->held = HELD_NONE;
+    server_request(p_link, pdu, len);
+}
+
+
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle,
+                                         ble_gatts_rw_authorize_reply_params_t const * p_reply)
+{
+    link_t       * p_link = link_get(conn_handle);
+    uint8_t const * p_pdu;
+    attr_t       * p_attr;
+    uint8_t        req;
+
+    if (p_reply == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    p_pdu = p_link->held_pdu;
+    req   = p_pdu[0];
+    if ((p_link->held != HELD_AUTH) ||
+        ((p_reply->type == BLE_GATTS_AUTHORIZE_TYPE_READ) && (req == SIM_ATT_WRITE_REQ)) ||
+        ((p_reply->type == BLE_GATTS_AUTHORIZE_TYPE_WRITE) && (req != SIM_ATT_WRITE_REQ)))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    p_attr = attr_get(get16(&p_pdu[1]));
+
+    model_enter();
+    if (p_reply->type == BLE_GATTS_AUTHORIZE_TYPE_READ)
+    {
+        ble_gatts_read_authorize_params_t const * p_read = &p_reply->params.read;
+
+        if (p_read->update && (p_read->offset + p_read->len > p_attr->max_len))
+        {
+            model_exit();
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        p_link->held = HELD_NONE;
+        if (p_read->gatt_status != BLE_GATT_STATUS_SUCCESS)
+        {
+            att_error_send(p_link, req, get16(&p_pdu[1]), p_read->gatt_status);
+        }
+        else
+        {
+            if (p_read->update)
+            {
+                if (p_read->p_data != NULL)
+                {
+                    memcpy(p_attr->p_value + p_read->offset, p_read->p_data, p_read->len);
+                }
+                if (p_attr->vlen || (p_read->offset + p_read->len > p_attr->len))
+                {
+                    p_attr->len = p_read->offset + p_read->len;
+                }
+            }
+            read_rsp_send(p_link, req, p_attr, (req == SIM_ATT_READ_BLOB_REQ) ? get16(&p_pdu[3]) : 0);
+        }
+    }
+    else
+    {
+        uint8_t rsp = SIM_ATT_WRITE_RSP;
+
+        p_link->held = HELD_NONE;
+        if (p_reply->params.write.gatt_status != BLE_GATT_STATUS_SUCCESS)
+        {
+            att_error_send(p_link, req, get16(&p_pdu[1]), p_reply->params.write.gatt_status);
+        }
+        else
+        {
+            uint16_t len = p_link->held_len - 3;
+
+            memcpy(p_attr->p_value, &p_pdu[3], len);
+            if (p_attr->vlen || (len > p_attr->len))
+            {
+                p_attr->len = len;
+            }
+            device_send(p_link, &rsp, 1, false);
+        }
+    }
+    model_exit();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    link_t       * p_link = link_get(conn_handle);
+    attr_t       * p_attr;
+    attr_t const * p_cccd;
+    uint16_t       cccd;
+    uint8_t        pdu[SIM_BLE_ATT_MTU];
+    uint16_t       len;
+    bool           notification;
+
+    if (p_hvx_params == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    p_attr = attr_get(p_hvx_params->handle);
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+    p_cccd = cccd_find(p_hvx_params->handle);
+    if ((p_attr->kind != BLE_GATTS_ATTR_TYPE_CHAR_VAL) || (p_cccd == NULL))
+    {
+        return BLE_ERROR_GATTS_INVALID_ATTR_TYPE;
+    }
+    if ((p_hvx_params->type != BLE_GATT_HVX_NOTIFICATION) && (p_hvx_params->type != BLE_GATT_HVX_INDICATION))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (!p_link->sys_attr_known)
+    {
+        return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+    }
+
+    notification = (p_hvx_params->type == BLE_GATT_HVX_NOTIFICATION);
+    cccd         = p_link->cccds[(uint8_t)p_cccd->cccd];
+    if (!(cccd & (notification ? BLE_GATT_HVX_NOTIFICATION : BLE_GATT_HVX_INDICATION)))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (notification && (p_link->tx_free == 0))
+    {
+        return BLE_ERROR_NO_TX_BUFFERS;
+    }
+    if (!notification && (p_link->hvi_handle != 0))
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    // The value is updated with the data sent, if any, then sent from the offset.
+    if ((p_hvx_params->p_len != NULL) && (p_hvx_params->p_data != NULL))
+    {
+        if (p_hvx_params->offset + *p_hvx_params->p_len > p_attr->max_len)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        memcpy(p_attr->p_value + p_hvx_params->offset, p_hvx_params->p_data, *p_hvx_params->p_len);
+        if (p_attr->vlen || (p_hvx_params->offset + *p_hvx_params->p_len > p_attr->len))
+        {
+            p_attr->len = p_hvx_params->offset + *p_hvx_params->p_len;
+        }
+    }
+    len = (p_hvx_params->offset < p_attr->len) ? p_attr->len - p_hvx_params->offset : 0;
+    if (len > SIM_BLE_ATT_MTU - 3)
+    {
+        len = SIM_BLE_ATT_MTU - 3;
+    }
+
+    pdu[0] = notification ? SIM_ATT_HVN : SIM_ATT_HVI;
+    put16(&pdu[1], p_hvx_params->handle);
+    memcpy(&pdu[3], p_attr->p_value + p_hvx_params->offset, len);
+    device_send(p_link, pdu, 3 + len, notification);
+    if (notification)
+    {
+        p_link->tx_free--;
+    }
+    else
+    {
+        p_link->hvi_handle = p_hvx_params->handle;
+    }
+    if (p_hvx_params->p_len != NULL)
+    {
+        *p_hvx_params->p_len = len;
+    }
+    m_stats.notifications++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_service_changed(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle)
+{
+    link_t  * p_link = link_get(conn_handle);
+    uint8_t   value[4];
+    uint16_t  len = sizeof(value);
+    ble_gatts_hvx_params_t hvx;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (m_ble.sc_handle == 0)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+    if ((start_handle == 0) || (start_handle > end_handle))
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+
+    put16(&value[0], start_handle);
+    put16(&value[2], end_handle);
+    memset(&hvx, 0, sizeof(hvx));
+    hvx.handle = m_ble.sc_handle;
+    hvx.type   = BLE_GATT_HVX_INDICATION;
+    hvx.p_len  = &len;
+    hvx.p_data = value;
+    return sd_ble_gatts_hvx(conn_handle, &hvx);
+}
+
+
+/**@brief Function for checking whether a CCCD belongs to the system or the user services. */
+static bool cccd_in_scope(attr_t const * p_attr, uint32_t flags)
+{
+    bool system = (p_attr->value_handle == m_ble.sc_handle);
+
+    if ((flags & BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS) && !system)
+    {
+        return false;
+    }
+    if ((flags & BLE_GATTS_SYS_ATTR_FLAG_USR_SRVCS) && system)
+    {
+        return false;
+    }
+    return true;
+}
+
+
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, uint8_t const * p_sys_attr_data, uint16_t len,
+                                   uint32_t flags)
+{
+    link_t * p_link = link_get(conn_handle);
+    uint16_t i;
+    uint16_t offset;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    if (p_sys_attr_data == NULL)
+    {
+        for (i = 0; i < m_ble.attr_count; i++)
+        {
+            if ((m_ble.attrs[i].cccd >= 0) && cccd_in_scope(&m_ble.attrs[i], flags))
+            {
+                p_link->cccds[(uint8_t)m_ble.attrs[i].cccd] = 0;
+            }
+        }
+    }
+    else
+    {
+        // Entries of handle, length and value, then a CRC of them all.
+        if ((len < 2) || (crc16(p_sys_attr_data, len - 2) != get16(&p_sys_attr_data[len - 2])))
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        for (offset = 0; offset + 4 <= len - 2; )
+        {
+            attr_t const * p_attr    = attr_get(get16(&p_sys_attr_data[offset]));
+            uint16_t       value_len = get16(&p_sys_attr_data[offset + 2]);
+
+            if ((p_attr == NULL) || (p_attr->cccd < 0) || (value_len != 2) || (offset + 6 > len - 2))
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+            if (cccd_in_scope(p_attr, flags))
+            {
+                p_link->cccds[(uint8_t)p_attr->cccd] = get16(&p_sys_attr_data[offset + 4]);
+            }
+            offset += 6;
+        }
+    }
+
+    model_enter();
+    p_link->sys_attr_known = true;
+    held_resume(p_link);
+    model_exit();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_sys_attr_get(uint16_t conn_handle, uint8_t * p_sys_attr_data, uint16_t * p_len,
+                                   uint32_t flags)
+{
+    link_t * p_link = ((conn_handle < SIM_BLE_LINKS_MAX) && m_ble.links[conn_handle].attrs_kept)
+                      ? &m_ble.links[conn_handle] : NULL;
+    uint8_t  buf[CCCDS_MAX * 6 + 2];
+    uint16_t len = 0;
+    uint16_t i;
+
+    if (p_len == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (!p_link->sys_attr_known)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    for (i = 0; i < m_ble.attr_count; i++)
+    {
+        attr_t const * p_attr = &m_ble.attrs[i];
+
+        if ((p_attr->cccd >= 0) && cccd_in_scope(p_attr, flags))
+        {
+            put16(&buf[len], i + 1);
+            put16(&buf[len + 2], 2);
+            put16(&buf[len + 4], p_link->cccds[(uint8_t)p_attr->cccd]);
+            len += 6;
+        }
+    }
+    put16(&buf[len], crc16(buf, len));
+    len += 2;
+
+    if (p_sys_attr_data == NULL)
+    {
+        *p_len = len;
+        return NRF_SUCCESS;
+    }
+    if (*p_len < len)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    memcpy(p_sys_attr_data, buf, len);
+    *p_len = len;
+    return NRF_SUCCESS;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * GATT client: requests of the firmware and the answers of the centrals.
+ */
+
+/**@brief Function for sending a request of the GATT client, which allows one at a time. */
+static uint32_t gattc_request(uint16_t conn_handle, uint8_t const * p_pdu, uint16_t len, link_t ** pp_link)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_link->gattc_op != 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    device_send(p_link, p_pdu, len, false);
+    p_link->gattc_op = p_pdu[0];
+    m_stats.gattc_requests++;
+    if (pp_link != NULL)
+    {
+        *pp_link = p_link;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gattc_primary_services_discover(uint16_t conn_handle, uint16_t start_handle,
+                                                ble_uuid_t const * p_srvc_uuid)
+{
+    uint8_t  pdu[SIM_BLE_ATT_MTU];
+    uint8_t  len;
+    link_t * p_link;
+    uint32_t err_code;
+
+    if (start_handle == 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    put16(&pdu[1], start_handle);
+    put16(&pdu[3], 0xFFFF);
+    put16(&pdu[5], BLE_UUID_SERVICE_PRIMARY);
+    if (p_srvc_uuid == NULL)
+    {
+        pdu[0] = SIM_ATT_READ_BY_GROUP_REQ;
+        len    = 7;
+    }
+    else
+    {
+        pdu[0] = SIM_ATT_FIND_BY_TYPE_REQ;
+        len    = uuid_encode(p_srvc_uuid, &pdu[7]);
+        if (len == 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        len += 7;
+    }
+
+    err_code = gattc_request(conn_handle, pdu, len, &p_link);
+    if ((err_code == NRF_SUCCESS) && (p_srvc_uuid != NULL))
+    {
+        p_link->gattc_uuid = *p_srvc_uuid;
+    }
+    return err_code;
+}
+
+
+uint32_t sd_ble_gattc_characteristics_discover(uint16_t conn_handle,
+                                               ble_gattc_handle_range_t const * p_handle_range)
+{
+    uint8_t pdu[7];
+
+    if (p_handle_range == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if ((p_handle_range->start_handle == 0) || (p_handle_range->start_handle > p_handle_range->end_handle))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    pdu[0] = SIM_ATT_READ_BY_TYPE_REQ;
+    put16(&pdu[1], p_handle_range->start_handle);
+    put16(&pdu[3], p_handle_range->end_handle);
+    put16(&pdu[5], BLE_UUID_CHARACTERISTIC);
+    return gattc_request(conn_handle, pdu, sizeof(pdu), NULL);
+}
+
+
+uint32_t sd_ble_gattc_descriptors_discover(uint16_t conn_handle,
+                                           ble_gattc_handle_range_t const * p_handle_range)
+{
+    uint8_t pdu[5];
+
+    if (p_handle_range == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if ((p_handle_range->start_handle == 0) || (p_handle_range->start_handle > p_handle_range->end_handle))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    pdu[0] = SIM_ATT_FIND_INFO_REQ;
+    put16(&pdu[1], p_handle_range->start_handle);
+    put16(&pdu[3], p_handle_range->end_handle);
+    return gattc_request(conn_handle, pdu, sizeof(pdu), NULL);
+}
+
+
+uint32_t sd_ble_gattc_read(uint16_t conn_handle, uint16_t handle, uint16_t offset)
+{
+    uint8_t  pdu[5];
+    link_t * p_link;
+    uint32_t err_code;
+
+    if (handle == 0)
+    {
+        return BLE_ERROR_INVALID_ATTR_HANDLE;
+    }
+    pdu[0] = (offset == 0) ? SIM_ATT_READ_REQ : SIM_ATT_READ_BLOB_REQ;
+    put16(&pdu[1], handle);
+    put16(&pdu[3], offset);
+
+    err_code = gattc_request(conn_handle, pdu, (offset == 0) ? 3 : 5, &p_link);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_link->gattc_handle = handle;
+        p_link->gattc_offset = offset;
+    }
+    return err_code;
+}
+
+
+uint32_t sd_ble_gattc_char_values_read(uint16_t conn_handle, uint16_t const * p_handles, uint16_t handle_count)
+{
+    uint8_t  pdu[SIM_BLE_ATT_MTU];
+    uint16_t i;
+
+    if (p_handles == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if ((handle_count < 2) || (1 + 2 * handle_count > SIM_BLE_ATT_MTU))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    pdu[0] = SIM_ATT_READ_MULTI_REQ;
+    for (i = 0; i < handle_count; i++)
+    {
+        if (p_handles[i] == 0)
+        {
+            return BLE_ERROR_INVALID_ATTR_HANDLE;
+        }
+        put16(&pdu[1 + 2 * i], p_handles[i]);
+    }
+    return gattc_request(conn_handle, pdu, 1 + 2 * handle_count, NULL);
+}
+
+
+uint32_t sd_ble_gattc_write(uint16_t conn_handle, ble_gattc_write_params_t const * p_write_params)
+{
+    uint8_t  pdu[SIM_BLE_ATT_MTU];
+    uint16_t len;
+    link_t * p_link = link_get(conn_handle);
+    uint32_t err_code;
+
+    if (p_write_params == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((p_write_params->len > 0) && (p_write_params->p_value == NULL))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    switch (p_write_params->write_op)
+    {
+        case BLE_GATT_OP_WRITE_CMD:
+            if (p_write_params->len > SIM_BLE_ATT_MTU - 3)
+            {
+                return NRF_ERROR_DATA_SIZE;
+            }
+            if (p_link->tx_free == 0)
+            {
+                return BLE_ERROR_NO_TX_BUFFERS;
+            }
+            pdu[0] = SIM_ATT_WRITE_CMD;
+            put16(&pdu[1], p_write_params->handle);
+            memcpy(&pdu[3], p_write_params->p_value, p_write_params->len);
+            device_send(p_link, pdu, 3 + p_write_params->len, true);
+            p_link->tx_free--;
+            return NRF_SUCCESS;
+
+        case BLE_GATT_OP_WRITE_REQ:
+            if (p_write_params->len > SIM_BLE_ATT_MTU - 3)
+            {
+                return NRF_ERROR_DATA_SIZE;
+            }
+            pdu[0] = SIM_ATT_WRITE_REQ;
+            put16(&pdu[1], p_write_params->handle);
+            memcpy(&pdu[3], p_write_params->p_value, p_write_params->len);
+            len = 3 + p_write_params->len;
+            break;
+
+        case BLE_GATT_OP_PREP_WRITE_REQ:
+            if (p_write_params->len > SIM_BLE_ATT_MTU - 5)
+            {
+                return NRF_ERROR_DATA_SIZE;
+            }
+            pdu[0] = SIM_ATT_PREP_WRITE_REQ;
+            put16(&pdu[1], p_write_params->handle);
+            put16(&pdu[3], p_write_params->offset);
+            memcpy(&pdu[5], p_write_params->p_value, p_write_params->len);
+            len = 5 + p_write_params->len;
+            break;
+
+        case BLE_GATT_OP_EXEC_WRITE_REQ:
+            pdu[0] = SIM_ATT_EXEC_WRITE_REQ;
+            pdu[1] = p_write_params->flags;
+            len    = 2;
+            break;
+
+        default:
+            return NRF_ERROR_INVALID_PARAM;
+    }
+
+    err_code = gattc_request(conn_handle, pdu, len, NULL);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_link->gattc_write_op = p_write_params->write_op;
+        p_link->gattc_handle   = p_write_params->handle;
+        p_link->gattc_offset   = p_write_params->offset;
+        p_link->gattc_len      = p_write_params->len;
+        memcpy(p_link->gattc_data, p_write_params->p_value, p_write_params->len);
+    }
+    return err_code;
+}
+
+
+static ble_evt_t * gattc_evt_new(link_t const * p_link, uint16_t evt_id, uint16_t status, uint16_t error_handle)
+{
+    ble_evt_t * p_evt = evt_new(evt_id);
+
+    p_evt->evt.gattc_evt.conn_handle  = link_handle(p_link);
+    p_evt->evt.gattc_evt.gatt_status  = status;
+    p_evt->evt.gattc_evt.error_handle = error_handle;
+    return p_evt;
+}
+
+
+static void props_decode(uint8_t props, ble_gatt_char_props_t * p_props)
+{
+    p_props->broadcast      = (props >> 0) & 1;
+    p_props->read           = (props >> 1) & 1;
+    p_props->write_wo_resp  = (props >> 2) & 1;
+    p_props->write          = (props >> 3) & 1;
+    p_props->notify         = (props >> 4) & 1;
+    p_props->indicate       = (props >> 5) & 1;
+    p_props->auth_signed_wr = (props >> 6) & 1;
+}
+
+
+/**@brief Function for turning the answer of a central to a request of the GATT client into the
+ *        event of the procedure.
+ */
+static void gattc_response(link_t * p_link, uint8_t const * p_pdu, uint16_t len)
+{
+    uint8_t     req          = p_link->gattc_op;
+    uint16_t    status       = BLE_GATT_STATUS_SUCCESS;
+    uint16_t    error_handle = 0;
+    ble_evt_t * p_evt;
+    uint16_t    count        = 0;
+    uint16_t    i;
+
+    if (req == 0)
+    {
+        return;
+    }
+    if (p_pdu[0] == SIM_ATT_ERROR_RSP)
+    {
+        if ((len != 5) || (p_pdu[1] != req))
+        {
+            return;
+        }
+        status       = 0x0100 | p_pdu[4];
+        error_handle = get16(&p_pdu[2]);
+    }
+    else if (p_pdu[0] != req + 1)
+    {
+        return;
+    }
+    p_link->gattc_op = 0;
+
+    switch (req)
+    {
+        case SIM_ATT_FIND_BY_TYPE_REQ:
+        case SIM_ATT_READ_BY_GROUP_REQ:
+        {
+            ble_gattc_evt_prim_srvc_disc_rsp_t * p_rsp;
+
+            p_evt = gattc_evt_new(p_link, BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP, status, error_handle);
+            p_rsp = &p_evt->evt.gattc_evt.params.prim_srvc_disc_rsp;
+            if ((status == BLE_GATT_STATUS_SUCCESS) && (req == SIM_ATT_FIND_BY_TYPE_REQ))
+            {
+                for (i = 1; i + 4 <= len; i += 4, count++)
+                {
+                    p_rsp->services[count].uuid                      = p_link->gattc_uuid;
+                    p_rsp->services[count].handle_range.start_handle = get16(&p_pdu[i]);
+                    p_rsp->services[count].handle_range.end_handle   = get16(&p_pdu[i + 2]);
+                }
+            }
+            else if (status == BLE_GATT_STATUS_SUCCESS)
+            {
+                uint8_t entry_len = p_pdu[1];
+
+                for (i = 2; (entry_len > 4) && (i + entry_len <= len); i += entry_len, count++)
+                {
+                    p_rsp->services[count].handle_range.start_handle = get16(&p_pdu[i]);
+                    p_rsp->services[count].handle_range.end_handle   = get16(&p_pdu[i + 2]);
+                    uuid_decode(&p_pdu[i + 4], entry_len - 4, &p_rsp->services[count].uuid);
+                }
+            }
+            p_rsp->count = count;
+            evt_push(p_evt, EVT_SIZE_AT(evt.gattc_evt.params.prim_srvc_disc_rsp.services,
+                                        count * sizeof(ble_gattc_service_t)));
+            break;
+        }
+
+        case SIM_ATT_READ_BY_TYPE_REQ:
+        {
+            ble_gattc_evt_char_disc_rsp_t * p_rsp;
+            uint8_t                         entry_len = (len > 1) ? p_pdu[1] : 0;
+
+            p_evt = gattc_evt_new(p_link, BLE_GATTC_EVT_CHAR_DISC_RSP, status, error_handle);
+            p_rsp = &p_evt->evt.gattc_evt.params.char_disc_rsp;
+            for (i = 2; (status == BLE_GATT_STATUS_SUCCESS) && (entry_len > 5) && (i + entry_len <= len);
+                 i += entry_len, count++)
+            {
+                p_rsp->chars[count].handle_decl  = get16(&p_pdu[i]);
+                props_decode(p_pdu[i + 2], &p_rsp->chars[count].char_props);
+                p_rsp->chars[count].char_ext_props = (p_pdu[i + 2] >> 7) & 1;
+                p_rsp->chars[count].handle_value = get16(&p_pdu[i + 3]);
+                uuid_decode(&p_pdu[i + 5], entry_len - 5, &p_rsp->chars[count].uuid);
+            }
+            p_rsp->count = count;
+            evt_push(p_evt, EVT_SIZE_AT(evt.gattc_evt.params.char_disc_rsp.chars,
+                                        count * sizeof(ble_gattc_char_t)));
+            break;
+        }
+
+        case SIM_ATT_FIND_INFO_REQ:
+        {
+            ble_gattc_evt_desc_disc_rsp_t * p_rsp;
+            uint8_t                         uuid_len = ((len > 1) && (p_pdu[1] == 2)) ? 16 : 2;
+
+            p_evt = gattc_evt_new(p_link, BLE_GATTC_EVT_DESC_DISC_RSP, status, error_handle);
+            p_rsp = &p_evt->evt.gattc_evt.params.desc_disc_rsp;
+            for (i = 2; (status == BLE_GATT_STATUS_SUCCESS) && (i + 2 + uuid_len <= len); i += 2 + uuid_len, count++)
+            {
+                p_rsp->descs[count].handle = get16(&p_pdu[i]);
+                uuid_decode(&p_pdu[i + 2], uuid_len, &p_rsp->descs[count].uuid);
+            }
+            p_rsp->count = count;
+            evt_push(p_evt, EVT_SIZE_AT(evt.gattc_evt.params.desc_disc_rsp.descs,
+                                        count * sizeof(ble_gattc_desc_t)));
+            break;
+        }
+
+        case SIM_ATT_READ_REQ:
+        case SIM_ATT_READ_BLOB_REQ:
+        {
+            ble_gattc_evt_read_rsp_t * p_rsp;
+            uint16_t                   value_len = (status == BLE_GATT_STATUS_SUCCESS) ? len - 1 : 0;
+
+            p_evt = gattc_evt_new(p_link, BLE_GATTC_EVT_READ_RSP, status, error_handle);
+            p_rsp = &p_evt->evt.gattc_evt.params.read_rsp;
+            p_rsp->handle = p_link->gattc_handle;
+            p_rsp->offset = p_link->gattc_offset;
+            p_rsp->len    = value_len;
+            memcpy(p_rsp->data, &p_pdu[1], value_len);
+            evt_push(p_evt, EVT_SIZE_AT(evt.gattc_evt.params.read_rsp.data, value_len));
+            break;
+        }
+
+        case SIM_ATT_READ_MULTI_REQ:
+        {
+            ble_gattc_evt_char_vals_read_rsp_t * p_rsp;
+            uint16_t                             value_len = (status == BLE_GATT_STATUS_SUCCESS) ? len - 1 : 0;
+
+            p_evt = gattc_evt_new(p_link, BLE_GATTC_EVT_CHAR_VALS_READ_RSP, status, error_handle);
+            p_rsp = &p_evt->evt.gattc_evt.params.char_vals_read_rsp;
+            p_rsp->len = value_len;
+            memcpy(p_rsp->values, &p_pdu[1], value_len);
+            evt_push(p_evt, EVT_SIZE_AT(evt.gattc_evt.params.char_vals_read_rsp.values, value_len));
+            break;
+        }
+
+        case SIM_ATT_WRITE_REQ:
+        case SIM_ATT_PREP_WRITE_REQ:
+        case SIM_ATT_EXEC_WRITE_REQ:
+        {
+            ble_gattc_evt_write_rsp_t * p_rsp;
+            uint16_t                    value_len = (req == SIM_ATT_EXEC_WRITE_REQ) ? 0 : p_link->gattc_len;
+
+            p_evt = gattc_evt_new(p_link, BLE_GATTC_EVT_WRITE_RSP, status, error_handle);
+            p_rsp = &p_evt->evt.gattc_evt.params.write_rsp;
+            p_rsp->handle   = (req == SIM_ATT_EXEC_WRITE_REQ) ? 0 : p_link->gattc_handle;
+            p_rsp->write_op = p_link->gattc_write_op;
+            p_rsp->offset   = p_link->gattc_offset;
+            p_rsp->len      = value_len;
+            memcpy(p_rsp->data, p_link->gattc_data, value_len);
+            evt_push(p_evt, EVT_SIZE_AT(evt.gattc_evt.params.write_rsp.data, value_len));
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+static void gattc_hvx(link_t * p_link, uint8_t const * p_pdu, uint16_t len)
+{
+    ble_evt_t           * p_evt = gattc_evt_new(p_link, BLE_GATTC_EVT_HVX, BLE_GATT_STATUS_SUCCESS, 0);
+    ble_gattc_evt_hvx_t * p_hvx = &p_evt->evt.gattc_evt.params.hvx;
+
+    if (len < 3)
+    {
+        return;
+    }
+    p_hvx->handle = get16(&p_pdu[1]);
+    p_hvx->type   = (p_pdu[0] == SIM_ATT_HVN) ? BLE_GATT_HVX_NOTIFICATION : BLE_GATT_HVX_INDICATION;
+    p_hvx->len    = len - 3;
+    memcpy(p_hvx->data, &p_pdu[3], len - 3);
+    evt_push(p_evt, EVT_SIZE_AT(evt.gattc_evt.params.hvx.data, len - 3));
+}
+
+
+/**@brief Function for handling a PDU from a central. */
+static void device_receive(link_t * p_link, uint8_t const * p_pdu, uint16_t len)
+{
+    m_stats.pdus_to_device++;
+
+    switch (p_pdu[0])
+    {
+        case SIM_ATT_ERROR_RSP:
+        case SIM_ATT_MTU_RSP:
+        case SIM_ATT_FIND_INFO_RSP:
+        case SIM_ATT_FIND_BY_TYPE_RSP:
+        case SIM_ATT_READ_BY_TYPE_RSP:
+        case SIM_ATT_READ_RSP:
+        case SIM_ATT_READ_BLOB_RSP:
+        case SIM_ATT_READ_MULTI_RSP:
+        case SIM_ATT_READ_BY_GROUP_RSP:
+        case SIM_ATT_WRITE_RSP:
+        case SIM_ATT_PREP_WRITE_RSP:
+        case SIM_ATT_EXEC_WRITE_RSP:
+            gattc_response(p_link, p_pdu, len);
+            break;
+
+        case SIM_ATT_HVN:
+        case SIM_ATT_HVI:
+            gattc_hvx(p_link, p_pdu, len);
+            break;
+
+        default:
+            server_request(p_link, p_pdu, len);
+            break;
+    }
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Radio. Events reserve the radio ahead of their start; the radio notification follows the first
+ * reservation and the end of the last one, so active and inactive alternate.
+ */
+
+static uint64_t radio_lead(void)
+{
+    return sim_soc_radio_notification_distance();
+}
+
+
+static bool radio_acquire(uint64_t start, uint64_t end)
+{
+    if (start < m_ble.radio_free)
+    {
+        return false;
+    }
+    m_ble.radio_free = end;
+    if (m_ble.radio_holders++ == 0)
+    {
+        sim_soc_radio_notify(true);
+    }
+    return true;
+}
+
+
+static void radio_release(void)
+{
+    if ((m_ble.radio_holders > 0) && (--m_ble.radio_holders == 0))
+    {
+        sim_soc_radio_notify(false);
+    }
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Links: connection events and the procedures carried by them.
+ */
+
+static void central_evt_send(sim_ble_central_t * p_central, sim_ble_central_evt_type_t type,
+                             uint8_t reason, bool paired)
+{
+    sim_ble_central_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.type   = type;
+    evt.reason = reason;
+    evt.paired = paired;
+    if (p_central->evt_handler != NULL)
+    {
+        p_central->evt_handler(p_central, &evt);
+    }
+}
+
+
+static void conn_prepare(void * p_context);
+
+
+static void conn_schedule(link_t * p_link)
+{
+    uint64_t lead = radio_lead();
+    uint64_t at   = (p_link->anchor > lead) ? p_link->anchor - lead : 0;
+
+    p_link->prepare_id = sim_at(at, SIM_OWNER_DEVICE, conn_prepare, p_link);
+}
+
+
+static void link_close(link_t * p_link, uint8_t device_reason, uint8_t central_reason)
+{
+    sim_ble_central_t * p_central = p_link->p_central;
+    uint16_t            conn_handle = link_handle(p_link);
+    ble_gap_evt_disconnected_t disconnected;
+
+    sim_cancel(p_link->prepare_id);
+
+    // Keeps what sd_ble_gatts_sys_attr_get() reads on the disconnection event.
+    p_link->connected  = false;
+    p_link->attrs_kept = true;
+    m_stats.disconnections++;
+
+    disconnected.reason = device_reason;
+    gap_evt_push(BLE_GAP_EVT_DISCONNECTED, conn_handle, &disconnected, sizeof(disconnected));
+
+    p_central->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_central->encrypted   = false;
+    central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_DISCONNECTED, central_reason, false);
+}
+
+
+static void keys_distribute(link_t * p_link)
+{
+    sim_ble_central_t   * p_central = p_link->p_central;
+    ble_gap_sec_kdist_t   kdist_periph;
+    ble_gap_sec_kdist_t   kdist_central;
+    ble_gap_evt_auth_status_t auth;
+    uint32_t              i;
+
+    memset(&kdist_periph, 0, sizeof(kdist_periph));
+    memset(&kdist_central, 0, sizeof(kdist_central));
+    kdist_periph.enc  = p_link->sec_own.kdist_periph.enc && p_link->sec_peer.kdist_periph.enc;
+    kdist_periph.id   = p_link->sec_own.kdist_periph.id && p_link->sec_peer.kdist_periph.id;
+    kdist_central.id  = p_link->sec_own.kdist_central.id && p_link->sec_peer.kdist_central.id;
+
+    if (kdist_periph.enc)
+    {
+        ble_gap_enc_key_t key;
+
+        memset(&key, 0, sizeof(key));
+        for (i = 0; i < BLE_GAP_SEC_KEY_LEN; i++)
+        {
+            key.enc_info.ltk[i] = (uint8_t)sim_rand();
+        }
+        key.enc_info.ltk_len = BLE_GAP_SEC_KEY_LEN;
+        key.master_id.ediv   = (uint16_t)sim_rand();
+        for (i = 0; i < BLE_GAP_SEC_RAND_LEN; i++)
+        {
+            key.master_id.rand[i] = (uint8_t)sim_rand();
+        }
+        if (p_link->keyset.keys_periph.p_enc_key != NULL)
+        {
+            *p_link->keyset.keys_periph.p_enc_key = key;
+        }
+        if (p_link->sec_bond)
+        {
+            p_central->bond.valid     = true;
+            p_central->bond.enc_info  = key.enc_info;
+            p_central->bond.master_id = key.master_id;
+        }
+    }
+    if (kdist_periph.id && (p_link->keyset.keys_periph.p_id_key != NULL))
+    {
+        memset(p_link->keyset.keys_periph.p_id_key, 0, sizeof(ble_gap_id_key_t));
+        (void)sd_ble_gap_address_get(&p_link->keyset.keys_periph.p_id_key->id_addr_info);
+    }
+    if (kdist_central.id && (p_link->keyset.keys_central.p_id_key != NULL))
+    {
+        p_link->keyset.keys_central.p_id_key->id_info      = p_central->irk;
+        p_link->keyset.keys_central.p_id_key->id_addr_info = p_central->id_addr;
+    }
+
+    memset(&auth, 0, sizeof(auth));
+    auth.auth_status    = BLE_GAP_SEC_STATUS_SUCCESS;
+    auth.bonded         = p_link->sec_bond;
+    auth.sm1_levels.lv1 = 1;
+    auth.sm1_levels.lv2 = 1;
+    auth.kdist_periph   = kdist_periph;
+    auth.kdist_central  = kdist_central;
+    gap_evt_push(BLE_GAP_EVT_AUTH_STATUS, link_handle(p_link), &auth, sizeof(auth));
+}
+
+
+static void conn_sec_update(link_t * p_link)
+{
+    ble_gap_evt_conn_sec_update_t update;
+
+    p_link->conn_sec.sec_mode.sm    = 1;
+    p_link->conn_sec.sec_mode.lv    = 2;
+    p_link->conn_sec.encr_key_size  = BLE_GAP_SEC_KEY_LEN;
+    p_link->p_central->encrypted    = true;
+
+    update.conn_sec = p_link->conn_sec;
+    gap_evt_push(BLE_GAP_EVT_CONN_SEC_UPDATE, link_handle(p_link), &update, sizeof(update));
+}
+
+
+static void security_step(link_t * p_link)
+{
+    sim_ble_central_t * p_central = p_link->p_central;
+    uint16_t            conn_handle = link_handle(p_link);
+
+    if (p_link->sec_request)
+    {
+        p_link->sec_request = false;
+        central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_SECURITY_REQUEST, 0, false);
+    }
+
+    switch (p_link->sec_state)
+    {
+        case SEC_PAIR_REQUEST:
+        {
+            ble_gap_evt_sec_params_request_t request;
+
+            request.peer_params = p_link->sec_peer;
+            p_link->sec_state   = SEC_PARAMS_WAIT;
+            gap_evt_push(BLE_GAP_EVT_SEC_PARAMS_REQUEST, conn_handle, &request, sizeof(request));
+            break;
+        }
+
+        case SEC_PAIRING:
+            if (--p_link->sec_events == 0)
+            {
+                p_link->sec_state = SEC_KEYS;
+                conn_sec_update(p_link);
+            }
+            break;
+
+        case SEC_KEYS:
+            p_link->sec_state = SEC_IDLE;
+            keys_distribute(p_link);
+            central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_ENCRYPTED, 0, true);
+            break;
+
+        case SEC_PAIR_REJECT:
+        {
+            ble_gap_evt_auth_status_t auth;
+
+            memset(&auth, 0, sizeof(auth));
+            auth.auth_status  = p_link->sec_status;
+            auth.error_src    = BLE_GAP_SEC_STATUS_SOURCE_LOCAL;
+            p_link->sec_state = SEC_IDLE;
+            gap_evt_push(BLE_GAP_EVT_AUTH_STATUS, conn_handle, &auth, sizeof(auth));
+            central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_SECURITY_FAILED, p_link->sec_status, false);
+            break;
+        }
+
+        case SEC_ENC_REQUEST:
+        {
+            ble_gap_evt_sec_info_request_t request;
+
+            memset(&request, 0, sizeof(request));
+            request.peer_addr = p_link->peer_addr;
+            request.master_id = p_central->bond.master_id;
+            request.enc_info  = 1;
+            p_link->sec_state = SEC_INFO_WAIT;
+            gap_evt_push(BLE_GAP_EVT_SEC_INFO_REQUEST, conn_handle, &request, sizeof(request));
+            break;
+        }
+
+        case SEC_ENCRYPTING:
+            p_link->sec_state = SEC_IDLE;
+            conn_sec_update(p_link);
+            central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_ENCRYPTED, 0, false);
+            break;
+
+        case SEC_ENC_REJECT:
+            p_link->sec_state = SEC_IDLE;
+            central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_SECURITY_FAILED, BLE_HCI_STATUS_CODE_PIN_OR_KEY_MISSING, false);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void conn_param_step(link_t * p_link)
+{
+    sim_ble_central_t const * p_central = p_link->p_central;
+
+    switch (p_link->cpu_state)
+    {
+        case CPU_REQUEST:
+            p_link->cpu_state = CPU_RESPONSE;
+            break;
+
+        case CPU_RESPONSE:
+        {
+            // The central takes the longest interval both sides accept, or rejects the request.
+            uint16_t min = MAX(p_link->cpu_params.min_conn_interval, p_central->interval_min);
+            uint16_t max = MIN(p_link->cpu_params.max_conn_interval, p_central->interval_max);
+
+            if (min <= max)
+            {
+                p_link->cpu_params.min_conn_interval = max;
+                p_link->cpu_params.max_conn_interval = max;
+                p_link->cpu_instant = p_link->event_counter + CONN_UPDATE_INSTANT;
+                p_link->cpu_state   = CPU_INSTANT;
+            }
+            else
+            {
+                p_link->cpu_state = CPU_IDLE;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for carrying on the procedures of a link, at a connection event heard. */
+static bool link_procedures(link_t * p_link)
+{
+    if (p_link->local_terminate)
+    {
+        link_close(p_link, BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION, p_link->local_reason);
+        return false;
+    }
+    if (p_link->remote_terminate)
+    {
+        link_close(p_link, p_link->remote_reason, BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION);
+        return false;
+    }
+    security_step(p_link);
+    conn_param_step(p_link);
+    return true;
+}
+
+
+/**@brief Function for checking the supervision timeout of a link. */
+static bool link_supervise(link_t * p_link)
+{
+    if (sim_time() - p_link->last_rx >= UNITS_10_MS(p_link->sup_timeout))
+    {
+        link_close(p_link, BLE_HCI_CONNECTION_TIMEOUT, BLE_HCI_CONNECTION_TIMEOUT);
+        return false;
+    }
+    return true;
+}
+
+
+/**@brief Function for moving a link to its next connection event, at the instant of a
+ *        parameter update if one is due.
+ */
+static void link_next_event(link_t * p_link)
+{
+    p_link->anchor += UNITS_1250_US(p_link->interval);
+
+    if ((p_link->cpu_state == CPU_INSTANT) && (p_link->event_counter + 1 >= p_link->cpu_instant))
+    {
+        ble_gap_evt_conn_param_update_t update;
+
+        p_link->interval    = p_link->cpu_params.max_conn_interval;
+        p_link->latency     = p_link->cpu_params.slave_latency;
+        p_link->sup_timeout = p_link->cpu_params.conn_sup_timeout;
+        p_link->cpu_state   = CPU_IDLE;
+
+        update.conn_params = p_link->cpu_params;
+        gap_evt_push(BLE_GAP_EVT_CONN_PARAM_UPDATE, link_handle(p_link), &update, sizeof(update));
+    }
+    conn_schedule(p_link);
+}
+
+
+static uint32_t packet_time_us(packet_queue_t const * p_queue, uint32_t index)
+{
+    if (index >= queue_count(p_queue))
+    {
+        return 0;
+    }
+    return (L2CAP_HEADER_LEN + queue_peek(p_queue, index)->len) * BYTE_TIME_US;
+}
+
+
+static void conn_event_end(void * p_context);
+
+
+/**@brief Function for setting up a connection event ahead of its start: the radio is reserved and
+ *        the packets it moves are drawn, as the link layer has its packets ready at the start.
+ */
+static void conn_prepare(void * p_context)
+{
+    link_t            * p_link    = p_context;
+    sim_ble_central_t * p_central = p_link->p_central;
+    uint64_t            start     = p_link->anchor;
+    uint64_t            duration  = 0;
+    uint64_t            limit     = UNITS_1250_US(p_link->interval) - SIM_US(150);
+    uint32_t            wanted;
+    uint32_t            i;
+    uint32_t            loss      = p_central->in_range ? m_config.loss_ppm : 1000000;
+
+    model_enter();
+    p_link->event_counter++;
+
+    wanted = MAX(MIN(queue_count(&p_link->to_central), m_config.packets_per_event),
+                 MIN(queue_count(&p_link->to_device), m_config.packets_per_event));
+    wanted = MAX(wanted, 1);
+
+    // Exchanges go on until one is lost, each way, or the packets run out.
+    p_link->exchanged = 0;
+    for (i = 0; i < wanted; i++)
+    {
+        uint64_t exchange = SIM_US(EXCHANGE_OVERHEAD_US + packet_time_us(&p_link->to_central, i) +
+                                   packet_time_us(&p_link->to_device, i));
+
+        if (duration + exchange > limit)
+        {
+            break;
+        }
+        duration += exchange;
+        if (sim_chance(loss) || sim_chance(loss))
+        {
+            if (p_central->in_range)
+            {
+                m_stats.packets_lost++;
+            }
+            break;
+        }
+        p_link->exchanged++;
+    }
+    if (duration == 0)
+    {
+        duration = SIM_US(EXCHANGE_OVERHEAD_US);
+    }
+
+    if (!radio_acquire(start, start + duration))
+    {
+        m_stats.conn_events_skipped++;
+        if (link_supervise(p_link))
+        {
+            link_next_event(p_link);
+        }
+        model_exit();
+        return;
+    }
+
+    m_stats.conn_events++;
+    (void)sim_at(start + duration, SIM_OWNER_DEVICE, conn_event_end, p_link);
+    model_exit();
+}
+
+
+static void conn_event_end(void * p_context)
+{
+    link_t            * p_link    = p_context;
+    sim_ble_central_t * p_central = p_link->p_central;
+    uint32_t            acked     = 0;
+    uint32_t            i;
+
+    model_enter();
+
+    if (p_link->exchanged > 0)
+    {
+        p_link->last_rx = sim_time();
+    }
+
+    // Packets of the central first: their answers wait for the next event anyway.
+    for (i = 0; (i < p_link->exchanged) && (queue_count(&p_link->to_device) > 0); i++)
+    {
+        packet_t packet = *queue_peek(&p_link->to_device, 0);
+
+        p_link->to_device.read++;
+        device_receive(p_link, packet.pdu, packet.len);
+    }
+    for (i = 0; (i < p_link->exchanged) && (queue_count(&p_link->to_central) > 0); i++)
+    {
+        packet_t              packet = *queue_peek(&p_link->to_central, 0);
+        sim_ble_central_evt_t evt;
+
+        p_link->to_central.read++;
+        m_stats.pdus_to_central++;
+        if (packet.tx_buffer)
+        {
+            acked++;
+        }
+
+        memset(&evt, 0, sizeof(evt));
+        evt.type  = SIM_BLE_CENTRAL_EVT_ATT;
+        evt.p_pdu = packet.pdu;
+        evt.len   = packet.len;
+        if (p_central->evt_handler != NULL)
+        {
+            p_central->evt_handler(p_central, &evt);
+        }
+    }
+    if (acked > 0)
+    {
+        ble_evt_t * p_evt = evt_new(BLE_EVT_TX_COMPLETE);
+
+        p_link->tx_free += acked;
+        p_evt->evt.common_evt.conn_handle             = link_handle(p_link);
+        p_evt->evt.common_evt.params.tx_complete.count = (uint8_t)acked;
+        evt_push(p_evt, EVT_SIZE_COMMON);
+    }
+
+    if (((p_link->exchanged == 0) || link_procedures(p_link)) && link_supervise(p_link))
+    {
+        link_next_event(p_link);
+    }
+
+    radio_release();
+    model_exit();
+}
+
+
+/**@brief Function for making up a resolvable private address. */
+static void resolvable_addr_make(ble_gap_addr_t * p_addr)
+{
+    uint32_t i;
+
+    p_addr->addr_type = BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE;
+    for (i = 0; i < BLE_GAP_ADDR_LEN; i++)
+    {
+        p_addr->addr[i] = (uint8_t)sim_rand();
+    }
+    p_addr->addr[5] = (p_addr->addr[5] & 0x3F) | 0x40;
+}
+
+
+static void link_open(sim_ble_central_t * p_central, int32_t irk_index)
+{
+    link_t                * p_link = NULL;
+    ble_gap_evt_connected_t connected;
+    uint32_t                i;
+
+    for (i = 0; i < SIM_BLE_LINKS_MAX; i++)
+    {
+        if (!m_ble.links[i].connected)
+        {
+            p_link = &m_ble.links[i];
+            break;
+        }
+    }
+
+    memset(p_link, 0, sizeof(*p_link));
+    p_link->connected   = true;
+    p_link->attrs_kept  = true;
+    p_link->p_central   = p_central;
+    p_link->interval    = p_central->interval;
+    p_link->sup_timeout = p_central->sup_timeout;
+    p_link->anchor      = sim_time() + CONN_FIRST_EVENT;
+    p_link->last_rx     = sim_time();
+    p_link->tx_free     = SIM_BLE_TX_BUFFERS;
+    p_link->conn_sec.sec_mode.sm = 1;
+    p_link->conn_sec.sec_mode.lv = 1;
+    if (p_central->privacy)
+    {
+        resolvable_addr_make(&p_link->peer_addr);
+    }
+    else
+    {
+        p_link->peer_addr = p_central->id_addr;
+    }
+
+    p_central->conn_handle = link_handle(p_link);
+    p_central->initiating  = false;
+    p_central->encrypted   = false;
+    m_stats.connections++;
+
+    memset(&connected, 0, sizeof(connected));
+    connected.peer_addr = p_link->peer_addr;
+    (void)sd_ble_gap_address_get(&connected.own_addr);
+    connected.role          = BLE_GAP_ROLE_PERIPH;
+    connected.irk_match     = (irk_index >= 0);
+    connected.irk_match_idx = (irk_index >= 0) ? (uint8_t)irk_index : 0;
+    connected.conn_params.min_conn_interval = p_link->interval;
+    connected.conn_params.max_conn_interval = p_link->interval;
+    connected.conn_params.slave_latency     = 0;
+    connected.conn_params.conn_sup_timeout  = p_link->sup_timeout;
+    gap_evt_push(BLE_GAP_EVT_CONNECTED, link_handle(p_link), &connected, sizeof(connected));
+
+    central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_CONNECTED, 0, false);
+    conn_schedule(p_link);
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Advertising.
+ */
+
+static void adv_prepare(void * p_context);
+
+
+static void adv_schedule(uint64_t start)
+{
+    uint64_t lead = radio_lead();
+
+    m_adv.next       = start;
+    m_adv.prepare_id = sim_at((start > lead) ? start - lead : 0, SIM_OWNER_DEVICE, adv_prepare,
+                              (void *)(uintptr_t)m_adv.generation);
+}
+
+
+static bool adv_connectable(void)
+{
+    return (m_adv.params.type == BLE_GAP_ADV_TYPE_ADV_IND) || (m_adv.params.type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND);
+}
+
+
+static bool adv_high_duty(void)
+{
+    return (m_adv.params.type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND) && (m_adv.params.interval == 0);
+}
+
+
+/**@brief Function for checking whether a central may connect, by the filter policy of the
+ *        advertising set.
+ *
+ * @return -1 if not, -2 if it may without a resolved key, or the index of the matched key.
+ */
+static int32_t adv_filter(sim_ble_central_t const * p_central)
+{
+    uint32_t i;
+
+    if (m_adv.params.type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND)
+    {
+        return (memcmp(&m_adv.peer_addr, &p_central->id_addr, sizeof(ble_gap_addr_t)) == 0) ? -2 : -1;
+    }
+    if ((m_adv.params.fp != BLE_GAP_ADV_FP_FILTER_CONNREQ) && (m_adv.params.fp != BLE_GAP_ADV_FP_FILTER_BOTH))
+    {
+        return -2;
+    }
+    for (i = 0; i < m_adv.wl_irk_count; i++)
+    {
+        if (p_central->privacy && p_central->bond.valid &&
+            (memcmp(&m_adv.wl_irks[i], &p_central->irk, sizeof(ble_gap_irk_t)) == 0))
+        {
+            return (int32_t)i;
+        }
+    }
+    for (i = 0; i < m_adv.wl_addr_count; i++)
+    {
+        if (!p_central->privacy &&
+            (memcmp(&m_adv.wl_addrs[i], &p_central->id_addr, sizeof(ble_gap_addr_t)) == 0))
+        {
+            return -2;
+        }
+    }
+    return -1;
+}
+
+
+static void adv_event_end(void * p_context);
+
+
+static void adv_prepare(void * p_context)
+{
+    uint64_t start = m_adv.next;
+
+    if (!m_adv.active || ((uint32_t)(uintptr_t)p_context != m_adv.generation))
+    {
+        return;
+    }
+
+    model_enter();
+    if (!radio_acquire(start, start + ADV_EVENT_TIME))
+    {
+        m_stats.adv_delayed++;
+        adv_schedule(m_ble.radio_free + SIM_US(150));
+    }
+    else
+    {
+        (void)sim_at(start + ADV_EVENT_TIME, SIM_OWNER_DEVICE, adv_event_end, p_context);
+    }
+    model_exit();
+}
+
+
+static void adv_event_end(void * p_context)
+{
+    uint32_t i;
+    uint64_t delay;
+
+    model_enter();
+    if (m_adv.active && ((uint32_t)(uintptr_t)p_context == m_adv.generation))
+    {
+        m_stats.adv_events++;
+
+        for (i = 0; adv_connectable() && (link_count() < m_config.links_max) && (i < m_central_count); i++)
+        {
+            sim_ble_central_t * p_central = mp_centrals[i];
+            int32_t             match;
+
+            if (!p_central->initiating || !p_central->in_range)
+            {
+                continue;
+            }
+            match = adv_filter(p_central);
+            if (match != -1)
+            {
+                // The link layer stops advertising on a connection.
+                m_adv.active = false;
+                m_adv.generation++;
+                sim_cancel(m_adv.timeout_id);
+                link_open(p_central, match);
+                break;
+            }
+        }
+
+        if (m_adv.active)
+        {
+            delay = adv_high_duty() ? ADV_HIGH_DUTY_TIME
+                                    : UNITS_625_US(m_adv.params.interval) + SIM_US(sim_rand() % ADV_DELAY_MAX_US);
+            adv_schedule(m_adv.next + delay);
+        }
+    }
+    radio_release();
+    model_exit();
+}
+
+
+static void adv_timeout(void * p_context)
+{
+    ble_gap_evt_timeout_t timeout;
+
+    if (!m_adv.active || ((uint32_t)(uintptr_t)p_context != m_adv.generation))
+    {
+        return;
+    }
+
+    model_enter();
+    m_adv.active = false;
+    m_adv.generation++;
+    timeout.src = BLE_GAP_TIMEOUT_SRC_ADVERTISING;
+    gap_evt_push(BLE_GAP_EVT_TIMEOUT, BLE_CONN_HANDLE_INVALID, &timeout, sizeof(timeout));
+    model_exit();
+}
+
+
+uint32_t sd_ble_gap_adv_data_set(uint8_t const * p_data, uint8_t dlen, uint8_t const * p_sr_data, uint8_t srdlen)
+{
+    uint8_t const * p_sets[2] = {p_data, p_sr_data};
+    uint8_t         lens[2]   = {dlen, srdlen};
+    uint32_t        i;
+    uint32_t        offset;
+
+    for (i = 0; i < 2; i++)
+    {
+        if ((p_sets[i] == NULL) && (lens[i] > 0))
+        {
+            return NRF_ERROR_INVALID_ADDR;
+        }
+        if (lens[i] > BLE_GAP_ADV_MAX_SIZE)
+        {
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        // Each AD structure is a length, a type and data, and must fit.
+        for (offset = 0; (p_sets[i] != NULL) && (offset < lens[i]); offset += 1 + p_sets[i][offset])
+        {
+            if ((p_sets[i][offset] == 0) || (offset + 1 + p_sets[i][offset] > lens[i]))
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+        }
+    }
+
+    if (p_data != NULL)
+    {
+        memcpy(m_adv.data, p_data, dlen);
+        m_adv.dlen = dlen;
+    }
+    if (p_sr_data != NULL)
+    {
+        memcpy(m_adv.sr_data, p_sr_data, srdlen);
+        m_adv.srdlen = srdlen;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const * p_adv_params)
+{
+    ble_gap_whitelist_t const * p_wl;
+    uint32_t                    i;
+
+    if (p_adv_params == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (!m_ble.enabled)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if (m_adv.active)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_adv_params->type > BLE_GAP_ADV_TYPE_ADV_NONCONN_IND)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (!((p_adv_params->type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND) && (p_adv_params->interval == 0)) &&
+        ((p_adv_params->interval < BLE_GAP_ADV_INTERVAL_MIN) || (p_adv_params->interval > BLE_GAP_ADV_INTERVAL_MAX) ||
+         ((p_adv_params->type != BLE_GAP_ADV_TYPE_ADV_IND) && (p_adv_params->type != BLE_GAP_ADV_TYPE_ADV_DIRECT_IND) &&
+          (p_adv_params->interval < BLE_GAP_ADV_NONCON_INTERVAL_MIN))))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_adv_params->type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND) && (p_adv_params->p_peer_addr == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_adv_params->fp != BLE_GAP_ADV_FP_ANY) &&
+        ((p_adv_params->p_whitelist == NULL) || (p_adv_params->type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND)))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_adv_params->type == BLE_GAP_ADV_TYPE_ADV_IND) || (p_adv_params->type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND))
+    {
+        // A connectable set needs a free link.
+        if (link_count() >= m_config.links_max)
+        {
+            return NRF_ERROR_INVALID_STATE;
+        }
+    }
+
+    memset(&m_adv.params, 0, sizeof(m_adv.params));
+    m_adv.params        = *p_adv_params;
+    m_adv.wl_addr_count = 0;
+    m_adv.wl_irk_count  = 0;
+    p_wl = p_adv_params->p_whitelist;
+    if (p_wl != NULL)
+    {
+        if ((p_wl->addr_count > WHITELIST_MAX) || (p_wl->irk_count > WHITELIST_MAX))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        for (i = 0; i < p_wl->addr_count; i++)
+        {
+            m_adv.wl_addrs[i] = *p_wl->pp_addrs[i];
+        }
+        for (i = 0; i < p_wl->irk_count; i++)
+        {
+            m_adv.wl_irks[i] = *p_wl->pp_irks[i];
+        }
+        m_adv.wl_addr_count = p_wl->addr_count;
+        m_adv.wl_irk_count  = p_wl->irk_count;
+    }
+    m_adv.params.p_whitelist = NULL;
+    if (p_adv_params->p_peer_addr != NULL)
+    {
+        m_adv.peer_addr = *p_adv_params->p_peer_addr;
+    }
+    m_adv.params.p_peer_addr = NULL;
+
+    m_adv.active = true;
+    m_adv.generation++;
+    adv_schedule(sim_time() + SIM_US(sim_rand() % ADV_DELAY_MAX_US));
+
+    if (adv_high_duty())
+    {
+        m_adv.timeout_id = sim_at(sim_time() + ADV_HIGH_DUTY_TIMEOUT, SIM_OWNER_DEVICE, adv_timeout,
+                                  (void *)(uintptr_t)m_adv.generation);
+    }
+    else if (p_adv_params->timeout != 0)
+    {
+        m_adv.timeout_id = sim_at(sim_time() + SIM_S(p_adv_params->timeout), SIM_OWNER_DEVICE, adv_timeout,
+                                  (void *)(uintptr_t)m_adv.generation);
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_stop(void)
+{
+    if (!m_adv.active)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_adv.active = false;
+    m_adv.generation++;
+    sim_cancel(m_adv.prepare_id);
+    sim_cancel(m_adv.timeout_id);
+    return NRF_SUCCESS;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * GAP.
+ */
+
+uint32_t sd_ble_gap_address_get(ble_gap_addr_t * p_addr)
+{
+    uint32_t addr0 = NRF_FICR->DEVICEADDR[0];
+    uint32_t addr1 = NRF_FICR->DEVICEADDR[1];
+
+    if (p_addr == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    p_addr->addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    p_addr->addr[0]   = (uint8_t)addr0;
+    p_addr->addr[1]   = (uint8_t)(addr0 >> 8);
+    p_addr->addr[2]   = (uint8_t)(addr0 >> 16);
+    p_addr->addr[3]   = (uint8_t)(addr0 >> 24);
+    p_addr->addr[4]   = (uint8_t)addr1;
+    p_addr->addr[5]   = (uint8_t)(addr1 >> 8) | 0xC0;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const * p_write_perm, uint8_t const * p_dev_name,
+                                    uint16_t len)
+{
+    attr_t * p_attr = attr_get(m_ble.name_handle);
+
+    if (p_write_perm == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if (len > BLE_GAP_DEVNAME_MAX_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if ((p_dev_name == NULL) && (len > 0))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    memcpy(p_attr->p_value, p_dev_name, len);
+    p_attr->len        = len;
+    p_attr->write_perm = *p_write_perm;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_get(uint8_t * p_dev_name, uint16_t * p_len)
+{
+    attr_t const * p_attr = attr_get(m_ble.name_handle);
+
+    if (p_len == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    // Copies what fits and gives the full length, which tells the caller whether it all fit.
+    if (p_dev_name != NULL)
+    {
+        memcpy(p_dev_name, p_attr->p_value, MIN(*p_len, p_attr->len));
+    }
+    *p_len = p_attr->len;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance)
+{
+    attr_t * p_attr = attr_get(m_ble.appearance_handle);
+
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    put16(p_attr->p_value, appearance);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_appearance_get(uint16_t * p_appearance)
+{
+    attr_t const * p_attr = attr_get(m_ble.appearance_handle);
+
+    if (p_appearance == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    *p_appearance = get16(p_attr->p_value);
+    return NRF_SUCCESS;
+}
+
+
+static bool conn_params_valid(ble_gap_conn_params_t const * p_params)
+{
+    return (p_params->min_conn_interval >= BLE_GAP_CP_MIN_CONN_INTVL_MIN) &&
+           (p_params->max_conn_interval <= BLE_GAP_CP_MAX_CONN_INTVL_MAX) &&
+           (p_params->min_conn_interval <= p_params->max_conn_interval) &&
+           (p_params->slave_latency <= BLE_GAP_CP_SLAVE_LATENCY_MAX) &&
+           (p_params->conn_sup_timeout >= BLE_GAP_CP_CONN_SUP_TIMEOUT_MIN) &&
+           (p_params->conn_sup_timeout <= BLE_GAP_CP_CONN_SUP_TIMEOUT_MAX) &&
+           ((uint32_t)p_params->conn_sup_timeout * 4 >
+            (uint32_t)(1 + p_params->slave_latency) * p_params->max_conn_interval);
+}
+
+
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const * p_conn_params)
+{
+    attr_t * p_attr = attr_get(m_ble.ppcp_handle);
+
+    if (p_conn_params == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    if (!conn_params_valid(p_conn_params))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    put16(&p_attr->p_value[0], p_conn_params->min_conn_interval);
+    put16(&p_attr->p_value[2], p_conn_params->max_conn_interval);
+    put16(&p_attr->p_value[4], p_conn_params->slave_latency);
+    put16(&p_attr->p_value[6], p_conn_params->conn_sup_timeout);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_get(ble_gap_conn_params_t * p_conn_params)
+{
+    attr_t const * p_attr = attr_get(m_ble.ppcp_handle);
+
+    if (p_conn_params == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_attr == NULL)
+    {
+        return BLE_ERROR_NOT_ENABLED;
+    }
+    p_conn_params->min_conn_interval = get16(&p_attr->p_value[0]);
+    p_conn_params->max_conn_interval = get16(&p_attr->p_value[2]);
+    p_conn_params->slave_latency     = get16(&p_attr->p_value[4]);
+    p_conn_params->conn_sup_timeout  = get16(&p_attr->p_value[6]);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params)
+{
+    link_t              * p_link = link_get(conn_handle);
+    ble_gap_conn_params_t params;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_conn_params == NULL)
+    {
+        (void)sd_ble_gap_ppcp_get(&params);
+    }
+    else
+    {
+        params = *p_conn_params;
+    }
+    if (!conn_params_valid(&params))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_link->cpu_state != CPU_IDLE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    p_link->cpu_params = params;
+    p_link->cpu_state  = CPU_REQUEST;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((hci_status_code != BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION) &&
+        (hci_status_code != BLE_HCI_CONN_INTERVAL_UNACCEPTABLE))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_link->local_terminate)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    p_link->local_terminate = true;
+    p_link->local_reason    = hci_status_code;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_authenticate(uint16_t conn_handle, ble_gap_sec_params_t const * p_sec_params)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_sec_params == NULL)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((p_link->sec_state != SEC_IDLE) || p_link->sec_request)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    p_link->sec_request = true;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status,
+                                     ble_gap_sec_params_t const * p_sec_params,
+                                     ble_gap_sec_keyset_t const * p_sec_keyset)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_link->sec_state != SEC_PARAMS_WAIT)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (sec_status != BLE_GAP_SEC_STATUS_SUCCESS)
+    {
+        p_link->sec_status = sec_status;
+        p_link->sec_state  = SEC_PAIR_REJECT;
+        return NRF_SUCCESS;
+    }
+    if ((p_sec_params == NULL) || (p_sec_keyset == NULL))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    p_link->sec_own    = *p_sec_params;
+    p_link->keyset     = *p_sec_keyset;
+    p_link->sec_bond   = p_sec_params->bond && p_link->sec_peer.bond;
+    p_link->sec_events = PAIRING_EVENTS;
+    p_link->sec_state  = SEC_PAIRING;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_info_reply(uint16_t conn_handle, ble_gap_enc_info_t const * p_enc_info,
+                                   ble_gap_irk_t const * p_id_info, ble_gap_sign_info_t const * p_sign_info)
+{
+    link_t               * p_link = link_get(conn_handle);
+    sim_ble_bond_t const * p_bond;
+
+    if (p_link == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (p_link->sec_state != SEC_INFO_WAIT)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    p_bond = &p_link->p_central->bond;
+    if ((p_enc_info != NULL) && p_bond->valid &&
+        (memcmp(p_enc_info->ltk, p_bond->enc_info.ltk, BLE_GAP_SEC_KEY_LEN) == 0))
+    {
+        p_link->sec_state = SEC_ENCRYPTING;
+    }
+    else
+    {
+        // No key or another one: the central's encryption request fails.
+        p_link->sec_state = SEC_ENC_REJECT;
+    }
+    return NRF_SUCCESS;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Centrals.
+ */
+
+void sim_ble_central_init(sim_ble_central_t * p_central)
+{
+    uint32_t i;
+
+    memset(&p_central->bond, 0, sizeof(p_central->bond));
+    p_central->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_central->initiating  = false;
+    p_central->in_range    = false;
+    p_central->encrypted   = false;
+
+    for (i = 0; i < m_central_count; i++)
+    {
+        if (mp_centrals[i] == p_central)
+        {
+            return;
+        }
+    }
+    if (m_central_count == CENTRALS_MAX)
+    {
+        fprintf(stderr, "sim: too many centrals\n");
+        abort();
+    }
+    mp_centrals[m_central_count++] = p_central;
+}
+
+
+void sim_ble_range_set(sim_ble_central_t * p_central, bool in_range)
+{
+    p_central->in_range = in_range;
+}
+
+
+void sim_ble_connect(sim_ble_central_t * p_central)
+{
+    if (central_link(p_central) == NULL)
+    {
+        p_central->initiating = true;
+    }
+}
+
+
+void sim_ble_connect_cancel(sim_ble_central_t * p_central)
+{
+    p_central->initiating = false;
+}
+
+
+void sim_ble_disconnect(sim_ble_central_t * p_central, uint8_t reason)
+{
+    link_t * p_link = central_link(p_central);
+
+    if (p_link != NULL)
+    {
+        p_link->remote_terminate = true;
+        p_link->remote_reason    = reason;
+    }
+}
+
+
+void sim_ble_pair(sim_ble_central_t * p_central, bool bond)
+{
+    link_t * p_link = central_link(p_central);
+
+    if ((p_link == NULL) || (p_link->sec_state != SEC_IDLE))
+    {
+        return;
+    }
+    memset(&p_link->sec_peer, 0, sizeof(p_link->sec_peer));
+    p_link->sec_peer.bond               = bond;
+    p_link->sec_peer.io_caps            = BLE_GAP_IO_CAPS_KEYBOARD_DISPLAY;
+    p_link->sec_peer.min_key_size       = 7;
+    p_link->sec_peer.max_key_size       = 16;
+    p_link->sec_peer.kdist_periph.enc   = 1;
+    p_link->sec_peer.kdist_periph.id    = 1;
+    p_link->sec_peer.kdist_central.id   = 1;
+    p_link->sec_state                   = SEC_PAIR_REQUEST;
+}
+
+
+void sim_ble_encrypt(sim_ble_central_t * p_central)
+{
+    link_t * p_link = central_link(p_central);
+
+    if ((p_link == NULL) || (p_link->sec_state != SEC_IDLE) || !p_central->bond.valid)
+    {
+        return;
+    }
+    p_link->sec_state = SEC_ENC_REQUEST;
+}
+
+
+bool sim_ble_att_send(sim_ble_central_t * p_central, uint8_t const * p_pdu, uint16_t len)
+{
+    link_t * p_link = central_link(p_central);
+
+    return (p_link != NULL) && (len > 0) && queue_put(&p_link->to_device, p_pdu, len, false);
+}
+
+
+uint32_t sim_ble_central_queued(sim_ble_central_t const * p_central)
+{
+    link_t * p_link = central_link(p_central);
+
+    return (p_link != NULL) ? queue_count(&p_link->to_device) : 0;
+}
+
+
+uint16_t sim_ble_conn_interval_get(sim_ble_central_t const * p_central)
+{
+    link_t * p_link = central_link(p_central);
+
+    return (p_link != NULL) ? p_link->interval : 0;
+}
+
+
+uint16_t sim_ble_cccd_get(sim_ble_central_t const * p_central, uint16_t value_handle)
+{
+    link_t       * p_link = central_link(p_central);
+    attr_t const * p_cccd = cccd_find(value_handle);
+
+    return ((p_link != NULL) && (p_cccd != NULL)) ? p_link->cccds[(uint8_t)p_cccd->cccd] : 0;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Settings, counters and resets.
+ */
+
+void sim_ble_config_default(sim_ble_config_t * p_config)
+{
+    memset(p_config, 0, sizeof(*p_config));
+    p_config->links_max         = 1;
+    p_config->packets_per_event = 6;
+}
+
+
+void sim_ble_config_set(sim_ble_config_t const * p_config)
+{
+    m_config = *p_config;
+    if (m_config.links_max > SIM_BLE_LINKS_MAX)
+    {
+        m_config.links_max = SIM_BLE_LINKS_MAX;
+    }
+    if (m_config.packets_per_event == 0)
+    {
+        m_config.packets_per_event = 1;
+    }
+}
+
+
+void sim_ble_stats_get(sim_ble_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
+
+
+void sim_ble_stats_clear(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+bool sim_ble_advertising(void)
+{
+    return m_adv.active;
+}
+
+
+uint8_t sim_ble_adv_data_get(uint8_t * p_data)
+{
+    memcpy(p_data, m_adv.data, m_adv.dlen);
+    return m_adv.dlen;
+}
+
+
+/**@brief Function for telling a central its link is gone, when its supervision timeout ends. */
+static void central_link_lost(void * p_context)
+{
+    sim_ble_central_t * p_central = p_context;
+
+    p_central->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_central->encrypted   = false;
+    m_stats.disconnections++;
+    central_evt_send(p_central, SIM_BLE_CENTRAL_EVT_DISCONNECTED, BLE_HCI_CONNECTION_TIMEOUT, false);
+}
+
+
+static void ble_reset(sim_reset_t reset)
+{
+    uint32_t i;
+
+    // The centrals of the links find out by their supervision timeout.
+    for (i = 0; i < SIM_BLE_LINKS_MAX; i++)
+    {
+        if (m_ble.links[i].connected)
+        {
+            (void)sim_at(sim_time() + UNITS_10_MS(m_ble.links[i].sup_timeout), SIM_OWNER_WORLD,
+                         central_link_lost, m_ble.links[i].p_central);
+        }
+    }
+    memset(&m_ble, 0, sizeof(m_ble));
+    memset(&m_adv, 0, sizeof(m_adv));
+}
+
+
+static void __attribute__((constructor)) ble_constructor(void)
+{
+    sim_ble_config_default(&m_config);
+    sim_reset_hook_add(ble_reset);
+}
@@ -0,0 +1,207 @@
+/* Model of the BLE part of the SoftDevice: GAP in the peripheral role, the GATT server and client,
+ * and the link layer under them, with the centrals at the other end of the links.
+ *
+ * The firmware side is the sd_ble_* API with its events, read with sd_ble_evt_get() from the
+ * SoftDevice event interrupt. Between the firmware and a central the model carries ATT PDUs of the
+ * default MTU: the GATT client calls of the firmware become request PDUs, the GATT server of the
+ * firmware answers the requests of the central, and each side sees the other only through PDUs.
+ *
+ * Timing follows the link layer. Advertising events come at the advertising interval plus a random
+ * delay of up to 10 ms, and a central that initiates connects at the next connectable one it is
+ * allowed to. On a link, PDUs move at connection events only, a few per event in each direction; a
+ * lost packet ends the event and is sent again at the next one, and a link without a packet through
+ * for the supervision timeout drops. A central handles the PDUs of an event when the event ends,
+ * so its answer goes at the next event at the earliest. Radio events never overlap: one due while
+ * another has the radio is skipped (connection) or delayed (advertising), and the radio
+ * notification interrupt marks their start and end as on the chip.
+ *
+ * Security is modelled at the level of its events: pairing and encryption take a few connection
+ * events, the keys are made up by the model, and a central keeps its bond between links.
+ */
+
+#ifndef SIM_BLE_H__
+#define SIM_BLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+#define SIM_BLE_LINKS_MAX    2
+#define SIM_BLE_ATT_MTU      GATT_MTU_SIZE_DEFAULT
+#define SIM_BLE_TX_BUFFERS   7      /**< Application transmission buffers of a link. */
+
+/* ATT PDU opcodes, for the centrals. */
+#define SIM_ATT_ERROR_RSP          0x01
+#define SIM_ATT_MTU_REQ            0x02
+#define SIM_ATT_MTU_RSP            0x03
+#define SIM_ATT_FIND_INFO_REQ      0x04
+#define SIM_ATT_FIND_INFO_RSP      0x05
+#define SIM_ATT_FIND_BY_TYPE_REQ   0x06
+#define SIM_ATT_FIND_BY_TYPE_RSP   0x07
+#define SIM_ATT_READ_BY_TYPE_REQ   0x08
+#define SIM_ATT_READ_BY_TYPE_RSP   0x09
+#define SIM_ATT_READ_REQ           0x0A
+#define SIM_ATT_READ_RSP           0x0B
+#define SIM_ATT_READ_BLOB_REQ      0x0C
+#define SIM_ATT_READ_BLOB_RSP      0x0D
+#define SIM_ATT_READ_MULTI_REQ     0x0E
+#define SIM_ATT_READ_MULTI_RSP     0x0F
+#define SIM_ATT_READ_BY_GROUP_REQ  0x10
+#define SIM_ATT_READ_BY_GROUP_RSP  0x11
+#define SIM_ATT_WRITE_REQ          0x12
+#define SIM_ATT_WRITE_RSP          0x13
+#define SIM_ATT_PREP_WRITE_REQ     0x16
+#define SIM_ATT_PREP_WRITE_RSP     0x17
+#define SIM_ATT_EXEC_WRITE_REQ     0x18
+#define SIM_ATT_EXEC_WRITE_RSP     0x19
+#define SIM_ATT_HVN                0x1B
+#define SIM_ATT_HVI                0x1D
+#define SIM_ATT_HVC                0x1E
+#define SIM_ATT_WRITE_CMD          0x52
+#define SIM_ATT_CMD_FLAG           0x40
+
+/**@brief Link layer settings. */
+typedef struct
+{
+    uint8_t  links_max;            /**< Links the firmware may have at once, 1 on this SoftDevice. */
+    uint8_t  packets_per_event;    /**< Packets a connection event moves in each direction. */
+    uint32_t loss_ppm;             /**< Probability of losing a packet, per million. */
+} sim_ble_config_t;
+
+/**@brief Counters of the model, for all links since the start or the last clear. */
+typedef struct
+{
+    uint32_t adv_events;           /**< Advertising events held. */
+    uint32_t adv_delayed;          /**< Advertising events delayed by another radio event. */
+    uint32_t conn_events;          /**< Connection events held. */
+    uint32_t conn_events_skipped;  /**< Connection events skipped for another radio event. */
+    uint32_t packets_lost;         /**< Packets lost, and sent again. */
+    uint32_t pdus_to_central;      /**< ATT PDUs the firmware sent. */
+    uint32_t pdus_to_device;       /**< ATT PDUs the centrals sent. */
+    uint32_t gattc_requests;       /**< Requests of the GATT client of the firmware: its round trips. */
+    uint32_t notifications;        /**< Notifications and indications the firmware sent. */
+    uint32_t connections;          /**< Links established. */
+    uint32_t disconnections;       /**< Links dropped or closed. */
+} sim_ble_stats_t;
+
+typedef struct sim_ble_central_s sim_ble_central_t;
+
+/**@brief Events of a central. */
+typedef enum
+{
+    SIM_BLE_CENTRAL_EVT_CONNECTED,        /**< Link up. */
+    SIM_BLE_CENTRAL_EVT_DISCONNECTED,     /**< Link down, see reason. */
+    SIM_BLE_CENTRAL_EVT_ENCRYPTED,        /**< Link encrypted, by pairing if paired is set. */
+    SIM_BLE_CENTRAL_EVT_SECURITY_FAILED,  /**< Pairing or encryption failed, see reason. */
+    SIM_BLE_CENTRAL_EVT_SECURITY_REQUEST, /**< The firmware asked for security. */
+    SIM_BLE_CENTRAL_EVT_ATT,              /**< ATT PDU from the firmware, in p_pdu and len. */
+} sim_ble_central_evt_type_t;
+
+typedef struct
+{
+    sim_ble_central_evt_type_t type;
+    uint8_t                    reason;   /**< HCI status, or SMP status of a security failure. */
+    bool                       paired;
+    uint8_t const            * p_pdu;
+    uint16_t                   len;
+} sim_ble_central_evt_t;
+
+typedef void (*sim_ble_central_evt_handler_t)(sim_ble_central_t * p_central,
+                                              sim_ble_central_evt_t const * p_evt);
+
+/**@brief Bond a central keeps with the device. */
+typedef struct
+{
+    bool                valid;
+    ble_gap_enc_info_t  enc_info;
+    ble_gap_master_id_t master_id;
+} sim_ble_bond_t;
+
+/**@brief A central, the other end of a link. Set the fields above the line, then call
+ *        sim_ble_central_init().
+ */
+struct sim_ble_central_s
+{
+    sim_ble_central_evt_handler_t evt_handler;
+    void                        * p_context;
+    ble_gap_addr_t                id_addr;        /**< Identity address. */
+    ble_gap_irk_t                 irk;            /**< Identity resolving key, given when bonding. */
+    bool                          privacy;        /**< Connects from resolvable private addresses. */
+    uint16_t                      interval;       /**< Interval of the links it opens, 1.25 ms units. */
+    uint16_t                      sup_timeout;    /**< Supervision timeout, 10 ms units. */
+    uint16_t                      interval_min;   /**< Intervals it accepts on a parameter update. */
+    uint16_t                      interval_max;
+    /* ------------------------------------------------------------------------------------- */
+    sim_ble_bond_t                bond;           /**< Kept across links. */
+    uint16_t                      conn_handle;    /**< BLE_CONN_HANDLE_INVALID without a link. */
+    bool                          initiating;
+    bool                          in_range;
+    bool                          encrypted;
+};
+
+/**@brief Function for setting the link layer settings. */
+void sim_ble_config_set(sim_ble_config_t const * p_config);
+
+/**@brief Function for getting the default settings: one link, 6 packets per event, no loss. */
+void sim_ble_config_default(sim_ble_config_t * p_config);
+
+/**@brief Function for getting the counters. */
+void sim_ble_stats_get(sim_ble_stats_t * p_stats);
+
+/**@brief Function for clearing the counters. */
+void sim_ble_stats_clear(void);
+
+/**@brief Function for checking whether the firmware advertises. */
+bool sim_ble_advertising(void);
+
+/**@brief Function for getting the advertising data set by the firmware.
+ *
+ * @return Length of the data, copied to p_data, which must hold BLE_GAP_ADV_MAX_SIZE bytes.
+ */
+uint8_t sim_ble_adv_data_get(uint8_t * p_data);
+
+/**@brief Function for getting the connection interval of the link of a central, 1.25 ms units, or 0
+ *        without a link.
+ */
+uint16_t sim_ble_conn_interval_get(sim_ble_central_t const * p_central);
+
+/**@brief Function for checking whether the firmware enabled notifications or indications of an
+ *        attribute for the link of a central: the value of its CCCD, 0 if none.
+ */
+uint16_t sim_ble_cccd_get(sim_ble_central_t const * p_central, uint16_t value_handle);
+
+/**@brief Function for getting the number of PDUs of a central waiting to be sent to the device. */
+uint32_t sim_ble_central_queued(sim_ble_central_t const * p_central);
+
+/**@brief Function for initializing a central. Out of range and without a link. */
+void sim_ble_central_init(sim_ble_central_t * p_central);
+
+/**@brief Function for bringing a central in or out of range. Out of range, all its packets are lost
+ *        and it cannot connect.
+ */
+void sim_ble_range_set(sim_ble_central_t * p_central, bool in_range);
+
+/**@brief Function for making a central initiate a link: it connects at the next advertising event
+ *        it may connect to, until sim_ble_connect_cancel().
+ */
+void sim_ble_connect(sim_ble_central_t * p_central);
+
+/**@brief Function for stopping a central initiating a link. */
+void sim_ble_connect_cancel(sim_ble_central_t * p_central);
+
+/**@brief Function for making a central close its link, with the given HCI reason. */
+void sim_ble_disconnect(sim_ble_central_t * p_central, uint8_t reason);
+
+/**@brief Function for making a central pair, bonding if bond is set. */
+void sim_ble_pair(sim_ble_central_t * p_central, bool bond);
+
+/**@brief Function for making a central encrypt the link with its bond. */
+void sim_ble_encrypt(sim_ble_central_t * p_central);
+
+/**@brief Function for queuing an ATT PDU from a central to the firmware.
+ *
+ * @return false if the central has no link or its queue is full.
+ */
+bool sim_ble_att_send(sim_ble_central_t * p_central, uint8_t const * p_pdu, uint16_t len);
+
+#endif /* SIM_BLE_H__ */
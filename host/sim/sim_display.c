@@ -0,0 +1,379 @@
+/* Model of the SSD1351 OLED controller. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_periph.h"
+#include "sim_display.h"
+
+#define RESET_PULSE_MIN   SIM_US(2)
+#define PARAMS_MAX        63          /**< Parameters of the longest command, the gray scale table. */
+#define PARAMS_UNKNOWN    0xFF        /**< Parameter count of a command that is not known. */
+
+#define CMD_COLUMN        0x15
+#define CMD_ROW           0x75
+#define CMD_WRITE_RAM     0x5C
+#define CMD_READ_RAM      0x5D
+#define CMD_DISPLAY_OFF   0xAE
+#define CMD_DISPLAY_ON    0xAF
+#define CMD_LOCK          0xFD
+
+#define LOCK_ALL          0x16        /**< Parameter of CMD_LOCK that locks out all other commands. */
+#define UNLOCK_ALL        0x12
+
+/**@brief Parameter counts of the commands, PARAMS_UNKNOWN for bytes that are no command. */
+static uint8_t m_param_counts[256];
+
+static struct
+{
+    uint16_t ram[SIM_DISPLAY_HEIGHT][SIM_DISPLAY_WIDTH];
+    bool     in_reset;
+    uint64_t reset_start;
+    bool     locked;
+    bool     on;
+    uint8_t  cmd;
+    uint8_t  params[PARAMS_MAX];
+    uint8_t  param_count;
+    bool     writing;                 /**< RAM write in progress, until the next command. */
+    uint8_t  pixel_msb;
+    bool     pixel_half;
+    uint8_t  col_start, col_end, col;
+    uint8_t  row_start, row_end, row;
+} m_ssd;
+
+static sim_display_stats_t m_stats;
+static uint64_t            m_first_pixel_time = SIM_TIME_NEVER;
+static uint16_t          * mp_trace;
+static uint32_t            m_trace_count;
+static uint32_t            m_trace_size;
+
+
+/**@brief Function for putting the controller in its state after a reset. The RAM is kept. */
+static void controller_reset(void)
+{
+    m_ssd.locked      = false;
+    m_ssd.on          = false;
+    m_ssd.writing     = false;
+    m_ssd.param_count = 0;
+    m_ssd.cmd         = 0;
+    m_ssd.pixel_half  = false;
+    m_ssd.col_start   = 0;
+    m_ssd.col_end     = SIM_DISPLAY_WIDTH - 1;
+    m_ssd.row_start   = 0;
+    m_ssd.row_end     = SIM_DISPLAY_HEIGHT - 1;
+    m_ssd.col         = 0;
+    m_ssd.row         = 0;
+}
+
+
+static void pin_changed(uint32_t pin, bool level)
+{
+    if (pin != SIM_DISPLAY_PIN_RESET)
+    {
+        return;
+    }
+
+    if (!level && !m_ssd.in_reset)
+    {
+        m_ssd.in_reset    = true;
+        m_ssd.reset_start = sim_time();
+    }
+    else if (level && m_ssd.in_reset)
+    {
+        m_ssd.in_reset = false;
+        m_stats.resets++;
+        if (sim_time() - m_ssd.reset_start < RESET_PULSE_MIN)
+        {
+            m_stats.short_resets++;
+        }
+        else
+        {
+            controller_reset();
+        }
+    }
+}
+
+
+static void chip_reset(sim_reset_t reset)
+{
+    // The display is not reset with the chip. Its pins float, and the firmware drives them again.
+    m_first_pixel_time = SIM_TIME_NEVER;
+}
+
+
+static void __attribute__((constructor)) display_constructor(void)
+{
+    static uint8_t const counts[][2] =
+    {
+        {0x15, 2}, {0x75, 2}, {0x5C, 0}, {0x5D, 0}, {0xA0, 1}, {0xA1, 1}, {0xA2, 1},
+        {0xA4, 0}, {0xA5, 0}, {0xA6, 0}, {0xA7, 0}, {0xAB, 1}, {0xAE, 0}, {0xAF, 0},
+        {0xB1, 1}, {0xB2, 3}, {0xB3, 1}, {0xB4, 3}, {0xB5, 1}, {0xB6, 1}, {0xB8, 63},
+        {0xB9, 0}, {0xBB, 1}, {0xBE, 1}, {0xC1, 3}, {0xC7, 1}, {0xCA, 1}, {0xFD, 1},
+        {0x96, 5}, {0x9E, 0}, {0x9F, 0},
+    };
+    uint32_t i;
+
+    memset(m_param_counts, PARAMS_UNKNOWN, sizeof(m_param_counts));
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        m_param_counts[counts[i][0]] = counts[i][1];
+    }
+
+    controller_reset();
+    sim_gpio_listener_set(pin_changed);
+    sim_reset_hook_add(chip_reset);
+}
+
+
+static void trace_add(uint16_t entry)
+{
+    if (m_trace_count == m_trace_size)
+    {
+        m_trace_size = (m_trace_size == 0) ? 4096 : 2 * m_trace_size;
+        mp_trace     = realloc(mp_trace, m_trace_size * sizeof(mp_trace[0]));
+        if (mp_trace == NULL)
+        {
+            perror("sim: display trace");
+            exit(1);
+        }
+    }
+    mp_trace[m_trace_count++] = entry;
+}
+
+
+static void command_apply(void)
+{
+    switch (m_ssd.cmd)
+    {
+        case CMD_COLUMN:
+            m_ssd.col_start = m_ssd.params[0] % SIM_DISPLAY_WIDTH;
+            m_ssd.col_end   = m_ssd.params[1] % SIM_DISPLAY_WIDTH;
+            m_ssd.col       = m_ssd.col_start;
+            break;
+
+        case CMD_ROW:
+            m_ssd.row_start = m_ssd.params[0] % SIM_DISPLAY_HEIGHT;
+            m_ssd.row_end   = m_ssd.params[1] % SIM_DISPLAY_HEIGHT;
+            m_ssd.row       = m_ssd.row_start;
+            break;
+
+        case CMD_LOCK:
+            if (m_ssd.params[0] == LOCK_ALL)
+            {
+                m_ssd.locked = true;
+            }
+            else if (m_ssd.params[0] == UNLOCK_ALL)
+            {
+                m_ssd.locked = false;
+            }
+            break;
+
+        default:
+            // Set-up commands: their parameters are taken, without effect on the model.
+            break;
+    }
+}
+
+
+static void command_start(uint8_t cmd)
+{
+    m_stats.commands++;
+    m_ssd.writing     = false;
+    m_ssd.param_count = 0;
+    m_ssd.cmd         = cmd;
+
+    if (m_ssd.locked && (cmd != CMD_LOCK))
+    {
+        m_stats.ignored++;
+        m_ssd.cmd = 0;
+        return;
+    }
+
+    switch (cmd)
+    {
+        case CMD_WRITE_RAM:
+            // The address goes back to the start of the window.
+            m_ssd.writing    = true;
+            m_ssd.pixel_half = false;
+            m_ssd.col        = m_ssd.col_start;
+            m_ssd.row        = m_ssd.row_start;
+            break;
+
+        case CMD_DISPLAY_ON:
+            m_ssd.on = true;
+            break;
+
+        case CMD_DISPLAY_OFF:
+            m_ssd.on = false;
+            break;
+
+        default:
+            if (m_param_counts[cmd] == PARAMS_UNKNOWN)
+            {
+                m_stats.unknown++;
+                m_ssd.cmd = 0;
+            }
+            else if (m_param_counts[cmd] == 0)
+            {
+                command_apply();
+            }
+            break;
+    }
+}
+
+
+static void pixel_write(uint16_t color)
+{
+    m_ssd.ram[m_ssd.row][m_ssd.col] = color;
+    m_stats.pixels++;
+    if (m_first_pixel_time == SIM_TIME_NEVER)
+    {
+        m_first_pixel_time = sim_time();
+    }
+
+    // Horizontal address increment within the window, wrapping to its start.
+    if (m_ssd.col != m_ssd.col_end)
+    {
+        m_ssd.col = (m_ssd.col + 1) % SIM_DISPLAY_WIDTH;
+        return;
+    }
+    m_ssd.col = m_ssd.col_start;
+    m_ssd.row = (m_ssd.row != m_ssd.row_end) ? (m_ssd.row + 1) % SIM_DISPLAY_HEIGHT : m_ssd.row_start;
+}
+
+
+static void data_receive(uint8_t byte)
+{
+    if (m_ssd.writing)
+    {
+        if (!m_ssd.pixel_half)
+        {
+            m_ssd.pixel_msb  = byte;
+            m_ssd.pixel_half = true;
+        }
+        else
+        {
+            m_ssd.pixel_half = false;
+            pixel_write(((uint16_t)m_ssd.pixel_msb << 8) | byte);
+        }
+        return;
+    }
+
+    if ((m_ssd.cmd == 0) || (m_ssd.param_count >= m_param_counts[m_ssd.cmd]))
+    {
+        m_stats.ignored++;
+        return;
+    }
+
+    m_ssd.params[m_ssd.param_count++] = byte;
+    if (m_ssd.param_count == m_param_counts[m_ssd.cmd])
+    {
+        command_apply();
+    }
+}
+
+
+void sim_display_spi_byte(uint8_t byte)
+{
+    bool data;
+
+    // Chip select and D/C are sampled as the byte is clocked in.
+    if (sim_gpio_level_get(SIM_DISPLAY_PIN_CS))
+    {
+        return;
+    }
+    data = sim_gpio_level_get(SIM_DISPLAY_PIN_DC);
+
+    m_stats.bytes++;
+    trace_add(byte | (data ? SIM_DISPLAY_TRACE_DC : 0));
+
+    if (m_ssd.in_reset)
+    {
+        m_stats.ignored++;
+    }
+    else if (!data)
+    {
+        command_start(byte);
+    }
+    else
+    {
+        data_receive(byte);
+    }
+}
+
+
+bool sim_display_on(void)
+{
+    return m_ssd.on;
+}
+
+
+uint16_t sim_display_pixel_get(uint8_t x, uint8_t y)
+{
+    return m_ssd.ram[y % SIM_DISPLAY_HEIGHT][x % SIM_DISPLAY_WIDTH];
+}
+
+
+uint64_t sim_display_first_pixel_time(void)
+{
+    return m_first_pixel_time;
+}
+
+
+bool sim_display_ppm_save(char const * p_path)
+{
+    FILE   * p_file = fopen(p_path, "wb");
+    uint32_t x;
+    uint32_t y;
+    bool     ok;
+
+    if (p_file == NULL)
+    {
+        return false;
+    }
+
+    fprintf(p_file, "P6\n%u %u\n255\n", SIM_DISPLAY_WIDTH, SIM_DISPLAY_HEIGHT);
+    for (y = 0; y < SIM_DISPLAY_HEIGHT; y++)
+    {
+        for (x = 0; x < SIM_DISPLAY_WIDTH; x++)
+        {
+            uint16_t c      = m_ssd.on ? m_ssd.ram[y][x] : 0;
+            uint8_t  rgb[3] =
+            {
+                (uint8_t)(((c >> 11) & 0x1F) * 255 / 0x1F),
+                (uint8_t)(((c >> 5)  & 0x3F) * 255 / 0x3F),
+                (uint8_t)((c         & 0x1F) * 255 / 0x1F),
+            };
+            (void)fwrite(rgb, 1, sizeof(rgb), p_file);
+        }
+    }
+
+    ok = !ferror(p_file);
+    return (fclose(p_file) == 0) && ok;
+}
+
+
+uint16_t const * sim_display_trace_get(uint32_t * p_count)
+{
+    *p_count = m_trace_count;
+    return mp_trace;
+}
+
+
+void sim_display_trace_clear(void)
+{
+    m_trace_count = 0;
+}
+
+
+void sim_display_stats_get(sim_display_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
+
+
+void sim_display_stats_clear(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
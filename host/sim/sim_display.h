@@ -0,0 +1,79 @@
+/* Model of the SSD1351 OLED controller of the board, on SPI0 with chip select, D/C and reset pins.
+ *
+ * The SPI driver hands each byte sent with chip select low to the model, tagged with the level of
+ * the D/C pin. The model runs the commands the firmware uses: column and row windows (0x15, 0x75),
+ * RAM writes (0x5C) of RGB565 pixels, display on and off, the command lock, and the set-up commands
+ * with their parameter counts. Other bytes are counted, not applied. The reset pin clears the
+ * controller, not its RAM. The RAM is shown as written, row 0 at the top: the remapping and
+ * scan settings of the init sequence match the mounting of the panel.
+ *
+ * Every byte is also kept in a trace, in order, so tests can compare what went over the bus.
+ */
+
+#ifndef SIM_DISPLAY_H__
+#define SIM_DISPLAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_DISPLAY_WIDTH     128
+#define SIM_DISPLAY_HEIGHT    128
+
+/* Wiring of the board, as in src/display.h. */
+#define SIM_DISPLAY_PIN_CS    24
+#define SIM_DISPLAY_PIN_DC    23
+#define SIM_DISPLAY_PIN_RESET 20
+
+#define SIM_DISPLAY_TRACE_DC  0x100    /**< Set in a trace entry for a data byte, clear for a command. */
+
+/**@brief Counters of the model since the start or the last clear. */
+typedef struct
+{
+    uint32_t bytes;            /**< Bytes received with chip select low. */
+    uint32_t commands;         /**< Command bytes. */
+    uint32_t unknown;          /**< Command bytes that are no SSD1351 command. */
+    uint32_t ignored;          /**< Bytes not applied: in reset, locked, or data without a command. */
+    uint32_t pixels;           /**< Pixels written to RAM. */
+    uint32_t resets;           /**< Pulses of the reset pin. */
+    uint32_t short_resets;     /**< Of which shorter than the 2 us the controller needs. */
+} sim_display_stats_t;
+
+/**@brief Function for handing a byte sent over SPI to the model. Called by the SPI driver. */
+void sim_display_spi_byte(uint8_t byte);
+
+/**@brief Function for checking whether the panel is on. */
+bool sim_display_on(void);
+
+/**@brief Function for getting a pixel of the RAM, RGB565. */
+uint16_t sim_display_pixel_get(uint8_t x, uint8_t y);
+
+/**@brief Function for getting the time of the first pixel written since the last reset of the chip.
+ *
+ * @return Simulated time, SIM_TIME_NEVER if none yet.
+ */
+uint64_t sim_display_first_pixel_time(void);
+
+/**@brief Function for writing the screen to a PPM file: the RAM, RGB565 expanded to 8 bits per
+ *        channel, or black while the panel is off.
+ *
+ * @return false if the file could not be written.
+ */
+bool sim_display_ppm_save(char const * p_path);
+
+/**@brief Function for getting the trace of the bytes received, each a byte, with
+ *        SIM_DISPLAY_TRACE_DC for data.
+ *
+ * @param[out] p_count Number of entries.
+ */
+uint16_t const * sim_display_trace_get(uint32_t * p_count);
+
+/**@brief Function for clearing the trace. */
+void sim_display_trace_clear(void);
+
+/**@brief Function for getting the counters. */
+void sim_display_stats_get(sim_display_stats_t * p_stats);
+
+/**@brief Function for clearing the counters. */
+void sim_display_stats_clear(void);
+
+#endif /* SIM_DISPLAY_H__ */
@@ -0,0 +1,411 @@
+/* Model of the flash of the chip and of the SoftDevice flash API. */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "nrf_soc.h"
+#include "nrf_error.h"
+#include "sim.h"
+#include "sim_soc.h"
+#include "sim_flash.h"
+
+#define FLASH_SIZE       (SIM_FLASH_END - SIM_FLASH_START)
+#define FLASH_WORDS      (FLASH_SIZE / 4)
+#define WRITE_MAX_WORDS  1024
+#define WRITES_PER_ERASE 2              /**< Times a word may be programmed between erases. */
+
+typedef enum
+{
+    OP_NONE,
+    OP_WRITE,
+    OP_ERASE,
+} op_type_t;
+
+/**@brief Operation in progress. */
+static struct
+{
+    op_type_t        type;
+    uint32_t       * p_dst;
+    uint32_t const * p_src;
+    uint32_t         size;
+    uint32_t         page;
+    bool             fail;
+} m_op;
+
+static uint8_t          * mp_flash;      /**< Writable view of the region. */
+static uint8_t          * mp_write_count;/**< Times each word was programmed since its page was erased. */
+static sim_flash_config_t m_config;
+static sim_flash_stats_t  m_stats;
+static uint32_t           m_erase_counts[SIM_FLASH_PAGES];
+static uint32_t           m_loss_op;     /**< Operations left until the one cut by a power loss. */
+static uint32_t           m_loss_fraction;
+static uint32_t           m_error_op;    /**< Operations left until the first one ended with an error. */
+static bool               m_error_on;    /**< Operations end with an error from now on. */
+
+
+static void flash_reset(sim_reset_t reset)
+{
+    // An operation in progress is lost with the chip state; its event was dropped.
+    memset(&m_op, 0, sizeof(m_op));
+}
+
+
+/**@brief Function for mapping the region: read-only at its chip address for the firmware, and
+ *        writable elsewhere for the model, both views of one memory file. The content of the
+ *        current mapping, if any, is copied to the new one.
+ */
+static void flash_map(void)
+{
+    int       fd;
+    void    * p_ro;
+    uint8_t * p_rw;
+    int       fixed = (mp_flash != NULL) ? MAP_FIXED : MAP_FIXED_NOREPLACE;
+
+    fd = memfd_create("sim_flash", 0);
+    if ((fd < 0) || (ftruncate(fd, FLASH_SIZE) != 0))
+    {
+        perror("sim: flash");
+        exit(1);
+    }
+
+    p_rw = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p_rw == MAP_FAILED)
+    {
+        perror("sim: flash mapping");
+        exit(1);
+    }
+    if (mp_flash != NULL)
+    {
+        memcpy(p_rw, mp_flash, FLASH_SIZE);
+        (void)munmap(mp_flash, FLASH_SIZE);
+    }
+    else
+    {
+        memset(p_rw, 0xFF, FLASH_SIZE);
+        mp_write_count = calloc(FLASH_WORDS, 1);
+    }
+
+    p_ro = mmap((void *)SIM_FLASH_START, FLASH_SIZE, PROT_READ, MAP_SHARED | fixed, fd, 0);
+    if (p_ro != (void *)SIM_FLASH_START)
+    {
+        perror("sim: flash mapping");
+        exit(1);
+    }
+    close(fd);
+    mp_flash = p_rw;
+}
+
+
+/**@brief Function for giving a forked process a flash of its own: a shared mapping would let the
+ *        processes of the tests see each other's writes.
+ */
+static void flash_fork_child(void)
+{
+    flash_map();
+}
+
+
+static void __attribute__((constructor)) flash_constructor(void)
+{
+    flash_map();
+    (void)pthread_atfork(NULL, NULL, flash_fork_child);
+    sim_flash_config_default(&m_config);
+    sim_reset_hook_add(flash_reset);
+}
+
+
+void sim_flash_config_default(sim_flash_config_t * p_config)
+{
+    memset(p_config, 0, sizeof(*p_config));
+    p_config->write_overhead  = SIM_US(100);
+    p_config->write_word_time = SIM_US(41);
+    p_config->erase_time      = SIM_MS(85);
+}
+
+
+void sim_flash_config_set(sim_flash_config_t const * p_config)
+{
+    m_config = *p_config;
+}
+
+
+void sim_flash_power_loss_set(uint32_t op, uint32_t fraction)
+{
+    m_loss_op       = op;
+    m_loss_fraction = (fraction > 256) ? 256 : fraction;
+}
+
+
+void sim_flash_error_set(uint32_t op)
+{
+    m_error_op = op;
+    m_error_on = false;
+}
+
+
+void sim_flash_erase_all(void)
+{
+    memset(mp_flash, 0xFF, FLASH_SIZE);
+    memset(mp_write_count, 0, FLASH_WORDS);
+}
+
+
+bool sim_flash_load(char const * p_path)
+{
+    FILE * p_file = fopen(p_path, "rb");
+    bool   ok;
+
+    sim_flash_erase_all();
+    if (p_file == NULL)
+    {
+        return false;
+    }
+    ok = (fread(mp_flash, 1, FLASH_SIZE, p_file) == FLASH_SIZE);
+    fclose(p_file);
+    if (!ok)
+    {
+        sim_flash_erase_all();
+    }
+    return ok;
+}
+
+
+bool sim_flash_save(char const * p_path)
+{
+    FILE * p_file = fopen(p_path, "wb");
+    bool   ok;
+
+    if (p_file == NULL)
+    {
+        return false;
+    }
+    ok = (fwrite(mp_flash, 1, FLASH_SIZE, p_file) == FLASH_SIZE);
+    return (fclose(p_file) == 0) && ok;
+}
+
+
+void sim_flash_stats_get(sim_flash_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
+
+
+void sim_flash_stats_clear(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+uint32_t sim_flash_page_erase_count(uint32_t page)
+{
+    return (page < SIM_FLASH_PAGES) ? m_erase_counts[page] : 0;
+}
+
+
+bool sim_flash_busy(void)
+{
+    return m_op.type != OP_NONE;
+}
+
+
+/**@brief Function for programming a word: bits can only be cleared. */
+static void word_program(uint32_t index, uint32_t value)
+{
+    uint32_t * p_word = (uint32_t *)mp_flash + index;
+
+    *p_word &= value;
+    if (mp_write_count[index] < 0xFF)
+    {
+        mp_write_count[index]++;
+    }
+    if (mp_write_count[index] == WRITES_PER_ERASE + 1)
+    {
+        m_stats.overwrites++;
+    }
+    m_stats.words++;
+}
+
+
+static void page_erase(uint32_t page)
+{
+    uint32_t offset = page * SIM_FLASH_PAGE_SIZE - SIM_FLASH_START;
+
+    memset(mp_flash + offset, 0xFF, SIM_FLASH_PAGE_SIZE);
+    memset(mp_write_count + offset / 4, 0, SIM_FLASH_PAGE_SIZE / 4);
+    m_erase_counts[page]++;
+}
+
+
+/**@brief Function for applying the operation in progress, up to a part of it in 1/256. */
+static void op_apply(uint32_t fraction)
+{
+    uint32_t index = ((uint32_t)(uintptr_t)m_op.p_dst - SIM_FLASH_START) / 4;
+    uint32_t done;
+    uint32_t i;
+
+    if (m_op.type == OP_WRITE)
+    {
+        done = (m_op.size * fraction) / 256;
+        for (i = 0; i < done; i++)
+        {
+            word_program(index + i, m_op.p_src[i]);
+        }
+        if (done < m_op.size && fraction < 256)
+        {
+            // The word being programmed at the cut has some of its bits cleared.
+            word_program(index + done, m_op.p_src[done] | sim_rand());
+        }
+    }
+    else if (m_op.type == OP_ERASE)
+    {
+        if (fraction == 256)
+        {
+            page_erase(m_op.page);
+        }
+        else
+        {
+            // A cut erase leaves some bits set and others not.
+            uint32_t * p_page = (uint32_t *)(mp_flash + m_op.page * SIM_FLASH_PAGE_SIZE - SIM_FLASH_START);
+
+            for (i = 0; i < SIM_FLASH_PAGE_SIZE / 4; i++)
+            {
+                p_page[i] |= sim_rand();
+            }
+            m_erase_counts[m_op.page]++;
+        }
+    }
+}
+
+
+static void op_done(void * p_context)
+{
+    bool fail = m_op.fail;
+
+    if (!fail)
+    {
+        op_apply(256);
+        if (m_op.type == OP_WRITE)
+        {
+            m_stats.writes++;
+        }
+        else
+        {
+            m_stats.erases++;
+        }
+    }
+    else
+    {
+        m_stats.errors++;
+    }
+    m_op.type = OP_NONE;
+
+    sim_soc_evt_push(fail ? NRF_EVT_FLASH_OPERATION_ERROR : NRF_EVT_FLASH_OPERATION_SUCCESS);
+}
+
+
+/**@brief Function for ending the operation of another flash user, which made a call busy. */
+static void foreign_op_done(void * p_context)
+{
+    sim_soc_evt_push(NRF_EVT_FLASH_OPERATION_SUCCESS);
+}
+
+
+static void op_power_loss(void * p_context)
+{
+    op_apply(m_loss_fraction);
+    m_stats.power_losses++;
+    m_op.type = OP_NONE;
+    sim_reset(SIM_RESET_POWER_ON);
+}
+
+
+/**@brief Function for starting an operation set up in m_op. */
+static uint32_t op_start(uint64_t duration)
+{
+    if (sim_chance(m_config.busy_ppm))
+    {
+        // The SoftDevice is busy with an operation of its own, whose event the caller waits for.
+        (void)sim_at(sim_time() + m_config.write_overhead, SIM_OWNER_DEVICE, foreign_op_done, NULL);
+        m_op.type = OP_NONE;
+        m_stats.busy++;
+        return NRF_ERROR_BUSY;
+    }
+
+    m_op.fail = sim_chance(m_config.error_ppm);
+    if ((m_error_op != 0) && (--m_error_op == 0))
+    {
+        m_error_on = true;
+    }
+    m_op.fail = m_op.fail || m_error_on;
+
+    if ((m_loss_op != 0) && (--m_loss_op == 0))
+    {
+        (void)sim_at(sim_time() + (duration * m_loss_fraction) / 256, SIM_OWNER_DEVICE, op_power_loss, NULL);
+    }
+    else
+    {
+        (void)sim_at(sim_time() + duration, SIM_OWNER_DEVICE, op_done, NULL);
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_flash_write(uint32_t * const p_dst, uint32_t const * const p_src, uint32_t size)
+{
+    uint32_t dst = (uint32_t)(uintptr_t)p_dst;
+
+    if (((dst & 3) != 0) || (((uintptr_t)p_src & 3) != 0))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if ((size == 0) || (size > WRITE_MAX_WORDS))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (dst < SIM_FLASH_START)
+    {
+        return NRF_ERROR_FORBIDDEN;
+    }
+    if ((dst >= SIM_FLASH_END) || (size * 4 > SIM_FLASH_END - dst))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (m_op.type != OP_NONE)
+    {
+        m_stats.busy++;
+        return NRF_ERROR_BUSY;
+    }
+
+    // The source is read when the operation runs, so it must stay valid until the event.
+    m_op.type  = OP_WRITE;
+    m_op.p_dst = p_dst;
+    m_op.p_src = p_src;
+    m_op.size  = size;
+    return op_start(m_config.write_overhead + size * m_config.write_word_time);
+}
+
+
+uint32_t sd_flash_page_erase(uint32_t page_number)
+{
+    if (page_number >= SIM_FLASH_PAGES)
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (page_number * SIM_FLASH_PAGE_SIZE < SIM_FLASH_START)
+    {
+        return NRF_ERROR_FORBIDDEN;
+    }
+    if (m_op.type != OP_NONE)
+    {
+        m_stats.busy++;
+        return NRF_ERROR_BUSY;
+    }
+
+    m_op.type = OP_ERASE;
+    m_op.page = page_number;
+    return op_start(m_config.erase_time);
+}
@@ -0,0 +1,96 @@
+/* Model of the flash of the chip and of the SoftDevice flash API, sd_flash_write() and
+ * sd_flash_page_erase().
+ *
+ * The code region of the application is mapped read-only at its address on the chip, so the
+ * firmware reads flash through plain pointers as on the target, and a stray write faults. Writes
+ * go through the SoftDevice calls: an operation takes the configured time, then applies and ends
+ * with NRF_EVT_FLASH_OPERATION_SUCCESS or NRF_EVT_FLASH_OPERATION_ERROR. Programming only clears
+ * bits, as on the chip. The flash keeps its content across resets.
+ *
+ * Faults: a call can be refused with NRF_ERROR_BUSY, as if the SoftDevice were busy with an
+ * operation of its own that ends with an event shortly after, an operation can time out with an
+ * error event and no effect, and power can be lost during a chosen operation, which then applies in
+ * part before the chip restarts with a power-on reset.
+ */
+
+#ifndef SIM_FLASH_H__
+#define SIM_FLASH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_FLASH_START      0x0001F000UL     /**< Start of the application region, after the SoftDevice. */
+#define SIM_FLASH_END        0x00080000UL     /**< End of flash. */
+#define SIM_FLASH_PAGE_SIZE  4096
+#define SIM_FLASH_PAGES      (SIM_FLASH_END / SIM_FLASH_PAGE_SIZE)
+
+/**@brief Timing and fault settings. */
+typedef struct
+{
+    uint64_t write_overhead;   /**< Time of a write operation besides its words. */
+    uint64_t write_word_time;  /**< Time to program one word. */
+    uint64_t erase_time;       /**< Time to erase a page. */
+    uint32_t busy_ppm;         /**< Probability of a call refused with NRF_ERROR_BUSY, per million. */
+    uint32_t error_ppm;        /**< Probability of an operation ending with an error event, per million. */
+} sim_flash_config_t;
+
+/**@brief Counters. */
+typedef struct
+{
+    uint32_t writes;           /**< Write operations done, sd_flash_write() calls accepted. */
+    uint32_t words;            /**< Words programmed. */
+    uint32_t erases;           /**< Pages erased. */
+    uint32_t busy;             /**< Calls refused with NRF_ERROR_BUSY. */
+    uint32_t errors;           /**< Operations ended with an error event. */
+    uint32_t overwrites;       /**< Words programmed more than twice between erases. */
+    uint32_t power_losses;     /**< Operations cut by a power loss. */
+} sim_flash_stats_t;
+
+/**@brief Function for setting the timing and fault settings. sim_flash_config_default() gives
+ *        the nRF52832 timing and no faults.
+ */
+void sim_flash_config_set(sim_flash_config_t const * p_config);
+
+/**@brief Function for getting the default settings. */
+void sim_flash_config_default(sim_flash_config_t * p_config);
+
+/**@brief Function for cutting the power during an operation.
+ *
+ * @param[in] op        Operation to cut, counted from 1 from now; 0 cancels.
+ * @param[in] fraction  Part of the operation done before the cut, in 1/256.
+ */
+void sim_flash_power_loss_set(uint32_t op, uint32_t fraction);
+
+/**@brief Function for ending operations with an error event, as worn out flash does. pstorage
+ *        retries a failed operation many times before it reports the error.
+ *
+ * @param[in] op  First operation to fail, counted from 1 from now; all the following ones fail
+ *                too. 0 cancels.
+ */
+void sim_flash_error_set(uint32_t op);
+
+/**@brief Function for erasing all of the application region. */
+void sim_flash_erase_all(void);
+
+/**@brief Function for loading the application region from a file written by sim_flash_save().
+ *
+ * @return false if the file cannot be read; the flash is then erased.
+ */
+bool sim_flash_load(char const * p_path);
+
+/**@brief Function for saving the application region to a file. */
+bool sim_flash_save(char const * p_path);
+
+/**@brief Function for getting the counters. */
+void sim_flash_stats_get(sim_flash_stats_t * p_stats);
+
+/**@brief Function for clearing the counters. */
+void sim_flash_stats_clear(void);
+
+/**@brief Function for getting the number of times a page was erased since the start. */
+uint32_t sim_flash_page_erase_count(uint32_t page);
+
+/**@brief Function for checking whether a flash operation is in progress. */
+bool sim_flash_busy(void);
+
+#endif /* SIM_FLASH_H__ */
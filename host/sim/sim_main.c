@@ -0,0 +1,117 @@
+/* Simulator of the watch: the firmware on the simulation layer, driven by a script.
+ *
+ *   pixwatch_sim [-s script] [-t seconds] [-f flash.bin] [-o screen.ppm] [-r seed] [-q]
+ *
+ *   -s  script of the world around the watch, see sim_script.h
+ *   -t  simulated time to run, 60 s by default
+ *   -f  flash image, loaded at the start if it exists and saved at the end
+ *   -o  screen at the end, as a PPM file
+ *   -r  seed of the models
+ *   -q  no log on stdout
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim.h"
+#include "sim_flash.h"
+#include "sim_uart.h"
+#include "sim_display.h"
+#include "sim_script.h"
+
+
+static void usage(char const * p_name)
+{
+    fprintf(stderr, "usage: %s [-s script] [-t seconds] [-f flash.bin] [-o screen.ppm] [-r seed] [-q]\n",
+            p_name);
+    exit(2);
+}
+
+
+int main(int argc, char * argv[])
+{
+    char const    * p_flash  = NULL;
+    char const    * p_screen = NULL;
+    double          seconds  = 60;
+    bool            quiet    = false;
+    struct timespec start;
+    struct timespec end;
+    double          wall;
+    int             status;
+    int             opt;
+
+    // localtime() of the firmware is UTC, as on the chip.
+    (void)setenv("TZ", "UTC", 1);
+    tzset();
+
+    while ((opt = getopt(argc, argv, "s:t:f:o:r:q")) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+                if (!sim_script_load(optarg))
+                {
+                    return 2;
+                }
+                break;
+
+            case 't':
+                seconds = strtod(optarg, NULL);
+                break;
+
+            case 'f':
+                p_flash = optarg;
+                break;
+
+            case 'o':
+                p_screen = optarg;
+                break;
+
+            case 'r':
+                sim_seed(strtoul(optarg, NULL, 0));
+                break;
+
+            case 'q':
+                quiet = true;
+                break;
+
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+    if ((optind != argc) || (seconds <= 0))
+    {
+        usage(argv[0]);
+    }
+
+    if ((p_flash != NULL) && (access(p_flash, F_OK) == 0) && !sim_flash_load(p_flash))
+    {
+        fprintf(stderr, "sim: cannot read %s\n", p_flash);
+        return 1;
+    }
+
+    sim_uart_echo_set(!quiet);
+    sim_end_set((uint64_t)(seconds * 1e9));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    status = sim_script_run();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "sim: %.3f s simulated in %.3f s, %u boots\n",
+            (double)sim_time() / SIM_S(1), wall, sim_boot_count());
+
+    if ((p_flash != NULL) && !sim_flash_save(p_flash))
+    {
+        fprintf(stderr, "sim: cannot write %s\n", p_flash);
+        status = 1;
+    }
+    if ((p_screen != NULL) && !sim_display_ppm_save(p_screen))
+    {
+        fprintf(stderr, "sim: cannot write %s\n", p_screen);
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,775 @@
+/* Model of a phone. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ble_gatt.h"
+#include "ble_hci.h"
+#include "nordic_common.h"
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_peer.h"
+
+#define UUID_PRIMARY_SERVICE  0x2800
+#define UUID_CHARACTERISTIC   0x2803
+#define UUID_CCCD             0x2902
+
+#define ATT_ERR_INVALID_HANDLE      0x01
+#define ATT_ERR_INVALID_PDU         0x04
+#define ATT_ERR_REQUEST_NOT_SUPP    0x06
+#define ATT_ERR_INVALID_OFFSET      0x07
+#define ATT_ERR_PREPARE_QUEUE_FULL  0x09
+#define ATT_ERR_NOT_FOUND           0x0A
+#define ATT_ERR_INVALID_LENGTH      0x0D
+#define ATT_ERR_UNSUPP_GROUP_TYPE   0x10
+
+#define PEER_INTERVAL         24        /**< 30 ms, as phones open links. */
+#define PEER_SUP_TIMEOUT      400       /**< 4 s. */
+#define PEER_INTERVAL_MIN     6
+#define PEER_INTERVAL_MAX     1600      /**< 2 s, the longest a phone accepts. */
+
+/* PixWatch Service, FBA2xxxx-4C50-4FCC-8BB4-20768A0787DB. */
+static const uint8_t m_pixwatch_base[16] =
+{
+    0xDB, 0x87, 0x07, 0x8A, 0x76, 0x20, 0xB4, 0x8B, 0xCC, 0x4F, 0x50, 0x4C, 0x00, 0x00, 0xA2, 0xFB
+};
+
+
+static uint16_t get16(uint8_t const * p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+
+static void put16(uint8_t * p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+
+static sim_peer_t * peer_of(sim_ble_central_t * p_central)
+{
+    return p_central->p_context;
+}
+
+
+static void evt_send(sim_peer_t * p_peer, sim_peer_evt_type_t type, uint8_t reason, uint16_t handle,
+                     uint8_t const * p_data, uint16_t len)
+{
+    sim_peer_evt_t evt;
+
+    if (p_peer->evt_handler == NULL)
+    {
+        return;
+    }
+    memset(&evt, 0, sizeof(evt));
+    evt.type   = type;
+    evt.reason = reason;
+    evt.handle = handle;
+    evt.p_data = p_data;
+    evt.len    = len;
+    p_peer->evt_handler(p_peer, &evt);
+}
+
+
+static sim_peer_attr_t * attr_get(sim_peer_t * p_peer, uint16_t handle)
+{
+    return ((handle == 0) || (handle > p_peer->attr_count)) ? NULL : &p_peer->attrs[handle - 1];
+}
+
+
+static bool attr_is(sim_peer_attr_t const * p_attr, uint16_t type16)
+{
+    return (p_attr->type_len == 2) && (get16(p_attr->type) == type16);
+}
+
+
+static uint16_t attr_add(sim_peer_t * p_peer, uint8_t const * p_type, uint8_t type_len,
+                         uint8_t const * p_value, uint16_t len)
+{
+    sim_peer_attr_t * p_attr;
+
+    if ((p_peer->attr_count == SIM_PEER_ATTRS_MAX) || (len > SIM_PEER_VALUE_MAX))
+    {
+        fprintf(stderr, "sim: phone attribute table full\n");
+        abort();
+    }
+    p_attr = &p_peer->attrs[p_peer->attr_count++];
+    memset(p_attr, 0, sizeof(*p_attr));
+    memcpy(p_attr->type, p_type, type_len);
+    p_attr->type_len = type_len;
+    if (p_value != NULL)
+    {
+        memcpy(p_attr->value, p_value, len);
+    }
+    p_attr->len = len;
+    return p_peer->attr_count;
+}
+
+
+static uint16_t attr16_add(sim_peer_t * p_peer, uint16_t type16, uint8_t const * p_value, uint16_t len)
+{
+    uint8_t type[2];
+
+    put16(type, type16);
+    return attr_add(p_peer, type, 2, p_value, len);
+}
+
+
+uint16_t sim_peer_service_add(sim_peer_t * p_peer, uint8_t const * p_uuid, uint8_t uuid_len)
+{
+    uint16_t handle = attr16_add(p_peer, UUID_PRIMARY_SERVICE, p_uuid, uuid_len);
+    uint16_t i;
+
+    // The previous service ends before this one.
+    for (i = handle - 1; i > 0; i--)
+    {
+        if (attr_is(&p_peer->attrs[i - 1], UUID_PRIMARY_SERVICE))
+        {
+            p_peer->attrs[i - 1].group_end = handle - 1;
+            break;
+        }
+    }
+    p_peer->attrs[handle - 1].group_end = 0xFFFF;
+    return handle;
+}
+
+
+uint16_t sim_peer_char_add(sim_peer_t * p_peer, uint8_t const * p_uuid, uint8_t uuid_len, uint8_t props,
+                           uint8_t const * p_value, uint16_t len)
+{
+    uint8_t  decl[3 + 16];
+    uint16_t value_handle;
+
+    decl[0] = props;
+    put16(&decl[1], p_peer->attr_count + 2);
+    memcpy(&decl[3], p_uuid, uuid_len);
+    (void)attr16_add(p_peer, UUID_CHARACTERISTIC, decl, 3 + uuid_len);
+
+    value_handle = attr_add(p_peer, p_uuid, uuid_len, p_value, len);
+    if (props & (BLE_GATT_HVX_NOTIFICATION << 4 | BLE_GATT_HVX_INDICATION << 4))
+    {
+        uint8_t cccd[2] = {0, 0};
+
+        (void)attr16_add(p_peer, UUID_CCCD, cccd, sizeof(cccd));
+    }
+    return value_handle;
+}
+
+
+void sim_peer_pixwatch_add(sim_peer_t * p_peer)
+{
+    static const uint16_t uuids[4] = {0x1530, 0x1531, 0x1532, 0x1533};
+    static const uint8_t  lens[4]  = {4, 1, 12, 3};
+    uint8_t               uuid[16];
+    uint8_t               value[12];
+    uint32_t              i;
+
+    memcpy(uuid, m_pixwatch_base, sizeof(uuid));
+    put16(&uuid[12], 0x1525);
+    (void)sim_peer_service_add(p_peer, uuid, sizeof(uuid));
+
+    memset(value, 0, sizeof(value));
+    for (i = 0; i < 4; i++)
+    {
+        put16(&uuid[12], uuids[i]);
+        // Read, and notify for the local time.
+        p_peer->pixwatch_handles[i] = sim_peer_char_add(p_peer, uuid, sizeof(uuid), (i == 0) ? 0x12 : 0x02,
+                                                        value, lens[i]);
+    }
+}
+
+
+void sim_peer_value_set(sim_peer_t * p_peer, uint16_t handle, uint8_t const * p_value, uint16_t len)
+{
+    sim_peer_attr_t * p_attr = attr_get(p_peer, handle);
+
+    if ((p_attr != NULL) && (len <= SIM_PEER_VALUE_MAX))
+    {
+        memcpy(p_attr->value, p_value, len);
+        p_attr->len = len;
+    }
+}
+
+
+sim_peer_attr_t const * sim_peer_attr_get(sim_peer_t const * p_peer, uint16_t handle)
+{
+    return ((handle == 0) || (handle > p_peer->attr_count)) ? NULL : &p_peer->attrs[handle - 1];
+}
+
+
+uint16_t sim_peer_cccd_get(sim_peer_t const * p_peer, uint16_t value_handle)
+{
+    sim_peer_attr_t const * p_attr = sim_peer_attr_get(p_peer, value_handle + 1);
+
+    return ((p_attr != NULL) && attr_is(p_attr, UUID_CCCD)) ? get16(p_attr->value) : 0;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * GATT server.
+ */
+
+static void send(sim_peer_t * p_peer, uint8_t const * p_pdu, uint16_t len)
+{
+    if (!sim_ble_att_send(&p_peer->central, p_pdu, len))
+    {
+        fprintf(stderr, "sim: phone cannot send, link down or queue full\n");
+    }
+}
+
+
+static void error_send(sim_peer_t * p_peer, uint8_t req, uint16_t handle, uint8_t code)
+{
+    uint8_t pdu[5];
+
+    pdu[0] = SIM_ATT_ERROR_RSP;
+    pdu[1] = req;
+    put16(&pdu[2], handle);
+    pdu[4] = code;
+    send(p_peer, pdu, sizeof(pdu));
+}
+
+
+static bool type_matches(sim_peer_attr_t const * p_attr, uint8_t const * p_type, uint8_t type_len)
+{
+    return (p_attr->type_len == type_len) && (memcmp(p_attr->type, p_type, type_len) == 0);
+}
+
+
+static void find_by_type(sim_peer_t * p_peer, uint8_t const * p_pdu, uint16_t len)
+{
+    uint16_t start = get16(&p_pdu[1]);
+    uint16_t end   = get16(&p_pdu[3]);
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t rsp_len = 1;
+    uint32_t handle;
+
+    for (handle = start; (handle <= end) && (handle <= p_peer->attr_count); handle++)
+    {
+        sim_peer_attr_t const * p_attr = &p_peer->attrs[handle - 1];
+
+        if (!attr_is(p_attr, get16(&p_pdu[5])) || (p_attr->len != len - 7) ||
+            (memcmp(p_attr->value, &p_pdu[7], p_attr->len) != 0))
+        {
+            continue;
+        }
+        if (rsp_len + 4 > SIM_BLE_ATT_MTU)
+        {
+            break;
+        }
+        put16(&rsp[rsp_len], handle);
+        put16(&rsp[rsp_len + 2], p_attr->group_end ? p_attr->group_end : handle);
+        rsp_len += 4;
+    }
+    if (rsp_len == 1)
+    {
+        error_send(p_peer, p_pdu[0], start, ATT_ERR_NOT_FOUND);
+        return;
+    }
+    rsp[0] = SIM_ATT_FIND_BY_TYPE_RSP;
+    send(p_peer, rsp, rsp_len);
+}
+
+
+/**@brief Function for answering Read By Type and Read By Group Type requests. */
+static void read_by_type(sim_peer_t * p_peer, uint8_t const * p_pdu, uint16_t len)
+{
+    bool     group     = (p_pdu[0] == SIM_ATT_READ_BY_GROUP_REQ);
+    uint16_t start     = get16(&p_pdu[1]);
+    uint16_t end       = get16(&p_pdu[3]);
+    uint8_t  head      = group ? 4 : 2;
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t rsp_len   = 2;
+    uint8_t  entry_len = 0;
+    uint32_t handle;
+
+    if (group && ((len != 7) || (get16(&p_pdu[5]) != UUID_PRIMARY_SERVICE)))
+    {
+        error_send(p_peer, p_pdu[0], start, ATT_ERR_UNSUPP_GROUP_TYPE);
+        return;
+    }
+    for (handle = start; (handle <= end) && (handle <= p_peer->attr_count); handle++)
+    {
+        sim_peer_attr_t const * p_attr    = &p_peer->attrs[handle - 1];
+        uint16_t                value_len = p_attr->len;
+
+        if (!type_matches(p_attr, &p_pdu[5], (uint8_t)(len - 5)))
+        {
+            continue;
+        }
+        if (value_len > SIM_BLE_ATT_MTU - 2 - head)
+        {
+            value_len = SIM_BLE_ATT_MTU - 2 - head;
+        }
+        if (entry_len == 0)
+        {
+            entry_len = (uint8_t)(head + value_len);
+        }
+        else if ((head + value_len != entry_len) || (rsp_len + entry_len > SIM_BLE_ATT_MTU))
+        {
+            break;
+        }
+        put16(&rsp[rsp_len], handle);
+        if (group)
+        {
+            put16(&rsp[rsp_len + 2], p_attr->group_end);
+        }
+        memcpy(&rsp[rsp_len + head], p_attr->value, value_len);
+        rsp_len += entry_len;
+    }
+    if (entry_len == 0)
+    {
+        error_send(p_peer, p_pdu[0], start, ATT_ERR_NOT_FOUND);
+        return;
+    }
+    rsp[0] = (uint8_t)(p_pdu[0] + 1);
+    rsp[1] = entry_len;
+    send(p_peer, rsp, rsp_len);
+}
+
+
+static void find_info(sim_peer_t * p_peer, uint8_t const * p_pdu)
+{
+    uint16_t start   = get16(&p_pdu[1]);
+    uint16_t end     = get16(&p_pdu[3]);
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t rsp_len = 2;
+    uint8_t  type_len = 0;
+    uint32_t handle;
+
+    for (handle = start; (handle <= end) && (handle <= p_peer->attr_count); handle++)
+    {
+        sim_peer_attr_t const * p_attr = &p_peer->attrs[handle - 1];
+
+        if (((type_len != 0) && (p_attr->type_len != type_len)) ||
+            (rsp_len + 2 + p_attr->type_len > SIM_BLE_ATT_MTU))
+        {
+            break;
+        }
+        type_len = p_attr->type_len;
+        put16(&rsp[rsp_len], handle);
+        memcpy(&rsp[rsp_len + 2], p_attr->type, type_len);
+        rsp_len += 2 + type_len;
+    }
+    if (type_len == 0)
+    {
+        error_send(p_peer, p_pdu[0], start, ATT_ERR_NOT_FOUND);
+        return;
+    }
+    rsp[0] = SIM_ATT_FIND_INFO_RSP;
+    rsp[1] = (type_len == 2) ? 1 : 2;
+    send(p_peer, rsp, rsp_len);
+}
+
+
+static void read(sim_peer_t * p_peer, uint8_t const * p_pdu, uint16_t len)
+{
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t rsp_len = 1;
+    uint16_t i;
+
+    p_peer->stats.reads++;
+    for (i = 1; i + 1 < len; i += 2)
+    {
+        uint16_t                handle = get16(&p_pdu[i]);
+        sim_peer_attr_t const * p_attr = attr_get(p_peer, handle);
+        uint16_t                offset = (p_pdu[0] == SIM_ATT_READ_BLOB_REQ) ? get16(&p_pdu[3]) : 0;
+        uint16_t                value_len;
+
+        if (p_attr == NULL)
+        {
+            error_send(p_peer, p_pdu[0], handle, ATT_ERR_INVALID_HANDLE);
+            return;
+        }
+        if (offset > p_attr->len)
+        {
+            error_send(p_peer, p_pdu[0], handle, ATT_ERR_INVALID_OFFSET);
+            return;
+        }
+        value_len = MIN(p_attr->len - offset, SIM_BLE_ATT_MTU - rsp_len);
+        memcpy(&rsp[rsp_len], p_attr->value + offset, value_len);
+        rsp_len += value_len;
+        if (p_pdu[0] != SIM_ATT_READ_MULTI_REQ)
+        {
+            break;
+        }
+    }
+    rsp[0] = (uint8_t)(p_pdu[0] + 1);
+    send(p_peer, rsp, rsp_len);
+}
+
+
+/**@brief Function for applying a write of the firmware, reported to the owner if evt is set. */
+static bool write_apply(sim_peer_t * p_peer, uint16_t handle, uint16_t offset, uint8_t const * p_data,
+                        uint16_t len, bool evt)
+{
+    sim_peer_attr_t * p_attr = attr_get(p_peer, handle);
+
+    if ((p_attr == NULL) || (offset + len > SIM_PEER_VALUE_MAX))
+    {
+        return false;
+    }
+    memcpy(p_attr->value + offset, p_data, len);
+    p_attr->len = offset + len;
+    p_peer->stats.writes++;
+    if (evt && !attr_is(p_attr, UUID_CCCD))
+    {
+        evt_send(p_peer, SIM_PEER_EVT_WRITE, 0, handle, p_attr->value, p_attr->len);
+    }
+    return true;
+}
+
+
+/**@brief Function for checking whether the queued prepared writes after offset write handle. */
+static bool prepared_later(sim_peer_t const * p_peer, uint16_t offset, uint16_t handle)
+{
+    for (offset += 6 + get16(&p_peer->prep[offset + 4]); offset + 6 <= p_peer->prep_len;
+         offset += 6 + get16(&p_peer->prep[offset + 4]))
+    {
+        if (get16(&p_peer->prep[offset]) == handle)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**@brief Function for executing the queued prepared writes: entries of handle, offset, length and
+ *        data. Each attribute written is reported once, with its whole value.
+ */
+static bool prepared_execute(sim_peer_t * p_peer)
+{
+    uint16_t offset = 0;
+    bool     ok     = true;
+
+    while (offset + 6 <= p_peer->prep_len)
+    {
+        uint16_t handle       = get16(&p_peer->prep[offset]);
+        uint16_t value_offset = get16(&p_peer->prep[offset + 2]);
+        uint16_t len          = get16(&p_peer->prep[offset + 4]);
+
+        ok = ok && write_apply(p_peer, handle, value_offset, &p_peer->prep[offset + 6], len,
+                               !prepared_later(p_peer, offset, handle));
+        offset += 6 + len;
+    }
+    p_peer->prep_len = 0;
+    return ok;
+}
+
+
+static void server_request(sim_peer_t * p_peer, uint8_t const * p_pdu, uint16_t len)
+{
+    uint8_t  rsp[SIM_BLE_ATT_MTU];
+    uint16_t prep_max;
+
+    if (!(p_pdu[0] & SIM_ATT_CMD_FLAG) && (p_pdu[0] != SIM_ATT_HVC))
+    {
+        p_peer->stats.requests++;
+    }
+    switch (p_pdu[0])
+    {
+        case SIM_ATT_MTU_REQ:
+            rsp[0] = SIM_ATT_MTU_RSP;
+            put16(&rsp[1], SIM_BLE_ATT_MTU);
+            send(p_peer, rsp, 3);
+            break;
+
+        case SIM_ATT_FIND_BY_TYPE_REQ:
+            find_by_type(p_peer, p_pdu, len);
+            break;
+
+        case SIM_ATT_READ_BY_TYPE_REQ:
+        case SIM_ATT_READ_BY_GROUP_REQ:
+            read_by_type(p_peer, p_pdu, len);
+            break;
+
+        case SIM_ATT_FIND_INFO_REQ:
+            find_info(p_peer, p_pdu);
+            break;
+
+        case SIM_ATT_READ_REQ:
+        case SIM_ATT_READ_BLOB_REQ:
+        case SIM_ATT_READ_MULTI_REQ:
+            read(p_peer, p_pdu, len);
+            break;
+
+        case SIM_ATT_WRITE_REQ:
+            if (!write_apply(p_peer, get16(&p_pdu[1]), 0, &p_pdu[3], len - 3, true))
+            {
+                error_send(p_peer, p_pdu[0], get16(&p_pdu[1]), ATT_ERR_INVALID_HANDLE);
+                break;
+            }
+            rsp[0] = SIM_ATT_WRITE_RSP;
+            send(p_peer, rsp, 1);
+            break;
+
+        case SIM_ATT_WRITE_CMD:
+            (void)write_apply(p_peer, get16(&p_pdu[1]), 0, &p_pdu[3], len - 3, true);
+            break;
+
+        case SIM_ATT_PREP_WRITE_REQ:
+            prep_max = (p_peer->prep_max != 0) ? p_peer->prep_max : SIM_PEER_PREP_MAX;
+            if (attr_get(p_peer, get16(&p_pdu[1])) == NULL)
+            {
+                error_send(p_peer, p_pdu[0], get16(&p_pdu[1]), ATT_ERR_INVALID_HANDLE);
+                break;
+            }
+            if (p_peer->prep_len + 6 + (len - 5) > prep_max)
+            {
+                error_send(p_peer, p_pdu[0], get16(&p_pdu[1]), ATT_ERR_PREPARE_QUEUE_FULL);
+                break;
+            }
+            memcpy(&p_peer->prep[p_peer->prep_len], &p_pdu[1], 4);
+            put16(&p_peer->prep[p_peer->prep_len + 4], len - 5);
+            memcpy(&p_peer->prep[p_peer->prep_len + 6], &p_pdu[5], len - 5);
+            p_peer->prep_len += 6 + (len - 5);
+
+            // The response echoes the request.
+            memcpy(rsp, p_pdu, len);
+            rsp[0] = SIM_ATT_PREP_WRITE_RSP;
+            send(p_peer, rsp, len);
+            break;
+
+        case SIM_ATT_EXEC_WRITE_REQ:
+            if ((p_pdu[1] == 0) || prepared_execute(p_peer))
+            {
+                p_peer->prep_len = 0;
+                rsp[0] = SIM_ATT_EXEC_WRITE_RSP;
+                send(p_peer, rsp, 1);
+            }
+            else
+            {
+                error_send(p_peer, p_pdu[0], 0, ATT_ERR_INVALID_LENGTH);
+            }
+            break;
+
+        case SIM_ATT_HVC:
+            break;
+
+        default:
+            if (!(p_pdu[0] & SIM_ATT_CMD_FLAG))
+            {
+                error_send(p_peer, p_pdu[0], 0, ATT_ERR_REQUEST_NOT_SUPP);
+            }
+            break;
+    }
+}
+
+
+bool sim_peer_hvx(sim_peer_t * p_peer, uint16_t value_handle, uint8_t const * p_data, uint16_t len)
+{
+    uint16_t cccd = sim_peer_cccd_get(p_peer, value_handle);
+    uint8_t  pdu[SIM_BLE_ATT_MTU];
+
+    if ((cccd == 0) || (len > SIM_BLE_ATT_MTU - 3))
+    {
+        return false;
+    }
+    pdu[0] = (cccd & BLE_GATT_HVX_NOTIFICATION) ? SIM_ATT_HVN : SIM_ATT_HVI;
+    put16(&pdu[1], value_handle);
+    memcpy(&pdu[3], p_data, len);
+    if (!sim_ble_att_send(&p_peer->central, pdu, 3 + len))
+    {
+        return false;
+    }
+    p_peer->stats.notifications++;
+    return true;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * GATT client.
+ */
+
+bool sim_peer_request(sim_peer_t * p_peer, uint8_t const * p_pdu, uint16_t len)
+{
+    bool command = (p_pdu[0] & SIM_ATT_CMD_FLAG) != 0;
+
+    if ((!command && (p_peer->client_op != 0)) || !sim_ble_att_send(&p_peer->central, p_pdu, len))
+    {
+        return false;
+    }
+    if (!command)
+    {
+        p_peer->client_op = p_pdu[0];
+    }
+    return true;
+}
+
+
+bool sim_peer_write(sim_peer_t * p_peer, uint16_t handle, uint8_t const * p_data, uint16_t len, bool request)
+{
+    uint8_t pdu[SIM_BLE_ATT_MTU];
+
+    if (len > SIM_BLE_ATT_MTU - 3)
+    {
+        return false;
+    }
+    pdu[0] = request ? SIM_ATT_WRITE_REQ : SIM_ATT_WRITE_CMD;
+    put16(&pdu[1], handle);
+    memcpy(&pdu[3], p_data, len);
+    return sim_peer_request(p_peer, pdu, 3 + len);
+}
+
+
+bool sim_peer_read(sim_peer_t * p_peer, uint16_t handle)
+{
+    uint8_t pdu[3];
+
+    pdu[0] = SIM_ATT_READ_REQ;
+    put16(&pdu[1], handle);
+    return sim_peer_request(p_peer, pdu, sizeof(pdu));
+}
+
+
+static bool is_response(uint8_t op)
+{
+    switch (op)
+    {
+        case SIM_ATT_ERROR_RSP:
+        case SIM_ATT_MTU_RSP:
+        case SIM_ATT_FIND_INFO_RSP:
+        case SIM_ATT_FIND_BY_TYPE_RSP:
+        case SIM_ATT_READ_BY_TYPE_RSP:
+        case SIM_ATT_READ_RSP:
+        case SIM_ATT_READ_BLOB_RSP:
+        case SIM_ATT_READ_MULTI_RSP:
+        case SIM_ATT_READ_BY_GROUP_RSP:
+        case SIM_ATT_WRITE_RSP:
+        case SIM_ATT_PREP_WRITE_RSP:
+        case SIM_ATT_EXEC_WRITE_RSP:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Link events.
+ */
+
+static void central_evt_handler(sim_ble_central_t * p_central, sim_ble_central_evt_t const * p_evt)
+{
+    sim_peer_t * p_peer = peer_of(p_central);
+
+    switch (p_evt->type)
+    {
+        case SIM_BLE_CENTRAL_EVT_CONNECTED:
+            p_peer->client_op = 0;
+            p_peer->prep_len  = 0;
+            if (p_peer->auto_encrypt && p_central->bond.valid)
+            {
+                sim_ble_encrypt(p_central);
+            }
+            evt_send(p_peer, SIM_PEER_EVT_CONNECTED, 0, 0, NULL, 0);
+            break;
+
+        case SIM_BLE_CENTRAL_EVT_DISCONNECTED:
+            evt_send(p_peer, SIM_PEER_EVT_DISCONNECTED, p_evt->reason, 0, NULL, 0);
+            break;
+
+        case SIM_BLE_CENTRAL_EVT_SECURITY_REQUEST:
+            if (p_central->bond.valid)
+            {
+                sim_ble_encrypt(p_central);
+            }
+            else
+            {
+                sim_ble_pair(p_central, true);
+            }
+            break;
+
+        case SIM_BLE_CENTRAL_EVT_ENCRYPTED:
+            evt_send(p_peer, SIM_PEER_EVT_ENCRYPTED, 0, 0, NULL, 0);
+            break;
+
+        case SIM_BLE_CENTRAL_EVT_SECURITY_FAILED:
+            evt_send(p_peer, SIM_PEER_EVT_SECURITY_FAILED, p_evt->reason, 0, NULL, 0);
+            break;
+
+        case SIM_BLE_CENTRAL_EVT_ATT:
+        {
+            uint8_t op = p_evt->p_pdu[0];
+
+            if ((op == SIM_ATT_HVN) || (op == SIM_ATT_HVI))
+            {
+                p_peer->stats.hvx_received++;
+                if (op == SIM_ATT_HVI)
+                {
+                    uint8_t confirm = SIM_ATT_HVC;
+
+                    send(p_peer, &confirm, 1);
+                }
+                evt_send(p_peer, SIM_PEER_EVT_HVX, 0, get16(&p_evt->p_pdu[1]), &p_evt->p_pdu[3], p_evt->len - 3);
+            }
+            else if (is_response(op))
+            {
+                p_peer->client_op = 0;
+                evt_send(p_peer, SIM_PEER_EVT_RESPONSE, 0, 0, p_evt->p_pdu, p_evt->len);
+            }
+            else
+            {
+                server_request(p_peer, p_evt->p_pdu, p_evt->len);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+void sim_peer_init(sim_peer_t * p_peer, uint8_t index)
+{
+    sim_ble_central_t * p_central = &p_peer->central;
+    uint32_t            i;
+
+    memset(p_central, 0, sizeof(*p_central));
+    p_peer->attr_count = 0;
+    p_peer->prep_len   = 0;
+    p_peer->client_op  = 0;
+    memset(p_peer->pixwatch_handles, 0, sizeof(p_peer->pixwatch_handles));
+    memset(&p_peer->stats, 0, sizeof(p_peer->stats));
+
+    p_central->evt_handler  = central_evt_handler;
+    p_central->p_context    = p_peer;
+    p_central->privacy      = true;
+    p_central->interval     = PEER_INTERVAL;
+    p_central->sup_timeout  = PEER_SUP_TIMEOUT;
+    p_central->interval_min = PEER_INTERVAL_MIN;
+    p_central->interval_max = PEER_INTERVAL_MAX;
+    p_central->id_addr.addr_type = BLE_GAP_ADDR_TYPE_PUBLIC;
+    for (i = 0; i < BLE_GAP_ADDR_LEN; i++)
+    {
+        p_central->id_addr.addr[i] = (uint8_t)(0x10 * (i + 1) + index);
+    }
+    for (i = 0; i < BLE_GAP_SEC_KEY_LEN; i++)
+    {
+        p_central->irk.irk[i] = (uint8_t)(0xA0 + i + 0x11 * index);
+    }
+    sim_ble_central_init(p_central);
+
+    // The GAP and GATT services every server has.
+    {
+        static const uint8_t gap[2]  = {0x00, 0x18};
+        static const uint8_t gatt[2] = {0x01, 0x18};
+        static const uint8_t name[2] = {0x00, 0x2A};
+
+        (void)sim_peer_service_add(p_peer, gap, sizeof(gap));
+        (void)sim_peer_char_add(p_peer, name, sizeof(name), 0x02, (uint8_t const *)"Phone", 5);
+        (void)sim_peer_service_add(p_peer, gatt, sizeof(gatt));
+    }
+}
+
+
+void sim_peer_connect(sim_peer_t * p_peer)
+{
+    sim_ble_range_set(&p_peer->central, true);
+    sim_ble_connect(&p_peer->central);
+}
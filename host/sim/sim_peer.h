@@ -0,0 +1,147 @@
+/* Model of a phone: a central with a GATT server and a small GATT client, over sim_ble.
+ *
+ * The server holds the services the firmware looks for as a client. sim_peer_pixwatch_add() adds
+ * the PixWatch Service; tests add others, such as a notification provider, with
+ * sim_peer_service_add() and sim_peer_char_add(). It answers the discovery, read and write
+ * requests of the firmware, prepared writes included, and sends notifications and indications
+ * when the firmware enabled them.
+ *
+ * Security follows a phone: asked for security by the firmware, it pairs and bonds the first time
+ * and encrypts with its bond later, and it encrypts a new link itself when it has a bond.
+ *
+ * The client sends one request at a time to the GATT server of the firmware and reports its
+ * response with SIM_PEER_EVT_RESPONSE; write commands need no response.
+ */
+
+#ifndef SIM_PEER_H__
+#define SIM_PEER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim_ble.h"
+
+#define SIM_PEER_ATTRS_MAX      48
+#define SIM_PEER_VALUE_MAX      64      /**< Largest attribute value. */
+#define SIM_PEER_PREP_MAX       256     /**< Prepared write data the server queues. */
+
+typedef struct sim_peer_s sim_peer_t;
+
+/**@brief Events of a phone, for its owner. */
+typedef enum
+{
+    SIM_PEER_EVT_CONNECTED,
+    SIM_PEER_EVT_DISCONNECTED,       /**< See reason. */
+    SIM_PEER_EVT_ENCRYPTED,
+    SIM_PEER_EVT_SECURITY_FAILED,    /**< See reason. */
+    SIM_PEER_EVT_WRITE,              /**< The firmware wrote handle, with p_data and len; prepared writes once executed. */
+    SIM_PEER_EVT_HVX,                /**< Notification or indication from the firmware: handle, p_data, len. */
+    SIM_PEER_EVT_RESPONSE,           /**< Response to the request of the client: the PDU in p_data and len. */
+} sim_peer_evt_type_t;
+
+typedef struct
+{
+    sim_peer_evt_type_t type;
+    uint8_t             reason;
+    uint16_t            handle;
+    uint8_t const     * p_data;
+    uint16_t            len;
+} sim_peer_evt_t;
+
+typedef void (*sim_peer_evt_handler_t)(sim_peer_t * p_peer, sim_peer_evt_t const * p_evt);
+
+/**@brief Attribute of the GATT server of a phone. */
+typedef struct
+{
+    uint8_t  type[16];              /**< Attribute type, little endian. */
+    uint8_t  type_len;              /**< 2 or 16. */
+    uint8_t  value[SIM_PEER_VALUE_MAX];
+    uint16_t len;
+    uint16_t group_end;             /**< Last handle of the service, for service declarations. */
+} sim_peer_attr_t;
+
+/**@brief Counters of a phone. */
+typedef struct
+{
+    uint32_t requests;              /**< Requests of the firmware answered. */
+    uint32_t reads;                 /**< Read, Read Blob and Read Multiple requests among them. */
+    uint32_t writes;                /**< Writes applied, commands and executed prepared writes included. */
+    uint32_t notifications;         /**< Notifications and indications sent. */
+    uint32_t hvx_received;          /**< Notifications and indications received. */
+} sim_peer_stats_t;
+
+/**@brief A phone. Set the fields above the line, then call sim_peer_init(). */
+struct sim_peer_s
+{
+    sim_peer_evt_handler_t evt_handler;     /**< May be NULL. */
+    void                 * p_context;
+    bool                   auto_encrypt;    /**< Encrypts new links with its bond. */
+    uint16_t               prep_max;        /**< Prepared write data the server queues, SIM_PEER_PREP_MAX if 0. */
+    /* ------------------------------------------------------------------------------------- */
+    sim_ble_central_t      central;
+    sim_peer_attr_t        attrs[SIM_PEER_ATTRS_MAX];
+    uint16_t               attr_count;
+    uint8_t                prep[SIM_PEER_PREP_MAX];
+    uint16_t               prep_len;
+    uint8_t                client_op;       /**< Request of the client awaiting its response, 0 if none. */
+    uint16_t               pixwatch_handles[4]; /**< Value handles of the PixWatch characteristics. */
+    sim_peer_stats_t       stats;
+};
+
+/**@brief Function for initializing a phone, out of range. Each phone gets its own address and
+ *        identity key from index.
+ */
+void sim_peer_init(sim_peer_t * p_peer, uint8_t index);
+
+/**@brief Function for bringing a phone in range and making it connect. */
+void sim_peer_connect(sim_peer_t * p_peer);
+
+/**@brief Function for adding a primary service to the server of a phone.
+ *
+ * @return Handle of the service declaration.
+ */
+uint16_t sim_peer_service_add(sim_peer_t * p_peer, uint8_t const * p_uuid, uint8_t uuid_len);
+
+/**@brief Function for adding a characteristic to the last service, with a CCCD if it notifies or
+ *        indicates.
+ *
+ * @return Handle of the value.
+ */
+uint16_t sim_peer_char_add(sim_peer_t * p_peer, uint8_t const * p_uuid, uint8_t uuid_len, uint8_t props,
+                           uint8_t const * p_value, uint16_t len);
+
+/**@brief Function for adding the PixWatch Service, with the local time, date format, alarms and
+ *        weather characteristics, the value handles of which go to pixwatch_handles.
+ */
+void sim_peer_pixwatch_add(sim_peer_t * p_peer);
+
+/**@brief Function for setting the value of an attribute. */
+void sim_peer_value_set(sim_peer_t * p_peer, uint16_t handle, uint8_t const * p_value, uint16_t len);
+
+/**@brief Function for getting an attribute of the server, NULL if there is none at handle. */
+sim_peer_attr_t const * sim_peer_attr_get(sim_peer_t const * p_peer, uint16_t handle);
+
+/**@brief Function for getting the value of the CCCD of a characteristic, as the firmware wrote it. */
+uint16_t sim_peer_cccd_get(sim_peer_t const * p_peer, uint16_t value_handle);
+
+/**@brief Function for notifying or indicating a value, if the firmware enabled it.
+ *
+ * @return false if the firmware did not, or the link is down.
+ */
+bool sim_peer_hvx(sim_peer_t * p_peer, uint16_t value_handle, uint8_t const * p_data, uint16_t len);
+
+/**@brief Function for sending a request or command of the client. Requests wait for the response to
+ *        the previous one.
+ *
+ * @return false if a request is in progress or the link is down.
+ */
+bool sim_peer_request(sim_peer_t * p_peer, uint8_t const * p_pdu, uint16_t len);
+
+/**@brief Function for writing to the server of the firmware, with a Write Request or a Write
+ *        Command.
+ */
+bool sim_peer_write(sim_peer_t * p_peer, uint16_t handle, uint8_t const * p_data, uint16_t len, bool request);
+
+/**@brief Function for reading from the server of the firmware. */
+bool sim_peer_read(sim_peer_t * p_peer, uint16_t handle);
+
+#endif /* SIM_PEER_H__ */
@@ -0,0 +1,638 @@
+/* Models of the chip peripherals the firmware uses directly. */
+
+#define SIM_REGISTERS_WRITABLE
+
+#include <string.h>
+#include "nrf.h"
+#include "sim.h"
+#include "sim_periph.h"
+
+#define LF_TICKS_PER_S      32768
+#define LFCLK_STARTUP       SIM_MS(250)          /**< Start-up of the 32 kHz crystal. */
+#define RTC_COUNTER_MASK    0x00FFFFFF
+#define RTC_CC_COUNT        4
+#define TIMER_CC_COUNT      6
+#define GPIO_PINS           32
+
+
+/**@brief State of RTC1 behind its registers. */
+static struct
+{
+    NRF_RTC_Type regs;
+    bool         running;       /**< Started by TASKS_START. */
+    bool         counting;      /**< Running, and the low frequency clock too. */
+    uint32_t     prescaler;     /**< Latched at start. */
+    uint32_t     base_count;    /**< Counter at base_lf. */
+    uint64_t     base_lf;       /**< Low frequency tick the counter was last rebased on. */
+    uint32_t     inten;
+    uint32_t     evten;
+    uint32_t     evt_id;        /**< Timed event of the next compare match. */
+    uint64_t     evt_time;
+} m_rtc;
+
+/**@brief State of TIMER1 behind its registers, timer mode only. */
+static struct
+{
+    NRF_TIMER_Type regs;
+    bool           running;
+    uint32_t       base_count;
+    uint64_t       base_time;
+    uint32_t       inten;
+} m_timer;
+
+/**@brief State of the GPIO port behind its registers. */
+static struct
+{
+    NRF_GPIO_Type       regs;
+    uint32_t            out;
+    uint32_t            dir;
+    uint32_t            old_dir;    /**< Direction as mirrored into DIR and PIN_CNF by the last sync. */
+    int32_t             input[GPIO_PINS];
+    uint32_t            in;
+    uint32_t            sense;
+    sim_gpio_listener_t listener;
+} m_gpio;
+
+static NRF_POWER_Type m_power;
+static NRF_CLOCK_Type m_clock;
+static NRF_FICR_Type  m_ficr;
+static NRF_UICR_Type  m_uicr;
+static bool           m_lfclk_running;
+static bool           m_lfclk_starting;     /**< LFCLKSTART triggered, the crystal not running yet. */
+static uint64_t       m_lfclk_due;          /**< Time the starting crystal runs. */
+static bool           m_hooked;
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Low frequency clock and RTC1.
+ */
+
+/**@brief Function for getting the number of low frequency ticks by a time. */
+static uint64_t lf_ticks(uint64_t time)
+{
+    return (time / 1000000000ULL) * LF_TICKS_PER_S +
+           ((time % 1000000000ULL) * LF_TICKS_PER_S) / 1000000000ULL;
+}
+
+
+/**@brief Function for getting the time of a low frequency tick. */
+static uint64_t lf_tick_time(uint64_t tick)
+{
+    return (tick / LF_TICKS_PER_S) * 1000000000ULL +
+           ((tick % LF_TICKS_PER_S) * 1000000000ULL + LF_TICKS_PER_S - 1) / LF_TICKS_PER_S;
+}
+
+
+static uint32_t rtc_counter(void)
+{
+    uint64_t elapsed;
+
+    if (!m_rtc.counting)
+    {
+        return m_rtc.base_count;
+    }
+    elapsed = (lf_ticks(sim_time()) - m_rtc.base_lf) / (m_rtc.prescaler + 1);
+    return (uint32_t)(m_rtc.base_count + elapsed) & RTC_COUNTER_MASK;
+}
+
+
+static void rtc_rebase(uint32_t count)
+{
+    m_rtc.base_count = count;
+    m_rtc.base_lf    = lf_ticks(sim_time());
+    m_rtc.counting   = m_rtc.running && m_lfclk_running;
+}
+
+
+static void rtc_schedule(void);
+
+
+/**@brief Function for handling a compare match: the counter reached a CC value. */
+static void rtc_compare_evt(void * p_context)
+{
+    uint32_t counter = rtc_counter();
+    bool     irq     = false;
+    uint32_t i;
+
+    m_rtc.evt_id = 0;
+
+    for (i = 0; i < RTC_CC_COUNT; i++)
+    {
+        uint32_t mask = RTC_INTENSET_COMPARE0_Msk << i;
+
+        if (((m_rtc.inten | m_rtc.evten) & mask) && ((m_rtc.regs.CC[i] & RTC_COUNTER_MASK) == counter))
+        {
+            m_rtc.regs.EVENTS_COMPARE[i] = 1;
+            irq = irq || (m_rtc.inten & mask);
+        }
+    }
+
+    rtc_schedule();
+    if (irq)
+    {
+        sim_irq_pend(RTC1_IRQn);
+    }
+}
+
+
+/**@brief Function for scheduling the next compare match of the channels in use. */
+static void rtc_schedule(void)
+{
+    uint64_t next = SIM_TIME_NEVER;
+    uint32_t i;
+
+    if (m_rtc.counting)
+    {
+        uint64_t lf_now  = lf_ticks(sim_time());
+        uint64_t elapsed = (lf_now - m_rtc.base_lf) / (m_rtc.prescaler + 1);
+        uint32_t counter = (uint32_t)(m_rtc.base_count + elapsed) & RTC_COUNTER_MASK;
+
+        for (i = 0; i < RTC_CC_COUNT; i++)
+        {
+            uint32_t mask = RTC_INTENSET_COMPARE0_Msk << i;
+            uint32_t distance;
+            uint64_t time;
+
+            if (!((m_rtc.inten | m_rtc.evten) & mask))
+            {
+                continue;
+            }
+
+            // A CC value equal to the counter matches again after a full wrap.
+            distance = (m_rtc.regs.CC[i] - counter) & RTC_COUNTER_MASK;
+            if (distance == 0)
+            {
+                distance = RTC_COUNTER_MASK + 1;
+            }
+
+            time = lf_tick_time(m_rtc.base_lf + (elapsed + distance) * (m_rtc.prescaler + 1));
+            if (time < next)
+            {
+                next = time;
+            }
+        }
+    }
+
+    if ((m_rtc.evt_id != 0) && (m_rtc.evt_time == next))
+    {
+        return;
+    }
+
+    sim_cancel(m_rtc.evt_id);
+    m_rtc.evt_id   = 0;
+    m_rtc.evt_time = next;
+    if (next != SIM_TIME_NEVER)
+    {
+        m_rtc.evt_id = sim_at(next, SIM_OWNER_DEVICE, rtc_compare_evt, NULL);
+    }
+}
+
+
+static void rtc_sync(void)
+{
+    NRF_RTC_Type * p_regs = &m_rtc.regs;
+
+    if (p_regs->TASKS_STOP)
+    {
+        p_regs->TASKS_STOP = 0;
+        rtc_rebase(rtc_counter());
+        m_rtc.running = false;
+        rtc_rebase(m_rtc.base_count);
+    }
+    if (p_regs->TASKS_CLEAR)
+    {
+        p_regs->TASKS_CLEAR = 0;
+        rtc_rebase(0);
+    }
+    if (p_regs->TASKS_START)
+    {
+        p_regs->TASKS_START = 0;
+        if (!m_rtc.running)
+        {
+            m_rtc.running   = true;
+            m_rtc.prescaler = p_regs->PRESCALER & 0xFFF;
+            rtc_rebase(m_rtc.base_count);
+        }
+    }
+
+    m_rtc.inten     |= p_regs->INTENSET;
+    m_rtc.inten     &= ~p_regs->INTENCLR;
+    p_regs->INTENSET = m_rtc.inten;
+    p_regs->INTENCLR = 0;
+
+    m_rtc.evten     |= p_regs->EVTENSET;
+    m_rtc.evten     &= ~p_regs->EVTENCLR;
+    p_regs->EVTENSET = m_rtc.evten;
+    p_regs->EVTENCLR = 0;
+    p_regs->EVTEN    = m_rtc.evten;
+
+    p_regs->COUNTER = rtc_counter();
+    rtc_schedule();
+}
+
+
+/**@brief Function for setting the clock status registers to a running crystal. */
+static void lfclk_stat_set(void)
+{
+    m_clock.LFCLKSTAT = CLOCK_LFCLKSTAT_STATE_Msk | (CLOCK_LFCLKSTAT_SRC_Xtal << CLOCK_LFCLKSTAT_SRC_Pos);
+}
+
+
+/**@brief Function for handling the end of the crystal start-up. */
+static void lfclk_started(void * p_context)
+{
+    sim_periph_sync();
+    m_lfclk_starting            = false;
+    m_lfclk_running             = true;
+    m_clock.EVENTS_LFCLKSTARTED = 1;
+    lfclk_stat_set();
+    rtc_rebase(m_rtc.base_count);
+    rtc_schedule();
+}
+
+
+/**@brief Function for starting the crystal, unless it runs or starts already. */
+static void lfclk_task_start(void)
+{
+    if (m_lfclk_running || m_lfclk_starting)
+    {
+        return;
+    }
+
+    m_lfclk_starting = true;
+    m_lfclk_due      = sim_time() + LFCLK_STARTUP;
+    (void)sim_at(m_lfclk_due, SIM_OWNER_DEVICE, lfclk_started, NULL);
+}
+
+
+static void clock_sync(void)
+{
+    if (m_clock.TASKS_LFCLKSTART)
+    {
+        m_clock.TASKS_LFCLKSTART = 0;
+        lfclk_task_start();
+    }
+}
+
+
+void sim_lfclk_start(void)
+{
+    lfclk_task_start();
+    if (!m_lfclk_running)
+    {
+        sim_busy_wait(m_lfclk_due - sim_time());
+    }
+}
+
+
+bool sim_lfclk_running(void)
+{
+    return m_lfclk_running;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * TIMER1.
+ */
+
+static uint32_t timer_count(void)
+{
+    uint64_t ticks;
+
+    if (!m_timer.running)
+    {
+        return m_timer.base_count;
+    }
+
+    // 16 MHz divided by 2^PRESCALER.
+    ticks = ((sim_time() - m_timer.base_time) * 16) / (1000ULL << (m_timer.regs.PRESCALER & 0x0F));
+    return m_timer.base_count + (uint32_t)ticks;
+}
+
+
+static void timer_sync(void)
+{
+    NRF_TIMER_Type * p_regs = &m_timer.regs;
+    uint32_t         i;
+
+    if (p_regs->TASKS_STOP || p_regs->TASKS_SHUTDOWN)
+    {
+        p_regs->TASKS_STOP     = 0;
+        p_regs->TASKS_SHUTDOWN = 0;
+        m_timer.base_count     = timer_count();
+        m_timer.running        = false;
+    }
+    if (p_regs->TASKS_CLEAR)
+    {
+        p_regs->TASKS_CLEAR = 0;
+        m_timer.base_count  = 0;
+        m_timer.base_time   = sim_time();
+    }
+    if (p_regs->TASKS_START)
+    {
+        p_regs->TASKS_START = 0;
+        if (!m_timer.running)
+        {
+            m_timer.running   = true;
+            m_timer.base_time = sim_time();
+        }
+    }
+    for (i = 0; i < TIMER_CC_COUNT; i++)
+    {
+        if (p_regs->TASKS_CAPTURE[i])
+        {
+            p_regs->TASKS_CAPTURE[i] = 0;
+            p_regs->CC[i]            = timer_count();
+        }
+    }
+
+    m_timer.inten    |= p_regs->INTENSET;
+    m_timer.inten    &= ~p_regs->INTENCLR;
+    p_regs->INTENSET  = m_timer.inten;
+    p_regs->INTENCLR  = 0;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * GPIO.
+ */
+
+static bool pin_level(uint32_t pin)
+{
+    uint32_t pull;
+
+    if (m_gpio.dir & (1UL << pin))
+    {
+        return (m_gpio.out >> pin) & 1;
+    }
+    if (m_gpio.input[pin] != SIM_GPIO_FLOATING)
+    {
+        return m_gpio.input[pin] != 0;
+    }
+
+    pull = (m_gpio.regs.PIN_CNF[pin] & GPIO_PIN_CNF_PULL_Msk) >> GPIO_PIN_CNF_PULL_Pos;
+    return pull == GPIO_PIN_CNF_PULL_Pullup;
+}
+
+
+static void gpio_port_evt(void * p_context)
+{
+    sim_irq_pend(GPIOTE_IRQn);
+}
+
+
+/**@brief Function for updating IN, raising the port event when a sensed pin changed. The event
+ *        goes through the timed events, so that no handler runs in the middle of an access.
+ */
+static void gpio_inputs_update(void)
+{
+    uint32_t in = 0;
+    uint32_t pin;
+
+    for (pin = 0; pin < GPIO_PINS; pin++)
+    {
+        if (pin_level(pin))
+        {
+            in |= 1UL << pin;
+        }
+    }
+
+    if ((in ^ m_gpio.in) & m_gpio.sense)
+    {
+        (void)sim_at(sim_time(), SIM_OWNER_DEVICE, gpio_port_evt, NULL);
+    }
+    m_gpio.in      = in;
+    m_gpio.regs.IN = in;
+}
+
+
+static void gpio_sync(void)
+{
+    NRF_GPIO_Type * p_regs  = &m_gpio.regs;
+    uint32_t        old_out = m_gpio.out;
+    uint32_t        old_dir = m_gpio.old_dir;
+    uint32_t        changed;
+    uint32_t        pin;
+
+    // OUT and DIR written directly, then the set and clear registers.
+    m_gpio.out  = p_regs->OUT;
+    m_gpio.out |= p_regs->OUTSET;
+    m_gpio.out &= ~p_regs->OUTCLR;
+    m_gpio.dir  = p_regs->DIR;
+    m_gpio.dir |= p_regs->DIRSET;
+    m_gpio.dir &= ~p_regs->DIRCLR;
+
+    // PIN_CNF sets the direction too, for the pins whose config was written.
+    for (pin = 0; pin < GPIO_PINS; pin++)
+    {
+        uint32_t mask    = 1UL << pin;
+        bool     cnf_dir = (p_regs->PIN_CNF[pin] & GPIO_PIN_CNF_DIR_Msk) != 0;
+
+        if (cnf_dir != ((m_gpio.old_dir & mask) != 0))
+        {
+            m_gpio.dir = cnf_dir ? (m_gpio.dir | mask) : (m_gpio.dir & ~mask);
+        }
+    }
+    m_gpio.old_dir = m_gpio.dir;
+
+    p_regs->OUT    = m_gpio.out;
+    p_regs->OUTSET = 0;
+    p_regs->OUTCLR = 0;
+    p_regs->DIR    = m_gpio.dir;
+    p_regs->DIRSET = 0;
+    p_regs->DIRCLR = 0;
+    for (pin = 0; pin < GPIO_PINS; pin++)
+    {
+        if (m_gpio.dir & (1UL << pin))
+        {
+            p_regs->PIN_CNF[pin] |= GPIO_PIN_CNF_DIR_Msk;
+        }
+        else
+        {
+            p_regs->PIN_CNF[pin] &= ~GPIO_PIN_CNF_DIR_Msk;
+        }
+    }
+
+    // A pin that turns to an output is driven from then on, even at the level of OUT it had.
+    changed = ((old_out ^ m_gpio.out) | ~old_dir) & m_gpio.dir;
+    for (pin = 0; (pin < GPIO_PINS) && (m_gpio.listener != NULL); pin++)
+    {
+        if (changed & (1UL << pin))
+        {
+            m_gpio.listener(pin, (m_gpio.out >> pin) & 1);
+        }
+    }
+
+    gpio_inputs_update();
+}
+
+
+void sim_gpio_input_set(uint32_t pin, int32_t level)
+{
+    sim_periph_sync();
+    m_gpio.input[pin] = level;
+    gpio_inputs_update();
+}
+
+
+bool sim_gpio_level_get(uint32_t pin)
+{
+    sim_periph_sync();
+    return pin_level(pin);
+}
+
+
+void sim_gpio_sense_set(uint32_t mask)
+{
+    sim_periph_sync();
+    m_gpio.sense = mask;
+}
+
+
+void sim_gpio_listener_set(sim_gpio_listener_t listener)
+{
+    m_gpio.listener = listener;
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * Register blocks, and resets.
+ */
+
+static void periph_reset(sim_reset_t reset)
+{
+    uint32_t pin;
+
+    // The peripherals lose their state at every reset; the low frequency clock only at power-on.
+    memset(&m_rtc, 0, sizeof(m_rtc));
+    memset(&m_timer, 0, sizeof(m_timer));
+    memset(&m_gpio.regs, 0, sizeof(m_gpio.regs));
+    m_gpio.out   = 0;
+    m_gpio.dir   = 0;
+    m_gpio.old_dir = 0;
+    m_gpio.sense = 0;
+    m_gpio.in    = 0;
+    for (pin = 0; pin < GPIO_PINS; pin++)
+    {
+        m_gpio.regs.PIN_CNF[pin] = GPIO_PIN_CNF_INPUT_Disconnect << GPIO_PIN_CNF_INPUT_Pos;
+    }
+    gpio_inputs_update();
+
+    memset(&m_power, 0, sizeof(m_power));
+    memset(&m_clock, 0, sizeof(m_clock));
+    m_lfclk_starting = false;
+
+    switch (reset)
+    {
+        case SIM_RESET_POWER_ON:
+            m_lfclk_running = false;
+            break;
+
+        case SIM_RESET_SOFT:
+            m_power.RESETREAS = POWER_RESETREAS_SREQ_Msk;
+            break;
+
+        case SIM_RESET_PIN:
+            m_power.RESETREAS = POWER_RESETREAS_RESETPIN_Msk;
+            break;
+
+        case SIM_RESET_DOG:
+            m_power.RESETREAS = POWER_RESETREAS_DOG_Msk;
+            break;
+
+        case SIM_RESET_LOCKUP:
+            m_power.RESETREAS = POWER_RESETREAS_LOCKUP_Msk;
+            break;
+    }
+    if (m_lfclk_running)
+    {
+        lfclk_stat_set();
+    }
+
+    memset(&m_ficr, 0xFF, sizeof(m_ficr));
+    m_ficr.CODEPAGESIZE  = 4096;
+    m_ficr.CODESIZE      = 128;
+    m_ficr.DEVICEID[0]   = 0x5049585A;
+    m_ficr.DEVICEID[1]   = 0x57415443;
+    m_ficr.DEVICEADDR[0] = 0x5A585049;
+    m_ficr.DEVICEADDR[1] = 0x0000C157;
+    memset(&m_uicr, 0xFF, sizeof(m_uicr));
+}
+
+
+static void hook(void)
+{
+    uint32_t pin;
+
+    if (!m_hooked)
+    {
+        m_hooked = true;
+        for (pin = 0; pin < GPIO_PINS; pin++)
+        {
+            m_gpio.input[pin] = SIM_GPIO_FLOATING;
+        }
+        sim_reset_hook_add(periph_reset);
+    }
+}
+
+
+void sim_periph_sync(void)
+{
+    clock_sync();
+    rtc_sync();
+    timer_sync();
+    gpio_sync();
+}
+
+
+NRF_RTC_Type * sim_rtc1(void)
+{
+    sim_periph_sync();
+    return &m_rtc.regs;
+}
+
+
+NRF_TIMER_Type * sim_timer1(void)
+{
+    sim_periph_sync();
+    return &m_timer.regs;
+}
+
+
+NRF_GPIO_Type * sim_gpio(void)
+{
+    sim_periph_sync();
+    return &m_gpio.regs;
+}
+
+
+NRF_POWER_Type * sim_power(void)
+{
+    return &m_power;
+}
+
+
+NRF_CLOCK_Type * sim_clock(void)
+{
+    sim_periph_sync();
+    return &m_clock;
+}
+
+
+NRF_FICR_Type * sim_ficr(void)
+{
+    return &m_ficr;
+}
+
+
+NRF_UICR_Type * sim_uicr(void)
+{
+    return &m_uicr;
+}
+
+
+/**@brief Registration of the reset hook, before the first reset of the run. */
+static void __attribute__((constructor)) periph_constructor(void)
+{
+    hook();
+}
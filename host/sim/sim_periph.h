@@ -0,0 +1,45 @@
+/* Models of the chip peripherals the firmware uses directly: RTC1, TIMER1, GPIO with the port
+ * event of GPIOTE, POWER, the low frequency clock, FICR and UICR.
+ *
+ * The firmware reads and writes register blocks in host memory (see host/include/nrf.h). Each
+ * access first calls sim_periph_sync(), which applies the tasks and register writes done since
+ * the previous access, and updates counters and inputs to the simulated time. The simulation
+ * core calls it before letting time pass, so writes take effect at the time they were done.
+ */
+
+#ifndef SIM_PERIPH_H__
+#define SIM_PERIPH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_GPIO_FLOATING  (-1)   /**< Input level of a pin nothing drives. */
+
+typedef void (*sim_gpio_listener_t)(uint32_t pin, bool level);
+
+/**@brief Function for applying the register writes of the firmware. */
+void sim_periph_sync(void);
+
+/**@brief Function for starting the low frequency clock, which RTC1 counts, as LFCLKSTART does.
+ *        Returns when it runs, waiting for a start already triggered to complete.
+ */
+void sim_lfclk_start(void);
+
+/**@brief Function for checking whether the low frequency clock runs. */
+bool sim_lfclk_running(void);
+
+/**@brief Function for driving an input pin from outside, 0 or 1, or for leaving it floating
+ *        (SIM_GPIO_FLOATING), when its pull resistor sets the level.
+ */
+void sim_gpio_input_set(uint32_t pin, int32_t level);
+
+/**@brief Function for getting the level of a pin, as IN reads it. */
+bool sim_gpio_level_get(uint32_t pin);
+
+/**@brief Function for setting the pins that raise the GPIOTE port event when their level changes. */
+void sim_gpio_sense_set(uint32_t mask);
+
+/**@brief Function for registering a function called when the firmware changes an output. */
+void sim_gpio_listener_set(sim_gpio_listener_t listener);
+
+#endif /* SIM_PERIPH_H__ */
@@ -0,0 +1,373 @@
+/* Scripted world around the firmware. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_periph.h"
+#include "sim_uart.h"
+#include "sim_display.h"
+#include "sim_script.h"
+
+#define LINE_MAX           256
+#define CLICK_TIME         SIM_MS(100)
+#define REASON_USER        0x13        /**< HCI reason: remote user terminated the connection. */
+
+typedef enum
+{
+    ACTION_PRESS,
+    ACTION_RELEASE,
+    ACTION_CLICK,
+    ACTION_CONNECT,
+    ACTION_DISCONNECT,
+    ACTION_AWAY,
+    ACTION_TIME,
+    ACTION_TYPE,
+    ACTION_PPM,
+    ACTION_RESET,
+    ACTION_END,
+} action_type_t;
+
+typedef struct
+{
+    action_type_t type;
+    uint32_t      arg;
+    uint32_t      value;
+    char          text[LINE_MAX];
+} action_t;
+
+/**@brief Actions by name, with the arguments they take: 'n' a number, 't' the rest of the line. */
+static struct
+{
+    char const  * p_name;
+    action_type_t type;
+    char const  * p_args;
+} const m_actions[] =
+{
+    {"press",      ACTION_PRESS,      "n"},
+    {"release",    ACTION_RELEASE,    "n"},
+    {"click",      ACTION_CLICK,      "n"},
+    {"connect",    ACTION_CONNECT,    "n"},
+    {"disconnect", ACTION_DISCONNECT, "n"},
+    {"away",       ACTION_AWAY,       "n"},
+    {"time",       ACTION_TIME,       "nn"},
+    {"type",       ACTION_TYPE,       "t"},
+    {"ppm",        ACTION_PPM,        "t"},
+    {"reset",      ACTION_RESET,      "t"},
+    {"end",        ACTION_END,        ""},
+};
+
+static sim_peer_t m_peers[SIM_SCRIPT_PEERS];
+static bool       m_peers_ready[SIM_SCRIPT_PEERS];
+static uint64_t   m_last_time;
+
+
+sim_peer_t * sim_script_peer(uint8_t index)
+{
+    if (index >= SIM_SCRIPT_PEERS)
+    {
+        return NULL;
+    }
+    if (!m_peers_ready[index])
+    {
+        sim_peer_init(&m_peers[index], index);
+        sim_peer_pixwatch_add(&m_peers[index]);
+        m_peers_ready[index] = true;
+    }
+    return &m_peers[index];
+}
+
+
+void sim_script_button_set(uint8_t button, bool pressed)
+{
+    if ((button >= 1) && (button <= SIM_SCRIPT_BUTTONS))
+    {
+        // Active low; released, the pull-up of the pin holds it high.
+        sim_gpio_input_set(SIM_SCRIPT_BUTTON_PIN + button - 1, pressed ? 0 : SIM_GPIO_FLOATING);
+    }
+}
+
+
+static void button_release(void * p_context)
+{
+    sim_script_button_set((uint8_t)(uintptr_t)p_context, false);
+}
+
+
+static void action_run(void * p_context)
+{
+    action_t   * p_action = p_context;
+    sim_peer_t * p_peer   = NULL;
+    uint8_t      value[4];
+
+    if ((p_action->type >= ACTION_CONNECT) && (p_action->type <= ACTION_TIME))
+    {
+        p_peer = sim_script_peer((uint8_t)p_action->arg);
+    }
+
+    switch (p_action->type)
+    {
+        case ACTION_PRESS:
+            sim_script_button_set(p_action->arg, true);
+            break;
+
+        case ACTION_RELEASE:
+            sim_script_button_set(p_action->arg, false);
+            break;
+
+        case ACTION_CLICK:
+            sim_script_button_set(p_action->arg, true);
+            (void)sim_at(sim_time() + CLICK_TIME, SIM_OWNER_WORLD, button_release,
+                         (void *)(uintptr_t)p_action->arg);
+            break;
+
+        case ACTION_CONNECT:
+            sim_peer_connect(p_peer);
+            break;
+
+        case ACTION_DISCONNECT:
+            sim_ble_disconnect(&p_peer->central, REASON_USER);
+            break;
+
+        case ACTION_AWAY:
+            sim_ble_connect_cancel(&p_peer->central);
+            sim_ble_range_set(&p_peer->central, false);
+            break;
+
+        case ACTION_TIME:
+            value[0] = (uint8_t)p_action->value;
+            value[1] = (uint8_t)(p_action->value >> 8);
+            value[2] = (uint8_t)(p_action->value >> 16);
+            value[3] = (uint8_t)(p_action->value >> 24);
+            sim_peer_value_set(p_peer, p_peer->pixwatch_handles[0], value, sizeof(value));
+            (void)sim_peer_hvx(p_peer, p_peer->pixwatch_handles[0], value, sizeof(value));
+            break;
+
+        case ACTION_TYPE:
+            sim_uart_line_push(p_action->text);
+            break;
+
+        case ACTION_PPM:
+            if (!sim_display_ppm_save(p_action->text))
+            {
+                fprintf(stderr, "sim: cannot write %s\n", p_action->text);
+            }
+            break;
+
+        case ACTION_RESET:
+            if (strcmp(p_action->text, "soft") == 0)
+            {
+                sim_reset(SIM_RESET_SOFT);
+            }
+            else if (strcmp(p_action->text, "pin") == 0)
+            {
+                sim_reset(SIM_RESET_PIN);
+            }
+            else if (strcmp(p_action->text, "dog") == 0)
+            {
+                sim_reset(SIM_RESET_DOG);
+            }
+            else
+            {
+                sim_reset(SIM_RESET_POWER_ON);
+            }
+            break;
+
+        case ACTION_END:
+            sim_stop(0);
+            break;
+    }
+}
+
+
+/**@brief Function for parsing the arguments of an action.
+ *
+ * @return false if they do not match what the action takes.
+ */
+static bool args_parse(action_t * p_action, char const * p_args, char * p_rest)
+{
+    uint32_t * p_numbers[2] = {&p_action->arg, &p_action->value};
+    uint32_t   count        = 0;
+    char     * p_end;
+
+    for (; *p_args != '\0'; p_args++)
+    {
+        while ((*p_rest == ' ') || (*p_rest == '\t'))
+        {
+            p_rest++;
+        }
+
+        if (*p_args == 't')
+        {
+            if (*p_rest == '\0')
+            {
+                return false;
+            }
+            snprintf(p_action->text, sizeof(p_action->text), "%s", p_rest);
+            return true;
+        }
+
+        *p_numbers[count++] = strtoul(p_rest, &p_end, 0);
+        if (p_end == p_rest)
+        {
+            return false;
+        }
+        p_rest = p_end;
+    }
+
+    while ((*p_rest == ' ') || (*p_rest == '\t'))
+    {
+        p_rest++;
+    }
+    return *p_rest == '\0';
+}
+
+
+static bool line_parse(char * p_line)
+{
+    action_t * p_action;
+    char     * p_end;
+    char     * p_name;
+    char     * p_time;
+    double     seconds;
+    bool       relative;
+    uint64_t   time;
+    uint32_t   i;
+
+    p_end = strchr(p_line, '#');
+    if (p_end != NULL)
+    {
+        *p_end = '\0';
+    }
+    p_end = p_line + strlen(p_line);
+    while ((p_end > p_line) && ((p_end[-1] == ' ') || (p_end[-1] == '\t') || (p_end[-1] == '\r')))
+    {
+        *--p_end = '\0';
+    }
+    while ((*p_line == ' ') || (*p_line == '\t'))
+    {
+        p_line++;
+    }
+    if (*p_line == '\0')
+    {
+        return true;
+    }
+
+    relative = (*p_line == '+');
+    p_time   = relative ? p_line + 1 : p_line;
+    seconds  = strtod(p_time, &p_end);
+    if ((p_end == p_time) || (seconds < 0))
+    {
+        return false;
+    }
+    time = (uint64_t)(seconds * 1e9 + 0.5);
+    time = relative ? m_last_time + time : time;
+
+    p_name = strtok_r(p_end, " \t", &p_end);
+    if (p_name == NULL)
+    {
+        return false;
+    }
+    for (i = 0; i < sizeof(m_actions) / sizeof(m_actions[0]); i++)
+    {
+        if (strcmp(p_name, m_actions[i].p_name) == 0)
+        {
+            break;
+        }
+    }
+    if (i == sizeof(m_actions) / sizeof(m_actions[0]))
+    {
+        return false;
+    }
+
+    p_action = calloc(1, sizeof(*p_action));
+    if (p_action == NULL)
+    {
+        return false;
+    }
+    p_action->type = m_actions[i].type;
+    if (!args_parse(p_action, m_actions[i].p_args, (p_end != NULL) ? p_end : ""))
+    {
+        free(p_action);
+        return false;
+    }
+
+    if ((((p_action->type == ACTION_PRESS) || (p_action->type == ACTION_RELEASE) || (p_action->type == ACTION_CLICK)) &&
+         ((p_action->arg < 1) || (p_action->arg > SIM_SCRIPT_BUTTONS))) ||
+        (((p_action->type == ACTION_CONNECT) || (p_action->type == ACTION_DISCONNECT) ||
+          (p_action->type == ACTION_AWAY) || (p_action->type == ACTION_TIME)) &&
+         (p_action->arg >= SIM_SCRIPT_PEERS)))
+    {
+        free(p_action);
+        return false;
+    }
+
+    (void)sim_at(time, SIM_OWNER_WORLD, action_run, p_action);
+    m_last_time = time;
+    return true;
+}
+
+
+bool sim_script_parse(char const * p_text)
+{
+    char     line[LINE_MAX];
+    uint32_t number = 0;
+    bool     ok     = true;
+
+    while (*p_text != '\0')
+    {
+        char const * p_end = strchr(p_text, '\n');
+        size_t       len   = (p_end != NULL) ? (size_t)(p_end - p_text) : strlen(p_text);
+
+        number++;
+        snprintf(line, sizeof(line), "%.*s", (int)len, p_text);
+        if (!line_parse(line))
+        {
+            fprintf(stderr, "sim: script line %u not understood: %.*s\n", number, (int)len, p_text);
+            ok = false;
+        }
+        p_text += (p_end != NULL) ? len + 1 : len;
+    }
+    return ok;
+}
+
+
+bool sim_script_load(char const * p_path)
+{
+    FILE * p_file = fopen(p_path, "r");
+    char * p_text;
+    long   size;
+    bool   ok;
+
+    if (p_file == NULL)
+    {
+        perror(p_path);
+        return false;
+    }
+    (void)fseek(p_file, 0, SEEK_END);
+    size = ftell(p_file);
+    (void)fseek(p_file, 0, SEEK_SET);
+
+    p_text = calloc(1, size + 1);
+    ok     = (p_text != NULL) && (fread(p_text, 1, size, p_file) == (size_t)size);
+    fclose(p_file);
+
+    ok = ok && sim_script_parse(p_text);
+    free(p_text);
+    return ok;
+}
+
+
+/**@brief Entry of the firmware: main() of src/main.c, renamed by the host Makefile. */
+extern int pixwatch_main(void);
+
+static void firmware_entry(void)
+{
+    (void)pixwatch_main();
+}
+
+
+int sim_script_run(void)
+{
+    return sim_run(firmware_entry);
+}
@@ -0,0 +1,54 @@
+/* Scripted world around the firmware: buttons, phones, console input and resets at given times.
+ *
+ * A script has one action per line, at a time in seconds since the start of the run, or after the
+ * previous action with a leading '+'. '#' starts a comment.
+ *
+ *   1.5   press 1            hold button 1 down (buttons 1 to 4, active low)
+ *   +0.2  release 1
+ *   3     click 2            press, and release 100 ms later
+ *   4     connect 0          bring phone 0 or 1 in range and connect it
+ *   +1    time 0 1700000000  set the local time characteristic of phone 0, and notify it
+ *   +5    disconnect 0
+ *   +1    away 0             take phone 0 out of range, which drops its link
+ *   6     type stats         type a line on the console
+ *   8     ppm clock.ppm      save the screen
+ *   9     reset soft         reset the chip: soft, pin, dog or power
+ *   60    end                end the run
+ *
+ * The phones carry the PixWatch Service. Actions run as world events, which resets of the chip do
+ * not drop.
+ */
+
+#ifndef SIM_SCRIPT_H__
+#define SIM_SCRIPT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim_peer.h"
+
+#define SIM_SCRIPT_PEERS        2
+#define SIM_SCRIPT_BUTTONS      4
+#define SIM_SCRIPT_BUTTON_PIN   13     /**< Pin of button 1, as in src/main.c; the others follow. */
+
+/**@brief Function for adding the actions of a script.
+ *
+ * @return false if a line is not understood; it is reported on stderr with its number.
+ */
+bool sim_script_parse(char const * p_text);
+
+/**@brief Function for adding the actions of a script file. */
+bool sim_script_load(char const * p_path);
+
+/**@brief Function for getting a phone, set up with the PixWatch Service on first use. */
+sim_peer_t * sim_script_peer(uint8_t index);
+
+/**@brief Function for pressing or releasing a button now, 1 to SIM_SCRIPT_BUTTONS. */
+void sim_script_button_set(uint8_t button, bool pressed);
+
+/**@brief Function for running the firmware from a power-on, with the actions of the scripts.
+ *
+ * @return Status passed to sim_stop(), 0 at the end of the run.
+ */
+int sim_script_run(void);
+
+#endif /* SIM_SCRIPT_H__ */
@@ -0,0 +1,260 @@
+/* Model of the SoC library of the SoftDevice. */
+
+#include <string.h>
+#include "nrf_soc.h"
+#include "nrf_sdm.h"
+#include "nrf_error.h"
+#include "nrf_error_soc.h"
+#include "sim.h"
+#include "sim_periph.h"
+#include "sim_soc.h"
+
+#define SOC_EVT_QUEUE_SIZE   16
+#define TEMP_MEASURE_TIME    SIM_US(36)        /**< Conversion time of the temperature sensor. */
+#define SD_EVT_IRQ_PRIORITY  NRF_APP_PRIORITY_LOW
+
+
+/**@brief Distance of each nrf_radio_notification_distance_t, in microseconds. */
+static const uint32_t m_distance_us[] = {0, 800, 1740, 2680, 3620, 4560, 5500};
+
+static struct
+{
+    bool     enabled;
+    uint32_t evts[SOC_EVT_QUEUE_SIZE];
+    uint32_t evt_read;
+    uint32_t evt_write;
+    uint8_t  radio_type;
+    uint8_t  radio_distance;
+} m_soc;
+
+static int32_t m_temp = 25 * 4;
+
+
+static void soc_reset(sim_reset_t reset)
+{
+    memset(&m_soc, 0, sizeof(m_soc));
+}
+
+
+static void __attribute__((constructor)) soc_constructor(void)
+{
+    sim_reset_hook_add(soc_reset);
+}
+
+
+bool sim_soc_enabled(void)
+{
+    return m_soc.enabled;
+}
+
+
+void sim_soc_evt_push(uint32_t evt_id)
+{
+    if (m_soc.evt_write - m_soc.evt_read == SOC_EVT_QUEUE_SIZE)
+    {
+        // The SoftDevice drops events the application does not fetch.
+        return;
+    }
+    m_soc.evts[m_soc.evt_write++ % SOC_EVT_QUEUE_SIZE] = evt_id;
+    sim_soc_evt_irq_pend();
+}
+
+
+void sim_soc_evt_irq_pend(void)
+{
+    if (m_soc.enabled)
+    {
+        sim_irq_pend(SWI2_EGU2_IRQn);
+    }
+}
+
+
+void sim_soc_temp_set(int32_t temp)
+{
+    m_temp = temp;
+}
+
+
+uint64_t sim_soc_radio_notification_distance(void)
+{
+    if (m_soc.radio_type == NRF_RADIO_NOTIFICATION_TYPE_NONE)
+    {
+        return 0;
+    }
+    return SIM_US(m_distance_us[m_soc.radio_distance]);
+}
+
+
+void sim_soc_radio_notify(bool active)
+{
+    bool wanted;
+
+    switch (m_soc.radio_type)
+    {
+        case NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE:   wanted = active;  break;
+        case NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE: wanted = !active; break;
+        case NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH:     wanted = true;    break;
+        default:                                          wanted = false;   break;
+    }
+
+    if (wanted)
+    {
+        sim_irq_pend(SWI1_EGU1_IRQn);
+    }
+}
+
+
+/* ---------------------------------------------------------------------------------------------
+ * SoftDevice Manager and SoC library calls.
+ */
+
+uint32_t sd_softdevice_enable(nrf_clock_lfclksrc_t clock_source,
+                              softdevice_assertion_handler_t assertion_handler)
+{
+    if (m_soc.enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    // Returns once the low frequency clock runs, as the SoftDevice does.
+    sim_lfclk_start();
+
+    m_soc.enabled = true;
+    sim_irq_priority_set(SWI2_EGU2_IRQn, SD_EVT_IRQ_PRIORITY);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_softdevice_disable(void)
+{
+    m_soc.enabled = false;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_evt_get(uint32_t * p_evt_id)
+{
+    if (m_soc.evt_read == m_soc.evt_write)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    *p_evt_id = m_soc.evts[m_soc.evt_read++ % SOC_EVT_QUEUE_SIZE];
+    return NRF_SUCCESS;
+}
+
+
+static bool evt_flag_taken(void)
+{
+    return sim_evt_flag_take();
+}
+
+
+uint32_t sd_app_evt_wait(void)
+{
+    // As WFE: returns at once if an interrupt ran since the last call, otherwise sleeps until one.
+    if (!sim_evt_flag_take())
+    {
+        (void)sim_run_until(evt_flag_taken, SIM_TIME_NEVER);
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_temp_get(int32_t * p_temp)
+{
+    sim_busy_wait(TEMP_MEASURE_TIME);
+    *p_temp = m_temp;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_radio_notification_cfg_set(nrf_radio_notification_type_t type,
+                                       nrf_radio_notification_distance_t distance)
+{
+    if ((type > NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH) ||
+        (distance >= sizeof(m_distance_us) / sizeof(m_distance_us[0])))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_soc.radio_type     = type;
+    m_soc.radio_distance = distance;
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for checking that an interrupt belongs to the application. The SoftDevice
+ *        keeps the radio, the timers and a few others for itself.
+ */
+static bool irq_is_app(IRQn_Type irq)
+{
+    switch (irq)
+    {
+        case POWER_CLOCK_IRQn:
+        case RADIO_IRQn:
+        case RTC0_IRQn:
+        case TIMER0_IRQn:
+        case RNG_IRQn:
+        case ECB_IRQn:
+        case CCM_AAR_IRQn:
+        case SWI5_EGU5_IRQn:
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn)
+{
+    if (!irq_is_app(IRQn))
+    {
+        return NRF_ERROR_SOC_NVIC_INTERRUPT_NOT_AVAILABLE;
+    }
+    NVIC_EnableIRQ(IRQn);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    if (!irq_is_app(IRQn))
+    {
+        return NRF_ERROR_SOC_NVIC_INTERRUPT_NOT_AVAILABLE;
+    }
+    NVIC_ClearPendingIRQ(IRQn);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, nrf_app_irq_priority_t priority)
+{
+    if (!irq_is_app(IRQn))
+    {
+        return NRF_ERROR_SOC_NVIC_INTERRUPT_NOT_AVAILABLE;
+    }
+    if ((priority != NRF_APP_PRIORITY_HIGH) && (priority != NRF_APP_PRIORITY_LOW))
+    {
+        return NRF_ERROR_SOC_NVIC_INTERRUPT_PRIORITY_NOT_ALLOWED;
+    }
+    NVIC_SetPriority(IRQn, priority);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region)
+{
+    *p_is_nested_critical_region = sim_sd_critical_region_get();
+    sim_sd_critical_region_set(true);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region)
+{
+    if (!is_nested_critical_region)
+    {
+        sim_sd_critical_region_set(false);
+    }
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,37 @@
+/* Model of the SoC library of the SoftDevice: enabling, the SoC event queue, the interrupt
+ * functions, the temperature sensor and radio notifications.
+ *
+ * SoC events (flash operation results) are queued by the models and read by the firmware with
+ * sd_evt_get() from the SoftDevice event interrupt (SWI2), which the queue pends.
+ */
+
+#ifndef SIM_SOC_H__
+#define SIM_SOC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**@brief Function for checking whether the firmware enabled the SoftDevice. */
+bool sim_soc_enabled(void);
+
+/**@brief Function for queuing a SoC event (NRF_EVT_*) and pending the event interrupt. */
+void sim_soc_evt_push(uint32_t evt_id);
+
+/**@brief Function for pending the SoftDevice event interrupt, for BLE events. */
+void sim_soc_evt_irq_pend(void);
+
+/**@brief Function for setting the die temperature, in 0.25 degree Celsius. */
+void sim_soc_temp_set(int32_t temp);
+
+/**@brief Function for getting the radio notification distance configured by the firmware.
+ *
+ * @return Distance in nanoseconds, or 0 if radio notifications are off.
+ */
+uint64_t sim_soc_radio_notification_distance(void);
+
+/**@brief Function for signalling the start (active) or end of a radio event. Pends the radio
+ *        notification interrupt when the firmware asked for that notification.
+ */
+void sim_soc_radio_notify(bool active);
+
+#endif /* SIM_SOC_H__ */
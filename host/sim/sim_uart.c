@@ -0,0 +1,333 @@
+/* Terminal at the other end of the UART. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "app_util.h"
+#include "sim.h"
+#include "sim_uart.h"
+#include "dlog.h"
+
+#define HEADER_LEN       10
+#define FRAME_MAX_LEN    (HEADER_LEN + 4 * DLOG_MAX_ARGS)
+#define RX_QUEUE_SIZE    4096
+#define BYTE_TIME        (SIM_S(10) / 115200)    /**< Until the driver sets it: 8N1 at 115200 baud. */
+
+/**@brief Bounds of the executable, where the format strings are. */
+extern char const __executable_start[];
+extern char const _end[];
+
+static uint8_t          m_frame[FRAME_MAX_LEN];
+static uint32_t         m_frame_len;
+static uint8_t          m_seq;
+static bool             m_seq_valid;
+static bool             m_line_start = true;
+static bool             m_echo;
+static char           * mp_text;
+static size_t           m_text_len;
+static size_t           m_text_size;
+static sim_uart_stats_t m_stats;
+
+static sim_uart_rx_handler_t m_rx_handler;
+static uint64_t              m_byte_time = BYTE_TIME;
+static uint8_t               m_rx_queue[RX_QUEUE_SIZE];
+static uint32_t              m_rx_read;
+static uint32_t              m_rx_write;
+static bool                  m_rx_busy;
+
+
+static void text_add(char const * p_str, size_t len)
+{
+    if (m_text_len + len + 1 > m_text_size)
+    {
+        m_text_size = MAX(2 * m_text_size, m_text_len + len + 4096);
+        mp_text     = realloc(mp_text, m_text_size);
+        if (mp_text == NULL)
+        {
+            perror("sim: uart text");
+            exit(1);
+        }
+    }
+    memcpy(&mp_text[m_text_len], p_str, len);
+    m_text_len += len;
+    mp_text[m_text_len] = '\0';
+
+    if (m_echo)
+    {
+        (void)fwrite(p_str, 1, len, stdout);
+    }
+}
+
+
+/**@brief Function for adding a message, with the time at the start of each line. */
+static void message_add(uint8_t level, char const * p_msg)
+{
+    static char const levels[] = "-EWID---";
+    char              stamp[32];
+    char const      * p_line = p_msg;
+
+    while (*p_line != '\0')
+    {
+        char const * p_end = strchr(p_line, '\n');
+        size_t       len   = (p_end != NULL) ? (size_t)(p_end - p_line + 1) : strlen(p_line);
+
+        if (m_line_start)
+        {
+            int n = snprintf(stamp, sizeof(stamp), "[%11.6f] %c: ",
+                             (double)sim_time() / SIM_S(1), levels[level & 7]);
+            text_add(stamp, n);
+        }
+        text_add(p_line, len);
+        m_line_start = (p_line[len - 1] == '\n');
+        p_line      += len;
+    }
+    if (m_echo)
+    {
+        (void)fflush(stdout);
+    }
+}
+
+
+static bool address_valid(uint32_t address)
+{
+    return (address >= (uintptr_t)__executable_start) && (address < (uintptr_t)_end);
+}
+
+
+/**@brief Function for formatting a message from its format string and 32-bit arguments, as the
+ *        decoder script does: one argument per conversion, %s pointing to a string in flash.
+ */
+static void message_format(char * p_out, size_t size, char const * p_fmt, uint32_t const * p_args,
+                           uint8_t nargs)
+{
+    size_t  len = 0;
+    uint8_t arg = 0;
+
+    while ((*p_fmt != '\0') && (len + 1 < size))
+    {
+        char     spec[16];
+        size_t   spec_len = 0;
+        uint32_t value;
+        int      n;
+
+        if (*p_fmt != '%')
+        {
+            p_out[len++] = *p_fmt++;
+            continue;
+        }
+        if (p_fmt[1] == '%')
+        {
+            p_out[len++] = '%';
+            p_fmt       += 2;
+            continue;
+        }
+
+        // Flags, width and precision are kept; length modifiers dropped, as all arguments are
+        // 32-bit words.
+        spec[spec_len++] = *p_fmt++;
+        while ((*p_fmt != '\0') && (strchr("-+ #0123456789.", *p_fmt) != NULL) && (spec_len < 12))
+        {
+            spec[spec_len++] = *p_fmt++;
+        }
+        while ((*p_fmt != '\0') && (strchr("hlzjt", *p_fmt) != NULL))
+        {
+            p_fmt++;
+        }
+        if (*p_fmt == '\0')
+        {
+            break;
+        }
+        spec[spec_len++] = *p_fmt;
+        spec[spec_len]   = '\0';
+
+        value = (arg < nargs) ? p_args[arg] : 0;
+        arg++;
+
+        switch (*p_fmt++)
+        {
+            case 'd':
+            case 'i':
+                n = snprintf(&p_out[len], size - len, spec, (int32_t)value);
+                break;
+
+            case 's':
+                if (address_valid(value))
+                {
+                    n = snprintf(&p_out[len], size - len, spec, (char const *)(uintptr_t)value);
+                }
+                else
+                {
+                    n = snprintf(&p_out[len], size - len, "<0x%08x>", value);
+                }
+                break;
+
+            case 'p':
+                n = snprintf(&p_out[len], size - len, "0x%08x", value);
+                break;
+
+            case 'c':
+                n = snprintf(&p_out[len], size - len, spec, (int)(uint8_t)value);
+                break;
+
+            default:
+                n = snprintf(&p_out[len], size - len, spec, value);
+                break;
+        }
+        if (n > 0)
+        {
+            len = MIN(len + n, size - 1);
+        }
+    }
+    p_out[len] = '\0';
+}
+
+
+static void frame_decode(void)
+{
+    uint8_t  nargs   = m_frame[1] & 0x0F;
+    uint8_t  level   = (m_frame[1] >> 4) & 0x07;
+    uint32_t fmt     = uint32_decode(&m_frame[6]);
+    uint32_t args[DLOG_MAX_ARGS];
+    char     msg[512];
+    uint8_t  i;
+
+    if (m_seq_valid && (m_frame[2] != m_seq))
+    {
+        m_stats.frames_lost += (uint8_t)(m_frame[2] - m_seq);
+    }
+    m_seq       = m_frame[2] + 1;
+    m_seq_valid = true;
+    m_stats.frames++;
+
+    for (i = 0; i < nargs; i++)
+    {
+        args[i] = uint32_decode(&m_frame[HEADER_LEN + 4 * i]);
+    }
+
+    if (address_valid(fmt))
+    {
+        message_format(msg, sizeof(msg), (char const *)(uintptr_t)fmt, args, nargs);
+    }
+    else
+    {
+        (void)snprintf(msg, sizeof(msg), "<frame with format at 0x%08x>\n", fmt);
+    }
+    message_add(level, msg);
+}
+
+
+void sim_uart_tx(uint8_t const * p_data, uint32_t len)
+{
+    uint32_t i;
+
+    m_stats.tx_bytes += len;
+
+    for (i = 0; i < len; i++)
+    {
+        if ((m_frame_len == 0) && (p_data[i] != DLOG_SYNC))
+        {
+            m_stats.bad_bytes++;
+            continue;
+        }
+        if ((m_frame_len == 1) && ((p_data[i] & 0x0F) > DLOG_MAX_ARGS))
+        {
+            // Not a frame header after all: look for the next sync byte.
+            m_stats.bad_bytes++;
+            m_frame_len = 0;
+            continue;
+        }
+
+        m_frame[m_frame_len++] = p_data[i];
+        if ((m_frame_len > 1) && (m_frame_len == HEADER_LEN + 4 * (m_frame[1] & 0x0F)))
+        {
+            frame_decode();
+            m_frame_len = 0;
+        }
+    }
+}
+
+
+static void rx_byte_send(void * p_context)
+{
+    uint8_t byte;
+
+    if (m_rx_read == m_rx_write)
+    {
+        m_rx_busy = false;
+        return;
+    }
+
+    byte = m_rx_queue[m_rx_read++ % RX_QUEUE_SIZE];
+    m_stats.rx_bytes++;
+    if (m_rx_handler != NULL)
+    {
+        m_rx_handler(byte);
+    }
+    (void)sim_at(sim_time() + m_byte_time, SIM_OWNER_WORLD, rx_byte_send, NULL);
+}
+
+
+void sim_uart_rx_handler_set(sim_uart_rx_handler_t handler, uint64_t byte_time)
+{
+    m_rx_handler = handler;
+    m_byte_time  = byte_time;
+}
+
+
+void sim_uart_rx_push(uint8_t const * p_data, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; (i < len) && (m_rx_write - m_rx_read < RX_QUEUE_SIZE); i++)
+    {
+        m_rx_queue[m_rx_write++ % RX_QUEUE_SIZE] = p_data[i];
+    }
+
+    if (!m_rx_busy)
+    {
+        m_rx_busy = true;
+        (void)sim_at(sim_time() + m_byte_time, SIM_OWNER_WORLD, rx_byte_send, NULL);
+    }
+}
+
+
+void sim_uart_line_push(char const * p_line)
+{
+    sim_uart_rx_push((uint8_t const *)p_line, strlen(p_line));
+    sim_uart_rx_push((uint8_t const *)"\n", 1);
+}
+
+
+void sim_uart_echo_set(bool echo)
+{
+    m_echo = echo;
+}
+
+
+char const * sim_uart_text_get(void)
+{
+    return (mp_text != NULL) ? mp_text : "";
+}
+
+
+bool sim_uart_text_find(char const * p_str)
+{
+    return strstr(sim_uart_text_get(), p_str) != NULL;
+}
+
+
+void sim_uart_text_clear(void)
+{
+    m_text_len = 0;
+    if (mp_text != NULL)
+    {
+        mp_text[0] = '\0';
+    }
+}
+
+
+void sim_uart_stats_get(sim_uart_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
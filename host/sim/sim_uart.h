@@ -0,0 +1,60 @@
+/* The other end of the UART: a terminal that decodes the log frames of the firmware (src/dlog.h)
+ * into text, and types lines into the console.
+ *
+ * The host UART driver (host/drivers/nrf_drv_uart.c) hands the bytes it sent to sim_uart_tx().
+ * Frames are decoded as tools/dlog_decode.py does, with the format strings read from the memory of
+ * the simulator, where the firmware runs. The text is kept for tests and, if enabled, printed on
+ * stdout with the simulated time.
+ *
+ * Lines typed with sim_uart_rx_push() reach the driver a byte at a time, at the baud rate.
+ */
+
+#ifndef SIM_UART_H__
+#define SIM_UART_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**@brief Function called for each byte received by the chip, set by the driver. */
+typedef void (*sim_uart_rx_handler_t)(uint8_t byte);
+
+/**@brief Counters of the terminal. */
+typedef struct
+{
+    uint32_t tx_bytes;         /**< Bytes sent by the firmware. */
+    uint32_t frames;           /**< Log frames decoded. */
+    uint32_t frames_lost;      /**< Frames dropped by the firmware, from the gaps in the sequence numbers. */
+    uint32_t bad_bytes;        /**< Bytes skipped to find the start of a frame. */
+    uint32_t rx_bytes;         /**< Bytes typed. */
+} sim_uart_stats_t;
+
+/**@brief Function for handing the bytes sent by the firmware to the terminal. Called by the driver. */
+void sim_uart_tx(uint8_t const * p_data, uint32_t len);
+
+/**@brief Function for setting the receiver of the bytes typed, and the time a byte takes on the
+ *        line. Called by the driver.
+ */
+void sim_uart_rx_handler_set(sim_uart_rx_handler_t handler, uint64_t byte_time);
+
+/**@brief Function for typing bytes. They follow those typed before. */
+void sim_uart_rx_push(uint8_t const * p_data, uint32_t len);
+
+/**@brief Function for typing a line, followed by a newline. */
+void sim_uart_line_push(char const * p_line);
+
+/**@brief Function for printing the decoded text on stdout as it arrives. Off by default. */
+void sim_uart_echo_set(bool echo);
+
+/**@brief Function for getting all the text decoded since the start or the last clear. */
+char const * sim_uart_text_get(void);
+
+/**@brief Function for checking whether the text decoded contains a string. */
+bool sim_uart_text_find(char const * p_str);
+
+/**@brief Function for clearing the text decoded. */
+void sim_uart_text_clear(void);
+
+/**@brief Function for getting the counters. */
+void sim_uart_stats_get(sim_uart_stats_t * p_stats);
+
+#endif /* SIM_UART_H__ */
@@ -0,0 +1,196 @@
+/* Runner of the tests of a test program: each test in a child process, so that it starts from a
+ * fresh simulation and a crash fails only that test.
+ *
+ *   test_xxx [name]    runs all the tests, or the one named
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "test.h"
+
+#define TESTS_MAX   32
+
+static struct
+{
+    char const * p_name;
+    test_fn_t    fn;
+} m_tests[TESTS_MAX];
+
+static uint32_t m_test_count;
+static char     m_reports[4096];       /**< Figures of the running test, printed when it passes. */
+static size_t   m_reports_len;
+
+
+void test_register(char const * p_name, test_fn_t fn)
+{
+    if (m_test_count < TESTS_MAX)
+    {
+        m_tests[m_test_count].p_name = p_name;
+        m_tests[m_test_count].fn     = fn;
+        m_test_count++;
+    }
+}
+
+
+void test_fail(char const * p_file, int line, char const * p_fmt, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "%s:%d: ", p_file, line);
+    va_start(args, p_fmt);
+    vfprintf(stderr, p_fmt, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    fflush(stderr);
+    _exit(1);
+}
+
+
+void test_report(char const * p_fmt, ...)
+{
+    va_list args;
+    int     n;
+
+    if (m_reports_len + 8 >= sizeof(m_reports))
+    {
+        return;
+    }
+    m_reports_len += snprintf(&m_reports[m_reports_len], sizeof(m_reports) - m_reports_len, "    ");
+    va_start(args, p_fmt);
+    n = vsnprintf(&m_reports[m_reports_len], sizeof(m_reports) - m_reports_len - 1, p_fmt, args);
+    va_end(args);
+    if (n > 0)
+    {
+        m_reports_len = strlen(m_reports);
+        m_reports[m_reports_len++] = '\n';
+        m_reports[m_reports_len]   = '\0';
+    }
+}
+
+
+bool test_isolated(void (*fn)(void * p_result), void * p_result, size_t size)
+{
+    int     fds[2];
+    pid_t   pid;
+    int     status;
+    size_t  got = 0;
+    ssize_t n;
+
+    fflush(stdout);
+    fflush(stderr);
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+
+    pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        fn(p_result);
+        if (write(fds[1], p_result, size) != (ssize_t)size)
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    while ((got < size) && ((n = read(fds[0], (uint8_t *)p_result + got, size - got)) > 0))
+    {
+        got += n;
+    }
+    close(fds[0]);
+    (void)waitpid(pid, &status, 0);
+    return (got == size) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+
+/**@brief Function for running a test in a child process.
+ *
+ * @return true if it passed.
+ */
+static bool test_run(uint32_t index)
+{
+    int     fds[2];
+    pid_t   pid;
+    int     status;
+    ssize_t n;
+    char    reports[sizeof(m_reports)];
+    size_t  len = 0;
+
+    fflush(stdout);
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+
+    pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        m_tests[index].fn();
+        if (write(fds[1], m_reports, m_reports_len) < 0)
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    while ((len < sizeof(reports) - 1) && ((n = read(fds[0], &reports[len], sizeof(reports) - 1 - len)) > 0))
+    {
+        len += n;
+    }
+    reports[len] = '\0';
+    close(fds[0]);
+    (void)waitpid(pid, &status, 0);
+
+    if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
+    {
+        printf("PASS %s\n%s", m_tests[index].p_name, reports);
+        return true;
+    }
+    if (WIFSIGNALED(status))
+    {
+        printf("FAIL %s (signal %d)\n", m_tests[index].p_name, WTERMSIG(status));
+    }
+    else
+    {
+        printf("FAIL %s\n", m_tests[index].p_name);
+    }
+    return false;
+}
+
+
+int main(int argc, char * argv[])
+{
+    uint32_t failed = 0;
+    uint32_t run    = 0;
+    uint32_t i;
+
+    // localtime() of the firmware is UTC, as on the chip.
+    (void)setenv("TZ", "UTC", 1);
+    tzset();
+
+    for (i = 0; i < m_test_count; i++)
+    {
+        if ((argc > 1) && (strcmp(argv[1], m_tests[i].p_name) != 0))
+        {
+            continue;
+        }
+        run++;
+        if (!test_run(i))
+        {
+            failed++;
+        }
+    }
+
+    printf("%s: %u of %u tests passed\n", argv[0], run - failed, run);
+    return ((failed == 0) && (run > 0)) ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+/* Tests of the firmware on the simulation layer.
+ *
+ * A test file defines its tests with TEST(); test/runner.c runs each one in its own process, from a
+ * fresh simulation, and reports the figures tests give with test_report(). A failed check ends
+ * the test.
+ *
+ *   TEST(boot)
+ *   {
+ *       sim_end_set(SIM_S(2));
+ *       TEST_ASSERT_EQUAL(0, sim_script_run());
+ *       TEST_ASSERT(sim_uart_text_find("PixWatch Starting"));
+ *   }
+ */
+
+#ifndef TEST_H__
+#define TEST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*test_fn_t)(void);
+
+/**@brief Function for registering a test. Use TEST() instead. */
+void test_register(char const * p_name, test_fn_t fn);
+
+/**@brief Function for failing the running test. Does not return. */
+void test_fail(char const * p_file, int line, char const * p_fmt, ...)
+    __attribute__((noreturn, format(printf, 3, 4)));
+
+/**@brief Function for reporting a figure of the running test, printed with its result. */
+void test_report(char const * p_fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/**@brief Function for running a function in a process of its own, from the state of the
+ *        simulation at the call, and getting its result back: to compare fresh runs.
+ *
+ * @return false if the function failed a check or crashed.
+ */
+bool test_isolated(void (*fn)(void * p_result), void * p_result, size_t size);
+
+#define TEST(NAME)                                                                  \
+    static void test_##NAME(void);                                                  \
+    static void __attribute__((constructor)) test_register_##NAME(void)             \
+    {                                                                               \
+        test_register(#NAME, test_##NAME);                                          \
+    }                                                                               \
+    static void test_##NAME(void)
+
+#define TEST_ASSERT(COND)                                                           \
+    do                                                                              \
+    {                                                                               \
+        if (!(COND))                                                                \
+        {                                                                           \
+            test_fail(__FILE__, __LINE__, "%s", #COND);                             \
+        }                                                                           \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL(EXPECTED, ACTUAL)                                         \
+    do                                                                              \
+    {                                                                               \
+        long long expected_ = (long long)(EXPECTED);                                \
+        long long actual_   = (long long)(ACTUAL);                                  \
+        if (expected_ != actual_)                                                   \
+        {                                                                           \
+            test_fail(__FILE__, __LINE__, "%s is %lld, expected %lld",              \
+                      #ACTUAL, actual_, expected_);                                 \
+        }                                                                           \
+    } while (0)
+
+#endif /* TEST_H__ */
@@ -0,0 +1,88 @@
+/* The advertising policy against a trace of disconnects: a phone that stays connected for longer
+ * than an RTC1 wrap each time, and comes back after a few minutes. The time and energy the policy
+ * accounts must be those of advertising only, as the link layer counts them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_uart.h"
+#include "sim_script.h"
+#include "adv_policy.h"
+#include "test.h"
+
+#define CONNECTED_TIME  600            /**< Time each link lasts, in seconds: over the 512 s RTC1 wrap. */
+#define FIRST_CONNECT   1              /**< First connection, in seconds from the start. */
+
+/* Time the phone stays away after each disconnect, in seconds; one absence is longer than two
+ * limited discoverable periods.
+ */
+static uint32_t const m_latencies[] = {95, 100, 90, 105, 98, 400, 93};
+
+#define RECONNECTS      ((uint32_t)(sizeof(m_latencies) / sizeof(m_latencies[0])))
+
+static char m_script[1024];
+
+
+/**@brief Function for writing the script of the trace.
+ *
+ * @return Sum of the absences, in seconds.
+ */
+static uint32_t trace_script(void)
+{
+    uint32_t sum    = 0;
+    uint32_t length;
+    uint32_t i;
+
+    length = snprintf(m_script, sizeof(m_script), "%u connect 0\n", FIRST_CONNECT);
+    for (i = 0; i < RECONNECTS; i++)
+    {
+        length += snprintf(&m_script[length], sizeof(m_script) - length,
+                           "+%u disconnect 0\n+%u connect 0\n", CONNECTED_TIME, m_latencies[i]);
+        sum    += m_latencies[i];
+    }
+    (void)snprintf(&m_script[length], sizeof(m_script) - length, "+%u type adv\n", CONNECTED_TIME);
+
+    return sum;
+}
+
+
+TEST(disconnect_trace)
+{
+    adv_policy_stats_t policy;
+    sim_ble_stats_t    link_layer;
+    uint32_t           absent = trace_script();
+    uint32_t           advertised;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    sim_end_set(SIM_S(FIRST_CONNECT + absent + (RECONNECTS + 1) * CONNECTED_TIME + 1));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    adv_policy_stats_get(&policy);
+    sim_ble_stats_get(&link_layer);
+    TEST_ASSERT_EQUAL(RECONNECTS + 1, link_layer.connections);
+    TEST_ASSERT_EQUAL(RECONNECTS, policy.reconnects);
+
+    // Each reconnect comes at most one slow interval after the phone is back.
+    TEST_ASSERT((policy.latency_avg + 1 >= absent / RECONNECTS) && (policy.latency_avg <= absent / RECONNECTS + 2));
+    // The median absence is 98 s; latencies are counted in whole seconds from the disconnect event.
+    TEST_ASSERT((policy.latency_predicted >= 96) && (policy.latency_predicted <= 100));
+
+    // The links are not counted as advertising, however long they last.
+    advertised = policy.fast_seconds + policy.slow_seconds;
+    TEST_ASSERT((advertised + RECONNECTS + 1 >= FIRST_CONNECT + absent) &&
+                (advertised <= FIRST_CONNECT + absent + 2 * (RECONNECTS + 1)));
+
+    // The estimate from the intervals is within the random advertising delay of the events held.
+    TEST_ASSERT((policy.adv_events * 100 >= link_layer.adv_events * 90) &&
+                (policy.adv_events * 100 <= link_layer.adv_events * 110));
+
+    TEST_ASSERT(sim_uart_text_find("Advertising: 7 reconnects"));
+
+    test_report("%u reconnects, average %u s, predicted %u s",
+                policy.reconnects, policy.latency_avg, policy.latency_predicted);
+    test_report("%u s fast, %u s slow, %u events (%u held), %u uC, %u uC per reconnect",
+                policy.fast_seconds, policy.slow_seconds, policy.adv_events, link_layer.adv_events,
+                policy.charge_uc, policy.charge_uc / RECONNECTS);
+}
@@ -0,0 +1,139 @@
+/* The prebuilt advertising payloads of adv_payload against adv_data_encode() of the SDK, which
+ * encoded the payload before them: the same bytes for each payload and status.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_script.h"
+#include "ble_advdata.h"
+#include "ble_gap.h"
+#include "nrf_error.h"
+#include "adv_payload.h"
+#include "test.h"
+
+typedef struct
+{
+    uint8_t  battery_level;
+    uint16_t unread_count;
+} status_t;
+
+static status_t const m_statuses[] =
+{
+    {ADV_PAYLOAD_BATTERY_UNKNOWN, 0},
+    {80,                          3},
+    {100,                         0x1234},
+    {0,                           0xFFFF},
+};
+
+#define STATUS_COUNT  (sizeof(m_statuses) / sizeof(m_statuses[0]))
+
+static uint32_t m_boot_mismatch;    /**< Bytes of the boot payload that differ, or 0xFF on no payload. */
+static uint32_t m_compared;         /**< Payloads compared. */
+static uint32_t m_mismatches;       /**< Payloads that differ from the encoded ones. */
+static uint8_t  m_payload_len;
+
+
+/**@brief Function for encoding a payload the way main.c did before adv_payload. */
+static uint16_t advdata_encode(uint8_t flags, status_t const * p_status, uint8_t * p_data)
+{
+    ble_advdata_t            advdata;
+    ble_advdata_manuf_data_t manuf;
+    uint8_t                  status[4];
+    uint16_t                 len = BLE_GAP_ADV_MAX_SIZE;
+
+    status[0] = ADV_PAYLOAD_STATUS_VERSION;
+    status[1] = p_status->battery_level;
+    status[2] = (uint8_t)p_status->unread_count;
+    status[3] = (uint8_t)(p_status->unread_count >> 8);
+
+    manuf.company_identifier = ADV_PAYLOAD_COMPANY_ID;
+    manuf.data.p_data        = status;
+    manuf.data.size          = sizeof(status);
+
+    memset(&advdata, 0, sizeof(advdata));
+    advdata.name_type             = BLE_ADVDATA_FULL_NAME;
+    advdata.include_appearance    = true;
+    advdata.flags                 = flags;
+    advdata.p_manuf_specific_data = &manuf;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, adv_data_encode(&advdata, p_data, &len));
+    return len;
+}
+
+
+static bool payload_matches(uint8_t flags, status_t const * p_status)
+{
+    uint8_t  set[BLE_GAP_ADV_MAX_SIZE];
+    uint8_t  encoded[BLE_GAP_ADV_MAX_SIZE];
+    uint8_t  set_len;
+    uint16_t encoded_len;
+
+    set_len     = sim_ble_adv_data_get(set);
+    encoded_len = advdata_encode(flags, p_status, encoded);
+
+    m_payload_len = set_len;
+    return (set_len == encoded_len) && (memcmp(set, encoded, set_len) == 0);
+}
+
+
+/**@brief Function for comparing the payloads, run on the device once it advertises. */
+static void payloads_compare(void * p_context)
+{
+    static uint8_t const flags[ADV_PAYLOAD_COUNT] =
+    {
+        [ADV_PAYLOAD_DISCOVERABLE] = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE,
+        [ADV_PAYLOAD_WHITELIST]    = BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED,
+    };
+    uint32_t kind;
+    uint32_t i;
+
+    // At boot: discoverable, with an unknown battery level and an empty inbox.
+    m_boot_mismatch = !payload_matches(flags[ADV_PAYLOAD_DISCOVERABLE], &m_statuses[0]);
+
+    for (kind = 0; kind < ADV_PAYLOAD_COUNT; kind++)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, adv_payload_select((adv_payload_kind_t)kind));
+        for (i = 0; i < STATUS_COUNT; i++)
+        {
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, adv_payload_status_set(m_statuses[i].battery_level,
+                                                                  m_statuses[i].unread_count));
+            m_compared++;
+            if (!payload_matches(flags[kind], &m_statuses[i]))
+            {
+                m_mismatches++;
+            }
+        }
+    }
+}
+
+
+TEST(same_bytes)
+{
+    TEST_ASSERT(sim_script_parse(""));
+    (void)sim_at(SIM_S(1), SIM_OWNER_WORLD, payloads_compare, NULL);
+    sim_end_set(SIM_S(2));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT_EQUAL(0, m_boot_mismatch);
+    TEST_ASSERT_EQUAL(ADV_PAYLOAD_COUNT * STATUS_COUNT, m_compared);
+    TEST_ASSERT_EQUAL(0, m_mismatches);
+    test_report("%u payloads of %u bytes equal to adv_data_encode()", m_compared, m_payload_len);
+}
+
+
+TEST(unchanged_not_set)
+{
+    adv_payload_stats_t stats;
+
+    // The clock ticks from the boot on: once a second after the low frequency clock starts.
+    TEST_ASSERT(sim_script_parse("1 connect 0\n"));
+    sim_end_set(SIM_S(11));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    // The tick posts the status every second; it goes to the SoftDevice only when advertising
+    // starts, as it does not change.
+    adv_payload_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.data_sets);
+    TEST_ASSERT_EQUAL(10, stats.unchanged);
+}
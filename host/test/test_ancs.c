@@ -0,0 +1,455 @@
+/* The ANCS notification fetcher against a Notification Provider on the phone: the control point
+ * writes one notification takes, with the app display name cached or not, and how a fetch ends
+ * when notifications arrive together, when the provider does not answer, when it refuses a
+ * prepared write and when the inbox is still writing the notification before.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_flash.h"
+#include "sim_peer.h"
+#include "sim_script.h"
+#include "ble_ancs_c.h"
+#include "ancs_notif.h"
+#include "inbox.h"
+#include "test.h"
+
+#define NOTIFY_TIME      SIM_S(10)      /**< The phone bonds 4 s after the connection, then ANCS is found. */
+#define NOTIFY_SPACING   SIM_S(15)      /**< Time for one notification, at a connection interval of 1 s. */
+#define FETCH_TIMEOUT    SIM_S(30)      /**< ANCS_FETCH_TIMEOUT of main.c. */
+#define SLOW_WRITE       SIM_S(2)       /**< Flash write time that keeps the inbox busy over connection events. */
+
+/**@brief An app on the phone. */
+typedef struct
+{
+    char const * p_id;
+    char const * p_name;
+} np_app_t;
+
+static np_app_t const m_apps[] =
+{
+    {"com.skype.skype", "Skype"},
+    {"com.example.calendar.reminders", "Reminders"},   // Too long for one control point write.
+};
+
+/**@brief A notification on the phone; its UID is its index. */
+typedef struct
+{
+    uint8_t      app;
+    char const * p_title;
+    char const * p_message;
+} np_notif_t;
+
+static np_notif_t const m_notifs[] =
+{
+    {0, "Alice", "Lunch at noon?"},
+    {0, "Bob",   "On my way"},
+    {1, "Dentist", "Tomorrow at 9:30"},
+    {0, "Alice", "See you there"},
+};
+
+#define NOTIF_COUNT  (sizeof(m_notifs) / sizeof(m_notifs[0]))
+
+/**@brief Notification Provider of the phone. */
+static struct
+{
+    uint16_t cp_handle;
+    uint16_t ns_handle;
+    uint16_t ds_handle;
+    uint32_t mute;              /**< Requests left to ignore. */
+    uint32_t requests;          /**< Control point writes answered. */
+    uint32_t bad_requests;      /**< Control point writes that are not a whole command. */
+    uint8_t  rsp[128];          /**< Response waiting for the write response to go first. */
+    uint16_t rsp_len;
+} m_np;
+
+static uint32_t           m_ops[NOTIF_COUNT];     /**< Control point writes of each notification, as the fetcher counted them. */
+static ancs_notif_stats_t m_stats_before;         /**< Statistics before the fetch timeout. */
+
+
+static void put16(uint8_t * p_dst, uint16_t value)
+{
+    p_dst[0] = (uint8_t)value;
+    p_dst[1] = (uint8_t)(value >> 8);
+}
+
+
+static void put32(uint8_t * p_dst, uint32_t value)
+{
+    put16(p_dst, (uint16_t)value);
+    put16(&p_dst[2], (uint16_t)(value >> 16));
+}
+
+
+static uint16_t attr_put(uint8_t * p_dst, uint8_t id, char const * p_value, uint16_t max_len)
+{
+    uint16_t len = strlen(p_value);
+
+    if (len > max_len)
+    {
+        len = max_len;
+    }
+    p_dst[0] = id;
+    put16(&p_dst[1], len);
+    memcpy(&p_dst[3], p_value, len);
+    return 3 + len;
+}
+
+
+/**@brief Function for sending the response on the Data Source, in notifications of one ATT MTU. */
+static void np_respond_send(void * p_context)
+{
+    uint16_t offset;
+
+    for (offset = 0; offset < m_np.rsp_len; offset += GATT_MTU_SIZE_DEFAULT - 3)
+    {
+        uint16_t chunk = m_np.rsp_len - offset;
+
+        if (chunk > GATT_MTU_SIZE_DEFAULT - 3)
+        {
+            chunk = GATT_MTU_SIZE_DEFAULT - 3;
+        }
+        TEST_ASSERT(sim_peer_hvx(sim_script_peer(0), m_np.ds_handle, &m_np.rsp[offset], chunk));
+    }
+}
+
+
+/**@brief Function for sending a response after the write response to the command, as a phone does. */
+static void np_respond(uint8_t const * p_rsp, uint16_t len)
+{
+    memcpy(m_np.rsp, p_rsp, len);
+    m_np.rsp_len = len;
+    (void)sim_at(sim_time() + SIM_US(1), SIM_OWNER_WORLD, np_respond_send, NULL);
+}
+
+
+/**@brief Function for answering Get Notification Attributes: the app identifier, then the title
+ *        and the message cut to the length asked for.
+ */
+static bool notif_attrs_answer(uint8_t const * p_cmd, uint16_t len)
+{
+    uint8_t            rsp[128];
+    uint16_t           rsp_len = 0;
+    uint16_t           i       = 5;
+    uint32_t           uid;
+    np_notif_t const * p_notif;
+
+    if (len < 5)
+    {
+        return false;
+    }
+    uid = p_cmd[1] | (p_cmd[2] << 8) | (p_cmd[3] << 16) | ((uint32_t)p_cmd[4] << 24);
+    if (uid >= NOTIF_COUNT)
+    {
+        return false;
+    }
+    p_notif = &m_notifs[uid];
+
+    memcpy(rsp, p_cmd, 5);
+    rsp_len = 5;
+    while (i < len)
+    {
+        uint8_t  id      = p_cmd[i++];
+        uint16_t max_len = 0xFFFF;
+
+        if ((id == BLE_ANCS_NOTIF_ATTR_ID_TITLE) || (id == BLE_ANCS_NOTIF_ATTR_ID_MESSAGE))
+        {
+            if (i + 2 > len)
+            {
+                return false;
+            }
+            max_len = p_cmd[i] | (p_cmd[i + 1] << 8);
+            i      += 2;
+        }
+        switch (id)
+        {
+            case BLE_ANCS_NOTIF_ATTR_ID_APP_IDENTIFIER:
+                rsp_len += attr_put(&rsp[rsp_len], id, m_apps[p_notif->app].p_id, max_len);
+                break;
+
+            case BLE_ANCS_NOTIF_ATTR_ID_TITLE:
+                rsp_len += attr_put(&rsp[rsp_len], id, p_notif->p_title, max_len);
+                break;
+
+            case BLE_ANCS_NOTIF_ATTR_ID_MESSAGE:
+                rsp_len += attr_put(&rsp[rsp_len], id, p_notif->p_message, max_len);
+                break;
+
+            default:
+                return false;
+        }
+    }
+    np_respond(rsp, rsp_len);
+    return true;
+}
+
+
+/**@brief Function for answering Get App Attributes for the display name. */
+static bool app_attrs_answer(uint8_t const * p_cmd, uint16_t len)
+{
+    uint8_t  rsp[128];
+    uint16_t id_len;
+    uint32_t i;
+
+    id_len = strnlen((char const *)&p_cmd[1], len - 1);
+    if ((id_len + 3 != len) || (p_cmd[len - 1] != BLE_ANCS_APP_ATTR_ID_DISPLAY_NAME))
+    {
+        return false;
+    }
+    for (i = 0; i < sizeof(m_apps) / sizeof(m_apps[0]); i++)
+    {
+        if ((strlen(m_apps[i].p_id) == id_len) && (memcmp(m_apps[i].p_id, &p_cmd[1], id_len) == 0))
+        {
+            memcpy(rsp, p_cmd, len - 1);
+            np_respond(rsp, len - 1 + attr_put(&rsp[len - 1], BLE_ANCS_APP_ATTR_ID_DISPLAY_NAME,
+                                           m_apps[i].p_name, 0xFFFF));
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void np_evt_handler(sim_peer_t * p_peer, sim_peer_evt_t const * p_evt)
+{
+    bool ok = false;
+
+    if ((p_evt->type != SIM_PEER_EVT_WRITE) || (p_evt->handle != m_np.cp_handle))
+    {
+        return;
+    }
+    if (m_np.mute > 0)
+    {
+        m_np.mute--;
+        return;
+    }
+    if (p_evt->len > 0)
+    {
+        if (p_evt->p_data[0] == BLE_ANCS_COMMAND_ID_GET_NOTIF_ATTRIBUTES)
+        {
+            ok = notif_attrs_answer(p_evt->p_data, p_evt->len);
+        }
+        else if (p_evt->p_data[0] == BLE_ANCS_COMMAND_ID_GET_APP_ATTRIBUTES)
+        {
+            ok = app_attrs_answer(p_evt->p_data, p_evt->len);
+        }
+    }
+    if (ok)
+    {
+        m_np.requests++;
+    }
+    else
+    {
+        m_np.bad_requests++;
+    }
+}
+
+
+/**@brief Function for adding the Notification Provider to the phone, after the PixWatch Service. */
+static void np_add(sim_peer_t * p_peer)
+{
+    uint8_t empty = 0;
+
+    memset(&m_np, 0, sizeof(m_np));
+    (void)sim_peer_service_add(p_peer, ble_ancs_base_uuid128.uuid128, 16);
+    m_np.ns_handle = sim_peer_char_add(p_peer, ble_ancs_ns_base_uuid128.uuid128, 16, 0x10, &empty, 1);
+    m_np.cp_handle = sim_peer_char_add(p_peer, ble_ancs_cp_base_uuid128.uuid128, 16, 0x08, &empty, 1);
+    m_np.ds_handle = sim_peer_char_add(p_peer, ble_ancs_ds_base_uuid128.uuid128, 16, 0x10, &empty, 1);
+    p_peer->evt_handler = np_evt_handler;
+}
+
+
+/**@brief Function for posting a new notification on the Notification Source. */
+static void np_notify(void * p_context)
+{
+    uint8_t data[8] = {BLE_ANCS_EVENT_ID_NOTIFICATION_ADDED, 0, BLE_ANCS_CATEGORY_ID_SOCIAL, 1};
+
+    put32(&data[4], (uint32_t)(uintptr_t)p_context);
+    TEST_ASSERT(sim_peer_hvx(sim_script_peer(0), m_np.ns_handle, data, sizeof(data)));
+}
+
+
+static void ops_record(void * p_context)
+{
+    ancs_notif_stats_t stats;
+
+    ancs_notif_stats_get(&stats);
+    m_ops[(uintptr_t)p_context] = stats.last_gatt_ops;
+}
+
+
+static void stats_record(void * p_context)
+{
+    ancs_notif_stats_get(&m_stats_before);
+}
+
+
+static void ancs_run(uint64_t end)
+{
+    sim_end_set(end);
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+}
+
+
+static void ancs_setup(void)
+{
+    TEST_ASSERT(sim_script_parse("1 connect 0\n"));
+    np_add(sim_script_peer(0));
+}
+
+
+/**@brief Function for checking the inbox record of a notification. */
+static void record_check(uint32_t k, uint32_t uid)
+{
+    inbox_entry_t const * p_entry = inbox_latest(k);
+    char                  expected[INBOX_MSG_MAX_LEN + 1];
+    uint16_t              len;
+
+    TEST_ASSERT(p_entry != NULL);
+    TEST_ASSERT_EQUAL(uid, p_entry->id);
+    len = snprintf(expected, sizeof(expected), "%s\n%s\n%s", m_apps[m_notifs[uid].app].p_name,
+                   m_notifs[uid].p_title, m_notifs[uid].p_message);
+    TEST_ASSERT_EQUAL(len, p_entry->length);
+    TEST_ASSERT_EQUAL(0, memcmp(inbox_data_get(p_entry), expected, len));
+}
+
+
+TEST(gatt_ops_per_notification)
+{
+    ancs_notif_stats_t stats;
+    uint32_t           uid;
+
+    // One at a time: a short app identifier, the same app again, then a long app identifier.
+    ancs_setup();
+    for (uid = 0; uid < 3; uid++)
+    {
+        (void)sim_at(NOTIFY_TIME + uid * NOTIFY_SPACING, SIM_OWNER_WORLD, np_notify, (void *)(uintptr_t)uid);
+        (void)sim_at(NOTIFY_TIME + (uid + 1) * NOTIFY_SPACING - SIM_S(1), SIM_OWNER_WORLD, ops_record,
+                     (void *)(uintptr_t)uid);
+    }
+    ancs_run(NOTIFY_TIME + 3 * NOTIFY_SPACING);
+
+    ancs_notif_stats_get(&stats);
+    TEST_ASSERT_EQUAL(3, stats.notifications);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(2, stats.cache_misses);
+    TEST_ASSERT_EQUAL(1, stats.cache_hits);
+    TEST_ASSERT_EQUAL(0, m_np.bad_requests);
+    for (uid = 0; uid < 3; uid++)
+    {
+        record_check(2 - uid, uid);
+    }
+
+    // Notification attributes, then the display name in one write or in prepared writes and
+    // their execute write.
+    TEST_ASSERT_EQUAL(2, m_ops[0]);
+    TEST_ASSERT_EQUAL(1, m_ops[1]);
+    TEST_ASSERT_EQUAL(4, m_ops[2]);
+    test_report("control point writes per notification: %u cached name, %u short app id, %u long app id",
+                m_ops[1], m_ops[0], m_ops[2]);
+}
+
+
+TEST(notifications_together)
+{
+    ancs_notif_stats_t stats;
+    uint32_t           uid;
+
+    // The later notifications arrive before the attributes of the first one; each response is
+    // matched with its own request.
+    ancs_setup();
+    for (uid = 0; uid < NOTIF_COUNT; uid++)
+    {
+        (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, (void *)(uintptr_t)uid);
+    }
+    ancs_run(NOTIFY_TIME + NOTIF_COUNT * NOTIFY_SPACING);
+
+    ancs_notif_stats_get(&stats);
+    TEST_ASSERT_EQUAL(NOTIF_COUNT, stats.notifications);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(NOTIF_COUNT, inbox_count());
+    for (uid = 0; uid < NOTIF_COUNT; uid++)
+    {
+        record_check(NOTIF_COUNT - 1 - uid, uid);
+    }
+}
+
+
+TEST(provider_silent)
+{
+    ancs_notif_stats_t stats;
+
+    // The first request is never answered; the second notification waits for the timeout.
+    ancs_setup();
+    m_np.mute = 1;
+    (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, (void *)0);
+    (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, (void *)1);
+    (void)sim_at(NOTIFY_TIME + FETCH_TIMEOUT - SIM_S(1), SIM_OWNER_WORLD, stats_record, NULL);
+    ancs_run(NOTIFY_TIME + FETCH_TIMEOUT + NOTIFY_SPACING);
+
+    TEST_ASSERT_EQUAL(0, m_stats_before.notifications);
+    TEST_ASSERT_EQUAL(0, m_stats_before.timeouts);
+
+    ancs_notif_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.timeouts);
+    TEST_ASSERT_EQUAL(1, stats.dropped);
+    TEST_ASSERT_EQUAL(1, stats.notifications);
+    TEST_ASSERT_EQUAL(1, inbox_count());
+    record_check(0, 1);
+}
+
+
+TEST(prepared_write_refused)
+{
+    ancs_notif_stats_t stats;
+    sim_peer_t       * p_peer;
+
+    // The prepare queue of the phone takes one chunk of the long app identifier only. The rest of
+    // the request is dropped and the chunk cancelled, so the next request goes out whole.
+    ancs_setup();
+    p_peer           = sim_script_peer(0);
+    p_peer->prep_max = 6 + GATT_MTU_SIZE_DEFAULT - 5;
+    (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, (void *)2);
+    (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, (void *)0);
+    ancs_run(NOTIFY_TIME + 2 * NOTIFY_SPACING);
+
+    ancs_notif_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.dropped);
+    TEST_ASSERT_EQUAL(0, stats.timeouts);
+    TEST_ASSERT_EQUAL(1, stats.notifications);
+    TEST_ASSERT_EQUAL(0, m_np.bad_requests);
+    TEST_ASSERT_EQUAL(0, p_peer->prep_len);
+    record_check(0, 0);
+}
+
+
+TEST(inbox_busy)
+{
+    ancs_notif_stats_t stats;
+    sim_flash_config_t config;
+    uint32_t           uid;
+
+    // With a slow flash, the cached app names complete notifications while the inbox still
+    // writes the one before; they wait for it instead of being dropped.
+    sim_flash_config_default(&config);
+    config.write_overhead = SLOW_WRITE;
+    sim_flash_config_set(&config);
+    ancs_setup();
+    for (uid = 0; uid < NOTIF_COUNT; uid++)
+    {
+        (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, (void *)(uintptr_t)uid);
+    }
+    ancs_run(NOTIFY_TIME + NOTIF_COUNT * NOTIFY_SPACING);
+
+    ancs_notif_stats_get(&stats);
+    TEST_ASSERT(stats.deferred > 0);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(NOTIF_COUNT, stats.notifications);
+    TEST_ASSERT_EQUAL(NOTIF_COUNT, inbox_count());
+    for (uid = 0; uid < NOTIF_COUNT; uid++)
+    {
+        record_check(NOTIF_COUNT - 1 - uid, uid);
+    }
+    test_report("%u of %u notifications waited for the inbox", stats.deferred, (uint32_t)NOTIF_COUNT);
+}
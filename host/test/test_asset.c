@@ -0,0 +1,436 @@
+/* Asset upload from a phone: write commands paced by the credits of the watch, on a clean link and
+ * on one that loses packets, a transfer resumed after the link drops, and one whose trailer fails
+ * to be written. The phone finds the
+ * Asset Transfer Service, enables the control point notifications and sends the asset with its
+ * SHA-256, which the watch checks before it keeps the asset.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_flash.h"
+#include "sim_peer.h"
+#include "sim_script.h"
+#include "nordic_common.h"
+#include "app_util.h"
+#include "ble_hci.h"
+#include "sha256.h"
+#include "ble_asset.h"
+#include "test.h"
+
+#define ASSET_ID        7
+#define ASSET_LEN       2000
+#define UPLOAD_TIME     SIM_S(10)      /**< Bonded and encrypted by then. */
+#define PUMP_INTERVAL   SIM_MS(5)      /**< Phone stack queuing write commands. */
+#define QUEUE_MAX       8              /**< Write commands the phone keeps queued. */
+#define UUID_CHAR_DECL  0x2803
+#define DROP_AFTER      60             /**< Chunks sent before the link drops, in the resume test. */
+#define RECONNECT_DELAY SIM_S(2)
+#define CHUNKS          ((ASSET_LEN + BLE_ASSET_CHUNK_LEN - 1) / BLE_ASSET_CHUNK_LEN)
+
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n";
+
+/**@brief Steps of the phone, in order. */
+typedef enum
+{
+    STEP_DISCOVER,
+    STEP_CCCD,
+    STEP_BEGIN,
+    STEP_DATA,
+    STEP_DIGEST_0,
+    STEP_DIGEST_1,
+    STEP_COMMIT,
+    STEP_DONE,
+} step_t;
+
+/**@brief The uploader of the phone. */
+static struct
+{
+    sim_peer_t * p_peer;
+    step_t       step;
+    uint16_t     ctrl_handle;
+    uint16_t     data_handle;
+    uint16_t     discover_from;
+    uint32_t     offset;         /**< Resume offset of the last BEGIN. */
+    uint16_t     seq;            /**< Next chunk to send. */
+    uint16_t     credit_limit;
+    uint32_t     chunks_sent;
+    uint32_t     resends;        /**< RESEND notifications received. */
+    uint32_t     drop_after;     /**< Chunks sent before the link drops, 0 to keep it. */
+    int32_t      commit_status;  /**< Status of COMMIT_RSP, -1 before it. */
+    uint64_t     start;          /**< First BEGIN response. */
+    uint64_t     end;
+    uint32_t     begins;
+    uint32_t     flash_ops;      /**< Flash operations done by COMMIT_RSP. */
+} m_up;
+
+static uint8_t m_asset[ASSET_LEN];
+static uint8_t m_digest[32];
+
+
+static void asset_make(void)
+{
+    sha256_context_t ctx;
+    uint32_t         i;
+
+    for (i = 0; i < ASSET_LEN; i++)
+    {
+        m_asset[i] = (uint8_t)((i * 7) ^ (i >> 5));
+    }
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sha256_init(&ctx));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sha256_update(&ctx, m_asset, ASSET_LEN));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, sha256_final(&ctx, m_digest));
+}
+
+
+static void ctrl_write(uint8_t const * p_data, uint16_t len)
+{
+    TEST_ASSERT(sim_peer_write(m_up.p_peer, m_up.ctrl_handle, p_data, len, true));
+}
+
+
+/**@brief Function for reading the next characteristic declarations of the watch. */
+static void discover_next(void)
+{
+    uint8_t pdu[7] = {SIM_ATT_READ_BY_TYPE_REQ};
+
+    (void)uint16_encode(m_up.discover_from, &pdu[1]);
+    (void)uint16_encode(0xFFFF, &pdu[3]);
+    (void)uint16_encode(UUID_CHAR_DECL, &pdu[5]);
+    TEST_ASSERT(sim_peer_request(m_up.p_peer, pdu, sizeof(pdu)));
+}
+
+
+static void begin_send(void)
+{
+    uint8_t pdu[7] = {ASSET_OP_BEGIN};
+
+    (void)uint16_encode(ASSET_ID, &pdu[1]);
+    (void)uint32_encode(ASSET_LEN, &pdu[3]);
+    m_up.step = STEP_BEGIN;
+    m_up.begins++;
+    ctrl_write(pdu, sizeof(pdu));
+}
+
+
+static void digest_send(uint8_t part)
+{
+    uint8_t pdu[18] = {ASSET_OP_DIGEST, part};
+
+    memcpy(&pdu[2], &m_digest[part * 16], 16);
+    ctrl_write(pdu, sizeof(pdu));
+}
+
+
+/**@brief Function for the responses to the requests of the phone: discovery, then the control
+ *        point writes one after the other.
+ */
+static void on_response(uint8_t const * p_pdu, uint16_t len)
+{
+    uint8_t  cccd[2] = {BLE_GATT_HVX_NOTIFICATION, 0};
+    uint8_t  commit  = ASSET_OP_COMMIT;
+    uint16_t i;
+
+    switch (m_up.step)
+    {
+        case STEP_DISCOVER:
+            if (p_pdu[0] == SIM_ATT_ERROR_RSP)
+            {
+                // End of the table: the control point CCCD follows its value.
+                TEST_ASSERT((m_up.ctrl_handle != 0) && (m_up.data_handle != 0));
+                m_up.step = STEP_CCCD;
+                TEST_ASSERT(sim_peer_write(m_up.p_peer, m_up.ctrl_handle + 1, cccd, sizeof(cccd), true));
+                break;
+            }
+            // Declarations of 128-bit UUIDs: handle, properties, value handle, UUID.
+            for (i = 2; i + p_pdu[1] <= len; i += p_pdu[1])
+            {
+                uint16_t uuid = (p_pdu[1] == 21) ? uint16_decode(&p_pdu[i + 17]) : 0;
+
+                m_up.discover_from = uint16_decode(&p_pdu[i]) + 1;
+                if (uuid == ASSET_UUID_CHAR_CTRL)
+                {
+                    m_up.ctrl_handle = uint16_decode(&p_pdu[i + 3]);
+                }
+                else if (uuid == ASSET_UUID_CHAR_DATA)
+                {
+                    m_up.data_handle = uint16_decode(&p_pdu[i + 3]);
+                }
+            }
+            discover_next();
+            break;
+
+        case STEP_CCCD:
+            TEST_ASSERT_EQUAL(SIM_ATT_WRITE_RSP, p_pdu[0]);
+            begin_send();
+            break;
+
+        case STEP_DIGEST_0:
+            m_up.step = STEP_DIGEST_1;
+            digest_send(1);
+            break;
+
+        case STEP_DIGEST_1:
+            m_up.step = STEP_COMMIT;
+            ctrl_write(&commit, sizeof(commit));
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for the control point notifications of the watch. */
+static uint32_t flash_ops(void)
+{
+    sim_flash_stats_t stats;
+
+    sim_flash_stats_get(&stats);
+    return stats.writes + stats.erases + stats.errors;
+}
+
+
+static void on_ctrl_notification(uint8_t const * p_data, uint16_t len)
+{
+    switch (p_data[0])
+    {
+        case ASSET_OP_BEGIN_RSP:
+            TEST_ASSERT_EQUAL(ASSET_STATUS_SUCCESS, p_data[1]);
+            m_up.offset       = uint32_decode(&p_data[2]);
+            m_up.seq          = 0;
+            m_up.credit_limit = 0;
+            m_up.step         = STEP_DATA;
+            if (m_up.start == 0)
+            {
+                m_up.start = sim_time();
+            }
+            break;
+
+        case ASSET_OP_CREDIT:
+            // The next expected chunk lags those in flight; only the limit counts.
+            m_up.credit_limit = uint16_decode(&p_data[1]);
+            break;
+
+        case ASSET_OP_RESEND:
+            m_up.credit_limit = uint16_decode(&p_data[1]);
+            m_up.seq          = uint16_decode(&p_data[3]);
+            m_up.resends++;
+            break;
+
+        case ASSET_OP_COMMIT_RSP:
+            m_up.commit_status = p_data[1];
+            m_up.step          = STEP_DONE;
+            m_up.end           = sim_time();
+            m_up.flash_ops     = flash_ops();
+            break;
+
+        default:
+            TEST_ASSERT(false);
+            break;
+    }
+}
+
+
+static void peer_evt_handler(sim_peer_t * p_peer, sim_peer_evt_t const * p_evt)
+{
+    if (p_evt->type == SIM_PEER_EVT_RESPONSE)
+    {
+        on_response(p_evt->p_data, p_evt->len);
+    }
+    else if ((p_evt->type == SIM_PEER_EVT_HVX) && (p_evt->handle == m_up.ctrl_handle))
+    {
+        on_ctrl_notification(p_evt->p_data, p_evt->len);
+    }
+}
+
+
+static void reconnect(void * p_context)
+{
+    sim_peer_connect(m_up.p_peer);
+}
+
+
+/**@brief Function for dropping the link in the middle of the data, and coming back later. */
+static void link_drop(void)
+{
+    sim_ble_disconnect(&m_up.p_peer->central, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    (void)sim_at(sim_time() + RECONNECT_DELAY, SIM_OWNER_WORLD, reconnect, NULL);
+}
+
+
+/**@brief Function for queuing the chunks the credits allow, as the phone stack would. */
+static void pump(void * p_context)
+{
+    uint8_t  chunk[BLE_ASSET_MAX_DATA_LEN];
+    uint32_t position;
+    uint16_t length;
+
+    while ((m_up.step == STEP_DATA) && ((int16_t)(m_up.credit_limit - m_up.seq) > 0) &&
+           (sim_ble_central_queued(&m_up.p_peer->central) < QUEUE_MAX))
+    {
+        position = m_up.offset + m_up.seq * BLE_ASSET_CHUNK_LEN;
+        length   = MIN(ASSET_LEN - position, BLE_ASSET_CHUNK_LEN);
+
+        (void)uint16_encode(m_up.seq, chunk);
+        memcpy(&chunk[2], &m_asset[position], length);
+        if (!sim_peer_write(m_up.p_peer, m_up.data_handle, chunk, length + 2, false))
+        {
+            break;
+        }
+        m_up.seq++;
+        m_up.chunks_sent++;
+
+        if (m_up.chunks_sent == m_up.drop_after)
+        {
+            link_drop();
+            break;
+        }
+
+        if (position + length == ASSET_LEN)
+        {
+            m_up.step = STEP_DIGEST_0;
+            digest_send(0);
+        }
+    }
+
+    if (m_up.step != STEP_DONE)
+    {
+        (void)sim_at(sim_time() + PUMP_INTERVAL, SIM_OWNER_WORLD, pump, NULL);
+    }
+}
+
+
+static void upload_start(void * p_context)
+{
+    m_up.step = STEP_DISCOVER;
+    discover_next();
+    pump(NULL);
+}
+
+
+static void upload_setup(uint32_t loss_ppm)
+{
+    sim_ble_config_t config;
+
+    sim_ble_config_default(&config);
+    config.loss_ppm = loss_ppm;
+    sim_ble_config_set(&config);
+
+    asset_make();
+    memset(&m_up, 0, sizeof(m_up));
+    m_up.commit_status = -1;
+    m_up.discover_from = 1;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    m_up.p_peer              = sim_script_peer(0);
+    m_up.p_peer->evt_handler = peer_evt_handler;
+    (void)sim_at(UPLOAD_TIME, SIM_OWNER_WORLD, upload_start, NULL);
+}
+
+
+/**@brief Function for an upload, giving its throughput in bytes per second. */
+static uint32_t upload_run(uint32_t loss_ppm)
+{
+    upload_setup(loss_ppm);
+    sim_end_set(UPLOAD_TIME + SIM_S(120));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT_EQUAL(STEP_DONE, m_up.step);
+    TEST_ASSERT_EQUAL(ASSET_STATUS_SUCCESS, m_up.commit_status);
+
+    return (uint32_t)(((uint64_t)ASSET_LEN * SIM_S(1)) / (m_up.end - m_up.start));
+}
+
+
+TEST(clean_link)
+{
+    uint32_t        throughput = upload_run(0);
+    sim_ble_stats_t stats;
+
+    sim_ble_stats_get(&stats);
+    TEST_ASSERT_EQUAL(0, stats.packets_lost);
+    TEST_ASSERT_EQUAL(CHUNKS, m_up.chunks_sent);
+    TEST_ASSERT_EQUAL(0, m_up.resends);
+    test_report("%u bytes in %u chunks: %u bytes/s", ASSET_LEN, m_up.chunks_sent, throughput);
+}
+
+
+TEST(lossy_link)
+{
+    uint32_t        throughput = upload_run(100000);
+    sim_ble_stats_t stats;
+
+    // The link layer resends lost packets, so no chunk is sent twice.
+    sim_ble_stats_get(&stats);
+    TEST_ASSERT(stats.packets_lost > 0);
+    TEST_ASSERT_EQUAL(CHUNKS, m_up.chunks_sent);
+    TEST_ASSERT_EQUAL(0, m_up.resends);
+    test_report("10%% packet loss, %u packets resent: %u bytes/s", stats.packets_lost, throughput);
+}
+
+
+static void peer_resume_handler(sim_peer_t * p_peer, sim_peer_evt_t const * p_evt)
+{
+    if ((p_evt->type == SIM_PEER_EVT_ENCRYPTED) && (m_up.step == STEP_DATA))
+    {
+        // Handles are kept; notifications are off on a new link.
+        uint8_t cccd[2] = {BLE_GATT_HVX_NOTIFICATION, 0};
+
+        m_up.step = STEP_CCCD;
+        TEST_ASSERT(sim_peer_write(p_peer, m_up.ctrl_handle + 1, cccd, sizeof(cccd), true));
+        return;
+    }
+    peer_evt_handler(p_peer, p_evt);
+}
+
+
+TEST(resume)
+{
+    upload_setup(0);
+    m_up.p_peer->evt_handler = peer_resume_handler;
+    m_up.drop_after          = DROP_AFTER;
+    sim_end_set(UPLOAD_TIME + SIM_S(120));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    // The second BEGIN resumes from the data the watch kept in flash.
+    TEST_ASSERT_EQUAL(2, m_up.begins);
+    TEST_ASSERT(m_up.offset > 0);
+    TEST_ASSERT_EQUAL(ASSET_STATUS_SUCCESS, m_up.commit_status);
+    TEST_ASSERT(m_up.chunks_sent < 2 * CHUNKS);
+    test_report("resumed at %u of %u bytes, %u chunks sent", m_up.offset, ASSET_LEN, m_up.chunks_sent);
+}
+
+
+/**@brief Function for counting the flash operations of a clean upload up to its COMMIT_RSP. */
+static void upload_flash_ops(void * p_result)
+{
+    (void)upload_run(0);
+    *(uint32_t *)p_result = m_up.flash_ops;
+}
+
+
+TEST(trailer_error)
+{
+    uint32_t ops;
+    uint16_t asset_id;
+    uint32_t length;
+
+    // The trailer is the last flash operation before COMMIT_RSP.
+    sim_flash_stats_clear();
+    TEST_ASSERT(test_isolated(upload_flash_ops, &ops, sizeof(ops)));
+
+    upload_setup(0);
+    sim_flash_error_set(ops);
+    sim_end_set(UPLOAD_TIME + SIM_S(120));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT_EQUAL(STEP_DONE, m_up.step);
+    TEST_ASSERT_EQUAL(ASSET_STATUS_FLASH_ERROR, m_up.commit_status);
+    // pstorage retried the trailer before reporting the error.
+    TEST_ASSERT(m_up.flash_ops > ops);
+    TEST_ASSERT(asset_store_asset_get(&asset_id, &length) == NULL);
+    test_report("trailer write failed %u times, reported in COMMIT_RSP", m_up.flash_ops - ops + 1);
+}
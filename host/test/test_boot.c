@@ -0,0 +1,87 @@
+/* The boot with the display start-up run alongside the rest of the initialization: the stage times
+ * the boot log records against the first pixel the panel saw, the time the display waits save
+ * against running them after the set-up, and the boot clock stopped afterwards.
+ */
+
+#include "sim.h"
+#include "sim_display.h"
+#include "sim_script.h"
+#include "sim_uart.h"
+#include "nrf.h"
+#include "boot_log.h"
+#include "test.h"
+
+#define DISPLAY_WAIT    SIM_MS(70)     /**< Reset pulse and start-up time of the display, which the baseline waited out after the rest. */
+#define POLL_INTERVAL   SIM_MS(1)      /**< The crystal wait checks the display steps this often. */
+
+static uint32_t m_stages[BOOT_STAGE_COUNT];
+static uint64_t m_first_pixel;
+static uint32_t m_timer_counts[2];    /**< TIMER1 captured after the boot, and half a second later. */
+
+
+static void boot_read(void * p_context)
+{
+    uint32_t i;
+
+    for (i = 0; i < BOOT_STAGE_COUNT; i++)
+    {
+        m_stages[i] = boot_log_stage_get(i);
+    }
+    m_first_pixel = sim_display_first_pixel_time();
+}
+
+
+static void timer_capture(void * p_context)
+{
+    uint32_t index = (uint32_t)(uintptr_t)p_context;
+
+    NRF_TIMER1->TASKS_CAPTURE[3] = 1;
+    m_timer_counts[index]        = NRF_TIMER1->CC[3];
+}
+
+
+TEST(stages)
+{
+    uint32_t i;
+
+    TEST_ASSERT(sim_script_parse("2 type boot\n"));
+    (void)sim_at(SIM_S(1), SIM_OWNER_WORLD, boot_read, NULL);
+    (void)sim_at(SIM_S(1), SIM_OWNER_WORLD, timer_capture, (void *)0);
+    (void)sim_at(SIM_MS(1500), SIM_OWNER_WORLD, timer_capture, (void *)1);
+    sim_end_set(SIM_S(3));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    for (i = 0; i < BOOT_STAGE_COUNT; i++)
+    {
+        TEST_ASSERT(m_stages[i] != BOOT_LOG_NONE);
+    }
+
+    // The main path in order, the deferred work after the first frame.
+    TEST_ASSERT(m_stages[BOOT_STAGE_TIMERS] <= m_stages[BOOT_STAGE_BLE_STACK]);
+    TEST_ASSERT(m_stages[BOOT_STAGE_BLE_STACK] <= m_stages[BOOT_STAGE_STORAGE]);
+    TEST_ASSERT(m_stages[BOOT_STAGE_STORAGE] <= m_stages[BOOT_STAGE_SERVICES]);
+    TEST_ASSERT(m_stages[BOOT_STAGE_SERVICES] <= m_stages[BOOT_STAGE_ADVERTISING]);
+    TEST_ASSERT(m_stages[BOOT_STAGE_DISPLAY_READY] <= m_stages[BOOT_STAGE_FIRST_PIXEL]);
+    TEST_ASSERT(m_stages[BOOT_STAGE_FIRST_PIXEL] <= m_stages[BOOT_STAGE_DEFERRED]);
+
+    // The boot clock agrees with the panel on when the first frame went out.
+    TEST_ASSERT(m_first_pixel != SIM_TIME_NEVER);
+    TEST_ASSERT(m_first_pixel / SIM_US(1) >= m_stages[BOOT_STAGE_DISPLAY_READY]);
+    TEST_ASSERT(m_first_pixel / SIM_US(1) <= m_stages[BOOT_STAGE_FIRST_PIXEL] + 1000);
+
+    // The display waits ran while the crystal started: the display is ready the reset pulse and
+    // start-up time after the timers, and the first frame is out before the SoftDevice is up. One
+    // after the other, the display would only be ready the waits after advertising started.
+    TEST_ASSERT(m_stages[BOOT_STAGE_DISPLAY_READY] <= m_stages[BOOT_STAGE_TIMERS] + (DISPLAY_WAIT + POLL_INTERVAL) / SIM_US(1));
+    TEST_ASSERT(m_stages[BOOT_STAGE_FIRST_PIXEL] < m_stages[BOOT_STAGE_BLE_STACK]);
+    TEST_ASSERT(m_stages[BOOT_STAGE_FIRST_PIXEL] + DISPLAY_WAIT / SIM_US(1) < m_stages[BOOT_STAGE_ADVERTISING]);
+
+    // The boot clock is stopped once the boot is over, and its stages printed on request.
+    TEST_ASSERT_EQUAL(m_timer_counts[0], m_timer_counts[1]);
+    TEST_ASSERT(sim_uart_text_find("Boot first pixel:"));
+
+    test_report("BLE stack up at %u us, advertising at %u us, first pixel at %u us; one after the other: %u us",
+                m_stages[BOOT_STAGE_BLE_STACK], m_stages[BOOT_STAGE_ADVERTISING], m_stages[BOOT_STAGE_FIRST_PIXEL],
+                m_stages[BOOT_STAGE_ADVERTISING] + (uint32_t)(DISPLAY_WAIT / SIM_US(1)) +
+                m_stages[BOOT_STAGE_FIRST_PIXEL] - m_stages[BOOT_STAGE_DISPLAY_READY]);
+}
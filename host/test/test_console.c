@@ -0,0 +1,83 @@
+/* The UART console: lines split in words, and lines typed on the terminal at the baud rate, with
+ * line editing, line endings of either kind, several lines in one burst, unknown commands and
+ * lines too long for the buffer.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_script.h"
+#include "sim_uart.h"
+#include "console.h"
+#include "test.h"
+
+TEST(split)
+{
+    char    line[] = "  log\t1   3 extra words\t";
+    char *  argv[CONSOLE_ARGS_MAX];
+    char    empty[] = " \t ";
+
+    TEST_ASSERT_EQUAL(CONSOLE_ARGS_MAX, console_line_split(line, argv));
+    TEST_ASSERT(strcmp(argv[0], "log") == 0);
+    TEST_ASSERT(strcmp(argv[1], "1") == 0);
+    TEST_ASSERT(strcmp(argv[2], "3") == 0);
+    TEST_ASSERT(strcmp(argv[3], "extra") == 0);
+
+    TEST_ASSERT_EQUAL(0, console_line_split(empty, argv));
+}
+
+
+static void type(void * p_context)
+{
+    char const * p_text = p_context;
+
+    sim_uart_rx_push((uint8_t const *)p_text, strlen(p_text));
+}
+
+
+static char const m_long_line[] = "sched 0123456789012345678901234567890123456789012345\n";
+
+
+TEST(typed)
+{
+    sim_uart_stats_t stats;
+
+    TEST_ASSERT(sim_script_parse("0.5 time 0 1700000000\n"));
+    (void)sim_at(SIM_S(1), SIM_OWNER_WORLD, type, "help\r\n");
+    (void)sim_at(SIM_S(2), SIM_OWNER_WORLD, type, "spx\bi\n");
+    (void)sim_at(SIM_S(3), SIM_OWNER_WORLD, type, "\r\nnope\r\n");
+    (void)sim_at(SIM_S(4), SIM_OWNER_WORLD, type, (void *)m_long_line);
+    sim_end_set(SIM_S(5));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    // Every command of the table listed, by the built-in help.
+    TEST_ASSERT(sim_uart_text_find("help: list the commands."));
+    TEST_ASSERT(sim_uart_text_find("sched: scheduler queue state."));
+    TEST_ASSERT(sim_uart_text_find("boot: boot stage times of this run."));
+
+    // A backspace edits the line; blank lines do nothing.
+    TEST_ASSERT(sim_uart_text_find("SPI:"));
+    TEST_ASSERT(sim_uart_text_find("Unknown command, try help."));
+
+    // A line longer than the buffer is discarded whole, not run cut short.
+    TEST_ASSERT(sim_uart_text_find("Console line too long."));
+    TEST_ASSERT(!sim_uart_text_find("Scheduler queue:"));
+
+    sim_uart_stats_get(&stats);
+    TEST_ASSERT_EQUAL(strlen("help\r\n") + strlen("spx\bi\n") + strlen("\r\nnope\r\n") + strlen(m_long_line),
+                      stats.rx_bytes);
+}
+
+
+TEST(burst)
+{
+    // Lines typed back to back, faster than they are run: none is lost.
+    TEST_ASSERT(sim_script_parse("0.5 time 0 1700000000\n"));
+    (void)sim_at(SIM_S(1), SIM_OWNER_WORLD, type, "sched\nspi\nflash\nlog 9 9\n");
+    sim_end_set(SIM_S(2));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT(sim_uart_text_find("Scheduler queue:"));
+    TEST_ASSERT(sim_uart_text_find("SPI:"));
+    TEST_ASSERT(sim_uart_text_find("Asset store:"));
+    TEST_ASSERT(sim_uart_text_find("Usage: log"));
+}
@@ -0,0 +1,139 @@
+/* The crash log across resets: an application error while connected, reported after the soft
+ * reset it causes with its trace; a watchdog reset, reported with the trace and no fault; and a
+ * power-on, after which the undefined RAM gives no report.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_script.h"
+#include "sim_uart.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "app_error.h"
+#include "crash_log.h"
+#include "test.h"
+
+#define FAULT_TIME      SIM_S(20)
+#define FAULT_LINE      1234
+#define RESETREAS_DOG   (1UL << 1)
+#define RESETREAS_SREQ  (1UL << 2)
+
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n"
+    "30   reset dog\n"
+    "40   reset power\n";
+
+static uint8_t const m_file[] = "test_crash.c";
+
+/**@brief Reports read after the fault, after the watchdog reset and after the power-on. */
+static uint8_t  m_reports[3][CRASH_LOG_REPORT_MAX];
+static uint16_t m_report_lens[3];
+
+
+static void fault_inject(void * p_context)
+{
+    app_error_handler(NRF_ERROR_INTERNAL, FAULT_LINE, m_file);
+}
+
+
+static void report_read(void * p_context)
+{
+    uint32_t index = (uint32_t)(uintptr_t)p_context;
+
+    m_report_lens[index] = crash_log_report_encode(m_reports[index]);
+}
+
+
+static uint8_t event_id(uint8_t const * p_report, uint8_t index)
+{
+    return p_report[CRASH_LOG_HEADER_LEN + CRASH_LOG_EVENT_LEN * index + 3];
+}
+
+
+static uint32_t event_arg(uint8_t const * p_report, uint8_t index)
+{
+    return uint32_decode(&p_report[CRASH_LOG_HEADER_LEN + CRASH_LOG_EVENT_LEN * index + 4]);
+}
+
+
+TEST(resets)
+{
+    uint8_t const * p_report;
+    bool            ble_traced = false;
+    uint8_t         count;
+    uint8_t         i;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    (void)sim_at(FAULT_TIME, SIM_OWNER_WORLD, fault_inject, NULL);
+    (void)sim_at(SIM_S(25), SIM_OWNER_WORLD, report_read, (void *)0);
+    (void)sim_at(SIM_S(35), SIM_OWNER_WORLD, report_read, (void *)1);
+    (void)sim_at(SIM_S(45), SIM_OWNER_WORLD, report_read, (void *)2);
+    sim_end_set(SIM_S(46));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+    TEST_ASSERT_EQUAL(4, sim_boot_count());
+
+    // The error, where it was raised, and what the watch did before it.
+    p_report = m_reports[0];
+    count    = p_report[33];
+    TEST_ASSERT_EQUAL(CRASH_LOG_HEADER_LEN + count * CRASH_LOG_EVENT_LEN, m_report_lens[0]);
+    TEST_ASSERT_EQUAL(CRASH_LOG_VERSION, p_report[0]);
+    TEST_ASSERT_EQUAL(CRASH_LOG_FAULT_APP_ERROR, p_report[1]);
+    TEST_ASSERT_EQUAL(NRF_ERROR_INTERNAL, uint32_decode(&p_report[2]));
+    TEST_ASSERT_EQUAL(FAULT_LINE, uint32_decode(&p_report[6]));
+    TEST_ASSERT_EQUAL((uint32_t)(uintptr_t)m_file, uint32_decode(&p_report[10]));
+    TEST_ASSERT(uint32_decode(&p_report[14]) != 0);
+    TEST_ASSERT(uint32_decode(&p_report[22]) <= FAULT_TIME / SIM_S(1));
+    TEST_ASSERT(uint32_decode(&p_report[22]) + 2 >= FAULT_TIME / SIM_S(1));
+    TEST_ASSERT(count > 0);
+    TEST_ASSERT(count <= CRASH_LOG_EVENTS);
+    for (i = 0; i < count; i++)
+    {
+        ble_traced |= (event_id(p_report, i) == CRASH_LOG_EVT_BLE);
+    }
+    TEST_ASSERT(ble_traced);
+    TEST_ASSERT(sim_uart_text_find("Previous run: error 0x3 at test_crash.c:1234"));
+
+    // The watchdog left no fault, but the trace of the run after the soft reset, from its boot.
+    p_report = m_reports[1];
+    TEST_ASSERT(m_report_lens[1] > CRASH_LOG_HEADER_LEN);
+    TEST_ASSERT_EQUAL(CRASH_LOG_FAULT_NONE, p_report[1]);
+    TEST_ASSERT(p_report[33] < CRASH_LOG_EVENTS);
+    TEST_ASSERT_EQUAL(CRASH_LOG_EVT_BOOT, event_id(p_report, 0));
+    TEST_ASSERT(event_arg(p_report, 0) & RESETREAS_SREQ);
+    TEST_ASSERT(sim_uart_text_find("Previous run: no fault recorded."));
+
+    // Nothing survives a power-on.
+    TEST_ASSERT_EQUAL(0, m_report_lens[2]);
+
+    test_report("report of %u bytes with %u trace events", m_report_lens[0], count);
+}
+
+
+static void second_fault(void * p_context)
+{
+    app_error_handler(NRF_ERROR_NO_MEM, FAULT_LINE + 1, m_file);
+}
+
+
+static void first_fault(void * p_context)
+{
+    // Handled, as an error handler would: the first fault of the run is kept.
+    crash_log_app_error(NRF_ERROR_INTERNAL, FAULT_LINE, m_file, 0);
+    (void)sim_at(sim_time() + SIM_MS(100), SIM_OWNER_WORLD, second_fault, NULL);
+}
+
+
+TEST(first_fault_kept)
+{
+    TEST_ASSERT(sim_script_parse("0.5 time 0 1700000000\n"));
+    (void)sim_at(SIM_S(5), SIM_OWNER_WORLD, first_fault, NULL);
+    (void)sim_at(SIM_S(10), SIM_OWNER_WORLD, report_read, (void *)0);
+    sim_end_set(SIM_S(11));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT_EQUAL(2, sim_boot_count());
+    TEST_ASSERT_EQUAL(CRASH_LOG_FAULT_APP_ERROR, m_reports[0][1]);
+    TEST_ASSERT_EQUAL(NRF_ERROR_INTERNAL, uint32_decode(&m_reports[0][2]));
+    TEST_ASSERT_EQUAL(FAULT_LINE, uint32_decode(&m_reports[0][6]));
+}
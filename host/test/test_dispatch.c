@@ -0,0 +1,181 @@
+/* The BLE event dispatcher: a trace of events reaches only the modules subscribed to each, in table
+ * order, with the handler calls a broadcast to every module would take counted against it; and the
+ * counters of the firmware's own table over a connection, against the link layer.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_script.h"
+#include "nrf_error.h"
+#include "ble_gap.h"
+#include "ble_gatts.h"
+#include "ble_gattc.h"
+#include "ble_dispatch.h"
+#include "test.h"
+
+#define MODULES      4
+#define CALLS_MAX    64
+
+static uint8_t  m_calls[CALLS_MAX];         /**< Module of each handler call, in order. */
+static uint16_t m_call_evts[CALLS_MAX];     /**< Event of each handler call. */
+static uint32_t m_call_count;
+
+
+static void call_record(uint8_t module, ble_evt_t * p_ble_evt)
+{
+    TEST_ASSERT(m_call_count < CALLS_MAX);
+    m_calls[m_call_count]     = module;
+    m_call_evts[m_call_count] = p_ble_evt->header.evt_id;
+    m_call_count++;
+}
+
+
+static void module_0(ble_evt_t * p_ble_evt) { call_record(0, p_ble_evt); }
+static void module_1(ble_evt_t * p_ble_evt) { call_record(1, p_ble_evt); }
+static void module_2(ble_evt_t * p_ble_evt) { call_record(2, p_ble_evt); }
+static void module_3(ble_evt_t * p_ble_evt) { call_record(3, p_ble_evt); }
+
+/* The shape of the firmware table: a connection tracker, a GATT client, a GATT server and a module
+ * that only wants writes.
+ */
+static const ble_dispatch_module_t m_table[MODULES] =
+{
+    BLE_DISPATCH_MODULE(module_0, BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED),
+    BLE_DISPATCH_MODULE(module_1, BLE_GAP_EVT_DISCONNECTED, BLE_GATTC_EVT_READ_RSP, BLE_GATTC_EVT_HVX),
+    BLE_DISPATCH_MODULE(module_2, BLE_GAP_EVT_CONNECTED, BLE_GATTS_EVT_WRITE, BLE_EVT_TX_COMPLETE),
+    BLE_DISPATCH_MODULE(module_3, BLE_GATTS_EVT_WRITE),
+};
+
+/* A connection: the notifications of the phone and the writes of the watch dominate. */
+static const uint16_t m_trace[] =
+{
+    BLE_GAP_EVT_CONNECTED,
+    BLE_GAP_EVT_CONN_PARAM_UPDATE,
+    BLE_GATTC_EVT_READ_RSP,
+    BLE_GATTC_EVT_HVX,
+    BLE_GATTC_EVT_HVX,
+    BLE_GATTS_EVT_WRITE,
+    BLE_EVT_TX_COMPLETE,
+    BLE_GATTC_EVT_HVX,
+    BLE_GAP_EVT_DISCONNECTED,
+};
+
+#define TRACE_LEN  (sizeof(m_trace) / sizeof(m_trace[0]))
+
+
+static void trace_dispatch(void)
+{
+    ble_evt_t evt;
+    uint32_t  i;
+
+    for (i = 0; i < TRACE_LEN; i++)
+    {
+        memset(&evt, 0, sizeof(evt));
+        evt.header.evt_id = m_trace[i];
+        ble_dispatch_on_ble_evt(&evt);
+    }
+}
+
+
+TEST(routing)
+{
+    static const uint8_t  expected[]      = {0, 2, 1, 1, 1, 2, 3, 2, 1, 0, 1};
+    static const uint16_t expected_evts[] = {BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_CONNECTED,
+                                             BLE_GATTC_EVT_READ_RSP, BLE_GATTC_EVT_HVX,
+                                             BLE_GATTC_EVT_HVX, BLE_GATTS_EVT_WRITE,
+                                             BLE_GATTS_EVT_WRITE, BLE_EVT_TX_COMPLETE,
+                                             BLE_GATTC_EVT_HVX, BLE_GAP_EVT_DISCONNECTED,
+                                             BLE_GAP_EVT_DISCONNECTED};
+    ble_dispatch_stats_t stats;
+    ble_evt_t            evt;
+    uint32_t             i;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_dispatch_init(m_table, MODULES));
+    trace_dispatch();
+
+    // Subscribers of an event in table order; nobody for the parameter update.
+    TEST_ASSERT_EQUAL(sizeof(expected), m_call_count);
+    for (i = 0; i < m_call_count; i++)
+    {
+        TEST_ASSERT_EQUAL(expected[i], m_calls[i]);
+        TEST_ASSERT_EQUAL(expected_evts[i], m_call_evts[i]);
+    }
+
+    // Counted per event, also when no module takes it.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_dispatch_stats_get(BLE_GATTC_EVT_HVX, &stats));
+    TEST_ASSERT_EQUAL(3, stats.count);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_dispatch_stats_get(BLE_GAP_EVT_CONN_PARAM_UPDATE, &stats));
+    TEST_ASSERT_EQUAL(1, stats.count);
+
+    // Events outside the routed range go nowhere.
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id = BLE_DISPATCH_EVT_ID_MAX + 1;
+    ble_dispatch_on_ble_evt(&evt);
+    TEST_ASSERT_EQUAL(sizeof(expected), m_call_count);
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, ble_dispatch_stats_get(BLE_DISPATCH_EVT_ID_MAX + 1, &stats));
+
+    test_report("%u events: %u handler calls, %u with a broadcast to %u modules",
+                (uint32_t)TRACE_LEN, m_call_count, (uint32_t)(TRACE_LEN * MODULES), MODULES);
+}
+
+
+/* A module subscribed to an event the dispatcher does not route. */
+static const ble_dispatch_module_t m_out_of_range[] =
+{
+    BLE_DISPATCH_MODULE(module_0, BLE_GAP_EVT_CONNECTED),
+    BLE_DISPATCH_MODULE(module_1, BLE_DISPATCH_EVT_ID_MAX + 1),
+};
+
+
+TEST(bad_table)
+{
+    ble_dispatch_module_t too_many[BLE_DISPATCH_MAX_MODULES + 1];
+
+    memset(too_many, 0, sizeof(too_many));
+    TEST_ASSERT_EQUAL(NRF_ERROR_NULL, ble_dispatch_init(NULL, 1));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_LENGTH, ble_dispatch_init(too_many, BLE_DISPATCH_MAX_MODULES + 1));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, ble_dispatch_init(m_out_of_range, 2));
+}
+
+
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n"
+    "+20  disconnect 0\n"
+    "+2   connect 0\n"
+    "+20  disconnect 0\n";
+
+
+TEST(connection_trace)
+{
+    ble_dispatch_stats_t stats;
+    sim_ble_stats_t      link_layer;
+    uint32_t             events = 0;
+    uint32_t             cycles = 0;
+    uint16_t             evt_id;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    sim_end_set(SIM_S(46));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    sim_ble_stats_get(&link_layer);
+    TEST_ASSERT_EQUAL(2, link_layer.connections);
+
+    // The firmware table sees each link come and go once.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_dispatch_stats_get(BLE_GAP_EVT_CONNECTED, &stats));
+    TEST_ASSERT_EQUAL(link_layer.connections, stats.count);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_dispatch_stats_get(BLE_GAP_EVT_DISCONNECTED, &stats));
+    TEST_ASSERT_EQUAL(link_layer.disconnections, stats.count);
+
+    for (evt_id = BLE_DISPATCH_EVT_ID_MIN; evt_id <= BLE_DISPATCH_EVT_ID_MAX; evt_id++)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_dispatch_stats_get(evt_id, &stats));
+        events += stats.count;
+        cycles += stats.cycles;
+    }
+    TEST_ASSERT(events > 2 * link_layer.connections);
+
+    // Cycles are of the host clock scaled to 64 MHz: a relative figure only.
+    test_report("2 links: %u events dispatched, %u host cycles each on average", events, cycles / events);
+}
@@ -0,0 +1,101 @@
+/* The init sequence of the display, run from the step table, against the bytes the blocking
+ * initDisplay() sent one by one before the table: the same commands and data, in the same order,
+ * with the unknown 0x65 of the row window kept.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_display.h"
+#include "sim_script.h"
+#include "display.h"
+#include "test.h"
+
+#define C(byte)   (byte)                                /**< Command byte of the trace. */
+#define D(byte)   ((byte) | SIM_DISPLAY_TRACE_DC)       /**< Data byte of the trace. */
+
+#define RESET_PULSE     SIM_MS(20)     /**< Reset pulse of the baseline. */
+#define STARTUP_TIME    SIM_MS(50)     /**< Wait of the baseline from the reset to the first command. */
+
+/* displayConfigure() of the baseline, byte by byte. */
+static uint16_t const m_baseline[] =
+{
+    C(0xfd), D(0x12),                       // unlock
+    C(0xfd), D(0xb1),                       // unlock
+    C(0xae),                                // display off
+    C(0xb3), D(0xf1),                       // clock div
+    C(0xca), D(0x7f),                       // Multiplex Ratio
+    C(0xa0), D(0x74),                       // remap
+    C(0x15), D(0), D(0x7f),                 // col 0-127
+    C(0x65), D(0), D(0x7f),                 // row 0-127
+    C(0xa1), D(96),                         // startline
+    C(0xa2), D(0),                          // display offset
+    C(0xb5), D(0),                          // GPIO
+    C(0xab), D(1),                          // func select
+    C(0xB1), D(0x32),                       // precharge
+    C(0xBE), D(5),                          // vcomh
+    C(0xA6),                                // normal display
+    C(0xC1), D(0xC8), D(0x80), D(0xC8),     // contrast abc
+    C(0xC7), D(0x0F),                       // contrast master
+    C(0xB4), D(0xA0), D(0xB5), D(0x55),     // set vsl
+    C(0xB6), D(1),                          // precharge2
+    C(0xaf),                                // display on
+};
+
+#define BASELINE_LEN  (sizeof(m_baseline) / sizeof(m_baseline[0]))
+
+static uint64_t m_init_time;                /**< Time initDisplay() took. */
+
+
+static void init_stream_check(void)
+{
+    sim_display_stats_t stats;
+    uint16_t const    * p_trace;
+    uint32_t            count;
+
+    p_trace = sim_display_trace_get(&count);
+    TEST_ASSERT(count >= BASELINE_LEN);
+    TEST_ASSERT_EQUAL(0, memcmp(p_trace, m_baseline, sizeof(m_baseline)));
+
+    sim_display_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.resets);
+    TEST_ASSERT_EQUAL(0, stats.short_resets);
+    TEST_ASSERT_EQUAL(1, stats.unknown);              // 0x65, sent as before.
+    TEST_ASSERT(sim_display_on());
+}
+
+
+static void blocking_entry(void)
+{
+    uint64_t start;
+
+    spi_master_init();
+    start = sim_time();
+    initDisplay();
+    m_init_time = sim_time() - start;
+    sim_stop(0);
+}
+
+
+TEST(blocking_init)
+{
+    uint32_t count;
+
+    TEST_ASSERT_EQUAL(0, sim_run(blocking_entry));
+    init_stream_check();
+
+    // Nothing but the sequence, after the reset pulse and the start-up time.
+    (void)sim_display_trace_get(&count);
+    TEST_ASSERT_EQUAL(BASELINE_LEN, count);
+    TEST_ASSERT(m_init_time >= RESET_PULSE + STARTUP_TIME);
+    test_report("initDisplay(): %u bytes in %.1f ms", count, (double)m_init_time / SIM_MS(1));
+}
+
+
+TEST(boot_init)
+{
+    // The boot runs the sequence on the display timer, along with the rest of the init.
+    TEST_ASSERT(sim_script_parse(""));
+    sim_end_set(SIM_S(1));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+    init_stream_check();
+}
@@ -0,0 +1,243 @@
+/* The binary log: the cost of a call against formatting its text, the bytes it puts on the UART
+ * against those of the text, and the frames of the firmware decoded by the terminal as
+ * tools/dlog_decode.py does, none lost; and the filters: rate limited calls, calls removed at
+ * compile time with their arguments, and runtime levels set by call or from the console.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_periph.h"
+#include "sim_script.h"
+#include "sim_uart.h"
+#include "nrf.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "dlog.h"
+#include "test.h"
+
+#define CALLS        16
+#define FRAME_LEN    (10 + 4 * 3)      /**< Header and three arguments. */
+
+static dlog_stats_t m_stats;
+static uint32_t     m_format_cycles;
+static uint32_t     m_text_len;
+
+
+static void rtc_start(void)
+{
+    sim_lfclk_start();
+    NRF_RTC1->PRESCALER   = 0;
+    NRF_RTC1->TASKS_START = 1;
+}
+
+
+static void call_cost_entry(void)
+{
+    char     text[128];
+    uint32_t start;
+    uint32_t i;
+
+    rtc_start();
+    dlog_init();
+    sim_run_for(SIM_MS(10));
+
+    // The same call formatted, as the log did before frames.
+    for (i = 0; i < CALLS; i++)
+    {
+        DLOG_INFO("State received from link 0x%x in %d request(s), fields 0x%x.\n", i, 2, 0x1F);
+
+        start            = DWT->CYCCNT;
+        m_text_len       = snprintf(text, sizeof(text),
+                                    "State received from link 0x%x in %d request(s), fields 0x%x.\n", i, 2, 0x1F);
+        m_format_cycles += DWT->CYCCNT - start;
+    }
+    dlog_stats_get(&m_stats);
+    sim_stop(0);
+}
+
+
+TEST(call_cost)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(call_cost_entry));
+
+    TEST_ASSERT_EQUAL(CALLS, m_stats.frames);
+    TEST_ASSERT_EQUAL(0, m_stats.dropped);
+    TEST_ASSERT(FRAME_LEN < m_text_len);
+
+    // Cycles are of the host clock scaled to 64 MHz: relative figures only.
+    test_report("%u bytes per frame against %u of text; %u host cycles per call against %u to format",
+                FRAME_LEN, m_text_len, m_stats.write_cycles / CALLS, m_format_cycles / CALLS);
+}
+
+
+static void ring_full_entry(void)
+{
+    uint32_t i;
+
+    rtc_start();
+    dlog_init();
+
+    // Nothing drains the ring: the calls that do not fit are dropped whole.
+    for (i = 0; i < DLOG_BUFFER_SIZE / FRAME_LEN + 5; i++)
+    {
+        DLOG_INFO("Call %u of %u, 0x%x.\n", i, CALLS, 0);
+    }
+    dlog_stats_get(&m_stats);
+    sim_stop(0);
+}
+
+
+TEST(ring_full)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(ring_full_entry));
+    TEST_ASSERT_EQUAL(DLOG_BUFFER_SIZE / FRAME_LEN, m_stats.frames);
+    TEST_ASSERT_EQUAL(5, m_stats.dropped);
+}
+
+
+/* Console commands that log a burst of lines each. */
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    type sched\n"
+    "+0.5 type timers\n"
+    "+0.5 type spi\n"
+    "+0.5 type flash\n"
+    "+0.5 type stats\n";
+
+
+TEST(firmware_frames)
+{
+    sim_uart_stats_t uart;
+    dlog_stats_t     stats;
+    size_t           text_len;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    sim_end_set(SIM_S(5));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    dlog_stats_get(&stats);
+    sim_uart_stats_get(&uart);
+    text_len = strlen(sim_uart_text_get());
+
+    TEST_ASSERT(sim_uart_text_find("Scheduler queue:"));
+    TEST_ASSERT(sim_uart_text_find("pstorage:"));
+
+    // Every frame written reached the terminal whole and in sequence.
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(stats.frames, uart.frames);
+    TEST_ASSERT_EQUAL(0, uart.frames_lost);
+    TEST_ASSERT_EQUAL(0, uart.bad_bytes);
+    TEST_ASSERT(uart.tx_bytes < text_len);
+
+    test_report("%u frames, %u UART bytes for %u bytes of text (%u%%), %u host cycles per call",
+                stats.frames, uart.tx_bytes, (uint32_t)text_len, (uint32_t)(uart.tx_bytes * 100 / text_len),
+                stats.write_cycles / stats.frames);
+}
+
+
+static void limited_entry(void)
+{
+    uint32_t i;
+
+    rtc_start();
+    dlog_init();
+
+    // A hot path taken every 10 ms, logging at most every 100 ms.
+    for (i = 0; i < 100; i++)
+    {
+        DLOG_LIMITED(DLOG_LEVEL_WARNING, 100, "Hot path %u.\n", i);
+        sim_run_for(SIM_MS(10));
+    }
+    dlog_stats_get(&m_stats);
+    sim_stop(0);
+}
+
+
+TEST(limited)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(limited_entry));
+    TEST_ASSERT_EQUAL(100, m_stats.frames + m_stats.suppressed);
+    TEST_ASSERT(m_stats.frames >= 9);
+    TEST_ASSERT(m_stats.frames <= 11);
+    test_report("100 calls: %u logged, %u suppressed", m_stats.frames, m_stats.suppressed);
+}
+
+
+/* The rest of the file logs as a module built with warnings and errors only. */
+#undef  DLOG_MODULE
+#undef  DLOG_MODULE_LEVEL
+#define DLOG_MODULE       DLOG_MODULE_PIXWATCH_C
+#define DLOG_MODULE_LEVEL DLOG_LEVEL_WARNING
+
+STATIC_ASSERT(DLOG_COMPILED(DLOG_LEVEL_WARNING));
+STATIC_ASSERT(!DLOG_COMPILED(DLOG_LEVEL_INFO));
+STATIC_ASSERT(!DLOG_COMPILED(DLOG_LEVEL_DEBUG));
+
+static uint32_t m_evaluated;
+
+
+static uint32_t argument(void)
+{
+    return ++m_evaluated;
+}
+
+
+static void filter_entry(void)
+{
+    rtc_start();
+    dlog_init();
+
+    // Calls above the compile-time level are gone, arguments and all.
+    DLOG_INFO("Not built %u.\n", argument());
+    DLOG_DEBUG("Not built %u.\n", argument());
+    TEST_ASSERT_EQUAL(0, m_evaluated);
+
+    DLOG_WARNING("Built %u.\n", argument());
+    TEST_ASSERT_EQUAL(1, m_evaluated);
+
+    // Runtime levels filter per module, before the arguments are evaluated.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, dlog_level_set(DLOG_MODULE_PIXWATCH_C, DLOG_LEVEL_ERROR));
+    DLOG_WARNING("Filtered %u.\n", argument());
+    DLOG_ERROR("Logged %u.\n", argument());
+    TEST_ASSERT_EQUAL(2, m_evaluated);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, dlog_level_set(DLOG_MODULE_PIXWATCH_C, DLOG_LEVEL_NONE));
+    DLOG_ERROR("Filtered %u.\n", argument());
+    TEST_ASSERT_EQUAL(2, m_evaluated);
+
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, dlog_level_set(DLOG_MODULE_COUNT, DLOG_LEVEL_ERROR));
+    TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_PARAM, dlog_level_set(DLOG_MODULE_MAIN, DLOG_LEVEL_DEBUG + 1));
+
+    dlog_stats_get(&m_stats);
+    sim_stop(0);
+}
+
+
+TEST(filter)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(filter_entry));
+    TEST_ASSERT_EQUAL(2, m_stats.frames);
+}
+
+
+/* The log command sets the runtime level of the main module from the console. */
+static char const m_log_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    type log 0 1\n"
+    "+0.5 type sched\n"
+    "+0.5 type log 0 3\n"
+    "+0.5 type spi\n"
+    "+0.5 type log 7 1\n";
+
+
+TEST(log_command)
+{
+    TEST_ASSERT(sim_script_parse(m_log_script));
+    sim_end_set(SIM_S(4));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT(!sim_uart_text_find("Scheduler queue:"));
+    TEST_ASSERT(sim_uart_text_find("SPI:"));
+    TEST_ASSERT(sim_uart_text_find("Usage: log"));
+}
@@ -0,0 +1,213 @@
+/* The span functions of app_fifo against a reference queue, over random sequences of puts, gets,
+ * reads, writes, peeks and consumes; a span handed to the UART kept intact while the writer fills
+ * the FIFO behind it; and the cost of a bulk write against a put per byte.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nordic_common.h"
+#include "app_fifo.h"
+#include "test.h"
+
+#define FIFO_SIZE    64
+#define OPS          20000
+#define BENCH_SIZE   256
+
+static uint8_t    m_buf[FIFO_SIZE];
+static app_fifo_t m_fifo;
+
+/**@brief Reference queue: the bytes in the FIFO, oldest first. */
+static struct
+{
+    uint8_t  data[FIFO_SIZE];
+    uint32_t len;
+} m_model;
+
+static uint8_t m_next;                 /**< Next byte written: a running count. */
+
+
+static void model_push(uint8_t const * p_data, uint32_t len)
+{
+    memcpy(&m_model.data[m_model.len], p_data, len);
+    m_model.len += len;
+}
+
+
+static void model_pop(uint8_t const * p_data, uint32_t len)
+{
+    TEST_ASSERT(len <= m_model.len);
+    TEST_ASSERT(memcmp(m_model.data, p_data, len) == 0);
+    memmove(m_model.data, &m_model.data[len], m_model.len - len);
+    m_model.len -= len;
+}
+
+
+static void op_random(void)
+{
+    uint8_t   data[FIFO_SIZE + 8];
+    uint8_t   byte;
+    uint8_t * p_span;
+    uint32_t  size = sim_rand() % (FIFO_SIZE + 8);
+    uint32_t  err_code;
+    uint32_t  i;
+
+    switch (sim_rand() % 6)
+    {
+        case 0:
+            byte     = m_next;
+            err_code = app_fifo_put(&m_fifo, byte);
+            TEST_ASSERT_EQUAL((m_model.len < FIFO_SIZE) ? NRF_SUCCESS : NRF_ERROR_NO_MEM, err_code);
+            if (err_code == NRF_SUCCESS)
+            {
+                m_next++;
+                model_push(&byte, 1);
+            }
+            break;
+
+        case 1:
+            err_code = app_fifo_get(&m_fifo, &byte);
+            TEST_ASSERT_EQUAL((m_model.len > 0) ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND, err_code);
+            if (err_code == NRF_SUCCESS)
+            {
+                model_pop(&byte, 1);
+            }
+            break;
+
+        case 2:
+            for (i = 0; i < size; i++)
+            {
+                data[i] = (uint8_t)(m_next + i);
+            }
+            err_code = app_fifo_write(&m_fifo, data, &size);
+            TEST_ASSERT_EQUAL((m_model.len < FIFO_SIZE) ? NRF_SUCCESS : NRF_ERROR_NO_MEM, err_code);
+            TEST_ASSERT(size <= FIFO_SIZE - m_model.len);
+            m_next += size;
+            model_push(data, size);
+            break;
+
+        case 3:
+            err_code = app_fifo_read(&m_fifo, data, &size);
+            TEST_ASSERT_EQUAL((m_model.len > 0) ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND, err_code);
+            model_pop(data, size);
+            break;
+
+        case 4:
+            // As the UART driver does: peek a span, send part or all of it, consume that.
+            err_code = app_fifo_peek_span(&m_fifo, &p_span, &size);
+            TEST_ASSERT_EQUAL((m_model.len > 0) ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND, err_code);
+            TEST_ASSERT(size <= m_model.len);
+            TEST_ASSERT((m_model.len == 0) || (size > 0));
+            TEST_ASSERT(p_span + size <= &m_buf[FIFO_SIZE]);
+            size = (size > 0) ? 1 + sim_rand() % size : 0;
+            memcpy(data, p_span, size);
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_consume(&m_fifo, size));
+            model_pop(data, size);
+            break;
+
+        default:
+            // The fill level and the free space, without copying.
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_read(&m_fifo, NULL, &size));
+            TEST_ASSERT_EQUAL(m_model.len, size);
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_write(&m_fifo, NULL, &size));
+            TEST_ASSERT_EQUAL(FIFO_SIZE - m_model.len, size);
+            TEST_ASSERT_EQUAL(NRF_ERROR_INVALID_LENGTH, app_fifo_consume(&m_fifo, m_model.len + 1));
+            break;
+    }
+}
+
+
+TEST(reference_model)
+{
+    uint32_t i;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_init(&m_fifo, m_buf, FIFO_SIZE));
+    for (i = 0; i < OPS; i++)
+    {
+        op_random();
+    }
+
+    // The positions wrapped the buffer many times over.
+    TEST_ASSERT(m_fifo.write_pos > 100 * FIFO_SIZE);
+    test_report("%u operations, %u bytes through a %u byte FIFO", OPS, m_fifo.write_pos, FIFO_SIZE);
+}
+
+
+TEST(span_in_flight)
+{
+    uint8_t   data[FIFO_SIZE];
+    uint8_t   sent[FIFO_SIZE];
+    uint8_t * p_span;
+    uint32_t  span_size;
+    uint32_t  size;
+    uint32_t  i;
+
+    // Start the writes part way into the buffer, so the span ends at the wrap.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_init(&m_fifo, m_buf, FIFO_SIZE));
+    m_fifo.read_pos  = FIFO_SIZE - 10;
+    m_fifo.write_pos = FIFO_SIZE - 10;
+    for (i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t)i;
+    }
+    size = 40;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_write(&m_fifo, data, &size));
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_peek_span(&m_fifo, &p_span, &span_size));
+    TEST_ASSERT_EQUAL(10, span_size);
+    memcpy(sent, p_span, span_size);
+
+    // The writer fills the rest while the span is on the line: the span is not overwritten.
+    size = sizeof(data);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_write(&m_fifo, data, &size));
+    TEST_ASSERT_EQUAL(FIFO_SIZE - 40, size);
+    size = 1;
+    TEST_ASSERT_EQUAL(NRF_ERROR_NO_MEM, app_fifo_write(&m_fifo, data, &size));
+    TEST_ASSERT(memcmp(sent, p_span, span_size) == 0);
+
+    // Once consumed, the next span starts at the wrap.
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_consume(&m_fifo, span_size));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_peek_span(&m_fifo, &p_span, &span_size));
+    TEST_ASSERT(p_span == m_buf);
+    TEST_ASSERT_EQUAL(FIFO_SIZE - 10, span_size);
+    TEST_ASSERT(memcmp(p_span, &data[10], 30) == 0);
+}
+
+
+TEST(bulk_cost)
+{
+    static uint8_t buf[BENCH_SIZE];
+    uint8_t        data[BENCH_SIZE - 1];
+    uint32_t       put_cycles;
+    uint32_t       write_cycles;
+    uint32_t       start;
+    uint32_t       size;
+    uint32_t       i;
+
+    memset(data, 0x55, sizeof(data));
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_init(&m_fifo, buf, sizeof(buf)));
+    m_fifo.read_pos  = 100;
+    m_fifo.write_pos = 100;
+    start = DWT->CYCCNT;
+    for (i = 0; i < sizeof(data); i++)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_put(&m_fifo, data[i]));
+    }
+    put_cycles = DWT->CYCCNT - start;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_init(&m_fifo, buf, sizeof(buf)));
+    m_fifo.read_pos  = 100;
+    m_fifo.write_pos = 100;
+    size  = sizeof(data);
+    start = DWT->CYCCNT;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, app_fifo_write(&m_fifo, data, &size));
+    write_cycles = DWT->CYCCNT - start;
+    TEST_ASSERT_EQUAL(sizeof(data), size);
+
+    // Cycles are of the host clock scaled to 64 MHz: relative figures only.
+    test_report("%u bytes across the wrap: %u host cycles put by byte, %u in one write",
+                (uint32_t)sizeof(data), put_cycles, write_cycles);
+}
@@ -0,0 +1,525 @@
+/* pstorage.c on the flash model: the time a store takes, the retries of busy calls and failed
+ * operations, what a power loss during an update through the swap page leaves in flash, the flash
+ * operations merged stores and superseded updates save, and flash after random commands against
+ * a model of the commands done one by one.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_flash.h"
+#include "nrf_soc.h"
+#include "nrf_error.h"
+#include "pstorage.h"
+#include "softdevice_handler.h"
+#include "test.h"
+
+#define BLOCK_SIZE    16
+#define BLOCK_COUNT   8
+#define BLOCK_WORDS   (BLOCK_SIZE / 4)
+
+static pstorage_handle_t m_base;
+static uint32_t          m_results;        /**< Completed commands. */
+static uint32_t          m_errors;         /**< Completed commands with an error. */
+static uint64_t          m_last_done;      /**< Time of the last completion. */
+static uint32_t          m_data[BLOCK_COUNT][BLOCK_WORDS];
+static uint64_t          m_latency;        /**< Time from a store call to its completion. */
+static void           (* mp_scenario)(void);
+
+
+static void flash_cb(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result,
+                     uint8_t * p_data, uint32_t data_len)
+{
+    m_results++;
+    if (result != NRF_SUCCESS)
+    {
+        m_errors++;
+    }
+    m_last_done = sim_time();
+}
+
+
+static bool flash_idle(void)
+{
+    uint32_t count;
+
+    return (pstorage_access_status_get(&count) == NRF_SUCCESS) && (count == 0);
+}
+
+
+/**@brief Function for starting the SoftDevice and pstorage with one module, as main.c does. */
+static void flash_start(void)
+{
+    pstorage_module_param_t param;
+    uint32_t                err_code;
+
+    SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_XTAL_20_PPM, NULL);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, softdevice_sys_evt_handler_set(pstorage_sys_event_handler));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_init());
+
+    param.block_size  = BLOCK_SIZE;
+    param.block_count = BLOCK_COUNT;
+    param.cb          = flash_cb;
+    err_code          = pstorage_register(&param, &m_base);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, err_code);
+}
+
+
+static uint32_t const * block_addr(uint32_t block)
+{
+    return (uint32_t const *)(uintptr_t)(m_base.block_id + block * BLOCK_SIZE);
+}
+
+
+static void block_fill(uint32_t block, uint32_t pattern)
+{
+    uint32_t i;
+
+    for (i = 0; i < BLOCK_WORDS; i++)
+    {
+        m_data[block][i] = pattern + i;
+    }
+}
+
+
+static void block_store(uint32_t block, bool update)
+{
+    pstorage_handle_t handle;
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_block_identifier_get(&m_base, block, &handle));
+    if (update)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_update(&handle, (uint8_t *)m_data[block], BLOCK_SIZE, 0));
+    }
+    else
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_store(&handle, (uint8_t *)m_data[block], BLOCK_SIZE, 0));
+    }
+}
+
+
+static void flash_wait(void)
+{
+    TEST_ASSERT(sim_run_until(flash_idle, SIM_S(5)));
+}
+
+
+static void firmware_entry(void)
+{
+    mp_scenario();
+    sim_stop(0);
+}
+
+
+static void scenario_run(void (*scenario)(void))
+{
+    mp_scenario = scenario;
+    TEST_ASSERT_EQUAL(0, sim_run(firmware_entry));
+}
+
+
+static void scenario_latency(void)
+{
+    uint64_t start;
+
+    flash_start();
+    block_fill(0, 0x1000);
+    start = sim_time();
+    block_store(0, false);
+    flash_wait();
+
+    m_latency = m_last_done - start;
+    TEST_ASSERT_EQUAL(0, memcmp(block_addr(0), m_data[0], BLOCK_SIZE));
+}
+
+
+TEST(store_latency)
+{
+    sim_flash_stats_t stats;
+
+    scenario_run(scenario_latency);
+    sim_flash_stats_get(&stats);
+
+    TEST_ASSERT_EQUAL(1, m_results);
+    TEST_ASSERT_EQUAL(1, stats.writes);
+    TEST_ASSERT_EQUAL(BLOCK_WORDS, stats.words);
+    TEST_ASSERT_EQUAL(SIM_US(100) + BLOCK_WORDS * SIM_US(41), m_latency);
+    test_report("store of %u bytes: %.0f us", BLOCK_SIZE, (double)m_latency / SIM_US(1));
+}
+
+
+static void scenario_stores(void)
+{
+    uint32_t block;
+
+    flash_start();
+    for (block = 0; block < BLOCK_COUNT; block++)
+    {
+        block_fill(block, block << 16);
+        block_store(block, false);
+        // Apart, so that each store is a flash operation of its own.
+        sim_run_for(SIM_MS(2));
+    }
+    flash_wait();
+
+    for (block = 0; block < BLOCK_COUNT; block++)
+    {
+        TEST_ASSERT_EQUAL(0, memcmp(block_addr(block), m_data[block], BLOCK_SIZE));
+    }
+}
+
+
+TEST(busy_retry)
+{
+    sim_flash_config_t config;
+    sim_flash_stats_t  stats;
+    pstorage_stats_t   pstorage_stats;
+
+    sim_flash_config_default(&config);
+    config.busy_ppm = 500000;
+    sim_flash_config_set(&config);
+
+    scenario_run(scenario_stores);
+    sim_flash_stats_get(&stats);
+    pstorage_stats_get(&pstorage_stats);
+
+    TEST_ASSERT_EQUAL(BLOCK_COUNT, m_results);
+    TEST_ASSERT_EQUAL(0, m_errors);
+    TEST_ASSERT(stats.busy > 0);
+    TEST_ASSERT_EQUAL(stats.busy, pstorage_stats.busy_retries);
+    TEST_ASSERT_EQUAL(BLOCK_COUNT, stats.writes);
+    test_report("%u stores, %u busy calls reissued", BLOCK_COUNT, stats.busy);
+}
+
+
+TEST(error_retry)
+{
+    sim_flash_config_t config;
+    sim_flash_stats_t  stats;
+    pstorage_stats_t   pstorage_stats;
+
+    sim_flash_config_default(&config);
+    config.error_ppm = 300000;
+    sim_flash_config_set(&config);
+
+    scenario_run(scenario_stores);
+    sim_flash_stats_get(&stats);
+    pstorage_stats_get(&pstorage_stats);
+
+    TEST_ASSERT_EQUAL(BLOCK_COUNT, m_results);
+    TEST_ASSERT_EQUAL(0, m_errors);
+    TEST_ASSERT(stats.errors > 0);
+    TEST_ASSERT_EQUAL(stats.errors, pstorage_stats.flash_errors);
+    test_report("%u stores, %u failed operations retried", BLOCK_COUNT, stats.errors);
+}
+
+
+/**@brief What a power loss during an update of block 0 left, block 1 being its neighbour in the
+ *        page, which the update moves through the swap page.
+ */
+typedef struct
+{
+    bool old_kept;        /**< Block 0 still has its old content. */
+    bool new_written;     /**< Block 0 has its new content. */
+    bool neighbour_kept;  /**< Block 1 is intact in its page. */
+    bool neighbour_swap;  /**< Block 1 is intact in the swap page. */
+} loss_result_t;
+
+static uint32_t      m_loss_op;
+static loss_result_t m_loss;
+
+
+static void scenario_power_loss(void)
+{
+    uint32_t const * p_swap = (uint32_t const *)(uintptr_t)PSTORAGE_SWAP_ADDR;
+    uint32_t         offset;
+
+    block_fill(0, 0x0A000000);
+    block_fill(1, 0x0B000000);
+
+    if (sim_boot_count() == 1)
+    {
+        flash_start();
+        block_store(0, false);
+        block_store(1, false);
+        flash_wait();
+
+        sim_flash_power_loss_set(m_loss_op, 128);
+        block_fill(0, 0x0C000000);
+        block_store(0, true);
+        flash_wait();
+        return;
+    }
+
+    // After the power-on reset.
+    flash_start();
+    offset = (m_base.block_id + BLOCK_SIZE) % SIM_FLASH_PAGE_SIZE;
+    m_loss.neighbour_kept = (memcmp(block_addr(1), m_data[1], BLOCK_SIZE) == 0);
+    m_loss.neighbour_swap = (memcmp(p_swap + offset / 4, m_data[1], BLOCK_SIZE) == 0);
+    m_loss.old_kept       = (memcmp(block_addr(0), m_data[0], BLOCK_SIZE) == 0);
+    block_fill(0, 0x0C000000);
+    m_loss.new_written    = (memcmp(block_addr(0), m_data[0], BLOCK_SIZE) == 0);
+}
+
+
+static void power_loss_run(void * p_result)
+{
+    scenario_run(scenario_power_loss);
+    TEST_ASSERT_EQUAL(2, sim_boot_count());
+    *(loss_result_t *)p_result = m_loss;
+}
+
+
+TEST(power_loss_update)
+{
+    loss_result_t result;
+    uint32_t      torn = 0;
+
+    // The update is 5 flash operations: erase the swap page, copy the data page to it, erase the
+    // data page, restore the rest of the page from the swap page and write the block.
+    for (m_loss_op = 1; m_loss_op <= 5; m_loss_op++)
+    {
+        TEST_ASSERT(test_isolated(power_loss_run, &result, sizeof(result)));
+
+        // The neighbour is always somewhere: in its page until it is erased, then in the swap page.
+        TEST_ASSERT(result.neighbour_kept || result.neighbour_swap);
+        if (!result.old_kept && !result.new_written)
+        {
+            torn++;
+        }
+        test_report("power loss in operation %u: block %s, neighbour %s", m_loss_op,
+                    result.old_kept ? "old" : (result.new_written ? "new" : "torn"),
+                    result.neighbour_kept ? "in place" : "in swap page only");
+    }
+    TEST_ASSERT(torn > 0);
+}
+
+
+static bool stores_done(void)
+{
+    return m_results == 4;
+}
+
+
+static void scenario_merged_failure(void)
+{
+    sim_flash_config_t config;
+    uint32_t           block;
+
+    flash_start();
+    // Adjoining stores queued behind another one are merged into one flash write, which fails.
+    block_fill(7, 0x70000);
+    block_store(7, false);
+    for (block = 0; block < 3; block++)
+    {
+        block_fill(block, block << 16);
+        block_store(block, false);
+    }
+    sim_flash_config_default(&config);
+    config.error_ppm = 1000000;
+    sim_flash_config_set(&config);
+
+    TEST_ASSERT(sim_run_until(stores_done, SIM_S(5)));
+}
+
+
+TEST(merged_write_failure)
+{
+    pstorage_stats_t pstorage_stats;
+
+    scenario_run(scenario_merged_failure);
+    pstorage_stats_get(&pstorage_stats);
+
+    // Each of the merged stores gets the error, not only the first.
+    TEST_ASSERT_EQUAL(4, m_results);
+    TEST_ASSERT_EQUAL(3, m_errors);
+    TEST_ASSERT_EQUAL(1000, pstorage_stats.flash_errors);
+    test_report("3 merged stores failed after %u flash errors", pstorage_stats.flash_errors);
+}
+
+
+static uint32_t flash_ops(pstorage_stats_t const * p_stats)
+{
+    return p_stats->flash_writes + p_stats->flash_erases;
+}
+
+
+static void scenario_appends(void)
+{
+    uint32_t block;
+
+    flash_start();
+    // Log records appended back to back: all queued while the first is written.
+    for (block = 0; block < BLOCK_COUNT; block++)
+    {
+        block_fill(block, block << 16);
+        block_store(block, false);
+    }
+    flash_wait();
+
+    for (block = 0; block < BLOCK_COUNT; block++)
+    {
+        TEST_ASSERT_EQUAL(0, memcmp(block_addr(block), m_data[block], BLOCK_SIZE));
+    }
+}
+
+
+TEST(merged_appends)
+{
+    sim_flash_stats_t stats;
+    pstorage_stats_t  pstorage_stats;
+
+    scenario_run(scenario_appends);
+    sim_flash_stats_get(&stats);
+    pstorage_stats_get(&pstorage_stats);
+
+    // The first store is written alone, the ones queued behind it by one more write.
+    TEST_ASSERT_EQUAL(BLOCK_COUNT, m_results);
+    TEST_ASSERT_EQUAL(0, m_errors);
+    TEST_ASSERT_EQUAL(BLOCK_COUNT, pstorage_stats.commands);
+    TEST_ASSERT_EQUAL(2, stats.writes);
+    TEST_ASSERT_EQUAL(BLOCK_COUNT * BLOCK_WORDS, stats.words);
+    TEST_ASSERT_EQUAL(BLOCK_COUNT - 2, pstorage_stats.merged);
+    TEST_ASSERT_EQUAL(stats.writes + stats.erases, flash_ops(&pstorage_stats));
+    test_report("%u appends of %u bytes: %u flash operations, %u.%02u a command against 1 unmerged",
+                BLOCK_COUNT, BLOCK_SIZE, flash_ops(&pstorage_stats),
+                flash_ops(&pstorage_stats) / BLOCK_COUNT, flash_ops(&pstorage_stats) % BLOCK_COUNT * 100 / BLOCK_COUNT);
+}
+
+
+#define UPDATES  6
+
+static uint32_t m_updates[UPDATES][BLOCK_WORDS];
+
+
+static void scenario_updates(void)
+{
+    pstorage_handle_t handle;
+    uint32_t          i;
+    uint32_t          j;
+
+    flash_start();
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_block_identifier_get(&m_base, 2, &handle));
+
+    // The same block updated again and again, as the device manager does with bond data.
+    for (i = 0; i < UPDATES; i++)
+    {
+        for (j = 0; j < BLOCK_WORDS; j++)
+        {
+            m_updates[i][j] = (i << 16) + j;
+        }
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_update(&handle, (uint8_t *)m_updates[i], BLOCK_SIZE, 0));
+    }
+    flash_wait();
+
+    TEST_ASSERT_EQUAL(0, memcmp(block_addr(2), m_updates[UPDATES - 1], BLOCK_SIZE));
+}
+
+
+TEST(superseded_updates)
+{
+    sim_flash_stats_t stats;
+    pstorage_stats_t  pstorage_stats;
+    uint32_t          ops;
+
+    scenario_run(scenario_updates);
+    sim_flash_stats_get(&stats);
+    pstorage_stats_get(&pstorage_stats);
+
+    // The first update is under way; each later one supersedes those queued before it, so only
+    // the last is written too.
+    TEST_ASSERT_EQUAL(UPDATES, m_results);
+    TEST_ASSERT_EQUAL(0, m_errors);
+    TEST_ASSERT_EQUAL(UPDATES - 2, pstorage_stats.superseded);
+    TEST_ASSERT_EQUAL(stats.writes + stats.erases, flash_ops(&pstorage_stats));
+    ops = flash_ops(&pstorage_stats);
+    test_report("%u updates of a block: %u flash operations, %u.%02u an update against %u with each written",
+                UPDATES, ops, ops / UPDATES, ops % UPDATES * 100 / UPDATES, ops / 2 * UPDATES);
+}
+
+
+#define ROUNDS      200
+#define BATCH_MAX   8     /**< Commands queued at once, within PSTORAGE_CMD_QUEUE_SIZE. */
+
+static uint32_t m_model[BLOCK_COUNT][BLOCK_WORDS];
+static uint32_t m_batch[BATCH_MAX][BLOCK_WORDS];
+static uint32_t m_commands;
+
+
+static void scenario_random(void)
+{
+    pstorage_handle_t handle;
+    uint32_t          round;
+    uint32_t          n;
+    uint32_t          i;
+
+    flash_start();
+    memset(m_model, 0xFF, sizeof(m_model));
+
+    for (round = 0; round < ROUNDS; round++)
+    {
+        uint32_t batch = 1 + sim_rand() % BATCH_MAX;
+
+        // A batch of stores and updates of random parts of the blocks, queued at once.
+        for (n = 0; n < batch; n++)
+        {
+            uint32_t block  = sim_rand() % BLOCK_COUNT;
+            uint32_t offset = sim_rand() % BLOCK_WORDS;
+            uint32_t words  = 1 + sim_rand() % (BLOCK_WORDS - offset);
+            bool     update = (sim_rand() % 4) == 0;
+
+            for (i = 0; i < words; i++)
+            {
+                m_batch[n][i] = sim_rand();
+                // Stores only clear bits, an update sets the area anew.
+                m_model[block][offset + i] = update ? m_batch[n][i] : (m_model[block][offset + i] & m_batch[n][i]);
+            }
+
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_block_identifier_get(&m_base, block, &handle));
+            if (update)
+            {
+                TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_update(&handle, (uint8_t *)m_batch[n], words * 4, offset * 4));
+            }
+            else
+            {
+                TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_store(&handle, (uint8_t *)m_batch[n], words * 4, offset * 4));
+            }
+            m_commands++;
+        }
+        flash_wait();
+
+        for (i = 0; i < BLOCK_COUNT; i++)
+        {
+            TEST_ASSERT_EQUAL(0, memcmp(block_addr(i), m_model[i], BLOCK_SIZE));
+        }
+    }
+}
+
+
+TEST(reference_model)
+{
+    sim_flash_config_t config;
+    sim_flash_stats_t  stats;
+    pstorage_stats_t   pstorage_stats;
+
+    sim_flash_config_default(&config);
+    config.busy_ppm  = 200000;
+    config.error_ppm = 100000;
+    sim_flash_config_set(&config);
+
+    scenario_run(scenario_random);
+    sim_flash_stats_get(&stats);
+    pstorage_stats_get(&pstorage_stats);
+
+    // Flash as the commands one by one would leave it, after every batch, with busy calls and
+    // failed operations on the way.
+    TEST_ASSERT_EQUAL(m_commands, m_results);
+    TEST_ASSERT_EQUAL(0, m_errors);
+    TEST_ASSERT_EQUAL(m_commands, pstorage_stats.commands);
+    TEST_ASSERT(pstorage_stats.merged > 0);
+    TEST_ASSERT(pstorage_stats.superseded > 0);
+    TEST_ASSERT(stats.busy > 0);
+    TEST_ASSERT(stats.errors > 0);
+    test_report("%u commands: %u flash operations, %u merged, %u superseded, %u busy and %u failed operations",
+                m_commands, flash_ops(&pstorage_stats), pstorage_stats.merged, pstorage_stats.superseded,
+                stats.busy, stats.errors);
+}
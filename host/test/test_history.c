@@ -0,0 +1,216 @@
+/* The history store with a month of one-minute samples: the flash bytes a sample takes for a
+ * steady and a noisy series, the samples read back against those appended after the ring wrapped,
+ * and summaries of ranges against a count over the samples, with what a summary costs against
+ * decoding its range.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nordic_common.h"
+#include "pstorage.h"
+#include "softdevice_handler.h"
+#include "history.h"
+#include "test.h"
+
+#define SAMPLES     (30 * 24 * 60)
+#define START_TIME  1700000000
+#define QUERIES     50
+
+static uint32_t        m_times[SAMPLES];
+static int32_t         m_values[SAMPLES];
+static history_stats_t m_stats;
+static uint32_t        m_retained;          /**< Index of the oldest sample still in the store. */
+static uint32_t        m_summary_cycles;
+static uint32_t        m_decode_cycles;
+
+
+static bool flash_idle(void)
+{
+    uint32_t count;
+
+    return (pstorage_access_status_get(&count) == NRF_SUCCESS) && (count == 0);
+}
+
+
+/**@brief Function for starting pstorage and the history store alone, as main.c does. */
+static void history_start(void)
+{
+    SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_XTAL_20_PPM, NULL);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, softdevice_sys_evt_handler_set(pstorage_sys_event_handler));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_init());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, history_init());
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+/**@brief Die temperature in 0.25 degree steps: a daily swing, and noise if asked for. A minute is
+ *        skipped now and then, as when the sample timer was late.
+ */
+static void series_make(bool noisy)
+{
+    uint32_t time = START_TIME;
+    uint32_t i;
+
+    for (i = 0; i < SAMPLES; i++)
+    {
+        int32_t minute = (time - START_TIME) / 60 % (24 * 60);
+        int32_t swing  = (minute < 12 * 60) ? minute : 24 * 60 - minute;
+
+        m_times[i]  = time;
+        m_values[i] = 80 + swing / 60 + (noisy ? (int32_t)(sim_rand() % 5) - 2 : 0);
+        time       += ((sim_rand() % 100) == 0) ? 120 : 60;
+    }
+}
+
+
+static void series_append(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, history_append(HISTORY_SERIES_TEMPERATURE, m_times[i], m_values[i]));
+        TEST_ASSERT(sim_run_until(flash_idle, SIM_S(1)));
+    }
+    history_stats_get(&m_stats);
+    TEST_ASSERT_EQUAL(SAMPLES, m_stats.samples);
+    TEST_ASSERT_EQUAL(0, m_stats.dropped);
+    TEST_ASSERT_EQUAL(0, m_stats.failed);
+}
+
+
+/**@brief Function for reading the whole store back: the newest samples appended, in order, up to
+ *        the last one.
+ */
+static void read_back_check(void)
+{
+    history_reader_t reader;
+    uint32_t         time;
+    int32_t          value;
+    uint32_t         i = 0;
+    bool             found = false;
+
+    history_reader_init(&reader, HISTORY_SERIES_TEMPERATURE, 0, UINT32_MAX);
+    while (history_reader_next(&reader, &time, &value))
+    {
+        if (!found)
+        {
+            // The oldest sample kept: past the start if the ring wrapped.
+            while ((i < SAMPLES) && (m_times[i] != time))
+            {
+                i++;
+            }
+            TEST_ASSERT(i < SAMPLES);
+            m_retained = i;
+            found      = true;
+        }
+        TEST_ASSERT(i < SAMPLES);
+        TEST_ASSERT_EQUAL(m_times[i], time);
+        TEST_ASSERT_EQUAL(m_values[i], value);
+        i++;
+    }
+    TEST_ASSERT_EQUAL(SAMPLES, i);
+}
+
+
+/**@brief Function for checking summaries of random ranges against a count over the samples kept. */
+static void summaries_check(void)
+{
+    history_summary_t summary;
+    history_reader_t  reader;
+    uint32_t          time;
+    int32_t           value;
+    uint32_t          start;
+    uint32_t          q;
+    uint32_t          i;
+
+    for (q = 0; q < QUERIES; q++)
+    {
+        uint32_t a    = m_retained + sim_rand() % (SAMPLES - m_retained);
+        uint32_t b    = m_retained + sim_rand() % (SAMPLES - m_retained);
+        uint32_t from = m_times[MIN(a, b)] - (sim_rand() % 2) * 30;
+        uint32_t to   = m_times[MAX(a, b)] + (sim_rand() % 2) * 30;
+        uint32_t count = 0;
+        int32_t  min   = INT32_MAX;
+        int32_t  max   = INT32_MIN;
+
+        for (i = m_retained; i < SAMPLES; i++)
+        {
+            if ((m_times[i] >= from) && (m_times[i] <= to))
+            {
+                count++;
+                min = MIN(min, m_values[i]);
+                max = MAX(max, m_values[i]);
+            }
+        }
+
+        start = DWT->CYCCNT;
+        history_summary_get(HISTORY_SERIES_TEMPERATURE, from, to, &summary);
+        m_summary_cycles += DWT->CYCCNT - start;
+
+        TEST_ASSERT_EQUAL(count, summary.count);
+        TEST_ASSERT_EQUAL(min, summary.min);
+        TEST_ASSERT_EQUAL(max, summary.max);
+        TEST_ASSERT_EQUAL(m_times[MIN(a, b)], summary.first_time);
+        TEST_ASSERT_EQUAL(m_times[MAX(a, b)], summary.last_time);
+
+        // The same range decoded sample by sample.
+        start = DWT->CYCCNT;
+        history_reader_init(&reader, HISTORY_SERIES_TEMPERATURE, from, to);
+        while (history_reader_next(&reader, &time, &value))
+        {
+        }
+        m_decode_cycles += DWT->CYCCNT - start;
+    }
+}
+
+
+static void month_entry(void)
+{
+    history_start();
+    series_append();
+    read_back_check();
+    summaries_check();
+    sim_stop(0);
+}
+
+
+static void month_report(char const * p_name)
+{
+    uint32_t flash_bytes = m_stats.blocks * HISTORY_BLOCK_SIZE;
+
+    // Cycles are of the host clock scaled to 64 MHz: relative figures only.
+    test_report("%s: %u.%02u flash bytes per sample, %u.%02u encoded; %u of %u samples kept (%u days); "
+                "summary %u host cycles against %u to decode", p_name,
+                flash_bytes / SAMPLES, flash_bytes % SAMPLES * 100 / SAMPLES,
+                m_stats.encoded / SAMPLES, m_stats.encoded % SAMPLES * 100 / SAMPLES,
+                SAMPLES - m_retained, SAMPLES, (SAMPLES - m_retained) / (24 * 60),
+                m_summary_cycles / QUERIES, m_decode_cycles / QUERIES);
+}
+
+
+TEST(steady_month)
+{
+    series_make(false);
+    TEST_ASSERT_EQUAL(0, sim_run(month_entry));
+
+    // Runs of unchanged samples: a fraction of a byte each, the whole month kept.
+    TEST_ASSERT(m_stats.blocks * HISTORY_BLOCK_SIZE * 2 < SAMPLES);
+    TEST_ASSERT_EQUAL(0, m_retained);
+    month_report("steady");
+}
+
+
+TEST(noisy_month)
+{
+    series_make(true);
+    TEST_ASSERT_EQUAL(0, sim_run(month_entry));
+
+    // About a byte a sample; the ring wrapped, and holds more than a week.
+    TEST_ASSERT(m_stats.page_erases > 0);
+    TEST_ASSERT(m_stats.blocks * HISTORY_BLOCK_SIZE < SAMPLES * 3 / 2);
+    TEST_ASSERT(SAMPLES - m_retained > 7 * 24 * 60);
+    month_report("noisy");
+}
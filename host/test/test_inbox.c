@@ -0,0 +1,346 @@
+/* Flash of the notification inbox and its neighbours in the pstorage area: where the bonds stay,
+ * failed and cut flash operations, and the bytes written for the bytes kept.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_flash.h"
+#include "sim_script.h"
+#include "nrf_error.h"
+#include "pstorage.h"
+#include "softdevice_handler.h"
+#include "inbox.h"
+#include "test.h"
+
+#define DM_PAGE_ADDR  0x7D000      /**< Bonds of firmware with only the Device Manager in pstorage. */
+
+static uint8_t const m_message[] = "Lunch at noon";
+static inbox_stats_t m_stats;
+
+
+static bool page_erased(uint32_t addr)
+{
+    uint32_t const * p_word = (uint32_t const *)(uintptr_t)addr;
+    uint32_t         i;
+
+    for (i = 0; i < SIM_FLASH_PAGE_SIZE / 4; i++)
+    {
+        if (p_word[i] != 0xFFFFFFFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+TEST(bond_page_fixed)
+{
+    // The phone bonds when the watch asks for security, 4 s after the connection.
+    TEST_ASSERT(sim_script_parse("1 connect 0\n"));
+    sim_end_set(SIM_S(10));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    // The bond is where it was before the inbox and the other areas took pages of the pstorage
+    // area, so an update of the firmware keeps it.
+    TEST_ASSERT(!page_erased(DM_PAGE_ADDR));
+    TEST_ASSERT(page_erased(DM_PAGE_ADDR - SIM_FLASH_PAGE_SIZE));
+}
+
+
+/**@brief Function for starting pstorage and the inbox alone, as main.c does. */
+static void inbox_start(void)
+{
+    SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_XTAL_20_PPM, NULL);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, softdevice_sys_evt_handler_set(pstorage_sys_event_handler));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_init());
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_init(NULL));
+}
+
+
+static bool append_ended(void)
+{
+    inbox_stats_t stats;
+
+    inbox_stats_get(&stats);
+    return (stats.appended + stats.dropped) > (m_stats.appended + m_stats.dropped);
+}
+
+
+static void append_wait(void)
+{
+    TEST_ASSERT(sim_run_until(append_ended, SIM_S(200)));
+    inbox_stats_get(&m_stats);
+}
+
+
+static void header_failure_entry(void)
+{
+    sim_flash_config_t config;
+
+    inbox_start();
+    if (sim_boot_count() == 1)
+    {
+        // The flash fails from the erase of the first page on: pstorage gives up on it.
+        sim_flash_config_default(&config);
+        config.error_ppm = 1000000;
+        sim_flash_config_set(&config);
+
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_append(1, 0, 0, m_message, sizeof(m_message)));
+        append_wait();
+        TEST_ASSERT_EQUAL(1, m_stats.dropped);
+        TEST_ASSERT_EQUAL(0, m_stats.appended);
+
+        // The failed append does not hold the inbox busy.
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_append(2, 0, 0, m_message, sizeof(m_message)));
+
+        // pstorage recovers with a reset, with the flash healthy again.
+        sim_flash_config_default(&config);
+        sim_flash_config_set(&config);
+        sim_reset(SIM_RESET_POWER_ON);
+    }
+    if (sim_boot_count() == 2)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+        TEST_ASSERT_EQUAL(0, inbox_count());
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_append(3, 0, 0, m_message, sizeof(m_message)));
+        append_wait();
+        TEST_ASSERT_EQUAL(1, m_stats.appended);
+        sim_reset(SIM_RESET_POWER_ON);
+    }
+
+    // The message appended after the failure is found at boot.
+    TEST_ASSERT_EQUAL(1, inbox_count());
+    TEST_ASSERT_EQUAL(3, inbox_latest(0)->id);
+    sim_stop(0);
+}
+
+
+TEST(header_failure)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(header_failure_entry));
+    TEST_ASSERT_EQUAL(3, sim_boot_count());
+}
+
+
+static bool flash_idle(void)
+{
+    uint32_t count;
+
+    return (pstorage_access_status_get(&count) == NRF_SUCCESS) && (count == 0);
+}
+
+
+static void mark_read_entry(void)
+{
+    inbox_start();
+    if (sim_boot_count() == 1)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_append(1, 0, INBOX_FLAG_UNREAD, m_message, sizeof(m_message)));
+        append_wait();
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_append(2, 0, INBOX_FLAG_UNREAD, m_message, sizeof(m_message)));
+        append_wait();
+
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_mark_read(0));
+        TEST_ASSERT_EQUAL(0, inbox_latest(0)->flags & INBOX_FLAG_UNREAD);
+        TEST_ASSERT_EQUAL(NRF_ERROR_NOT_FOUND, inbox_mark_read(2));
+        TEST_ASSERT(sim_run_until(flash_idle, SIM_S(1)));
+        sim_reset(SIM_RESET_POWER_ON);
+    }
+
+    // The mark is in flash, written over the record without an erase.
+    TEST_ASSERT_EQUAL(2, inbox_count());
+    TEST_ASSERT_EQUAL(2, inbox_latest(0)->id);
+    TEST_ASSERT_EQUAL(0, inbox_latest(0)->flags & INBOX_FLAG_UNREAD);
+    TEST_ASSERT_EQUAL(INBOX_FLAG_UNREAD, inbox_latest(1)->flags & INBOX_FLAG_UNREAD);
+    inbox_stats_get(&m_stats);
+    TEST_ASSERT_EQUAL(0, m_stats.page_erases);
+    TEST_ASSERT_EQUAL(0, m_stats.torn);
+    sim_stop(0);
+}
+
+
+TEST(mark_read)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(mark_read_entry));
+    TEST_ASSERT_EQUAL(2, sim_boot_count());
+}
+
+
+/**@brief Function for making the body of a message from its id, so that any body found in flash can
+ *        be checked against its record.
+ */
+static uint16_t body_make(uint32_t id, uint8_t * p_body)
+{
+    uint16_t length = 20 + (id * 37) % (INBOX_MSG_MAX_LEN - 20);
+    uint16_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        p_body[i] = (uint8_t)(id + i * 3);
+    }
+    return length;
+}
+
+
+static bool body_check(inbox_entry_t const * p_entry)
+{
+    uint8_t body[INBOX_MSG_MAX_LEN];
+
+    return (body_make(p_entry->id, body) == p_entry->length) &&
+           (memcmp(inbox_data_get(p_entry), body, p_entry->length) == 0);
+}
+
+
+static void append_id(uint32_t id)
+{
+    uint8_t  body[INBOX_MSG_MAX_LEN];
+    uint16_t length = body_make(id, body);
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, inbox_append(id, id, 0, body, length));
+    append_wait();
+}
+
+
+#define AMPLIFICATION_APPENDS  100    /**< More than the ring holds. */
+
+static void write_amplification_entry(void)
+{
+    sim_flash_stats_t flash;
+    uint32_t          id;
+
+    inbox_start();
+    sim_flash_stats_clear();
+    for (id = 1; id <= AMPLIFICATION_APPENDS; id++)
+    {
+        append_id(id);
+    }
+    TEST_ASSERT(sim_run_until(flash_idle, SIM_S(1)));
+
+    // What the inbox counts is what went to flash.
+    sim_flash_stats_get(&flash);
+    TEST_ASSERT_EQUAL(AMPLIFICATION_APPENDS, m_stats.appended);
+    TEST_ASSERT_EQUAL(flash.words * 4, m_stats.flash_bytes);
+    TEST_ASSERT_EQUAL(flash.erases, m_stats.page_erases);
+    TEST_ASSERT_EQUAL(0, flash.overwrites);
+    TEST_ASSERT(m_stats.page_erases > INBOX_PAGE_COUNT);
+
+    // Record headers, padding and commit marks: well under twice the payload.
+    TEST_ASSERT(m_stats.flash_bytes * 10 < m_stats.payload_bytes * 13);
+
+    // The newest messages are indexed, oldest page dropped.
+    TEST_ASSERT(inbox_count() > 0);
+    TEST_ASSERT_EQUAL(AMPLIFICATION_APPENDS, inbox_latest(0)->id);
+    for (id = 0; id < inbox_count(); id++)
+    {
+        TEST_ASSERT(body_check(inbox_latest(id)));
+    }
+
+    test_report("%u messages, %u payload bytes: %u bytes written (x%u.%02u), %u erases, "
+                "%u flash writes", m_stats.appended, m_stats.payload_bytes, m_stats.flash_bytes,
+                m_stats.flash_bytes / m_stats.payload_bytes,
+                (m_stats.flash_bytes % m_stats.payload_bytes) * 100 / m_stats.payload_bytes,
+                m_stats.page_erases, flash.writes);
+    sim_stop(0);
+}
+
+
+TEST(write_amplification)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(write_amplification_entry));
+}
+
+
+/**@brief Power cuts, each as the flash operation to cut, counted from the last append before it,
+ *        and the part of it done, in 1/256: 256 cuts the power once the operation is done, before
+ *        the firmware hears of it. The appends cross pages, so cuts also land on erases.
+ */
+static const struct
+{
+    uint8_t  op;
+    uint16_t fraction;
+} m_cuts[] =
+{
+    {1, 0}, {1, 64}, {1, 200}, {2, 0}, {2, 128}, {2, 255}, {1, 128}, {2, 64},
+    {1, 16}, {2, 200}, {1, 240}, {2, 16}, {1, 100}, {2, 100}, {1, 32}, {2, 32},
+    {2, 256}, {1, 256}, {2, 256}, {2, 256},
+};
+
+#define CUTS             (sizeof(m_cuts) / sizeof(m_cuts[0]))
+#define APPENDS_PER_CUT  3
+
+/* Kept by the test across the resets of the chip. */
+static uint32_t m_cut;               /**< Power cuts done. */
+static uint32_t m_next_id;           /**< Message the last cut hit. */
+static uint32_t m_lost;              /**< Cuts that lost their message. */
+
+
+static void power_loss_entry(void)
+{
+    uint32_t k;
+
+    inbox_start();
+    inbox_stats_get(&m_stats);
+
+    // No partial message is ever indexed: each body matches its record, oldest first, and the
+    // message being appended at the cut is there in full or not at all.
+    for (k = 0; k < inbox_count(); k++)
+    {
+        TEST_ASSERT(body_check(inbox_latest(k)));
+        if (k > 0)
+        {
+            TEST_ASSERT(inbox_latest(k)->id < inbox_latest(k - 1)->id);
+        }
+    }
+    if (m_next_id != 0)
+    {
+        TEST_ASSERT(inbox_count() > 0);
+        TEST_ASSERT((inbox_latest(0)->id == m_next_id) || (inbox_latest(0)->id == m_next_id - 1));
+        if (inbox_latest(0)->id == m_next_id)
+        {
+            m_next_id++;
+        }
+        else
+        {
+            m_lost++;
+        }
+    }
+    else
+    {
+        m_next_id = 1;
+    }
+
+    if (m_cut == CUTS)
+    {
+        sim_stop(0);
+    }
+
+    // A phone sends again the message that was not acknowledged.
+    for (k = 0; k < APPENDS_PER_CUT; k++)
+    {
+        append_id(m_next_id++);
+    }
+    sim_flash_power_loss_set(m_cuts[m_cut].op, m_cuts[m_cut].fraction);
+    m_cut++;
+    append_id(m_next_id);
+    TEST_ASSERT(sim_run_until(flash_idle, SIM_S(1)));
+
+    // Not reached: the cut resets the chip.
+    TEST_ASSERT(false);
+}
+
+
+TEST(power_loss)
+{
+    sim_flash_stats_t flash;
+
+    TEST_ASSERT_EQUAL(0, sim_run(power_loss_entry));
+    sim_flash_stats_get(&flash);
+    TEST_ASSERT_EQUAL(CUTS, flash.power_losses);
+    TEST_ASSERT_EQUAL(CUTS + 1, sim_boot_count());
+    // Cuts before and after the commit mark.
+    TEST_ASSERT((m_lost > 0) && (m_lost < CUTS));
+    TEST_ASSERT(m_stats.torn > 0);
+    test_report("%u power cuts in appends: %u messages lost, %u torn records skipped at the last boot",
+                (uint32_t)CUTS, m_lost, m_stats.torn);
+}
@@ -0,0 +1,255 @@
+/* Two phones connected at once, on a SoftDevice with two links: discovery, state syncs and ANCS
+ * notifications of both interleave, and each link keeps its own client state. Both phones post a
+ * notification of the same UID, which the fetcher must not mix up.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_peer.h"
+#include "sim_script.h"
+#include "ble_ancs_c.h"
+#include "ble_hci.h"
+#include "ble_pixwatch_c.h"
+#include "ancs_notif.h"
+#include "inbox.h"
+#include "test.h"
+
+#define PHONES        2
+#define SYNC_TIME     SIM_S(12)      /**< Both phones bonded and discovered. */
+#define NOTIFY_TIME   SIM_S(15)
+#define NOTIF_UID     7              /**< UID of the notification on each phone. */
+
+/* The second phone connects while the first one is being discovered. */
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "0.5  time 1 1800000000\n"
+    "1    connect 0\n"
+    "1.5  connect 1\n";
+
+static uint32_t const m_times[PHONES] = {1700000000, 1800000000};
+
+/**@brief Notification Provider of a phone, answering for one notification of a short app. */
+typedef struct
+{
+    sim_peer_t * p_peer;
+    uint16_t     cp_handle;
+    uint16_t     ns_handle;
+    uint16_t     ds_handle;
+    bool         silent;            /**< Does not answer. */
+    uint32_t     requests;          /**< Control point writes answered. */
+    uint8_t      rsp[64];
+    uint16_t     rsp_len;
+} np_t;
+
+static np_t               m_np[PHONES];
+static ble_pixwatch_c_t * mp_pixwatch[PHONES];
+static uint32_t           m_sync_result[PHONES];
+
+
+static uint16_t attr_put(uint8_t * p_dst, uint8_t id, char const * p_value)
+{
+    uint16_t len = strlen(p_value);
+
+    p_dst[0] = id;
+    p_dst[1] = (uint8_t)len;
+    p_dst[2] = 0;
+    memcpy(&p_dst[3], p_value, len);
+    return 3 + len;
+}
+
+
+static void np_respond_send(void * p_context)
+{
+    np_t   * p_np = p_context;
+    uint16_t offset;
+
+    for (offset = 0; offset < p_np->rsp_len; offset += GATT_MTU_SIZE_DEFAULT - 3)
+    {
+        uint16_t chunk = p_np->rsp_len - offset;
+
+        if (chunk > GATT_MTU_SIZE_DEFAULT - 3)
+        {
+            chunk = GATT_MTU_SIZE_DEFAULT - 3;
+        }
+        TEST_ASSERT(sim_peer_hvx(p_np->p_peer, p_np->ds_handle, &p_np->rsp[offset], chunk));
+    }
+}
+
+
+/**@brief Function for answering a control point command, after its write response. The title
+ *        tells the phones apart.
+ */
+static void np_evt_handler(sim_peer_t * p_peer, sim_peer_evt_t const * p_evt)
+{
+    np_t * p_np = p_peer->p_context;
+    char   title[16];
+
+    if ((p_evt->type != SIM_PEER_EVT_WRITE) || (p_evt->handle != p_np->cp_handle) || (p_evt->len == 0) ||
+        p_np->silent)
+    {
+        return;
+    }
+
+    if (p_evt->p_data[0] == BLE_ANCS_COMMAND_ID_GET_NOTIF_ATTRIBUTES)
+    {
+        TEST_ASSERT(p_evt->len >= 5);
+        TEST_ASSERT_EQUAL(NOTIF_UID, p_evt->p_data[1]);
+        (void)snprintf(title, sizeof(title), "Phone %u", (unsigned)(p_np - m_np));
+
+        memcpy(p_np->rsp, p_evt->p_data, 5);
+        p_np->rsp_len  = 5;
+        p_np->rsp_len += attr_put(&p_np->rsp[p_np->rsp_len], BLE_ANCS_NOTIF_ATTR_ID_APP_IDENTIFIER, "com.skype.skype");
+        p_np->rsp_len += attr_put(&p_np->rsp[p_np->rsp_len], BLE_ANCS_NOTIF_ATTR_ID_TITLE, title);
+        p_np->rsp_len += attr_put(&p_np->rsp[p_np->rsp_len], BLE_ANCS_NOTIF_ATTR_ID_MESSAGE, "Hello");
+    }
+    else
+    {
+        // Get App Attributes: the command less its attribute ID, then the display name.
+        TEST_ASSERT_EQUAL(BLE_ANCS_COMMAND_ID_GET_APP_ATTRIBUTES, p_evt->p_data[0]);
+        memcpy(p_np->rsp, p_evt->p_data, p_evt->len - 1);
+        p_np->rsp_len = p_evt->len - 1 + attr_put(&p_np->rsp[p_evt->len - 1],
+                                                  BLE_ANCS_APP_ATTR_ID_DISPLAY_NAME, "Skype");
+    }
+    p_np->requests++;
+    (void)sim_at(sim_time() + SIM_US(1), SIM_OWNER_WORLD, np_respond_send, p_np);
+}
+
+
+static void np_add(uint8_t phone)
+{
+    np_t  * p_np  = &m_np[phone];
+    uint8_t empty = 0;
+
+    p_np->p_peer    = sim_script_peer(phone);
+    (void)sim_peer_service_add(p_np->p_peer, ble_ancs_base_uuid128.uuid128, 16);
+    p_np->ns_handle = sim_peer_char_add(p_np->p_peer, ble_ancs_ns_base_uuid128.uuid128, 16, 0x10, &empty, 1);
+    p_np->cp_handle = sim_peer_char_add(p_np->p_peer, ble_ancs_cp_base_uuid128.uuid128, 16, 0x08, &empty, 1);
+    p_np->ds_handle = sim_peer_char_add(p_np->p_peer, ble_ancs_ds_base_uuid128.uuid128, 16, 0x10, &empty, 1);
+    p_np->p_peer->evt_handler = np_evt_handler;
+    p_np->p_peer->p_context   = p_np;
+}
+
+
+static void np_notify(void * p_context)
+{
+    np_t  * p_np    = p_context;
+    uint8_t data[8] = {BLE_ANCS_EVENT_ID_NOTIFICATION_ADDED, 0, BLE_ANCS_CATEGORY_ID_SOCIAL, 1, NOTIF_UID};
+
+    TEST_ASSERT(sim_peer_hvx(p_np->p_peer, p_np->ns_handle, data, sizeof(data)));
+}
+
+
+/**@brief Function for syncing the state of both phones at once. */
+static void syncs_start(void * p_context)
+{
+    uint32_t i;
+
+    for (i = 0; i < PHONES; i++)
+    {
+        mp_pixwatch[i] = ble_pixwatch_c_find(sim_script_peer(i)->central.conn_handle);
+        TEST_ASSERT(mp_pixwatch[i] != NULL);
+        m_sync_result[i] = ble_pixwatch_c_sync(mp_pixwatch[i]);
+    }
+    TEST_ASSERT(mp_pixwatch[0] != mp_pixwatch[1]);
+}
+
+
+static void disconnect(void * p_context)
+{
+    sim_ble_disconnect(&((np_t *)p_context)->p_peer->central, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+}
+
+
+static void links_setup(void)
+{
+    sim_ble_config_t config;
+
+    sim_ble_config_default(&config);
+    config.links_max = PHONES;
+    sim_ble_config_set(&config);
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    np_add(0);
+    np_add(1);
+}
+
+
+/**@brief Function for checking that the inbox holds the notification of a phone. */
+static bool record_find(uint8_t phone)
+{
+    char     expected[32];
+    uint16_t len;
+    uint32_t i;
+
+    len = snprintf(expected, sizeof(expected), "Skype\nPhone %u\nHello", phone);
+    for (i = 0; i < inbox_count(); i++)
+    {
+        inbox_entry_t const * p_entry = inbox_latest(i);
+
+        if ((p_entry->id == NOTIF_UID) && (p_entry->length == len) &&
+            (memcmp(inbox_data_get(p_entry), expected, len) == 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+TEST(interleaved)
+{
+    ancs_notif_stats_t stats;
+    uint32_t           i;
+
+    links_setup();
+    (void)sim_at(SYNC_TIME, SIM_OWNER_WORLD, syncs_start, NULL);
+    (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, &m_np[0]);
+    (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, &m_np[1]);
+    sim_end_set(NOTIFY_TIME + SIM_S(30));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    for (i = 0; i < PHONES; i++)
+    {
+        // Each link found its own services and read its own phone.
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, m_sync_result[i]);
+        TEST_ASSERT_EQUAL((1 << BLE_PIXWATCH_C_FIELD_COUNT) - 1, mp_pixwatch[i]->state.valid);
+        TEST_ASSERT_EQUAL(m_times[i], mp_pixwatch[i]->state.local_time);
+        TEST_ASSERT_EQUAL(1, sim_peer_cccd_get(m_np[i].p_peer, m_np[i].ns_handle));
+        TEST_ASSERT_EQUAL(1, sim_peer_cccd_get(m_np[i].p_peer, m_np[i].ds_handle));
+        TEST_ASSERT(record_find(i));
+    }
+
+    // The display name fetched from the first phone serves the second.
+    ancs_notif_stats_get(&stats);
+    TEST_ASSERT_EQUAL(2, stats.notifications);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(1, stats.cache_hits);
+    TEST_ASSERT_EQUAL(3, m_np[0].requests + m_np[1].requests);
+    test_report("2 links: %u notifications in %u control point writes", stats.notifications, stats.gatt_ops);
+}
+
+
+TEST(one_link_lost)
+{
+    ancs_notif_stats_t stats;
+
+    // The first phone goes away while its notification is fetched, before the fetch times out;
+    // the second one's waits in the queue and is fetched on its link.
+    links_setup();
+    m_np[0].silent = true;
+    (void)sim_at(NOTIFY_TIME, SIM_OWNER_WORLD, np_notify, &m_np[0]);
+    (void)sim_at(NOTIFY_TIME + SIM_MS(100), SIM_OWNER_WORLD, np_notify, &m_np[1]);
+    (void)sim_at(NOTIFY_TIME + SIM_S(5), SIM_OWNER_WORLD, disconnect, &m_np[0]);
+    sim_end_set(NOTIFY_TIME + SIM_S(30));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    ancs_notif_stats_get(&stats);
+    TEST_ASSERT_EQUAL(1, stats.notifications);
+    TEST_ASSERT_EQUAL(1, stats.dropped);
+    TEST_ASSERT_EQUAL(0, stats.timeouts);
+    TEST_ASSERT(!record_find(0));
+    TEST_ASSERT(record_find(1));
+    TEST_ASSERT(ble_ancs_c_find(sim_script_peer(1)->central.conn_handle) != NULL);
+}
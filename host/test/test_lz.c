@@ -0,0 +1,270 @@
+/* The streaming LZ decoder against the compressor of tools/lz_compress.py, ported here: assets of
+ * the kinds the watch receives round trip through the decoder fed and drained in pieces of any
+ * size, with the compression ratio of each and the cost of decoding it.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nordic_common.h"
+#include "lz_decoder.h"
+#include "test.h"
+
+#define MIN_MATCH       2              /**< As tools/lz_compress.py: a back-reference takes 13 bits, two literals 18. */
+#define MAX_MATCH       (1 << LZ_LOOKAHEAD_BITS)
+#define DATA_MAX        4096
+#define ICON_SIDE       32
+
+static uint8_t      m_data[DATA_MAX];
+static uint8_t      m_packed[DATA_MAX * 9 / 8 + 1];
+static uint8_t      m_out[DATA_MAX];
+static lz_decoder_t m_decoder;
+
+/**@brief Bit writer of the compressor, most significant bit first. */
+static struct
+{
+    uint32_t len;
+    uint8_t  acc;
+    uint8_t  bits;
+} m_writer;
+
+
+static void bits_put(uint32_t value, uint8_t count)
+{
+    while (count-- > 0)
+    {
+        m_writer.acc = (uint8_t)((m_writer.acc << 1) | ((value >> count) & 1));
+        if (++m_writer.bits == 8)
+        {
+            m_packed[m_writer.len++] = m_writer.acc;
+            m_writer.acc  = 0;
+            m_writer.bits = 0;
+        }
+    }
+}
+
+
+/**@brief Function for compressing m_data as tools/lz_compress.py does: greedy, the nearest of the
+ *        longest matches.
+ *
+ * @return Length of the stream in m_packed.
+ */
+static uint32_t compress(uint32_t len)
+{
+    uint32_t pos = 0;
+
+    memset(&m_writer, 0, sizeof(m_writer));
+    while (pos < len)
+    {
+        uint32_t best_len = 0;
+        uint32_t best_off = 0;
+        uint32_t limit    = MIN(MAX_MATCH, len - pos);
+        uint32_t start;
+
+        for (start = (pos > LZ_WINDOW_SIZE) ? pos - LZ_WINDOW_SIZE : 0; start < pos; start++)
+        {
+            uint32_t length = 0;
+
+            while ((length < limit) && (m_data[start + length] == m_data[pos + length]))
+            {
+                length++;
+            }
+            if (length >= best_len)
+            {
+                best_len = length;
+                best_off = pos - start;
+                if (length == limit)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (best_len >= MIN_MATCH)
+        {
+            bits_put(0, 1);
+            bits_put(best_off - 1, LZ_WINDOW_BITS);
+            bits_put(best_len - 1, LZ_LOOKAHEAD_BITS);
+            pos += best_len;
+        }
+        else
+        {
+            bits_put(1, 1);
+            bits_put(m_data[pos], 8);
+            pos++;
+        }
+    }
+
+    // Zero padding is an incomplete back-reference, which the decoder ignores.
+    if (m_writer.bits != 0)
+    {
+        m_packed[m_writer.len++] = (uint8_t)(m_writer.acc << (8 - m_writer.bits));
+    }
+    return m_writer.len;
+}
+
+
+/**@brief Function for decoding m_packed into m_out, sinking and polling pieces of the given sizes,
+ *        as the asset service does with data writes and staging buffers.
+ *
+ * @return Bytes decoded.
+ */
+static uint32_t decode(uint32_t packed_len, uint16_t sink_piece, uint16_t poll_piece, uint32_t * p_cycles)
+{
+    uint32_t in  = 0;
+    uint32_t out = 0;
+    uint32_t start;
+    uint16_t produced;
+
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    start      = DWT->CYCCNT;
+
+    lz_decoder_init(&m_decoder);
+    do
+    {
+        uint16_t piece = MIN(MIN(sink_piece, packed_len - in), lz_decoder_sink_space(&m_decoder));
+
+        if (piece > 0)
+        {
+            TEST_ASSERT_EQUAL(NRF_SUCCESS, lz_decoder_sink(&m_decoder, &m_packed[in], piece));
+            in += piece;
+        }
+        produced = lz_decoder_poll(&m_decoder, &m_out[out], MIN(poll_piece, sizeof(m_out) - out));
+        out     += produced;
+    } while ((in < packed_len) || (produced > 0));
+
+    *p_cycles = DWT->CYCCNT - start;
+    return out;
+}
+
+
+/**@brief Function for a small icon of a few colours in RGB565, as the watch faces use. */
+static uint32_t icon_make(void)
+{
+    uint16_t * p_pixels = (uint16_t *)m_data;
+    int32_t    x;
+    int32_t    y;
+
+    for (y = 0; y < ICON_SIDE; y++)
+    {
+        for (x = 0; x < ICON_SIDE; x++)
+        {
+            int32_t dx = x - ICON_SIDE / 2;
+            int32_t dy = y - ICON_SIDE / 2;
+            int32_t r2 = dx * dx + dy * dy;
+
+            p_pixels[y * ICON_SIDE + x] = (r2 < 100) ? 0xFFE0 : (r2 < 196) ? 0xF800 : 0x0000;
+        }
+    }
+    return ICON_SIDE * ICON_SIDE * 2;
+}
+
+
+/**@brief Function for text of the kind of a notification digest. */
+static uint32_t text_make(void)
+{
+    static char const * const words[] = {"meeting ", "at ", "noon ", "with ", "the ", "team ",
+                                         "lunch ", "tomorrow ", "call ", "me ", "back ", "please "};
+    uint32_t len = 0;
+
+    while (len < 2000)
+    {
+        char const * p_word = words[sim_rand() % (sizeof(words) / sizeof(words[0]))];
+
+        memcpy(&m_data[len], p_word, strlen(p_word));
+        len += strlen(p_word);
+    }
+    return len;
+}
+
+
+static uint32_t noise_make(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < 2000; i++)
+    {
+        m_data[i] = (uint8_t)sim_rand();
+    }
+    return 2000;
+}
+
+
+/**@brief Function for checking the round trip of m_data through pieces of many sizes.
+ *
+ * @return Compressed length.
+ */
+static uint32_t round_trip(uint32_t len, uint32_t * p_cycles)
+{
+    static const uint16_t pieces[][2] = {{1, 1}, {1, 4096}, {18, 64}, {18, 1}, {256, 4096}, {7, 13}};
+    uint32_t packed_len = compress(len);
+    uint32_t i;
+
+    for (i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++)
+    {
+        memset(m_out, 0, sizeof(m_out));
+        TEST_ASSERT_EQUAL(len, decode(packed_len, pieces[i][0], pieces[i][1], p_cycles));
+        TEST_ASSERT(memcmp(m_out, m_data, len) == 0);
+    }
+
+    // In the sizes the asset service uses: data chunks in, staging buffer pieces out.
+    (void)decode(packed_len, 18, 256, p_cycles);
+    return packed_len;
+}
+
+
+TEST(icon)
+{
+    uint32_t len = icon_make();
+    uint32_t cycles;
+    uint32_t packed_len = round_trip(len, &cycles);
+
+    // Runs of a few colours: under a fifth of the size.
+    TEST_ASSERT(packed_len * 5 < len);
+    test_report("icon: %u -> %u bytes (%u%%), %u host cycles per KB decoded", len, packed_len,
+                packed_len * 100 / len, (uint32_t)((uint64_t)cycles * 1024 / len));
+}
+
+
+TEST(text)
+{
+    uint32_t len = text_make();
+    uint32_t cycles;
+    uint32_t packed_len = round_trip(len, &cycles);
+
+    TEST_ASSERT(packed_len * 10 < len * 7);
+    test_report("text: %u -> %u bytes (%u%%), %u host cycles per KB decoded", len, packed_len,
+                packed_len * 100 / len, (uint32_t)((uint64_t)cycles * 1024 / len));
+}
+
+
+TEST(noise)
+{
+    uint32_t len = noise_make();
+    uint32_t cycles;
+    uint32_t packed_len = round_trip(len, &cycles);
+
+    // Incompressible data costs at most the literal flags.
+    TEST_ASSERT(packed_len <= (len * 9 + 7) / 8);
+    test_report("noise: %u -> %u bytes (%u%%)", len, packed_len, packed_len * 100 / len);
+}
+
+
+TEST(input_full)
+{
+    uint8_t  byte = 0x80;
+    uint32_t i;
+
+    // The decoder takes no more than its buffer until it is polled.
+    lz_decoder_init(&m_decoder);
+    for (i = 0; i < LZ_INPUT_BUF_SIZE; i++)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, lz_decoder_sink(&m_decoder, &byte, 1));
+    }
+    TEST_ASSERT_EQUAL(0, lz_decoder_sink_space(&m_decoder));
+    TEST_ASSERT_EQUAL(NRF_ERROR_NO_MEM, lz_decoder_sink(&m_decoder, &byte, 1));
+    TEST_ASSERT(lz_decoder_poll(&m_decoder, m_out, sizeof(m_out)) > 0);
+    TEST_ASSERT(lz_decoder_sink_space(&m_decoder) > 0);
+    test_report("decoder state: %u bytes of RAM", (uint32_t)sizeof(lz_decoder_t));
+}
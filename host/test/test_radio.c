@@ -0,0 +1,123 @@
+/* The radio-aware scheduler on the radio timeline of fast advertising: a job postponed because it
+ * does not fit the idle window must still run when the radio then goes quiet, with no radio event
+ * left to end. The phone sets the time first, so that the clock keeps RTC1 running.
+ */
+
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_script.h"
+#include "sim_uart.h"
+#include "nrf_delay.h"
+#include "nrf_error.h"
+#include "ble_gap.h"
+#include "radio_sched.h"
+#include "test.h"
+
+#define JOB_TIME_MS     20             /**< Run time of the job: most of a fast advertising interval. */
+#define PROBE_START     SIM_S(9)       /**< Fast advertising after the disconnect. */
+#define PROBE_STEP      SIM_MS(7)      /**< Not a divisor of the advertising interval. */
+#define PROBE_POLL      SIM_US(100)
+#define PROBE_END       SIM_S(25)
+
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n"
+    "8    disconnect 0\n"
+    "+0.5 away 0\n"
+    "25.5 type stats\n";
+
+static radio_sched_job_id_t m_job_id;
+static uint32_t             m_runs;
+static uint64_t             m_run_time;        /**< Start of the last run of the job. */
+static uint32_t             m_postponed;       /**< Postponed requests before the probe. */
+static uint32_t             m_probe_runs;      /**< Runs of the job before the probe. */
+static uint64_t             m_stop_time;       /**< Advertising stopped, 0 while it runs. */
+
+
+static void job(void)
+{
+    m_runs++;
+    m_run_time = sim_time();
+    nrf_delay_ms(JOB_TIME_MS);
+}
+
+
+static uint32_t postponed_get(void)
+{
+    radio_sched_stats_t stats;
+
+    radio_sched_stats_get(&stats);
+    return stats.collisions_avoided;
+}
+
+
+static void probe_check(void * p_context);
+
+
+/**@brief Function for requesting the job, as the firmware would from its main loop. */
+static void probe(void * p_context)
+{
+    m_postponed  = postponed_get();
+    m_probe_runs = m_runs;
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, radio_sched_job_request(m_job_id));
+
+    // Wake the main loop, which runs the scheduler queue.
+    sim_irq_pend(SWI3_EGU3_IRQn);
+    (void)sim_at(sim_time() + PROBE_POLL, SIM_OWNER_WORLD, probe_check, NULL);
+}
+
+
+/**@brief Function for stopping advertising as soon as a request is postponed: no radio event
+ *        ends after that. The main loop may be busy with the clock when the probe comes.
+ */
+static void probe_check(void * p_context)
+{
+    if (postponed_get() != m_postponed)
+    {
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, sd_ble_gap_adv_stop());
+        m_stop_time = sim_time();
+    }
+    else if (m_runs == m_probe_runs)
+    {
+        (void)sim_at(sim_time() + PROBE_POLL, SIM_OWNER_WORLD, probe_check, NULL);
+    }
+    else if (sim_time() < PROBE_END)
+    {
+        (void)sim_at(sim_time() + PROBE_STEP, SIM_OWNER_WORLD, probe, NULL);
+    }
+}
+
+
+/**@brief Function for creating the job, and running it once to measure it. */
+static void job_setup(void * p_context)
+{
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, radio_sched_job_create(&m_job_id, job));
+    probe(NULL);
+}
+
+
+TEST(quiet_radio)
+{
+    radio_sched_stats_t stats;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    (void)sim_at(PROBE_START, SIM_OWNER_WORLD, job_setup, NULL);
+    sim_end_set(PROBE_END + SIM_S(2));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT(m_stop_time != 0);
+    TEST_ASSERT(!sim_ble_advertising());
+
+    // The retry timer runs the job about one advertising period after it was postponed.
+    radio_sched_stats_get(&stats);
+    TEST_ASSERT(m_run_time > m_stop_time);
+    TEST_ASSERT(m_run_time - m_stop_time <= SIM_MS(2 * 35));
+    TEST_ASSERT_EQUAL(m_probe_runs + 1, m_runs);
+    // The console reports the same counters.
+    TEST_ASSERT(sim_uart_text_find("collisions avoided"));
+
+    test_report("job %u ms, advertising period %u ticks: run %u us after the radio went quiet",
+                JOB_TIME_MS, stats.period, (uint32_t)((m_run_time - m_stop_time) / 1000));
+    test_report("%u requests, %u postponed, %u overruns", stats.requests, stats.collisions_avoided,
+                stats.overruns);
+}
@@ -0,0 +1,92 @@
+/* The firmware on the host target: a phone sets the time and the watch draws it, and two runs of
+ * the same script send the same bytes to the display.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_display.h"
+#include "sim_uart.h"
+#include "sim_script.h"
+#include "display.h"
+#include "test.h"
+
+/* The phone has 2023-11-14 22:13:20 UTC, which the watch reads on button 1 once connected. */
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n"
+    "8    click 1\n";
+
+typedef struct
+{
+    uint32_t trace_hash;
+    uint32_t trace_count;
+    uint64_t first_pixel;
+} render_result_t;
+
+
+static uint32_t fnv1a(uint32_t hash, void const * p_data, size_t len)
+{
+    uint8_t const * p_byte = p_data;
+
+    while (len-- > 0)
+    {
+        hash = (hash ^ *p_byte++) * 16777619u;
+    }
+    return hash;
+}
+
+
+static void render_run(void * p_result)
+{
+    render_result_t * p_out = p_result;
+    uint16_t const  * p_trace;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    sim_end_set(SIM_S(12));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    p_trace            = sim_display_trace_get(&p_out->trace_count);
+    p_out->trace_hash  = fnv1a(2166136261u, p_trace, p_out->trace_count * sizeof(p_trace[0]));
+    p_out->first_pixel = sim_display_first_pixel_time();
+}
+
+
+TEST(clock_drawn)
+{
+    sim_display_stats_t stats;
+    render_result_t     result;
+
+    render_run(&result);
+    sim_display_stats_get(&stats);
+
+    TEST_ASSERT(sim_uart_text_find("PixWatch Starting"));
+    TEST_ASSERT(sim_display_on());
+    TEST_ASSERT_EQUAL(1, stats.unknown);              // 0x65 of the init sequence.
+    TEST_ASSERT_EQUAL(0, stats.short_resets);
+
+    // Each digit cell is 3x3 pixels; the first digit is a 2, whose second row is lit on the right only.
+    TEST_ASSERT_EQUAL(BLUE, sim_display_pixel_get(0, 0));
+    TEST_ASSERT_EQUAL(BLACK, sim_display_pixel_get(0, 3));
+    TEST_ASSERT_EQUAL(BLUE, sim_display_pixel_get(6, 3));
+    TEST_ASSERT_EQUAL(BLUE, sim_display_pixel_get(12, 0));
+
+    test_report("display: %u bytes, %u pixels, first pixel at %.1f ms",
+                stats.bytes, stats.pixels, (double)result.first_pixel / SIM_MS(1));
+}
+
+
+TEST(deterministic)
+{
+    render_result_t first;
+    render_result_t second;
+
+    TEST_ASSERT(test_isolated(render_run, &first, sizeof(first)));
+    TEST_ASSERT(test_isolated(render_run, &second, sizeof(second)));
+
+    TEST_ASSERT(first.trace_count > 0);
+    TEST_ASSERT_EQUAL(first.trace_count, second.trace_count);
+    TEST_ASSERT_EQUAL(first.trace_hash, second.trace_hash);
+    TEST_ASSERT_EQUAL(first.first_pixel, second.first_pixel);
+
+    test_report("display trace: %u bytes, hash 0x%08x", first.trace_count, first.trace_hash);
+}
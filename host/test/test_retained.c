@@ -0,0 +1,248 @@
+/* State kept for a bonded phone across its links: the PixWatch handles of its last discovery, on
+ * which the state is read before discovery runs again. And the clock kept across resets of the
+ * chip: drawn with the first pixels after a soft or watchdog reset, black until the phone gives
+ * the time after a power-on.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "sim_uart.h"
+#include "sim_script.h"
+#include "sim_display.h"
+#include "display.h"
+#include "app_timer.h"
+#include "retained.h"
+#include "boot_log.h"
+#include "test.h"
+
+#define TIME_FIRST   1700000000u    /**< Local time of the phone on the first link. */
+#define TIME_LATER   1700086400u    /**< Local time of the phone on the second link. */
+
+extern time_t current_time;
+
+/* The phone bonds and the watch discovers it on the first link; the second link starts with a
+ * state sync on the cached handles. */
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n"
+    "8    disconnect 0\n"
+    "10   connect 0\n";
+
+
+static void phone_time_set(sim_peer_t * p_peer)
+{
+    uint8_t  value[4];
+    uint32_t time = TIME_LATER;
+
+    memcpy(value, &time, sizeof(value));
+    sim_peer_value_set(p_peer, p_peer->pixwatch_handles[0], value, sizeof(value));
+}
+
+
+/**@brief Function for moving the time on the phone, while it is away. */
+static void phone_time_later(void * p_context)
+{
+    phone_time_set(sim_script_peer(0));
+}
+
+
+/**@brief Function for updating the application of the phone while it is away: its new GATT database
+ *        has a Battery Service first, which moves the PixWatch characteristics.
+ */
+static void phone_app_update(void * p_context)
+{
+    static uint8_t const battery_service[2] = {0x0F, 0x18};
+    static uint8_t const battery_level[2]   = {0x19, 0x2A};
+    uint8_t              level              = 100;
+    sim_peer_t         * p_peer             = sim_script_peer(0);
+
+    p_peer->attr_count = 0;
+    (void)sim_peer_service_add(p_peer, battery_service, sizeof(battery_service));
+    (void)sim_peer_char_add(p_peer, battery_level, sizeof(battery_level), 0x02, &level, sizeof(level));
+    sim_peer_pixwatch_add(p_peer);
+    phone_time_set(p_peer);
+}
+
+
+static void reconnect_run(sim_evt_handler_t phone_change)
+{
+    TEST_ASSERT(sim_script_parse(m_script));
+    (void)sim_at(SIM_S(9), SIM_OWNER_WORLD, phone_change, NULL);
+    sim_end_set(SIM_S(16));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT(sim_uart_text_find("State sync on cached handles"));
+    // The clock runs on from the time read.
+    TEST_ASSERT(current_time >= TIME_LATER);
+    TEST_ASSERT(current_time <= TIME_LATER + 10);
+}
+
+
+TEST(cached_handles_confirmed)
+{
+    reconnect_run(phone_time_later);
+    TEST_ASSERT(!sim_uart_text_find("stale"));
+}
+
+
+TEST(cached_handles_stale)
+{
+    // Values read on the old handles are not the state; they are dropped and read again.
+    reconnect_run(phone_app_update);
+    TEST_ASSERT(sim_uart_text_find("stale"));
+}
+
+
+TEST(time_restore)
+{
+    retained_state_t state;
+
+    // The part of a second passed at the reset, to the nearest second.
+    memset(&state, 0, sizeof(state));
+    state.time   = TIME_FIRST;
+    TEST_ASSERT_EQUAL(TIME_FIRST, retained_time_restore(&state));
+    state.offset = APP_TIMER_CLOCK_FREQ / 2 - 1;
+    TEST_ASSERT_EQUAL(TIME_FIRST, retained_time_restore(&state));
+    state.offset = APP_TIMER_CLOCK_FREQ / 2;
+    TEST_ASSERT_EQUAL(TIME_FIRST + 1, retained_time_restore(&state));
+    state.offset = APP_TIMER_CLOCK_FREQ * 3 / 2;
+    TEST_ASSERT_EQUAL(TIME_FIRST + 2, retained_time_restore(&state));
+}
+
+
+#define BOOTS        4
+#define FACE_HEIGHT  96     /**< Rows the boot clears and the clock is drawn in. */
+
+/* The phone gives the time, then goes away for good; the later boots have only what was kept. */
+static char const m_reset_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n"
+    "5    away 0\n"
+    "10   reset soft\n"
+    "20   reset dog\n"
+    "30   reset power\n";
+
+static uint64_t m_reset_time;              /**< Time of the last reset of the chip. */
+static uint64_t m_boot_time[BOOTS];        /**< Time of the reset that started each boot. */
+static uint64_t m_clock_time[BOOTS];       /**< Time the clock was first on screen in each boot. */
+static uint64_t m_first_pixel[BOOTS];      /**< Time of the first pixel written in each boot. */
+static time_t   m_time_at_reset;           /**< The clock just before the soft reset. */
+static uint32_t m_warm_first_pixel;        /**< Boot log of the soft reset: the first frame. */
+static uint32_t m_warm_ble_stack;          /**< Boot log of the soft reset: the SoftDevice up. */
+static time_t   m_time_after_reset;        /**< The clock a second after it. */
+
+
+static void chip_reset(sim_reset_t reset)
+{
+    m_reset_time = sim_time();
+    sim_display_stats_clear();
+}
+
+
+/**@brief Function for checking whether the clock is on screen: the face cleared in this boot, and
+ *        drawn on since.
+ */
+static bool clock_shown(void)
+{
+    sim_display_stats_t stats;
+    uint8_t             x;
+    uint8_t             y;
+
+    sim_display_stats_get(&stats);
+    if (!sim_display_on() || (stats.pixels <= SIM_DISPLAY_WIDTH * FACE_HEIGHT))
+    {
+        return false;
+    }
+    for (y = 0; y < FACE_HEIGHT; y++)
+    {
+        for (x = 0; x < SIM_DISPLAY_WIDTH; x++)
+        {
+            if (sim_display_pixel_get(x, y) != BLACK)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+/**@brief Function for watching the screen every millisecond, as the eye of the user. */
+static void screen_watch(void * p_context)
+{
+    uint32_t boot = sim_boot_count() - 1;
+
+    if (m_first_pixel[boot] == SIM_TIME_NEVER)
+    {
+        m_boot_time[boot]   = m_reset_time;
+        m_first_pixel[boot] = sim_display_first_pixel_time();
+    }
+    if ((m_clock_time[boot] == SIM_TIME_NEVER) && clock_shown())
+    {
+        m_clock_time[boot] = sim_time();
+    }
+    (void)sim_at(sim_time() + SIM_MS(1), SIM_OWNER_WORLD, screen_watch, NULL);
+}
+
+
+static void time_before_reset(void * p_context)
+{
+    m_time_at_reset = current_time;
+}
+
+
+static void time_after_reset(void * p_context)
+{
+    m_time_after_reset = current_time;
+    m_warm_first_pixel = boot_log_stage_get(BOOT_STAGE_FIRST_PIXEL);
+    m_warm_ble_stack   = boot_log_stage_get(BOOT_STAGE_BLE_STACK);
+}
+
+
+TEST(clock_across_resets)
+{
+    uint32_t boot;
+
+    for (boot = 0; boot < BOOTS; boot++)
+    {
+        m_clock_time[boot]  = SIM_TIME_NEVER;
+        m_first_pixel[boot] = SIM_TIME_NEVER;
+    }
+    sim_reset_hook_add(chip_reset);
+    TEST_ASSERT(sim_script_parse(m_reset_script));
+    (void)sim_at(SIM_MS(1), SIM_OWNER_WORLD, screen_watch, NULL);
+    (void)sim_at(SIM_S(10) - SIM_MS(1), SIM_OWNER_WORLD, time_before_reset, NULL);
+    (void)sim_at(SIM_S(11), SIM_OWNER_WORLD, time_after_reset, NULL);
+    sim_end_set(SIM_S(40));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+    TEST_ASSERT_EQUAL(BOOTS, sim_boot_count());
+
+    // Cold: the first pixels clear the screen, and the clock waits for the phone.
+    TEST_ASSERT(m_clock_time[0] > SIM_S(1));
+    TEST_ASSERT(m_first_pixel[0] < SIM_S(1));
+
+    // Warm: the clock is drawn with the first pixels, and runs on without the phone.
+    for (boot = 1; boot <= 2; boot++)
+    {
+        TEST_ASSERT(m_clock_time[boot] != SIM_TIME_NEVER);
+        TEST_ASSERT(m_clock_time[boot] - m_boot_time[boot] < SIM_MS(200));
+        // Right after the face is cleared, at the SPI rate.
+        TEST_ASSERT(m_clock_time[boot] - m_first_pixel[boot] < SIM_MS(50));
+    }
+    // The BLE, storage and service init wait for the restored clock to be on screen.
+    TEST_ASSERT(m_warm_first_pixel <= m_warm_ble_stack);
+    TEST_ASSERT(m_warm_ble_stack != BOOT_LOG_NONE);
+    TEST_ASSERT(m_time_after_reset >= m_time_at_reset);
+    TEST_ASSERT(m_time_after_reset <= m_time_at_reset + 2);
+
+    // Power-on: nothing kept, and no phone to give the time.
+    TEST_ASSERT_EQUAL(SIM_TIME_NEVER, m_clock_time[3]);
+
+    test_report("first pixel %u ms after a power-on, the clock at %u ms once the phone gave the time; "
+                "after a soft reset the clock at %u ms, after a watchdog reset at %u ms",
+                (uint32_t)((m_first_pixel[0] - m_boot_time[0]) / SIM_MS(1)),
+                (uint32_t)((m_clock_time[0] - m_boot_time[0]) / SIM_MS(1)),
+                (uint32_t)((m_clock_time[1] - m_boot_time[1]) / SIM_MS(1)),
+                (uint32_t)((m_clock_time[2] - m_boot_time[2]) / SIM_MS(1)));
+}
@@ -0,0 +1,357 @@
+/* The settings store on the flash model: the bytes and erases a run of writes costs, spread over
+ * its pages and counted as the flash saw them, the values found again at boot, and power cut at
+ * random points of writes and of garbage collection, after which every key holds a whole value,
+ * the last one acknowledged or the one being written. And new keys set and deleted in turn, far more
+ * than the index holds.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_flash.h"
+#include "nrf.h"
+#include "nrf_error.h"
+#include "pstorage.h"
+#include "softdevice_handler.h"
+#include "settings.h"
+#include "test.h"
+
+#define KEYS        4
+#define VALUE_LEN   SETTINGS_VALUE_MAX_LEN
+
+static settings_stats_t m_stats;
+
+
+/**@brief Function for starting pstorage and the settings store alone, as main.c does. */
+static void settings_start(void)
+{
+    SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_XTAL_20_PPM, NULL);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, softdevice_sys_evt_handler_set(pstorage_sys_event_handler));
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, pstorage_init());
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, settings_init());
+    settings_stats_get(&m_stats);
+}
+
+
+/**@brief Function for making the value of a key from a count, so that any value read can be checked
+ *        whole.
+ */
+static void value_make(uint16_t key, uint32_t count, uint8_t * p_value)
+{
+    uint32_t i;
+
+    for (i = 0; i < VALUE_LEN; i++)
+    {
+        p_value[i] = (uint8_t)(count + i * key);
+    }
+    memcpy(p_value, &count, sizeof(count));
+}
+
+
+/**@brief Function for reading the count a key holds, 0 if none.
+ */
+static uint32_t value_get(uint16_t key)
+{
+    uint8_t  value[VALUE_LEN];
+    uint8_t  expected[VALUE_LEN];
+    uint8_t  length = sizeof(value);
+    uint32_t count;
+
+    if (settings_get(key, value, &length) == NRF_ERROR_NOT_FOUND)
+    {
+        return 0;
+    }
+    TEST_ASSERT_EQUAL(VALUE_LEN, length);
+    memcpy(&count, value, sizeof(count));
+    value_make(key, count, expected);
+    TEST_ASSERT(memcmp(value, expected, VALUE_LEN) == 0);
+    return count;
+}
+
+
+static bool settings_idle(void)
+{
+    return !settings_busy();
+}
+
+
+static void set_wait(uint16_t key, uint32_t count)
+{
+    uint8_t  value[VALUE_LEN];
+    uint32_t err_code;
+
+    value_make(key, count, value);
+    for (;;)
+    {
+        TEST_ASSERT(sim_run_until(settings_idle, SIM_S(1)));
+        err_code = settings_set(key, value, sizeof(value));
+        if (err_code != NRF_ERROR_BUSY)
+        {
+            break;
+        }
+
+        // Busy only while a garbage collection it started runs, not for good.
+        TEST_ASSERT(settings_busy());
+    }
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, err_code);
+    TEST_ASSERT(sim_run_until(settings_idle, SIM_S(1)));
+}
+
+
+#define WEAR_SETS  1000    /**< Several times around the pages. */
+
+static void wear_entry(void)
+{
+    sim_flash_stats_t flash;
+    uint32_t          erases[SETTINGS_PAGE_COUNT];
+    uint32_t          pages = 0;
+    uint32_t          page;
+    uint32_t          i;
+
+    settings_start();
+    if (sim_boot_count() == 1)
+    {
+        sim_flash_stats_clear();
+        for (i = 1; i <= WEAR_SETS; i++)
+        {
+            set_wait(SETTINGS_KEY_USER + i % KEYS, i);
+        }
+
+        // What the store counts is what went to flash.
+        sim_flash_stats_get(&flash);
+        settings_stats_get(&m_stats);
+        TEST_ASSERT_EQUAL(WEAR_SETS, m_stats.sets);
+        TEST_ASSERT_EQUAL(0, m_stats.failed);
+        TEST_ASSERT_EQUAL(flash.words * 4, m_stats.flash_bytes);
+        TEST_ASSERT_EQUAL(flash.erases, m_stats.page_erases);
+        TEST_ASSERT_EQUAL(0, flash.overwrites);
+        TEST_ASSERT(m_stats.gc_runs > SETTINGS_PAGE_COUNT);
+
+        // The pages are used in turn.
+        for (page = 0; page < SIM_FLASH_PAGES; page++)
+        {
+            if (sim_flash_page_erase_count(page) > 0)
+            {
+                TEST_ASSERT(pages < SETTINGS_PAGE_COUNT);
+                erases[pages++] = sim_flash_page_erase_count(page);
+            }
+        }
+        TEST_ASSERT_EQUAL(SETTINGS_PAGE_COUNT, pages);
+        TEST_ASSERT(erases[0] <= erases[1] + 1);
+        TEST_ASSERT(erases[1] <= erases[0] + 1);
+
+        test_report("%u sets of %u bytes: %u bytes written, %u erases (%u and %u), %u records copied",
+                    m_stats.sets, VALUE_LEN, m_stats.flash_bytes, m_stats.page_erases, erases[0], erases[1],
+                    m_stats.gc_copies);
+        sim_reset(SIM_RESET_POWER_ON);
+    }
+
+    // Each key holds its last value after the power-on.
+    for (i = WEAR_SETS - KEYS + 1; i <= WEAR_SETS; i++)
+    {
+        TEST_ASSERT_EQUAL(i, value_get(SETTINGS_KEY_USER + i % KEYS));
+    }
+    TEST_ASSERT(m_stats.recovered >= KEYS);
+    TEST_ASSERT_EQUAL(0, m_stats.torn);
+    test_report("index rebuilt from %u records in %u host cycles", m_stats.recovered, m_stats.rebuild_cycles);
+    sim_stop(0);
+}
+
+
+TEST(wear)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(wear_entry));
+    TEST_ASSERT_EQUAL(2, sim_boot_count());
+}
+
+
+#define PAGE_RECORDS  ((SIM_FLASH_PAGE_SIZE - 8) / (VALUE_LEN + 8))  /**< Records of 32 bytes a page holds. */
+
+static void torn_copy_entry(void)
+{
+    uint32_t i;
+
+    settings_start();
+    if (sim_boot_count() == 1)
+    {
+        for (i = 1; i <= PAGE_RECORDS; i++)
+        {
+            set_wait(SETTINGS_KEY_USER + i % KEYS, i);
+        }
+
+        // The next write opens the other page: its header, the record, then garbage collection
+        // copies the live records of the full page. Power goes as the first word of the first copy
+        // is programmed, leaving a header of any length.
+        sim_flash_power_loss_set(3, 0);
+        set_wait(SETTINGS_KEY_USER + i % KEYS, i);
+        TEST_ASSERT(false);
+    }
+
+    // The torn copy is skipped, the collection ends, and the store takes writes again.
+    TEST_ASSERT_EQUAL(1, m_stats.torn);
+    for (i = PAGE_RECORDS - KEYS + 2; i <= PAGE_RECORDS + 1; i++)
+    {
+        TEST_ASSERT_EQUAL(i, value_get(SETTINGS_KEY_USER + i % KEYS));
+    }
+    for (i = PAGE_RECORDS + 2; i <= 2 * PAGE_RECORDS; i++)
+    {
+        set_wait(SETTINGS_KEY_USER + i % KEYS, i);
+    }
+    sim_stop(0);
+}
+
+
+TEST(torn_copy)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(torn_copy_entry));
+    TEST_ASSERT_EQUAL(2, sim_boot_count());
+}
+
+
+static void delete_wait(uint16_t key)
+{
+    uint32_t err_code;
+
+    do
+    {
+        TEST_ASSERT(sim_run_until(settings_idle, SIM_S(1)));
+        err_code = settings_delete(key);
+    } while (err_code == NRF_ERROR_BUSY);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, err_code);
+    TEST_ASSERT(sim_run_until(settings_idle, SIM_S(1)));
+}
+
+
+#define LIVE_KEYS   (SETTINGS_MAX_KEYS - 1)    /**< Keys kept, leaving one slot of the index free. */
+#define CHURN_KEYS  (4 * SETTINGS_MAX_KEYS)    /**< New keys set and deleted, one after the other. */
+#define CHURN_KEY   (SETTINGS_KEY_USER + 0x100)
+
+static void key_churn_entry(void)
+{
+    uint32_t i;
+    uint32_t k;
+
+    settings_start();
+    if (sim_boot_count() == 1)
+    {
+        for (k = 0; k < LIVE_KEYS; k++)
+        {
+            set_wait(SETTINGS_KEY_USER + k, k + 1);
+        }
+
+        // Each deleted key gives its slot back, so the next new key finds room, and the keys probed
+        // past a freed slot are still found.
+        for (i = 0; i < CHURN_KEYS; i++)
+        {
+            set_wait(CHURN_KEY + i, i + 1);
+            TEST_ASSERT_EQUAL(i + 1, value_get(CHURN_KEY + i));
+            delete_wait(CHURN_KEY + i);
+            TEST_ASSERT_EQUAL(0, value_get(CHURN_KEY + i));
+            for (k = 0; k < LIVE_KEYS; k++)
+            {
+                TEST_ASSERT_EQUAL(k + 1, value_get(SETTINGS_KEY_USER + k));
+            }
+        }
+        settings_stats_get(&m_stats);
+        TEST_ASSERT(m_stats.gc_runs > 0);
+        test_report("%u keys set and deleted beside %u kept, in an index of %u keys; %u collections",
+                    CHURN_KEYS, LIVE_KEYS, SETTINGS_MAX_KEYS, m_stats.gc_runs);
+        sim_reset(SIM_RESET_POWER_ON);
+    }
+
+    // The rebuild drops the deleted keys again, and leaves room for one more.
+    for (k = 0; k < LIVE_KEYS; k++)
+    {
+        TEST_ASSERT_EQUAL(k + 1, value_get(SETTINGS_KEY_USER + k));
+    }
+    for (i = 0; i < CHURN_KEYS; i++)
+    {
+        TEST_ASSERT_EQUAL(0, value_get(CHURN_KEY + i));
+    }
+    set_wait(CHURN_KEY, 1);
+    sim_stop(0);
+}
+
+
+TEST(key_churn)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(key_churn_entry));
+    TEST_ASSERT_EQUAL(2, sim_boot_count());
+}
+
+
+#define CUTS          60
+#define OPS_MAX       12    /**< A cut lands on one of the next flash operations: stores, copies or erases. */
+
+/* Kept by the test across the resets of the chip. */
+static uint32_t m_cut;                /**< Power cuts done. */
+static uint32_t m_count;              /**< Count of the last value written. */
+static uint32_t m_acked[KEYS];        /**< Count of the value each key had when its write ended. */
+static uint16_t m_pending_key;        /**< Key being written at the cut, 0 if none. */
+static uint32_t m_pending_count;
+static uint32_t m_torn;               /**< Torn records found at boot, over all boots. */
+static uint32_t m_new_kept;           /**< Cuts after which the value being written was found. */
+
+
+static void power_loss_entry(void)
+{
+    uint32_t count;
+    uint32_t op;
+    uint32_t fraction;
+    uint16_t k;
+
+    settings_start();
+    m_torn += m_stats.torn;
+
+    // Each key holds what it held before the cut, or the value being written, whole.
+    for (k = 0; k < KEYS; k++)
+    {
+        count = value_get(SETTINGS_KEY_USER + k);
+        if ((SETTINGS_KEY_USER + k == m_pending_key) && (count == m_pending_count))
+        {
+            m_new_kept++;
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL(m_acked[k], count);
+        }
+        m_acked[k] = count;
+    }
+    m_pending_key = 0;
+
+    if (m_cut == CUTS)
+    {
+        sim_stop(0);
+    }
+
+    op       = 1 + sim_rand() % OPS_MAX;
+    fraction = sim_rand() % 257;
+    sim_flash_power_loss_set(op, fraction);
+    m_cut++;
+
+    // Values of 32 bytes: a page holds about a hundred, so the writes cross pages often, and cuts
+    // land in garbage collections too.
+    for (;;)
+    {
+        k               = m_count % KEYS;
+        m_pending_key   = SETTINGS_KEY_USER + k;
+        m_pending_count = ++m_count;
+        set_wait(m_pending_key, m_pending_count);
+        m_acked[k]      = m_pending_count;
+        m_pending_key   = 0;
+    }
+}
+
+
+TEST(power_loss)
+{
+    sim_flash_stats_t flash;
+
+    TEST_ASSERT_EQUAL(0, sim_run(power_loss_entry));
+    sim_flash_stats_get(&flash);
+    TEST_ASSERT_EQUAL(CUTS, flash.power_losses);
+    TEST_ASSERT(m_count > 2 * SIM_FLASH_PAGE_SIZE / (VALUE_LEN + 8));
+    TEST_ASSERT(m_torn > 0);
+    test_report("%u power cuts over %u writes: %u torn records skipped over the boots, %u cut writes kept",
+                CUTS, m_count, m_torn, m_new_kept);
+}
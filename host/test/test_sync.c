@@ -0,0 +1,93 @@
+/* The state sync of the PixWatch client: the GATT requests it takes, as the SoftDevice counts them,
+ * and a request the GATT client refuses while another procedure holds it.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_uart.h"
+#include "sim_script.h"
+#include "nrf_error.h"
+#include "ble_pixwatch_c.h"
+#include "test.h"
+
+#define SYNC_TIME   SIM_S(8)
+
+/* The phone bonds 4 s after the connection; discovery is over by the sync. */
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n";
+
+static uint32_t               m_requests;      /**< GATT client requests before the sync. */
+static uint32_t               m_sync_result;
+static ble_pixwatch_c_t     * mp_pixwatch;
+
+
+static void requests_mark(void)
+{
+    sim_ble_stats_t stats;
+
+    sim_ble_stats_get(&stats);
+    m_requests = stats.gattc_requests;
+}
+
+
+static uint32_t requests_since_mark(void)
+{
+    sim_ble_stats_t stats;
+
+    sim_ble_stats_get(&stats);
+    return stats.gattc_requests - m_requests;
+}
+
+
+static void sync_start(void * p_context)
+{
+    mp_pixwatch = ble_pixwatch_c_find(sim_script_peer(0)->central.conn_handle);
+    TEST_ASSERT(mp_pixwatch != NULL);
+
+    requests_mark();
+    if (p_context != NULL)
+    {
+        // Another request holds the GATT client of the link.
+        TEST_ASSERT_EQUAL(NRF_SUCCESS, ble_pixwatch_c_local_time_read(mp_pixwatch));
+    }
+    m_sync_result = ble_pixwatch_c_sync(mp_pixwatch);
+}
+
+
+static void sync_run(bool busy)
+{
+    TEST_ASSERT(sim_script_parse(m_script));
+    (void)sim_at(SYNC_TIME, SIM_OWNER_WORLD, sync_start, busy ? (void *)1 : NULL);
+    sim_end_set(SYNC_TIME + SIM_S(5));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, m_sync_result);
+    TEST_ASSERT_EQUAL(1, sim_boot_count());
+    TEST_ASSERT(sim_uart_text_find("State received"));
+    TEST_ASSERT_EQUAL((1 << BLE_PIXWATCH_C_FIELD_COUNT) - 1, mp_pixwatch->state.valid);
+    TEST_ASSERT_EQUAL(1700000000, mp_pixwatch->state.local_time);
+}
+
+
+TEST(one_round_trip)
+{
+    sync_run(false);
+
+    // All the fields fit in one Read Multiple response.
+    TEST_ASSERT_EQUAL(1, mp_pixwatch->state.round_trips);
+    TEST_ASSERT_EQUAL(1, requests_since_mark());
+    test_report("state of %u fields in %u request", BLE_PIXWATCH_C_FIELD_COUNT, requests_since_mark());
+}
+
+
+TEST(busy_client_waited)
+{
+    // The sync waits for the read to end instead of failing, and the error handler is not called.
+    sync_run(true);
+
+    TEST_ASSERT(sim_uart_text_find("Current Time received"));
+    TEST_ASSERT_EQUAL(1, mp_pixwatch->state.round_trips);
+    TEST_ASSERT_EQUAL(2, requests_since_mark());
+}
@@ -0,0 +1,305 @@
+/* Telemetry records: the encoder against the decoder of tools/telemetry_decode.py, ported here, and
+ * the record a phone reads and gets notified from the Telemetry Service, before and after a soft
+ * reset of the watch.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_ble.h"
+#include "sim_peer.h"
+#include "sim_script.h"
+#include "app_util.h"
+#include "ble_dispatch.h"
+#include "ble_telemetry.h"
+#include "test.h"
+
+#define UUID_CHAR_DECL  0x2803
+#define READ_TIME       SIM_S(20)      /**< Bonded and encrypted by then. */
+#define RESET_TIME      30
+#define READ_AGAIN_TIME SIM_S(55)     /**< The phone found the link lost by its supervision timeout, and reconnected. */
+
+#define RESETREAS_SREQ  (1UL << 2)     /**< Soft reset, bit 2 of RESETREAS and of the record. */
+#define RESETREAS_OFF   (1UL << 16)    /**< Wake from System OFF by GPIO: bit 4 of the record. */
+
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    connect 0\n"
+    "30   reset soft\n"
+    "+8   connect 0\n"
+    "+0.5 time 0 1700000100\n";
+
+/**@brief Decoded record, as tools/telemetry_decode.py gives it. */
+typedef struct
+{
+    uint8_t  version;
+    uint8_t  length;
+    uint8_t  reset_reason;
+    uint8_t  sched_queue_hwm;
+    uint32_t uptime;
+    uint16_t wakeups_per_hour;
+    uint16_t spi_bytes_per_frame;
+    uint32_t ble_events;
+    uint32_t flash_ops;
+    uint8_t  extra;                    /**< Bytes of later versions, skipped. */
+} decoded_t;
+
+
+/**@brief Function for decoding a record as tools/telemetry_decode.py does: the version 1 fields
+ *        after the header, and whatever the length gives beyond them left alone.
+ *
+ * @return false if the record is too short for its header or for version 1.
+ */
+static bool record_decode(uint8_t const * p_record, uint16_t len, decoded_t * p_decoded)
+{
+    if ((len < 2) || (p_record[0] < 1) || (len < p_record[1]) || (p_record[1] < TELEMETRY_RECORD_LEN))
+    {
+        return false;
+    }
+
+    p_decoded->version             = p_record[0];
+    p_decoded->length              = p_record[1];
+    p_decoded->reset_reason        = p_record[2];
+    p_decoded->sched_queue_hwm     = p_record[3];
+    p_decoded->uptime              = uint32_decode(&p_record[4]);
+    p_decoded->wakeups_per_hour    = uint16_decode(&p_record[8]);
+    p_decoded->spi_bytes_per_frame = uint16_decode(&p_record[10]);
+    p_decoded->ble_events          = uint32_decode(&p_record[12]);
+    p_decoded->flash_ops           = uint32_decode(&p_record[16]);
+    p_decoded->extra               = p_record[1] - TELEMETRY_RECORD_LEN;
+    return true;
+}
+
+
+TEST(encoding)
+{
+    telemetry_record_t record;
+    decoded_t          decoded;
+    uint8_t            buf[TELEMETRY_RECORD_LEN + 4];
+
+    record.reset_reason        = RESETREAS_SREQ | RESETREAS_OFF;
+    record.sched_queue_hwm     = 300;
+    record.uptime              = 86400 * 40 + 7;
+    record.wakeups_per_hour    = 70000;
+    record.spi_bytes_per_frame = 32768 + 12;
+    record.ble_events          = 0x12345678;
+    record.flash_ops           = 0x9ABCDEF0;
+
+    TEST_ASSERT_EQUAL(TELEMETRY_RECORD_LEN, telemetry_encode(&record, buf));
+    TEST_ASSERT(record_decode(buf, TELEMETRY_RECORD_LEN, &decoded));
+    TEST_ASSERT_EQUAL(TELEMETRY_VERSION, decoded.version);
+    TEST_ASSERT_EQUAL(0x14, decoded.reset_reason);
+    TEST_ASSERT_EQUAL(UINT8_MAX, decoded.sched_queue_hwm);
+    TEST_ASSERT_EQUAL(record.uptime, decoded.uptime);
+    TEST_ASSERT_EQUAL(UINT16_MAX, decoded.wakeups_per_hour);
+    TEST_ASSERT_EQUAL(record.spi_bytes_per_frame, decoded.spi_bytes_per_frame);
+    TEST_ASSERT_EQUAL(record.ble_events, decoded.ble_events);
+    TEST_ASSERT_EQUAL(record.flash_ops, decoded.flash_ops);
+    TEST_ASSERT_EQUAL(0, decoded.extra);
+
+    // A record of a later version, with a field appended, still decodes.
+    buf[0] = TELEMETRY_VERSION + 1;
+    buf[1] = TELEMETRY_RECORD_LEN + 4;
+    TEST_ASSERT(record_decode(buf, sizeof(buf), &decoded));
+    TEST_ASSERT_EQUAL(record.flash_ops, decoded.flash_ops);
+    TEST_ASSERT_EQUAL(4, decoded.extra);
+
+    // Truncated records do not.
+    buf[0] = TELEMETRY_VERSION;
+    buf[1] = TELEMETRY_RECORD_LEN;
+    TEST_ASSERT(!record_decode(buf, TELEMETRY_RECORD_LEN - 1, &decoded));
+}
+
+
+/**@brief The reader of the phone. */
+static struct
+{
+    sim_peer_t * p_peer;
+    uint16_t     discover_from;
+    uint16_t     record_handle;
+    bool         cccd_written;
+    uint8_t      reads;
+    decoded_t    read[2];          /**< Record read after the boot, and after the reset. */
+    uint64_t     read_time[2];
+    uint32_t     dispatched[2];    /**< BLE events the firmware had dispatched at the read. */
+    uint8_t      notifications;
+    decoded_t    notified;
+} m_phone;
+
+
+static uint32_t ble_events_dispatched(void)
+{
+    ble_dispatch_stats_t stats;
+    uint32_t             count = 0;
+    uint16_t             evt_id;
+
+    for (evt_id = BLE_DISPATCH_EVT_ID_MIN; evt_id <= BLE_DISPATCH_EVT_ID_MAX; evt_id++)
+    {
+        if (ble_dispatch_stats_get(evt_id, &stats) == NRF_SUCCESS)
+        {
+            count += stats.count;
+        }
+    }
+    return count;
+}
+
+
+static void discover_next(void)
+{
+    uint8_t pdu[7] = {SIM_ATT_READ_BY_TYPE_REQ};
+
+    (void)uint16_encode(m_phone.discover_from, &pdu[1]);
+    (void)uint16_encode(0xFFFF, &pdu[3]);
+    (void)uint16_encode(UUID_CHAR_DECL, &pdu[5]);
+    TEST_ASSERT(sim_peer_request(m_phone.p_peer, pdu, sizeof(pdu)));
+}
+
+
+static void record_read(void * p_context)
+{
+    if (m_phone.record_handle == 0)
+    {
+        m_phone.discover_from = 1;
+        discover_next();
+        return;
+    }
+    m_phone.dispatched[m_phone.reads] = ble_events_dispatched();
+    TEST_ASSERT(sim_peer_read(m_phone.p_peer, m_phone.record_handle));
+}
+
+
+static void on_response(uint8_t const * p_pdu, uint16_t len)
+{
+    uint8_t  cccd[2] = {BLE_GATT_HVX_NOTIFICATION, 0};
+    uint16_t i;
+
+    switch (p_pdu[0])
+    {
+        case SIM_ATT_READ_BY_TYPE_RSP:
+            // Declarations of 128-bit UUIDs: handle, properties, value handle, UUID.
+            for (i = 2; i + p_pdu[1] <= len; i += p_pdu[1])
+            {
+                m_phone.discover_from = uint16_decode(&p_pdu[i]) + 1;
+                if ((p_pdu[1] == 21) && (uint16_decode(&p_pdu[i + 17]) == TELEMETRY_UUID_CHAR_RECORD))
+                {
+                    m_phone.record_handle = uint16_decode(&p_pdu[i + 3]);
+                }
+            }
+            discover_next();
+            break;
+
+        case SIM_ATT_ERROR_RSP:
+            // End of discovery.
+            TEST_ASSERT(m_phone.record_handle != 0);
+            record_read(NULL);
+            break;
+
+        case SIM_ATT_READ_RSP:
+            TEST_ASSERT(m_phone.reads < 2);
+            TEST_ASSERT(record_decode(&p_pdu[1], len - 1, &m_phone.read[m_phone.reads]));
+            m_phone.read_time[m_phone.reads] = sim_time();
+            m_phone.reads++;
+            if (!m_phone.cccd_written)
+            {
+                // The record comes at once when notifications are enabled.
+                m_phone.cccd_written = true;
+                TEST_ASSERT(sim_peer_write(m_phone.p_peer, m_phone.record_handle + 1, cccd, sizeof(cccd), true));
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void phone_evt_handler(sim_peer_t * p_peer, sim_peer_evt_t const * p_evt)
+{
+    if (p_evt->type == SIM_PEER_EVT_RESPONSE)
+    {
+        on_response(p_evt->p_data, p_evt->len);
+    }
+    else if ((p_evt->type == SIM_PEER_EVT_HVX) && (p_evt->handle == m_phone.record_handle))
+    {
+        TEST_ASSERT(record_decode(p_evt->p_data, p_evt->len, &m_phone.notified));
+        m_phone.notifications++;
+    }
+}
+
+
+TEST(read_and_notify)
+{
+    TEST_ASSERT(sim_script_parse(m_script));
+    m_phone.p_peer              = sim_script_peer(0);
+    m_phone.p_peer->evt_handler = phone_evt_handler;
+    (void)sim_at(READ_TIME, SIM_OWNER_WORLD, record_read, NULL);
+    (void)sim_at(READ_AGAIN_TIME, SIM_OWNER_WORLD, record_read, NULL);
+    sim_end_set(READ_AGAIN_TIME + SIM_S(5));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    TEST_ASSERT_EQUAL(2, m_phone.reads);
+    TEST_ASSERT_EQUAL(2, sim_boot_count());
+
+    // First boot: a power-on reset, with the uptime counted from the boot.
+    TEST_ASSERT_EQUAL(TELEMETRY_VERSION, m_phone.read[0].version);
+    TEST_ASSERT_EQUAL(TELEMETRY_RECORD_LEN, m_phone.read[0].length);
+    TEST_ASSERT_EQUAL(0, m_phone.read[0].reset_reason);
+    TEST_ASSERT(m_phone.read[0].uptime + 2 >= m_phone.read_time[0] / SIM_S(1));
+    TEST_ASSERT(m_phone.read[0].uptime <= m_phone.read_time[0] / SIM_S(1));
+    TEST_ASSERT(m_phone.read[0].ble_events >= m_phone.dispatched[0]);
+    TEST_ASSERT(m_phone.read[0].ble_events <= m_phone.dispatched[0] + 2);
+    TEST_ASSERT(m_phone.read[0].sched_queue_hwm > 0);
+    TEST_ASSERT(m_phone.read[0].spi_bytes_per_frame > 0);
+    TEST_ASSERT(m_phone.read[0].wakeups_per_hour > 0);
+
+    // Enabling notifications sent a record of the same layout.
+    TEST_ASSERT_EQUAL(1, m_phone.notifications);
+    TEST_ASSERT_EQUAL(TELEMETRY_RECORD_LEN, m_phone.notified.length);
+    TEST_ASSERT(m_phone.notified.ble_events >= m_phone.read[0].ble_events);
+
+    // After the soft reset: its reason, and the counters from zero again.
+    TEST_ASSERT_EQUAL(RESETREAS_SREQ, m_phone.read[1].reset_reason);
+    TEST_ASSERT(m_phone.read[1].uptime <= (READ_AGAIN_TIME - SIM_S(RESET_TIME)) / SIM_S(1));
+    TEST_ASSERT(m_phone.read[1].ble_events < m_phone.read[0].ble_events + m_phone.dispatched[1]);
+
+    test_report("uptime %u s, %u wakeups per hour, %u BLE events, %u SPI bytes per frame, queue %u",
+                m_phone.read[0].uptime, m_phone.read[0].wakeups_per_hour, m_phone.read[0].ble_events,
+                m_phone.read[0].spi_bytes_per_frame, m_phone.read[0].sched_queue_hwm);
+}
+
+
+#define LATE_CONNECT    600            /**< The phone comes in range ten minutes after the boot. */
+#define HOURS_READ_TIME SIM_S(2 * 3600 + 900)
+
+static char const m_hours_script[] =
+    "0.5  time 0 1700000000\n"
+    "600  connect 0\n";
+
+
+TEST(hours)
+{
+    TEST_ASSERT(sim_script_parse(m_hours_script));
+    m_phone.p_peer              = sim_script_peer(0);
+    m_phone.p_peer->evt_handler = phone_evt_handler;
+    (void)sim_at(SIM_S(LATE_CONNECT + 20), SIM_OWNER_WORLD, record_read, NULL);
+    (void)sim_at(HOURS_READ_TIME, SIM_OWNER_WORLD, record_read, NULL);
+    sim_end_set(HOURS_READ_TIME + SIM_S(5));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+    TEST_ASSERT_EQUAL(2, m_phone.reads);
+
+    // The uptime runs from the boot, not from the first link.
+    TEST_ASSERT(m_phone.read[0].uptime + 1 >= m_phone.read_time[0] / SIM_S(1));
+    TEST_ASSERT(m_phone.read[0].uptime <= m_phone.read_time[0] / SIM_S(1));
+    TEST_ASSERT(m_phone.read[1].uptime + 1 >= m_phone.read_time[1] / SIM_S(1));
+
+    // A rate extrapolated from the first hour, then the rate of a full hour, neither saturated.
+    TEST_ASSERT(m_phone.read[0].wakeups_per_hour > 0);
+    TEST_ASSERT(m_phone.read[0].wakeups_per_hour < UINT16_MAX);
+    TEST_ASSERT(m_phone.read[1].wakeups_per_hour > 0);
+    TEST_ASSERT(m_phone.read[1].wakeups_per_hour < UINT16_MAX);
+
+    // The record when notifications were enabled, then one on each hour of the clock.
+    TEST_ASSERT_EQUAL(3, m_phone.notifications);
+
+    test_report("uptime %u s at the first read; %u wakeups per hour extrapolated, %u over a full hour",
+                m_phone.read[0].uptime, m_phone.read[0].wakeups_per_hour, m_phone.read[1].wakeups_per_hour);
+}
@@ -0,0 +1,122 @@
+/* UART output in chunks: the log bursts of console commands go out in transfers of many bytes,
+ * each a span of the TX FIFO, with the interrupts per KB against one per byte before; and the
+ * bytes counted by the driver against those the terminal received.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "sim_script.h"
+#include "sim_uart.h"
+#include "nrf_error.h"
+#include "app_util_platform.h"
+#include "app_uart.h"
+#include "test.h"
+
+#define RX_PIN          8              /**< Pins of the PCA10040 board, as the firmware. */
+#define TX_PIN          6
+#define TX_BUF_SIZE     1024           /**< As the firmware. */
+#define LEAD            800            /**< Bytes sent first, so the large write wraps the FIFO. */
+#define LARGE           700
+
+/* Console commands that log a burst of lines each, back to back. */
+static char const m_script[] =
+    "0.5  time 0 1700000000\n"
+    "1    type flash\n"
+    "+0.2 type stats\n"
+    "+0.2 type timers\n"
+    "+0.2 type settings\n";
+
+
+TEST(bursts)
+{
+    app_uart_tx_stats_t tx;
+    sim_uart_stats_t    terminal;
+    uint32_t            per_kb;
+
+    TEST_ASSERT(sim_script_parse(m_script));
+    sim_end_set(SIM_S(3));
+    TEST_ASSERT_EQUAL(0, sim_script_run());
+
+    app_uart_tx_stats_get(&tx);
+    sim_uart_stats_get(&terminal);
+
+    // Everything queued went out, in transfers of a span each.
+    TEST_ASSERT_EQUAL(terminal.tx_bytes, tx.bytes);
+    TEST_ASSERT(tx.transfers > 0);
+    TEST_ASSERT(tx.bytes > 0);
+    TEST_ASSERT(tx.bytes <= tx.transfers * UINT8_MAX);
+
+    // Frames logged while a transfer is on the line go out together in the next one.
+    per_kb = tx.transfers * 1024 / tx.bytes;
+    TEST_ASSERT(per_kb < 1024 / 8);
+
+    test_report("%u bytes in %u transfers: %u interrupts per KB against 1024 byte by byte, %u bytes each",
+                tx.bytes, tx.transfers, per_kb, tx.bytes / tx.transfers);
+}
+
+
+static app_uart_tx_stats_t m_tx;
+
+
+static void uart_evt_handler(app_uart_evt_t * p_event)
+{
+}
+
+
+static void write_all(uint8_t const * p_data, uint32_t len)
+{
+    uint32_t size;
+
+    while (len > 0)
+    {
+        size = len;
+        if (app_uart_write(p_data, &size) == NRF_SUCCESS)
+        {
+            p_data += size;
+            len    -= size;
+        }
+        sim_run_for(SIM_MS(1));
+    }
+}
+
+
+static void large_write_entry(void)
+{
+    static uint8_t               data[LARGE];
+    uint32_t                     err_code;
+    const app_uart_comm_params_t comm_params =
+    {
+        RX_PIN,
+        TX_PIN,
+        0xFF,
+        0xFF,
+        APP_UART_FLOW_CONTROL_DISABLED,
+        false,
+        UARTE_BAUDRATE_BAUDRATE_Baud115200
+    };
+
+    APP_UART_FIFO_INIT(&comm_params, 32, TX_BUF_SIZE, uart_evt_handler, APP_IRQ_PRIORITY_LOW, err_code);
+    TEST_ASSERT_EQUAL(NRF_SUCCESS, err_code);
+
+    memset(data, 0x00, sizeof(data));
+    write_all(data, LEAD);
+    sim_run_for(SIM_S(1));
+    app_uart_tx_stats_get(&m_tx);
+    TEST_ASSERT_EQUAL(LEAD, m_tx.bytes);
+
+    write_all(data, LARGE);
+    sim_run_for(SIM_S(1));
+    app_uart_tx_stats_get(&m_tx);
+    sim_stop(0);
+}
+
+
+TEST(large_write)
+{
+    TEST_ASSERT_EQUAL(0, sim_run(large_write_entry));
+
+    // A DMA transfer is at most 255 bytes, and a span ends at the wrap: 800 bytes in four, 700
+    // bytes from offset 800 in 224 + 255 + 221.
+    TEST_ASSERT_EQUAL(LEAD + LARGE, m_tx.bytes);
+    TEST_ASSERT_EQUAL(4 + 3, m_tx.transfers);
+}
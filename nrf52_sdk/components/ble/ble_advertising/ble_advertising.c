@@ -562,3 +562,7 @@ uint32_t ble_advertising_restart_without_whitelist(void)
 }
 
 
+void ble_advertising_modes_config_set(ble_adv_modes_config_t const * p_config)
+{
+    m_adv_modes_config = *p_config;
+}
@@ -216,6 +216,17 @@ uint32_t ble_advertising_whitelist_reply(ble_gap_whitelist_t * p_whitelist);
  * @retval @ref NRF_SUCCESS On success, else an error message propogated from the Softdevice.
  */
 uint32_t ble_advertising_restart_without_whitelist(void);
+
+
+/**@brief Function for changing the advertising modes configuration.
+ *
+ * @details The new intervals and time-outs are used from the next call to
+ *          @ref ble_advertising_start, including the ones made internally when a mode times out
+ *          or a link is disconnected.
+ *
+ * @param[in] p_config  Advertising modes configuration.
+ */
+void ble_advertising_modes_config_set(ble_adv_modes_config_t const * p_config);
 /** @} */
 
 #endif // BLE_ADVERTISING_H__
@@ -28,21 +28,7 @@ static struct
     ble_db_discovery_evt_handler_t evt_handler;  /**< The event handler of the application module to be called in case there are any events.*/
 } m_registered_handlers[DB_DISCOVERY_MAX_USERS];
 
-/**@brief   Array of structures containing pending events to be sent to the application modules.
- *
- * @details Whenever a discovery related event is to be raised to a user module, it will be stored
- *          in this array first. When all services needed to be discovered have been
- *          discovered, all pending events will be sent to the corresponding user modules.
- **/
-static struct
-{
-    ble_db_discovery_evt_t         evt;          /**< The pending event. */
-    ble_db_discovery_evt_handler_t evt_handler;  /**< The event handler which should be called to raise this event. */
-} m_pending_user_evts[DB_DISCOVERY_MAX_USERS];
-
-static uint32_t m_pending_usr_evt_index;    /**< The index to the pending user event array, pointing to the last added pending user event. */
 static uint32_t m_num_of_handlers_reg;      /**< The number of handlers registered with the DB Discovery module. */
-static uint32_t m_num_of_discoveries_made;  /**< The total number of service discoveries (successful or unsuccessful) made since initialization. */
 static bool     m_initialized = false;      /**< This variable Indicates if the module is initialized or not. */
 
 /**@brief     Function for fetching the event handler provided by a registered application module.
@@ -96,18 +82,24 @@ static uint32_t registered_handler_set(const ble_uuid_t * const       p_srv_uuid
 
 
 /**@brief Function for sending all pending discovery events to the corresponding user modules.
+ *
+ * @details Whenever a discovery related event is to be raised to a user module, it is stored in
+ *          the instance first. When all services needed to be discovered have been discovered,
+ *          all pending events are sent to the corresponding user modules.
+ *
+ * @param[in] p_db_discovery Pointer to the DB discovery structure.
  */
-static void pending_user_evts_send(void)
+static void pending_user_evts_send(ble_db_discovery_t * const p_db_discovery)
 {
     uint32_t i;
 
     for (i = 0; i < m_num_of_handlers_reg; i++)
     {
         // Pass the event to the corresponding event handler.
-        m_pending_user_evts[i].evt_handler(&(m_pending_user_evts[i].evt));
+        p_db_discovery->pending_user_evts[i].evt_handler(&(p_db_discovery->pending_user_evts[i].evt));
     }
     
-    m_pending_usr_evt_index = 0;
+    p_db_discovery->pending_usr_evt_index = 0;
 }
 
 
@@ -134,23 +126,23 @@ static void discovery_error_evt_trigger(ble_db_discovery_t * const p_db_discover
 
     if (p_evt_handler != NULL)
     {
-        if (m_pending_usr_evt_index < DB_DISCOVERY_MAX_USERS)
+        if (p_db_discovery->pending_usr_evt_index < DB_DISCOVERY_MAX_USERS)
         {
             // Insert an event into the pending event list.
-            m_pending_user_evts[m_pending_usr_evt_index].evt.conn_handle     =
+            p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt.conn_handle     =
                 p_db_discovery->conn_handle;
-            m_pending_user_evts[m_pending_usr_evt_index].evt.evt_type        =
+            p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt.evt_type        =
                 BLE_DB_DISCOVERY_ERROR;
-            m_pending_user_evts[m_pending_usr_evt_index].evt.params.err_code = err_code;
-            m_pending_user_evts[m_pending_usr_evt_index].evt_handler         = p_evt_handler;
+            p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt.params.err_code = err_code;
+            p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt_handler         = p_evt_handler;
 
-            m_pending_usr_evt_index++;
+            p_db_discovery->pending_usr_evt_index++;
 
-            if (m_pending_usr_evt_index == m_num_of_handlers_reg)
+            if (p_db_discovery->pending_usr_evt_index == m_num_of_handlers_reg)
             {
                 // All registered modules have pending events.
                 // Send all pending events to the user modules.
-                pending_user_evts_send();
+                pending_user_evts_send(p_db_discovery);
             }
         }
         else
@@ -184,34 +176,34 @@ static void discovery_complete_evt_trigger(ble_db_discovery_t * const p_db_disco
 
     if (p_evt_handler != NULL)
     {
-        if (m_pending_usr_evt_index < DB_DISCOVERY_MAX_USERS)
+        if (p_db_discovery->pending_usr_evt_index < DB_DISCOVERY_MAX_USERS)
         {
             // Insert an event into the pending event list.
-            m_pending_user_evts[m_pending_usr_evt_index].evt.conn_handle =
+            p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt.conn_handle =
                 p_db_discovery->conn_handle;
 
             if (is_srv_found)
             {
-                m_pending_user_evts[m_pending_usr_evt_index].evt.evt_type =
+                p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt.evt_type =
                     BLE_DB_DISCOVERY_COMPLETE;
 
-                m_pending_user_evts[m_pending_usr_evt_index].evt.params.discovered_db =
+                p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt.params.discovered_db =
                     *p_srv_being_discovered;
             }
             else
             {
-                m_pending_user_evts[m_pending_usr_evt_index].evt.evt_type =
+                p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt.evt_type =
                     BLE_DB_DISCOVERY_SRV_NOT_FOUND;
             }
-            m_pending_user_evts[m_pending_usr_evt_index].evt_handler = p_evt_handler;
+            p_db_discovery->pending_user_evts[p_db_discovery->pending_usr_evt_index].evt_handler = p_evt_handler;
 
-            m_pending_usr_evt_index++;
+            p_db_discovery->pending_usr_evt_index++;
 
-            if (m_pending_usr_evt_index == m_num_of_handlers_reg)
+            if (p_db_discovery->pending_usr_evt_index == m_num_of_handlers_reg)
             {
                 // All registered modules have pending events. Send all pending events to the user
                 // modules.
-                pending_user_evts_send();
+                pending_user_evts_send(p_db_discovery);
             }
             else
             {
@@ -231,10 +223,10 @@ static void discovery_complete_evt_trigger(ble_db_discovery_t * const p_db_disco
  */
 static void on_srv_disc_completion(ble_db_discovery_t * p_db_discovery)
 {
-    m_num_of_discoveries_made++;
+    p_db_discovery->num_of_discoveries_made++;
 
     // Check if more services need to be discovered.
-    if (m_num_of_discoveries_made < m_num_of_handlers_reg)
+    if (p_db_discovery->num_of_discoveries_made < m_num_of_handlers_reg)
     {
         // Reset the current characteristic index since a new service discovery is about to start.
         p_db_discovery->curr_char_ind = 0;
@@ -767,8 +759,6 @@ uint32_t ble_db_discovery_init(void)
 {
     m_num_of_handlers_reg      = 0;
     m_initialized              = true;
-    m_num_of_discoveries_made  = 0;
-    m_pending_usr_evt_index    = 0;
 
     return NRF_SUCCESS;
 }
@@ -778,8 +768,6 @@ uint32_t ble_db_discovery_close()
 {
     m_num_of_handlers_reg      = 0;
     m_initialized              = false;
-    m_num_of_discoveries_made  = 0;
-    m_pending_usr_evt_index    = 0;
 
     return NRF_SUCCESS;
 }
@@ -834,8 +822,8 @@ uint32_t ble_db_discovery_start(ble_db_discovery_t * const p_db_discovery,
 
     ble_db_discovery_srv_t * p_srv_being_discovered;
 
-    m_num_of_discoveries_made = 0;
-    m_pending_usr_evt_index   = 0;
+    p_db_discovery->num_of_discoveries_made = 0;
+    p_db_discovery->pending_usr_evt_index   = 0;
 
     p_db_discovery->curr_srv_ind = 0;
     p_db_discovery->conn_handle  = conn_handle;
@@ -54,7 +54,7 @@
  */
 
 #define BLE_DB_DISCOVERY_MAX_SRV          2  /**< Maximum number of services supported by this module. This also indicates the maximum number of users allowed to be registered to this module. (one user per service). */
-#define BLE_DB_DISCOVERY_MAX_CHAR_PER_SRV 3  /**< Maximum number of characteristics per service supported by this module. */
+#define BLE_DB_DISCOVERY_MAX_CHAR_PER_SRV 4  /**< Maximum number of characteristics per service supported by this module. */
 
 /** @} */
 
@@ -99,24 +99,6 @@ typedef struct
     ble_gattc_handle_range_t handle_range;                                       /**< Service Handle Range. */
 } ble_db_discovery_srv_t;
 
-/**@brief   Structure for holding the information related to the GATT database at the server.
- *
- * @details This module identifies a remote database. Use one instance of this structure per 
- *          connection.
- *
- * @warning This structure must be zero-initialized.
- */
-typedef struct
-{
-    ble_db_discovery_srv_t services[BLE_DB_DISCOVERY_MAX_SRV];  /**< Information related to the current service being discovered. This is intended for internal use during service discovery.*/
-    uint16_t               conn_handle;                         /**< Connection handle as provided by the SoftDevice. */
-    uint8_t                srv_count;                           /**< Number of services at the peers GATT database.*/
-    uint8_t                curr_char_ind;                       /**< Index of the current characteristic being discovered. This is intended for internal use during service discovery.*/
-    uint8_t                curr_srv_ind;                        /**< Index of the current service being discovered. This is intended for internal use during service discovery.*/
-    bool                   discovery_in_progress;               /**< Variable to indicate if there is a service discovery in progress. */
-} ble_db_discovery_t;
-
-
 /**@brief   Structure containing the event from the DB discovery module to the application.
  */
 typedef struct
@@ -147,6 +129,35 @@ typedef void (* ble_db_discovery_evt_handler_t)(ble_db_discovery_evt_t * p_evt);
  * @{
  */
 
+/**@brief   Structure for holding a discovery event until the discovery of all services is over.
+ */
+typedef struct
+{
+    ble_db_discovery_evt_t         evt;          /**< The pending event. */
+    ble_db_discovery_evt_handler_t evt_handler;  /**< The event handler which should be called to raise this event. */
+} ble_db_discovery_pending_evt_t;
+
+/**@brief   Structure for holding the information related to the GATT database at the server.
+ *
+ * @details This module identifies a remote database. Use one instance of this structure per 
+ *          connection. The state of a discovery is kept in its instance, so discoveries can run
+ *          on several connections at the same time.
+ *
+ * @warning This structure must be zero-initialized.
+ */
+typedef struct
+{
+    ble_db_discovery_srv_t         services[BLE_DB_DISCOVERY_MAX_SRV];           /**< Information related to the current service being discovered. This is intended for internal use during service discovery.*/
+    uint16_t                       conn_handle;                                  /**< Connection handle as provided by the SoftDevice. */
+    uint8_t                        srv_count;                                    /**< Number of services at the peers GATT database.*/
+    uint8_t                        curr_char_ind;                                /**< Index of the current characteristic being discovered. This is intended for internal use during service discovery.*/
+    uint8_t                        curr_srv_ind;                                 /**< Index of the current service being discovered. This is intended for internal use during service discovery.*/
+    bool                           discovery_in_progress;                        /**< Variable to indicate if there is a service discovery in progress. */
+    uint8_t                        num_of_discoveries_made;                      /**< The number of service discoveries (successful or unsuccessful) made since the discovery started. This is intended for internal use during service discovery.*/
+    uint8_t                        pending_usr_evt_index;                        /**< The number of pending events in pending_user_evts. This is intended for internal use during service discovery.*/
+    ble_db_discovery_pending_evt_t pending_user_evts[BLE_DB_DISCOVERY_MAX_SRV];  /**< Events to be sent to the user modules once all services have been discovered. This is intended for internal use during service discovery.*/
+} ble_db_discovery_t;
+
 /** @} */
 
 /**
@@ -36,9 +36,10 @@
 
 #define START_HANDLE_DISCOVER            0x0001                   /**< Value of start handle during discovery. */
 
-#define TX_BUFFER_MASK                   0x07                     /**< TX buffer mask. Must be a mask of contiguous zeroes followed by a contiguous sequence of ones: 000...111. */
-#define TX_BUFFER_SIZE                   (TX_BUFFER_MASK + 1)     /**< Size of send buffer, which is 1 higher than the mask. */
-#define WRITE_MESSAGE_LENGTH             20                       /**< Length of the write message for CCCD/control point. */
+#define TX_BUFFER_MASK                   (BLE_ANCS_C_TX_BUFFER_SIZE - 1) /**< TX buffer mask. Must be a mask of contiguous zeroes followed by a contiguous sequence of ones: 000...111. */
+#define WRITE_MESSAGE_LENGTH             BLE_ANCS_C_WRITE_MESSAGE_LENGTH /**< Length of the write message for CCCD/control point. */
+#define PREPARED_WRITE_LENGTH            (GATT_MTU_SIZE_DEFAULT - 5) /**< Payload of one prepared write, the ATT MTU minus opcode, handle and offset. */
+#define APP_ATTR_REQUEST_MAX_LENGTH      (2 + BLE_ANCS_ATTR_DATA_MAX + 1) /**< Command ID, NUL-terminated app identifier and one attribute ID. */
 #define BLE_CCCD_NOTIFY_BIT_MASK         0x0001                   /**< Enable notification bit. */
 
 #define BLE_ANCS_MAX_DISCOVERED_CENTRALS DEVICE_MANAGER_MAX_BONDS /**< Maximum number of discovered services that can be stored in the flash. This number should be identical to maximum number of bonded peer devices. */
@@ -49,86 +50,12 @@
     CEIL_DIV(sizeof(ble_ancs_c_service_t) * BLE_ANCS_MAX_DISCOVERED_CENTRALS, sizeof(uint32_t)) /**< Size of bonded peer's database in word size (4 byte). */
 
 
-/**@brief ANCS request types.
- */
-typedef enum
-{
-    READ_REQ = 1,  /**< Type identifying that this tx_message is a read request. */
-    WRITE_REQ      /**< Type identifying that this tx_message is a write request. */
-} ancs_tx_request_t;
-
-
-/**@brief Structure used for holding the characteristic found during the discovery process.
- */
-typedef struct
-{
-    ble_uuid_t            uuid;          /**< UUID identifying the characteristic. */
-    ble_gatt_char_props_t properties;    /**< Properties for the characteristic. */
-    uint16_t              handle_decl;   /**< Characteristic Declaration Handle for the characteristic. */
-    uint16_t              handle_value;  /**< Value Handle for the value provided in the characteristic. */
-    uint16_t              handle_cccd;   /**< CCCD Handle value for the characteristic. */
-} ble_ancs_c_characteristic_t;
-
-
-/**@brief Structure used for holding the Apple Notification Center Service found during the discovery process.
- */
-typedef struct
-{
-    uint8_t                     handle;         /**< Handle of Apple Notification Center Service, which identifies to which peer this discovered service belongs. */
-    ble_gattc_service_t         service;        /**< The GATT Service holding the discovered Apple Notification Center Service. */
-    ble_ancs_c_characteristic_t control_point;  /**< Control Point Characteristic for the service. Allows interaction with the peer. */
-    ble_ancs_c_characteristic_t notif_source;   /**< Characteristic that keeps track of arrival, modification, and removal of notifications. */
-    ble_ancs_c_characteristic_t data_source;    /**< Characteristic where attribute data for the notifications is received from peer. */
-} ble_ancs_c_service_t;
-
-
-/**@brief Structure for writing a message to the central, i.e. Control Point or CCCD.
- */
-typedef struct
-{
-    uint8_t                  gattc_value[WRITE_MESSAGE_LENGTH]; /**< The message to write. */
-    ble_gattc_write_params_t gattc_params;                      /**< GATTC parameters for this message. */
-} write_params_t;
-
-
-/**@brief Structure for holding data to be transmitted to the connected master.
- */
-typedef struct
-{
-    uint16_t          conn_handle;  /**< Connection handle to be used when transmitting this message. */
-    ancs_tx_request_t type;         /**< Type of this message, i.e. read or write message. */
-    union
-    {
-        uint16_t       read_handle; /**< Read request message. */
-        write_params_t write_req;   /**< Write request message. */
-    } req;
-} tx_message_t;
-
-
-/**@brief Parsing states for received iOS notification attributes.
- */
-typedef enum
-{
-    COMMAND_ID_AND_NOTIF_UID,  /**< Parsing the command ID and the notification UID. */
-    ATTR_ID,                   /**< Parsing attribute ID. */
-    ATTR_LEN1,                 /**< Parsing the LSB of the attribute length. */
-    ATTR_LEN2,                 /**< Parsing the MSB of the attribute length. */
-    ATTR_DATA,                 /**< Parsing the attribute data. */
-    DONE                       /**< Parsing is done. */
-} ble_ancs_c_parse_state_t;
-
-static tx_message_t m_tx_buffer[TX_BUFFER_SIZE];                           /**< Transmit buffer for messages to be transmitted to the Notification Provider. */
-static uint32_t     m_tx_insert_index = 0;                                 /**< Current index in the transmit buffer where the next message should be inserted. */
-static uint32_t     m_tx_index        = 0;                                 /**< Current index in the transmit buffer from where the next message to be transmitted resides. */
-
-static ble_ancs_c_service_t   m_service;                                   /**< Current service data. */
-static ble_ancs_c_t         * mp_ble_ancs;                                 /**< Pointer to the current instance of the ANCS client module. The memory for this is provided by the application.*/
+static ble_ancs_c_service_t   m_service;                                   /**< UUIDs of the service and its characteristics. The handles are found per link, in the instances. */
+static ble_ancs_c_t         * mp_ble_ancs;                                 /**< Array of ANCS client instances, one per link. The memory for this is provided by the application.*/
+static uint8_t                m_link_count;                                /**< Number of instances in mp_ble_ancs. */
 static ble_ancs_c_attr_list_t m_ancs_attr_list[BLE_ANCS_NB_OF_ATTRS];      /**< For all attributes; contains whether they should be requested upon attribute request and the length and buffer of where to store attribute data. */
-static uint32_t               m_expected_number_of_attrs;                  /**< Variable to keep track of when to stop reading incoming attributes. */
 static ble_ancs_c_evt_t       m_ancs_evt;                                  /**< The ANCS event that is created in this module and propagated to the application. */
 
-static ble_ancs_c_parse_state_t m_parse_state = COMMAND_ID_AND_NOTIF_UID;  /**< ANCS notification attribute parsing state. */
-
 
 /**@brief 128-bit service UUID for the Apple Notification Center Service.
  */
@@ -177,6 +104,71 @@ const ble_uuid128_t ble_ancs_ds_base_uuid128 =
 };
 
 
+ble_ancs_c_t * ble_ancs_c_find(uint16_t conn_handle)
+{
+    uint32_t i;
+
+    if (conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < m_link_count; i++)
+    {
+        if (mp_ble_ancs[i].conn_handle == conn_handle)
+        {
+            return &mp_ble_ancs[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for clearing the link state of an instance.
+ *
+ * @param[in] p_ancs       Pointer to the ANCS instance.
+ * @param[in] conn_handle  Connection handle of the link served next, or BLE_CONN_HANDLE_INVALID.
+ */
+static void instance_reset(ble_ancs_c_t * p_ancs, uint16_t conn_handle)
+{
+    p_ancs->conn_handle              = conn_handle;
+    p_ancs->central_handle           = DM_INVALID_ID;
+    p_ancs->service                  = m_service;
+    p_ancs->tx_insert_index          = 0;
+    p_ancs->tx_index                 = 0;
+    p_ancs->expected_number_of_attrs = 0;
+    p_ancs->request_uid              = 0;
+
+    // Nothing is parsed until attributes are requested on the link.
+    p_ancs->parse_state = BLE_ANCS_C_PARSE_DONE;
+
+    memset(&p_ancs->evt, 0, sizeof(p_ancs->evt));
+    p_ancs->evt.conn_handle    = conn_handle;
+    p_ancs->evt.ancs_attr_list = m_ancs_attr_list;
+}
+
+
+/**@brief Function for getting the instance of a link, assigning a free one on a new link.
+ *
+ * @return Client instance, or NULL if all instances serve other links.
+ */
+static ble_ancs_c_t * instance_assign(uint16_t conn_handle)
+{
+    ble_ancs_c_t * p_ancs = ble_ancs_c_find(conn_handle);
+    uint32_t       i;
+
+    for (i = 0; (p_ancs == NULL) && (i < m_link_count); i++)
+    {
+        if (mp_ble_ancs[i].conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+            p_ancs = &mp_ble_ancs[i];
+            instance_reset(p_ancs, conn_handle);
+        }
+    }
+    return p_ancs;
+}
+
+
 /**@brief Function for handling events from the database discovery module.
  *
  * @details This function handles events from the database discovery module and determines
@@ -193,16 +185,21 @@ static void db_discover_evt_handler(ble_db_discovery_evt_t * p_evt)
 
     ble_ancs_c_evt_t evt;
     ble_db_discovery_char_t * p_chars;
+    ble_ancs_c_t            * p_ancs;
 
     p_chars = p_evt->params.discovered_db.charateristics;
+    p_ancs  = ble_ancs_c_find(p_evt->conn_handle);
+    if (p_ancs == NULL)
+    {
+        return;
+    }
+    evt.conn_handle = p_evt->conn_handle;
 
     // Check if the ANCS Service was discovered.
     if (p_evt->evt_type == BLE_DB_DISCOVERY_COMPLETE &&
         p_evt->params.discovered_db.srv_uuid.uuid == ANCS_UUID_SERVICE &&
-        p_evt->params.discovered_db.srv_uuid.type == BLE_UUID_TYPE_VENDOR_BEGIN)
+        p_evt->params.discovered_db.srv_uuid.type == m_service.service.uuid.type)
     {
-        mp_ble_ancs->conn_handle = p_evt->conn_handle;
-
         // Find the handles of the ANCS characteristic.
         uint32_t i;
 
@@ -212,26 +209,26 @@ static void db_discover_evt_handler(ble_db_discovery_evt_t * p_evt)
             {
                 case ANCS_UUID_CHAR_CONTROL_POINT:
                     LOG("[ANCS]: Control Point Characteristic found.\n\r");
-                    m_service.control_point.properties   = p_chars[i].characteristic.char_props;
-                    m_service.control_point.handle_decl  = p_chars[i].characteristic.handle_decl;
-                    m_service.control_point.handle_value = p_chars[i].characteristic.handle_value;
-                    m_service.control_point.handle_cccd  = p_chars[i].cccd_handle;
+                    p_ancs->service.control_point.properties   = p_chars[i].characteristic.char_props;
+                    p_ancs->service.control_point.handle_decl  = p_chars[i].characteristic.handle_decl;
+                    p_ancs->service.control_point.handle_value = p_chars[i].characteristic.handle_value;
+                    p_ancs->service.control_point.handle_cccd  = p_chars[i].cccd_handle;
                     break;
 
                 case ANCS_UUID_CHAR_DATA_SOURCE:
                     LOG("[ANCS]: Data Source Characteristic found.\n\r");
-                    m_service.data_source.properties   = p_chars[i].characteristic.char_props;
-                    m_service.data_source.handle_decl  = p_chars[i].characteristic.handle_decl;
-                    m_service.data_source.handle_value = p_chars[i].characteristic.handle_value;
-                    m_service.data_source.handle_cccd  = p_chars[i].cccd_handle;
+                    p_ancs->service.data_source.properties   = p_chars[i].characteristic.char_props;
+                    p_ancs->service.data_source.handle_decl  = p_chars[i].characteristic.handle_decl;
+                    p_ancs->service.data_source.handle_value = p_chars[i].characteristic.handle_value;
+                    p_ancs->service.data_source.handle_cccd  = p_chars[i].cccd_handle;
                     break;
 
                 case ANCS_UUID_CHAR_NOTIFICATION_SOURCE:
                     LOG("[ANCS]: Notification point Characteristic found.\n\r");
-                    m_service.notif_source.properties   = p_chars[i].characteristic.char_props;
-                    m_service.notif_source.handle_decl  = p_chars[i].characteristic.handle_decl;
-                    m_service.notif_source.handle_value = p_chars[i].characteristic.handle_value;
-                    m_service.notif_source.handle_cccd  = p_chars[i].cccd_handle;
+                    p_ancs->service.notif_source.properties   = p_chars[i].characteristic.char_props;
+                    p_ancs->service.notif_source.handle_decl  = p_chars[i].characteristic.handle_decl;
+                    p_ancs->service.notif_source.handle_value = p_chars[i].characteristic.handle_value;
+                    p_ancs->service.notif_source.handle_cccd  = p_chars[i].cccd_handle;
                     break;
 
                 default:
@@ -239,49 +236,108 @@ static void db_discover_evt_handler(ble_db_discovery_evt_t * p_evt)
             }
         }
         evt.evt_type = BLE_ANCS_C_EVT_DISCOVER_COMPLETE;
-        mp_ble_ancs->evt_handler(&evt);
+        p_ancs->evt_handler(&evt);
     }
     else
     {
         evt.evt_type = BLE_ANCS_C_EVT_DISCOVER_FAILED;
-        mp_ble_ancs->evt_handler(&evt);
+        p_ancs->evt_handler(&evt);
+    }
+}
+
+
+/**@brief Function for getting the number of free entries in the transmit buffer.
+ */
+static uint32_t tx_buffer_free_get(const ble_ancs_c_t * p_ancs)
+{
+    return TX_BUFFER_MASK - ((p_ancs->tx_insert_index - p_ancs->tx_index) & TX_BUFFER_MASK);
+}
+
+
+/**@brief Function for dropping the rest of a failed prepared write request from the buffer.
+ *
+ * @details The remaining prepared writes of the request are skipped, and its execute write is
+ *          turned into a cancel, so the chunks the Notification Provider queued before the failure
+ *          are discarded instead of prefixing the next request.
+ */
+static void tx_buffer_prepared_flush(ble_ancs_c_t * p_ancs)
+{
+    while ((p_ancs->tx_index != p_ancs->tx_insert_index) &&
+           (p_ancs->tx_buffer[p_ancs->tx_index].type == BLE_ANCS_C_WRITE_REQ) &&
+           (p_ancs->tx_buffer[p_ancs->tx_index].req.write_req.gattc_params.write_op == BLE_GATT_OP_PREP_WRITE_REQ))
+    {
+        ++p_ancs->tx_index;
+        p_ancs->tx_index &= TX_BUFFER_MASK;
+    }
+
+    if ((p_ancs->tx_index != p_ancs->tx_insert_index) &&
+        (p_ancs->tx_buffer[p_ancs->tx_index].type == BLE_ANCS_C_WRITE_REQ) &&
+        (p_ancs->tx_buffer[p_ancs->tx_index].req.write_req.gattc_params.write_op == BLE_GATT_OP_EXEC_WRITE_REQ))
+    {
+        p_ancs->tx_buffer[p_ancs->tx_index].req.write_req.gattc_params.flags = BLE_GATT_EXEC_WRITE_FLAG_PREPARED_CANCEL;
     }
 }
 
 
 /**@brief Function for passing any pending request from the buffer to the stack.
  */
-static void tx_buffer_process(void)
+static void tx_buffer_process(ble_ancs_c_t * p_ancs)
 {
-    if (m_tx_index != m_tx_insert_index)
+    if (p_ancs->tx_index != p_ancs->tx_insert_index)
     {
         uint32_t err_code;
 
-        if (m_tx_buffer[m_tx_index].type == READ_REQ)
+        if (p_ancs->tx_buffer[p_ancs->tx_index].type == BLE_ANCS_C_READ_REQ)
         {
-            err_code = sd_ble_gattc_read(m_tx_buffer[m_tx_index].conn_handle,
-                                         m_tx_buffer[m_tx_index].req.read_handle,
+            err_code = sd_ble_gattc_read(p_ancs->tx_buffer[p_ancs->tx_index].conn_handle,
+                                         p_ancs->tx_buffer[p_ancs->tx_index].req.read_handle,
                                          0);
         }
         else
         {
-            err_code = sd_ble_gattc_write(m_tx_buffer[m_tx_index].conn_handle,
-                                          &m_tx_buffer[m_tx_index].req.write_req.gattc_params);
+            err_code = sd_ble_gattc_write(p_ancs->tx_buffer[p_ancs->tx_index].conn_handle,
+                                          &p_ancs->tx_buffer[p_ancs->tx_index].req.write_req.gattc_params);
         }
         if (err_code == NRF_SUCCESS)
         {
-            ++m_tx_index;
-            m_tx_index &= TX_BUFFER_MASK;
+            ++p_ancs->tx_index;
+            p_ancs->tx_index &= TX_BUFFER_MASK;
         }
     }
 }
 
 
+/**@brief Function for sending a parsed notification or app attribute to the application.
+ *
+ * @param[in] p_ancs       Pointer to an ANCS instance to which the event belongs.
+ * @param[in] p_evt        Event being built by the parser.
+ * @param[in] p_data       NUL-terminated attribute data.
+ * @param[in] stored_len   Number of attribute bytes stored in p_data.
+ */
+static void attr_evt_send(ble_ancs_c_t     * p_ancs,
+                          ble_ancs_c_evt_t * p_evt,
+                          uint8_t          * p_data,
+                          uint16_t           stored_len)
+{
+    if (p_ancs->parse_app_attrs)
+    {
+        p_evt->evt_type             = BLE_ANCS_C_EVT_APP_ATTRIBUTE;
+        p_evt->app_attr.attr_len    = stored_len;
+        p_evt->app_attr.p_attr_data = p_data;
+    }
+    else
+    {
+        p_evt->evt_type = BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE;
+    }
+    p_ancs->evt_handler(p_evt);
+}
+
+
 /**@brief Function for parsing received notification attribute response data.
  *
  * @details The data that comes from the Notification Provider can be much longer than what
- *          would fit in a single GATTC notification. Therefore, function relies on static
- *          variables and a state-oriented switch case.
+ *          would fit in a single GATTC notification. Therefore, function relies on the
+ *          parser state of the instance and a state-oriented switch case.
  *          UID and command ID will be received only once at the beginning of the first 
  *          GATTC notification of a new attribute request for a given iOS notification.
  *          After this, we can loop several ID > LENGTH > DATA > ID > LENGTH > DATA until we have
@@ -296,115 +352,137 @@ static void parse_get_notif_attrs_response(ble_ancs_c_t  * p_ancs,
                                            const uint8_t * p_data_src,
                                            const uint16_t  hvx_data_len)
 {
-    static uint8_t               * p_data_dest;
-    static uint16_t                current_attr_index;
-    static ble_ancs_c_evt_t        evt;
     ble_ancs_c_command_id_values_t command_id;
     uint32_t                       index;
 
-    evt.ancs_attr_list = m_ancs_attr_list;
-
     for (index = 0; index < hvx_data_len;)
     {
-        switch (m_parse_state)
+        switch (p_ancs->parse_state)
         {
-            case COMMAND_ID_AND_NOTIF_UID:
+            case BLE_ANCS_C_PARSE_COMMAND_ID_AND_NOTIF_UID:
                 command_id = (ble_ancs_c_command_id_values_t) p_data_src[index++];
+                if (command_id == BLE_ANCS_COMMAND_ID_GET_APP_ATTRIBUTES)
+                {
+                    p_ancs->parse_app_attrs = true;
+                    p_ancs->parse_state     = BLE_ANCS_C_PARSE_APP_ID;
+                    break;
+                }
+                p_ancs->parse_app_attrs = false;
+
                 if(command_id != BLE_ANCS_COMMAND_ID_GET_NOTIF_ATTRIBUTES)
                 {
                     LOG("[ANCS]: Invalid Command ID");
-                    m_parse_state = DONE;
+                    p_ancs->parse_state = BLE_ANCS_C_PARSE_DONE;
                 }
 
-                evt.attr.notif_uid  = uint32_decode(&p_data_src[index]);
-                index              += sizeof(uint32_t);
-                m_parse_state       = ATTR_ID;
+                p_ancs->evt.attr.notif_uid  = uint32_decode(&p_data_src[index]);
+                index                      += sizeof(uint32_t);
+                p_ancs->parse_state         = BLE_ANCS_C_PARSE_ATTR_ID;
+
+                // Compare with the request, not with the latest Notification Source event: more
+                // notifications can arrive while the attributes of an earlier one are fetched.
+                if (p_ancs->evt.attr.notif_uid != p_ancs->request_uid)
+                {
+                    LOG("UID mismatch: Requested UID %x , Attribute UID %x\n\r",
+                        p_ancs->request_uid,
+                        p_ancs->evt.attr.notif_uid);
+                    p_ancs->parse_state = BLE_ANCS_C_PARSE_DONE;
+                }
+                break;
 
-                if (evt.attr.notif_uid != m_ancs_evt.notif.notif_uid)
+            case BLE_ANCS_C_PARSE_APP_ID:
+                // The app identifier was provided by us in the request; skip it.
+                if (p_data_src[index++] == '\0')
                 {
-                    LOG("UID mismatch: Notification UID %x , Attribute UID %x\n\r",
-                        evt.notif.notif_uid,
-                        evt.attr.notif_uid);
-                    m_parse_state = DONE;
+                    p_ancs->parse_state = BLE_ANCS_C_PARSE_ATTR_ID;
                 }
                 break;
 
-            case ATTR_ID:
-                if (m_expected_number_of_attrs == 0)
+            case BLE_ANCS_C_PARSE_ATTR_ID:
+                if (p_ancs->expected_number_of_attrs == 0)
                 {
                     LOG("[ANCS]: All requested attributes received\n\r");
-                    m_parse_state = DONE;
+                    p_ancs->parse_state = BLE_ANCS_C_PARSE_DONE;
                     index++;
                 }
+                else if (p_ancs->parse_app_attrs)
+                {
+                    p_ancs->evt.app_attr.attr_id = (ble_ancs_c_app_attr_id_values_t) p_data_src[index++];
+                    p_ancs->p_data_dest          = p_ancs->p_app_attr_data;
+                    p_ancs->data_dest_len        = p_ancs->app_attr_len;
+                    p_ancs->parse_state          = BLE_ANCS_C_PARSE_ATTR_LEN1;
+                    p_ancs->expected_number_of_attrs--;
+                    LOG("App Attribute ID %i \n\r", p_ancs->evt.app_attr.attr_id);
+                }
                 else
                 {
-                    evt.attr.attr_id = (ble_ancs_c_notif_attr_id_values_t) p_data_src[index++];
-                    p_data_dest        = m_ancs_attr_list[evt.attr.attr_id].p_attr_data;
-                    if (m_ancs_attr_list[evt.attr.attr_id].get == true)
+                    p_ancs->evt.attr.attr_id = (ble_ancs_c_notif_attr_id_values_t) p_data_src[index++];
+                    p_ancs->p_data_dest      = m_ancs_attr_list[p_ancs->evt.attr.attr_id].p_attr_data;
+                    p_ancs->data_dest_len    = m_ancs_attr_list[p_ancs->evt.attr.attr_id].attr_len;
+                    if (m_ancs_attr_list[p_ancs->evt.attr.attr_id].get == true)
                     {
-                        m_parse_state = ATTR_LEN1;
+                        p_ancs->parse_state = BLE_ANCS_C_PARSE_ATTR_LEN1;
                     }
-                    m_expected_number_of_attrs--;
-                    LOG("Attribute ID %i \n\r", evt.attr.attr_id);
+                    p_ancs->expected_number_of_attrs--;
+                    LOG("Attribute ID %i \n\r", p_ancs->evt.attr.attr_id);
                 }
                 break;
 
-            case ATTR_LEN1:
-                evt.attr.attr_len = p_data_src[index++];
-                m_parse_state       = ATTR_LEN2;
+            case BLE_ANCS_C_PARSE_ATTR_LEN1:
+                p_ancs->evt.attr.attr_len = p_data_src[index++];
+                p_ancs->parse_state       = BLE_ANCS_C_PARSE_ATTR_LEN2;
                 break;
 
-            case ATTR_LEN2:
-                evt.attr.attr_len |= (p_data_src[index++] << 8);
-                current_attr_index   = 0;
-                if (evt.attr.attr_len != 0)
+            case BLE_ANCS_C_PARSE_ATTR_LEN2:
+                p_ancs->evt.attr.attr_len  |= (p_data_src[index++] << 8);
+                p_ancs->current_attr_index  = 0;
+                if (p_ancs->evt.attr.attr_len != 0)
                 {
-                    m_parse_state = ATTR_DATA;
+                    p_ancs->parse_state = BLE_ANCS_C_PARSE_ATTR_DATA;
                 }
                 else
                 {
-                    evt.evt_type = BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE;
-                    p_ancs->evt_handler(&evt);
-                    m_parse_state = ATTR_ID;
+                    p_ancs->p_data_dest[0] = '\0';
+                    attr_evt_send(p_ancs, &p_ancs->evt, p_ancs->p_data_dest, 0);
+                    p_ancs->parse_state = BLE_ANCS_C_PARSE_ATTR_ID;
                 }
-                LOG("Attribute LEN %i \n\r", evt.attr.attr_len);
+                LOG("Attribute LEN %i \n\r", p_ancs->evt.attr.attr_len);
                 break;
 
-            case ATTR_DATA:
+            case BLE_ANCS_C_PARSE_ATTR_DATA:
                 // We have not reached the end of the attribute, nor our max allocated internal size.
                 // Proceed with copying data over to our buffer.
-                if (   (current_attr_index < m_ancs_attr_list[evt.attr.attr_id].attr_len)
-                    && (current_attr_index < evt.attr.attr_len))
+                if (   (p_ancs->current_attr_index < p_ancs->data_dest_len)
+                    && (p_ancs->current_attr_index < p_ancs->evt.attr.attr_len))
                 {
-                    p_data_dest[current_attr_index++] = p_data_src[index++];
+                    p_ancs->p_data_dest[p_ancs->current_attr_index++] = p_data_src[index++];
                 }
                 // We have reached the end of the attribute, or our max allocated internal size.
                 // Stop copying data over to our buffer. NUL-terminate at the current index.
-                if ( (current_attr_index == evt.attr.attr_len) ||
-                     (current_attr_index == m_ancs_attr_list[evt.attr.attr_id].attr_len))
+                if ( (p_ancs->current_attr_index == p_ancs->evt.attr.attr_len) ||
+                     (p_ancs->current_attr_index == p_ancs->data_dest_len))
                 {
-                    p_data_dest[current_attr_index] = '\0';
+                    p_ancs->p_data_dest[p_ancs->current_attr_index] = '\0';
                     
                     // If our max buffer size is smaller than the remaining attribute data, we must
                     // increase index to skip the data until the start of the next attribute.
-                    if (current_attr_index < evt.attr.attr_len)
+                    if (p_ancs->current_attr_index < p_ancs->evt.attr.attr_len)
                     {
-                        index += (evt.attr.attr_len - current_attr_index);
+                        index += (p_ancs->evt.attr.attr_len - p_ancs->current_attr_index);
                     }
-                    m_parse_state = ATTR_ID;
+                    p_ancs->parse_state = BLE_ANCS_C_PARSE_ATTR_ID;
                     LOG("Attribute finished!\n\r");
-                    evt.evt_type = BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE;
-                    p_ancs->evt_handler(&evt);
+                    attr_evt_send(p_ancs, &p_ancs->evt, p_ancs->p_data_dest, p_ancs->current_attr_index);
                 }
                 break;
 
-            case DONE:
+            case BLE_ANCS_C_PARSE_DONE:
                 index = hvx_data_len;
                 break;
 
             default:
                 // Default case will never trigger intentionally. Go to the DONE state to minimize the consequences.
-                m_parse_state = DONE;
+                p_ancs->parse_state = BLE_ANCS_C_PARSE_DONE;
                 break;
         }
     }
@@ -441,6 +519,8 @@ static void parse_notif(const ble_ancs_c_t * p_ancs,
                         const uint16_t       hvx_data_len)
 {
     uint32_t err_code;
+
+    m_ancs_evt.conn_handle = p_ancs->conn_handle;
     if (hvx_data_len != BLE_ANCS_NOTIFICATION_DATA_LENGTH)
     {
         m_ancs_evt.evt_type = BLE_ANCS_C_EVT_INVALID_NOTIF;
@@ -496,14 +576,14 @@ static void on_evt_gattc_notif(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_ev
 {
     const ble_gattc_evt_hvx_t * p_notif = &p_ble_evt->evt.gattc_evt.params.hvx;
 
-    if (p_notif->handle == m_service.notif_source.handle_value)
+    if (p_notif->handle == p_ancs->service.notif_source.handle_value)
     {
-        BLE_UUID_COPY_INST(m_ancs_evt.uuid, m_service.notif_source.uuid);
+        BLE_UUID_COPY_INST(m_ancs_evt.uuid, p_ancs->service.notif_source.uuid);
         parse_notif(p_ancs, &m_ancs_evt,p_notif->data,p_notif->len);
     }
-    else if (p_notif->handle == m_service.data_source.handle_value)
+    else if (p_notif->handle == p_ancs->service.data_source.handle_value)
     {
-        BLE_UUID_COPY_INST(m_ancs_evt.uuid, m_service.data_source.uuid);
+        BLE_UUID_COPY_INST(m_ancs_evt.uuid, p_ancs->service.data_source.uuid);
         parse_get_notif_attrs_response(p_ancs, p_notif->data, p_notif->len);
     }
     else
@@ -513,23 +593,38 @@ static void on_evt_gattc_notif(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_ev
 }
 
 /**@brief Function for handling write response events.
+ *
+ * @param[in] p_ancs    Pointer to an ANCS instance to which the event belongs.
+ * @param[in] p_ble_evt Bluetooth stack event.
  */
-static void on_evt_write_rsp()
+static void on_evt_write_rsp(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt)
 {
-    tx_buffer_process();
+    const ble_gattc_evt_t * p_gattc_evt = &p_ble_evt->evt.gattc_evt;
+
+    if ((p_gattc_evt->gatt_status != BLE_GATT_STATUS_SUCCESS) &&
+        (p_gattc_evt->params.write_rsp.write_op == BLE_GATT_OP_PREP_WRITE_REQ))
+    {
+        tx_buffer_prepared_flush(p_ancs);
+    }
+    tx_buffer_process(p_ancs);
 }
 
 
-void ble_ancs_c_on_device_manager_evt(ble_ancs_c_t      * p_ans,
-                                      dm_handle_t const * p_handle,
+void ble_ancs_c_on_device_manager_evt(dm_handle_t const * p_handle,
                                       dm_event_t const  * p_dm_evt)
 {
+    ble_ancs_c_t * p_ancs;
+
     switch (p_dm_evt->event_id)
     {
         case DM_EVT_CONNECTION:
             // Fall through.
         case DM_EVT_SECURITY_SETUP_COMPLETE:
-            p_ans->central_handle = p_handle->device_id;
+            p_ancs = instance_assign(p_dm_evt->event_param.p_gap_param->conn_handle);
+            if (p_ancs != NULL)
+            {
+                p_ancs->central_handle = p_handle->device_id;
+            }
             break;
 
         default:
@@ -539,18 +634,39 @@ void ble_ancs_c_on_device_manager_evt(ble_ancs_c_t      * p_ans,
 }
 
 
-void ble_ancs_c_on_ble_evt(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt)
+void ble_ancs_c_on_ble_evt(const ble_evt_t * p_ble_evt)
 {
-    uint16_t evt = p_ble_evt->header.evt_id;
+    uint16_t       evt = p_ble_evt->header.evt_id;
+    ble_ancs_c_t * p_ancs;
 
     switch (evt)
     {
+        case BLE_GAP_EVT_CONNECTED:
+            (void)instance_assign(p_ble_evt->evt.gap_evt.conn_handle);
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            p_ancs = ble_ancs_c_find(p_ble_evt->evt.gap_evt.conn_handle);
+            if (p_ancs != NULL)
+            {
+                instance_reset(p_ancs, BLE_CONN_HANDLE_INVALID);
+            }
+            break;
+
         case BLE_GATTC_EVT_WRITE_RSP:
-            on_evt_write_rsp();
+            p_ancs = ble_ancs_c_find(p_ble_evt->evt.gattc_evt.conn_handle);
+            if (p_ancs != NULL)
+            {
+                on_evt_write_rsp(p_ancs, p_ble_evt);
+            }
             break;
 
         case BLE_GATTC_EVT_HVX:
-            on_evt_gattc_notif(p_ancs, p_ble_evt);
+            p_ancs = ble_ancs_c_find(p_ble_evt->evt.gattc_evt.conn_handle);
+            if (p_ancs != NULL)
+            {
+                on_evt_gattc_notif(p_ancs, p_ble_evt);
+            }
             break;
 
         default:
@@ -559,29 +675,67 @@ void ble_ancs_c_on_ble_evt(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt)
 }
 
 
-uint32_t ble_ancs_c_init(ble_ancs_c_t * p_ancs, const ble_ancs_c_init_t * p_ancs_init)
+uint32_t ble_ancs_c_init(ble_ancs_c_t            * p_ancs,
+                         uint8_t                   link_count,
+                         const ble_ancs_c_init_t * p_ancs_init)
 {
+    uint32_t   err_code;
+    ble_uuid_t ancs_uuid;
+    uint32_t   i;
+
     if ((p_ancs == NULL) || p_ancs_init == NULL || (p_ancs_init->evt_handler == NULL))
     {
         return NRF_ERROR_NULL;
     }
 
-    mp_ble_ancs = p_ancs;
+    if ((link_count == 0) || (link_count > BLE_ANCS_C_MAX_LINKS))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
 
-    mp_ble_ancs->evt_handler    = p_ancs_init->evt_handler;
-    mp_ble_ancs->error_handler  = p_ancs_init->error_handler;
-    mp_ble_ancs->service_handle = BLE_GATT_HANDLE_INVALID;
-    mp_ble_ancs->central_handle = DM_INVALID_ID;
-    mp_ble_ancs->conn_handle    = BLE_CONN_HANDLE_INVALID;
+    mp_ble_ancs  = p_ancs;
+    m_link_count = link_count;
 
     memset(&m_service, 0, sizeof(ble_ancs_c_service_t));
-    memset(m_tx_buffer, 0, TX_BUFFER_SIZE);
 
     m_service.handle = BLE_GATT_HANDLE_INVALID;
 
-    ble_uuid_t ancs_uuid;
+    // Register the vendor specific UUID bases of the service and its characteristics, so the
+    // service does not have to be the first vendor specific UUID in the application.
     ancs_uuid.uuid = ANCS_UUID_SERVICE;
-    ancs_uuid.type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    err_code = sd_ble_uuid_vs_add(&ble_ancs_base_uuid128, &ancs_uuid.type);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    m_service.service.uuid = ancs_uuid;
+
+    err_code = sd_ble_uuid_vs_add(&ble_ancs_cp_base_uuid128, &m_service.control_point.uuid.type);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = sd_ble_uuid_vs_add(&ble_ancs_ns_base_uuid128, &m_service.notif_source.uuid.type);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = sd_ble_uuid_vs_add(&ble_ancs_ds_base_uuid128, &m_service.data_source.uuid.type);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // The instances take the UUIDs of the service along with the cleared link state.
+    for (i = 0; i < link_count; i++)
+    {
+        p_ancs[i].evt_handler    = p_ancs_init->evt_handler;
+        p_ancs[i].error_handler  = p_ancs_init->error_handler;
+        p_ancs[i].service_handle = BLE_GATT_HANDLE_INVALID;
+        instance_reset(&p_ancs[i], BLE_CONN_HANDLE_INVALID);
+    }
 
     return ble_db_discovery_evt_register(&ancs_uuid, db_discover_evt_handler);
 }
@@ -589,20 +743,26 @@ uint32_t ble_ancs_c_init(ble_ancs_c_t * p_ancs, const ble_ancs_c_init_t * p_ancs
 
 /**@brief Function for creating a TX message for writing a CCCD.
  *
- * @param[in] conn_handle  Connection handle on which to perform the configuration.
+ * @param[in] p_ancs       Pointer to the ANCS instance of the link to configure.
  * @param[in] handle_cccd  Handle of the CCCD.
  * @param[in] enable       Enable or disable GATTC notifications.
  *
  * @retval NRF_SUCCESS              If the message was created successfully.
  * @retval NRF_ERROR_INVALID_PARAM  If one of the input parameters was invalid.
+ * @retval NRF_ERROR_NO_MEM         If the transmit buffer is full.
  */
-static uint32_t cccd_configure(const uint16_t conn_handle, const uint16_t handle_cccd, bool enable)
+static uint32_t cccd_configure(ble_ancs_c_t * p_ancs, const uint16_t handle_cccd, bool enable)
 {
-    tx_message_t * p_msg;
-    uint16_t       cccd_val = enable ? BLE_CCCD_NOTIFY_BIT_MASK : 0;
+    ble_ancs_c_tx_message_t * p_msg;
+    uint16_t                  cccd_val = enable ? BLE_CCCD_NOTIFY_BIT_MASK : 0;
+
+    if (tx_buffer_free_get(p_ancs) == 0)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
 
-    p_msg              = &m_tx_buffer[m_tx_insert_index++];
-    m_tx_insert_index &= TX_BUFFER_MASK;
+    p_msg                    = &p_ancs->tx_buffer[p_ancs->tx_insert_index++];
+    p_ancs->tx_insert_index &= TX_BUFFER_MASK;
 
     p_msg->req.write_req.gattc_params.handle   = handle_cccd;
     p_msg->req.write_req.gattc_params.len      = 2;
@@ -611,53 +771,58 @@ static uint32_t cccd_configure(const uint16_t conn_handle, const uint16_t handle
     p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_WRITE_REQ;
     p_msg->req.write_req.gattc_value[0]        = LSB(cccd_val);
     p_msg->req.write_req.gattc_value[1]        = MSB(cccd_val);
-    p_msg->conn_handle                         = conn_handle;
-    p_msg->type                                = WRITE_REQ;
+    p_msg->conn_handle                         = p_ancs->conn_handle;
+    p_msg->type                                = BLE_ANCS_C_WRITE_REQ;
 
-    tx_buffer_process();
+    tx_buffer_process(p_ancs);
     return NRF_SUCCESS;
 }
 
 
-uint32_t ble_ancs_c_notif_source_notif_enable(const ble_ancs_c_t * p_ancs)
+uint32_t ble_ancs_c_notif_source_notif_enable(ble_ancs_c_t * p_ancs)
 {
     LOG("[ANCS]: Enable Notification Source notifications. writing to handle: %i \n\r",
-        m_service.notif_source.handle_cccd);
-    return cccd_configure(p_ancs->conn_handle, m_service.notif_source.handle_cccd, true);
+        p_ancs->service.notif_source.handle_cccd);
+    return cccd_configure(p_ancs, p_ancs->service.notif_source.handle_cccd, true);
 }
 
 
-uint32_t ble_ancs_c_notif_source_notif_disable(const ble_ancs_c_t * p_ancs)
+uint32_t ble_ancs_c_notif_source_notif_disable(ble_ancs_c_t * p_ancs)
 {
-    return cccd_configure(p_ancs->conn_handle, m_service.notif_source.handle_cccd, false);
+    return cccd_configure(p_ancs, p_ancs->service.notif_source.handle_cccd, false);
 }
 
 
-uint32_t ble_ancs_c_data_source_notif_enable(const ble_ancs_c_t * p_ancs)
+uint32_t ble_ancs_c_data_source_notif_enable(ble_ancs_c_t * p_ancs)
 {
     LOG("[ANCS]: Enable Data Source notifications. Writing to handle: %i \n\r",
-        m_service.data_source.handle_cccd);
-    return cccd_configure(p_ancs->conn_handle, m_service.data_source.handle_cccd, true);
+        p_ancs->service.data_source.handle_cccd);
+    return cccd_configure(p_ancs, p_ancs->service.data_source.handle_cccd, true);
 }
 
 
-uint32_t ble_ancs_c_data_source_notif_disable(const ble_ancs_c_t * p_ancs)
+uint32_t ble_ancs_c_data_source_notif_disable(ble_ancs_c_t * p_ancs)
 {
-    return cccd_configure(p_ancs->conn_handle, m_service.data_source.handle_cccd, false);
+    return cccd_configure(p_ancs, p_ancs->service.data_source.handle_cccd, false);
 }
 
 
-uint32_t ble_ancs_get_notif_attrs(const ble_ancs_c_t * p_ancs,
-                                  const uint32_t       p_uid)
+uint32_t ble_ancs_get_notif_attrs(ble_ancs_c_t * p_ancs,
+                                  const uint32_t p_uid)
 {
-    tx_message_t * p_msg;
-    uint32_t       index                    = 0;
-    uint32_t       number_of_requested_attr = 0;
+    ble_ancs_c_tx_message_t * p_msg;
+    uint32_t                  index                    = 0;
+    uint32_t                  number_of_requested_attr = 0;
 
-    p_msg              = &m_tx_buffer[m_tx_insert_index++];
-    m_tx_insert_index &= TX_BUFFER_MASK;
+    if (tx_buffer_free_get(p_ancs) == 0)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_msg                    = &p_ancs->tx_buffer[p_ancs->tx_insert_index++];
+    p_ancs->tx_insert_index &= TX_BUFFER_MASK;
 
-    p_msg->req.write_req.gattc_params.handle   = m_service.control_point.handle_value;
+    p_msg->req.write_req.gattc_params.handle   = p_ancs->service.control_point.handle_value;
     p_msg->req.write_req.gattc_params.p_value  = p_msg->req.write_req.gattc_value;
     p_msg->req.write_req.gattc_params.offset   = 0;
     p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_WRITE_REQ;
@@ -687,10 +852,10 @@ uint32_t ble_ancs_get_notif_attrs(const ble_ancs_c_t * p_ancs,
     }
     p_msg->req.write_req.gattc_params.len = index;
     p_msg->conn_handle                    = p_ancs->conn_handle;
-    p_msg->type                           = WRITE_REQ;
-    m_expected_number_of_attrs            = number_of_requested_attr;
+    p_msg->type                           = BLE_ANCS_C_WRITE_REQ;
+    p_ancs->expected_number_of_attrs      = number_of_requested_attr;
 
-    tx_buffer_process();
+    tx_buffer_process(p_ancs);
 
     return NRF_SUCCESS;
 }
@@ -717,7 +882,7 @@ uint32_t ble_ancs_c_attr_add(const ble_ancs_c_notif_attr_id_values_t id,
 }
 
 
-uint32_t ble_ancs_c_request_attrs(const ble_ancs_c_evt_notif_t * notif)
+uint32_t ble_ancs_c_request_attrs(ble_ancs_c_t * p_ancs, const ble_ancs_c_evt_notif_t * notif)
 {
     uint32_t err_code;
     err_code = ble_ancs_verify_notification_format(notif);
@@ -726,12 +891,109 @@ uint32_t ble_ancs_c_request_attrs(const ble_ancs_c_evt_notif_t * notif)
         return err_code;
     }
 
-    err_code      = ble_ancs_get_notif_attrs(mp_ble_ancs, notif->notif_uid);
-    m_parse_state = COMMAND_ID_AND_NOTIF_UID;
+    err_code = ble_ancs_get_notif_attrs(p_ancs, notif->notif_uid);
     if (err_code != NRF_SUCCESS)
     {
         return err_code;
     }
+    p_ancs->request_uid = notif->notif_uid;
+    p_ancs->parse_state = BLE_ANCS_C_PARSE_COMMAND_ID_AND_NOTIF_UID;
     return NRF_SUCCESS;
 }
 
+
+uint32_t ble_ancs_c_app_attr_request(ble_ancs_c_t  * p_ancs,
+                                     const uint8_t * p_app_id,
+                                     uint32_t        len,
+                                     uint8_t       * p_data,
+                                     uint16_t        data_len)
+{
+    uint8_t                   request[APP_ATTR_REQUEST_MAX_LENGTH];
+    uint32_t                  index = 0;
+    uint32_t                  offset;
+    uint32_t                  msg_count;
+    ble_ancs_c_tx_message_t * p_msg;
+
+    if ((p_ancs == NULL) || (p_app_id == NULL) || (p_data == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((len == 0) || (len > BLE_ANCS_ATTR_DATA_MAX) || (data_len == 0))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    //Encode Command ID.
+    request[index++] = BLE_ANCS_COMMAND_ID_GET_APP_ATTRIBUTES;
+
+    //Encode App Identifier, including the NUL terminator.
+    memcpy(&request[index], p_app_id, len);
+    index           += len;
+    request[index++] = '\0';
+
+    //Encode Attribute ID.
+    request[index++] = BLE_ANCS_APP_ATTR_ID_DISPLAY_NAME;
+
+    // One write, or the prepared writes and their execute write, all queued at once.
+    msg_count = (index <= WRITE_MESSAGE_LENGTH) ? 1 : (CEIL_DIV(index, PREPARED_WRITE_LENGTH) + 1);
+    if (tx_buffer_free_get(p_ancs) < msg_count)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_ancs->p_app_attr_data          = p_data;
+    p_ancs->app_attr_len             = data_len;
+    p_ancs->expected_number_of_attrs = 1;
+    p_ancs->parse_state              = BLE_ANCS_C_PARSE_COMMAND_ID_AND_NOTIF_UID;
+
+    if (index <= WRITE_MESSAGE_LENGTH)
+    {
+        p_msg                    = &p_ancs->tx_buffer[p_ancs->tx_insert_index++];
+        p_ancs->tx_insert_index &= TX_BUFFER_MASK;
+
+        memcpy(p_msg->req.write_req.gattc_value, request, index);
+        p_msg->req.write_req.gattc_params.handle   = p_ancs->service.control_point.handle_value;
+        p_msg->req.write_req.gattc_params.p_value  = p_msg->req.write_req.gattc_value;
+        p_msg->req.write_req.gattc_params.len      = index;
+        p_msg->req.write_req.gattc_params.offset   = 0;
+        p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_WRITE_REQ;
+        p_msg->conn_handle                         = p_ancs->conn_handle;
+        p_msg->type                                = BLE_ANCS_C_WRITE_REQ;
+
+        tx_buffer_process(p_ancs);
+        return NRF_SUCCESS;
+    }
+
+    // The request does not fit in one write; queue it as prepared writes followed by an execute.
+    for (offset = 0; offset < index; offset += PREPARED_WRITE_LENGTH)
+    {
+        uint32_t chunk = MIN(PREPARED_WRITE_LENGTH, index - offset);
+
+        p_msg                    = &p_ancs->tx_buffer[p_ancs->tx_insert_index++];
+        p_ancs->tx_insert_index &= TX_BUFFER_MASK;
+
+        memcpy(p_msg->req.write_req.gattc_value, &request[offset], chunk);
+        p_msg->req.write_req.gattc_params.handle   = p_ancs->service.control_point.handle_value;
+        p_msg->req.write_req.gattc_params.p_value  = p_msg->req.write_req.gattc_value;
+        p_msg->req.write_req.gattc_params.len      = chunk;
+        p_msg->req.write_req.gattc_params.offset   = offset;
+        p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_PREP_WRITE_REQ;
+        p_msg->conn_handle                         = p_ancs->conn_handle;
+        p_msg->type                                = BLE_ANCS_C_WRITE_REQ;
+    }
+
+    p_msg                    = &p_ancs->tx_buffer[p_ancs->tx_insert_index++];
+    p_ancs->tx_insert_index &= TX_BUFFER_MASK;
+
+    p_msg->req.write_req.gattc_params.handle   = p_ancs->service.control_point.handle_value;
+    p_msg->req.write_req.gattc_params.p_value  = NULL;
+    p_msg->req.write_req.gattc_params.len      = 0;
+    p_msg->req.write_req.gattc_params.offset   = 0;
+    p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_EXEC_WRITE_REQ;
+    p_msg->req.write_req.gattc_params.flags    = BLE_GATT_EXEC_WRITE_FLAG_PREPARED_WRITE;
+    p_msg->conn_handle                         = p_ancs->conn_handle;
+    p_msg->type                                = BLE_ANCS_C_WRITE_REQ;
+
+    tx_buffer_process(p_ancs);
+    return NRF_SUCCESS;
+}
@@ -50,6 +50,9 @@
 #define BLE_ANCS_NB_OF_CATEGORY_ID          12  /**< Number of iOS notification categories: Other, Incoming Call, Missed Call, Voice Mail, Social, Schedule, Email, News, Health And Fitness, Business And Finance, Location, Entertainment. */
 #define BLE_ANCS_NB_OF_ATTRS                8   /**< Number of iOS notification attributes: AppIdentifier, Title, Subtitle, Message, MessageSize, Date, PositiveActionLabel, NegativeActionLabel. */
 #define BLE_ANCS_NB_OF_EVT_ID               3   /**< Number of iOS notification events: Added, Modified, Removed.*/
+#define BLE_ANCS_C_MAX_LINKS                DEVICE_MANAGER_MAX_CONNECTIONS  /**< Maximum number of links served by the client, one instance each. */
+#define BLE_ANCS_C_TX_BUFFER_SIZE           8   /**< Number of requests queued per link. Must be a power of two. */
+#define BLE_ANCS_C_WRITE_MESSAGE_LENGTH     20  /**< Length of the write message for CCCD/control point. */
 
 /** @brief Length of the iOS notification data.
  *
@@ -79,7 +82,8 @@ typedef enum
     BLE_ANCS_C_EVT_DISCOVER_FAILED,            /**< It was not possible to discover the service or characteristics of the connected peer. */
     BLE_ANCS_C_EVT_NOTIF,                      /**< An iOS notification was received on the notification source control point. */
     BLE_ANCS_C_EVT_INVALID_NOTIF,              /**< An iOS notification was received on the notification source control point, but the format is invalid. */
-    BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE             /**< A received iOS notification attribute has been parsed. */
+    BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE,            /**< A received iOS notification attribute has been parsed. */
+    BLE_ANCS_C_EVT_APP_ATTRIBUTE               /**< A received iOS app attribute has been parsed. */
 } ble_ancs_c_evt_type_t;
 
 /**@brief Category IDs for iOS notifications. */
@@ -128,6 +132,12 @@ typedef enum
     BLE_ANCS_NOTIF_ATTR_ID_NEGATIVE_ACTION_LABEL,  /**< The notification has a "Negative action" that can be executed associated with it. */
 } ble_ancs_c_notif_attr_id_values_t;
 
+/**@brief IDs for iOS app attributes. */
+typedef enum
+{
+    BLE_ANCS_APP_ATTR_ID_DISPLAY_NAME              /**< Identifies that the attribute data is the "Display Name" of the app. */
+} ble_ancs_c_app_attr_id_values_t;
+
 
 /**@brief Flags for iOS notifications. */
 typedef struct
@@ -159,6 +169,15 @@ typedef struct
 } ble_ancs_c_evt_notif_attr_t;
 
 
+/**@brief iOS app attribute structure for incoming attributes. */
+typedef struct
+{
+    uint16_t                          attr_len;     /**< Length of the received attribute data, after truncation to the buffer size. */
+    ble_ancs_c_app_attr_id_values_t   attr_id;      /**< Classification of the attribute type. */
+    uint8_t                         * p_attr_data;  /**< NUL-terminated attribute data. */
+} ble_ancs_c_evt_app_attr_t;
+
+
 /**@brief iOS notification attribute content wanted by our application. */
 typedef struct
 {
@@ -176,9 +195,11 @@ typedef struct
 typedef struct
 {
     ble_ancs_c_evt_type_t       evt_type;        /**< Type of event. */
+    uint16_t                    conn_handle;     /**< Connection handle of the link the event belongs to. */
     ble_uuid_t                  uuid;            /**< UUID of the event if it is an iOS notification. */
     ble_ancs_c_evt_notif_t      notif;           /**< iOS notification. */
     ble_ancs_c_evt_notif_attr_t attr;            /**< Currently received attribute for a given notification. */
+    ble_ancs_c_evt_app_attr_t   app_attr;        /**< Currently received attribute for a given app. */
     uint32_t                    error_code;      /**< Additional status or error code if the event was caused by a stack error or GATT status, for example, during service discovery. */
     ble_ancs_c_attr_list_t    * ancs_attr_list;  /**< List of attributes that will be requested if attributes are requested for a notification.*/
 } ble_ancs_c_evt_t;
@@ -188,14 +209,102 @@ typedef struct
 typedef void (*ble_ancs_c_evt_handler_t) (ble_ancs_c_evt_t * p_evt);
 
 
-/**@brief iOS notification structure, which contains various status information for the client. */
+/**@brief Structure used for holding the characteristic found during the discovery process.
+ */
+typedef struct
+{
+    ble_uuid_t            uuid;          /**< UUID identifying the characteristic. */
+    ble_gatt_char_props_t properties;    /**< Properties for the characteristic. */
+    uint16_t              handle_decl;   /**< Characteristic Declaration Handle for the characteristic. */
+    uint16_t              handle_value;  /**< Value Handle for the value provided in the characteristic. */
+    uint16_t              handle_cccd;   /**< CCCD Handle value for the characteristic. */
+} ble_ancs_c_characteristic_t;
+
+
+/**@brief Structure used for holding the Apple Notification Center Service found during the discovery process.
+ */
+typedef struct
+{
+    uint8_t                     handle;         /**< Handle of Apple Notification Center Service, which identifies to which peer this discovered service belongs. */
+    ble_gattc_service_t         service;        /**< The GATT Service holding the discovered Apple Notification Center Service. */
+    ble_ancs_c_characteristic_t control_point;  /**< Control Point Characteristic for the service. Allows interaction with the peer. */
+    ble_ancs_c_characteristic_t notif_source;   /**< Characteristic that keeps track of arrival, modification, and removal of notifications. */
+    ble_ancs_c_characteristic_t data_source;    /**< Characteristic where attribute data for the notifications is received from peer. */
+} ble_ancs_c_service_t;
+
+
+/**@brief ANCS request types.
+ */
+typedef enum
+{
+    BLE_ANCS_C_READ_REQ = 1,  /**< Type identifying that this tx_message is a read request. */
+    BLE_ANCS_C_WRITE_REQ      /**< Type identifying that this tx_message is a write request. */
+} ble_ancs_c_tx_request_t;
+
+
+/**@brief Structure for writing a message to the central, i.e. Control Point or CCCD.
+ */
+typedef struct
+{
+    uint8_t                  gattc_value[BLE_ANCS_C_WRITE_MESSAGE_LENGTH]; /**< The message to write. */
+    ble_gattc_write_params_t gattc_params;                                 /**< GATTC parameters for this message. */
+} ble_ancs_c_write_params_t;
+
+
+/**@brief Structure for holding data to be transmitted to the connected master.
+ */
+typedef struct
+{
+    uint16_t                conn_handle;  /**< Connection handle to be used when transmitting this message. */
+    ble_ancs_c_tx_request_t type;         /**< Type of this message, i.e. read or write message. */
+    union
+    {
+        uint16_t                  read_handle; /**< Read request message. */
+        ble_ancs_c_write_params_t write_req;   /**< Write request message. */
+    } req;
+} ble_ancs_c_tx_message_t;
+
+
+/**@brief Parsing states for received iOS notification attributes.
+ */
+typedef enum
+{
+    BLE_ANCS_C_PARSE_COMMAND_ID_AND_NOTIF_UID,  /**< Parsing the command ID and the notification UID. */
+    BLE_ANCS_C_PARSE_APP_ID,                    /**< Parsing the NUL-terminated app identifier of an app attribute response. */
+    BLE_ANCS_C_PARSE_ATTR_ID,                   /**< Parsing attribute ID. */
+    BLE_ANCS_C_PARSE_ATTR_LEN1,                 /**< Parsing the LSB of the attribute length. */
+    BLE_ANCS_C_PARSE_ATTR_LEN2,                 /**< Parsing the MSB of the attribute length. */
+    BLE_ANCS_C_PARSE_ATTR_DATA,                 /**< Parsing the attribute data. */
+    BLE_ANCS_C_PARSE_DONE                       /**< Parsing is done. */
+} ble_ancs_c_parse_state_t;
+
+
+/**@brief iOS notification structure, which contains various status information for the client.
+ *
+ * @details One instance serves one link: it holds the service handles found at the peer, the
+ *          requests waiting for the GATT client of the link and the state of the attribute parser.
+ */
 typedef struct
 {
-    ble_ancs_c_evt_handler_t evt_handler;     /**< Event handler to be called for handling events in the Apple Notification client application. */
-    ble_srv_error_handler_t  error_handler;   /**< Function to be called in case of an error. */
-    uint16_t                 conn_handle;     /**< Handle of the current connection (as provided by the BLE stack; BLE_CONN_HANDLE_INVALID if not in a connection). */
-    uint8_t                  central_handle;  /**< Handle of the currently connected peer (if we have a bond in the Device Manager). */
-    uint8_t                  service_handle;  /**< Handle of the service in the database to use for this instance. */
+    ble_ancs_c_evt_handler_t  evt_handler;               /**< Event handler to be called for handling events in the Apple Notification client application. */
+    ble_srv_error_handler_t   error_handler;             /**< Function to be called in case of an error. */
+    uint16_t                  conn_handle;               /**< Handle of the current connection (as provided by the BLE stack; BLE_CONN_HANDLE_INVALID if not in a connection). */
+    uint8_t                   central_handle;            /**< Handle of the currently connected peer (if we have a bond in the Device Manager). */
+    uint8_t                   service_handle;            /**< Handle of the service in the database to use for this instance. */
+    ble_ancs_c_service_t      service;                   /**< Service found at the peer of this link. */
+    ble_ancs_c_tx_message_t   tx_buffer[BLE_ANCS_C_TX_BUFFER_SIZE]; /**< Transmit buffer for messages to be transmitted to the Notification Provider. */
+    uint32_t                  tx_insert_index;           /**< Current index in the transmit buffer where the next message should be inserted. */
+    uint32_t                  tx_index;                  /**< Current index in the transmit buffer from where the next message to be transmitted resides. */
+    ble_ancs_c_parse_state_t  parse_state;               /**< ANCS notification attribute parsing state. */
+    bool                      parse_app_attrs;           /**< Whether the response being parsed is an app attribute response. */
+    uint32_t                  expected_number_of_attrs;  /**< Variable to keep track of when to stop reading incoming attributes. */
+    uint32_t                  request_uid;               /**< UID of the iOS notification whose attributes were last requested. */
+    uint8_t                 * p_app_attr_data;           /**< Buffer for the requested app attribute. */
+    uint16_t                  app_attr_len;              /**< Maximum length of the requested app attribute. */
+    uint8_t                 * p_data_dest;               /**< Buffer of the attribute being parsed. */
+    uint16_t                  data_dest_len;             /**< Size of p_data_dest, excluding the NUL terminator. */
+    uint16_t                  current_attr_index;        /**< Number of bytes of the attribute being parsed stored in p_data_dest. */
+    ble_ancs_c_evt_t          evt;                       /**< Attribute event being built by the parser. */
 } ble_ancs_c_t;
 
 
@@ -217,12 +326,22 @@ extern const ble_uuid128_t ble_ancs_ds_base_uuid128;  /**< Data source UUID. */
 
 /**@brief Function for handling the application's BLE Stack events.
  *
- * @details Handles all events from the BLE stack that are of interest to the ANCS client.
+ * @details Handles all events from the BLE stack that are of interest to the ANCS client. An
+ *          instance is assigned to a link on connection and freed on disconnection; other events
+ *          are forwarded to the instance of the link they relate to.
  *
- * @param[in] p_ancs     ANCS client structure.
  * @param[in] p_ble_evt  Event received from the BLE stack.
  */
-void ble_ancs_c_on_ble_evt(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt);
+void ble_ancs_c_on_ble_evt(const ble_evt_t * p_ble_evt);
+
+
+/**@brief Function for finding the client instance of a connection.
+ *
+ * @param[in] conn_handle  Connection handle of the link.
+ *
+ * @return Client instance, or NULL if no instance is assigned to the connection.
+ */
+ble_ancs_c_t * ble_ancs_c_find(uint16_t conn_handle);
 
 
 /**@brief Function for handling the ANCS client Device Manager events.
@@ -232,25 +351,30 @@ void ble_ancs_c_on_ble_evt(ble_ancs_c_t * p_ancs, const ble_evt_t * p_ble_evt);
  *          handling service discovery and writing to the Apple Notification Control Point, the
  *          Notification Provider will send new and unread iOS notifications again.
  *
- * @param[in] p_ancs    ANCS client structure.
+ *          The Device Manager reports a connection before the client sees it, so the instance
+ *          of the link may be assigned here.
+ *
  * @param[in] p_handle  Pointer to the ANCS device handle.
  * @param[in] p_dm_evt  Event received from the Device Manager.
  */
-void ble_ancs_c_on_device_manager_evt(ble_ancs_c_t      * p_ancs,
-                                      dm_handle_t const * p_handle,
+void ble_ancs_c_on_device_manager_evt(dm_handle_t const * p_handle,
                                       dm_event_t const  * p_dm_evt);
 
 
 /**@brief Function for initializing the ANCS client.
  *
- * @param[out] p_ancs       ANCS client structure. This structure must be
- *                          supplied by the application. It is initialized by this function
- *                          and will later be used to identify this particular client instance.
+ * @details One client instance is used per connection. The attributes registered with
+ *          ble_ancs_c_attr_add() are shared by all instances.
+ *
+ * @param[out] p_ancs       Array of client instances. The memory is provided by the application.
+ * @param[in]  link_count   Number of instances in the array, at most BLE_ANCS_C_MAX_LINKS.
  * @param[in]  p_ancs_init  Information needed to initialize the client.
  *
  * @retval NRF_SUCCESS  If the client was initialized successfully. Otherwise, an error code is returned.
  */
-uint32_t ble_ancs_c_init(ble_ancs_c_t * p_ancs, const ble_ancs_c_init_t * p_ancs_init);
+uint32_t ble_ancs_c_init(ble_ancs_c_t            * p_ancs,
+                         uint8_t                   link_count,
+                         const ble_ancs_c_init_t * p_ancs_init);
 
 
 /**@brief Function for writing to the CCCD to enable notifications from the Apple Notification Service.
@@ -260,7 +384,7 @@ uint32_t ble_ancs_c_init(ble_ancs_c_t * p_ancs, const ble_ancs_c_init_t * p_ancs
  *
  * @retval NRF_SUCCESS If writing to the CCCD was successful. Otherwise, an error code is returned.
  */
-uint32_t ble_ancs_c_notif_source_notif_enable(const ble_ancs_c_t * p_ancs);
+uint32_t ble_ancs_c_notif_source_notif_enable(ble_ancs_c_t * p_ancs);
 
 
 /**@brief Function for writing to the CCCD to enable data source notifications from the ANCS.
@@ -270,7 +394,7 @@ uint32_t ble_ancs_c_notif_source_notif_enable(const ble_ancs_c_t * p_ancs);
  *
  * @retval NRF_SUCCESS If writing to the CCCD was successful. Otherwise, an error code is returned.
  */
-uint32_t ble_ancs_c_data_source_notif_enable(const ble_ancs_c_t * p_ancs);
+uint32_t ble_ancs_c_data_source_notif_enable(ble_ancs_c_t * p_ancs);
 
 
 /**@brief Function for writing to the CCCD to disable notifications from the ANCS.
@@ -280,7 +404,7 @@ uint32_t ble_ancs_c_data_source_notif_enable(const ble_ancs_c_t * p_ancs);
  *
  * @retval NRF_SUCCESS If writing to the CCCD was successful. Otherwise, an error code is returned.
  */
-uint32_t ble_ancs_c_notif_source_notif_disable(const ble_ancs_c_t * p_ancs);
+uint32_t ble_ancs_c_notif_source_notif_disable(ble_ancs_c_t * p_ancs);
 
 
 /**@brief Function for writing to the CCCD to disable data source notifications from the ANCS.
@@ -290,7 +414,7 @@ uint32_t ble_ancs_c_notif_source_notif_disable(const ble_ancs_c_t * p_ancs);
  *
  * @retval NRF_SUCCESS If writing to the CCCD was successful. Otherwise, an error code is returned.
  */
-uint32_t ble_ancs_c_data_source_notif_disable(const ble_ancs_c_t * p_ancs);
+uint32_t ble_ancs_c_data_source_notif_disable(ble_ancs_c_t * p_ancs);
 
 
 /**@brief Function for registering attributes that will be requested if ble_ancs_c_request_attrs
@@ -307,12 +431,41 @@ uint32_t ble_ancs_c_attr_add(const ble_ancs_c_notif_attr_id_values_t id, uint8_t
 
 /**@brief Function for requesting attributes for a notification.
  *
+ * @details Only attributes of this notification are reported until the next request; responses
+ *          for other notification UIDs are ignored. The attributes are stored in the buffers
+ *          registered with ble_ancs_c_attr_add(), which all links share: only one request may be
+ *          in progress at a time across the links.
+ *
+ * @param[in] p_ancs   Client instance of the link of the notification.
  * @param[in] p_notif  Pointer to the notification whose attributes will be requested from
  *                     the Notification Provider.
  *
- * @retval NRF_SUCCESS If all operations were successful. Otherwise, an error code is returned.
+ * @retval NRF_SUCCESS      If all operations were successful.
+ * @retval NRF_ERROR_NO_MEM If the transmit buffer is full. Otherwise, an error code is returned.
+ */
+uint32_t ble_ancs_c_request_attrs(ble_ancs_c_t * p_ancs, const ble_ancs_c_evt_notif_t * p_notif);
+
+
+/**@brief Function for requesting the display name of an iOS app.
+ *
+ * @details The request is sent with prepared writes when it does not fit in a single write. The
+ *          name is reported with a @ref BLE_ANCS_C_EVT_APP_ATTRIBUTE event.
+ *
+ * @param[in] p_ancs    Client instance of the link to request the name from.
+ * @param[in] p_app_id  App identifier, as received in the AppIdentifier notification attribute.
+ * @param[in] len       Length of the app identifier, excluding the NUL terminator.
+ * @param[in] p_data    Buffer where the display name will be stored. Must hold data_len + 1 bytes.
+ * @param[in] data_len  Maximum length of the display name. Longer names are truncated.
+ *
+ * @retval NRF_SUCCESS      If all operations were successful.
+ * @retval NRF_ERROR_NO_MEM If the transmit buffer cannot take all the writes of the request.
+ *                          Otherwise, an error code is returned.
  */
-uint32_t ble_ancs_c_request_attrs(const ble_ancs_c_evt_notif_t * p_notif);
+uint32_t ble_ancs_c_app_attr_request(ble_ancs_c_t  * p_ancs,
+                                     const uint8_t * p_app_id,
+                                     uint32_t        len,
+                                     uint8_t       * p_data,
+                                     uint16_t        data_len);
 
 #endif // BLE_ANCS_C_H__
 
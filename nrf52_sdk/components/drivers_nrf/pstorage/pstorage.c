@@ -37,6 +37,10 @@
 #define MASK_MODULE_INITIALIZED    (1 << 2)                            /**< Flag for checking if the module has been initialized. */
 #define MASK_FLASH_API_ERR_BUSY    (1 << 3)                            /**< Flag for checking if flash API returned NRF_ERROR_BUSY. */
 
+#ifndef PSTORAGE_COALESCE_SIZE
+#define PSTORAGE_COALESCE_SIZE     256                                 /**< Size of the buffer for merging queued stores into one flash write. 0 disables merging. */
+#endif
+
 /**
  * @defgroup api_param_check API Parameters check macros.
  *
@@ -86,7 +90,7 @@
  */
 #define BLOCK_COUNT_CHECK(COUNT, SIZE)                                                            \
         if (((COUNT) == 0) ||                                                                     \
-            ((m_next_page_addr + ((COUNT) *(SIZE)) > PSTORAGE_SWAP_ADDR)))                        \
+            (((COUNT) * (SIZE)) > (m_next_page_addr - PSTORAGE_DATA_START_ADDR)))                 \
         {                                                                                         \
             return NRF_ERROR_INVALID_PARAM;                                                       \
         }        
@@ -198,6 +202,7 @@ typedef struct
     pstorage_size_t   offset;                                          /**< Offset requested by the application for the access operation. */
     pstorage_handle_t storage_addr;                                    /**< Address/Identifier for persistent memory. */
     uint8_t *         p_data_addr;                                     /**< Address/Identifier for data memory. This is assumed to be resident memory. */
+    bool              superseded;                                      /**< A later update or clear covers the area of this command, so it completes without flash access. */
 } cmd_queue_element_t;
 
 
@@ -218,7 +223,7 @@ typedef struct
 
 static cmd_queue_t             m_cmd_queue;                            /**< Flash operation request queue. */
 static pstorage_size_t         m_next_app_instance;                    /**< Points to the application module instance that can be allocated next. */
-static uint32_t                m_next_page_addr;                       /**< Points to the flash address that can be allocated to a module next. This is needed as blocks of a module that can span across flash pages. */
+static uint32_t                m_next_page_addr;                       /**< End of the flash that can be allocated to a module next; areas are allocated down from the swap page. */
 static pstorage_state_t        m_state;                                /**< Main state tracking variable. */
 static flash_swap_sub_state_t  m_swap_sub_state;                       /**< Flash swap erase when swap used state tracking variable. */
 static uint32_t                m_head_word_size;                       /**< Head restore area size in words. */
@@ -229,6 +234,13 @@ static pstorage_module_table_t m_app_table[PSTORAGE_NUM_OF_PAGES];     /**< Regi
 static uint32_t                m_num_of_bytes_written;                 /**< Variable for tracking the number of bytes written by the store operation. */
 static uint32_t                m_app_data_size;                        /**< Variable for storing the application command size parameter internally. */
 static uint32_t                m_flags = 0;                            /**< Storage for boolean flags for state tracking. */
+static pstorage_stats_t        m_stats;                                /**< Command and flash operation counters. */
+static uint32_t                m_merge_count;                          /**< Number of queued stores after the one in progress that are written by the same flash operation. */
+#if PSTORAGE_COALESCE_SIZE
+static uint32_t                m_merge_addr;                           /**< Flash address of the merged write. */
+static uint32_t                m_merge_words;                          /**< Size of the merged write in words. */
+static uint32_t                m_merge_buf[PSTORAGE_COALESCE_SIZE / sizeof(uint32_t)]; /**< Data of the merged write. */
+#endif
 
 #ifdef PSTORAGE_RAW_MODE_ENABLE
 static pstorage_raw_module_table_t m_raw_app_table;                    /**< Registered application information table for raw mode. */
@@ -238,6 +250,7 @@ static pstorage_raw_module_table_t m_raw_app_table;                    /**< Regi
 static void cmd_process(void);
 static void store_operation_execute(void);
 static void app_notify(uint32_t result, cmd_queue_element_t * p_elem);
+static cmd_queue_element_t * cmd_queue_element_get(uint32_t position);
 static void cmd_queue_element_init(uint32_t index);
 static void cmd_queue_dequeue(void);
 static void sm_state_change(pstorage_state_t new_state);
@@ -273,6 +286,16 @@ static void command_end_procedure_run(void)
     
     command_queue_element_consume();
     
+    // Stores merged into the same flash write complete with it, in queue order.
+    while (m_merge_count != 0)
+    {
+        --m_merge_count;
+        ++m_stats.merged;
+        m_app_data_size = m_cmd_queue.cmd[m_cmd_queue.rp].size;
+        app_notify(NRF_SUCCESS, &m_cmd_queue.cmd[m_cmd_queue.rp]);
+        command_queue_element_consume();
+    }
+    
     sm_state_change(STATE_IDLE);
 }
 
@@ -295,11 +318,23 @@ static void state_idle_entry_run(void)
 /**@brief Function for notifying an application of command completion and transitioning to an error 
  *        state.
  *
+ * @details Stores merged into the failed flash write fail with it, in queue order.
+ *
  * @param[in] result Result code of the operation for the application.
  */
 static void app_notify_error_state_transit(uint32_t result)
 {
     app_notify(result, &m_cmd_queue.cmd[m_cmd_queue.rp]);
+    
+    for (uint32_t position = 1; position <= m_merge_count; position++)
+    {
+        cmd_queue_element_t * p_elem = cmd_queue_element_get(position);
+        
+        m_app_data_size = p_elem->size;
+        app_notify(result, p_elem);
+    }
+    m_merge_count = 0;
+    
     sm_state_change(STATE_ERROR);                
 }
 
@@ -338,7 +373,17 @@ static void flash_write(uint32_t * const       p_dst,
                         uint32_t const * const p_src, 
                         uint32_t               size_in_words)
 {
-    flash_api_err_code_process(sd_flash_write(p_dst, p_src, size_in_words));    
+    const uint32_t err_code = sd_flash_write(p_dst, p_src, size_in_words);
+    
+    if (err_code == NRF_SUCCESS)
+    {
+        ++m_stats.flash_writes;
+    }
+    else if (err_code == NRF_ERROR_BUSY)
+    {
+        ++m_stats.busy_retries;
+    }
+    flash_api_err_code_process(err_code);    
 }
 
 
@@ -352,6 +397,15 @@ static void store_cmd_flash_write_execute(void)
 {
     const cmd_queue_element_t * p_cmd = &m_cmd_queue.cmd[m_cmd_queue.rp];
     
+#if PSTORAGE_COALESCE_SIZE
+    if (m_merge_count != 0)
+    {
+        flash_write((uint32_t *)m_merge_addr, m_merge_buf, m_merge_words);
+
+        m_num_of_bytes_written = p_cmd->size;
+    }
+    else
+#endif
     if (p_cmd->size > SOC_MAX_WRITE_SIZE)    
     {
         const uint32_t offset = p_cmd->size - PSTORAGE_FLASH_PAGE_SIZE;
@@ -372,12 +426,106 @@ static void store_cmd_flash_write_execute(void)
 }
 
 
+/**@brief Function for getting a command queue element by its position in the queue.
+ *
+ * @param[in] position Position counted from the read pointer.
+ */
+static cmd_queue_element_t * cmd_queue_element_get(uint32_t position)
+{
+    uint32_t index = m_cmd_queue.rp + position;
+    
+    if (index >= PSTORAGE_CMD_QUEUE_SIZE)
+    {
+        index -= PSTORAGE_CMD_QUEUE_SIZE;
+    }
+    
+    return &m_cmd_queue.cmd[index];
+}
+
+
+#if PSTORAGE_COALESCE_SIZE
+/**@brief Function for merging the store in progress with the stores queued after it.
+ *
+ * @details Stores that directly follow in the queue and whose areas overlap or adjoin the merged 
+ *          area are written by one flash operation, as long as the area stays within one flash 
+ *          page and fits the merge buffer. Flash bits can only be cleared, so the merged data is 
+ *          the AND of the overlapping stores, which is what writing them one by one leaves in 
+ *          flash.
+ */
+static void store_cmd_merge(void)
+{
+    const cmd_queue_element_t * p_cmd = &m_cmd_queue.cmd[m_cmd_queue.rp];
+    uint32_t                    start = p_cmd->storage_addr.block_id + p_cmd->offset;
+    uint32_t                    end   = start + p_cmd->size;
+    uint32_t                    count = 0;
+    
+    m_merge_count = 0;
+    
+    if (p_cmd->size > PSTORAGE_COALESCE_SIZE)
+    {
+        return;
+    }
+    
+    for (uint32_t position = 1; position < m_cmd_queue.count; ++position)
+    {
+        const cmd_queue_element_t * p_next  = cmd_queue_element_get(position);
+        const uint32_t              n_start = p_next->storage_addr.block_id + p_next->offset;
+        const uint32_t              n_end   = n_start + p_next->size;
+        const uint32_t              m_start = MIN(start, n_start);
+        const uint32_t              m_end   = MAX(end, n_end);
+        
+        if ((p_next->op_code != PSTORAGE_STORE_OP_CODE) || p_next->superseded ||
+            (n_start > end) || (n_end < start) ||
+            (m_start / PSTORAGE_FLASH_PAGE_SIZE != (m_end - 1) / PSTORAGE_FLASH_PAGE_SIZE) ||
+            (m_end - m_start > PSTORAGE_COALESCE_SIZE))
+        {
+            break;
+        }
+        
+        start = m_start;
+        end   = m_end;
+        count = position;
+    }
+    
+    if (count == 0)
+    {
+        return;
+    }
+    
+    memset(m_merge_buf, 0xFF, end - start);
+    for (uint32_t position = 0; position <= count; ++position)
+    {
+        const cmd_queue_element_t * p_elem  = cmd_queue_element_get(position);
+        uint8_t *                   p_dst   = (uint8_t *)m_merge_buf + 
+                                              (p_elem->storage_addr.block_id + p_elem->offset - start);
+        
+        for (uint32_t i = 0; i < p_elem->size; ++i)
+        {
+            p_dst[i] &= p_elem->p_data_addr[i];
+        }
+    }
+    
+    m_merge_addr  = start;
+    m_merge_words = (end - start) / sizeof(uint32_t);
+    m_merge_count = count;
+}
+#endif // PSTORAGE_COALESCE_SIZE
+
+
 /**@brief Function for store state entry action.
  *
  * @details Function for store state entry action, which includes writing data to a flash page.
  */
 static void state_store_entry_run(void)
 {
+#if PSTORAGE_COALESCE_SIZE
+    // Only merge before the first write of a command; a command larger than a flash page is 
+    // written in parts and never merged.
+    if (m_num_of_bytes_written == 0)
+    {
+        store_cmd_merge();
+    }
+#endif
     store_cmd_flash_write_execute();    
 }
 
@@ -434,7 +582,17 @@ static void state_data_erase_swap_entry_run(void)
  */
 static void flash_page_erase(uint32_t page_number)
 {
-    flash_api_err_code_process(sd_flash_page_erase(page_number));
+    const uint32_t err_code = sd_flash_page_erase(page_number);
+    
+    if (err_code == NRF_SUCCESS)
+    {
+        ++m_stats.flash_erases;
+    }
+    else if (err_code == NRF_ERROR_BUSY)
+    {
+        ++m_stats.busy_retries;
+    }
+    flash_api_err_code_process(err_code);
 }
 
 
@@ -599,6 +757,7 @@ static void cmd_queue_element_init(uint32_t index)
     m_cmd_queue.cmd[index].storage_addr.block_id  = 0;
     m_cmd_queue.cmd[index].p_data_addr            = NULL;
     m_cmd_queue.cmd[index].offset                 = 0;
+    m_cmd_queue.cmd[index].superseded             = false;
 }
 
 
@@ -616,6 +775,35 @@ static void cmd_queue_init(void)
 }
 
 
+/**@brief Function for marking the queued commands that a new update or clear makes redundant.
+ *
+ * @details A command whose area lies within the area the new command erases and rewrites has no 
+ *          effect on the final flash content. It stays in the queue, so completion events keep 
+ *          their order, but completes without flash access. The command in progress, and stores 
+ *          merged with it, are left alone.
+ *
+ * @param[in] start Flash address of the area of the new command.
+ * @param[in] size  Size of the area in bytes.
+ */
+static void cmd_queue_supersede(uint32_t start, uint32_t size)
+{
+    const uint32_t end      = start + size;
+    uint32_t       position = (m_state == STATE_IDLE) ? 0 : (1 + m_merge_count);
+
+    for (; position < m_cmd_queue.count; ++position)
+    {
+        cmd_queue_element_t * p_elem   = cmd_queue_element_get(position);
+        const uint32_t        e_start  = p_elem->storage_addr.block_id + p_elem->offset;
+        const uint32_t        e_end    = e_start + p_elem->size;
+
+        if ((e_start >= start) && (e_end <= end))
+        {
+            p_elem->superseded = true;
+        }
+    }
+}
+
+
 /**@brief Function for enqueuing, and possibly dispatching, a flash access operation.
  *
  * @param[in] opcode         Identifies the operation requested to be enqueued.
@@ -651,8 +839,16 @@ static uint32_t cmd_queue_enqueue(uint8_t             opcode,
         m_cmd_queue.cmd[write_index].storage_addr = (*p_storage_addr);
         m_cmd_queue.cmd[write_index].size         = size;
         m_cmd_queue.cmd[write_index].offset       = offset;
+        m_cmd_queue.cmd[write_index].superseded   = false;
                
+        if ((opcode == PSTORAGE_UPDATE_OP_CODE) || (opcode == PSTORAGE_CLEAR_OP_CODE))
+        {
+            cmd_queue_supersede(p_storage_addr->block_id + offset, size);
+        }
+        
         m_cmd_queue.count++;
+        ++m_stats.commands;
+        m_stats.queue_hwm = MAX(m_stats.queue_hwm, m_cmd_queue.count);
                                 
         if (m_state == STATE_IDLE)
         {
@@ -1117,6 +1313,11 @@ void pstorage_sys_event_handler(uint32_t sys_evt)
 {  
     if (m_state != STATE_IDLE && m_state != STATE_ERROR)
     {        
+        if ((sys_evt == NRF_EVT_FLASH_OPERATION_ERROR) && !(m_flags & MASK_FLASH_API_ERR_BUSY))
+        {
+            ++m_stats.flash_errors;
+        }
+        
         switch (sys_evt)
         {
             case NRF_EVT_FLASH_OPERATION_SUCCESS:
@@ -1254,6 +1455,27 @@ static void update_operation_execute(void)
 }
 
 
+/**@brief Function for completing a superseded command without flash access.
+ *
+ * @details The element is consumed before the application is notified, so a command the 
+ *          application enqueues from the callback is dispatched after it.
+ */
+static void superseded_cmd_complete(void)
+{
+    cmd_queue_element_t elem = m_cmd_queue.cmd[m_cmd_queue.rp];
+
+    ++m_stats.superseded;
+    command_queue_element_consume();
+
+    app_notify(NRF_SUCCESS, &elem);
+
+    if (m_state == STATE_IDLE)
+    {
+        cmd_queue_dequeue();
+    }
+}
+
+
 /**@brief Function for dispatching the flash access operation.
  */  
 static void cmd_process(void)
@@ -1261,6 +1483,12 @@ static void cmd_process(void)
     const cmd_queue_element_t * p_cmd = &m_cmd_queue.cmd[m_cmd_queue.rp];
     m_app_data_size                   = p_cmd->size;
 
+    if (p_cmd->superseded)
+    {
+        superseded_cmd_complete();
+        return;
+    }
+
     switch (p_cmd->op_code)
     {
         case PSTORAGE_STORE_OP_CODE:                   
@@ -1287,7 +1515,7 @@ uint32_t pstorage_init(void)
     cmd_queue_init();
 
     m_next_app_instance = 0;
-    m_next_page_addr    = PSTORAGE_DATA_START_ADDR;
+    m_next_page_addr    = PSTORAGE_DATA_END_ADDR;
     m_current_page_id   = 0;
     
     for (uint32_t index = 0; index < PSTORAGE_NUM_OF_PAGES; index++)
@@ -1305,7 +1533,10 @@ uint32_t pstorage_init(void)
     m_num_of_command_retries    = 0;
     m_flags                     = 0;
     m_num_of_bytes_written      = 0;
+    m_merge_count               = 0;
     m_flags                    |= MASK_MODULE_INITIALIZED;
+
+    memset(&m_stats, 0, sizeof(m_stats));
        
     return NRF_SUCCESS;
 }
@@ -1331,6 +1562,22 @@ uint32_t pstorage_register(pstorage_module_param_t * p_module_param,
         return NRF_ERROR_NO_MEM;
     }
 
+    // Calculate number of flash pages allocated for the device. Areas are allocated down from the 
+    // swap page, so that a module registered after the others does not move their data.
+    uint32_t page_count = CEIL_DIV((p_module_param->block_size * p_module_param->block_count), 
+                                   PSTORAGE_FLASH_PAGE_SIZE);
+#ifdef PSTORAGE_FIRST_MODULE_PAGES
+    if (m_next_app_instance == 0)
+    {
+        page_count = MAX(page_count, PSTORAGE_FIRST_MODULE_PAGES);
+    }
+#endif
+    if ((page_count * PSTORAGE_FLASH_PAGE_SIZE) > (m_next_page_addr - PSTORAGE_DATA_START_ADDR))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_next_page_addr -= page_count * PSTORAGE_FLASH_PAGE_SIZE;
+
     p_block_id->module_id = m_next_app_instance;
     p_block_id->block_id  = m_next_page_addr;
 
@@ -1338,11 +1585,6 @@ uint32_t pstorage_register(pstorage_module_param_t * p_module_param,
     m_app_table[m_next_app_instance].cb          = p_module_param->cb;
     m_app_table[m_next_app_instance].block_size  = p_module_param->block_size;
     m_app_table[m_next_app_instance].block_count = p_module_param->block_count;
-
-    // Calculate number of flash pages allocated for the device and adjust next free page address.
-    const uint32_t page_count = CEIL_DIV((p_module_param->block_size * p_module_param->block_count), 
-                                         PSTORAGE_FLASH_PAGE_SIZE);
-    m_next_page_addr         += page_count * PSTORAGE_FLASH_PAGE_SIZE;
     
     ++m_next_app_instance;
 
@@ -1503,6 +1745,13 @@ uint32_t pstorage_access_status_get(uint32_t * p_count)
     return NRF_SUCCESS;
 }
 
+
+void pstorage_stats_get(pstorage_stats_t * p_stats)
+{
+    (*p_stats) = m_stats;
+}
+
+
 #ifdef PSTORAGE_RAW_MODE_ENABLE
 
 uint32_t pstorage_raw_register(pstorage_module_param_t * p_module_param,
@@ -78,6 +78,24 @@ typedef void (*pstorage_ntf_cb_t)(pstorage_handle_t * p_handle,
                                   uint8_t *           p_data,
                                   uint32_t            data_len);
 
+/**@brief Persistent storage counters.
+ *
+ * @details Flash operations per command is (flash_writes + flash_erases) / commands. Queued stores 
+ *          that adjoin or overlap within a flash page are written by one flash operation, and a 
+ *          command whose area a later update or clear rewrites completes without flash access.
+ */
+typedef struct
+{
+    uint32_t commands;       /**< Store, update and clear commands queued. */
+    uint32_t flash_writes;   /**< Flash write operations accepted by the SoftDevice. */
+    uint32_t flash_erases;   /**< Flash page erase operations accepted by the SoftDevice, including the swap page. */
+    uint32_t merged;         /**< Store commands written by the flash operation of an earlier store. */
+    uint32_t superseded;     /**< Commands completed without flash access because a later command rewrote their area. */
+    uint32_t busy_retries;   /**< Flash operations the SoftDevice rejected as busy, and were reissued. */
+    uint32_t flash_errors;   /**< Flash operations that reported an error; each is retried, up to a limit. */
+    uint32_t queue_hwm;      /**< Most commands in the queue at once, the one in progress included. */
+} pstorage_stats_t;
+
 /**@brief Struct containing module registration context. */
 typedef struct
 {
@@ -293,6 +311,12 @@ uint32_t pstorage_clear(pstorage_handle_t * p_base_id, pstorage_size_t size);
  */
 uint32_t pstorage_access_status_get(uint32_t * p_count);
 
+/**@brief Function for getting the command and flash operation counters.
+ *
+ * @param[out] p_stats Counters since pstorage_init.
+ */
+void pstorage_stats_get(pstorage_stats_t * p_stats);
+
 #ifdef PSTORAGE_RAW_MODE_ENABLE
 
 /**@brief Function for registering with the persistent storage interface.
@@ -206,7 +206,7 @@ ret_code_t nrf_drv_uart_init(nrf_drv_uart_config_t const * p_config,
     {
         p_config = &m_default_config;
     }
-#ifdef NRF52
+#if (defined(UARTE_IN_USE) && defined(UART_IN_USE))
     m_cb.use_easy_dma = p_config->use_easy_dma;
 #endif
     apply_config(p_config);
@@ -10,6 +10,8 @@
  *
  */
 
+#include <string.h>
+#include "nordic_common.h"
 #include "app_fifo.h"
 #include "nrf_error.h"
 #include "app_util.h"
@@ -23,6 +25,27 @@ static __INLINE uint32_t fifo_length(app_fifo_t * p_fifo)
 #define FIFO_LENGTH fifo_length(p_fifo)  /**< Macro for calculating the FIFO length. */
 
 
+/**@brief Function for copying between a linear buffer and the FIFO buffer, starting at a FIFO
+ *        position. Takes at most two copies, the second one after the wrap.
+ */
+static void fifo_copy(app_fifo_t * p_fifo, uint32_t pos, uint8_t * p_data, uint32_t size, bool to_fifo)
+{
+    uint32_t index = pos & p_fifo->buf_size_mask;
+    uint32_t first = MIN(size, (uint32_t)p_fifo->buf_size_mask + 1 - index);
+
+    if (to_fifo)
+    {
+        memcpy(&p_fifo->p_buf[index], p_data, first);
+        memcpy(p_fifo->p_buf, &p_data[first], size - first);
+    }
+    else
+    {
+        memcpy(p_data, &p_fifo->p_buf[index], first);
+        memcpy(&p_data[first], p_fifo->p_buf, size - first);
+    }
+}
+
+
 uint32_t app_fifo_init(app_fifo_t * p_fifo, uint8_t * p_buf, uint16_t buf_size)
 {
     // Check buffer for null pointer.
@@ -72,6 +95,99 @@ uint32_t app_fifo_get(app_fifo_t * p_fifo, uint8_t * p_byte)
 
 }
 
+uint32_t app_fifo_read(app_fifo_t * p_fifo, uint8_t * p_byte_array, uint32_t * p_size)
+{
+    uint32_t length = FIFO_LENGTH;
+    uint32_t size;
+
+    if (p_size == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if (p_byte_array == NULL)
+    {
+        *p_size = length;
+        return NRF_SUCCESS;
+    }
+
+    if (length == 0)
+    {
+        *p_size = 0;
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    size = MIN(*p_size, length);
+
+    fifo_copy(p_fifo, p_fifo->read_pos, p_byte_array, size, false);
+    p_fifo->read_pos += size;
+
+    *p_size = size;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_fifo_write(app_fifo_t * p_fifo, uint8_t const * p_byte_array, uint32_t * p_size)
+{
+    uint32_t available = (uint32_t)p_fifo->buf_size_mask + 1 - FIFO_LENGTH;
+    uint32_t size;
+
+    if (p_size == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if (p_byte_array == NULL)
+    {
+        *p_size = available;
+        return NRF_SUCCESS;
+    }
+
+    if (available == 0)
+    {
+        *p_size = 0;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    size = MIN(*p_size, available);
+
+    fifo_copy(p_fifo, p_fifo->write_pos, (uint8_t *)p_byte_array, size, true);
+    p_fifo->write_pos += size;
+
+    *p_size = size;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_fifo_peek_span(app_fifo_t * p_fifo, uint8_t ** pp_data, uint32_t * p_size)
+{
+    uint32_t length = FIFO_LENGTH;
+    uint32_t index  = p_fifo->read_pos & p_fifo->buf_size_mask;
+
+    if ((pp_data == NULL) || (p_size == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    *pp_data = &p_fifo->p_buf[index];
+    *p_size  = MIN(length, (uint32_t)p_fifo->buf_size_mask + 1 - index);
+
+    return (length == 0) ? NRF_ERROR_NOT_FOUND : NRF_SUCCESS;
+}
+
+
+uint32_t app_fifo_consume(app_fifo_t * p_fifo, uint32_t size)
+{
+    if (size > FIFO_LENGTH)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    p_fifo->read_pos += size;
+    return NRF_SUCCESS;
+}
+
+
 uint32_t app_fifo_flush(app_fifo_t * p_fifo)
 {
     p_fifo->read_pos = p_fifo->write_pos;
@@ -23,6 +23,7 @@
 #define APP_FIFO_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 /**@brief A FIFO instance structure. Keeps track of which bytes to read and write next.
@@ -69,6 +70,63 @@ uint32_t app_fifo_put(app_fifo_t * p_fifo, uint8_t byte);
  */
 uint32_t app_fifo_get(app_fifo_t * p_fifo, uint8_t * p_byte);
 
+/**@brief Function for reading bytes from the FIFO.
+ *
+ * @details The bytes are copied with at most two memcpy calls, split at the end of the buffer.
+ *          If p_byte_array is NULL, only the number of bytes in the FIFO is returned.
+ *
+ * @param[in]    p_fifo        Pointer to the FIFO.
+ * @param[out]   p_byte_array  Memory the bytes are copied to, or NULL.
+ * @param[inout] p_size        Number of bytes to read; number of bytes read, or available.
+ *
+ * @retval     NRF_SUCCESS              If bytes were read, or the size was returned.
+ * @retval     NRF_ERROR_NULL           If p_size is NULL.
+ * @retval     NRF_ERROR_NOT_FOUND      If the FIFO is empty.
+ */
+uint32_t app_fifo_read(app_fifo_t * p_fifo, uint8_t * p_byte_array, uint32_t * p_size);
+
+/**@brief Function for writing bytes to the FIFO.
+ *
+ * @details The bytes are copied with at most two memcpy calls, split at the end of the buffer.
+ *          Only as many bytes as fit are written. If p_byte_array is NULL, only the free space is
+ *          returned.
+ *
+ * @param[in]    p_fifo        Pointer to the FIFO.
+ * @param[in]    p_byte_array  Bytes to write, or NULL.
+ * @param[inout] p_size        Number of bytes to write; number of bytes written, or free space.
+ *
+ * @retval     NRF_SUCCESS              If bytes were written, or the free space was returned.
+ * @retval     NRF_ERROR_NULL           If p_size is NULL.
+ * @retval     NRF_ERROR_NO_MEM         If the FIFO is full.
+ */
+uint32_t app_fifo_write(app_fifo_t * p_fifo, uint8_t const * p_byte_array, uint32_t * p_size);
+
+/**@brief Function for getting the contiguous bytes at the head of the FIFO without copying.
+ *
+ * @details The span ends at the end of the buffer; the bytes after the wrap are returned by the
+ *          next call once the span is consumed. The bytes stay in the FIFO, and are not
+ *          overwritten, until app_fifo_consume() is called.
+ *
+ * @param[in]  p_fifo   Pointer to the FIFO.
+ * @param[out] pp_data  Start of the span.
+ * @param[out] p_size   Length of the span.
+ *
+ * @retval     NRF_SUCCESS              If a span was returned.
+ * @retval     NRF_ERROR_NULL           If pp_data or p_size is NULL.
+ * @retval     NRF_ERROR_NOT_FOUND      If the FIFO is empty. *p_size is 0.
+ */
+uint32_t app_fifo_peek_span(app_fifo_t * p_fifo, uint8_t ** pp_data, uint32_t * p_size);
+
+/**@brief Function for removing bytes from the head of the FIFO, after app_fifo_peek_span().
+ *
+ * @param[in]  p_fifo   Pointer to the FIFO.
+ * @param[in]  size     Number of bytes to remove.
+ *
+ * @retval     NRF_SUCCESS              If the bytes were removed.
+ * @retval     NRF_ERROR_INVALID_LENGTH If the FIFO holds fewer bytes.
+ */
+uint32_t app_fifo_consume(app_fifo_t * p_fifo, uint32_t size);
+
 /**@brief Function for flushing the FIFO.
  *
  * @param[in]  p_fifo   Pointer to the FIFO.
@@ -30,7 +30,7 @@
 #include "app_error.h"
 #include "app_util.h"
 
-#define APP_SCHED_EVENT_HEADER_SIZE 8       /**< Size of app_scheduler.event_header_t (only for use inside APP_SCHED_BUF_SIZE()). */
+#define APP_SCHED_EVENT_HEADER_SIZE (2 * sizeof(void *))  /**< Size of app_scheduler.event_header_t (only for use inside APP_SCHED_BUF_SIZE()). */
 
 /**@brief Compute number of bytes required to hold the scheduler buffer.
  *
@@ -108,6 +108,22 @@ uint32_t app_sched_event_put(void *                    p_event_data,
                              uint16_t                  event_size,
                              app_sched_event_handler_t handler);
 
+#ifdef APP_SCHEDULER_WITH_PROFILER
+/**@brief Function for getting the maximum observed queue utilization.
+ *
+ * @details Compile with APP_SCHEDULER_WITH_PROFILER defined to enable this function.
+ *
+ * @return Maximum number of events that were in the queue at the same time.
+ */
+uint16_t app_sched_queue_utilization_get(void);
+#endif
+
+/**@brief Function for getting the current amount of free space in the queue.
+ *
+ * @return Number of events that can be put in the queue before it is full.
+ */
+uint16_t app_sched_queue_space_get(void);
+
 #ifdef APP_SCHEDULER_WITH_PAUSE
 /**@brief A function to pause the scheduler.
  *
@@ -1160,3 +1160,49 @@ uint32_t app_timer_cnt_diff_compute(uint32_t   ticks_to,
     return NRF_SUCCESS;
 }
 
+
+uint32_t app_timer_info_get(app_timer_id_t timer_id, app_timer_info_t * p_info)
+{
+    timer_node_t * p_node;
+    app_timer_id_t current;
+    uint32_t       ticks_to_expire = 0;
+    uint32_t       ticks_elapsed;
+
+    if ((mp_nodes == NULL) || (timer_id >= m_node_array_size))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_node = &mp_nodes[timer_id];
+    if (p_node->state != STATE_ALLOCATED)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    // The list is only changed by the RTC1 and SWI interrupts.
+    CRITICAL_REGION_ENTER();
+
+    p_info->is_running              = p_node->is_running;
+    p_info->mode                    = p_node->mode;
+    p_info->ticks_periodic_interval = p_node->ticks_periodic_interval;
+    p_info->p_timeout_handler       = p_node->p_timeout_handler;
+
+    // Expiry times in the list are relative to the previous timer, the first one to m_ticks_latest.
+    for (current = m_timer_id_head; current != TIMER_NULL; current = mp_nodes[current].next)
+    {
+        ticks_to_expire += mp_nodes[current].ticks_to_expire;
+        if (current == timer_id)
+        {
+            break;
+        }
+    }
+    ticks_elapsed = ticks_diff_get(rtc1_counter_get(), m_ticks_latest);
+
+    CRITICAL_REGION_EXIT();
+
+    p_info->ticks_to_expire = (p_node->is_running && (ticks_to_expire > ticks_elapsed))
+                              ? (ticks_to_expire - ticks_elapsed) : 0;
+
+    return NRF_SUCCESS;
+}
+
@@ -51,9 +51,9 @@
 #define APP_TIMER_CLOCK_FREQ         32768                      /**< Clock frequency of the RTC timer used to implement the app timer module. */
 #define APP_TIMER_MIN_TIMEOUT_TICKS  5                          /**< Minimum value of the timeout_ticks parameter of app_timer_start(). */
 
-#define APP_TIMER_NODE_SIZE          40                         /**< Size of app_timer.timer_node_t (only for use inside APP_TIMER_BUF_SIZE()). */
-#define APP_TIMER_USER_OP_SIZE       24                         /**< Size of app_timer.timer_user_op_t (only for use inside APP_TIMER_BUF_SIZE()). */
-#define APP_TIMER_USER_SIZE          8                          /**< Size of app_timer.timer_user_t (only for use inside APP_TIMER_BUF_SIZE()). */
+#define APP_TIMER_NODE_SIZE          (32 + 2 * sizeof(void *))  /**< Size of app_timer.timer_node_t (only for use inside APP_TIMER_BUF_SIZE()). */
+#define APP_TIMER_USER_OP_SIZE       (16 + 2 * sizeof(void *))  /**< Size of app_timer.timer_user_op_t (only for use inside APP_TIMER_BUF_SIZE()). */
+#define APP_TIMER_USER_SIZE          (2 * sizeof(void *))       /**< Size of app_timer.timer_user_t (only for use inside APP_TIMER_BUF_SIZE()). */
 #define APP_TIMER_INT_LEVELS         3                          /**< Number of interrupt levels from where timer operations may be initiated (only for use inside APP_TIMER_BUF_SIZE()). */
 
 /**@brief Compute number of bytes required to hold the application timer data structures.
@@ -262,6 +262,27 @@ uint32_t app_timer_cnt_diff_compute(uint32_t   ticks_to,
                                     uint32_t   ticks_from,
                                     uint32_t * p_ticks_diff);
 
+/**@brief Timer state, as returned by app_timer_info_get(). */
+typedef struct
+{
+    bool                        is_running;              /**< True if the timer is in the list of running timers. */
+    app_timer_mode_t            mode;                    /**< Timer mode. */
+    uint32_t                    ticks_to_expire;         /**< Ticks from now to the next expiry, if running. */
+    uint32_t                    ticks_periodic_interval; /**< Timer period (for repeating timers). */
+    app_timer_timeout_handler_t p_timeout_handler;       /**< Timeout handler. */
+} app_timer_info_t;
+
+/**@brief Function for getting the state of a timer, for diagnostics.
+ *
+ * @param[in]  timer_id  Id of the timer. Ids are assigned from 0 up by app_timer_create().
+ * @param[out] p_info    Timer state.
+ *
+ * @retval     NRF_SUCCESS               State was successfully read.
+ * @retval     NRF_ERROR_INVALID_PARAM   Id beyond the number of timers given to app_timer_init().
+ * @retval     NRF_ERROR_NOT_FOUND       Timer has not been created.
+ */
+uint32_t app_timer_info_get(app_timer_id_t timer_id, app_timer_info_t * p_info);
+
 #endif // APP_TIMER_H__
 
 /** @} */
@@ -60,6 +60,13 @@ typedef struct
     uint32_t  tx_buf_size; /**< Size of the TX buffer. */
 } app_uart_buffers_t;
 
+/**@brief UART transmit statistics. */
+typedef struct
+{
+    uint32_t bytes;      /**< Bytes transmitted. */
+    uint32_t transfers;  /**< Transfers completed, one TX done interrupt each. */
+} app_uart_tx_stats_t;
+
 /**@brief Enumeration which defines events used by the UART module upon data reception or error.
  *
  * @details The event type is used to indicate the type of additional information in the event
@@ -205,6 +212,24 @@ uint32_t app_uart_get(uint8_t * p_byte);
  */
 uint32_t app_uart_put(uint8_t byte);
 
+/**@brief Function for putting bytes on the UART.
+ *
+ * @details This call is non-blocking. As many bytes as fit in the TX buffer are copied to it. Only
+ *          available in the FIFO variant of the module (app_uart_fifo.c).
+ *
+ * @param[in]    p_data  Bytes to be transmitted on the UART.
+ * @param[inout] p_size  Number of bytes to transmit; number of bytes put on the TX buffer.
+ *
+ * @retval NRF_SUCCESS        If bytes were put on the TX buffer.
+ * @retval NRF_ERROR_NO_MEM   If the TX buffer is full.
+ */
+uint32_t app_uart_write(uint8_t const * p_data, uint32_t * p_size);
+
+/**@brief Function for getting the transmit statistics. Only available in the FIFO variant of the
+ *        module (app_uart_fifo.c).
+ */
+void app_uart_tx_stats_get(app_uart_tx_stats_t * p_stats);
+
 /**@brief Function for flushing the RX and TX buffers (Only valid if FIFO is used).
  *        This function does nothing if FIFO is not used.
  *
@@ -10,8 +10,10 @@
  *
  */
 
+#include "nordic_common.h"
 #include "app_uart.h"
 #include "app_fifo.h"
+#include "app_util_platform.h"
 #include "nrf_drv_uart.h"
 
 
@@ -25,12 +27,29 @@ static __INLINE uint32_t fifo_length(app_fifo_t * const fifo)
 
 
 static app_uart_event_handler_t   m_event_handler;            /**< Event handler function. */
-static uint8_t tx_buffer[1];
-static uint8_t tx_tmp;
 static uint8_t rx_buffer[1];
 
 static app_fifo_t                  m_rx_fifo;                               /**< RX FIFO buffer for storing data received on the UART until the application fetches them using app_uart_get(). */
 static app_fifo_t                  m_tx_fifo;                               /**< TX FIFO buffer for storing data to be transmitted on the UART when TXD is ready. Data is put to the buffer on using app_uart_put(). */
+static app_uart_tx_stats_t         m_tx_stats;                              /**< TX statistics. */
+
+
+/**@brief Function for starting the transmission of the contiguous bytes at the head of the TX FIFO.
+ *
+ * @details The bytes are sent from the FIFO buffer and consumed once the transfer is done. Must be
+ *          called with the UART interrupt unable to preempt, as the TX done handler also calls it.
+ */
+static void tx_start(void)
+{
+    uint8_t  * p_data;
+    uint32_t   size;
+
+    if (app_fifo_peek_span(&m_tx_fifo, &p_data, &size) == NRF_SUCCESS)
+    {
+        // Returns NRF_ERROR_BUSY while a transfer is in progress; the TX done handler continues.
+        (void)nrf_drv_uart_tx(p_data, (uint8_t)MIN(size, UINT8_MAX));
+    }
+}
 
 void uart_event_handler(nrf_drv_uart_event_t * p_event, void* p_context)
 {
@@ -66,11 +85,12 @@ void uart_event_handler(nrf_drv_uart_event_t * p_event, void* p_context)
     }
     else if (p_event->type == NRF_DRV_UART_EVT_TX_DONE)
     {
-        // Get next byte from FIFO.
-        if (app_fifo_get(&m_tx_fifo, tx_buffer) == NRF_SUCCESS)
-        {
-            (void)nrf_drv_uart_tx(tx_buffer,1);
-        }
+        // Release the bytes sent and send the next span from the FIFO.
+        (void)app_fifo_consume(&m_tx_fifo, p_event->data.rxtx.bytes);
+        m_tx_stats.bytes += p_event->data.rxtx.bytes;
+        m_tx_stats.transfers++;
+        tx_start();
+
         if (FIFO_LENGTH(m_tx_fifo) == 0)
         {
             // Last byte from FIFO transmitted, notify the application.
@@ -161,17 +181,39 @@ uint32_t app_uart_put(uint8_t byte)
 {
     uint32_t err_code;
 
-    tx_tmp = byte;
-    err_code = nrf_drv_uart_tx(&tx_tmp, 1);
+    err_code = app_fifo_put(&m_tx_fifo, byte);
+    if (err_code == NRF_SUCCESS)
+    {
+        CRITICAL_REGION_ENTER();
+        tx_start();
+        CRITICAL_REGION_EXIT();
+    }
+
+    return err_code;
+}
 
-    if (err_code == NRF_ERROR_BUSY)
+uint32_t app_uart_write(uint8_t const * p_data, uint32_t * p_size)
+{
+    uint32_t err_code;
+
+    err_code = app_fifo_write(&m_tx_fifo, p_data, p_size);
+    if (err_code == NRF_SUCCESS)
     {
-        err_code = app_fifo_put(&m_tx_fifo, byte);
+        CRITICAL_REGION_ENTER();
+        tx_start();
+        CRITICAL_REGION_EXIT();
     }
 
     return err_code;
 }
 
+void app_uart_tx_stats_get(app_uart_tx_stats_t * p_stats)
+{
+    CRITICAL_REGION_ENTER();
+    *p_stats = m_tx_stats;
+    CRITICAL_REGION_EXIT();
+}
+
 uint32_t app_uart_close(void)
 {
     nrf_drv_uart_uninit();
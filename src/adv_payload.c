@@ -0,0 +1,118 @@
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "adv_payload.h"
+
+#define NAME_LEN    (sizeof(ADV_PAYLOAD_DEVICE_NAME) - 1)
+
+
+/**@brief Advertising payload layout, in the order ble_advdata_encode() uses for these fields.
+ *
+ * @details Each field is an AD structure: length, AD type, data. Only byte arrays are used, so
+ *          there is no padding and the structure is the over-the-air payload.
+ */
+typedef struct
+{
+    uint8_t appearance[4];
+    uint8_t flags[3];
+    uint8_t status_hdr[4];
+    uint8_t status_version;
+    uint8_t battery_level;
+    uint8_t unread_count[2];
+    uint8_t name_hdr[2];
+    char    name[NAME_LEN];
+} adv_payload_t;
+
+STATIC_ASSERT(sizeof(adv_payload_t) <= BLE_GAP_ADV_MAX_SIZE);
+
+#define PAYLOAD_TEMPLATE(FLAGS)                                                                     \
+{                                                                                                   \
+    .appearance     = {3, BLE_GAP_AD_TYPE_APPEARANCE,                                               \
+                       LSB(ADV_PAYLOAD_APPEARANCE), MSB(ADV_PAYLOAD_APPEARANCE)},                   \
+    .flags          = {2, BLE_GAP_AD_TYPE_FLAGS, (FLAGS)},                                          \
+    .status_hdr     = {7, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA,                               \
+                       LSB(ADV_PAYLOAD_COMPANY_ID), MSB(ADV_PAYLOAD_COMPANY_ID)},                   \
+    .status_version = ADV_PAYLOAD_STATUS_VERSION,                                                   \
+    .battery_level  = ADV_PAYLOAD_BATTERY_UNKNOWN,                                                  \
+    .unread_count   = {0, 0},                                                                       \
+    .name_hdr       = {NAME_LEN + 1, BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME},                          \
+    .name           = ADV_PAYLOAD_DEVICE_NAME                                                       \
+}
+
+static const adv_payload_t m_templates[ADV_PAYLOAD_COUNT] =
+{
+    [ADV_PAYLOAD_DISCOVERABLE] = PAYLOAD_TEMPLATE(BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE),
+    [ADV_PAYLOAD_WHITELIST]    = PAYLOAD_TEMPLATE(BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED),
+};
+
+static adv_payload_t       m_payloads[ADV_PAYLOAD_COUNT];  /**< Templates with the current status patched in. */
+static adv_payload_kind_t  m_current;                      /**< Payload being advertised. */
+static adv_payload_stats_t m_stats;
+static bool                m_set_failed;                   /**< The SoftDevice did not take the last payload. */
+
+
+static uint32_t payload_set(void)
+{
+    uint32_t err_code;
+
+    m_stats.data_sets++;
+
+    err_code     = sd_ble_gap_adv_data_set((uint8_t const *)&m_payloads[m_current], sizeof(adv_payload_t), NULL, 0);
+    m_set_failed = (err_code != NRF_SUCCESS);
+
+    return err_code;
+}
+
+
+void adv_payload_init(void)
+{
+    memcpy(m_payloads, m_templates, sizeof(m_payloads));
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_current    = ADV_PAYLOAD_DISCOVERABLE;
+    m_set_failed = false;
+}
+
+
+uint32_t adv_payload_select(adv_payload_kind_t kind)
+{
+    if (kind >= ADV_PAYLOAD_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_current = kind;
+
+    return payload_set();
+}
+
+
+uint32_t adv_payload_status_set(uint8_t battery_level, uint16_t unread_count)
+{
+    uint8_t unread[2];
+    uint8_t i;
+
+    (void)uint16_encode(unread_count, unread);
+
+    if (!m_set_failed &&
+        (m_payloads[m_current].battery_level == battery_level) &&
+        (memcmp(m_payloads[m_current].unread_count, unread, sizeof(unread)) == 0))
+    {
+        m_stats.unchanged++;
+        return NRF_SUCCESS;
+    }
+
+    for (i = 0; i < ADV_PAYLOAD_COUNT; i++)
+    {
+        m_payloads[i].battery_level = battery_level;
+        memcpy(m_payloads[i].unread_count, unread, sizeof(unread));
+    }
+
+    return payload_set();
+}
+
+
+void adv_payload_stats_get(adv_payload_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
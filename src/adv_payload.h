@@ -0,0 +1,62 @@
+#ifndef ADV_PAYLOAD_H__
+#define ADV_PAYLOAD_H__
+
+#include <stdint.h>
+#include "ble_gap.h"
+
+#define ADV_PAYLOAD_DEVICE_NAME         "PixWatch"                      /**< Complete local name, also used as GAP device name. */
+#define ADV_PAYLOAD_APPEARANCE          BLE_APPEARANCE_GENERIC_WATCH    /**< GAP appearance. */
+#define ADV_PAYLOAD_STATUS_VERSION      0x01                            /**< Version of the status field layout. */
+
+#define ADV_PAYLOAD_BATTERY_UNKNOWN     0xFF                            /**< Battery level when none is measured. */
+
+/* Company identifier of the status field. 0xFFFF is the value the Bluetooth SIG reserves for
+ * development; a product build must define the identifier assigned to its vendor. */
+#ifndef ADV_PAYLOAD_COMPANY_ID
+#define ADV_PAYLOAD_COMPANY_ID          0xFFFF
+#endif
+
+
+/**@brief Prebuilt advertising payloads. They differ only in their flags. */
+typedef enum
+{
+    ADV_PAYLOAD_DISCOVERABLE,   /**< LE limited discoverable mode. */
+    ADV_PAYLOAD_WHITELIST,      /**< Not discoverable, for advertising to bonded peers only. */
+    ADV_PAYLOAD_COUNT
+} adv_payload_kind_t;
+
+/**@brief Advertising payload statistics. */
+typedef struct
+{
+    uint32_t data_sets;   /**< Payloads passed to the SoftDevice. */
+    uint32_t unchanged;   /**< Status updates that did not change the payload and were not sent. */
+} adv_payload_stats_t;
+
+
+/**@brief Function for initializing the advertising payloads.
+ *
+ * @details The payloads are compile-time templates:
+ *          appearance, flags, manufacturer specific status, complete local name. The status is
+ *          company id (2), version (1), battery level in percent (1) and unread message count (2).
+ *          Nothing is encoded at runtime; only the status bytes are patched.
+ */
+void adv_payload_init(void);
+
+/**@brief Function for selecting the payload to advertise and passing it to the SoftDevice.
+ *
+ * @details Call whenever advertising starts, as ble_advertising re-encodes its own payload when it
+ *          switches to whitelist mode. The scan response is left unchanged.
+ */
+uint32_t adv_payload_select(adv_payload_kind_t kind);
+
+/**@brief Function for updating the status field.
+ *
+ * @details The payload is passed to the SoftDevice only if a value changed, or if the SoftDevice
+ *          did not take the last one, so a failed update is retried by the next call.
+ */
+uint32_t adv_payload_status_set(uint8_t battery_level, uint16_t unread_count);
+
+/**@brief Function for getting the advertising payload statistics. */
+void adv_payload_stats_get(adv_payload_stats_t * p_stats);
+
+#endif /* ADV_PAYLOAD_H__ */
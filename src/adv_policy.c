@@ -0,0 +1,357 @@
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "adv_policy.h"
+
+#define TIMEOUT_MAX         BLE_GAP_ADV_TIMEOUT_LIMITED_MAX     /**< Longest advertising period in limited discoverable mode, in seconds. */
+#define TICKS_TO_MS(TICKS)  ((uint32_t)(((uint64_t)(TICKS) * 1000) / APP_TIMER_CLOCK_FREQ))  /**< RTC1 runs with prescaler 0. */
+#define BURST_MAX           2                                   /**< Initial burst and predicted reconnect burst. */
+#define ADV_DELAY_AVG_MS    5                                   /**< Average advDelay of the link layer. */
+#define RTC_COUNTER_RANGE   0x1000000                           /**< RTC1 counts 24 bits, 512 s at prescaler 0. */
+
+// A period, fast then slow, is timed by RTC1 and must end before the counter wraps.
+STATIC_ASSERT((uint64_t)2 * TIMEOUT_MAX * APP_TIMER_CLOCK_FREQ < RTC_COUNTER_RANGE);
+
+
+/**@brief Period of fast advertising, in seconds since the disconnect. */
+typedef struct
+{
+    uint32_t start;
+    uint32_t end;
+} burst_t;
+
+static ble_adv_modes_config_t m_config;                           /**< Intervals and mode settings from the application. */
+static uint32_t               m_history[ADV_POLICY_HISTORY_LEN];  /**< Last reconnect latencies, in seconds. */
+static uint8_t                m_history_count;
+static uint8_t                m_history_next;
+static bool                   m_waiting_reconnect;                /**< Disconnected, and not reconnected yet. */
+static uint32_t               m_elapsed_ms;                       /**< Advertising time since the disconnect, up to the current period. */
+static bool                   m_period_active;                    /**< The SoftDevice took the current period, which has not ended. */
+static uint32_t               m_period_start;                     /**< RTC1 counter when the current period started. */
+static uint32_t               m_period_fast;                      /**< Fast part of the current period, in seconds. */
+static uint32_t               m_period_slow;                      /**< Slow part of the current period, in seconds. */
+static uint32_t               m_latency_sum;
+static uint32_t               m_fast_ms;
+static uint32_t               m_slow_ms;
+static adv_policy_stats_t     m_stats;
+
+
+/**@brief Function for predicting the reconnect time from the history.
+ *
+ * @param[out] p_center  Median reconnect time.
+ * @param[out] p_half    Half-width of the burst: the interquartile range, at least ADV_POLICY_MIN_WINDOW.
+ *
+ * @return false if the history is too short for a prediction.
+ */
+static bool prediction_get(uint32_t * p_center, uint32_t * p_half)
+{
+    uint32_t sorted[ADV_POLICY_HISTORY_LEN];
+    uint32_t value;
+    uint8_t  n = m_history_count;
+    uint8_t  i;
+    uint8_t  j;
+
+    if (n < ADV_POLICY_MIN_HISTORY)
+    {
+        return false;
+    }
+
+    // Insertion sort; the history is short.
+    for (i = 0; i < n; i++)
+    {
+        value = m_history[i];
+        for (j = i; (j > 0) && (sorted[j - 1] > value); j--)
+        {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+
+    *p_center = sorted[n / 2];
+    *p_half   = MAX(sorted[(3 * n) / 4] - sorted[n / 4], ADV_POLICY_MIN_WINDOW);
+
+    return true;
+}
+
+
+/**@brief Function for planning the advertising period starting t seconds after the disconnect.
+ *
+ * @param[in]  t       Time since the disconnect, in seconds.
+ * @param[out] p_fast  Fast advertising time-out, 0 if no burst is due.
+ * @param[out] p_slow  Slow advertising time-out that follows, 0 if none.
+ */
+static void plan(uint32_t t, uint32_t * p_fast, uint32_t * p_slow)
+{
+    burst_t  bursts[BURST_MAX];
+    uint8_t  count = 0;
+    uint32_t center;
+    uint32_t half;
+    uint32_t t_end = t;
+    uint32_t next  = ADV_POLICY_GIVE_UP;
+    bool     extended;
+    uint8_t  i;
+
+    if (prediction_get(&center, &half))
+    {
+        bursts[count].start = 0;
+        bursts[count].end   = ADV_POLICY_INITIAL_BURST;
+        count++;
+        bursts[count].start = (center > half) ? (center - half) : 0;
+        bursts[count].end   = center + half;
+        count++;
+
+        m_stats.latency_predicted = center;
+    }
+    else
+    {
+        bursts[count].start = 0;
+        bursts[count].end   = m_config.ble_adv_fast_timeout;
+        count++;
+    }
+
+    // Fast advertising lasts until the end of the bursts covering t, which may overlap.
+    do
+    {
+        extended = false;
+        for (i = 0; i < count; i++)
+        {
+            if ((t_end >= bursts[i].start) && (t_end < bursts[i].end))
+            {
+                t_end    = bursts[i].end;
+                extended = true;
+            }
+        }
+    } while (extended);
+
+    for (i = 0; i < count; i++)
+    {
+        if ((bursts[i].start > t_end) && (bursts[i].start < next))
+        {
+            next = bursts[i].start;
+        }
+    }
+
+    *p_fast = t_end - t;
+    *p_slow = (next > t_end) ? (next - t_end) : 0;
+
+    // Periods are limited in limited discoverable mode; the plan is redone when one ends.
+    if (*p_fast > TIMEOUT_MAX)
+    {
+        *p_fast = TIMEOUT_MAX;
+        *p_slow = 0;
+    }
+    *p_slow = MIN(*p_slow, TIMEOUT_MAX);
+}
+
+
+/**@brief Function for passing the time-outs of the next advertising period to ble_advertising.
+ *        The period is only timed once advertising starts, see period_begin().
+ *
+ * @return false if advertising should stop.
+ */
+static bool period_configure(void)
+{
+    ble_adv_modes_config_t config = m_config;
+    uint32_t               fast;
+    uint32_t               slow;
+
+    plan((m_elapsed_ms + 500) / 1000, &fast, &slow);
+    if ((fast == 0) && (slow == 0))
+    {
+        return false;
+    }
+
+    config.ble_adv_fast_enabled = (fast > 0);
+    config.ble_adv_fast_timeout = fast;
+    config.ble_adv_slow_enabled = (slow > 0);
+    config.ble_adv_slow_timeout = slow;
+
+    ble_advertising_modes_config_set(&config);
+
+    m_period_fast = fast;
+    m_period_slow = slow;
+
+    return true;
+}
+
+
+/**@brief Function for timing the configured period from now, when the SoftDevice has taken it.
+ *
+ * @details A start refused by the SoftDevice, such as connectable advertising while connected,
+ *          leaves the period inactive, so that the time until the next start is not counted.
+ */
+static void period_begin(void)
+{
+    if (!m_period_active)
+    {
+        m_period_active = true;
+        (void)app_timer_cnt_get(&m_period_start);
+    }
+}
+
+
+/**@brief Function for accounting the time and energy of the current advertising period.
+ *
+ * @details A period lasts at most two limited discoverable time-outs, less than an RTC1 wrap. The
+ *          elapsed time is still capped to the length of the period, should its end be seen late.
+ */
+static void period_account(void)
+{
+    uint32_t now;
+    uint32_t ticks;
+    uint32_t elapsed_ms;
+    uint32_t fast_ms;
+    uint32_t slow_ms;
+
+    if (!m_period_active)
+    {
+        return;
+    }
+    m_period_active = false;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, m_period_start, &ticks);
+
+    elapsed_ms = MIN(TICKS_TO_MS(ticks), (m_period_fast + m_period_slow) * 1000);
+    fast_ms    = MIN(elapsed_ms, m_period_fast * 1000);
+    slow_ms    = elapsed_ms - fast_ms;
+
+    m_elapsed_ms += elapsed_ms;
+    m_fast_ms    += fast_ms;
+    m_slow_ms    += slow_ms;
+
+    // Intervals are in units of 0.625 ms; the link layer adds a random delay of 0 to 10 ms to each.
+    m_stats.adv_events += (fast_ms * 8) / (m_config.ble_adv_fast_interval * 5 + ADV_DELAY_AVG_MS * 8);
+    m_stats.adv_events += (slow_ms * 8) / (m_config.ble_adv_slow_interval * 5 + ADV_DELAY_AVG_MS * 8);
+}
+
+
+static void reconnect_record(uint32_t latency)
+{
+    m_history[m_history_next] = latency;
+    m_history_next            = (m_history_next + 1) % ADV_POLICY_HISTORY_LEN;
+    if (m_history_count < ADV_POLICY_HISTORY_LEN)
+    {
+        m_history_count++;
+    }
+
+    m_latency_sum += latency;
+    m_stats.reconnects++;
+}
+
+
+void adv_policy_init(ble_adv_modes_config_t const * p_config)
+{
+    m_config            = *p_config;
+    m_history_count     = 0;
+    m_history_next      = 0;
+    m_waiting_reconnect = false;
+    m_period_active     = false;
+    m_latency_sum       = 0;
+    m_fast_ms           = 0;
+    m_slow_ms           = 0;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+uint32_t adv_policy_start(void)
+{
+    uint32_t err_code;
+
+    if (m_period_active)
+    {
+        // Still advertising.
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_elapsed_ms = 0;
+
+    if (!period_configure())
+    {
+        return NRF_SUCCESS;
+    }
+
+    err_code = ble_advertising_start(BLE_ADV_MODE_FAST);
+    if (err_code == NRF_SUCCESS)
+    {
+        period_begin();
+    }
+    return err_code;
+}
+
+
+void adv_policy_on_ble_evt(ble_evt_t const * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            if (p_ble_evt->evt.gap_evt.params.connected.role != BLE_GAP_ROLE_PERIPH)
+            {
+                break;
+            }
+            period_account();
+            if (m_waiting_reconnect)
+            {
+                m_waiting_reconnect = false;
+                reconnect_record(m_elapsed_ms / 1000);
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            // ble_advertising restarts advertising with the configuration set here.
+            period_account();
+            m_elapsed_ms        = 0;
+            m_waiting_reconnect = true;
+            (void)period_configure();
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+void adv_policy_on_adv_evt(ble_adv_evt_t adv_evt)
+{
+    uint32_t err_code;
+
+    switch (adv_evt)
+    {
+        case BLE_ADV_EVT_FAST:
+        case BLE_ADV_EVT_FAST_WHITELIST:
+        case BLE_ADV_EVT_SLOW:
+        case BLE_ADV_EVT_SLOW_WHITELIST:
+            // ble_advertising reports a mode only once the SoftDevice has taken it, which is how
+            // the restart after a disconnect is seen.
+            period_begin();
+            break;
+
+        case BLE_ADV_EVT_IDLE:
+            period_account();
+            if (period_configure())
+            {
+                err_code = ble_advertising_start(BLE_ADV_MODE_FAST);
+                APP_ERROR_CHECK(err_code);
+            }
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+void adv_policy_stats_get(adv_policy_stats_t * p_stats)
+{
+    m_stats.latency_avg  = (m_stats.reconnects > 0) ? (m_latency_sum / m_stats.reconnects) : 0;
+    m_stats.fast_seconds = m_fast_ms / 1000;
+    m_stats.slow_seconds = m_slow_ms / 1000;
+    m_stats.charge_uc    = (uint32_t)(((uint64_t)m_stats.adv_events * ADV_POLICY_EVENT_CHARGE_NC) / 1000);
+
+    *p_stats = m_stats;
+}
@@ -0,0 +1,63 @@
+#ifndef ADV_POLICY_H__
+#define ADV_POLICY_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "ble_advertising.h"
+
+#define ADV_POLICY_HISTORY_LEN        8       /**< Number of reconnect latencies remembered. */
+#define ADV_POLICY_MIN_HISTORY        3       /**< Reconnects needed before a reconnect burst is predicted. */
+#define ADV_POLICY_INITIAL_BURST      10      /**< Fast advertising right after a disconnect, in seconds, once bursts are predicted. */
+#define ADV_POLICY_MIN_WINDOW         10      /**< Minimum half-width of a predicted burst, in seconds. */
+#define ADV_POLICY_GIVE_UP            3600    /**< Time after which advertising stops, in seconds. */
+#define ADV_POLICY_EVENT_CHARGE_NC    7000    /**< Approximate charge of one advertising event on three channels, in nC. */
+
+
+/**@brief Advertising policy statistics. */
+typedef struct
+{
+    uint32_t reconnects;          /**< Reconnections after a disconnect. */
+    uint32_t latency_avg;         /**< Average time from disconnect to reconnect, in seconds. */
+    uint32_t latency_predicted;   /**< Predicted reconnect time, in seconds. 0 while the history is too short. */
+    uint32_t fast_seconds;        /**< Time spent in fast advertising. */
+    uint32_t slow_seconds;        /**< Time spent in slow advertising. */
+    uint32_t adv_events;          /**< Advertising events, estimated from the intervals. */
+    uint32_t charge_uc;           /**< Charge spent on advertising, estimated with ADV_POLICY_EVENT_CHARGE_NC, in uC. */
+} adv_policy_stats_t;
+
+
+/**@brief Function for initializing the advertising policy.
+ *
+ * @details After a disconnect, the policy advertises fast for a short burst while the phone may
+ *          still be near, then slowly, with a second fast burst around the median reconnect time
+ *          of the last ADV_POLICY_HISTORY_LEN reconnections. Until enough reconnections are seen,
+ *          the fast time-out of p_config is used for the first burst. Slow advertising continues
+ *          in limited discoverable periods until ADV_POLICY_GIVE_UP.
+ *
+ * @param[in] p_config  Intervals of fast and slow advertising, and the other modes settings. The
+ *                      time-outs are set by the policy. Must match the configuration given to
+ *                      ble_advertising_init().
+ */
+void adv_policy_init(ble_adv_modes_config_t const * p_config);
+
+/**@brief Function for starting advertising according to the policy.
+ *
+ * @retval NRF_ERROR_INVALID_STATE  Advertising already, or refused by the SoftDevice while connected.
+ * @return Other errors of ble_advertising_start().
+ */
+uint32_t adv_policy_start(void);
+
+/**@brief Function for handling BLE events. Must be called before ble_advertising_on_ble_evt(), and
+ *        before adv_policy_start() is called for a connection event.
+ */
+void adv_policy_on_ble_evt(ble_evt_t const * p_ble_evt);
+
+/**@brief Function for handling the events of ble_advertising. Times a period from the start the
+ *        SoftDevice takes, and starts the next period, if any, on BLE_ADV_EVT_IDLE.
+ */
+void adv_policy_on_adv_evt(ble_adv_evt_t adv_evt);
+
+/**@brief Function for getting the advertising policy statistics. */
+void adv_policy_stats_get(adv_policy_stats_t * p_stats);
+
+#endif /* ADV_POLICY_H__ */
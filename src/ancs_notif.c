@@ -0,0 +1,476 @@
+#include <string.h>
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ancs_notif.h"
+#include "inbox.h"
+
+#define ATTR_BUF_LEN          (BLE_ANCS_ATTR_DATA_MAX + 1)   /**< Attribute buffer size, including the NUL terminator. */
+#define REQUESTED_ATTR_COUNT  3                              /**< App identifier, title and message. */
+
+/**@brief Fetcher states. */
+typedef enum
+{
+    STATE_IDLE,          /**< No notification is being fetched. */
+    STATE_NOTIF_ATTRS,   /**< Waiting for the notification attributes. */
+    STATE_APP_ATTRS      /**< Waiting for the app display name. */
+} fetch_state_t;
+
+/**@brief Notification waiting for its attributes. */
+typedef struct
+{
+    uint16_t conn_handle;                         /**< Link of the Notification Provider that sent it. */
+    uint32_t notif_uid;                           /**< Notification UID. */
+} queue_entry_t;
+
+/**@brief Notification composed for the inbox, waiting for it to finish the previous append. */
+typedef struct
+{
+    uint32_t notif_uid;                           /**< Notification UID, the inbox message identifier. */
+    uint32_t timestamp;                           /**< Local time the notification was complete. */
+    uint32_t gatt_ops;                            /**< Control point writes it took. */
+    uint16_t length;                              /**< Length of the record. */
+    uint8_t  record[INBOX_MSG_MAX_LEN];           /**< "name\ntitle\nmessage". */
+} pending_entry_t;
+
+/**@brief Cached app display name. */
+typedef struct
+{
+    uint8_t  app_id[ATTR_BUF_LEN];                /**< App identifier, empty if the entry is unused. */
+    uint8_t  name[ANCS_NOTIF_NAME_MAX_LEN + 1];   /**< App display name. */
+    uint32_t last_used;                           /**< Value of m_cache_clock when the entry was last used. */
+} name_cache_entry_t;
+
+
+static ancs_notif_time_get_t m_time_get;                               /**< Local time source. */
+static fetch_state_t         m_state;                                  /**< Fetcher state. */
+static app_timer_id_t        m_fetch_timer_id;                         /**< Timer of the notification being fetched. */
+static uint32_t              m_fetch_timeout;                          /**< Time given to the Notification Provider for one notification, in ticks. */
+
+static queue_entry_t         m_queue[ANCS_NOTIF_QUEUE_SIZE];           /**< Notifications waiting to be fetched, from all links. */
+static uint8_t               m_queue_head;                             /**< Next notification to fetch. */
+static uint8_t               m_queue_count;                            /**< Number of queued notifications. */
+
+static pending_entry_t       m_pending[ANCS_NOTIF_PENDING_SIZE];       /**< Notifications waiting for the inbox. */
+static uint8_t               m_pending_head;                           /**< Next notification to append. */
+static uint8_t               m_pending_count;                          /**< Number of notifications waiting for the inbox. */
+
+static ble_ancs_c_evt_notif_t m_current;                               /**< Notification being fetched. */
+static uint16_t              m_current_conn;                           /**< Link of the notification being fetched. */
+static uint8_t               m_attrs_pending;                          /**< Notification attributes still expected. */
+static uint32_t              m_current_ops;                            /**< Control point writes completed for the current notification. */
+
+static uint8_t               m_app_id[ATTR_BUF_LEN];                   /**< App identifier attribute. */
+static uint8_t               m_title[ATTR_BUF_LEN];                    /**< Title attribute. */
+static uint8_t               m_message[ANCS_NOTIF_MSG_MAX_LEN + 1];    /**< Message attribute, truncated by the Notification Provider. */
+static uint8_t               m_app_name[ANCS_NOTIF_NAME_MAX_LEN + 1];  /**< App display name being fetched. */
+
+static name_cache_entry_t    m_cache[ANCS_NOTIF_CACHE_SIZE];           /**< App display name cache. */
+static uint32_t              m_cache_clock;                            /**< Incremented on each cache access, for LRU replacement. */
+
+static ancs_notif_stats_t    m_stats;                                  /**< Statistics. */
+
+
+static name_cache_entry_t * cache_find(uint8_t const * p_app_id)
+{
+    uint32_t i;
+
+    for (i = 0; i < ANCS_NOTIF_CACHE_SIZE; i++)
+    {
+        if ((m_cache[i].app_id[0] != '\0') && (strcmp((char *)m_cache[i].app_id, (char const *)p_app_id) == 0))
+        {
+            m_cache[i].last_used = ++m_cache_clock;
+            return &m_cache[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for storing an app display name, replacing the least recently used entry. */
+static void cache_insert(uint8_t const * p_app_id, uint8_t const * p_name)
+{
+    name_cache_entry_t * p_victim = &m_cache[0];
+    uint32_t             i;
+
+    for (i = 1; i < ANCS_NOTIF_CACHE_SIZE; i++)
+    {
+        if (m_cache[i].last_used < p_victim->last_used)
+        {
+            p_victim = &m_cache[i];
+        }
+    }
+
+    strncpy((char *)p_victim->app_id, (char const *)p_app_id, sizeof(p_victim->app_id) - 1);
+    strncpy((char *)p_victim->name, (char const *)p_name, sizeof(p_victim->name) - 1);
+    p_victim->app_id[sizeof(p_victim->app_id) - 1] = '\0';
+    p_victim->name[sizeof(p_victim->name) - 1]     = '\0';
+    p_victim->last_used                            = ++m_cache_clock;
+}
+
+
+/**@brief Function for appending one NUL-terminated field to the inbox record being composed. */
+static uint16_t field_append(uint8_t * p_dst, uint16_t offset, uint8_t const * p_field)
+{
+    uint16_t len = strlen((char const *)p_field);
+
+    if (len > INBOX_MSG_MAX_LEN - offset)
+    {
+        len = INBOX_MSG_MAX_LEN - offset;
+    }
+    memcpy(&p_dst[offset], p_field, len);
+    return offset + len;
+}
+
+
+/**@brief Function for appending the notifications waiting for the inbox, as long as it takes them.
+ *
+ * @details The inbox writes one message at a time. A notification it refuses as busy stays
+ *          first in the ring, and is appended again from ancs_notif_on_inbox_append_done().
+ */
+static void pending_drain(void)
+{
+    pending_entry_t * p_entry;
+    uint32_t          err_code;
+
+    while (m_pending_count > 0)
+    {
+        p_entry  = &m_pending[m_pending_head];
+        err_code = inbox_append(p_entry->notif_uid, p_entry->timestamp, INBOX_FLAG_UNREAD,
+                                p_entry->record, p_entry->length);
+        if (err_code == NRF_ERROR_BUSY)
+        {
+            return;
+        }
+        if (err_code == NRF_SUCCESS)
+        {
+            m_stats.notifications++;
+            m_stats.gatt_ops     += p_entry->gatt_ops;
+            m_stats.last_gatt_ops = p_entry->gatt_ops;
+        }
+        else
+        {
+            m_stats.dropped++;
+        }
+        m_pending_head = (m_pending_head + 1) % ANCS_NOTIF_PENDING_SIZE;
+        m_pending_count--;
+    }
+}
+
+
+/**@brief Function for storing the fetched notification in the inbox, or queueing it for the inbox
+ *        if a previous append is still being written.
+ */
+static void notif_store(uint8_t const * p_name)
+{
+    static const uint8_t separator[] = "\n";
+    pending_entry_t    * p_entry;
+    uint16_t             len = 0;
+
+    if (m_pending_count == ANCS_NOTIF_PENDING_SIZE)
+    {
+        m_stats.dropped++;
+        return;
+    }
+    p_entry = &m_pending[(m_pending_head + m_pending_count) % ANCS_NOTIF_PENDING_SIZE];
+
+    len = field_append(p_entry->record, len, p_name);
+    len = field_append(p_entry->record, len, separator);
+    len = field_append(p_entry->record, len, m_title);
+    len = field_append(p_entry->record, len, separator);
+    len = field_append(p_entry->record, len, m_message);
+
+    p_entry->notif_uid = m_current.notif_uid;
+    p_entry->timestamp = m_time_get();
+    p_entry->gatt_ops  = m_current_ops;
+    p_entry->length    = len;
+    m_pending_count++;
+
+    pending_drain();
+    if (m_pending_count > 0)
+    {
+        // This one is last in the ring, so it waits.
+        m_stats.deferred++;
+    }
+}
+
+
+/**@brief Function for starting to fetch the next queued notification, if any.
+ *
+ * @details The notifications of all links are fetched one at a time, as the ANCS client stores
+ *          the attributes in the same buffers whichever link they come from.
+ */
+static void fetch_next(void)
+{
+    ble_ancs_c_t * p_ancs;
+    uint32_t       err_code;
+
+    m_state = STATE_IDLE;
+
+    while ((m_state == STATE_IDLE) && (m_queue_count > 0))
+    {
+        memset(&m_current, 0, sizeof(m_current));
+        m_current.notif_uid = m_queue[m_queue_head].notif_uid;
+        m_current_conn      = m_queue[m_queue_head].conn_handle;
+        m_queue_head        = (m_queue_head + 1) % ANCS_NOTIF_QUEUE_SIZE;
+        m_queue_count--;
+
+        m_attrs_pending = REQUESTED_ATTR_COUNT;
+        m_current_ops   = 0;
+
+        p_ancs   = ble_ancs_c_find(m_current_conn);
+        err_code = (p_ancs != NULL) ? ble_ancs_c_request_attrs(p_ancs, &m_current) : NRF_ERROR_INVALID_STATE;
+        if (err_code == NRF_SUCCESS)
+        {
+            m_state = STATE_NOTIF_ATTRS;
+        }
+        else
+        {
+            m_stats.dropped++;
+        }
+    }
+
+    // Each notification gets the whole timeout, for its attributes and the app display name.
+    err_code = app_timer_stop(m_fetch_timer_id);
+    APP_ERROR_CHECK(err_code);
+    if (m_state != STATE_IDLE)
+    {
+        err_code = app_timer_start(m_fetch_timer_id, m_fetch_timeout, NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for dropping a notification the Notification Provider did not answer for.
+ *
+ * @details A late response is ignored: the ANCS client only reports the attributes of the
+ *          notification requested next.
+ */
+static void fetch_timeout_handler(void * p_context)
+{
+    if (m_state == STATE_IDLE)
+    {
+        return;
+    }
+    m_stats.timeouts++;
+    m_stats.dropped++;
+    fetch_next();
+}
+
+
+/**@brief Function for continuing once all notification attributes have been received. */
+static void on_notif_attrs_complete(void)
+{
+    name_cache_entry_t * p_entry = cache_find(m_app_id);
+    uint32_t             err_code;
+
+    if (p_entry != NULL)
+    {
+        m_stats.cache_hits++;
+        notif_store(p_entry->name);
+        fetch_next();
+        return;
+    }
+
+    m_stats.cache_misses++;
+
+    err_code = ble_ancs_c_app_attr_request(ble_ancs_c_find(m_current_conn),
+                                           m_app_id,
+                                           strlen((char *)m_app_id),
+                                           m_app_name,
+                                           ANCS_NOTIF_NAME_MAX_LEN);
+    if (err_code == NRF_SUCCESS)
+    {
+        m_state = STATE_APP_ATTRS;
+    }
+    else
+    {
+        // Without a display name the app identifier is still better than nothing.
+        notif_store(m_app_id);
+        fetch_next();
+    }
+}
+
+
+uint32_t ancs_notif_init(ancs_notif_time_get_t time_get, uint32_t fetch_timeout)
+{
+    uint32_t err_code;
+
+    if (time_get == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_time_get      = time_get;
+    m_fetch_timeout = fetch_timeout;
+
+    err_code = app_timer_create(&m_fetch_timer_id, APP_TIMER_MODE_SINGLE_SHOT, fetch_timeout_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = ble_ancs_c_attr_add(BLE_ANCS_NOTIF_ATTR_ID_APP_IDENTIFIER, m_app_id, BLE_ANCS_ATTR_DATA_MAX);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = ble_ancs_c_attr_add(BLE_ANCS_NOTIF_ATTR_ID_TITLE, m_title, BLE_ANCS_ATTR_DATA_MAX);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return ble_ancs_c_attr_add(BLE_ANCS_NOTIF_ATTR_ID_MESSAGE, m_message, ANCS_NOTIF_MSG_MAX_LEN);
+}
+
+
+void ancs_notif_on_ancs_evt(ble_ancs_c_evt_t const * p_evt)
+{
+    queue_entry_t * p_entry;
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_ANCS_C_EVT_NOTIF:
+            // Notifications that existed before we connected are not pulled, to avoid flooding the
+            // inbox with everything on the phone each time it reconnects.
+            if ((p_evt->notif.evt_id != BLE_ANCS_EVENT_ID_NOTIFICATION_ADDED) ||
+                p_evt->notif.evt_flags.pre_existing)
+            {
+                break;
+            }
+            if (m_queue_count == ANCS_NOTIF_QUEUE_SIZE)
+            {
+                m_stats.dropped++;
+                break;
+            }
+            p_entry              = &m_queue[(m_queue_head + m_queue_count) % ANCS_NOTIF_QUEUE_SIZE];
+            p_entry->conn_handle = p_evt->conn_handle;
+            p_entry->notif_uid   = p_evt->notif.notif_uid;
+            m_queue_count++;
+
+            if (m_state == STATE_IDLE)
+            {
+                fetch_next();
+            }
+            break;
+
+        case BLE_ANCS_C_EVT_NOTIF_ATTRIBUTE:
+            if ((m_state != STATE_NOTIF_ATTRS) ||
+                (p_evt->conn_handle != m_current_conn) ||
+                (p_evt->attr.notif_uid != m_current.notif_uid))
+            {
+                break;
+            }
+            if (--m_attrs_pending == 0)
+            {
+                on_notif_attrs_complete();
+            }
+            break;
+
+        case BLE_ANCS_C_EVT_APP_ATTRIBUTE:
+            if ((m_state != STATE_APP_ATTRS) ||
+                (p_evt->conn_handle != m_current_conn) ||
+                (p_evt->app_attr.attr_id != BLE_ANCS_APP_ATTR_ID_DISPLAY_NAME))
+            {
+                break;
+            }
+            cache_insert(m_app_id, m_app_name);
+            notif_store(m_app_name);
+            fetch_next();
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void ancs_notif_on_inbox_append_done(void)
+{
+    pending_drain();
+}
+
+
+/**@brief Function for checking whether a write response is for the control point of the current
+ *        notification: a write to it, or the execute write of a long request.
+ */
+static bool control_point_write_rsp(ble_gattc_evt_t const * p_gattc_evt)
+{
+    ble_ancs_c_t const * p_ancs = ble_ancs_c_find(m_current_conn);
+
+    if ((p_ancs == NULL) || (p_gattc_evt->conn_handle != m_current_conn))
+    {
+        return false;
+    }
+    return (p_gattc_evt->params.write_rsp.handle == p_ancs->service.control_point.handle_value) ||
+           (p_gattc_evt->params.write_rsp.write_op == BLE_GATT_OP_EXEC_WRITE_REQ);
+}
+
+
+/**@brief Function for dropping the queued notifications of a link. */
+static void queue_link_drop(uint16_t conn_handle)
+{
+    uint8_t count = m_queue_count;
+    uint8_t i;
+
+    m_queue_count = 0;
+    for (i = 0; i < count; i++)
+    {
+        queue_entry_t entry = m_queue[(m_queue_head + i) % ANCS_NOTIF_QUEUE_SIZE];
+
+        if (entry.conn_handle == conn_handle)
+        {
+            m_stats.dropped++;
+        }
+        else
+        {
+            m_queue[(m_queue_head + m_queue_count) % ANCS_NOTIF_QUEUE_SIZE] = entry;
+            m_queue_count++;
+        }
+    }
+}
+
+
+void ancs_notif_on_ble_evt(ble_evt_t const * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GATTC_EVT_WRITE_RSP:
+            if ((m_state == STATE_IDLE) || !control_point_write_rsp(&p_ble_evt->evt.gattc_evt))
+            {
+                break;
+            }
+            m_current_ops++;
+
+            // A rejected request never gets a response; move on to the next notification. The ANCS
+            // client, earlier in the dispatch order, has already dropped the rest of a failed
+            // prepared write, so the next request is not sent behind it.
+            if (p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS)
+            {
+                m_stats.dropped++;
+                fetch_next();
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            // The notifications of the other links are kept.
+            queue_link_drop(p_ble_evt->evt.gap_evt.conn_handle);
+            if ((m_state != STATE_IDLE) && (p_ble_evt->evt.gap_evt.conn_handle == m_current_conn))
+            {
+                m_stats.dropped++;
+                fetch_next();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void ancs_notif_stats_get(ancs_notif_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
@@ -0,0 +1,78 @@
+#ifndef ANCS_NOTIF_H__
+#define ANCS_NOTIF_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ancs_c.h"
+
+#define ANCS_NOTIF_QUEUE_SIZE     8                       /**< Number of iOS notifications waiting for their attributes. */
+#define ANCS_NOTIF_PENDING_SIZE   2                       /**< Number of complete iOS notifications waiting for the inbox to finish an append. */
+#define ANCS_NOTIF_CACHE_SIZE     8                       /**< Number of app display names kept in the cache. */
+#define ANCS_NOTIF_NAME_MAX_LEN   20                      /**< Maximum length of a cached app display name. */
+#define ANCS_NOTIF_MSG_MAX_LEN    BLE_ANCS_ATTR_DATA_MAX  /**< Length the notification message is truncated to. */
+
+
+/**@brief Function for getting the current local time, used to timestamp inbox messages. */
+typedef uint32_t (* ancs_notif_time_get_t)(void);
+
+/**@brief ANCS notification statistics. */
+typedef struct
+{
+    uint32_t notifications;    /**< Notifications stored in the inbox. */
+    uint32_t dropped;          /**< Notifications lost to a full queue or wait ring, a GATT error, a timeout or an inbox error. */
+    uint32_t deferred;         /**< Notifications that waited for the inbox to finish a previous append. */
+    uint32_t timeouts;         /**< Notifications dropped because the Notification Provider did not answer in time. */
+    uint32_t gatt_ops;         /**< Control point writes completed for stored notifications, execute writes included. */
+    uint32_t last_gatt_ops;    /**< Control point writes completed for the latest stored notification. */
+    uint32_t cache_hits;       /**< App display names found in the cache. */
+    uint32_t cache_misses;     /**< App display names requested from the Notification Provider. */
+} ancs_notif_stats_t;
+
+
+/**@brief Function for initializing the ANCS notification fetcher.
+ *
+ * @details Registers the notification attributes shown on the watch (app identifier, title and
+ *          a truncated message) with the ANCS client. Must be called after ble_ancs_c_init() and
+ *          after the app timer module is initialized.
+ *
+ * @param[in] time_get       Function returning the local time.
+ * @param[in] fetch_timeout  Time the Notification Provider gets to answer for one notification,
+ *                           in app timer ticks. The notification is dropped after it.
+ *
+ * @retval NRF_SUCCESS    If the module was initialized.
+ * @retval NRF_ERROR_NULL If a parameter is NULL.
+ */
+uint32_t ancs_notif_init(ancs_notif_time_get_t time_get, uint32_t fetch_timeout);
+
+/**@brief Function for handling the ANCS client events.
+ *
+ * @details Added notifications are queued and their attributes fetched one notification at a
+ *          time, whichever link they come from. The app display name is only requested when it is not in the cache. Complete
+ *          notifications are appended to the inbox as "name\ntitle\nmessage", waiting in a small ring
+ *          while the inbox writes a previous one. A notification
+ *          the Notification Provider does not answer for within the fetch timeout is dropped.
+ *
+ * @param[in] p_evt  ANCS client event.
+ */
+void ancs_notif_on_ancs_evt(ble_ancs_c_evt_t const * p_evt);
+
+/**@brief Function for handling the BLE stack events.
+ *
+ * @details Counts and checks the control point write responses of the current notification, and drops the notifications of a
+ *          link on its disconnection.
+ *
+ * @param[in] p_ble_evt  Bluetooth stack event.
+ */
+void ancs_notif_on_ble_evt(ble_evt_t const * p_ble_evt);
+
+/**@brief Function for handling the end of an inbox append, successful or not.
+ *
+ * @details Appends the next notification that waited for the inbox, if any. Must be called from
+ *          the inbox append handler.
+ */
+void ancs_notif_on_inbox_append_done(void);
+
+/**@brief Function for getting the ANCS notification statistics. */
+void ancs_notif_stats_get(ancs_notif_stats_t * p_stats);
+
+#endif /* ANCS_NOTIF_H__ */
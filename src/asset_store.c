@@ -0,0 +1,501 @@
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "pstorage.h"
+#include "sha256.h"
+#include "asset_store.h"
+
+#define ASSET_TRAILER_MAGIC   0x54535341  /**< Marks a valid asset trailer ("ASST"). */
+#define ASSET_TRAILER_SIZE    16          /**< Space reserved for the trailer at the end of the last page. */
+#define STAGE_COUNT           2           /**< Number of staging buffers; one fills while the other is written. */
+
+#define WORD_ALIGN(X)         (((X) + 3) & ~3)
+
+/**@brief Trailer written in the last bytes of the asset area once an asset has been verified. */
+typedef struct
+{
+    uint32_t magic;      /**< ASSET_TRAILER_MAGIC. */
+    uint32_t asset_id;   /**< Identifier of the asset. */
+    uint32_t length;     /**< Length of the asset in bytes. */
+    uint32_t reserved;
+} asset_trailer_t;
+
+
+static asset_store_evt_handler_t m_evt_handler;                 /**< Event handler. */
+static pstorage_handle_t         m_storage;                     /**< Base handle of the asset area, one block per page. */
+static uint16_t                  m_page_size;                   /**< Flash page size. */
+static bool                      m_initialized;                 /**< Set once the area has been registered. */
+
+static bool                      m_active;                      /**< A transfer has been started and not abandoned. */
+static bool                      m_finishing;                   /**< All data was received; waiting for flash. */
+static bool                      m_failed;                      /**< A flash operation of the transfer failed. */
+static uint16_t                  m_asset_id;                    /**< Identifier of the asset being received. */
+static uint32_t                  m_length;                      /**< Length of the asset being received. */
+static uint32_t                  m_offset;                      /**< Bytes accepted so far. */
+static uint32_t                  m_durable;                     /**< Bytes known to be in flash. */
+static uint32_t                  m_erased;                      /**< Bitmask of the pages erased for this transfer. */
+static uint8_t                   m_pending_ops;                 /**< Flash operations queued and not yet completed. */
+
+static uint32_t                  m_stage[STAGE_COUNT][ASSET_STORE_STAGE_SIZE / sizeof(uint32_t)]; /**< Staging buffers, resident until their store completes. */
+static bool                      m_stage_busy[STAGE_COUNT];     /**< Whether a staging buffer is being written to flash. */
+static uint32_t                  m_stage_offset[STAGE_COUNT];   /**< Asset offset each staging buffer is being written to. */
+static uint8_t                   m_fill;                        /**< Staging buffer being filled. */
+static uint32_t                  m_fill_offset;                 /**< Asset offset of the staging buffer being filled. */
+static uint16_t                  m_fill_len;                    /**< Bytes in the staging buffer being filled. */
+
+static sha256_context_t          m_hash;                        /**< Running digest of the accepted data. */
+static uint8_t                   m_digest[ASSET_STORE_DIGEST_LEN]; /**< Final digest of the asset. */
+static asset_trailer_t           m_trailer;                     /**< Source buffer of a trailer store. */
+
+static asset_store_stats_t       m_stats;                       /**< Statistics. */
+
+
+static uint8_t const * area_address(void)
+{
+    return (uint8_t const *)m_storage.block_id;
+}
+
+
+static asset_trailer_t const * trailer_address(void)
+{
+    return (asset_trailer_t const *)(area_address() +
+                                     (uint32_t)ASSET_STORE_PAGE_COUNT * m_page_size -
+                                     ASSET_TRAILER_SIZE);
+}
+
+
+static void evt_send(asset_store_evt_type_t evt_type)
+{
+    asset_store_evt_t evt;
+
+    evt.evt_type = evt_type;
+    evt.p_digest = (evt_type == ASSET_STORE_EVT_COMPLETE) ? m_digest : NULL;
+
+    m_evt_handler(&evt);
+}
+
+
+/**@brief Function for erasing an asset page, unless it was already erased for this transfer. */
+static uint32_t page_erase(uint32_t page)
+{
+    uint32_t          err_code;
+    pstorage_handle_t handle;
+
+    if (m_erased & (1UL << page))
+    {
+        return NRF_SUCCESS;
+    }
+
+    err_code = pstorage_block_identifier_get(&m_storage, page, &handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = pstorage_clear(&handle, m_page_size);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_erased |= (1UL << page);
+    m_pending_ops++;
+    m_stats.page_erases++;
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for writing the staging buffer being filled to flash and switching to the other.
+ *
+ * @details A staging buffer never crosses a page boundary, so the page it lands in is erased the
+ *          first time the transfer reaches it.
+ */
+static uint32_t stage_flush(void)
+{
+    uint32_t          err_code;
+    uint32_t          offset = m_fill_offset;
+    uint16_t          size   = WORD_ALIGN(m_fill_len);
+    pstorage_handle_t handle;
+
+    // Pad the last, partial buffer of an asset with the erased flash value.
+    memset((uint8_t *)m_stage[m_fill] + m_fill_len, 0xFF, size - m_fill_len);
+
+    err_code = page_erase(offset / m_page_size);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = pstorage_block_identifier_get(&m_storage, offset / m_page_size, &handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = pstorage_store(&handle, (uint8_t *)m_stage[m_fill], size, offset % m_page_size);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_stage_busy[m_fill]   = true;
+    m_stage_offset[m_fill] = offset;
+    m_pending_ops++;
+    m_stats.stores++;
+
+    m_fill        = (m_fill + 1) % STAGE_COUNT;
+    m_fill_len    = 0;
+    m_fill_offset = offset + ASSET_STORE_STAGE_SIZE;
+
+    return NRF_SUCCESS;
+}
+
+
+static void transfer_fail(void)
+{
+    m_failed    = true;
+    m_active    = false;
+    m_finishing = false;
+    evt_send(ASSET_STORE_EVT_ERROR);
+}
+
+
+static void transfer_complete(void)
+{
+    m_finishing = false;
+    (void)sha256_final(&m_hash, m_digest);
+    evt_send(ASSET_STORE_EVT_COMPLETE);
+}
+
+
+static void pstorage_cb_handler(pstorage_handle_t * p_handle,
+                                uint8_t             op_code,
+                                uint32_t            result,
+                                uint8_t           * p_data,
+                                uint32_t            data_len)
+{
+    uint32_t i;
+    bool     was_active = m_active && !m_failed;
+
+    if ((op_code == PSTORAGE_STORE_OP_CODE) && (p_data == (uint8_t *)&m_trailer))
+    {
+        evt_send((result == NRF_SUCCESS) ? ASSET_STORE_EVT_COMMITTED : ASSET_STORE_EVT_ERROR);
+        return;
+    }
+
+    if ((op_code != PSTORAGE_STORE_OP_CODE) && (op_code != PSTORAGE_CLEAR_OP_CODE))
+    {
+        return;
+    }
+
+    m_pending_ops--;
+
+    for (i = 0; (op_code == PSTORAGE_STORE_OP_CODE) && (i < STAGE_COUNT); i++)
+    {
+        if (p_data == (uint8_t *)m_stage[i])
+        {
+            m_stage_busy[i] = false;
+            if (result == NRF_SUCCESS)
+            {
+                m_durable             = m_stage_offset[i] + data_len;
+                m_stats.bytes_stored += data_len;
+                if (m_durable > m_length)
+                {
+                    m_durable = m_length;
+                }
+            }
+        }
+    }
+
+    if (!was_active)
+    {
+        return;
+    }
+
+    if (result != NRF_SUCCESS)
+    {
+        transfer_fail();
+    }
+    else if (m_finishing)
+    {
+        if (m_pending_ops == 0)
+        {
+            transfer_complete();
+        }
+    }
+    else if (op_code == PSTORAGE_STORE_OP_CODE)
+    {
+        evt_send(ASSET_STORE_EVT_SPACE_AVAILABLE);
+    }
+}
+
+
+uint32_t asset_store_init(asset_store_evt_handler_t evt_handler)
+{
+    uint32_t                err_code;
+    pstorage_module_param_t param;
+
+    if (evt_handler == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_evt_handler = evt_handler;
+    m_page_size   = PSTORAGE_FLASH_PAGE_SIZE;
+
+    param.block_size  = m_page_size;
+    param.block_count = ASSET_STORE_PAGE_COUNT;
+    param.cb          = pstorage_cb_handler;
+
+    err_code = pstorage_register(&param, &m_storage);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_initialized = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t asset_store_max_length(void)
+{
+    return (uint32_t)ASSET_STORE_PAGE_COUNT * m_page_size - ASSET_TRAILER_SIZE;
+}
+
+
+uint32_t asset_store_begin(uint16_t asset_id, uint32_t length, uint32_t * p_resume_offset)
+{
+    uint32_t err_code;
+
+    if (!m_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_pending_ops != 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if ((length == 0) || (length > asset_store_max_length()))
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    m_finishing = false;
+    m_fill      = 0;
+    m_fill_len  = 0;
+
+    if (m_active && (asset_id == m_asset_id) && (length == m_length) && (m_durable < m_length))
+    {
+        // Data staged but not yet in flash when the link dropped is received again.
+        m_offset      = m_durable;
+        m_fill_offset = m_durable;
+
+        (void)sha256_init(&m_hash);
+        (void)sha256_update(&m_hash, area_address(), m_durable);
+
+        m_stats.resumes++;
+        *p_resume_offset = m_durable;
+        return NRF_SUCCESS;
+    }
+
+    m_active          = true;
+    m_failed          = false;
+    m_asset_id        = asset_id;
+    m_length          = length;
+    m_offset          = 0;
+    m_durable         = 0;
+    m_erased          = 0;
+    m_fill_offset     = 0;
+
+    (void)sha256_init(&m_hash);
+
+    // Erasing the last page first invalidates the trailer of the previous asset.
+    err_code = page_erase(ASSET_STORE_PAGE_COUNT - 1);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_active = false;
+        return err_code;
+    }
+
+    *p_resume_offset = 0;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t asset_store_free_space(void)
+{
+    uint32_t space;
+    uint32_t i;
+
+    if (!m_active || m_finishing || m_stage_busy[m_fill])
+    {
+        return 0;
+    }
+
+    space = ASSET_STORE_STAGE_SIZE - m_fill_len;
+    for (i = 1; i < STAGE_COUNT; i++)
+    {
+        if (m_stage_busy[(m_fill + i) % STAGE_COUNT])
+        {
+            break;
+        }
+        space += ASSET_STORE_STAGE_SIZE;
+    }
+
+    return MIN(space, m_length - m_offset);
+}
+
+
+uint32_t asset_store_write(uint8_t const * p_data, uint16_t length)
+{
+    uint32_t err_code;
+    uint16_t chunk;
+
+    if (!m_active || m_finishing)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (length > m_length - m_offset)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if (length > asset_store_free_space())
+    {
+        m_stats.stalls++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    (void)sha256_update(&m_hash, p_data, length);
+    m_offset               += length;
+    m_stats.bytes_received += length;
+
+    while (length > 0)
+    {
+        chunk = MIN(length, ASSET_STORE_STAGE_SIZE - m_fill_len);
+
+        memcpy((uint8_t *)m_stage[m_fill] + m_fill_len, p_data, chunk);
+        m_fill_len += chunk;
+        p_data     += chunk;
+        length     -= chunk;
+
+        if (m_fill_len == ASSET_STORE_STAGE_SIZE)
+        {
+            err_code = stage_flush();
+            if (err_code != NRF_SUCCESS)
+            {
+                transfer_fail();
+                return err_code;
+            }
+        }
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t asset_store_remaining(void)
+{
+    return m_active ? m_length - m_offset : 0;
+}
+
+
+uint32_t asset_store_finish(void)
+{
+    uint32_t err_code;
+
+    if (!m_active || m_finishing || (m_offset != m_length))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (m_fill_len > 0)
+    {
+        err_code = stage_flush();
+        if (err_code != NRF_SUCCESS)
+        {
+            transfer_fail();
+            return err_code;
+        }
+    }
+
+    m_finishing = true;
+    if (m_pending_ops == 0)
+    {
+        transfer_complete();
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t asset_store_commit(void)
+{
+    uint32_t          err_code;
+    pstorage_handle_t handle;
+
+    if (!m_active || m_finishing || (m_durable != m_length))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    err_code = pstorage_block_identifier_get(&m_storage, ASSET_STORE_PAGE_COUNT - 1, &handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_trailer.magic    = ASSET_TRAILER_MAGIC;
+    m_trailer.asset_id = m_asset_id;
+    m_trailer.length   = m_length;
+    m_trailer.reserved = 0xFFFFFFFF;
+
+    err_code = pstorage_store(&handle,
+                              (uint8_t *)&m_trailer,
+                              sizeof(m_trailer),
+                              m_page_size - ASSET_TRAILER_SIZE);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_active = false;
+    return NRF_SUCCESS;
+}
+
+
+void asset_store_abort(void)
+{
+    m_active    = false;
+    m_finishing = false;
+}
+
+
+uint8_t const * asset_store_asset_get(uint16_t * p_asset_id, uint32_t * p_length)
+{
+    asset_trailer_t const * p_trailer;
+
+    if (!m_initialized)
+    {
+        return NULL;
+    }
+
+    p_trailer = trailer_address();
+    if ((p_trailer->magic != ASSET_TRAILER_MAGIC) || (p_trailer->length > asset_store_max_length()))
+    {
+        return NULL;
+    }
+
+    *p_asset_id = (uint16_t)p_trailer->asset_id;
+    *p_length   = p_trailer->length;
+
+    return area_address();
+}
+
+
+void asset_store_stats_get(asset_store_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
@@ -0,0 +1,125 @@
+#ifndef ASSET_STORE_H__
+#define ASSET_STORE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ASSET_STORE_PAGE_COUNT    16     /**< Number of flash pages reserved for assets. */
+#define ASSET_STORE_STAGE_SIZE    256    /**< Size of one RAM staging buffer. Must divide the flash page size. */
+#define ASSET_STORE_DIGEST_LEN    32     /**< Length of the SHA-256 digest of an asset. */
+
+
+/**@brief Asset store event types. */
+typedef enum
+{
+    ASSET_STORE_EVT_SPACE_AVAILABLE,  /**< A staging buffer was written to flash and can take new data. */
+    ASSET_STORE_EVT_COMPLETE,         /**< All data of the asset is in flash. p_digest holds its SHA-256. */
+    ASSET_STORE_EVT_COMMITTED,        /**< The trailer of asset_store_commit() is in flash; the asset is valid. */
+    ASSET_STORE_EVT_ERROR             /**< A flash operation failed. The transfer must be restarted. */
+} asset_store_evt_type_t;
+
+/**@brief Asset store event. */
+typedef struct
+{
+    asset_store_evt_type_t evt_type;  /**< Type of event. */
+    uint8_t const *        p_digest;  /**< SHA-256 of the asset, for ASSET_STORE_EVT_COMPLETE. */
+} asset_store_evt_t;
+
+/**@brief Asset store event handler type. */
+typedef void (* asset_store_evt_handler_t)(asset_store_evt_t const * p_evt);
+
+/**@brief Asset store statistics. */
+typedef struct
+{
+    uint32_t bytes_received;  /**< Bytes accepted by asset_store_write(). */
+    uint32_t bytes_stored;    /**< Bytes written to flash, including padding. */
+    uint32_t stores;          /**< Flash store operations. */
+    uint32_t page_erases;     /**< Flash pages erased. */
+    uint32_t stalls;          /**< Writes refused because both staging buffers were in flight. */
+    uint32_t resumes;         /**< Transfers resumed from data already in flash. */
+} asset_store_stats_t;
+
+
+/**@brief Function for initializing the asset store.
+ *
+ * @details Registers the asset area with pstorage and looks for a completed asset from a previous
+ *          session. pstorage_init() must have been called.
+ *
+ * @param[in] evt_handler  Event handler.
+ *
+ * @retval NRF_SUCCESS    If the store was initialized. Otherwise an error code from pstorage.
+ * @retval NRF_ERROR_NULL If evt_handler is NULL.
+ */
+uint32_t asset_store_init(asset_store_evt_handler_t evt_handler);
+
+/**@brief Function for getting the largest asset that fits in the store. */
+uint32_t asset_store_max_length(void);
+
+/**@brief Function for starting or resuming an asset transfer.
+ *
+ * @details If the same asset was being received when the previous transfer was interrupted, the
+ *          transfer resumes after the data already in flash, and the digest is recomputed over it.
+ *          Otherwise the previous asset is invalidated and the transfer starts from the beginning.
+ *          What was interrupted is known in RAM only: after a reset every transfer starts over.
+ *
+ * @param[in]  asset_id         Identifier of the asset.
+ * @param[in]  length           Length of the asset in bytes.
+ * @param[out] p_resume_offset  Offset the sender must continue from.
+ *
+ * @retval NRF_SUCCESS              If the transfer can proceed.
+ * @retval NRF_ERROR_BUSY           If flash operations of the previous transfer are still pending.
+ * @retval NRF_ERROR_DATA_SIZE      If length is 0 or exceeds asset_store_max_length().
+ * @retval NRF_ERROR_INVALID_STATE  If the store is not initialized.
+ */
+uint32_t asset_store_begin(uint16_t asset_id, uint32_t length, uint32_t * p_resume_offset);
+
+/**@brief Function for getting the number of bytes asset_store_write() can take right now. */
+uint32_t asset_store_free_space(void);
+
+/**@brief Function for appending data to the asset being received.
+ *
+ * @details The data is hashed and copied to a staging buffer, which is written to flash once full.
+ *
+ * @retval NRF_SUCCESS              If the data was accepted.
+ * @retval NRF_ERROR_NO_MEM         If the staging buffers cannot take the data. Nothing was accepted.
+ * @retval NRF_ERROR_DATA_SIZE      If the data runs past the announced length.
+ * @retval NRF_ERROR_INVALID_STATE  If no transfer is in progress.
+ */
+uint32_t asset_store_write(uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for getting the number of bytes still expected in the current transfer. */
+uint32_t asset_store_remaining(void);
+
+/**@brief Function for finishing a transfer once all data has been written.
+ *
+ * @details Flushes the last staging buffer. ASSET_STORE_EVT_COMPLETE is sent with the digest once
+ *          all data is in flash. The asset becomes valid only after asset_store_commit().
+ *
+ * @retval NRF_SUCCESS              If the transfer is being finished.
+ * @retval NRF_ERROR_INVALID_STATE  If no transfer is in progress or data is missing.
+ */
+uint32_t asset_store_finish(void);
+
+/**@brief Function for marking the finished asset as valid, after its digest was checked.
+ *
+ * @details Writes the trailer of the asset. ASSET_STORE_EVT_COMMITTED is sent once it is in flash,
+ *          or ASSET_STORE_EVT_ERROR if the write failed.
+ */
+uint32_t asset_store_commit(void);
+
+/**@brief Function for abandoning the current transfer. The next transfer starts from the beginning. */
+void asset_store_abort(void);
+
+/**@brief Function for getting the valid asset in the store.
+ *
+ * @param[out] p_asset_id  Identifier of the asset.
+ * @param[out] p_length    Length of the asset.
+ *
+ * @return Pointer to the asset in flash, or NULL if the store holds no valid asset.
+ */
+uint8_t const * asset_store_asset_get(uint16_t * p_asset_id, uint32_t * p_length);
+
+/**@brief Function for getting the asset store statistics. */
+void asset_store_stats_get(asset_store_stats_t * p_stats);
+
+#endif /* ASSET_STORE_H__ */
@@ -0,0 +1,570 @@
+#include <string.h>
+#include "nrf.h"
+#include "nordic_common.h"
+#include "app_util.h"
+#include "cycle_counter.h"
+#include "lz_decoder.h"
+#include "ble_asset.h"
+
+#define DIGEST_PART_LEN       (ASSET_STORE_DIGEST_LEN / 2)  /**< Digest bytes carried by one DIGEST request. */
+#define DIGEST_PARTS_ALL      0x03                          /**< Both digest parts received. */
+#define DECODE_BUF_SIZE       64                            /**< Decoder output passed to the asset store at a time. */
+
+
+static ble_asset_t * mp_asset;   /**< Service instance, for the asset store events. */
+static lz_decoder_t  m_decoder;  /**< Decoder of compressed transfers. */
+
+
+/**@brief Function for sending a notification on the control point. */
+static uint32_t ctrl_notify(ble_asset_t * p_asset, uint16_t conn_handle, uint8_t * p_data, uint16_t length)
+{
+    ble_gatts_hvx_params_t hvx_params;
+
+    if (conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle = p_asset->ctrl_handles.value_handle;
+    hvx_params.p_data = p_data;
+    hvx_params.p_len  = &length;
+    hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+
+    return sd_ble_gatts_hvx(conn_handle, &hvx_params);
+}
+
+
+static void status_send(ble_asset_t * p_asset, uint16_t conn_handle, uint8_t op, uint8_t status)
+{
+    uint8_t rsp[2];
+
+    rsp[0] = op;
+    rsp[1] = status;
+
+    (void)ctrl_notify(p_asset, conn_handle, rsp, sizeof(rsp));
+}
+
+
+/**@brief Function for getting the sequence number up to which the phone may send.
+ *
+ * @details Credits cover the chunks that fit in the staging buffers right now, or in the decoder
+ *          input buffer for a compressed transfer, so chunks written without response are never
+ *          dropped for lack of space.
+ */
+static uint16_t credit_limit_get(ble_asset_t * p_asset)
+{
+    uint32_t space;
+    uint32_t credits;
+
+    if (p_asset->compressed)
+    {
+        return (uint16_t)(p_asset->next_seq + lz_decoder_sink_space(&m_decoder) / BLE_ASSET_CHUNK_LEN);
+    }
+
+    space   = asset_store_free_space();
+    credits = space / BLE_ASSET_CHUNK_LEN;
+
+    // The last chunk of an asset may be short; grant it once the rest of the asset fits.
+    if ((space == asset_store_remaining()) && ((space % BLE_ASSET_CHUNK_LEN) != 0))
+    {
+        credits++;
+    }
+
+    return (uint16_t)(p_asset->next_seq + credits);
+}
+
+
+/**@brief Function for notifying the credit limit, if it grew enough to be worth a packet.
+ *
+ * @param[in] force  Send even if the limit did not change, to report a sequence gap.
+ */
+static void credit_update(ble_asset_t * p_asset, bool force)
+{
+    uint8_t  msg[5];
+    uint16_t limit = credit_limit_get(p_asset);
+    uint16_t grant = (uint16_t)(limit - p_asset->credit_limit);
+    uint32_t err_code;
+
+    if (!force && !p_asset->credit_pending)
+    {
+        // Wait for a batch, unless the phone has used up all of its credits.
+        if ((grant == 0) ||
+            ((grant < p_asset->credit_batch) && (p_asset->credit_limit != p_asset->next_seq)))
+        {
+            return;
+        }
+    }
+
+    // Until the missing chunk arrives, every credit also asks for the resend.
+    msg[0] = p_asset->nack_sent ? ASSET_OP_RESEND : ASSET_OP_CREDIT;
+    (void)uint16_encode(limit, &msg[1]);
+    (void)uint16_encode(p_asset->next_seq, &msg[3]);
+
+    err_code = ctrl_notify(p_asset, p_asset->conn_handle, msg, sizeof(msg));
+    if (err_code == BLE_ERROR_NO_TX_BUFFERS)
+    {
+        // Retried on the next BLE_EVT_TX_COMPLETE.
+        p_asset->credit_pending = true;
+        p_asset->stats.notify_deferred++;
+        return;
+    }
+
+    p_asset->credit_pending = false;
+    if (err_code == NRF_SUCCESS)
+    {
+        p_asset->credit_limit = limit;
+        p_asset->stats.credits_sent++;
+    }
+}
+
+
+/**@brief Function for passing decoded data to the asset store, as far as the staging buffers allow. */
+static void decode(ble_asset_t * p_asset)
+{
+    uint8_t  buf[DECODE_BUF_SIZE];
+    uint32_t space;
+    uint32_t start;
+    uint16_t produced;
+
+    if (!p_asset->compressed)
+    {
+        return;
+    }
+
+    while ((space = asset_store_free_space()) > 0)
+    {
+        start    = DWT->CYCCNT;
+        produced = lz_decoder_poll(&m_decoder, buf, (uint16_t)MIN(space, sizeof(buf)));
+        p_asset->stats.decode_cycles += DWT->CYCCNT - start;
+
+        if (produced == 0)
+        {
+            break;
+        }
+
+        // Cannot fail: the output was limited to the free space.
+        (void)asset_store_write(buf, produced);
+        p_asset->stats.decoded_bytes += produced;
+    }
+}
+
+
+/**@brief Function for finishing the transfer once COMMIT was received and all data was decoded. */
+static void commit_try(ble_asset_t * p_asset)
+{
+    if (!p_asset->commit_requested)
+    {
+        return;
+    }
+    if (p_asset->compressed && (asset_store_remaining() > 0) && (asset_store_free_space() == 0))
+    {
+        // The decoder waits for a staging buffer; retried on ASSET_STORE_EVT_SPACE_AVAILABLE.
+        return;
+    }
+
+    p_asset->commit_requested = false;
+
+    // The response is sent once the data is in flash and the digest is known.
+    if ((p_asset->digest_parts != DIGEST_PARTS_ALL) || (asset_store_finish() != NRF_SUCCESS))
+    {
+        status_send(p_asset, p_asset->conn_handle, ASSET_OP_COMMIT_RSP, ASSET_STATUS_INVALID);
+    }
+}
+
+
+static void on_begin(ble_asset_t * p_asset, uint16_t conn_handle, uint8_t const * p_data, uint16_t len)
+{
+    uint8_t  rsp[6];
+    uint32_t resume_offset = 0;
+    uint8_t  flags         = 0;
+    uint32_t err_code;
+
+    if ((len != 7) && (len != 8))
+    {
+        return;
+    }
+    if (len == 8)
+    {
+        flags = p_data[7];
+    }
+    if (((p_asset->conn_handle != BLE_CONN_HANDLE_INVALID) && (p_asset->conn_handle != conn_handle)) ||
+        p_asset->committing)
+    {
+        // One transfer at a time, owned by the link that started it, until its trailer is in flash.
+        status_send(p_asset, conn_handle, ASSET_OP_BEGIN_RSP, ASSET_STATUS_BUSY);
+        return;
+    }
+
+    p_asset->conn_handle = conn_handle;
+
+    if (flags & ASSET_FLAG_COMPRESSED)
+    {
+        // The decoder state is not kept across links, so compressed transfers restart from 0.
+        asset_store_abort();
+    }
+
+    err_code = asset_store_begin(uint16_decode(&p_data[1]), uint32_decode(&p_data[3]), &resume_offset);
+    switch (err_code)
+    {
+        case NRF_SUCCESS:
+            rsp[1] = ASSET_STATUS_SUCCESS;
+            break;
+
+        case NRF_ERROR_BUSY:
+            rsp[1] = ASSET_STATUS_BUSY;
+            break;
+
+        case NRF_ERROR_DATA_SIZE:
+            rsp[1] = ASSET_STATUS_TOO_LARGE;
+            break;
+
+        default:
+            rsp[1] = ASSET_STATUS_FLASH_ERROR;
+            break;
+    }
+
+    rsp[0] = ASSET_OP_BEGIN_RSP;
+    (void)uint32_encode(resume_offset, &rsp[2]);
+    (void)ctrl_notify(p_asset, conn_handle, rsp, sizeof(rsp));
+
+    if (err_code != NRF_SUCCESS)
+    {
+        p_asset->conn_handle = BLE_CONN_HANDLE_INVALID;
+        return;
+    }
+
+    p_asset->next_seq         = 0;
+    p_asset->credit_limit     = 0;
+    p_asset->credit_pending   = false;
+    p_asset->nack_sent        = false;
+    p_asset->compressed       = ((flags & ASSET_FLAG_COMPRESSED) != 0);
+    p_asset->commit_requested = false;
+    p_asset->digest_parts     = 0;
+
+    lz_decoder_init(&m_decoder);
+
+    credit_update(p_asset, true);
+}
+
+
+static void on_ctrl_write(ble_asset_t * p_asset, uint16_t conn_handle, uint8_t const * p_data, uint16_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+
+    if (p_data[0] == ASSET_OP_BEGIN)
+    {
+        on_begin(p_asset, conn_handle, p_data, len);
+        return;
+    }
+
+    if (conn_handle != p_asset->conn_handle)
+    {
+        return;
+    }
+
+    switch (p_data[0])
+    {
+        case ASSET_OP_DIGEST:
+            if ((len != 2 + DIGEST_PART_LEN) || (p_data[1] > 1))
+            {
+                status_send(p_asset, conn_handle, ASSET_OP_DIGEST_RSP, ASSET_STATUS_INVALID);
+                break;
+            }
+            memcpy(&p_asset->digest[p_data[1] * DIGEST_PART_LEN], &p_data[2], DIGEST_PART_LEN);
+            p_asset->digest_parts |= (1 << p_data[1]);
+            break;
+
+        case ASSET_OP_COMMIT:
+            p_asset->commit_requested = true;
+            commit_try(p_asset);
+            break;
+
+        case ASSET_OP_ABORT:
+            asset_store_abort();
+            p_asset->conn_handle      = BLE_CONN_HANDLE_INVALID;
+            p_asset->commit_requested = false;
+            break;
+
+        default:
+            status_send(p_asset, conn_handle, p_data[0] | ASSET_OP_RSP_FLAG, ASSET_STATUS_INVALID);
+            break;
+    }
+}
+
+
+/**@brief Function for asking the phone to resend from the first missing chunk.
+ *
+ * @details Chunks after a gap are discarded. The gap is reported once; the phone then resends
+ *          everything from the sequence number in the RESEND notification.
+ */
+static void gap_report(ble_asset_t * p_asset)
+{
+    p_asset->stats.out_of_sequence++;
+    if (!p_asset->nack_sent)
+    {
+        p_asset->nack_sent = true;
+        credit_update(p_asset, true);
+    }
+}
+
+
+static void on_data_write(ble_asset_t * p_asset, uint16_t conn_handle, uint8_t const * p_data, uint16_t len)
+{
+    uint32_t err_code;
+
+    if ((conn_handle != p_asset->conn_handle) || (len <= 2))
+    {
+        return;
+    }
+
+    if (uint16_decode(p_data) != p_asset->next_seq)
+    {
+        gap_report(p_asset);
+        return;
+    }
+
+    if (p_asset->compressed)
+    {
+        err_code = lz_decoder_sink(&m_decoder, &p_data[2], len - 2);
+    }
+    else
+    {
+        err_code = asset_store_write(&p_data[2], len - 2);
+    }
+    if (err_code != NRF_SUCCESS)
+    {
+        // Sent beyond its credits; handled like a lost chunk.
+        gap_report(p_asset);
+        return;
+    }
+
+    p_asset->next_seq++;
+    p_asset->nack_sent = false;
+    p_asset->stats.chunks++;
+
+    if (p_asset->compressed)
+    {
+        p_asset->stats.compressed_bytes += len - 2;
+        decode(p_asset);
+    }
+
+    credit_update(p_asset, false);
+}
+
+
+static void on_write(ble_asset_t * p_asset, ble_evt_t const * p_ble_evt)
+{
+    ble_gatts_evt_write_t const * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+    uint16_t                      conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+
+    if (p_evt_write->handle == p_asset->data_handles.value_handle)
+    {
+        on_data_write(p_asset, conn_handle, p_evt_write->data, p_evt_write->len);
+    }
+    else if (p_evt_write->handle == p_asset->ctrl_handles.value_handle)
+    {
+        on_ctrl_write(p_asset, conn_handle, p_evt_write->data, p_evt_write->len);
+    }
+}
+
+
+static void asset_store_evt_handler(asset_store_evt_t const * p_evt)
+{
+    ble_asset_t * p_asset = mp_asset;
+
+    switch (p_evt->evt_type)
+    {
+        case ASSET_STORE_EVT_SPACE_AVAILABLE:
+            decode(p_asset);
+            commit_try(p_asset);
+            credit_update(p_asset, false);
+            break;
+
+        case ASSET_STORE_EVT_COMPLETE:
+            // The transfer keeps its link until the trailer is in flash, for the final status.
+            if (memcmp(p_evt->p_digest, p_asset->digest, ASSET_STORE_DIGEST_LEN) == 0 &&
+                asset_store_commit() == NRF_SUCCESS)
+            {
+                p_asset->committing = true;
+                break;
+            }
+            asset_store_abort();
+            status_send(p_asset, p_asset->conn_handle, ASSET_OP_COMMIT_RSP, ASSET_STATUS_DIGEST_MISMATCH);
+            p_asset->conn_handle = BLE_CONN_HANDLE_INVALID;
+            break;
+
+        case ASSET_STORE_EVT_COMMITTED:
+            status_send(p_asset, p_asset->conn_handle, ASSET_OP_COMMIT_RSP, ASSET_STATUS_SUCCESS);
+            p_asset->conn_handle = BLE_CONN_HANDLE_INVALID;
+            p_asset->committing  = false;
+            break;
+
+        case ASSET_STORE_EVT_ERROR:
+            status_send(p_asset, p_asset->conn_handle, ASSET_OP_COMMIT_RSP, ASSET_STATUS_FLASH_ERROR);
+            p_asset->conn_handle = BLE_CONN_HANDLE_INVALID;
+            p_asset->committing  = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for adding a characteristic of the service.
+ *
+ * @param[in]  p_asset    Asset Transfer Service structure.
+ * @param[in]  uuid       16-bit UUID of the characteristic.
+ * @param[in]  is_ctrl    true for the control point, false for the data characteristic.
+ * @param[out] p_handles  Handles of the characteristic.
+ *
+ * @return NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t char_add(ble_asset_t              * p_asset,
+                         uint16_t                   uuid,
+                         bool                       is_ctrl,
+                         ble_gatts_char_handles_t * p_handles)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_md_t cccd_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+    memset(&cccd_md, 0, sizeof(cccd_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+
+    cccd_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    if (is_ctrl)
+    {
+        char_md.char_props.write  = 1;
+        char_md.char_props.notify = 1;
+        char_md.p_cccd_md         = &cccd_md;
+    }
+    else
+    {
+        char_md.char_props.write_wo_resp = 1;
+    }
+
+    ble_uuid.type = p_asset->uuid_type;
+    ble_uuid.uuid = uuid;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&attr_md.write_perm);
+
+    attr_md.vloc    = BLE_GATTS_VLOC_STACK;
+    attr_md.rd_auth = 0;
+    attr_md.wr_auth = 0;
+    attr_md.vlen    = 1;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = 1;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = BLE_ASSET_MAX_DATA_LEN;
+
+    return sd_ble_gatts_characteristic_add(p_asset->service_handle,
+                                           &char_md,
+                                           &attr_char_value,
+                                           p_handles);
+}
+
+
+void ble_asset_on_ble_evt(ble_asset_t * p_asset, ble_evt_t const * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GATTS_EVT_WRITE:
+            on_write(p_asset, p_ble_evt);
+            break;
+
+        case BLE_EVT_TX_COMPLETE:
+            if (p_asset->credit_pending &&
+                (p_ble_evt->evt.common_evt.conn_handle == p_asset->conn_handle))
+            {
+                credit_update(p_asset, true);
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            // The asset store keeps what reached flash; a BEGIN for the same asset resumes there.
+            if (p_ble_evt->evt.gap_evt.conn_handle == p_asset->conn_handle)
+            {
+                p_asset->conn_handle      = BLE_CONN_HANDLE_INVALID;
+                p_asset->credit_pending   = false;
+                p_asset->commit_requested = false;
+            }
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+uint32_t ble_asset_init(ble_asset_t * p_asset, const ble_asset_init_t * p_asset_init)
+{
+    uint32_t   err_code;
+    ble_uuid_t ble_uuid;
+    uint8_t    tx_buffers;
+
+    if ((p_asset == NULL) || (p_asset_init == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    memset(p_asset, 0, sizeof(*p_asset));
+    p_asset->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_asset->uuid_type   = p_asset_init->uuid_type;
+
+    // Enable the DWT cycle counter used for measuring the decoder.
+    cycle_counter_enable();
+
+    // Credits are granted in batches of one connection event worth of packets.
+    err_code = sd_ble_tx_buffer_count_get(&tx_buffers);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    p_asset->credit_batch = MAX(tx_buffers, 1);
+
+    mp_asset = p_asset;
+
+    err_code = asset_store_init(asset_store_evt_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    ble_uuid.type = p_asset->uuid_type;
+    ble_uuid.uuid = ASSET_UUID_SERVICE;
+
+    err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &p_asset->service_handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = char_add(p_asset, ASSET_UUID_CHAR_CTRL, true, &p_asset->ctrl_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return char_add(p_asset, ASSET_UUID_CHAR_DATA, false, &p_asset->data_handles);
+}
@@ -0,0 +1,123 @@
+#ifndef BLE_ASSET_H__
+#define BLE_ASSET_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "asset_store.h"
+
+/* Asset Transfer Service UUIDs, on the PixWatch base UUID. */
+#define ASSET_UUID_SERVICE        0x1540  /**< 16-bit service UUID for the Asset Transfer Service. */
+#define ASSET_UUID_CHAR_CTRL      0x1541  /**< Control point: requests are written, responses and credits are notified. */
+#define ASSET_UUID_CHAR_DATA      0x1542  /**< Data: chunks are written without response. */
+
+#define BLE_ASSET_MAX_DATA_LEN    (GATT_MTU_SIZE_DEFAULT - 3)          /**< Maximum length of a characteristic write or notification. */
+#define BLE_ASSET_CHUNK_LEN       (BLE_ASSET_MAX_DATA_LEN - 2)         /**< Asset bytes in a data chunk, after the sequence number. */
+
+/* Control point requests, written by the phone. Multi-byte fields are little endian. */
+#define ASSET_OP_BEGIN            0x01    /**< asset_id (2), length (4), optional flags (1). Starts or resumes a transfer. */
+#define ASSET_OP_DIGEST           0x02    /**< part (1), 16 bytes of the expected SHA-256. Parts 0 and 1 are both needed. */
+#define ASSET_OP_COMMIT           0x03    /**< All data was sent; verify and keep the asset. */
+#define ASSET_OP_ABORT            0x04    /**< Abandon the transfer. */
+
+/* Flags of the BEGIN request. */
+#define ASSET_FLAG_COMPRESSED     0x01    /**< Data is an LZ stream (see lz_decoder.h); length is the decompressed length. */
+
+/* Control point notifications, sent by the watch. A response carries the request opcode | 0x80. */
+#define ASSET_OP_RSP_FLAG         0x80
+#define ASSET_OP_BEGIN_RSP        0x81    /**< status (1), resume offset (4). */
+#define ASSET_OP_DIGEST_RSP       0x82    /**< status (1). Only sent on error. */
+#define ASSET_OP_COMMIT_RSP       0x83    /**< status (1). */
+#define ASSET_OP_CREDIT           0x90    /**< credit limit (2), next expected sequence number (2). */
+#define ASSET_OP_RESEND           0x91    /**< credit limit (2), sequence number to resend from (2). */
+
+/* Status codes of the responses. */
+#define ASSET_STATUS_SUCCESS          0x00
+#define ASSET_STATUS_INVALID          0x01  /**< Malformed request, or request out of sequence. */
+#define ASSET_STATUS_BUSY             0x02  /**< Another transfer or a flash operation is in progress; retry. */
+#define ASSET_STATUS_TOO_LARGE        0x03  /**< The asset does not fit in the store. */
+#define ASSET_STATUS_DIGEST_MISMATCH  0x04  /**< The received data does not match the expected SHA-256. */
+#define ASSET_STATUS_FLASH_ERROR      0x05  /**< Writing to flash failed; restart the transfer. */
+
+
+/**@brief Asset Transfer Service statistics. */
+typedef struct
+{
+    uint32_t chunks;            /**< Data chunks accepted. */
+    uint32_t out_of_sequence;   /**< Data chunks discarded because an earlier one was lost or sent without credit. */
+    uint32_t credits_sent;      /**< Credit notifications sent. */
+    uint32_t notify_deferred;   /**< Notifications postponed because the SoftDevice had no free TX buffer. */
+    uint32_t compressed_bytes;  /**< Compressed bytes received. */
+    uint32_t decoded_bytes;     /**< Bytes produced by the decoder. */
+    uint32_t decode_cycles;     /**< CPU cycles spent in the decoder. */
+} ble_asset_stats_t;
+
+/**@brief Asset Transfer Service structure.
+ *
+ * @details A data chunk is a 2-byte sequence number followed by BLE_ASSET_CHUNK_LEN asset bytes;
+ *          only the last chunk of an asset may be shorter. Sequence numbers restart at 0 from the
+ *          resume offset of each BEGIN. The phone may send chunks with sequence numbers below the
+ *          last credit limit it received. When a chunk is lost, the following ones are discarded
+ *          and a RESEND notification carries the sequence number to resend from. The next
+ *          expected sequence number of a CREDIT notification lags the chunks in flight; the
+ *          phone must not rewind to it.
+ *
+ *          A compressed transfer is decoded as it arrives, so only the decoder input buffer and
+ *          the staging buffers of the asset store are needed in RAM. Compressed transfers cannot
+ *          be resumed and always start from offset 0.
+ *
+ *          The resume state is kept in RAM only. A transfer resumes when its link drops, but not
+ *          across a reset of the watch: the data in flash is then discarded and the next BEGIN
+ *          gets offset 0.
+ *
+ *          COMMIT_RSP is sent once the asset is valid in flash. Until then the transfer keeps its
+ *          link and a BEGIN gets ASSET_STATUS_BUSY.
+ */
+typedef struct
+{
+    uint16_t                 service_handle;                    /**< Handle of the service, as provided by the BLE stack. */
+    ble_gatts_char_handles_t ctrl_handles;                      /**< Handles of the control point characteristic. */
+    ble_gatts_char_handles_t data_handles;                      /**< Handles of the data characteristic. */
+    uint8_t                  uuid_type;                         /**< UUID type of the PixWatch base UUID. */
+    uint16_t                 conn_handle;                       /**< Link of the transfer in progress, BLE_CONN_HANDLE_INVALID if none. */
+    uint16_t                 next_seq;                          /**< Sequence number of the next expected chunk. */
+    uint16_t                 credit_limit;                      /**< Credit limit last notified to the phone. */
+    uint8_t                  credit_batch;                      /**< Minimum credit increase worth a notification. */
+    bool                     credit_pending;                    /**< A credit notification is waiting for a free TX buffer. */
+    bool                     nack_sent;                         /**< The current sequence gap has already been reported. */
+    bool                     compressed;                        /**< The data of the current transfer is compressed. */
+    bool                     commit_requested;                  /**< COMMIT received; waiting for the decoder to catch up. */
+    bool                     committing;                        /**< The trailer of the asset is being written; COMMIT_RSP follows. */
+    uint8_t                  digest_parts;                      /**< Bitmask of the expected digest parts received. */
+    uint8_t                  digest[ASSET_STORE_DIGEST_LEN];    /**< Expected SHA-256 of the asset. */
+    ble_asset_stats_t        stats;                             /**< Statistics. */
+} ble_asset_t;
+
+/**@brief Asset Transfer Service init structure. */
+typedef struct
+{
+    uint8_t uuid_type;  /**< UUID type of the PixWatch base UUID, as returned by sd_ble_uuid_vs_add(). */
+} ble_asset_init_t;
+
+
+/**@brief Function for initializing the Asset Transfer Service.
+ *
+ * @details Adds the service to the GATT table and initializes the asset store. Must be called after
+ *          the BLE stack is enabled and pstorage is initialized.
+ *
+ * @param[out] p_asset       Asset Transfer Service structure.
+ * @param[in]  p_asset_init  Information needed to initialize the service.
+ *
+ * @return NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_asset_init(ble_asset_t * p_asset, const ble_asset_init_t * p_asset_init);
+
+/**@brief Function for handling the application's BLE stack events.
+ *
+ * @param[in] p_asset    Asset Transfer Service structure.
+ * @param[in] p_ble_evt  Event received from the BLE stack.
+ */
+void ble_asset_on_ble_evt(ble_asset_t * p_asset, ble_evt_t const * p_ble_evt);
+
+#endif /* BLE_ASSET_H__ */
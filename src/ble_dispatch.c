@@ -0,0 +1,113 @@
+#include <string.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "cycle_counter.h"
+#include "ble_dispatch.h"
+
+
+static ble_dispatch_module_t const * mp_modules;                       /**< Dispatch table provided by the application. */
+static uint16_t m_routes[BLE_DISPATCH_EVT_ID_COUNT];                   /**< Bitmask of subscribed modules for each event ID. */
+
+#if BLE_DISPATCH_STATS_ENABLED
+static ble_dispatch_stats_t m_stats[BLE_DISPATCH_EVT_ID_COUNT];        /**< Per-event dispatch counters and cycle costs. */
+#endif
+
+
+uint32_t ble_dispatch_init(ble_dispatch_module_t const * p_modules, uint8_t module_count)
+{
+    uint32_t i;
+    uint32_t j;
+
+    if (p_modules == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if (module_count > BLE_DISPATCH_MAX_MODULES)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    memset(m_routes, 0, sizeof(m_routes));
+
+    for (i = 0; i < module_count; i++)
+    {
+        for (j = 0; j < p_modules[i].evt_id_count; j++)
+        {
+            uint16_t evt_id = p_modules[i].p_evt_ids[j];
+
+            if ((evt_id < BLE_DISPATCH_EVT_ID_MIN) || (evt_id > BLE_DISPATCH_EVT_ID_MAX))
+            {
+                return NRF_ERROR_INVALID_PARAM;
+            }
+            m_routes[evt_id - BLE_DISPATCH_EVT_ID_MIN] |= (uint16_t)(1 << i);
+        }
+    }
+
+    mp_modules = p_modules;
+
+#if BLE_DISPATCH_STATS_ENABLED
+    ble_dispatch_stats_clear();
+
+    // Enable the DWT cycle counter used for measuring the cost of each dispatch.
+    cycle_counter_enable();
+#endif
+
+    return NRF_SUCCESS;
+}
+
+
+void ble_dispatch_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    uint16_t evt_id = p_ble_evt->header.evt_id;
+    uint32_t routes;
+    uint32_t i;
+
+    if ((mp_modules == NULL) || (evt_id < BLE_DISPATCH_EVT_ID_MIN) || (evt_id > BLE_DISPATCH_EVT_ID_MAX))
+    {
+        return;
+    }
+
+#if BLE_DISPATCH_STATS_ENABLED
+    uint32_t start = DWT->CYCCNT;
+#endif
+
+    routes = m_routes[evt_id - BLE_DISPATCH_EVT_ID_MIN];
+
+    for (i = 0; routes != 0; i++, routes >>= 1)
+    {
+        if (routes & 1)
+        {
+            mp_modules[i].handler(p_ble_evt);
+        }
+    }
+
+#if BLE_DISPATCH_STATS_ENABLED
+    m_stats[evt_id - BLE_DISPATCH_EVT_ID_MIN].count++;
+    m_stats[evt_id - BLE_DISPATCH_EVT_ID_MIN].cycles += DWT->CYCCNT - start;
+#endif
+}
+
+
+uint32_t ble_dispatch_stats_get(uint16_t evt_id, ble_dispatch_stats_t * p_stats)
+{
+#if BLE_DISPATCH_STATS_ENABLED
+    if ((evt_id < BLE_DISPATCH_EVT_ID_MIN) || (evt_id > BLE_DISPATCH_EVT_ID_MAX))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    *p_stats = m_stats[evt_id - BLE_DISPATCH_EVT_ID_MIN];
+    return NRF_SUCCESS;
+#else
+    return NRF_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+
+void ble_dispatch_stats_clear(void)
+{
+#if BLE_DISPATCH_STATS_ENABLED
+    memset(m_stats, 0, sizeof(m_stats));
+#endif
+}
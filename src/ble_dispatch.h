@@ -0,0 +1,83 @@
+#ifndef BLE_DISPATCH_H__
+#define BLE_DISPATCH_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ranges.h"
+
+#define BLE_DISPATCH_EVT_ID_MIN     BLE_EVT_BASE                                  /**< Lowest BLE event ID routed by the dispatcher. */
+#define BLE_DISPATCH_EVT_ID_MAX     BLE_L2CAP_EVT_LAST                            /**< Highest BLE event ID routed by the dispatcher. */
+#define BLE_DISPATCH_EVT_ID_COUNT   (BLE_DISPATCH_EVT_ID_MAX - BLE_DISPATCH_EVT_ID_MIN + 1)
+#define BLE_DISPATCH_MAX_MODULES    16                                            /**< Maximum number of subscribers in a dispatch table. */
+
+#ifndef BLE_DISPATCH_STATS_ENABLED
+#define BLE_DISPATCH_STATS_ENABLED  1                                             /**< Keep per-event dispatch counters and cycle costs. */
+#endif
+
+
+/**@brief BLE event handler of a module subscribed to the dispatcher. */
+typedef void (* ble_dispatch_handler_t) (ble_evt_t * p_ble_evt);
+
+/**@brief Subscriber entry of the dispatch table. A module is called only for the event IDs it lists. */
+typedef struct
+{
+    ble_dispatch_handler_t handler;      /**< Module BLE event handler. */
+    uint16_t const *       p_evt_ids;    /**< Event IDs consumed by the module. */
+    uint8_t                evt_id_count; /**< Number of entries in p_evt_ids. */
+} ble_dispatch_module_t;
+
+/**@brief Macro for declaring a dispatch table entry at compile time.
+ *
+ * @details Usage: BLE_DISPATCH_MODULE(my_on_ble_evt, BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED)
+ */
+#define BLE_DISPATCH_MODULE(HANDLER, ...)                                          \
+    {                                                                              \
+        .handler      = (HANDLER),                                                 \
+        .p_evt_ids    = (uint16_t const []) {__VA_ARGS__},                         \
+        .evt_id_count = sizeof((uint16_t const []) {__VA_ARGS__}) / sizeof(uint16_t) \
+    }
+
+/**@brief Dispatch statistics of one BLE event ID. */
+typedef struct
+{
+    uint32_t count;  /**< Number of times the event has been dispatched. */
+    uint32_t cycles; /**< Total CPU cycles spent in the subscribers of the event. */
+} ble_dispatch_stats_t;
+
+
+/**@brief Function for initializing the dispatcher with a dispatch table.
+ *
+ * @details Builds the event ID to subscriber routing index. Subscribers of an event are called in
+ *          the order they appear in the table.
+ *
+ * @param[in] p_modules     Dispatch table. Must stay valid for the lifetime of the dispatcher.
+ * @param[in] module_count  Number of entries in the table.
+ *
+ * @retval NRF_SUCCESS              If the dispatcher was initialized.
+ * @retval NRF_ERROR_NULL           If p_modules is NULL.
+ * @retval NRF_ERROR_INVALID_LENGTH If the table has more than BLE_DISPATCH_MAX_MODULES entries.
+ * @retval NRF_ERROR_INVALID_PARAM  If an entry subscribes to an event ID outside the routed range.
+ */
+uint32_t ble_dispatch_init(ble_dispatch_module_t const * p_modules, uint8_t module_count);
+
+/**@brief Function for dispatching a BLE stack event to its subscribers.
+ *
+ * @param[in] p_ble_evt  Bluetooth stack event.
+ */
+void ble_dispatch_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for getting the dispatch statistics of an event ID.
+ *
+ * @param[in]  evt_id   BLE event ID.
+ * @param[out] p_stats  Statistics of the event.
+ *
+ * @retval NRF_SUCCESS             If the statistics were copied.
+ * @retval NRF_ERROR_INVALID_PARAM If evt_id is outside the routed range.
+ * @retval NRF_ERROR_NOT_SUPPORTED If statistics are disabled in this build.
+ */
+uint32_t ble_dispatch_stats_get(uint16_t evt_id, ble_dispatch_stats_t * p_stats);
+
+/**@brief Function for clearing all dispatch statistics. */
+void ble_dispatch_stats_clear(void);
+
+#endif /* BLE_DISPATCH_H__ */
@@ -1,15 +1,39 @@
 
+#include <string.h>
 #include "ble.h"
 #include "ble_pixwatch_c.h"
 #include "ble_gattc.h"
 #include "device_manager.h"
 #include "ble_db_discovery.h"
-#include "app_trace.h"
+#include "app_util.h"
 
-#define LOG          app_trace_log            /**< Debug logger macro that will be used in this file to do logging of important information over UART. */
+#define DLOG_MODULE  DLOG_MODULE_PIXWATCH_C
+#include "dlog.h"
 
+#define SYNC_RSP_MAX (GATT_MTU_SIZE_DEFAULT - 1)  /**< Value bytes in one ATT Read (Multiple) Response. */
+#define SYNC_NONE    BLE_PIXWATCH_C_FIELD_COUNT   /**< sync_field value when no state sync is in progress. */
 
-static ble_pixwatch_c_t * mp_ble_pixwatch; /**< Pointer to the current instance of the PixWatch Client module. The memory for this provided by the application.*/
+
+/**@brief Characteristic UUID and value length of each state field, indexed by ble_pixwatch_c_field_t.
+ *
+ * @details Read Multiple responses carry the values back to back, so the values must have a fixed
+ *          length to be split.
+ */
+static const struct
+{
+    uint16_t uuid;
+    uint8_t  len;
+} m_fields[BLE_PIXWATCH_C_FIELD_COUNT] =
+{
+    [BLE_PIXWATCH_C_FIELD_LOCAL_TIME]  = {PIXWATCH_UUID_CHAR_LOCAL_TIME,  4},
+    [BLE_PIXWATCH_C_FIELD_DATE_FORMAT] = {PIXWATCH_UUID_CHAR_DATE_FORMAT, 1},
+    [BLE_PIXWATCH_C_FIELD_ALARMS]      = {PIXWATCH_UUID_CHAR_ALARMS,      3 * PIXWATCH_ALARM_COUNT},
+    [BLE_PIXWATCH_C_FIELD_WEATHER]     = {PIXWATCH_UUID_CHAR_WEATHER,     3},
+};
+
+
+static ble_pixwatch_c_t * mp_ble_pixwatch;  /**< Array of PixWatch Client instances, one per link. The memory for this provided by the application.*/
+static uint8_t            m_link_count;     /**< Number of instances in mp_ble_pixwatch. */
 
 
 /**@brief 128-bit service UUID for the PixWatch Service.
@@ -35,31 +59,68 @@ const ble_uuid128_t ble_pixwatch_local_time_base_uuid128 =
 };
 
 
+ble_pixwatch_c_t * ble_pixwatch_c_find(uint16_t conn_handle)
+{
+    uint32_t i;
+
+    if (conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < m_link_count; i++)
+    {
+        if (mp_ble_pixwatch[i].conn_handle == conn_handle)
+        {
+            return &mp_ble_pixwatch[i];
+        }
+    }
+    return NULL;
+}
+
+
 static void db_discover_evt_handler(ble_db_discovery_evt_t * p_evt)
 {
-    LOG("[PixWatch]: Database Discovery handler called with event 0x%x\r\n", p_evt->evt_type);
+    DLOG_DEBUG("[PixWatch]: Database Discovery handler called with event 0x%x\r\n", p_evt->evt_type);
 
     ble_pixwatch_c_evt_t evt;
+    ble_pixwatch_c_t   * p_pixwatch = ble_pixwatch_c_find(p_evt->conn_handle);
+
+    if (p_pixwatch == NULL)
+    {
+        // Discovery finished on a link that has no client instance.
+        return;
+    }
+
+    evt.conn_handle = p_evt->conn_handle;
 
     // Check if the PixWatch Service was discovered.
     if (p_evt->evt_type == BLE_DB_DISCOVERY_COMPLETE &&
         p_evt->params.discovered_db.srv_uuid.uuid == PIXWATCH_UUID_SERVICE &&
         p_evt->params.discovered_db.srv_uuid.type == BLE_UUID_TYPE_VENDOR_BEGIN)
     {
-        mp_ble_pixwatch->conn_handle = p_evt->conn_handle;
-
         // Find the handles of the Current Local Time characteristic.
         uint32_t i;
+        uint32_t j;
 
         for (i = 0; i < p_evt->params.discovered_db.char_count; i++)
         {
+            for (j = 0; j < BLE_PIXWATCH_C_FIELD_COUNT; j++)
+            {
+                if (p_evt->params.discovered_db.charateristics[i].characteristic.uuid.uuid == m_fields[j].uuid)
+                {
+                    p_pixwatch->field_handles[j] =
+                        p_evt->params.discovered_db.charateristics[i].characteristic.handle_value;
+                }
+            }
+
         	switch (p_evt->params.discovered_db.charateristics[i].characteristic.uuid.uuid)
         	{
         		case PIXWATCH_UUID_CHAR_LOCAL_TIME:
                     // Found Local Time characteristic. Store CCCD and value handle and break.
-                    mp_ble_pixwatch->cccd_handle =
+                    p_pixwatch->cccd_handle =
                         p_evt->params.discovered_db.charateristics[i].cccd_handle;
-                    mp_ble_pixwatch->local_time_handle =
+                    p_pixwatch->local_time_handle =
                         p_evt->params.discovered_db.charateristics[i].characteristic.handle_value;
                     break;
 
@@ -68,23 +129,43 @@ static void db_discover_evt_handler(ble_db_discovery_evt_t * p_evt)
         	}
         }
 
-        LOG("[PixWatch]: PixWatch Service discovered at peer.\r\n");
+        DLOG_INFO("[PixWatch]: PixWatch Service discovered at peer 0x%x.\r\n", p_evt->conn_handle);
 
         evt.evt_type = BLE_PIXWATCH_C_EVT_DISCOVERY_COMPLETE;
 
-        mp_ble_pixwatch->evt_handler(mp_ble_pixwatch, &evt);
+        p_pixwatch->evt_handler(p_pixwatch, &evt);
     }
     else
     {
         evt.evt_type = BLE_PIXWATCH_C_EVT_SERVICE_NOT_FOUND;
-        mp_ble_pixwatch->evt_handler(mp_ble_pixwatch, &evt);
+        p_pixwatch->evt_handler(p_pixwatch, &evt);
     }
 
 }
 
 
-uint32_t ble_pixwatch_c_init(ble_pixwatch_c_t * p_pixwatch, const ble_pixwatch_c_init_t * p_pixwatch_init)
+static void handles_reset(ble_pixwatch_c_t * p_pixwatch)
 {
+    uint32_t i;
+
+    p_pixwatch->local_time_handle = BLE_GATT_HANDLE_INVALID;
+    p_pixwatch->cccd_handle       = BLE_GATT_HANDLE_INVALID;
+    p_pixwatch->sync_field        = SYNC_NONE;
+    p_pixwatch->sync_count        = 0;
+
+    for (i = 0; i < BLE_PIXWATCH_C_FIELD_COUNT; i++)
+    {
+        p_pixwatch->field_handles[i] = BLE_GATT_HANDLE_INVALID;
+    }
+}
+
+
+uint32_t ble_pixwatch_c_init(ble_pixwatch_c_t           * p_pixwatch,
+                             uint8_t                      link_count,
+                             const ble_pixwatch_c_init_t * p_pixwatch_init)
+{
+    uint32_t i;
+
     if (   (p_pixwatch_init == NULL)
         || (p_pixwatch_init->error_handler == NULL)
         || (p_pixwatch_init->evt_handler == NULL)
@@ -93,12 +174,23 @@ uint32_t ble_pixwatch_c_init(ble_pixwatch_c_t * p_pixwatch, const ble_pixwatch_c
         return NRF_ERROR_NULL;
     }
 
+    if ((link_count == 0) || (link_count > BLE_PIXWATCH_C_MAX_LINKS))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
     mp_ble_pixwatch = p_pixwatch;
+    m_link_count    = link_count;
 
-    p_pixwatch->evt_handler      = p_pixwatch_init->evt_handler;
-    p_pixwatch->error_handler    = p_pixwatch_init->error_handler;
-    p_pixwatch->conn_handle      = BLE_CONN_HANDLE_INVALID;
-    p_pixwatch->local_time_handle = BLE_GATT_HANDLE_INVALID;
+    for (i = 0; i < link_count; i++)
+    {
+        p_pixwatch[i].evt_handler       = p_pixwatch_init->evt_handler;
+        p_pixwatch[i].error_handler     = p_pixwatch_init->error_handler;
+        p_pixwatch[i].conn_handle       = BLE_CONN_HANDLE_INVALID;
+        p_pixwatch[i].local_time        = 0;
+        handles_reset(&p_pixwatch[i]);
+        memset(&p_pixwatch[i].state, 0, sizeof(p_pixwatch[i].state));
+    }
 
     ble_uuid_t pixwatch_uuid;
     pixwatch_uuid.uuid = PIXWATCH_UUID_SERVICE;
@@ -108,6 +200,25 @@ uint32_t ble_pixwatch_c_init(ble_pixwatch_c_t * p_pixwatch, const ble_pixwatch_c
 }
 
 
+static void on_connect(ble_evt_t const * p_ble_evt)
+{
+    uint32_t i;
+
+    // Assign the first free instance to the new link.
+    for (i = 0; i < m_link_count; i++)
+    {
+        if (mp_ble_pixwatch[i].conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+            mp_ble_pixwatch[i].conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            handles_reset(&mp_ble_pixwatch[i]);
+            return;
+        }
+    }
+
+    DLOG_WARNING("[PixWatch]: No free instance for link 0x%x\r\n", p_ble_evt->evt.gap_evt.conn_handle);
+}
+
+
 static void on_disconnect(ble_pixwatch_c_t * p_pixwatch, ble_evt_t const * p_ble_evt)
 {
     // The connection handle is now invalid. It will be re-initialized upon connection.
@@ -119,11 +230,13 @@ static void on_disconnect(ble_pixwatch_c_t * p_pixwatch, ble_evt_t const * p_ble
         // application, so that it can do any clean up related to this module.
         ble_pixwatch_c_evt_t evt;
 
-        evt.evt_type = BLE_PIXWATCH_C_EVT_DISCONN_COMPLETE;
+        evt.evt_type    = BLE_PIXWATCH_C_EVT_DISCONN_COMPLETE;
+        evt.conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
 
         p_pixwatch->evt_handler(p_pixwatch, &evt);
-        p_pixwatch->local_time_handle = BLE_GATT_HANDLE_INVALID;
     }
+
+    handles_reset(p_pixwatch);
 }
 
 
@@ -138,28 +251,283 @@ static void local_time_read(ble_pixwatch_c_t * p_pixwatch, const ble_evt_t * p_b
     	// const uint32_t length   = p_ble_evt->evt.gattc_evt.params.read_rsp.len;
     	uint32_t localtime = p_data[0] | (p_data[1] << 8) | (p_data[2] << 16) | (p_data[3] << 24);
 
-    	evt.local_time = localtime;
-        evt.evt_type = BLE_PIXWATCH_C_EVT_LOCAL_TIME;
+    	p_pixwatch->local_time = localtime;
+
+    	evt.local_time  = localtime;
+        evt.conn_handle = p_pixwatch->conn_handle;
+        evt.evt_type    = BLE_PIXWATCH_C_EVT_LOCAL_TIME;
         p_pixwatch->evt_handler(p_pixwatch, &evt);
     }
 }
 
-void ble_pixwatch_c_on_ble_evt(ble_pixwatch_c_t * p_pixwatch, ble_evt_t const * p_ble_evt)
+/**@brief Function for decoding the value of one state field. */
+static void field_decode(ble_pixwatch_c_state_t * p_state, uint8_t field, uint8_t const * p_data)
+{
+    uint32_t i;
+
+    switch (field)
+    {
+        case BLE_PIXWATCH_C_FIELD_LOCAL_TIME:
+            p_state->local_time = uint32_decode(p_data);
+            break;
+
+        case BLE_PIXWATCH_C_FIELD_DATE_FORMAT:
+            p_state->date_format = p_data[0];
+            break;
+
+        case BLE_PIXWATCH_C_FIELD_ALARMS:
+            for (i = 0; i < PIXWATCH_ALARM_COUNT; i++)
+            {
+                p_state->alarms[i].hour   = p_data[3 * i];
+                p_state->alarms[i].minute = p_data[3 * i + 1];
+                p_state->alarms[i].days   = p_data[3 * i + 2];
+            }
+            break;
+
+        case BLE_PIXWATCH_C_FIELD_WEATHER:
+            p_state->weather.temperature = (int16_t)uint16_decode(p_data);
+            p_state->weather.condition   = p_data[2];
+            break;
+
+        default:
+            return;
+    }
+
+    p_state->valid |= (1 << field);
+}
+
+
+/**@brief Function for sending the next state sync request.
+ *
+ * @details Starting at the first field not read yet, the discovered fields are batched while
+ *          their values fit in one response. A batch of one is read with a plain Read Request.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_NOT_FOUND when no field is left to read.
+ */
+static uint32_t sync_request_send(ble_pixwatch_c_t * p_pixwatch, uint8_t first)
+{
+    uint16_t handles[BLE_PIXWATCH_C_FIELD_COUNT];
+    uint8_t  count = 0;
+    uint8_t  len   = 0;
+    uint8_t  field;
+    uint32_t err_code;
+
+    while ((first < BLE_PIXWATCH_C_FIELD_COUNT) &&
+           (p_pixwatch->field_handles[first] == BLE_GATT_HANDLE_INVALID))
+    {
+        first++;
+    }
+
+    // Absent fields inside the batch are skipped, so fields are only batched in table order.
+    for (field = first; field < BLE_PIXWATCH_C_FIELD_COUNT; field++)
+    {
+        if (p_pixwatch->field_handles[field] == BLE_GATT_HANDLE_INVALID)
+        {
+            continue;
+        }
+        if ((count > 0) && (len + m_fields[field].len > SYNC_RSP_MAX))
+        {
+            break;
+        }
+        handles[count++] = p_pixwatch->field_handles[field];
+        len             += m_fields[field].len;
+    }
+
+    if (count == 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    if (count == 1)
+    {
+        err_code = sd_ble_gattc_read(p_pixwatch->conn_handle, handles[0], 0);
+    }
+    else
+    {
+        err_code = sd_ble_gattc_char_values_read(p_pixwatch->conn_handle, handles, count);
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        p_pixwatch->sync_field = first;
+        p_pixwatch->sync_count = count;
+        p_pixwatch->state.round_trips++;
+    }
+
+    return err_code;
+}
+
+
+/**@brief Function for ending the state sync and passing the state to the application. */
+static void sync_complete(ble_pixwatch_c_t * p_pixwatch)
 {
-    LOG("[PixWatch]: BLE event handler called with event 0x%x\r\n", p_ble_evt->header.evt_id);
+    ble_pixwatch_c_evt_t evt;
+
+    p_pixwatch->sync_field = SYNC_NONE;
+    p_pixwatch->sync_count = 0;
+
+    if (p_pixwatch->state.valid & (1 << BLE_PIXWATCH_C_FIELD_LOCAL_TIME))
+    {
+        p_pixwatch->local_time = p_pixwatch->state.local_time;
+    }
+
+    evt.evt_type    = BLE_PIXWATCH_C_EVT_STATE;
+    evt.conn_handle = p_pixwatch->conn_handle;
+    evt.local_time  = p_pixwatch->local_time;
+    evt.p_state     = &p_pixwatch->state;
+
+    p_pixwatch->evt_handler(p_pixwatch, &evt);
+}
+
+
+/**@brief Function for sending the state sync request from a field on, or ending the sync.
+ *
+ * @details The GATT client runs one procedure at a time per link. If another module holds it, the
+ *          request waits, and ble_pixwatch_c_sync_resume() sends it when that procedure ends.
+ */
+static void sync_continue(ble_pixwatch_c_t * p_pixwatch, uint8_t first)
+{
+    uint32_t err_code = sync_request_send(p_pixwatch, first);
+
+    if (err_code == NRF_SUCCESS)
+    {
+        return;
+    }
+
+    if (err_code == NRF_ERROR_BUSY)
+    {
+        p_pixwatch->sync_field = first;
+        p_pixwatch->sync_count = 0;
+        return;
+    }
+
+    if (err_code != NRF_ERROR_NOT_FOUND)
+    {
+        p_pixwatch->error_handler(err_code);
+    }
+    sync_complete(p_pixwatch);
+}
+
+
+/**@brief Function for handling the response to a state sync request.
+ *
+ * @details The values of the batch are split by the table lengths. A response cut short leaves
+ *          the remaining fields of the batch invalid.
+ */
+static void sync_response(ble_pixwatch_c_t * p_pixwatch, uint8_t const * p_data, uint16_t len)
+{
+    uint8_t  field = p_pixwatch->sync_field;
+    uint8_t  left  = p_pixwatch->sync_count;
+    uint16_t offset = 0;
+
+    for (; (field < BLE_PIXWATCH_C_FIELD_COUNT) && (left > 0); field++)
+    {
+        if (p_pixwatch->field_handles[field] == BLE_GATT_HANDLE_INVALID)
+        {
+            continue;
+        }
+        if (offset + m_fields[field].len > len)
+        {
+            break;
+        }
+        field_decode(&p_pixwatch->state, field, &p_data[offset]);
+        offset += m_fields[field].len;
+        left--;
+    }
+
+    // Continue after the last field of the batch, even if it was cut short.
+    for (; (field < BLE_PIXWATCH_C_FIELD_COUNT) && (left > 0); field++)
+    {
+        if (p_pixwatch->field_handles[field] != BLE_GATT_HANDLE_INVALID)
+        {
+            left--;
+        }
+    }
+
+    sync_continue(p_pixwatch, field);
+}
+
+
+static void on_read_rsp(ble_pixwatch_c_t * p_pixwatch, const ble_evt_t * p_ble_evt)
+{
+    ble_gattc_evt_t const * p_gattc_evt = &p_ble_evt->evt.gattc_evt;
+
+    if (p_pixwatch->sync_count == 0)
+    {
+        // No sync request in flight.
+        if (p_gattc_evt->params.read_rsp.handle == p_pixwatch->local_time_handle)
+        {
+            local_time_read(p_pixwatch, p_ble_evt);
+        }
+        return;
+    }
+
+    if (p_gattc_evt->gatt_status != BLE_GATT_STATUS_SUCCESS)
+    {
+        sync_complete(p_pixwatch);
+        return;
+    }
+
+    sync_response(p_pixwatch, p_gattc_evt->params.read_rsp.data, p_gattc_evt->params.read_rsp.len);
+}
+
+
+static void on_char_vals_read_rsp(ble_pixwatch_c_t * p_pixwatch, const ble_evt_t * p_ble_evt)
+{
+    ble_gattc_evt_t const * p_gattc_evt = &p_ble_evt->evt.gattc_evt;
+
+    if (p_pixwatch->sync_count == 0)
+    {
+        return;
+    }
+
+    if (p_gattc_evt->gatt_status != BLE_GATT_STATUS_SUCCESS)
+    {
+        sync_complete(p_pixwatch);
+        return;
+    }
+
+    sync_response(p_pixwatch,
+                  p_gattc_evt->params.char_vals_read_rsp.values,
+                  p_gattc_evt->params.char_vals_read_rsp.len);
+}
+
+
+void ble_pixwatch_c_on_ble_evt(ble_evt_t const * p_ble_evt)
+{
+    ble_pixwatch_c_t * p_pixwatch;
+
+    DLOG_LIMITED(DLOG_LEVEL_DEBUG, 1000, "[PixWatch]: BLE event handler called with event 0x%x\r\n",
+                 p_ble_evt->header.evt_id);
 
     switch (p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
-            p_pixwatch->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            on_connect(p_ble_evt);
             break;
 
         case BLE_GATTC_EVT_READ_RSP:
-            local_time_read(p_pixwatch, p_ble_evt);
+            p_pixwatch = ble_pixwatch_c_find(p_ble_evt->evt.gattc_evt.conn_handle);
+            if (p_pixwatch != NULL)
+            {
+                on_read_rsp(p_pixwatch, p_ble_evt);
+            }
+            break;
+
+        case BLE_GATTC_EVT_CHAR_VALS_READ_RSP:
+            p_pixwatch = ble_pixwatch_c_find(p_ble_evt->evt.gattc_evt.conn_handle);
+            if (p_pixwatch != NULL)
+            {
+                on_char_vals_read_rsp(p_pixwatch, p_ble_evt);
+            }
             break;
 
         case BLE_GAP_EVT_DISCONNECTED:
-            on_disconnect(p_pixwatch, p_ble_evt);
+            p_pixwatch = ble_pixwatch_c_find(p_ble_evt->evt.gap_evt.conn_handle);
+            if (p_pixwatch != NULL)
+            {
+                on_disconnect(p_pixwatch, p_ble_evt);
+            }
             break;
 
         default:
@@ -169,6 +537,17 @@ void ble_pixwatch_c_on_ble_evt(ble_pixwatch_c_t * p_pixwatch, ble_evt_t const *
 }
 
 
+void ble_pixwatch_c_sync_resume(ble_evt_t const * p_ble_evt)
+{
+    ble_pixwatch_c_t * p_pixwatch = ble_pixwatch_c_find(p_ble_evt->evt.gattc_evt.conn_handle);
+
+    if ((p_pixwatch != NULL) && (p_pixwatch->sync_field != SYNC_NONE) && (p_pixwatch->sync_count == 0))
+    {
+        sync_continue(p_pixwatch, p_pixwatch->sync_field);
+    }
+}
+
+
 uint32_t ble_pixwatch_c_local_time_read(ble_pixwatch_c_t const * p_pixwatch)
 {
     if (p_pixwatch->local_time_handle == BLE_GATT_HANDLE_INVALID)
@@ -178,3 +557,55 @@ uint32_t ble_pixwatch_c_local_time_read(ble_pixwatch_c_t const * p_pixwatch)
 
     return sd_ble_gattc_read(p_pixwatch->conn_handle, p_pixwatch->local_time_handle, 0);
 }
+
+
+uint32_t ble_pixwatch_c_sync(ble_pixwatch_c_t * p_pixwatch)
+{
+    uint32_t err_code;
+
+    if (p_pixwatch->sync_field != SYNC_NONE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    memset(&p_pixwatch->state, 0, sizeof(p_pixwatch->state));
+
+    err_code = sync_request_send(p_pixwatch, 0);
+    if (err_code == NRF_ERROR_BUSY)
+    {
+        // Sent by ble_pixwatch_c_sync_resume() once the GATT client is free.
+        p_pixwatch->sync_field = 0;
+        p_pixwatch->sync_count = 0;
+        return NRF_SUCCESS;
+    }
+
+    return err_code;
+}
+
+
+void ble_pixwatch_c_handles_get(ble_pixwatch_c_t const * p_pixwatch, ble_pixwatch_c_handles_t * p_handles)
+{
+    p_handles->local_time_handle = p_pixwatch->local_time_handle;
+    p_handles->cccd_handle       = p_pixwatch->cccd_handle;
+    memcpy(p_handles->field_handles, p_pixwatch->field_handles, sizeof(p_handles->field_handles));
+}
+
+
+uint32_t ble_pixwatch_c_handles_assign(ble_pixwatch_c_t * p_pixwatch, ble_pixwatch_c_handles_t const * p_handles)
+{
+    if (p_pixwatch->conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (p_pixwatch->sync_field != SYNC_NONE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    p_pixwatch->local_time_handle = p_handles->local_time_handle;
+    p_pixwatch->cccd_handle       = p_handles->cccd_handle;
+    memcpy(p_pixwatch->field_handles, p_handles->field_handles, sizeof(p_pixwatch->field_handles));
+
+    return NRF_SUCCESS;
+}
@@ -10,6 +10,14 @@
 /* PixWatch Service UUID */
 #define PIXWATCH_UUID_SERVICE          0x1525  /**< 16-bit service UUID for PixWatch Service */
 #define PIXWATCH_UUID_CHAR_LOCAL_TIME  0x1530  /**< 16-bit local time UUID */
+#define PIXWATCH_UUID_CHAR_DATE_FORMAT 0x1531  /**< 16-bit date format UUID */
+#define PIXWATCH_UUID_CHAR_ALARMS      0x1532  /**< 16-bit alarms UUID */
+#define PIXWATCH_UUID_CHAR_WEATHER     0x1533  /**< 16-bit weather UUID */
+
+#define PIXWATCH_ALARM_COUNT           4       /**< Number of alarms in the alarms characteristic. */
+
+/* Maximum number of simultaneously connected peers, one client instance per link. */
+#define BLE_PIXWATCH_C_MAX_LINKS       DEVICE_MANAGER_MAX_CONNECTIONS
 
 
 /**@brief PixWatch Service UUIDs */
@@ -23,17 +31,64 @@ typedef enum
     BLE_PIXWATCH_C_EVT_SERVICE_NOT_FOUND,  /**< The PixWatch Service was not found at the peer. */
     BLE_PIXWATCH_C_EVT_DISCOVERY_COMPLETE, /**< The PixWatch Service was found at the peer. */
     BLE_PIXWATCH_C_EVT_DISCONN_COMPLETE,   /**< */
-    BLE_PIXWATCH_C_EVT_LOCAL_TIME          /**< A new local time reading has been received. */
+    BLE_PIXWATCH_C_EVT_LOCAL_TIME,         /**< A new local time reading has been received. */
+    BLE_PIXWATCH_C_EVT_STATE               /**< A state sync has finished. p_state holds the values read. */
 } ble_pixwatch_c_evt_type_t;
 
+/**@brief Characteristics read by a state sync, in the order their values are requested. */
+typedef enum
+{
+    BLE_PIXWATCH_C_FIELD_LOCAL_TIME,   /**< uint32, seconds (Unix time + local offset). */
+    BLE_PIXWATCH_C_FIELD_DATE_FORMAT,  /**< uint8. */
+    BLE_PIXWATCH_C_FIELD_ALARMS,       /**< PIXWATCH_ALARM_COUNT times hour (1), minute (1), days (1). */
+    BLE_PIXWATCH_C_FIELD_WEATHER,      /**< int16 temperature in 0.1 degree Celsius, uint8 condition. */
+    BLE_PIXWATCH_C_FIELD_COUNT
+} ble_pixwatch_c_field_t;
+
+/**@brief Alarm setting. */
+typedef struct
+{
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t days;      /**< Bit 0 for Monday to bit 6 for Sunday. 0 if the alarm is off. */
+} ble_pixwatch_c_alarm_t;
+
+/**@brief Weather report. */
+typedef struct
+{
+    int16_t temperature;  /**< In 0.1 degree Celsius. */
+    uint8_t condition;    /**< Condition code defined by the phone application. */
+} ble_pixwatch_c_weather_t;
+
+/**@brief PixWatch state, as read from the peer by a state sync. */
+typedef struct
+{
+    uint8_t                  valid;                          /**< Bitmask of the fields read, bit n for ble_pixwatch_c_field_t n. */
+    uint8_t                  round_trips;                    /**< GATT requests the sync took. */
+    uint32_t                 local_time;
+    uint8_t                  date_format;
+    ble_pixwatch_c_alarm_t   alarms[PIXWATCH_ALARM_COUNT];
+    ble_pixwatch_c_weather_t weather;
+} ble_pixwatch_c_state_t;
+
+/**@brief Handles of the PixWatch Service at a peer. */
+typedef struct
+{
+    uint16_t local_time_handle;                         /**< Value handle of the Local Time Characteristic. */
+    uint16_t cccd_handle;                               /**< Handle of the CCCD of the Local Time Characteristic. */
+    uint16_t field_handles[BLE_PIXWATCH_C_FIELD_COUNT]; /**< Value handles of the state characteristics. */
+} ble_pixwatch_c_handles_t;
+
 // Forward declaration of the ble_pixwatch_c_t type.
 typedef struct ble_pixwatch_c_s ble_pixwatch_c_t;
 
 /**@brief PixWatch client event. */
 typedef struct
 {
-    ble_pixwatch_c_evt_type_t evt_type; /**< Type of event. */
+    ble_pixwatch_c_evt_type_t evt_type;    /**< Type of event. */
+    uint16_t                  conn_handle; /**< Handle of the connection the event relates to. */
     uint32_t                  local_time;
+    ble_pixwatch_c_state_t const * p_state;  /**< State read, for BLE_PIXWATCH_C_EVT_STATE. */
 } ble_pixwatch_c_evt_t;
 
 
@@ -47,6 +102,11 @@ struct ble_pixwatch_c_s
     uint16_t                     local_time_handle; /**< Handle of Local Time Characteristic at the peer (handles are provided by the BLE stack through the DB Discovery module). */
     uint16_t                     cccd_handle;       /**< Handle of the CCCD of the Current Local Time Characteristic at the peer. */
     uint16_t                     conn_handle;       /**< Handle of the current connection. BLE_CONN_HANDLE_INVALID if not in a connection. */
+    uint32_t                     local_time;        /**< Last local time received from this peer. */
+    uint16_t                     field_handles[BLE_PIXWATCH_C_FIELD_COUNT];  /**< Value handles of the state characteristics at the peer, BLE_GATT_HANDLE_INVALID if absent. */
+    uint8_t                      sync_field;        /**< First field of the state sync request in progress, BLE_PIXWATCH_C_FIELD_COUNT if none. */
+    uint8_t                      sync_count;        /**< Number of fields in the request in progress, 0 while the request waits for the GATT client. */
+    ble_pixwatch_c_state_t       state;             /**< State being read, then last state read. */
 };
 
 /**@brief Current Time Service client init structure. This structure contains all options and data needed for initialization of the client.*/
@@ -59,19 +119,69 @@ typedef struct
 
 /**@brief Function for initializing the PixWatch Service client.
  *
+ * @details One client instance is used per connection. Instances are assigned to links on
+ *          connection and looked up by connection handle afterwards.
+ *
+ * @param[in] p_pixwatch       Array of client instances. The memory is provided by the application.
+ * @param[in] link_count       Number of instances in the array, at most BLE_PIXWATCH_C_MAX_LINKS.
+ * @param[in] p_pixwatch_init  Initialization parameters shared by all instances.
  */
-uint32_t ble_pixwatch_c_init(ble_pixwatch_c_t * p_pixwatch, const ble_pixwatch_c_init_t * p_pixwatch_init);
+uint32_t ble_pixwatch_c_init(ble_pixwatch_c_t           * p_pixwatch,
+                             uint8_t                      link_count,
+                             const ble_pixwatch_c_init_t * p_pixwatch_init);
 
 /**@brief Function for handling the application's BLE stack events.
  *
+ * @details The event is forwarded to the instance of the connection it relates to.
  */
-void ble_pixwatch_c_on_ble_evt(ble_pixwatch_c_t * p_pixwatch, const ble_evt_t * p_ble_evt);
+void ble_pixwatch_c_on_ble_evt(const ble_evt_t * p_ble_evt);
+
+/**@brief Function for finding the client instance of a connection.
+ *
+ * @return Client instance, or NULL if no instance is assigned to the connection.
+ */
+ble_pixwatch_c_t * ble_pixwatch_c_find(uint16_t conn_handle);
 
 /**@brief Function for reading the peer's Current Time Service Current Time Characteristic.
  *
  */
 uint32_t ble_pixwatch_c_local_time_read(ble_pixwatch_c_t const * p_pixwatch);
 
+/**@brief Function for reading all state characteristics of the peer.
+ *
+ * @details The values are fetched with Read Multiple Characteristic Values requests, as many per
+ *          request as fit in one ATT response, so the whole state normally takes a single round
+ *          trip. A BLE_PIXWATCH_C_EVT_STATE event carries the decoded state once all requests are
+ *          answered or one fails. A request the GATT client refuses as busy is sent by
+ *          ble_pixwatch_c_sync_resume() when the procedure holding the client ends.
+ *
+ * @retval NRF_SUCCESS          If the sync was started.
+ * @retval NRF_ERROR_NOT_FOUND  If the peer has none of the state characteristics.
+ * @retval NRF_ERROR_BUSY       If a sync is already in progress.
+ */
+uint32_t ble_pixwatch_c_sync(ble_pixwatch_c_t * p_pixwatch);
+
+/**@brief Function for sending a state sync request that waits for the GATT client of the link.
+ *
+ * @details Call it with every event that ends a GATT client procedure, after the other modules
+ *          handled it, so that a module with more requests to send keeps the client.
+ */
+void ble_pixwatch_c_sync_resume(ble_evt_t const * p_ble_evt);
+
+/**@brief Function for getting the handles found at the peer by DB discovery. */
+void ble_pixwatch_c_handles_get(ble_pixwatch_c_t const * p_pixwatch, ble_pixwatch_c_handles_t * p_handles);
+
+/**@brief Function for assigning handles cached from an earlier discovery of the same peer.
+ *
+ * @details Lets a state sync run before DB discovery, on a reconnection to a bonded peer. The
+ *          handles are not checked; a later discovery replaces them.
+ *
+ * @retval NRF_SUCCESS             If the handles were assigned.
+ * @retval NRF_ERROR_INVALID_STATE If the instance is not assigned to a link.
+ * @retval NRF_ERROR_BUSY          If a state sync is in progress.
+ */
+uint32_t ble_pixwatch_c_handles_assign(ble_pixwatch_c_t * p_pixwatch, ble_pixwatch_c_handles_t const * p_handles);
+
 
 
 #endif /* BLE_PIXWATCH_C_H__ */
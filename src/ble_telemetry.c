@@ -0,0 +1,230 @@
+#include <string.h>
+#include "nordic_common.h"
+#include "ble_telemetry.h"
+
+
+/**@brief Function for collecting and encoding a record.
+ *
+ * @param[out] p_buf  Buffer of TELEMETRY_RECORD_LEN bytes.
+ *
+ * @return Encoded length.
+ */
+static uint16_t record_get(ble_telemetry_t * p_telemetry, uint8_t * p_buf)
+{
+    telemetry_record_t record;
+
+    memset(&record, 0, sizeof(record));
+    p_telemetry->collect(&record);
+
+    return telemetry_encode(&record, p_buf);
+}
+
+
+static void on_read_authorize(ble_telemetry_t * p_telemetry, ble_evt_t const * p_ble_evt)
+{
+    ble_gatts_evt_rw_authorize_request_t const * p_req =
+        &p_ble_evt->evt.gatts_evt.params.authorize_request;
+    ble_gatts_rw_authorize_reply_params_t        reply;
+    uint8_t                                      buf[TELEMETRY_RECORD_LEN];
+
+    if ((p_req->type != BLE_GATTS_AUTHORIZE_TYPE_READ) ||
+        (p_req->request.read.handle != p_telemetry->record_handles.value_handle))
+    {
+        return;
+    }
+
+    memset(&reply, 0, sizeof(reply));
+
+    reply.type                    = BLE_GATTS_AUTHORIZE_TYPE_READ;
+    reply.params.read.gatt_status = BLE_GATT_STATUS_SUCCESS;
+
+    // A read at a non-zero offset continues the record of the first read.
+    if (p_req->request.read.offset == 0)
+    {
+        reply.params.read.update = 1;
+        reply.params.read.len    = record_get(p_telemetry, buf);
+        reply.params.read.p_data = buf;
+    }
+
+    (void)sd_ble_gatts_rw_authorize_reply(p_ble_evt->evt.gatts_evt.conn_handle, &reply);
+}
+
+
+static void on_write(ble_telemetry_t * p_telemetry, ble_evt_t const * p_ble_evt)
+{
+    ble_gatts_evt_write_t const * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+
+    if ((p_evt_write->handle == p_telemetry->record_handles.cccd_handle) &&
+        (p_evt_write->len == 2) &&
+        ble_srv_is_notification_enabled((uint8_t *)p_evt_write->data))
+    {
+        (void)ble_telemetry_notify(p_telemetry, p_ble_evt->evt.gatts_evt.conn_handle);
+    }
+}
+
+
+/**@brief Function for adding the record characteristic. */
+static uint32_t record_char_add(ble_telemetry_t * p_telemetry)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_md_t cccd_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+    memset(&cccd_md, 0, sizeof(cccd_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+
+    cccd_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.notify = 1;
+    char_md.p_cccd_md         = &cccd_md;
+
+    ble_uuid.type = p_telemetry->uuid_type;
+    ble_uuid.uuid = TELEMETRY_UUID_CHAR_RECORD;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+
+    attr_md.vloc    = BLE_GATTS_VLOC_STACK;
+    attr_md.rd_auth = 1;
+    attr_md.wr_auth = 0;
+    attr_md.vlen    = 1;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = 0;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = TELEMETRY_RECORD_LEN;
+
+    return sd_ble_gatts_characteristic_add(p_telemetry->service_handle,
+                                           &char_md,
+                                           &attr_char_value,
+                                           &p_telemetry->record_handles);
+}
+
+
+/**@brief Function for adding the crash report characteristic. The report does not change while
+ *        running, so the SoftDevice serves it.
+ */
+static uint32_t crash_char_add(ble_telemetry_t * p_telemetry, uint8_t const * p_crash, uint16_t crash_len)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read = 1;
+
+    ble_uuid.type = p_telemetry->uuid_type;
+    ble_uuid.uuid = TELEMETRY_UUID_CHAR_CRASH;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+
+    attr_md.vloc = BLE_GATTS_VLOC_STACK;
+    attr_md.vlen = 1;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = crash_len;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = CRASH_LOG_REPORT_MAX;
+    attr_char_value.p_value   = (uint8_t *)p_crash;
+
+    return sd_ble_gatts_characteristic_add(p_telemetry->service_handle,
+                                           &char_md,
+                                           &attr_char_value,
+                                           &p_telemetry->crash_handles);
+}
+
+
+uint32_t ble_telemetry_init(ble_telemetry_t * p_telemetry, const ble_telemetry_init_t * p_telemetry_init)
+{
+    uint32_t   err_code;
+    ble_uuid_t ble_uuid;
+
+    if ((p_telemetry == NULL) || (p_telemetry_init == NULL) || (p_telemetry_init->collect == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    memset(p_telemetry, 0, sizeof(*p_telemetry));
+    p_telemetry->uuid_type = p_telemetry_init->uuid_type;
+    p_telemetry->collect   = p_telemetry_init->collect;
+
+    ble_uuid.type = p_telemetry->uuid_type;
+    ble_uuid.uuid = TELEMETRY_UUID_SERVICE;
+
+    err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &p_telemetry->service_handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = record_char_add(p_telemetry);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return crash_char_add(p_telemetry, p_telemetry_init->p_crash, p_telemetry_init->crash_len);
+}
+
+
+void ble_telemetry_on_ble_evt(ble_telemetry_t * p_telemetry, ble_evt_t const * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
+            on_read_authorize(p_telemetry, p_ble_evt);
+            break;
+
+        case BLE_GATTS_EVT_WRITE:
+            on_write(p_telemetry, p_ble_evt);
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+uint32_t ble_telemetry_notify(ble_telemetry_t * p_telemetry, uint16_t conn_handle)
+{
+    ble_gatts_hvx_params_t hvx_params;
+    uint8_t                buf[TELEMETRY_RECORD_LEN];
+    uint16_t               len;
+
+    if (conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    len = record_get(p_telemetry, buf);
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle = p_telemetry->record_handles.value_handle;
+    hvx_params.p_data = buf;
+    hvx_params.p_len  = &len;
+    hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+
+    return sd_ble_gatts_hvx(conn_handle, &hvx_params);
+}
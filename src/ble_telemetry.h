@@ -0,0 +1,68 @@
+#ifndef BLE_TELEMETRY_H__
+#define BLE_TELEMETRY_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "telemetry.h"
+#include "crash_log.h"
+
+/* Telemetry Service UUIDs, on the PixWatch base UUID. */
+#define TELEMETRY_UUID_SERVICE      0x1550  /**< 16-bit service UUID for the Telemetry Service. */
+#define TELEMETRY_UUID_CHAR_RECORD  0x1551  /**< Telemetry record (see telemetry.h): read, or notified. */
+#define TELEMETRY_UUID_CHAR_CRASH   0x1552  /**< Crash report of the previous run (see crash_log.h): read. Empty if there is none. */
+
+
+/**@brief Function type for filling in a telemetry record with the current counters. */
+typedef void (* ble_telemetry_collect_t)(telemetry_record_t * p_record);
+
+/**@brief Telemetry Service structure.
+ *
+ * @details The record is collected when it is read, so a read always returns current counters.
+ *          Enabling notifications sends a record at once; the application sends more with
+ *          ble_telemetry_notify().
+ */
+typedef struct
+{
+    uint16_t                 service_handle;   /**< Handle of the service, as provided by the BLE stack. */
+    ble_gatts_char_handles_t record_handles;   /**< Handles of the record characteristic. */
+    ble_gatts_char_handles_t crash_handles;    /**< Handles of the crash report characteristic. */
+    uint8_t                  uuid_type;        /**< UUID type of the PixWatch base UUID. */
+    ble_telemetry_collect_t  collect;          /**< Function filling in the record. */
+} ble_telemetry_t;
+
+/**@brief Telemetry Service init structure. */
+typedef struct
+{
+    uint8_t                 uuid_type;  /**< UUID type of the PixWatch base UUID, as returned by sd_ble_uuid_vs_add(). */
+    ble_telemetry_collect_t collect;    /**< Function filling in the record. */
+    uint8_t const *         p_crash;    /**< Crash report, as encoded by crash_log_report_encode(). */
+    uint16_t                crash_len;  /**< Length of the crash report, 0 if there is none. */
+} ble_telemetry_init_t;
+
+
+/**@brief Function for initializing the Telemetry Service.
+ *
+ * @param[out] p_telemetry       Telemetry Service structure.
+ * @param[in]  p_telemetry_init  Information needed to initialize the service.
+ *
+ * @return NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_telemetry_init(ble_telemetry_t * p_telemetry, const ble_telemetry_init_t * p_telemetry_init);
+
+/**@brief Function for handling the application's BLE stack events.
+ *
+ * @param[in] p_telemetry  Telemetry Service structure.
+ * @param[in] p_ble_evt    Event received from the BLE stack.
+ */
+void ble_telemetry_on_ble_evt(ble_telemetry_t * p_telemetry, ble_evt_t const * p_ble_evt);
+
+/**@brief Function for notifying a telemetry record on a link.
+ *
+ * @retval NRF_SUCCESS              If the record was queued.
+ * @retval NRF_ERROR_INVALID_STATE  If notifications are not enabled on the link.
+ * @retval BLE_ERROR_NO_TX_BUFFERS  If the SoftDevice has no free TX buffer.
+ */
+uint32_t ble_telemetry_notify(ble_telemetry_t * p_telemetry, uint16_t conn_handle);
+
+#endif /* BLE_TELEMETRY_H__ */
@@ -0,0 +1,93 @@
+#include <string.h>
+#include "nrf.h"
+#include "boot_log.h"
+#include "dlog.h"
+
+#define BOOT_TIMER      NRF_TIMER1
+#define CC_CAPTURE      0          /**< Capture register used to read the counter. */
+#define PRESCALER_1MHZ  4          /**< 16 MHz / 2^4. */
+
+
+static uint32_t m_stamps[BOOT_STAGE_COUNT];
+static uint32_t m_stop_time;
+static bool     m_running;
+
+static char const * const m_stage_names[BOOT_STAGE_COUNT] =
+{
+    [BOOT_STAGE_TIMERS]        = "timers",
+    [BOOT_STAGE_BLE_STACK]     = "ble stack",
+    [BOOT_STAGE_STORAGE]       = "storage",
+    [BOOT_STAGE_SERVICES]      = "services",
+    [BOOT_STAGE_ADVERTISING]   = "advertising",
+    [BOOT_STAGE_DISPLAY_READY] = "display ready",
+    [BOOT_STAGE_FIRST_PIXEL]   = "first pixel",
+    [BOOT_STAGE_DEFERRED]      = "deferred",
+};
+
+
+void boot_log_start(void)
+{
+    memset(m_stamps, 0xFF, sizeof(m_stamps));
+
+    BOOT_TIMER->TASKS_STOP  = 1;
+    BOOT_TIMER->TASKS_CLEAR = 1;
+    BOOT_TIMER->MODE        = TIMER_MODE_MODE_Timer << TIMER_MODE_MODE_Pos;
+    BOOT_TIMER->BITMODE     = TIMER_BITMODE_BITMODE_32Bit << TIMER_BITMODE_BITMODE_Pos;
+    BOOT_TIMER->PRESCALER   = PRESCALER_1MHZ;
+    BOOT_TIMER->TASKS_START = 1;
+    m_running = true;
+}
+
+
+uint32_t boot_log_time_get(void)
+{
+    if (!m_running)
+    {
+        return m_stop_time;
+    }
+
+    BOOT_TIMER->TASKS_CAPTURE[CC_CAPTURE] = 1;
+    return BOOT_TIMER->CC[CC_CAPTURE];
+}
+
+
+void boot_log_stamp(boot_stage_t stage)
+{
+    if ((stage < BOOT_STAGE_COUNT) && (m_stamps[stage] == BOOT_LOG_NONE))
+    {
+        m_stamps[stage] = boot_log_time_get();
+    }
+}
+
+
+void boot_log_stop(void)
+{
+    m_stop_time = boot_log_time_get();
+    m_running   = false;
+
+    BOOT_TIMER->TASKS_STOP = 1;
+}
+
+
+uint32_t boot_log_stage_get(boot_stage_t stage)
+{
+    return (stage < BOOT_STAGE_COUNT) ? m_stamps[stage] : BOOT_LOG_NONE;
+}
+
+
+void boot_log_print(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < BOOT_STAGE_COUNT; i++)
+    {
+        if (m_stamps[i] == BOOT_LOG_NONE)
+        {
+            DLOG_INFO("Boot %s: not reached.\n", m_stage_names[i]);
+        }
+        else
+        {
+            DLOG_INFO("Boot %s: %u us.\n", m_stage_names[i], m_stamps[i]);
+        }
+    }
+}
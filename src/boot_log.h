@@ -0,0 +1,57 @@
+#ifndef BOOT_LOG_H__
+#define BOOT_LOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BOOT_LOG_NONE  0xFFFFFFFF  /**< Time of a stage that was not reached. */
+
+/**@brief Boot stages. The display stages run concurrently with the others, so stages are not
+ *        necessarily reached in this order.
+ */
+typedef enum
+{
+    BOOT_STAGE_TIMERS,         /**< Scheduler and app timer up, display reset pulse started. */
+    BOOT_STAGE_BLE_STACK,      /**< SoftDevice enabled, low frequency clock running. */
+    BOOT_STAGE_STORAGE,        /**< Device Manager and the flash stores initialized. */
+    BOOT_STAGE_SERVICES,       /**< GAP, services, advertising and connection parameters set up. */
+    BOOT_STAGE_ADVERTISING,    /**< Advertising started. */
+    BOOT_STAGE_DISPLAY_READY,  /**< Display out of reset and configured. */
+    BOOT_STAGE_FIRST_PIXEL,    /**< First frame drawn. */
+    BOOT_STAGE_DEFERRED,       /**< Work deferred until after the first frame done. */
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+
+/**@brief Function for starting the boot clock. Called first thing in main().
+ *
+ * @details The boot clock is TIMER1 counting microseconds. Unlike the DWT cycle counter it keeps
+ *          counting while the CPU sleeps, and unlike RTC1 it does not wait for the low frequency
+ *          clock, which the SoftDevice starts.
+ */
+void boot_log_start(void);
+
+/**@brief Function for reading the boot clock.
+ *
+ * @return Microseconds since boot_log_start(), or the time boot_log_stop() was called.
+ */
+uint32_t boot_log_time_get(void);
+
+/**@brief Function for recording that a stage was reached. A stage is only recorded once. */
+void boot_log_stamp(boot_stage_t stage);
+
+/**@brief Function for stopping the boot clock when the boot is over. TIMER1 keeps the high
+ *        frequency clock running, so it must not be left on.
+ */
+void boot_log_stop(void);
+
+/**@brief Function for getting the time a stage was reached.
+ *
+ * @return Microseconds since boot_log_start(), or BOOT_LOG_NONE if the stage was not reached.
+ */
+uint32_t boot_log_stage_get(boot_stage_t stage);
+
+/**@brief Function for writing the stage times to the log. */
+void boot_log_print(void);
+
+#endif /* BOOT_LOG_H__ */
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "nordic_common.h"
+#include "app_scheduler.h"
+#include "console.h"
+#include "dlog.h"
+
+
+static console_cmd_t const * mp_cmds;
+static uint8_t               m_cmd_count;
+static char                  m_line[CONSOLE_LINE_MAX + 1];
+static uint8_t               m_line_len;
+static bool                  m_line_overflow;  /**< The line being received is too long, and is discarded. */
+static volatile bool         m_rx_pending;     /**< A call of rx_process() is in the scheduler queue. */
+
+
+void console_init(console_cmd_t const * p_cmds, uint8_t cmd_count)
+{
+    mp_cmds         = p_cmds;
+    m_cmd_count     = cmd_count;
+    m_line_len      = 0;
+    m_line_overflow = false;
+    m_rx_pending    = false;
+}
+
+
+uint8_t console_line_split(char * p_line, char * argv[])
+{
+    uint8_t argc = 0;
+
+    while (*p_line != '\0')
+    {
+        if ((*p_line == ' ') || (*p_line == '\t'))
+        {
+            *p_line++ = '\0';
+            continue;
+        }
+
+        if (argc == CONSOLE_ARGS_MAX)
+        {
+            break;
+        }
+        argv[argc++] = p_line;
+
+        while ((*p_line != '\0') && (*p_line != ' ') && (*p_line != '\t'))
+        {
+            p_line++;
+        }
+    }
+
+    return argc;
+}
+
+
+static void help_print(void)
+{
+    uint8_t i;
+
+    DLOG_INFO("help: list the commands.\n");
+    for (i = 0; i < m_cmd_count; i++)
+    {
+        DLOG_INFO("%s: %s\n", mp_cmds[i].p_name, mp_cmds[i].p_help);
+    }
+}
+
+
+void console_line_run(char * p_line)
+{
+    char *  argv[CONSOLE_ARGS_MAX];
+    uint8_t argc = console_line_split(p_line, argv);
+    uint8_t i;
+
+    if (argc == 0)
+    {
+        return;
+    }
+
+    if (strcmp(argv[0], "help") == 0)
+    {
+        help_print();
+        return;
+    }
+
+    for (i = 0; i < m_cmd_count; i++)
+    {
+        if (strcmp(argv[0], mp_cmds[i].p_name) == 0)
+        {
+            mp_cmds[i].handler(argc, argv);
+            return;
+        }
+    }
+
+    DLOG_WARNING("Unknown command, try help.\n");
+}
+
+
+/**@brief Function for reading the RX FIFO and running complete lines. Runs in the scheduler context.
+ */
+static void rx_process(void * p_event_data, uint16_t event_size)
+{
+    uint8_t c;
+
+    UNUSED_PARAMETER(p_event_data);
+    UNUSED_PARAMETER(event_size);
+
+    // Cleared first: a character received after the FIFO is found empty schedules another call.
+    m_rx_pending = false;
+
+    while (app_uart_get(&c) == NRF_SUCCESS)
+    {
+        if ((c == '\r') || (c == '\n'))
+        {
+            if (m_line_overflow)
+            {
+                DLOG_WARNING("Console line too long.\n");
+            }
+            else if (m_line_len > 0)
+            {
+                m_line[m_line_len] = '\0';
+                console_line_run(m_line);
+            }
+            m_line_len      = 0;
+            m_line_overflow = false;
+        }
+        else if ((c == '\b') || (c == 0x7F))
+        {
+            if (m_line_len > 0)
+            {
+                m_line_len--;
+            }
+        }
+        else if (m_line_len < CONSOLE_LINE_MAX)
+        {
+            m_line[m_line_len++] = (char)c;
+        }
+        else
+        {
+            m_line_overflow = true;
+        }
+    }
+}
+
+
+void console_on_uart_evt(app_uart_evt_t const * p_event)
+{
+    if ((p_event->evt_type != APP_UART_DATA_READY) || m_rx_pending)
+    {
+        return;
+    }
+
+    // If the scheduler queue is full, the characters stay in the FIFO until the next one arrives.
+    if (app_sched_event_put(NULL, 0, rx_process) == NRF_SUCCESS)
+    {
+        m_rx_pending = true;
+    }
+}
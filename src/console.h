@@ -0,0 +1,60 @@
+#ifndef CONSOLE_H__
+#define CONSOLE_H__
+
+#include <stdint.h>
+#include "app_uart.h"
+
+#define CONSOLE_LINE_MAX  48    /**< Longest command line, in characters. Longer lines are discarded. */
+#define CONSOLE_ARGS_MAX  4     /**< Maximum number of words in a command line, the command included. */
+
+
+/**@brief Function type of a command handler.
+ *
+ * @param[in] argc  Number of words in the command line, the command included.
+ * @param[in] argv  Words of the command line. The strings are in RAM and only valid during the call,
+ *                  so they can not be logged with %s.
+ */
+typedef void (* console_cmd_handler_t)(uint8_t argc, char * argv[]);
+
+/**@brief Console command. */
+typedef struct
+{
+    char const *          p_name;  /**< Command word. */
+    char const *          p_help;  /**< One line description, printed by the help command. */
+    console_cmd_handler_t handler;
+} console_cmd_t;
+
+
+/**@brief Function for initializing the console.
+ *
+ * @details Lines received on the UART are split in words at spaces and run by the command whose
+ *          name is the first word. A help command listing the table is built in. Responses go to
+ *          the log, so commands should log at DLOG_LEVEL_INFO or below.
+ *
+ * @param[in] p_cmds     Command table. Must stay valid while the console is used.
+ * @param[in] cmd_count  Number of commands in the table.
+ */
+void console_init(console_cmd_t const * p_cmds, uint8_t cmd_count);
+
+/**@brief Function for handling app_uart events. Call it from the app_uart event handler.
+ *
+ * @details Received characters are read from the RX FIFO and parsed in the scheduler context.
+ */
+void console_on_uart_evt(app_uart_evt_t const * p_event);
+
+/**@brief Function for splitting a command line in words, in place.
+ *
+ * @param[in,out] p_line  Null terminated line. Spaces are replaced by null characters.
+ * @param[out]    argv    Array of CONSOLE_ARGS_MAX words.
+ *
+ * @return Number of words. Words beyond CONSOLE_ARGS_MAX are ignored.
+ */
+uint8_t console_line_split(char * p_line, char * argv[]);
+
+/**@brief Function for running one command line. Used for received lines, and for scripted input.
+ *
+ * @param[in,out] p_line  Null terminated line. Modified by the call.
+ */
+void console_line_run(char * p_line);
+
+#endif /* CONSOLE_H__ */
@@ -0,0 +1,248 @@
+#include <string.h>
+#include "nrf.h"
+#include "nordic_common.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "app_scheduler.h"
+#include "crc16.h"
+#include "crash_log.h"
+#include "dlog.h"
+
+#define CRASH_LOG_MAGIC  0x43524C47  /**< Marks the no-init RAM as written by this module ("CRLG"). */
+#define EVENT_MASK       (CRASH_LOG_EVENTS - 1)
+#define RTC_MASK         0x00FFFFFF
+
+STATIC_ASSERT(IS_POWER_OF_TWO(CRASH_LOG_EVENTS));
+
+
+/**@brief Trace event. */
+typedef struct
+{
+    uint32_t time_id;  /**< RTC1 counter (bits 0-23), event id (bits 24-31). */
+    uint32_t arg;
+} event_t;
+
+/**@brief Fault snapshot. */
+typedef struct
+{
+    uint32_t type;         /**< crash_log_fault_type_t. */
+    uint32_t error_code;
+    uint32_t line_num;
+    uint32_t file;
+    uint32_t pc;
+    uint32_t lr;
+    uint32_t uptime;
+    uint16_t sched_space;
+    uint16_t sched_hwm;
+    uint32_t rtc;
+} fault_t;
+
+/**@brief Content of the no-init RAM. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t head;                       /**< Events written, free running. */
+    event_t  events[CRASH_LOG_EVENTS];
+    fault_t  fault;
+    uint16_t fault_crc;                  /**< CRC-16 of fault, valid if fault.type is not CRASH_LOG_FAULT_NONE. */
+} crash_ram_t;
+
+
+static crash_ram_t      m_ram __attribute__((section(".noinit")));  /**< Record of this run. */
+static crash_ram_t      m_previous;                                 /**< Record of the previous run, magic is 0 if there is none. */
+static uint32_t const * mp_uptime;
+
+
+/**@brief Function for recording a fault. Only the first fault of a run is kept.
+ *
+ * @details Called from fault context: must not call the SoftDevice.
+ */
+static void fault_record(crash_log_fault_type_t type,
+                         uint32_t               error_code,
+                         uint32_t               line_num,
+                         uint32_t               file,
+                         uint32_t               pc,
+                         uint32_t               lr)
+{
+    fault_t * p_fault = &m_ram.fault;
+
+    if ((m_ram.magic != CRASH_LOG_MAGIC) || (p_fault->type != CRASH_LOG_FAULT_NONE))
+    {
+        return;
+    }
+
+    p_fault->type        = type;
+    p_fault->error_code  = error_code;
+    p_fault->line_num    = line_num;
+    p_fault->file        = file;
+    p_fault->pc          = pc;
+    p_fault->lr          = lr;
+    p_fault->uptime      = (mp_uptime != NULL) ? *mp_uptime : 0;
+    p_fault->sched_space = app_sched_queue_space_get();
+    p_fault->sched_hwm   = app_sched_queue_utilization_get();
+    p_fault->rtc         = NRF_RTC1->COUNTER;
+
+    m_ram.fault_crc = crc16_compute((uint8_t const *)p_fault, sizeof(*p_fault), NULL);
+}
+
+
+void crash_log_init(uint32_t reset_reason, uint32_t const * p_uptime)
+{
+    mp_uptime = p_uptime;
+
+    memset(&m_previous, 0, sizeof(m_previous));
+
+    // RAM content is undefined after a power-on reset, the only reset that leaves RESETREAS empty.
+    if ((reset_reason != 0) && (m_ram.magic == CRASH_LOG_MAGIC))
+    {
+        m_previous = m_ram;
+
+        if ((m_previous.fault.type != CRASH_LOG_FAULT_NONE) &&
+            (crc16_compute((uint8_t const *)&m_previous.fault, sizeof(m_previous.fault), NULL) !=
+             m_previous.fault_crc))
+        {
+            memset(&m_previous.fault, 0, sizeof(m_previous.fault));
+        }
+    }
+
+    memset(&m_ram, 0, sizeof(m_ram));
+    m_ram.magic = CRASH_LOG_MAGIC;
+
+    crash_log_trace(CRASH_LOG_EVT_BOOT, reset_reason);
+}
+
+
+void crash_log_trace(crash_log_evt_id_t id, uint32_t arg)
+{
+    event_t * p_event;
+
+    CRITICAL_REGION_ENTER();
+
+    p_event          = &m_ram.events[m_ram.head & EVENT_MASK];
+    p_event->time_id = (NRF_RTC1->COUNTER & RTC_MASK) | ((uint32_t)id << 24);
+    p_event->arg     = arg;
+    m_ram.head++;
+
+    CRITICAL_REGION_EXIT();
+}
+
+
+void crash_log_app_error(uint32_t error_code, uint32_t line_num, uint8_t const * p_file_name, uint32_t pc)
+{
+    fault_record(CRASH_LOG_FAULT_APP_ERROR, error_code, line_num, (uint32_t)p_file_name, pc, 0);
+}
+
+
+/**@brief Function for recording a hard fault.
+ *
+ * @param[in] p_stack  Exception stack frame: r0-r3, r12, lr, pc, xpsr.
+ */
+static __attribute__((used)) void hard_fault_handler_c(uint32_t const * p_stack)
+{
+    fault_record(CRASH_LOG_FAULT_HARD_FAULT, SCB->CFSR, 0, SCB->HFSR, p_stack[6], p_stack[5]);
+    NVIC_SystemReset();
+}
+
+
+#if defined(__arm__)
+/**@brief Hard fault handler, replacing the default one of the startup file. Passes the stack frame
+ *        of the faulting context to hard_fault_handler_c(). Not in the host build (host/Makefile),
+ *        which has no exception stack frames.
+ */
+void HardFault_Handler(void) __attribute__((naked));
+void HardFault_Handler(void)
+{
+    __ASM volatile(
+        "    tst   lr, #4               \n"
+        "    ite   eq                   \n"
+        "    mrseq r0, msp              \n"
+        "    mrsne r0, psp              \n"
+        "    b     hard_fault_handler_c \n");
+}
+#endif
+
+
+uint16_t crash_log_report_encode(uint8_t * p_buf)
+{
+    fault_t const * p_fault = &m_previous.fault;
+    uint32_t        count;
+    uint32_t        index;
+    uint16_t        len;
+
+    if (m_previous.magic != CRASH_LOG_MAGIC)
+    {
+        return 0;
+    }
+
+    count = MIN(m_previous.head, CRASH_LOG_EVENTS);
+
+    p_buf[0] = CRASH_LOG_VERSION;
+    p_buf[1] = (uint8_t)p_fault->type;
+    len  = 2;
+    len += uint32_encode(p_fault->error_code, &p_buf[len]);
+    len += uint32_encode(p_fault->line_num, &p_buf[len]);
+    len += uint32_encode(p_fault->file, &p_buf[len]);
+    len += uint32_encode(p_fault->pc, &p_buf[len]);
+    len += uint32_encode(p_fault->lr, &p_buf[len]);
+    len += uint32_encode(p_fault->uptime, &p_buf[len]);
+    len += uint16_encode(p_fault->sched_space, &p_buf[len]);
+    len += uint16_encode(p_fault->sched_hwm, &p_buf[len]);
+    p_buf[len++] = (uint8_t)p_fault->rtc;
+    p_buf[len++] = (uint8_t)(p_fault->rtc >> 8);
+    p_buf[len++] = (uint8_t)(p_fault->rtc >> 16);
+    p_buf[len++] = (uint8_t)count;
+
+    for (index = m_previous.head - count; index != m_previous.head; index++)
+    {
+        len += uint32_encode(m_previous.events[index & EVENT_MASK].time_id, &p_buf[len]);
+        len += uint32_encode(m_previous.events[index & EVENT_MASK].arg, &p_buf[len]);
+    }
+
+    return len;
+}
+
+
+void crash_log_report_print(void)
+{
+    fault_t const * p_fault = &m_previous.fault;
+    uint32_t        count;
+    uint32_t        index;
+
+    if (m_previous.magic != CRASH_LOG_MAGIC)
+    {
+        return;
+    }
+
+    switch (p_fault->type)
+    {
+        case CRASH_LOG_FAULT_APP_ERROR:
+            DLOG_ERROR("Previous run: error 0x%x at %s:%u, pc 0x%x.\n",
+                       p_fault->error_code, (char const *)p_fault->file, p_fault->line_num, p_fault->pc);
+            break;
+
+        case CRASH_LOG_FAULT_HARD_FAULT:
+            DLOG_ERROR("Previous run: hard fault, CFSR 0x%x, HFSR 0x%x, pc 0x%x, lr 0x%x.\n",
+                       p_fault->error_code, p_fault->file, p_fault->pc, p_fault->lr);
+            break;
+
+        default:
+            DLOG_ERROR("Previous run: no fault recorded.\n");
+            break;
+    }
+
+    if (p_fault->type != CRASH_LOG_FAULT_NONE)
+    {
+        DLOG_ERROR("Previous run: uptime %u s, scheduler queue %u free, %u max used.\n",
+                   p_fault->uptime, p_fault->sched_space, p_fault->sched_hwm);
+    }
+
+    // Oldest first; the RTC1 counter dates them relative to each other and to the fault.
+    count = MIN(m_previous.head, CRASH_LOG_EVENTS);
+    for (index = m_previous.head - count; index != m_previous.head; index++)
+    {
+        event_t const * p_event = &m_previous.events[index & EVENT_MASK];
+
+        DLOG_ERROR("Trace: event %u, arg 0x%x, rtc %u.\n",
+                   p_event->time_id >> 24, p_event->arg, p_event->time_id & RTC_MASK);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef CRASH_LOG_H__
+#define CRASH_LOG_H__
+
+#include <stdint.h>
+
+#define CRASH_LOG_EVENTS      16      /**< Number of trace events kept. Must be a power of two. */
+#define CRASH_LOG_VERSION     1       /**< Version of the encoded report. */
+#define CRASH_LOG_HEADER_LEN  34      /**< Encoded length of the report without the events. */
+#define CRASH_LOG_EVENT_LEN   8       /**< Encoded length of one trace event. */
+#define CRASH_LOG_REPORT_MAX  (CRASH_LOG_HEADER_LEN + CRASH_LOG_EVENTS * CRASH_LOG_EVENT_LEN)
+
+/* Encoded report, little endian:
+ *
+ *   offset  size  field
+ *   0       1     CRASH_LOG_VERSION
+ *   1       1     fault type (crash_log_fault_type_t)
+ *   2       4     error code; CFSR for a hard fault
+ *   6       4     line number; 0 for a hard fault
+ *   10      4     address of the file name in flash; HFSR for a hard fault
+ *   14      4     PC
+ *   18      4     LR; 0 for an application error
+ *   22      4     uptime in seconds
+ *   26      2     free scheduler queue entries
+ *   28      2     maximum scheduler queue utilization
+ *   30      3     RTC1 counter
+ *   33      1     number of trace events n, oldest first
+ *   34      8*n   RTC1 counter (3), event id (1), argument (4)
+ */
+
+
+/**@brief Fault types. */
+typedef enum
+{
+    CRASH_LOG_FAULT_NONE,       /**< Reset without a recorded fault, e.g. by the watchdog or a pin reset. */
+    CRASH_LOG_FAULT_APP_ERROR,  /**< app_error_handler(), including SoftDevice asserts. */
+    CRASH_LOG_FAULT_HARD_FAULT  /**< Hard fault exception. */
+} crash_log_fault_type_t;
+
+/**@brief Trace event ids. */
+typedef enum
+{
+    CRASH_LOG_EVT_BOOT,          /**< Argument: RESETREAS. */
+    CRASH_LOG_EVT_BLE,           /**< Argument: BLE event id (bits 0-15), connection handle (bits 16-31). */
+    CRASH_LOG_EVT_BUTTON,        /**< Argument: pin number (bits 0-7), button action (bits 8-15). */
+    CRASH_LOG_EVT_ADV            /**< Argument: BLE advertising event. */
+} crash_log_evt_id_t;
+
+
+/**@brief Function for initializing the crash log.
+ *
+ * @details The trace ring and the fault snapshot live in RAM that is not cleared by the startup
+ *          code, so they survive soft resets, watchdog resets and pin resets. If they hold a
+ *          valid record from before the reset, it is kept as the report of the previous run and
+ *          the ring is cleared for this run.
+ *
+ * @param[in] reset_reason  NRF_POWER->RESETREAS at boot. RAM content is not trusted after a
+ *                          power-on reset (no reset reason bits set).
+ * @param[in] p_uptime      Application uptime counter in seconds, read when a fault is recorded.
+ */
+void crash_log_init(uint32_t reset_reason, uint32_t const * p_uptime);
+
+/**@brief Function for adding an event to the trace ring. Can be called from any interrupt priority. */
+void crash_log_trace(crash_log_evt_id_t id, uint32_t arg);
+
+/**@brief Function for recording an application error. Called from app_error_handler() before the
+ *        reset.
+ *
+ * @param[in] error_code   Error code passed to app_error_handler().
+ * @param[in] line_num     Line number of the error.
+ * @param[in] p_file_name  File name of the error, in flash.
+ * @param[in] pc           Address the error was raised at.
+ */
+void crash_log_app_error(uint32_t error_code, uint32_t line_num, uint8_t const * p_file_name, uint32_t pc);
+
+/**@brief Function for getting the encoded report of the previous run.
+ *
+ * @param[out] p_buf  Buffer of CRASH_LOG_REPORT_MAX bytes.
+ *
+ * @return Encoded length, or 0 if the previous run left no record.
+ */
+uint16_t crash_log_report_encode(uint8_t * p_buf);
+
+/**@brief Function for writing the report of the previous run to the log, if there is one. */
+void crash_log_report_print(void);
+
+#endif /* CRASH_LOG_H__ */
@@ -0,0 +1,18 @@
+#ifndef CYCLE_COUNTER_H__
+#define CYCLE_COUNTER_H__
+
+#include "nrf.h"
+#include "compiler_abstraction.h"
+
+/**@brief Function for enabling the DWT cycle counter, read from DWT->CYCCNT.
+ *
+ * @details The counter is shared by the modules measuring their cost; each enables it at init, and
+ *          enabling it again leaves it running.
+ */
+static __INLINE void cycle_counter_enable(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+#endif /* CYCLE_COUNTER_H__ */
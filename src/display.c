@@ -21,6 +21,8 @@
 
 static const nrf_drv_spi_t m_spi_master_0 = NRF_DRV_SPI_INSTANCE(0);
 
+static uint32_t spi_bytes;  // Bytes sent to the display since reset.
+
 void spi_master_init(void)
 {
     nrf_drv_spi_config_t config =
@@ -52,79 +54,141 @@ void writeCommand(uint8_t c) {
     nrf_gpio_pin_write(DC_PIN, 0); // command
     tx_buffer[0] = c;
     nrf_drv_spi_transfer(&m_spi_master_0, tx_buffer, buf_len, rx_buffer, 0);
+    spi_bytes += buf_len;
 }
 
 void writeData(uint8_t c) {
     nrf_gpio_pin_write(DC_PIN, 1); // data
     tx_buffer[0] = c;
     nrf_drv_spi_transfer(&m_spi_master_0, tx_buffer, buf_len, rx_buffer, 0);
+    spi_bytes += buf_len;
 }
 
 void spiWrite(uint8_t c) {
     tx_buffer[0] = c;
     nrf_drv_spi_transfer(&m_spi_master_0, tx_buffer, buf_len, rx_buffer, 0);
+    spi_bytes += buf_len;
+}
+
+
+// Init sequence steps that drive the reset pin instead of sending a command.
+#define INIT_RESET_LOW  0x100
+#define INIT_RESET_HIGH 0x101
+
+#define INIT_RUN_MAX    16   // bytes sent in one SPI transfer
+
+// One step of the init sequence: a command with its data bytes, then a wait.
+typedef struct {
+    uint16_t cmd;         // command byte, or INIT_RESET_LOW / INIT_RESET_HIGH
+    uint8_t  len;         // number of data bytes
+    uint8_t  data[3];
+    uint8_t  delay_ms;    // wait after the step
+} init_step_t;
+
+static const init_step_t init_steps[] = {
+    {INIT_RESET_LOW,  0, {0},                20},  // reset pulse
+    {INIT_RESET_HIGH, 0, {0},                50},  // controller start-up
+    {0xfd,            1, {0x12},             0},   // unlock
+    {0xfd,            1, {0xb1},             0},   // unlock
+    {0xae,            0, {0},                0},   // display off
+    {0xb3,            1, {0xf1},             0},   // clock div
+    {0xca,            1, {0x7f},             0},   // Multiplex Ratio
+    {0xa0,            1, {0x74},             0},   // remap
+    {0x15,            2, {0, 0x7f},          0},   // col 0-127
+    {0x65,            2, {0, 0x7f},          0},   // row 0-127
+    {0xa1,            1, {96},               0},   // startline (if height=96)
+    {0xa2,            1, {0},                0},   // display offset
+    {0xb5,            1, {0},                0},   // GPIO
+    {0xab,            1, {1},                0},   // func select
+    {0xb1,            1, {0x32},             0},   // precharge
+    {0xbe,            1, {5},                0},   // vcomh
+    {0xa6,            0, {0},                0},   // normal display
+    {0xc1,            3, {0xc8, 0x80, 0xc8}, 0},   // contrast abc
+    {0xc7,            1, {0x0f},             0},   // contrast master
+    {0xb4,            3, {0xa0, 0xb5, 0x55}, 0},   // set vsl
+    {0xb6,            1, {1},                0},   // precharge2
+    {0xaf,            0, {0},                0},   // display on
+};
+
+#define INIT_STEP_COUNT (sizeof(init_steps) / sizeof(init_steps[0]))
+
+static uint8_t  init_step;      // next step to run
+static uint32_t init_due;       // time the next step is due, in microseconds
+static uint8_t  init_run[INIT_RUN_MAX];  // bytes of one D/C level, in RAM for EasyDMA
+static uint8_t  init_run_len;
+static uint8_t  init_run_dc;
+
+// Send the bytes collected for one D/C level in one transfer.
+static void initRunFlush(void) {
+    if (init_run_len > 0) {
+        nrf_gpio_pin_write(DC_PIN, init_run_dc);
+        nrf_drv_spi_transfer(&m_spi_master_0, init_run, init_run_len, rx_buffer, 0);
+        spi_bytes += init_run_len;
+        init_run_len = 0;
+    }
 }
 
+// Add a byte to the transfer, starting a new one if the D/C level changes.
+static void initRunAdd(uint8_t dc, uint8_t c) {
+    if ((init_run_len > 0) && ((dc != init_run_dc) || (init_run_len == INIT_RUN_MAX))) {
+        initRunFlush();
+    }
+    init_run_dc = dc;
+    init_run[init_run_len++] = c;
+}
+
+void displayInitStart(uint32_t now) {
+    init_step = 0;
+    init_due = now;
+}
+
+uint32_t displayInitRun(uint32_t now) {
+    while (init_step < INIT_STEP_COUNT) {
+        if ((int32_t)(now - init_due) < 0) {
+            return init_due - now;
+        }
+
+        // Run the steps up to the next wait. Commands go out in one transfer per D/C level.
+        const init_step_t * p_step;
+        do {
+            p_step = &init_steps[init_step++];
+
+            if (p_step->cmd == INIT_RESET_LOW) {
+                nrf_gpio_cfg_output(CS_PIN);
+                nrf_gpio_cfg_output(DC_PIN);
+                nrf_gpio_cfg_output(RESET_PIN);
+
+                nrf_gpio_pin_write(CS_PIN, 1); // disable
+                nrf_gpio_pin_write(DC_PIN, 0); // command
+                nrf_gpio_pin_write(RESET_PIN, 0); // reset
+            } else if (p_step->cmd == INIT_RESET_HIGH) {
+                nrf_gpio_pin_write(RESET_PIN, 1); // un-reset
+            } else {
+                nrf_gpio_pin_write(CS_PIN, 0); // enable
+                initRunAdd(0, (uint8_t)p_step->cmd);
+                for (uint8_t i = 0; i < p_step->len; i++) {
+                    initRunAdd(1, p_step->data[i]);
+                }
+            }
+        } while ((p_step->delay_ms == 0) && (init_step < INIT_STEP_COUNT));
+
+        initRunFlush();
+        nrf_gpio_pin_write(CS_PIN, 1); // disable
+        init_due = now + p_step->delay_ms * 1000;
+    }
+
+    return 0;
+}
 
 void initDisplay() {
-    nrf_gpio_cfg_output(CS_PIN);
-    nrf_gpio_cfg_output(DC_PIN);
-    nrf_gpio_cfg_output(RESET_PIN);
+    uint32_t now = 0;
+    uint32_t wait;
 
-    nrf_gpio_pin_write(CS_PIN, 1); // disable
-    nrf_gpio_pin_write(DC_PIN, 0); // command
-    nrf_gpio_pin_write(RESET_PIN, 0); // reset
-
-    nrf_delay_us(20000);
-    nrf_gpio_pin_write(RESET_PIN, 1); // un-reset
-
-    // Initialize display
-    nrf_delay_us(50000);
-    nrf_gpio_pin_write(CS_PIN, 0); // enable
-    writeCommand(0xfd); // unlock
-    writeData(0x12);
-    writeCommand(0xfd); // unlock
-    writeData(0xb1);
-    writeCommand(0xae); // display off
-    writeCommand(0xb3); // clock div
-    writeData(0xf1);
-    writeCommand(0xca); // Multiplex Ratio
-    writeData(0x7f);
-    writeCommand(0xa0); // remap
-    writeData(0x74);
-    writeCommand(0x15); // col 0-127
-    writeData(0);
-    writeData(0x7f);
-    writeCommand(0x65); // row 0-127
-    writeData(0);
-    writeData(0x7f);
-    writeCommand(0xa1); // startline (if height=96)
-    writeData(96);
-    writeCommand(0xa2); // display offset
-    writeData(0);
-    writeCommand(0xb5); // GPIO
-    writeData(0);
-    writeCommand(0xab); // func select
-    writeData(1);
-    writeCommand(0xB1); // precharge
-    writeData(0x32);
-    writeCommand(0xBE); // vcomh
-    writeData(5);
-    writeCommand(0xA6); // normal display
-    writeCommand(0xC1); // contrast abc
-    writeData(0xC8);
-    writeData(0x80);
-    writeData(0xC8);
-    writeCommand(0xC7); // contrast master
-    writeData(0x0F);
-    writeCommand(0xB4); // set vsl
-    writeData(0xA0);
-    writeData(0xB5);
-    writeData(0x55);
-    writeCommand(0xB6); // precharge2
-    writeData(1);
-    writeCommand(0xaf); // display on
-    nrf_gpio_pin_write(CS_PIN, 1); // disable
+    displayInitStart(now);
+    while ((wait = displayInitRun(now)) != 0) {
+        nrf_delay_us(wait);
+        now += wait;
+    }
 }
 
 // put a pixel on 3x screen.
@@ -147,6 +211,11 @@ void putPixel(uint8_t x, uint8_t y, uint16_t c) {
       pix_buffer[i*2+1] = c;
     }
     nrf_drv_spi_transfer(&m_spi_master_0, pix_buffer, 18, rx_buffer, 0);
+    spi_bytes += 18;
+}
+
+uint32_t spiByteCount(void) {
+    return spi_bytes;
 }
 
 void drawRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t color) {
@@ -164,6 +233,7 @@ void drawRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t colo
         tx_buffer[1] = color;
         nrf_drv_spi_transfer(&m_spi_master_0, tx_buffer, 2, rx_buffer, 0);
     }
+    spi_bytes += 2 * len;
 }
 
 
@@ -30,9 +30,18 @@
 /** SPI init */
 void spi_master_init(void);
 
-/** Init display */
+/** Init display, waiting out the reset in busy loops. SPI must be initialized. */
 void initDisplay();
 
+/** Start the display init sequence. now is a microsecond clock, e.g. the boot clock. */
+void displayInitStart(uint32_t now);
+
+/** Run the steps of the init sequence that are due, the first one starting the reset pulse.
+ *  Returns the microseconds until the next step is due, or 0 when the display is ready. The
+ *  reset and start-up waits of the controller are left to the caller, e.g. to an app timer,
+ *  and the commands between them go out in one SPI transfer per D/C level. */
+uint32_t displayInitRun(uint32_t now);
+
 /** draw rectangle */
 void drawRectangle(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint16_t color);
 
@@ -42,4 +51,7 @@ void putPixel(uint8_t x, uint8_t y, uint16_t c);
 
 void putDigit(uint8_t x, uint8_t y, uint8_t digit, uint16_t color, uint16_t bkcolor);
 
+/** bytes sent to the display since reset. */
+uint32_t spiByteCount(void);
+
 #endif /* DISPLAY_H__ */
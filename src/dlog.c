@@ -0,0 +1,149 @@
+#include <stdarg.h>
+#include <string.h>
+#include "nrf.h"
+#include "nordic_common.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "app_uart.h"
+#include "cycle_counter.h"
+#include "dlog.h"
+
+#define BUFFER_MASK      (DLOG_BUFFER_SIZE - 1)
+#define HEADER_LEN       10
+#define FRAME_MAX_LEN    (HEADER_LEN + 4 * DLOG_MAX_ARGS)
+#define RTC_MASK         0x00FFFFFF
+#define RATE_VALID       0x80000000  /**< Set in a rate limit timestamp once the call site has logged. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(DLOG_BUFFER_SIZE));
+
+
+static uint8_t           m_buffer[DLOG_BUFFER_SIZE];
+static volatile uint32_t m_write_index;  /**< Free running; only written with interrupts disabled. */
+static volatile uint32_t m_read_index;   /**< Free running; only written by dlog_flush(). */
+static uint8_t           m_seq;
+static dlog_stats_t      m_stats;
+
+uint8_t dlog_levels[DLOG_MODULE_COUNT];
+
+
+void dlog_init(void)
+{
+    m_write_index = 0;
+    m_read_index  = 0;
+    m_seq         = 0;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(dlog_levels, DLOG_LEVEL_DEBUG, sizeof(dlog_levels));
+
+    // Enable the DWT cycle counter used for measuring the cost of a log call.
+    cycle_counter_enable();
+}
+
+
+uint32_t dlog_level_set(dlog_module_t module, uint8_t level)
+{
+    if ((module >= DLOG_MODULE_COUNT) || (level > DLOG_LEVEL_DEBUG))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    dlog_levels[module] = level;
+    return NRF_SUCCESS;
+}
+
+
+void dlog_write(uint8_t level, uint8_t nargs, char const * p_fmt, ...)
+{
+    uint8_t  frame[FRAME_MAX_LEN];
+    uint32_t start = DWT->CYCCNT;
+    uint32_t len;
+    uint32_t index;
+    uint32_t i;
+    va_list  args;
+
+    nargs = MIN(nargs, DLOG_MAX_ARGS);
+    len   = HEADER_LEN + 4 * nargs;
+
+    frame[0] = DLOG_SYNC;
+    frame[1] = nargs | (level << 4);
+    (void)uint32_encode((uint32_t)p_fmt, &frame[6]);
+
+    va_start(args, p_fmt);
+    for (i = 0; i < nargs; i++)
+    {
+        (void)uint32_encode(va_arg(args, uint32_t), &frame[HEADER_LEN + 4 * i]);
+    }
+    va_end(args);
+
+    CRITICAL_REGION_ENTER();
+
+    if (DLOG_BUFFER_SIZE - (m_write_index - m_read_index) < len)
+    {
+        m_stats.dropped++;
+    }
+    else
+    {
+        uint32_t counter = NRF_RTC1->COUNTER;
+
+        frame[2] = m_seq++;
+        frame[3] = (uint8_t)counter;
+        frame[4] = (uint8_t)(counter >> 8);
+        frame[5] = (uint8_t)(counter >> 16);
+
+        index = m_write_index;
+        for (i = 0; i < len; i++)
+        {
+            m_buffer[(index + i) & BUFFER_MASK] = frame[i];
+        }
+        m_write_index = index + len;
+        m_stats.frames++;
+    }
+
+    m_stats.write_cycles += DWT->CYCCNT - start;
+
+    CRITICAL_REGION_EXIT();
+}
+
+
+bool dlog_rate_check(uint32_t * p_last, uint32_t interval_ticks)
+{
+    uint32_t now = NRF_RTC1->COUNTER;
+
+    if ((*p_last & RATE_VALID) && (((now - *p_last) & RTC_MASK) < interval_ticks))
+    {
+        CRITICAL_REGION_ENTER();
+        m_stats.suppressed++;
+        CRITICAL_REGION_EXIT();
+        return false;
+    }
+
+    *p_last = now | RATE_VALID;
+    return true;
+}
+
+
+void dlog_flush(void)
+{
+    uint32_t index = m_read_index;
+    uint32_t size;
+
+    // Contiguous spans of the ring, up to the wrap.
+    while (index != m_write_index)
+    {
+        size = MIN(m_write_index - index, DLOG_BUFFER_SIZE - (index & BUFFER_MASK));
+        if (app_uart_write(&m_buffer[index & BUFFER_MASK], &size) != NRF_SUCCESS)
+        {
+            break;
+        }
+        index += size;
+    }
+
+    m_read_index = index;
+}
+
+
+void dlog_stats_get(dlog_stats_t * p_stats)
+{
+    CRITICAL_REGION_ENTER();
+    *p_stats = m_stats;
+    CRITICAL_REGION_EXIT();
+}
@@ -0,0 +1,161 @@
+#ifndef DLOG_H__
+#define DLOG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Log levels. A message is logged when its level is at or below the level set for its module. */
+#define DLOG_LEVEL_NONE     0
+#define DLOG_LEVEL_ERROR    1
+#define DLOG_LEVEL_WARNING  2
+#define DLOG_LEVEL_INFO     3
+#define DLOG_LEVEL_DEBUG    4
+
+#ifndef DLOG_MAX_LEVEL
+#define DLOG_MAX_LEVEL    DLOG_LEVEL_INFO  /**< Highest level compiled in for any module. Set with LOG_LEVEL in the Makefile. */
+#endif
+
+/**@brief Modules with their own log level.
+ *
+ * @details A source file selects its module, and optionally a compile-time level lower or higher
+ *          than DLOG_MAX_LEVEL, before including this header:
+ *
+ *              #define DLOG_MODULE        DLOG_MODULE_PIXWATCH_C
+ *              #define DLOG_MODULE_LEVEL  DLOG_LEVEL_DEBUG
+ *              #include "dlog.h"
+ *
+ *          Calls above min(DLOG_MODULE_LEVEL, DLOG_MAX_LEVEL) are removed by the compiler together
+ *          with their format strings. The others are filtered at run time with dlog_level_set().
+ */
+typedef enum
+{
+    DLOG_MODULE_MAIN,
+    DLOG_MODULE_PIXWATCH_C,
+    DLOG_MODULE_COUNT
+} dlog_module_t;
+
+#ifndef DLOG_MODULE
+#define DLOG_MODULE       DLOG_MODULE_MAIN
+#endif
+
+#ifndef DLOG_MODULE_LEVEL
+#define DLOG_MODULE_LEVEL DLOG_MAX_LEVEL
+#endif
+
+#define DLOG_BUFFER_SIZE  512   /**< Size of the log ring buffer. Must be a power of two. */
+#define DLOG_MAX_ARGS     4     /**< Maximum number of arguments of a log call. */
+#define DLOG_SYNC         0xA5  /**< First byte of every frame. */
+
+/* Frame, little endian:
+ *
+ *   offset  size  field
+ *   0       1     DLOG_SYNC
+ *   1       1     number of arguments (bits 0-3), level (bits 4-6)
+ *   2       1     sequence number, incremented per frame; a gap means frames were dropped
+ *   3       3     RTC1 counter
+ *   6       4     address of the format string in flash
+ *   10      4*n   arguments
+ *
+ * tools/dlog_decode.py reads the format strings from the ELF file of the firmware.
+ */
+
+
+/**@brief Deferred logger statistics. */
+typedef struct
+{
+    uint32_t frames;        /**< Frames written to the ring buffer. */
+    uint32_t dropped;       /**< Frames dropped because the ring buffer was full. */
+    uint32_t write_cycles;  /**< CPU cycles spent in dlog_write(). */
+    uint32_t suppressed;    /**< Messages skipped by DLOG_LIMITED(). */
+} dlog_stats_t;
+
+
+/**@brief Runtime level of each module. Use dlog_level_set() to change it. */
+extern uint8_t dlog_levels[DLOG_MODULE_COUNT];
+
+#define DLOG_NARGS_(FMT, A1, A2, A3, A4, N, ...) N
+#define DLOG_NARGS(...) DLOG_NARGS_(__VA_ARGS__, 4, 3, 2, 1, 0)
+
+/**@brief Macro for checking at compile time whether calls of a level are built into this file. */
+#define DLOG_COMPILED(LEVEL) (((LEVEL) <= DLOG_MODULE_LEVEL) && ((LEVEL) <= DLOG_MAX_LEVEL))
+
+/**@brief Macro for checking whether a message of a level is currently logged. */
+#define DLOG_ACTIVE(LEVEL)   (DLOG_COMPILED(LEVEL) && ((LEVEL) <= dlog_levels[DLOG_MODULE]))
+
+/**@brief Macro for logging a message at a level.
+ *
+ * @details Only the format string address and the arguments are stored; formatting is done on
+ *          the host. Arguments must be integers or pointers, at most DLOG_MAX_ARGS of them. A %s
+ *          argument must point to a constant string in flash.
+ */
+#define DLOG_AT(LEVEL, ...)                                                       \
+    do                                                                            \
+    {                                                                             \
+        if (DLOG_ACTIVE(LEVEL))                                                   \
+        {                                                                         \
+            dlog_write((LEVEL), DLOG_NARGS(__VA_ARGS__), __VA_ARGS__);            \
+        }                                                                         \
+    } while (0)
+
+/**@brief Macro for logging a message at most once per interval, for calls on hot paths.
+ *
+ * @details Each call site keeps the time it last logged. Skipped messages are counted in
+ *          dlog_stats_t.suppressed. The interval must be shorter than the RTC1 wrap (512 s).
+ */
+#define DLOG_LIMITED(LEVEL, INTERVAL_MS, ...)                                     \
+    do                                                                            \
+    {                                                                             \
+        static uint32_t dlog_last_;                                               \
+        if (DLOG_ACTIVE(LEVEL) &&                                                 \
+            dlog_rate_check(&dlog_last_, DLOG_MS_TO_TICKS(INTERVAL_MS)))          \
+        {                                                                         \
+            dlog_write((LEVEL), DLOG_NARGS(__VA_ARGS__), __VA_ARGS__);            \
+        }                                                                         \
+    } while (0)
+
+#define DLOG_MS_TO_TICKS(MS) ((uint32_t)(((uint64_t)(MS) * 32768) / 1000))  /**< RTC1 runs at 32768 Hz (prescaler 0). */
+
+#define DLOG_ERROR(...)   DLOG_AT(DLOG_LEVEL_ERROR, __VA_ARGS__)
+#define DLOG_WARNING(...) DLOG_AT(DLOG_LEVEL_WARNING, __VA_ARGS__)
+#define DLOG_INFO(...)    DLOG_AT(DLOG_LEVEL_INFO, __VA_ARGS__)
+#define DLOG_DEBUG(...)   DLOG_AT(DLOG_LEVEL_DEBUG, __VA_ARGS__)
+
+
+/**@brief Function for initializing the deferred logger. All modules start at DLOG_LEVEL_DEBUG,
+ *        so every call compiled in is logged.
+ */
+void dlog_init(void);
+
+/**@brief Function for setting the runtime level of a module.
+ *
+ * @retval NRF_SUCCESS              If the level was set.
+ * @retval NRF_ERROR_INVALID_PARAM  If the module or the level is out of range.
+ */
+uint32_t dlog_level_set(dlog_module_t module, uint8_t level);
+
+/**@brief Function for writing a frame to the ring buffer. Use the DLOG_ macros instead.
+ *
+ * @details Can be called from any interrupt priority.
+ */
+void dlog_write(uint8_t level, uint8_t nargs, char const * p_fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/**@brief Function for checking the rate limit of a DLOG_LIMITED() call site.
+ *
+ * @param[in,out] p_last         Time the call site last logged, 0 if never.
+ * @param[in]     interval_ticks Minimum time between two messages, in RTC1 ticks.
+ *
+ * @return true if the message is to be logged.
+ */
+bool dlog_rate_check(uint32_t * p_last, uint32_t interval_ticks);
+
+/**@brief Function for passing buffered frames to the UART, as far as its TX FIFO allows.
+ *
+ * @details Called from the main loop before going to sleep. The UART TX interrupt wakes the CPU
+ *          again when there is room for more.
+ */
+void dlog_flush(void);
+
+/**@brief Function for getting the deferred logger statistics. */
+void dlog_stats_get(dlog_stats_t * p_stats);
+
+#endif /* DLOG_H__ */
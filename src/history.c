@@ -0,0 +1,662 @@
+#include <stddef.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "crc16.h"
+#include "pstorage.h"
+#include "history.h"
+
+#define HISTORY_BLOCK_MAGIC    0x5AA5
+#define HISTORY_DATA_MAX       (HISTORY_BLOCK_SIZE - HISTORY_HEADER_LEN)  /**< Encoded bytes a block holds. */
+#define HISTORY_ERASED_WORD    0xFFFFFFFF
+#define HISTORY_COUNT_MAX      0xFFFF
+
+#define TOKEN_REGULAR          0
+#define TOKEN_IRREGULAR        1
+#define TOKEN_RUN              2
+
+#define SLOT_NONE              0xFFFF
+
+/**@brief Block header. The encoded samples follow. */
+typedef struct
+{
+    uint32_t seq;
+    uint32_t first_time;
+    uint32_t last_time;
+    int32_t  first_value;
+    int32_t  min;
+    int32_t  max;
+    uint16_t count;
+    uint8_t  series;
+    uint8_t  length;   /**< Encoded bytes after the header. */
+    uint16_t crc;      /**< CRC of the fields above and the encoded bytes. */
+    uint16_t magic;    /**< HISTORY_BLOCK_MAGIC. Written last, so a block with a magic has a whole header. */
+} block_hdr_t;
+
+STATIC_ASSERT(sizeof(block_hdr_t) == HISTORY_HEADER_LEN);
+STATIC_ASSERT(HISTORY_DATA_MAX <= UINT8_MAX);
+
+/**@brief Block being filled in RAM. */
+typedef struct
+{
+    block_hdr_t hdr;                      /**< Summary so far; length counts the bytes in data. */
+    uint8_t     data[HISTORY_DATA_MAX];
+    uint16_t    run;                      /**< Trailing run of unchanged regular samples, not yet encoded. */
+    int32_t     dt;                       /**< Time delta of the last sample. */
+    int32_t     value;                    /**< Value of the last sample. */
+    bool        sealed;                   /**< Full, waiting for the stage buffer. */
+} open_block_t;
+
+
+static pstorage_handle_t m_storage;                         /**< Base handle of the ring, one block per slot. */
+static uint16_t          m_slot_count;
+static uint16_t          m_slots_per_page;
+static bool              m_initialized;
+
+static uint16_t          m_next_slot;                       /**< Slot the next block is written to. */
+static uint32_t          m_next_seq;
+static uint16_t          m_stage_slot = SLOT_NONE;          /**< Slot being written from m_stage, SLOT_NONE if idle. */
+static uint32_t          m_stage[HISTORY_BLOCK_SIZE / sizeof(uint32_t)]; /**< Source buffer of a block store. */
+
+static open_block_t      m_open[HISTORY_SERIES_COUNT];
+
+static history_stats_t   m_stats;
+
+
+static block_hdr_t const * slot_address(uint16_t slot)
+{
+    return (block_hdr_t const *)(m_storage.block_id + (uint32_t)slot * HISTORY_BLOCK_SIZE);
+}
+
+
+static uint16_t block_crc(block_hdr_t const * p_hdr, uint8_t const * p_data)
+{
+    uint16_t crc = crc16_compute((uint8_t const *)p_hdr, offsetof(block_hdr_t, crc), NULL);
+
+    return crc16_compute(p_data, p_hdr->length, &crc);
+}
+
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+static uint8_t varint_len(uint64_t value)
+{
+    uint8_t len = 1;
+
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        len++;
+    }
+    return len;
+}
+
+
+static uint8_t * varint_put(uint8_t * p_buf, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *p_buf++ = (uint8_t)value | 0x80;
+        value  >>= 7;
+    }
+    *p_buf++ = (uint8_t)value;
+    return p_buf;
+}
+
+
+/**@brief Function for reading a varint of a block.
+ *
+ * @return false if the varint runs past the end of the block.
+ */
+static bool varint_get(history_reader_t * p_reader, uint64_t * p_value)
+{
+    uint64_t value = 0;
+    uint8_t  shift = 0;
+    uint8_t  byte;
+
+    do
+    {
+        if ((p_reader->p_data == p_reader->p_end) || (shift > 63))
+        {
+            return false;
+        }
+        byte   = *p_reader->p_data++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *p_value = value;
+    return true;
+}
+
+
+/**@brief Function for getting the token of a run of unchanged regular samples. */
+static uint64_t run_token(uint16_t run)
+{
+    return (run == 1) ? TOKEN_REGULAR : (((uint64_t)run << 2) | TOKEN_RUN);
+}
+
+
+static uint8_t run_len(uint16_t run)
+{
+    return (run == 0) ? 0 : varint_len(run_token(run));
+}
+
+
+static void run_flush(open_block_t * p_block)
+{
+    uint8_t * p_end;
+
+    if (p_block->run == 0)
+    {
+        return;
+    }
+
+    p_end = varint_put(&p_block->data[p_block->hdr.length], run_token(p_block->run));
+    p_block->hdr.length = p_end - p_block->data;
+    p_block->run        = 0;
+}
+
+
+/**@brief Function for writing the block in m_stage to the next slot, erasing its page first if
+ *        the ring has wrapped around to it.
+ */
+static void stage_write(void)
+{
+    uint32_t          err_code;
+    pstorage_handle_t handle;
+    uint32_t const  * p_word;
+    uint32_t          i;
+
+    err_code = pstorage_block_identifier_get(&m_storage, m_next_slot, &handle);
+
+    if ((err_code == NRF_SUCCESS) && ((m_next_slot % m_slots_per_page) == 0))
+    {
+        p_word = (uint32_t const *)slot_address(m_next_slot);
+        for (i = 0; i < (uint32_t)m_slots_per_page * HISTORY_BLOCK_SIZE / sizeof(uint32_t); i++)
+        {
+            if (p_word[i] != HISTORY_ERASED_WORD)
+            {
+                err_code = pstorage_clear(&handle, m_slots_per_page * HISTORY_BLOCK_SIZE);
+                m_stats.page_erases++;
+                break;
+            }
+        }
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = pstorage_store(&handle, (uint8_t *)m_stage, HISTORY_BLOCK_SIZE, 0);
+    }
+
+    if (err_code != NRF_SUCCESS)
+    {
+        m_stats.failed++;
+        return;
+    }
+
+    m_stage_slot = m_next_slot;
+    m_next_slot  = (m_next_slot + 1) % m_slot_count;
+    m_next_seq++;
+}
+
+
+/**@brief Function for closing a full block: it goes to the stage buffer if that is free, and the
+ *        series starts a new block. Otherwise it waits for the stage buffer.
+ */
+static void block_seal(open_block_t * p_block)
+{
+    block_hdr_t * p_hdr = (block_hdr_t *)m_stage;
+
+    run_flush(p_block);
+    p_block->sealed = true;
+
+    if (m_stage_slot != SLOT_NONE)
+    {
+        return;
+    }
+
+    memset(m_stage, 0xFF, sizeof(m_stage));
+    *p_hdr       = p_block->hdr;
+    p_hdr->seq   = m_next_seq;
+    p_hdr->magic = HISTORY_BLOCK_MAGIC;
+    memcpy(p_hdr + 1, p_block->data, p_block->hdr.length);
+    p_hdr->crc   = block_crc(p_hdr, (uint8_t const *)(p_hdr + 1));
+
+    p_block->hdr.count = 0;
+    p_block->sealed    = false;
+
+    stage_write();
+}
+
+
+static void pstorage_cb_handler(pstorage_handle_t * p_handle,
+                                uint8_t             op_code,
+                                uint32_t            result,
+                                uint8_t           * p_data,
+                                uint32_t            data_len)
+{
+    uint32_t i;
+
+    if (result != NRF_SUCCESS)
+    {
+        m_stats.failed++;
+    }
+
+    if ((op_code != PSTORAGE_STORE_OP_CODE) || (p_data != (uint8_t *)m_stage))
+    {
+        return;
+    }
+
+    if (result == NRF_SUCCESS)
+    {
+        m_stats.blocks++;
+        m_stats.encoded += ((block_hdr_t *)m_stage)->length;
+    }
+    m_stage_slot = SLOT_NONE;
+
+    for (i = 0; i < HISTORY_SERIES_COUNT; i++)
+    {
+        if (m_open[i].sealed)
+        {
+            block_seal(&m_open[i]);
+            break;
+        }
+    }
+}
+
+
+uint32_t history_init(void)
+{
+    uint32_t                err_code;
+    pstorage_module_param_t param;
+    block_hdr_t const     * p_newest = NULL;
+    uint16_t                slot;
+
+    m_slots_per_page = PSTORAGE_FLASH_PAGE_SIZE / HISTORY_BLOCK_SIZE;
+    m_slot_count     = HISTORY_PAGE_COUNT * m_slots_per_page;
+
+    param.block_size  = HISTORY_BLOCK_SIZE;
+    param.block_count = m_slot_count;
+    param.cb          = pstorage_cb_handler;
+
+    err_code = pstorage_register(&param, &m_storage);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // Blocks are written in slot order, so the newest block is followed by the oldest.
+    m_next_slot = 0;
+    m_next_seq  = 0;
+    for (slot = 0; slot < m_slot_count; slot++)
+    {
+        block_hdr_t const * p_hdr = slot_address(slot);
+
+        if ((p_hdr->magic == HISTORY_BLOCK_MAGIC) &&
+            ((p_newest == NULL) || ((int32_t)(p_hdr->seq - p_newest->seq) > 0)))
+        {
+            p_newest    = p_hdr;
+            m_next_slot = (slot + 1) % m_slot_count;
+            m_next_seq  = p_hdr->seq + 1;
+        }
+    }
+
+    memset(m_open, 0, sizeof(m_open));
+    m_stage_slot  = SLOT_NONE;
+    m_initialized = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t history_append(history_series_t series, uint32_t time, int32_t value)
+{
+    open_block_t * p_block;
+    block_hdr_t  * p_hdr;
+    int32_t        dt;
+    int32_t        dod;
+    int32_t        dv;
+    uint64_t       token;
+    uint8_t        needed;
+
+    if (!m_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (series >= HISTORY_SERIES_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_block = &m_open[series];
+    p_hdr   = &p_block->hdr;
+
+    if (p_hdr->count > 0)
+    {
+        dt  = (int32_t)(time - p_hdr->last_time);
+        dod = dt - p_block->dt;
+        dv  = (int32_t)((uint32_t)value - (uint32_t)p_block->value);
+
+        if ((dod == 0) && (dv == 0))
+        {
+            token  = 0;
+            needed = run_len(p_block->run + 1);
+        }
+        else
+        {
+            token  = ((uint64_t)zigzag(dv) << 2) | ((dod == 0) ? TOKEN_REGULAR : TOKEN_IRREGULAR);
+            needed = run_len(p_block->run) + varint_len(token) +
+                     ((dod == 0) ? 0 : varint_len(zigzag(dod)));
+        }
+
+        if ((p_hdr->length + needed > HISTORY_DATA_MAX) || (p_hdr->count == HISTORY_COUNT_MAX))
+        {
+            block_seal(p_block);
+        }
+    }
+
+    if (p_block->sealed)
+    {
+        m_stats.dropped++;
+        return NRF_ERROR_BUSY;
+    }
+
+    if (p_hdr->count == 0)
+    {
+        p_hdr->series      = series;
+        p_hdr->count       = 1;
+        p_hdr->length      = 0;
+        p_hdr->first_time  = time;
+        p_hdr->last_time   = time;
+        p_hdr->first_value = value;
+        p_hdr->min         = value;
+        p_hdr->max         = value;
+        p_block->run       = 0;
+        p_block->dt        = 0;
+        p_block->value     = value;
+        m_stats.samples++;
+        return NRF_SUCCESS;
+    }
+
+    if ((dod == 0) && (dv == 0))
+    {
+        p_block->run++;
+    }
+    else
+    {
+        uint8_t * p_end;
+
+        run_flush(p_block);
+        p_end = varint_put(&p_block->data[p_hdr->length], token);
+        if (dod != 0)
+        {
+            p_end = varint_put(p_end, zigzag(dod));
+        }
+        p_hdr->length = p_end - p_block->data;
+    }
+
+    p_hdr->count++;
+    p_hdr->last_time = time;
+    p_hdr->min       = MIN(p_hdr->min, value);
+    p_hdr->max       = MAX(p_hdr->max, value);
+    p_block->dt      = dt;
+    p_block->value   = value;
+    m_stats.samples++;
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for getting a block by reader index: the flash slots oldest first, then the
+ *        block being written to flash, then the RAM block of the series.
+ *
+ * @param[out] pp_data  Encoded samples.
+ *
+ * @return Header of the block, or NULL if the index holds no valid block of the series.
+ */
+static block_hdr_t const * block_get(uint16_t index, uint8_t series, uint8_t const ** pp_data)
+{
+    block_hdr_t const * p_hdr;
+
+    if (index < m_slot_count)
+    {
+        uint16_t slot = (m_next_slot + index) % m_slot_count;
+
+        if (slot == m_stage_slot)
+        {
+            return NULL;
+        }
+        p_hdr = slot_address(slot);
+        if ((p_hdr->magic != HISTORY_BLOCK_MAGIC) ||
+            (p_hdr->series != series) ||
+            (p_hdr->length > HISTORY_DATA_MAX) ||
+            (p_hdr->count == 0) ||
+            (block_crc(p_hdr, (uint8_t const *)(p_hdr + 1)) != p_hdr->crc))
+        {
+            return NULL;
+        }
+        *pp_data = (uint8_t const *)(p_hdr + 1);
+        return p_hdr;
+    }
+
+    if (index == m_slot_count)
+    {
+        p_hdr = (block_hdr_t const *)m_stage;
+        if ((m_stage_slot == SLOT_NONE) || (p_hdr->series != series))
+        {
+            return NULL;
+        }
+        *pp_data = (uint8_t const *)(p_hdr + 1);
+        return p_hdr;
+    }
+
+    p_hdr = &m_open[series].hdr;
+    if (p_hdr->count == 0)
+    {
+        return NULL;
+    }
+    *pp_data = m_open[series].data;
+    return p_hdr;
+}
+
+
+static void block_open(history_reader_t * p_reader, block_hdr_t const * p_hdr, uint8_t const * p_data)
+{
+    p_reader->p_data    = p_data;
+    p_reader->p_end     = p_data + p_hdr->length;
+    p_reader->remaining = p_hdr->count;
+    p_reader->run       = 0;
+    p_reader->first     = true;
+    p_reader->time      = p_hdr->first_time;
+    p_reader->dt        = 0;
+    p_reader->value     = p_hdr->first_value;
+}
+
+
+/**@brief Function for decoding the next sample of the open block.
+ *
+ * @return false at the end of the block, or if the block is damaged.
+ */
+static bool block_sample_next(history_reader_t * p_reader)
+{
+    uint64_t token;
+    uint64_t dod;
+
+    if (p_reader->remaining == 0)
+    {
+        return false;
+    }
+    p_reader->remaining--;
+
+    if (p_reader->first)
+    {
+        p_reader->first = false;
+        return true;
+    }
+
+    // The trailing run of the RAM block is not encoded yet; it is what follows the last token.
+    if ((p_reader->run == 0) && (p_reader->p_data != p_reader->p_end))
+    {
+        if (!varint_get(p_reader, &token))
+        {
+            return false;
+        }
+
+        if ((token & 3) == TOKEN_RUN)
+        {
+            p_reader->run = (uint16_t)(token >> 2);
+        }
+        else
+        {
+            if ((token & 3) == TOKEN_IRREGULAR)
+            {
+                if (!varint_get(p_reader, &dod))
+                {
+                    return false;
+                }
+                p_reader->dt += unzigzag((uint32_t)dod);
+            }
+            p_reader->time  += p_reader->dt;
+            p_reader->value  = (int32_t)((uint32_t)p_reader->value + (uint32_t)unzigzag((uint32_t)(token >> 2)));
+            return true;
+        }
+    }
+
+    if (p_reader->run > 0)
+    {
+        p_reader->run--;
+    }
+    p_reader->time += p_reader->dt;
+    return true;
+}
+
+
+static bool block_overlaps(block_hdr_t const * p_hdr, uint32_t from, uint32_t to)
+{
+    return (p_hdr->first_time <= to) && (p_hdr->last_time >= from);
+}
+
+
+void history_reader_init(history_reader_t * p_reader, history_series_t series, uint32_t from, uint32_t to)
+{
+    memset(p_reader, 0, sizeof(*p_reader));
+    p_reader->series = series;
+    p_reader->from   = from;
+    p_reader->to     = to;
+}
+
+
+bool history_reader_next(history_reader_t * p_reader, uint32_t * p_time, int32_t * p_value)
+{
+    block_hdr_t const * p_hdr;
+    uint8_t const     * p_data;
+
+    if (!m_initialized || (p_reader->series >= HISTORY_SERIES_COUNT))
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        if (p_reader->p_data != NULL)
+        {
+            if (block_sample_next(p_reader))
+            {
+                if ((p_reader->time >= p_reader->from) && (p_reader->time <= p_reader->to))
+                {
+                    *p_time  = p_reader->time;
+                    *p_value = p_reader->value;
+                    return true;
+                }
+                continue;
+            }
+            p_reader->p_data = NULL;
+        }
+
+        if (p_reader->index > m_slot_count + 1)
+        {
+            return false;
+        }
+
+        p_hdr = block_get(p_reader->index++, p_reader->series, &p_data);
+        if ((p_hdr != NULL) && block_overlaps(p_hdr, p_reader->from, p_reader->to))
+        {
+            block_open(p_reader, p_hdr, p_data);
+        }
+    }
+}
+
+
+static void summary_add(history_summary_t * p_summary, uint32_t count, int32_t min, int32_t max,
+                        uint32_t first_time, uint32_t last_time)
+{
+    if (p_summary->count == 0)
+    {
+        p_summary->min        = min;
+        p_summary->max        = max;
+        p_summary->first_time = first_time;
+    }
+    p_summary->count    += count;
+    p_summary->min       = MIN(p_summary->min, min);
+    p_summary->max       = MAX(p_summary->max, max);
+    p_summary->last_time = last_time;
+}
+
+
+void history_summary_get(history_series_t series, uint32_t from, uint32_t to, history_summary_t * p_summary)
+{
+    history_reader_t    reader;
+    block_hdr_t const * p_hdr;
+    uint8_t const     * p_data;
+    uint16_t            index;
+
+    memset(p_summary, 0, sizeof(*p_summary));
+
+    if (!m_initialized || (series >= HISTORY_SERIES_COUNT))
+    {
+        return;
+    }
+
+    for (index = 0; index <= m_slot_count + 1; index++)
+    {
+        p_hdr = block_get(index, series, &p_data);
+        if ((p_hdr == NULL) || !block_overlaps(p_hdr, from, to))
+        {
+            continue;
+        }
+
+        if ((p_hdr->first_time >= from) && (p_hdr->last_time <= to))
+        {
+            summary_add(p_summary, p_hdr->count, p_hdr->min, p_hdr->max, p_hdr->first_time, p_hdr->last_time);
+            continue;
+        }
+
+        block_open(&reader, p_hdr, p_data);
+        while (block_sample_next(&reader))
+        {
+            if ((reader.time >= from) && (reader.time <= to))
+            {
+                summary_add(p_summary, 1, reader.value, reader.value, reader.time, reader.time);
+            }
+        }
+    }
+}
+
+
+void history_stats_get(history_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
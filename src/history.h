@@ -0,0 +1,139 @@
+#ifndef HISTORY_H__
+#define HISTORY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HISTORY_PAGE_COUNT    4       /**< Number of flash pages used as the block ring. */
+#define HISTORY_BLOCK_SIZE    256     /**< Size of one block. Must divide the flash page size. */
+#define HISTORY_HEADER_LEN    32      /**< Size of the block header; the rest of the block holds samples. */
+
+/* Block layout, little endian:
+ *
+ *   offset  size  field
+ *   0       4     sequence number, incremented per block across all series
+ *   4       4     time of the first sample
+ *   8       4     time of the last sample
+ *   12      4     value of the first sample
+ *   16      4     smallest value
+ *   20      4     largest value
+ *   24      2     number of samples
+ *   26      1     series
+ *   27      1     number of encoded bytes n
+ *   28      2     CRC-16 of bytes 0-27 and the encoded bytes
+ *   30      2     0x5AA5
+ *   32      n     samples after the first, as varints
+ *
+ * Each sample after the first is coded from its time delta dt and value delta dv to the previous
+ * sample. A sample whose dt equals the previous dt is regular. The low two bits of a token say:
+ *
+ *   0  regular sample; token >> 2 is zigzag(dv)
+ *   1  irregular sample; token >> 2 is zigzag(dv), a varint with zigzag(dt - previous dt) follows
+ *   2  token >> 2 regular samples with dv = 0 (a run of at least two)
+ *
+ * A series sampled every minute and changing by small steps takes about a byte per sample, and a
+ * run of unchanged samples takes one or two bytes in all.
+ */
+
+/**@brief Series. Series are stored in flash, so existing values must not be renumbered. */
+typedef enum
+{
+    HISTORY_SERIES_TEMPERATURE,  /**< Die temperature in 0.25 degree Celsius steps, once a minute. */
+    HISTORY_SERIES_COUNT
+} history_series_t;
+
+/**@brief History store statistics. */
+typedef struct
+{
+    uint32_t samples;      /**< Samples appended. */
+    uint32_t dropped;      /**< Samples dropped because a full block was waiting for flash. */
+    uint32_t blocks;       /**< Blocks written to flash. */
+    uint32_t failed;       /**< Flash operations that failed. */
+    uint32_t page_erases;  /**< Pages erased; each erase drops the oldest blocks. */
+    uint32_t encoded;      /**< Bytes of sample data in the blocks written, headers excluded. */
+} history_stats_t;
+
+/**@brief Summary of the samples in a time range. */
+typedef struct
+{
+    uint32_t count;        /**< Number of samples. The other fields are only valid if it is not 0. */
+    int32_t  min;
+    int32_t  max;
+    uint32_t first_time;
+    uint32_t last_time;
+} history_summary_t;
+
+/**@brief Streaming reader. Fields are private. */
+typedef struct
+{
+    uint8_t         series;
+    uint32_t        from;
+    uint32_t        to;
+    uint16_t        index;      /**< Next block to visit: flash slots oldest first, then RAM. */
+    uint8_t const * p_data;     /**< Next token of the block being read, NULL if none is. */
+    uint8_t const * p_end;
+    uint16_t        remaining;  /**< Samples left in the block being read. */
+    uint16_t        run;        /**< Samples left in the current run. */
+    bool            first;      /**< The next sample is the first of the block, kept in its header. */
+    uint32_t        time;
+    int32_t         dt;
+    int32_t         value;
+} history_reader_t;
+
+
+/**@brief Function for initializing the history store.
+ *
+ * @details Registers the block ring with pstorage and finds the newest block. Samples are
+ *          collected in a RAM block per series; a full block is written to flash in one store,
+ *          and the oldest page is erased when the ring wraps. Samples in RAM are lost on reset.
+ *          pstorage_init() must have been called.
+ *
+ * @retval NRF_SUCCESS If the store was initialized. Otherwise an error code from pstorage.
+ */
+uint32_t history_init(void);
+
+/**@brief Function for appending a sample to a series.
+ *
+ * @param[in] series  Series.
+ * @param[in] time    Time of the sample, in seconds.
+ * @param[in] value   Value of the sample.
+ *
+ * @retval NRF_SUCCESS             If the sample was added.
+ * @retval NRF_ERROR_INVALID_STATE If the store is not initialized.
+ * @retval NRF_ERROR_INVALID_PARAM If the series does not exist.
+ * @retval NRF_ERROR_BUSY          If the block of the series is full and still waiting for flash.
+ *                                 The sample is dropped.
+ */
+uint32_t history_append(history_series_t series, uint32_t time, int32_t value);
+
+/**@brief Function for starting to read the samples of a series in a time range, oldest first.
+ *
+ * @details Blocks are skipped on their header alone if their time range does not overlap, so a
+ *          query only decodes the blocks it needs. Blocks in flash are read in place; a block
+ *          whose CRC does not match is skipped. Reading must not span a call of history_append()
+ *          or a pstorage event, which can move or erase the block being read.
+ *
+ * @param[out] p_reader  Reader.
+ * @param[in]  series    Series.
+ * @param[in]  from      Start of the range, inclusive.
+ * @param[in]  to        End of the range, inclusive.
+ */
+void history_reader_init(history_reader_t * p_reader, history_series_t series, uint32_t from, uint32_t to);
+
+/**@brief Function for reading the next sample.
+ *
+ * @return false when there are no more samples in the range.
+ */
+bool history_reader_next(history_reader_t * p_reader, uint32_t * p_time, int32_t * p_value);
+
+/**@brief Function for summarizing the samples of a series in a time range.
+ *
+ * @details Blocks entirely inside the range are summarized from their header; only the blocks at
+ *          the ends of the range are decoded.
+ */
+void history_summary_get(history_series_t series, uint32_t from, uint32_t to, history_summary_t * p_summary);
+
+/**@brief Function for getting the history store statistics. */
+void history_stats_get(history_stats_t * p_stats);
+
+#endif /* HISTORY_H__ */
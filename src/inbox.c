@@ -0,0 +1,504 @@
+#include <stddef.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "pstorage.h"
+#include "inbox.h"
+
+#define INBOX_PAGE_MAGIC      0x58424E49  /**< Marks an initialized ring page ("INBX"). */
+#define INBOX_RECORD_MAGIC    0x4D53      /**< Marks the start of a message record. */
+#define INBOX_COMMIT_MARK     0x00000000  /**< Written over the erased commit word once the record body is in flash. */
+#define INBOX_ERASED_WORD     0xFFFFFFFF  /**< Value of an erased flash word. */
+
+#define WORD_ALIGN(X)         (((X) + 3) & ~3)
+
+/**@brief Header at the start of each ring page. */
+typedef struct
+{
+    uint32_t magic;    /**< INBOX_PAGE_MAGIC. */
+    uint32_t seq;      /**< Page sequence number, incremented each time a page is recycled. */
+} inbox_page_hdr_t;
+
+/**@brief Header of a message record. The body follows, padded to a word boundary. */
+typedef struct
+{
+    uint16_t magic;         /**< INBOX_RECORD_MAGIC. */
+    uint16_t length;        /**< Length of the body in bytes. */
+    uint32_t id;            /**< Message identifier. */
+    uint32_t timestamp;     /**< Reception time. */
+    uint8_t  flags;         /**< Message flags. */
+    uint8_t  reserved[3];
+    uint32_t commit;        /**< INBOX_COMMIT_MARK once the record is complete, erased otherwise. */
+} inbox_record_hdr_t;
+
+#define INBOX_RECORD_SIZE(LEN) (sizeof(inbox_record_hdr_t) + WORD_ALIGN(LEN))
+
+
+static pstorage_handle_t m_storage;                  /**< Base handle of the ring, one block per page. */
+static uint16_t          m_page_size;                /**< Flash page size. */
+static bool              m_initialized;              /**< Set once the index has been rebuilt. */
+static inbox_append_handler_t m_append_handler;      /**< Called when an append is done, or NULL. */
+static bool              m_busy;                     /**< An append is being written. */
+static bool              m_failed;                   /**< A flash operation of the current append failed. */
+static bool              m_page_failed;              /**< The erase or header store of the write page failed. */
+
+static bool              m_write_page_valid;         /**< Whether a ring page has been opened for writing. */
+static uint8_t           m_write_page;               /**< Ring page currently written to. */
+static uint16_t          m_write_offset;             /**< Next free offset in the write page. */
+static uint32_t          m_write_seq;                /**< Sequence number of the write page. */
+
+static inbox_page_hdr_t  m_page_hdr;                 /**< Source buffer of a page header store. */
+static uint32_t          m_stage[INBOX_RECORD_SIZE(INBOX_MSG_MAX_LEN) / sizeof(uint32_t)]; /**< Source buffer of a record store. */
+static uint32_t          m_commit_mark = INBOX_COMMIT_MARK; /**< Source buffer of a commit store. */
+static uint32_t          m_read_mark;                /**< Source buffer of a flags word store. */
+static bool              m_read_busy;                /**< A flags word is being written. */
+static pstorage_handle_t m_pending_handle;           /**< Page handle of the record being written. */
+static uint16_t          m_pending_offset;           /**< Offset of the record being written. */
+static inbox_entry_t     m_pending;                  /**< Index entry of the record being written. */
+
+static inbox_entry_t     m_index[INBOX_MAX_ENTRIES]; /**< Ring of the latest messages, oldest first. */
+static uint32_t          m_index_head;               /**< Next free slot in m_index. */
+static uint32_t          m_index_count;              /**< Number of valid entries in m_index. */
+
+static inbox_stats_t     m_stats;                    /**< Flash statistics. */
+
+
+static uint8_t const * page_address(uint8_t page)
+{
+    return (uint8_t const *)(m_storage.block_id + (uint32_t)page * m_page_size);
+}
+
+
+static void index_push(inbox_entry_t const * p_entry)
+{
+    m_index[m_index_head] = *p_entry;
+    m_index_head          = (m_index_head + 1) % INBOX_MAX_ENTRIES;
+
+    if (m_index_count < INBOX_MAX_ENTRIES)
+    {
+        m_index_count++;
+    }
+}
+
+
+/**@brief Function for dropping the index entries of a page about to be erased.
+ *
+ * @details Pages are recycled oldest first, so the entries to drop are the oldest ones.
+ */
+static void index_drop_page(uint8_t page)
+{
+    while (m_index_count > 0)
+    {
+        uint32_t oldest = (m_index_head + INBOX_MAX_ENTRIES - m_index_count) % INBOX_MAX_ENTRIES;
+
+        if (m_index[oldest].page != page)
+        {
+            break;
+        }
+        m_index_count--;
+    }
+}
+
+
+/**@brief Function for scanning a ring page and indexing its committed records.
+ *
+ * @return Offset of the first free word of the page, or the page size if the page cannot take
+ *         more records.
+ */
+static uint16_t page_scan(uint8_t page)
+{
+    uint8_t const * p_page = page_address(page);
+    uint32_t        offset = sizeof(inbox_page_hdr_t);
+
+    while (offset + sizeof(inbox_record_hdr_t) <= m_page_size)
+    {
+        inbox_record_hdr_t const * p_hdr = (inbox_record_hdr_t const *)(p_page + offset);
+
+        if (*(uint32_t const *)p_hdr == INBOX_ERASED_WORD)
+        {
+            return offset;
+        }
+
+        if ((p_hdr->magic != INBOX_RECORD_MAGIC) ||
+            (p_hdr->length > INBOX_MSG_MAX_LEN) ||
+            (offset + INBOX_RECORD_SIZE(p_hdr->length) > m_page_size))
+        {
+            // Header is damaged; the rest of the page cannot be trusted.
+            return m_page_size;
+        }
+
+        if (p_hdr->commit == INBOX_COMMIT_MARK)
+        {
+            inbox_entry_t entry;
+
+            entry.id        = p_hdr->id;
+            entry.timestamp = p_hdr->timestamp;
+            entry.offset    = offset + sizeof(inbox_record_hdr_t);
+            entry.length    = p_hdr->length;
+            entry.page      = page;
+            entry.flags     = p_hdr->flags;
+
+            index_push(&entry);
+            m_stats.recovered++;
+        }
+        else
+        {
+            // Power was lost before the commit mark was written.
+            m_stats.torn++;
+        }
+
+        offset += INBOX_RECORD_SIZE(p_hdr->length);
+    }
+
+    return offset;
+}
+
+
+/**@brief Function for rebuilding the index from the ring pages, oldest page first. */
+static void index_rebuild(void)
+{
+    bool     scanned[INBOX_PAGE_COUNT] = {false};
+    uint32_t i;
+
+    for (;;)
+    {
+        inbox_page_hdr_t const * p_oldest = NULL;
+        uint8_t                  oldest   = 0;
+
+        for (i = 0; i < INBOX_PAGE_COUNT; i++)
+        {
+            inbox_page_hdr_t const * p_hdr = (inbox_page_hdr_t const *)page_address(i);
+
+            if (!scanned[i] &&
+                (p_hdr->magic == INBOX_PAGE_MAGIC) &&
+                ((p_oldest == NULL) || ((int32_t)(p_hdr->seq - p_oldest->seq) < 0)))
+            {
+                p_oldest = p_hdr;
+                oldest   = i;
+            }
+        }
+
+        if (p_oldest == NULL)
+        {
+            break;
+        }
+
+        scanned[oldest]    = true;
+        m_write_page_valid = true;
+        m_write_page       = oldest;
+        m_write_seq        = p_oldest->seq;
+        m_write_offset     = page_scan(oldest);
+    }
+}
+
+
+/**@brief Function for recycling a ring page and making it the write page. */
+static uint32_t page_open(uint8_t page)
+{
+    uint32_t          err_code;
+    pstorage_handle_t handle;
+
+    err_code = pstorage_block_identifier_get(&m_storage, page, &handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    index_drop_page(page);
+
+    err_code = pstorage_clear(&handle, m_page_size);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_page_hdr.magic = INBOX_PAGE_MAGIC;
+    m_page_hdr.seq   = m_write_seq + 1;
+
+    err_code = pstorage_store(&handle, (uint8_t *)&m_page_hdr, sizeof(m_page_hdr), 0);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_write_page_valid = true;
+    m_write_page       = page;
+    m_write_seq        = m_page_hdr.seq;
+    m_write_offset     = sizeof(inbox_page_hdr_t);
+    m_page_failed      = false;
+    m_stats.page_erases++;
+
+    return NRF_SUCCESS;
+}
+
+
+static void append_done(bool success)
+{
+    if (success)
+    {
+        index_push(&m_pending);
+        m_stats.appended++;
+        m_stats.payload_bytes += m_pending.length;
+    }
+    else
+    {
+        m_stats.dropped++;
+    }
+
+    m_failed = false;
+    m_busy   = false;
+
+    if (m_append_handler != NULL)
+    {
+        m_append_handler();
+    }
+}
+
+
+static void pstorage_cb_handler(pstorage_handle_t * p_handle,
+                                uint8_t             op_code,
+                                uint32_t            result,
+                                uint8_t           * p_data,
+                                uint32_t            data_len)
+{
+    uint32_t err_code;
+
+    if (p_data == (uint8_t *)&m_read_mark)
+    {
+        // A failed mark leaves the message unread in flash only; it is unread again after a reset.
+        if (result == NRF_SUCCESS)
+        {
+            m_stats.flash_bytes += data_len;
+        }
+        m_read_busy = false;
+        return;
+    }
+
+    if (result != NRF_SUCCESS)
+    {
+        m_failed = true;
+
+        if ((op_code == PSTORAGE_CLEAR_OP_CODE) || (p_data == (uint8_t *)&m_page_hdr))
+        {
+            // Records after a missing page header are not found at boot, and pstorage stops at a
+            // failed command, so the record store is never done: fail the append now, and recycle
+            // the page again before the next one.
+            m_page_failed = true;
+            if (m_busy)
+            {
+                append_done(false);
+            }
+            return;
+        }
+    }
+    else if (op_code == PSTORAGE_STORE_OP_CODE)
+    {
+        m_stats.flash_bytes += data_len;
+    }
+
+    if ((op_code != PSTORAGE_STORE_OP_CODE) || !m_busy)
+    {
+        return;
+    }
+
+    if (p_data == (uint8_t *)m_stage)
+    {
+        if (m_failed)
+        {
+            // Leave the record uncommitted; it is skipped when the page is scanned.
+            append_done(false);
+            return;
+        }
+
+        // The body is in flash; commit the record.
+        err_code = pstorage_store(&m_pending_handle,
+                                  (uint8_t *)&m_commit_mark,
+                                  sizeof(m_commit_mark),
+                                  m_pending_offset + offsetof(inbox_record_hdr_t, commit));
+        if (err_code != NRF_SUCCESS)
+        {
+            append_done(false);
+        }
+    }
+    else if (p_data == (uint8_t *)&m_commit_mark)
+    {
+        append_done(!m_failed);
+    }
+}
+
+
+uint32_t inbox_init(inbox_append_handler_t append_handler)
+{
+    uint32_t                err_code;
+    pstorage_module_param_t param;
+
+    m_append_handler = append_handler;
+    m_page_size      = PSTORAGE_FLASH_PAGE_SIZE;
+
+    param.block_size  = m_page_size;
+    param.block_count = INBOX_PAGE_COUNT;
+    param.cb          = pstorage_cb_handler;
+
+    err_code = pstorage_register(&param, &m_storage);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    index_rebuild();
+    m_initialized = true;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t inbox_append(uint32_t id, uint32_t timestamp, uint8_t flags, uint8_t const * p_data, uint16_t length)
+{
+    uint32_t             err_code;
+    uint16_t             record_size = INBOX_RECORD_SIZE(length);
+    inbox_record_hdr_t * p_hdr       = (inbox_record_hdr_t *)m_stage;
+
+    if (!m_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (length > INBOX_MSG_MAX_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    if (m_busy)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    if (m_page_failed)
+    {
+        err_code = page_open(m_write_page);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+    }
+    else if (!m_write_page_valid || (m_write_offset + record_size > m_page_size))
+    {
+        err_code = page_open(m_write_page_valid ? (m_write_page + 1) % INBOX_PAGE_COUNT : 0);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+    }
+
+    // Records are written with the commit word still erased; it is programmed in a second store.
+    memset(m_stage, 0xFF, record_size);
+    p_hdr->magic     = INBOX_RECORD_MAGIC;
+    p_hdr->length    = length;
+    p_hdr->id        = id;
+    p_hdr->timestamp = timestamp;
+    p_hdr->flags     = flags;
+    memcpy((uint8_t *)m_stage + sizeof(inbox_record_hdr_t), p_data, length);
+
+    err_code = pstorage_block_identifier_get(&m_storage, m_write_page, &m_pending_handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_pending_offset   = m_write_offset;
+    m_pending.id        = id;
+    m_pending.timestamp = timestamp;
+    m_pending.offset    = m_write_offset + sizeof(inbox_record_hdr_t);
+    m_pending.length    = length;
+    m_pending.page      = m_write_page;
+    m_pending.flags     = flags;
+
+    m_busy = true;
+
+    err_code = pstorage_store(&m_pending_handle, (uint8_t *)m_stage, record_size, m_write_offset);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_busy = false;
+        return err_code;
+    }
+
+    m_write_offset += record_size;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t inbox_mark_read(uint32_t k)
+{
+    uint32_t          err_code;
+    pstorage_handle_t handle;
+    inbox_entry_t   * p_entry;
+
+    if (k >= m_index_count)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    p_entry = &m_index[(m_index_head + INBOX_MAX_ENTRIES - 1 - k) % INBOX_MAX_ENTRIES];
+    if ((p_entry->flags & INBOX_FLAG_UNREAD) == 0)
+    {
+        return NRF_SUCCESS;
+    }
+
+    if (m_read_busy)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    err_code = pstorage_block_identifier_get(&m_storage, p_entry->page, &handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // Only clears bits of the flags word, which was programmed once with the record, so no erase is
+    // needed; the nRF52 allows two writes of a word between erases.
+    m_read_mark = 0xFFFFFF00 | (p_entry->flags & ~INBOX_FLAG_UNREAD);
+
+    err_code = pstorage_store(&handle,
+                              (uint8_t *)&m_read_mark,
+                              sizeof(m_read_mark),
+                              p_entry->offset - sizeof(inbox_record_hdr_t) + offsetof(inbox_record_hdr_t, flags));
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_read_busy     = true;
+    p_entry->flags &= ~INBOX_FLAG_UNREAD;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t inbox_count(void)
+{
+    return m_index_count;
+}
+
+
+inbox_entry_t const * inbox_latest(uint32_t k)
+{
+    if (k >= m_index_count)
+    {
+        return NULL;
+    }
+
+    return &m_index[(m_index_head + INBOX_MAX_ENTRIES - 1 - k) % INBOX_MAX_ENTRIES];
+}
+
+
+uint8_t const * inbox_data_get(inbox_entry_t const * p_entry)
+{
+    return page_address(p_entry->page) + p_entry->offset;
+}
+
+
+void inbox_stats_get(inbox_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
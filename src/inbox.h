@@ -0,0 +1,101 @@
+#ifndef INBOX_H__
+#define INBOX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INBOX_PAGE_COUNT      2      /**< Number of flash pages used as the message ring. Must be at least 2. */
+#define INBOX_MAX_ENTRIES     32     /**< Number of messages kept in the RAM index. */
+#define INBOX_MSG_MAX_LEN     236    /**< Maximum length of a message body in bytes. */
+
+#define INBOX_FLAG_UNREAD     0x01   /**< Message has not been opened yet. */
+
+
+/**@brief RAM index entry of a message stored in flash. */
+typedef struct
+{
+    uint32_t id;          /**< Message identifier provided by the sender. */
+    uint32_t timestamp;   /**< Time the message was received (local time). */
+    uint16_t offset;      /**< Offset of the message body from the start of its flash page. */
+    uint16_t length;      /**< Length of the message body in bytes. */
+    uint8_t  page;        /**< Ring page holding the message. */
+    uint8_t  flags;       /**< Message flags, see INBOX_FLAG_*. */
+} inbox_entry_t;
+
+/**@brief Inbox flash statistics. */
+typedef struct
+{
+    uint32_t appended;       /**< Messages committed to flash. */
+    uint32_t dropped;        /**< Messages lost because a flash operation failed. */
+    uint32_t payload_bytes;  /**< Message body bytes committed. */
+    uint32_t flash_bytes;    /**< Bytes written to flash, including headers, padding and commit marks. */
+    uint32_t page_erases;    /**< Ring pages erased. */
+    uint32_t recovered;      /**< Messages found in flash when the index was rebuilt at boot. */
+    uint32_t torn;           /**< Uncommitted records skipped when the index was rebuilt at boot. */
+} inbox_stats_t;
+
+
+/**@brief Function called when an append queued by inbox_append() is done, committed or dropped.
+ *        The inbox takes the next append from then on, also from within the handler.
+ */
+typedef void (*inbox_append_handler_t)(void);
+
+
+/**@brief Function for initializing the inbox.
+ *
+ * @details Registers the ring with pstorage and rebuilds the RAM index from the committed records
+ *          in flash. pstorage_init() must have been called.
+ *
+ * @param[in] append_handler  Function called when an append is done, or NULL.
+ *
+ * @retval NRF_SUCCESS If the inbox was initialized. Otherwise an error code from pstorage.
+ */
+uint32_t inbox_init(inbox_append_handler_t append_handler);
+
+/**@brief Function for appending a message to the inbox.
+ *
+ * @details The message is copied, so the caller may reuse p_data at once. It becomes visible
+ *          through inbox_latest() only once its commit mark has been written to flash, so a power
+ *          loss in the middle of an append never produces a partial message.
+ *
+ * @retval NRF_SUCCESS             If the append was queued.
+ * @retval NRF_ERROR_INVALID_STATE If the inbox is not initialized.
+ * @retval NRF_ERROR_BUSY          If a previous append is still being written.
+ * @retval NRF_ERROR_DATA_SIZE     If length exceeds INBOX_MSG_MAX_LEN.
+ */
+uint32_t inbox_append(uint32_t id, uint32_t timestamp, uint8_t flags, uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for marking one of the latest messages as read.
+ *
+ * @details Clears INBOX_FLAG_UNREAD in the index at once, and in the record in flash without an
+ *          erase. Only one mark is written at a time.
+ *
+ * @param[in] k  0 for the newest message, 1 for the one before, and so on.
+ *
+ * @retval NRF_SUCCESS         If the message is read, or the mark was queued.
+ * @retval NRF_ERROR_NOT_FOUND If fewer than k + 1 messages are indexed.
+ * @retval NRF_ERROR_BUSY      If a previous mark is still being written.
+ */
+uint32_t inbox_mark_read(uint32_t k);
+
+/**@brief Function for getting the number of indexed messages. */
+uint32_t inbox_count(void);
+
+/**@brief Function for getting one of the latest messages.
+ *
+ * @param[in] k  0 for the newest message, 1 for the one before, and so on.
+ *
+ * @return Index entry, or NULL if fewer than k + 1 messages are indexed.
+ */
+inbox_entry_t const * inbox_latest(uint32_t k);
+
+/**@brief Function for getting the body of a message. The body is read directly from flash.
+ *
+ * @return Pointer to the message body, valid until the page holding it is recycled.
+ */
+uint8_t const * inbox_data_get(inbox_entry_t const * p_entry);
+
+/**@brief Function for getting the inbox flash statistics. */
+void inbox_stats_get(inbox_stats_t * p_stats);
+
+#endif /* INBOX_H__ */
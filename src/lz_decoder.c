@@ -0,0 +1,167 @@
+#include <string.h>
+#include "nrf_error.h"
+#include "lz_decoder.h"
+
+#define WINDOW_MASK   (LZ_WINDOW_SIZE - 1)
+#define NO_BITS       (-1)
+
+/**@brief Token parser states. */
+enum
+{
+    STATE_TAG,       /**< Reading the literal/back-reference tag bit. */
+    STATE_LITERAL,   /**< Reading a literal byte. */
+    STATE_INDEX,     /**< Reading a back-reference offset. */
+    STATE_COUNT,     /**< Reading a back-reference length. */
+    STATE_YIELD      /**< Copying a back-reference to the output. */
+};
+
+
+/**@brief Function for reading bits from the input, most significant first.
+ *
+ * @return The bits, or NO_BITS if fewer than count bits are buffered. Nothing is consumed then.
+ */
+static int32_t bits_get(lz_decoder_t * p_dec, uint8_t count)
+{
+    uint32_t available = (uint32_t)(p_dec->input_size - p_dec->input_index) * 8 - p_dec->bit_index;
+    int32_t  value     = 0;
+
+    if (available < count)
+    {
+        return NO_BITS;
+    }
+
+    while (count-- > 0)
+    {
+        value = (value << 1) | ((p_dec->input[p_dec->input_index] >> (7 - p_dec->bit_index)) & 1);
+
+        if (++p_dec->bit_index == 8)
+        {
+            p_dec->bit_index = 0;
+            p_dec->input_index++;
+        }
+    }
+
+    return value;
+}
+
+
+static void byte_emit(lz_decoder_t * p_dec, uint8_t byte, uint8_t * p_out)
+{
+    p_dec->window[p_dec->head] = byte;
+    p_dec->head                = (p_dec->head + 1) & WINDOW_MASK;
+    *p_out                     = byte;
+}
+
+
+void lz_decoder_init(lz_decoder_t * p_dec)
+{
+    memset(p_dec, 0, sizeof(*p_dec));
+    p_dec->state = STATE_TAG;
+}
+
+
+uint16_t lz_decoder_sink_space(lz_decoder_t const * p_dec)
+{
+    return LZ_INPUT_BUF_SIZE - (p_dec->input_size - p_dec->input_index);
+}
+
+
+uint32_t lz_decoder_sink(lz_decoder_t * p_dec, uint8_t const * p_data, uint16_t length)
+{
+    if (length > lz_decoder_sink_space(p_dec))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    // Move the unread bytes to the front to make room.
+    if ((p_dec->input_size + length > LZ_INPUT_BUF_SIZE) && (p_dec->input_index > 0))
+    {
+        p_dec->input_size -= p_dec->input_index;
+        memmove(p_dec->input, &p_dec->input[p_dec->input_index], p_dec->input_size);
+        p_dec->input_index = 0;
+    }
+
+    memcpy(&p_dec->input[p_dec->input_size], p_data, length);
+    p_dec->input_size += length;
+
+    return NRF_SUCCESS;
+}
+
+
+uint16_t lz_decoder_poll(lz_decoder_t * p_dec, uint8_t * p_out, uint16_t out_len)
+{
+    uint16_t produced = 0;
+    int32_t  bits;
+
+    while (produced < out_len)
+    {
+        switch (p_dec->state)
+        {
+            case STATE_TAG:
+                bits = bits_get(p_dec, 1);
+                if (bits == NO_BITS)
+                {
+                    goto input_exhausted;
+                }
+                p_dec->state = bits ? STATE_LITERAL : STATE_INDEX;
+                break;
+
+            case STATE_LITERAL:
+                bits = bits_get(p_dec, 8);
+                if (bits == NO_BITS)
+                {
+                    goto input_exhausted;
+                }
+                byte_emit(p_dec, (uint8_t)bits, &p_out[produced++]);
+                p_dec->state = STATE_TAG;
+                break;
+
+            case STATE_INDEX:
+                bits = bits_get(p_dec, LZ_WINDOW_BITS);
+                if (bits == NO_BITS)
+                {
+                    goto input_exhausted;
+                }
+                p_dec->offset = (uint16_t)bits + 1;
+                p_dec->state  = STATE_COUNT;
+                break;
+
+            case STATE_COUNT:
+                bits = bits_get(p_dec, LZ_LOOKAHEAD_BITS);
+                if (bits == NO_BITS)
+                {
+                    goto input_exhausted;
+                }
+                p_dec->count = (uint16_t)bits + 1;
+                p_dec->state = STATE_YIELD;
+                break;
+
+            case STATE_YIELD:
+                while ((p_dec->count > 0) && (produced < out_len))
+                {
+                    byte_emit(p_dec,
+                              p_dec->window[(p_dec->head - p_dec->offset) & WINDOW_MASK],
+                              &p_out[produced++]);
+                    p_dec->count--;
+                }
+                if (p_dec->count == 0)
+                {
+                    p_dec->state = STATE_TAG;
+                }
+                break;
+
+            default:
+                lz_decoder_init(p_dec);
+                return produced;
+        }
+    }
+
+input_exhausted:
+    if (p_dec->input_index == p_dec->input_size)
+    {
+        p_dec->input_index = 0;
+        p_dec->input_size  = 0;
+    }
+
+    return produced;
+}
@@ -0,0 +1,62 @@
+#ifndef LZ_DECODER_H__
+#define LZ_DECODER_H__
+
+#include <stdint.h>
+
+/* Stream format parameters. They must match the compressor (tools/lz_compress.py). The format is
+ * that of heatshrink with these window and lookahead sizes, so its encoder can be used as well. */
+#define LZ_WINDOW_BITS      8                        /**< log2 of the back-reference window. */
+#define LZ_LOOKAHEAD_BITS   4                        /**< log2 of the longest back-reference. */
+#define LZ_WINDOW_SIZE      (1 << LZ_WINDOW_BITS)    /**< Size of the history window in bytes. */
+
+#define LZ_INPUT_BUF_SIZE   256                      /**< Compressed bytes buffered until they can be decoded. */
+
+
+/**@brief Streaming decoder state. All memory is in the structure; no heap is used.
+ *
+ * @details The stream is a sequence of bit-packed tokens, most significant bit first. A token is
+ *          either a 1 bit followed by an 8-bit literal, or a 0 bit followed by a
+ *          LZ_WINDOW_BITS-bit (offset - 1) and a LZ_LOOKAHEAD_BITS-bit (length - 1) back-reference
+ *          into the previous output.
+ */
+typedef struct
+{
+    uint8_t  input[LZ_INPUT_BUF_SIZE];  /**< Compressed bytes not decoded yet. */
+    uint8_t  window[LZ_WINDOW_SIZE];    /**< Last LZ_WINDOW_SIZE bytes of output. */
+    uint16_t input_size;                /**< Number of bytes in input. */
+    uint16_t input_index;               /**< Byte of input being read. */
+    uint8_t  bit_index;                 /**< Next bit of input[input_index] to read, 0 being the MSB. */
+    uint8_t  state;                     /**< Token parser state. */
+    uint16_t head;                      /**< Next write position in window. */
+    uint16_t offset;                    /**< Distance of the back-reference being copied. */
+    uint16_t count;                     /**< Bytes of the back-reference still to copy. */
+} lz_decoder_t;
+
+
+/**@brief Function for resetting a decoder to the start of a stream. */
+void lz_decoder_init(lz_decoder_t * p_dec);
+
+/**@brief Function for getting the number of compressed bytes lz_decoder_sink() can take now. */
+uint16_t lz_decoder_sink_space(lz_decoder_t const * p_dec);
+
+/**@brief Function for passing compressed bytes to the decoder.
+ *
+ * @retval NRF_SUCCESS      If all bytes were buffered.
+ * @retval NRF_ERROR_NO_MEM If they do not fit. Nothing was buffered.
+ */
+uint32_t lz_decoder_sink(lz_decoder_t * p_dec, uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for decoding buffered input.
+ *
+ * @details Decoding stops when p_out is full or the buffered input ends, possibly in the middle
+ *          of a token; it continues where it left off on the next call.
+ *
+ * @param[in]  p_dec    Decoder.
+ * @param[out] p_out    Output buffer.
+ * @param[in]  out_len  Size of the output buffer.
+ *
+ * @return Number of bytes written to p_out.
+ */
+uint16_t lz_decoder_poll(lz_decoder_t * p_dec, uint8_t * p_out, uint16_t out_len);
+
+#endif /* LZ_DECODER_H__ */
@@ -1,818 +1,2162 @@
-/* Copyright (c) 2014 Nordic Semiconductor. All Rights Reserved.
- *
- * The information contained herein is property of Nordic Semiconductor ASA.
- * Terms and conditions of usage are described in detail in NORDIC
- * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
- *
- * Licensees are granted free, non-transferable use of the information. NO
- * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
- * the file.
- *
- */
-
-/** @file
- *
- * @defgroup ble_sdk_app_cts_c_main main.c
- * @{
- * @ingroup ble_sdk_app_cts_c
- * @brief Current Time Profile sample application.
- *
- * This file contains the source code for a sample application that uses Current Time Service.
- * This is the client role of the profile, implemented on a peripheral device.
- * When a central device connects, the application will trigger a security procedure (if this is not done
- * by the central side first). Completion of the security procedure will trigger a service
- * discovery. When the Current Time Service and Characteristic have been discovered on the
- * server, pressing button 1 will trigger a read of the current time and print it on the UART.
- *
- */
-
-#include <stdint.h>
-#include <string.h>
-#include <time.h>
-#include "app_error.h"
-#include "app_scheduler.h"
-#include "app_timer_appsh.h"
-#include "app_trace.h"
-#include "ble.h"
-#include "ble_db_discovery.h"
-#include "ble_hci.h"
-#include "ble_srv_common.h"
-#include "ble_advdata.h"
-#include "ble_advertising.h"
-#include "ble_conn_params.h"
-#include "device_manager.h"
-#include "nordic_common.h"
-#include "nrf.h"
-#include "nrf_gpio.h"
-#include "pstorage.h"
-#include "softdevice_handler.h"
-#include "app_uart.h"
-#include "app_button.h"
-
-#include "ble_pixwatch_c.h"
-#include "display.h"
-
-#define UART_TX_BUF_SIZE                1024         /**< UART TX buffer size. */
-#define UART_RX_BUF_SIZE                32           /**< UART RX buffer size. */
-
-#define IS_SRVC_CHANGED_CHARACT_PRESENT 0            /**< Include or exclude the service_changed characteristic. If excluded, the server's database cannot be changed for the lifetime of the device. */
-
-#define WAKEUP_BUTTON_ID                0            /**< Button used to wake up the application. */
-#define BOND_DELETE_ALL_BUTTON_ID       1            /**< Button used to delete all bonded centrals during startup. */
-#define CURRENT_TIME_READ_BUTTON_ID     0            /**< Button used to read the current time from the server/central. */
-
-#define DEVICE_NAME                     "PixWatch"   /**< Name of the device. Will be included in the advertising data. */
-#define APP_ADV_FAST_INTERVAL           0x0028       /**< Fast advertising interval (in units of 0.625 ms). The default value corresponds to 25 ms. */
-#define APP_ADV_SLOW_INTERVAL           0x0C80       /**< Slow advertising interval (in units of 0.625 ms). The default value corresponds to 2 seconds. */
-#define APP_ADV_SLOW_TIMEOUT            180          /**< The duration of the slow advertising period (in seconds). */
-#define APP_ADV_FAST_TIMEOUT            30           /**< The duration of the fast advertising period (in seconds). */
-
-#define APP_TIMER_PRESCALER             0                                           /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS            (3 + 6)                                     /**< Maximum number of simultaneously created timers. */
-#define APP_TIMER_OP_QUEUE_SIZE         4                                           /**< Size of timer operation queues. */
-
-#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(500, UNIT_1_25_MS)            /**< Minimum acceptable connection interval (0.5 seconds). */
-#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(1000, UNIT_1_25_MS)           /**< Maximum acceptable connection interval (1 second). */
-#define SLAVE_LATENCY                   0                                           /**< Slave latency. */
-#define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Connection supervisory time-out (4 seconds). */
-#define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER)  /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
-#define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER) /**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
-#define MAX_CONN_PARAMS_UPDATE_COUNT    3                                           /**< Number of attempts before giving up the connection parameter negotiation. */
-
-#define SECURITY_REQUEST_DELAY          APP_TIMER_TICKS(4000, APP_TIMER_PRESCALER)  /**< Delay after connection until security request is sent, if necessary (ticks). */
-#define REALTIME_CLOCK_INTERVAL         APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)  /**< Real-time clock (ticks for every seconds). */
-
-#define SEC_PARAM_TIMEOUT               30                                          /**< Time-out for pairing request or security request (in seconds). */
-#define SEC_PARAM_BOND                  1                                           /**< Perform bonding. */
-#define SEC_PARAM_MITM                  0                                           /**< Man In The Middle protection requirement. */
-#define SEC_PARAM_IO_CAPABILITIES       BLE_GAP_IO_CAPS_NONE                        /**< I/O capabilities. */
-#define SEC_PARAM_OOB                   0                                           /**< Out Of Band data availability. */
-#define SEC_PARAM_MIN_KEY_SIZE          7                                           /**< Minimum encryption key size. */
-#define SEC_PARAM_MAX_KEY_SIZE          16                                          /**< Maximum encryption key size. */
-
-#define DEAD_BEEF                       0xDEADBEEF                                  /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
-
-#define BUTTON_1       13
-#define BUTTON_2       14
-#define BUTTON_3       15
-#define BUTTON_4       16
-
-#define RX_PIN_NUMBER  8
-#define TX_PIN_NUMBER  6
-#define CTS_PIN_NUMBER 7
-#define RTS_PIN_NUMBER 5
-
-#define BUTTON_DEBOUNCE_DELAY			50
-
-
-static uint16_t m_conn_handle               = BLE_CONN_HANDLE_INVALID; /**< Handle of the current connection. */
-
-static ble_db_discovery_t        m_ble_db_discovery;                   /**< Structure used to identify the DB Discovery module. */
-static ble_pixwatch_c_t          m_pixwatch;                           /**< Structure to store the data of the pixwatch service. */
-static dm_application_instance_t m_app_handle;                         /**< Application identifier allocated by the Device Manager. */
-static dm_handle_t               m_peer_handle;                        /**< The peer that is currently connected. */
-
-static app_timer_id_t m_sec_req_timer_id;                              /**< Security request timer. */
-static app_timer_id_t m_realtime_timer_id;                             /**< Real-time timer */
-
-#define SCHED_MAX_EVENT_DATA_SIZE sizeof(app_timer_event_t)            /**< Maximum size of scheduler events. Note that scheduler BLE stack events do not contain any data, as the events are being pulled from the stack in the event handler. */
-#define SCHED_QUEUE_SIZE          10                                   /**< Maximum number of events in the scheduler queue. */
-
-static ble_uuid_t m_adv_uuids[] = {{PIXWATCH_UUID_SERVICE, BLE_UUID_TYPE_VENDOR_BEGIN}}; /**< Universally unique service identifiers. */
-
-/* Current Time */
-time_t current_time = 0;
-
-
-/**@brief Callback function for asserts in the SoftDevice.
- *
- * @details This function will be called in case of an assert in the SoftDevice.
- *
- * @warning This handler is an example only and does not fit a final product. You need to analyze
- *          how your product is supposed to react in case of Assert.
- * @warning On assert from the SoftDevice, the system can only recover on reset.
- *
- * @param[in] line_num  Line number of the failing ASSERT call.
- * @param[in] file_name File name of the failing ASSERT call.
- */
-void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
-{
-    app_error_handler(DEAD_BEEF, line_num, p_file_name);
-}
-
-
-/**@brief Function for handling the Current Time Service errors.
- *
- * @param[in]  nrf_error  Error code containing information about what went wrong.
- */
-static void current_time_error_handler(uint32_t nrf_error)
-{
-    APP_ERROR_HANDLER(nrf_error);
-}
-
-
-/**@brief Function for handling UART errors.
- *
- * @param[in] nrf_error  Error code containing information about what went wrong.
- */
-static void uart_error_handle(app_uart_evt_t * p_event)
-{
-    if (p_event->evt_type == APP_UART_COMMUNICATION_ERROR)
-    {
-        APP_ERROR_HANDLER(p_event->data.error_communication);
-    }
-    else if (p_event->evt_type == APP_UART_FIFO_ERROR)
-    {
-        APP_ERROR_HANDLER(p_event->data.error_code);
-    }
-    /*
-    else if (p_event->evt_type == APP_UART_DATA_READY) // There is one byte in the RX FIFO.
-    {
-    	uint8_t character;
-    	while(app_uart_get(&character) != NRF_SUCCESS); // Non blocking.
-    	jshPushIOCharEvent(EV_SERIAL1, (char) character);
-    }
-    */
-}
-
-static void on_pixwatch_c_evt(ble_pixwatch_c_t * p_pixwatch, ble_pixwatch_c_evt_t * p_evt)
-{
-    switch (p_evt->evt_type)
-    {
-        case BLE_PIXWATCH_C_EVT_DISCOVERY_COMPLETE:
-            printf("Current Time Service discovered on server.\n");
-            break;
-
-        case BLE_PIXWATCH_C_EVT_SERVICE_NOT_FOUND:
-            printf("Current Time Service not found on server.\n");
-            break;
-
-        case BLE_PIXWATCH_C_EVT_DISCONN_COMPLETE:
-            printf("Disconnect Complete.\n");
-            break;
-
-        case BLE_PIXWATCH_C_EVT_LOCAL_TIME:
-            printf("Current Time received.\n");
-            current_time = p_evt->local_time;
-            break;
-
-        default:
-            break;
-    }
-}
-
-
-static void pixwatch_error_handler(uint32_t nrf_error)
-{
-    APP_ERROR_HANDLER(nrf_error);
-}
-
-
-/**@brief Function for handling the security request timer time-out.
- *
- * @details This function will be called each time the security request timer expires.
- *
- * @param[in] p_context  Pointer used for passing some arbitrary information (context) from the
- *                       app_start_timer() call to the time-out handler.
- */
-static void sec_req_timeout_handler(void * p_context)
-{
-    uint32_t             err_code;
-    dm_security_status_t status;
-
-    if (m_conn_handle != BLE_CONN_HANDLE_INVALID)
-    {
-        err_code = dm_security_status_req(&m_peer_handle, &status);
-        APP_ERROR_CHECK(err_code);
-
-        // If the link is still not secured by the peer, initiate security procedure.
-        if (status == NOT_ENCRYPTED)
-        {
-            err_code = dm_security_setup_req(&m_peer_handle);
-            APP_ERROR_CHECK(err_code);
-        }
-    }
-}
-
-
-static void button_handler(uint8_t pin_no, uint8_t button_action)
-{
-    if(button_action == APP_BUTTON_PUSH)
-    {
-    	uint32_t err_code;
-    	struct tm *t;
-
-        switch(pin_no)
-        {
-            case BUTTON_1:
-                if (m_conn_handle != BLE_CONN_HANDLE_INVALID)
-                {
-                    err_code = ble_pixwatch_c_local_time_read(&m_pixwatch);
-                    if (err_code == NRF_ERROR_NOT_FOUND)
-                    {
-                        printf("Current Time Service is not discovered.\r\n");
-                    }
-                }
-                break;
-
-            case BUTTON_2:
-            	t = localtime(&current_time);
-                printf("Local Time (Unix Time + Local Offset): %d\n", (int) current_time);
-                printf("Year: %d\n",   t->tm_year + 1900);
-                printf("Month: %d\n",   t->tm_mon + 1);
-                printf("Day: %d\n", t->tm_mday);
-                printf("Hour: %d\n",   t->tm_hour);
-                printf("Minute: %d\n",   t->tm_min);
-                printf("Second: %d\n", t->tm_sec);
-                printf("Day of Week: %d\n", t->tm_wday); // Sun=0, Mon=1, Tue=2, Wed=3, Thu=4, Fri=5, Sat=6
-                break;
-
-            case BUTTON_3:
-            	printf("button_3 pressed.\n");
-                break;
-
-            case BUTTON_4:
-            	printf("button_4 pressed.\n");
-                break;
-
-            default:
-                break;
-        }
-    }
-}
-
-
-static void realtime_timer_handler(void * p_context)
-{
-	current_time++;
-
-	struct tm *t;
-	t = localtime(&current_time);
-
-	putDigit(0, 0, t->tm_hour / 10, BLUE, BLACK);
-	putDigit(4, 0, t->tm_hour % 10, BLUE, BLACK);
-
-	putDigit(12, 0, t->tm_min / 10, BLUE, BLACK);
-	putDigit(16, 0, t->tm_min % 10, BLUE, BLACK);
-
-	putDigit(24, 0, t->tm_sec / 10, BLUE, BLACK);
-	putDigit(28, 0, t->tm_sec % 10, BLUE, BLACK);
-}
-
-
-/**@brief Function for the timer initialization.
- *
- * @details Initializes the timer module.
- */
-static void timers_init(void)
-{
-    uint32_t err_code;
-
-    // Initialize timer module, making it use the scheduler
-    APP_TIMER_APPSH_INIT(APP_TIMER_PRESCALER, APP_TIMER_MAX_TIMERS, APP_TIMER_OP_QUEUE_SIZE, true);
-
-    // Create security request timer.
-    err_code = app_timer_create(&m_sec_req_timer_id, APP_TIMER_MODE_SINGLE_SHOT, sec_req_timeout_handler);
-    APP_ERROR_CHECK(err_code);
-
-    // Create real-time timer.
-    err_code = app_timer_create(&m_realtime_timer_id, APP_TIMER_MODE_REPEATED, realtime_timer_handler);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for the GAP initialization.
- *
- * @details This function sets up all the necessary GAP (Generic Access Profile) parameters of the
- *          device including the device name, appearance, and the preferred connection parameters.
- */
-static void gap_params_init(void)
-{
-    uint32_t                err_code;
-    ble_gap_conn_params_t   gap_conn_params;
-    ble_gap_conn_sec_mode_t sec_mode;
-
-    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
-
-    err_code = sd_ble_gap_device_name_set(&sec_mode,
-                                          (const uint8_t *)DEVICE_NAME,
-                                          strlen(DEVICE_NAME));
-    APP_ERROR_CHECK(err_code);
-
-    memset(&gap_conn_params, 0, sizeof(gap_conn_params));
-
-    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
-    gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
-    gap_conn_params.slave_latency     = SLAVE_LATENCY;
-    gap_conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
-
-    err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-
-/**@brief Function for initializing services that will be used by the application.
- */
-static void services_init(void)
-{
-    uint32_t         err_code;
-    ble_pixwatch_c_init_t pixwatch_init_obj;
-
-    uint8_t m_pixwatch_uuid_type;
-    ble_uuid_t service_uuid;
-
-    err_code = sd_ble_uuid_vs_add(&ble_pixwatch_base_uuid128, &m_pixwatch_uuid_type);
-    APP_ERROR_CHECK(err_code);
-
-    err_code = sd_ble_uuid_vs_add(&ble_pixwatch_local_time_base_uuid128, &service_uuid.type);
-    APP_ERROR_CHECK(err_code);
-
-    pixwatch_init_obj.evt_handler   = on_pixwatch_c_evt;
-    pixwatch_init_obj.error_handler = pixwatch_error_handler;
-
-    err_code = ble_pixwatch_c_init(&m_pixwatch, &pixwatch_init_obj);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for handling the Connection Parameters module.
- *
- * @details This function will be called for all events in the Connection Parameters module that
- *          are passed to the application.
- *          @note All this function does is to disconnect. This could have been done by simply
- *                setting the disconnect_on_fail config parameter, but instead we use the event
- *                handler mechanism to demonstrate its use.
- *
- * @param[in] p_evt  Event received from the Connection Parameters module.
- */
-static void on_conn_params_evt(ble_conn_params_evt_t * p_evt)
-{
-    uint32_t err_code;
-
-    if (p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
-    {
-        err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
-        APP_ERROR_CHECK(err_code);
-    }
-}
-
-
-/**@brief Function for handling a Connection Parameters error.
- *
- * @param[in]   nrf_error   Error code containing information about what went wrong.
- */
-static void conn_params_error_handler(uint32_t nrf_error)
-{
-    APP_ERROR_HANDLER(nrf_error);
-}
-
-
-/**@brief Function for initializing the Connection Parameters module.
- */
-static void conn_params_init(void)
-{
-    uint32_t               err_code;
-    ble_conn_params_init_t cp_init;
-
-    memset(&cp_init, 0, sizeof(cp_init));
-
-    cp_init.p_conn_params                  = NULL;
-    cp_init.first_conn_params_update_delay = FIRST_CONN_PARAMS_UPDATE_DELAY;
-    cp_init.next_conn_params_update_delay  = NEXT_CONN_PARAMS_UPDATE_DELAY;
-    cp_init.max_conn_params_update_count   = MAX_CONN_PARAMS_UPDATE_COUNT;
-    cp_init.start_on_notify_cccd_handle    = BLE_GATT_HANDLE_INVALID;
-    cp_init.disconnect_on_fail             = false;
-    cp_init.evt_handler                    = on_conn_params_evt;
-    cp_init.error_handler                  = conn_params_error_handler;
-
-    err_code = ble_conn_params_init(&cp_init);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for dispatching a system event to interested modules.
- *
- * @details This function is called from the system event interrupt handler after a system
- *          event has been received.
- *
- * @param[in] sys_evt  System stack event.
- */
-static void sys_evt_dispatch(uint32_t sys_evt)
-{
-    pstorage_sys_event_handler(sys_evt);
-    ble_advertising_on_sys_evt(sys_evt);
-}
-
-
-/**@brief Function for handling the Device Manager events.
- *
- * @param[in] p_evt  Data associated to the Device Manager event.
- */
-static uint32_t device_manager_evt_handler(dm_handle_t const * p_handle,
-                                           dm_event_t const  * p_event,
-                                           ret_code_t        event_result)
-{
-    uint32_t err_code;
-
-    APP_ERROR_CHECK(event_result);
-
-    switch (p_event->event_id)
-    {
-        case DM_EVT_CONNECTION:
-            m_peer_handle = (*p_handle);
-            err_code      = app_timer_start(m_sec_req_timer_id, SECURITY_REQUEST_DELAY, NULL);
-            APP_ERROR_CHECK(err_code);
-
-            err_code      = app_timer_start(m_realtime_timer_id, REALTIME_CLOCK_INTERVAL, NULL);
-            APP_ERROR_CHECK(err_code);
-            break;
-
-        case DM_EVT_LINK_SECURED:
-            err_code = ble_db_discovery_start(&m_ble_db_discovery,
-                                              p_event->event_param.p_gap_param->conn_handle);
-            APP_ERROR_CHECK(err_code);
-            break;
-
-        default:
-            // No implementation needed.
-            break;
-
-    }
-    return NRF_SUCCESS;
-}
-
-
-/**@brief Function for the Device Manager initialization.
- *
- * @param[in] erase_bonds  Indicates whether bonding information should be cleared from
- *                         persistent storage during initialization of the Device Manager.
- */
-static void device_manager_init(bool erase_bonds)
-{
-    uint32_t               err_code;
-    dm_init_param_t        init_param = {.clear_persistent_data = erase_bonds};
-    dm_application_param_t register_param;
-
-    // Initialize persistent storage module.
-    err_code = pstorage_init();
-    APP_ERROR_CHECK(err_code);
-
-    err_code = dm_init(&init_param);
-    APP_ERROR_CHECK(err_code);
-
-    memset(&register_param.sec_param, 0, sizeof(ble_gap_sec_params_t));
-
-    register_param.sec_param.bond         = SEC_PARAM_BOND;
-    register_param.sec_param.mitm         = SEC_PARAM_MITM;
-    register_param.sec_param.io_caps      = SEC_PARAM_IO_CAPABILITIES;
-    register_param.sec_param.oob          = SEC_PARAM_OOB;
-    register_param.sec_param.min_key_size = SEC_PARAM_MIN_KEY_SIZE;
-    register_param.sec_param.max_key_size = SEC_PARAM_MAX_KEY_SIZE;
-    register_param.evt_handler            = device_manager_evt_handler;
-    register_param.service_type           = DM_PROTOCOL_CNTXT_GATT_CLI_ID;
-
-    err_code = dm_register(&m_app_handle, &register_param);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for putting the chip into sleep mode.
- *
- * @note This function will not return.
- */
-static void sleep_mode_enter(void)
-{
-    // uint32_t err_code = bsp_indication_set(BSP_INDICATE_IDLE);
-    // APP_ERROR_CHECK(err_code);
-
-    // Prepare wakeup buttons.
-    // err_code = bsp_btn_ble_sleep_mode_prepare();
-    // APP_ERROR_CHECK(err_code);
-
-    // Go to system-off mode (this function will not return; wakeup will cause a reset).
-	uint32_t err_code = sd_power_system_off();
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for handling advertising events.
- *
- * @details This function will be called for advertising events which are passed to the application.
- *
- * @param[in] ble_adv_evt  Advertising event.
- */
-static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
-{
-    uint32_t err_code;
-
-    switch (ble_adv_evt)
-    {
-        case BLE_ADV_EVT_DIRECTED:
-            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_DIRECTED);
-            // APP_ERROR_CHECK(err_code);
-            break;
-        case BLE_ADV_EVT_FAST:
-            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING);
-            // APP_ERROR_CHECK(err_code);
-            break;
-        case BLE_ADV_EVT_SLOW:
-            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_SLOW);
-            // APP_ERROR_CHECK(err_code);
-            break;
-        case BLE_ADV_EVT_FAST_WHITELIST:
-            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_WHITELIST);
-            // APP_ERROR_CHECK(err_code);
-            break;
-        case BLE_ADV_EVT_SLOW_WHITELIST:
-            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_WHITELIST);
-            // APP_ERROR_CHECK(err_code);
-            err_code = ble_advertising_restart_without_whitelist();
-            APP_ERROR_CHECK(err_code);
-            break;
-        case BLE_ADV_EVT_IDLE:
-            // sleep_mode_enter();
-            break;
-
-        case BLE_ADV_EVT_WHITELIST_REQUEST:
-        {
-            ble_gap_whitelist_t whitelist;
-            ble_gap_addr_t    * p_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
-            ble_gap_irk_t     * p_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
-
-            whitelist.addr_count = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
-            whitelist.irk_count  = BLE_GAP_WHITELIST_IRK_MAX_COUNT;
-            whitelist.pp_addrs   = p_whitelist_addr;
-            whitelist.pp_irks    = p_whitelist_irk;
-
-            err_code = dm_whitelist_create(&m_app_handle, &whitelist);
-            APP_ERROR_CHECK(err_code);
-
-            err_code = ble_advertising_whitelist_reply(&whitelist);
-            APP_ERROR_CHECK(err_code);
-            break;
-        }
-        default:
-            break;
-    }
-}
-
-
-/**@brief Function for dispatching a BLE stack event to all modules with a BLE stack event handler.
- *
- * @details This function is called from the scheduler in the main loop after a BLE stack
- *          event has been received.
- *
- * @param[in] p_ble_evt  Bluetooth stack event.
- */
-static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
-{
-    dm_ble_evt_handler(p_ble_evt);
-    ble_db_discovery_on_ble_evt(&m_ble_db_discovery, p_ble_evt);
-
-    switch (p_ble_evt->header.evt_id)
-    {
-        case BLE_GAP_EVT_CONNECTED:
-            m_conn_handle      = p_ble_evt->evt.gap_evt.conn_handle;
-            break;
-
-        case BLE_GAP_EVT_DISCONNECTED:
-            m_conn_handle = BLE_CONN_HANDLE_INVALID;
-            break;
-
-        default:
-            // No implementation needed.
-            break;
-    }
-
-    ble_conn_params_on_ble_evt(p_ble_evt);
-    ble_pixwatch_c_on_ble_evt(&m_pixwatch, p_ble_evt);
-    ble_advertising_on_ble_evt(p_ble_evt);
-}
-
-
-/**@brief Function for initializing the BLE stack.
- *
- * @details Initializes the SoftDevice and the BLE event interrupt.
- */
-static void ble_stack_init(void)
-{
-    uint32_t err_code;
-
-    // Initialize the SoftDevice handler module.
-    SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_XTAL_20_PPM, NULL);
-
-#if defined(S110) || defined(S130) || defined(S132)
-    // Enable BLE stack
-    ble_enable_params_t ble_enable_params;
-    memset(&ble_enable_params, 0, sizeof(ble_enable_params));
-#if (defined(S130) || defined(S132))
-    ble_enable_params.gatts_enable_params.attr_tab_size   = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT;
-#endif
-    ble_enable_params.gatts_enable_params.service_changed = IS_SRVC_CHANGED_CHARACT_PRESENT;
-    err_code = sd_ble_enable(&ble_enable_params);
-    APP_ERROR_CHECK(err_code);
-#endif
-
-    // Register with the SoftDevice handler module for BLE events.
-    err_code = softdevice_ble_evt_handler_set(ble_evt_dispatch);
-    APP_ERROR_CHECK(err_code);
-
-    // Register with the SoftDevice handler module for BLE events.
-    err_code = softdevice_sys_evt_handler_set(sys_evt_dispatch);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for the Event Scheduler initialization.
- */
-static void scheduler_init(void)
-{
-    APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
-}
-
-
-/**@brief Function for initializing the advertising functionality.
- *
- * @details Encodes the required advertising data and passes it to the stack.
- *          Also builds a structure to be passed to the stack when starting advertising.
- */
-static void advertising_init()
-{
-    uint32_t      err_code;
-    ble_advdata_t advdata;
-    ble_advdata_t scanrsp;
-
-    // Build and set advertising data
-    memset(&advdata, 0, sizeof(advdata));
-
-    advdata.name_type                = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance       = true;
-    advdata.flags                    = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
-
-    memset(&scanrsp, 0, sizeof(scanrsp));
-    scanrsp.uuids_solicited.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
-    scanrsp.uuids_solicited.p_uuids  = m_adv_uuids;
-
-    ble_adv_modes_config_t options    = {0};
-    options.ble_adv_whitelist_enabled = BLE_ADV_WHITELIST_ENABLED;
-    options.ble_adv_fast_enabled      = BLE_ADV_FAST_ENABLED;
-    options.ble_adv_fast_interval     = APP_ADV_FAST_INTERVAL;
-    options.ble_adv_fast_timeout      = APP_ADV_FAST_TIMEOUT;
-    options.ble_adv_slow_enabled      = BLE_ADV_SLOW_ENABLED;
-    options.ble_adv_slow_interval     = APP_ADV_SLOW_INTERVAL;
-    options.ble_adv_slow_timeout      = APP_ADV_SLOW_TIMEOUT;
-
-    err_code = ble_advertising_init(&advdata, &scanrsp, &options, on_adv_evt, NULL);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-static void buttons_init(void) {
-	uint32_t err_code;
-
-	static app_button_cfg_t p_button[] = {
-			{BUTTON_1, false, NRF_GPIO_PIN_PULLUP, button_handler},
-	        {BUTTON_2, false, NRF_GPIO_PIN_PULLUP, button_handler},
-	        {BUTTON_3, false, NRF_GPIO_PIN_PULLUP, button_handler},
-	        {BUTTON_4, false, NRF_GPIO_PIN_PULLUP, button_handler}
-	};
-
-    err_code = app_button_init(p_button, sizeof(p_button) / sizeof(p_button[0]), BUTTON_DEBOUNCE_DELAY);
-    APP_ERROR_CHECK(err_code);
-
-    err_code = app_button_enable();
-    APP_ERROR_CHECK(err_code);
-}
-
-/**@brief Function for initializing the UART.
- */
-static void uart_init(void)
-{
-    uint32_t                     err_code;
-    const app_uart_comm_params_t comm_params =
-    {
-        RX_PIN_NUMBER,
-        TX_PIN_NUMBER,
-        0xFF, // UART_PIN_DISCONNECTED
-        0xFF, // UART_PIN_DISCONNECTED
-        APP_UART_FLOW_CONTROL_DISABLED,
-        false,
-        UART_BAUDRATE_BAUDRATE_Baud38400
-    };
-
-    APP_UART_FIFO_INIT(&comm_params,
-                       UART_RX_BUF_SIZE,
-                       UART_TX_BUF_SIZE,
-                       uart_error_handle,
-                       APP_IRQ_PRIORITY_LOW,
-                       err_code);
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**
- * @brief Database discovery collector initialization.
- */
-static void db_discovery_init(void)
-{
-    uint32_t err_code = ble_db_discovery_init();
-
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for the power manager.
- */
-static void power_manage(void)
-{
-    uint32_t err_code = sd_app_evt_wait();
-
-    APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for application main entry.
- */
-int main(void)
-{
-    uint32_t err_code;
-    bool     erase_bonds = false;
-
-    // Initialize
-    app_trace_init();
-    timers_init();
-    buttons_init();
-    uart_init();
-    printf("PixWatch Starting!\n");
-    ble_stack_init();
-    device_manager_init(erase_bonds);
-    db_discovery_init();
-    scheduler_init();
-    gap_params_init();
-    services_init();
-    advertising_init();
-    conn_params_init();
-
-    // Start execution
-    err_code = ble_advertising_start(BLE_ADV_MODE_FAST);
-    APP_ERROR_CHECK(err_code);
-    printf("Advertising Started!\n");
-
-    // Init display
-    spi_master_init();
-    initDisplay();
-    drawRectangle(0, 0, 127, 95, BLACK);
-
-    // Enter main loop
-    for (;;)
-    {
-        app_sched_execute();
-        power_manage();
-    }
-}
-
-
-/**
- * @}
- */
+/* Copyright (c) 2014 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is property of Nordic Semiconductor ASA.
+ * Terms and conditions of usage are described in detail in NORDIC
+ * SEMICONDUCTOR STANDARD SOFTWARE LICENSE AGREEMENT.
+ *
+ * Licensees are granted free, non-transferable use of the information. NO
+ * WARRANTY of ANY KIND is provided. This heading must NOT be removed from
+ * the file.
+ *
+ */
+
+/** @file
+ *
+ * @defgroup ble_sdk_app_cts_c_main main.c
+ * @{
+ * @ingroup ble_sdk_app_cts_c
+ * @brief Current Time Profile sample application.
+ *
+ * This file contains the source code for a sample application that uses Current Time Service.
+ * This is the client role of the profile, implemented on a peripheral device.
+ * When a central device connects, the application will trigger a security procedure (if this is not done
+ * by the central side first). Completion of the security procedure will trigger a service
+ * discovery. When the Current Time Service and Characteristic have been discovered on the
+ * server, pressing button 1 will trigger a read of the current time and print it on the UART.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_timer_appsh.h"
+#include "app_trace.h"
+#include "ble.h"
+#include "ble_db_discovery.h"
+#include "ble_hci.h"
+#include "ble_srv_common.h"
+#include "ble_advdata.h"
+#include "ble_advertising.h"
+#include "ble_conn_params.h"
+#include "device_manager.h"
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf_delay.h"
+#include "nrf_gpio.h"
+#include "pstorage.h"
+#include "softdevice_handler.h"
+#include "app_uart.h"
+#include "app_button.h"
+
+#include "adv_payload.h"
+#include "adv_policy.h"
+#include "ble_ancs_c.h"
+#include "ble_asset.h"
+#include "ble_telemetry.h"
+#include "console.h"
+#include "crash_log.h"
+#include "dlog.h"
+#include "ble_dispatch.h"
+#include "ble_pixwatch_c.h"
+#include "ancs_notif.h"
+#include "display.h"
+#include "inbox.h"
+#include "radio_sched.h"
+#include "settings.h"
+#include "history.h"
+#include "retained.h"
+#include "boot_log.h"
+
+// One client instance per link the SoftDevice takes, and no more: the instances cost RAM.
+STATIC_ASSERT(BLE_PIXWATCH_C_MAX_LINKS == PERIPHERAL_LINK_COUNT);
+
+#define UART_TX_BUF_SIZE                1024         /**< UART TX buffer size. */
+#define UART_RX_BUF_SIZE                32           /**< UART RX buffer size. */
+
+#define IS_SRVC_CHANGED_CHARACT_PRESENT 0            /**< Include or exclude the service_changed characteristic. If excluded, the server's database cannot be changed for the lifetime of the device. */
+
+#define WAKEUP_BUTTON_ID                0            /**< Button used to wake up the application. */
+#define BOND_DELETE_ALL_BUTTON_ID       1            /**< Button used to delete all bonded centrals during startup. */
+#define CURRENT_TIME_READ_BUTTON_ID     0            /**< Button used to read the current time from the server/central. */
+
+#define DEVICE_NAME                     ADV_PAYLOAD_DEVICE_NAME   /**< Name of the device. Will be included in the advertising data. */
+#define APP_ADV_FAST_INTERVAL           0x0028       /**< Fast advertising interval (in units of 0.625 ms). The default value corresponds to 25 ms. */
+#define APP_ADV_SLOW_INTERVAL           0x0C80       /**< Slow advertising interval (in units of 0.625 ms). The default value corresponds to 2 seconds. */
+#define APP_ADV_SLOW_TIMEOUT            180          /**< The duration of the slow advertising period (in seconds). */
+#define APP_ADV_FAST_TIMEOUT            30           /**< The duration of the fast advertising period (in seconds). */
+
+#define APP_TIMER_PRESCALER             0                                           /**< Value of the RTC1 PRESCALER register. */
+#define APP_TIMER_MAX_TIMERS            (4 + 6)                                     /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_OP_QUEUE_SIZE         4                                           /**< Size of timer operation queues. */
+
+#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(500, UNIT_1_25_MS)            /**< Minimum acceptable connection interval (0.5 seconds). */
+#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(1000, UNIT_1_25_MS)           /**< Maximum acceptable connection interval (1 second). */
+#define SLAVE_LATENCY                   0                                           /**< Slave latency. */
+#define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Connection supervisory time-out (4 seconds). */
+#define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER)  /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
+#define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER) /**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
+#define MAX_CONN_PARAMS_UPDATE_COUNT    3                                           /**< Number of attempts before giving up the connection parameter negotiation. */
+
+#define SECURITY_REQUEST_DELAY          APP_TIMER_TICKS(4000, APP_TIMER_PRESCALER)  /**< Delay after connection until security request is sent, if necessary (ticks). */
+#define REALTIME_CLOCK_INTERVAL         APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)  /**< Real-time clock (ticks for every seconds). */
+#define ANCS_FETCH_TIMEOUT              APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER) /**< Time the phone gets to send the attributes of one iOS notification, some ten connection events at the longest interval (30 seconds). */
+#define HISTORY_SAMPLE_INTERVAL         60                                          /**< Seconds between history samples. */
+#define LFCLK_POLL_INTERVAL             1000                                        /**< Microseconds between checks for the crystal while the display starts up. */
+
+#define SEC_PARAM_TIMEOUT               30                                          /**< Time-out for pairing request or security request (in seconds). */
+#define SEC_PARAM_BOND                  1                                           /**< Perform bonding. */
+#define SEC_PARAM_MITM                  0                                           /**< Man In The Middle protection requirement. */
+#define SEC_PARAM_IO_CAPABILITIES       BLE_GAP_IO_CAPS_NONE                        /**< I/O capabilities. */
+#define SEC_PARAM_OOB                   0                                           /**< Out Of Band data availability. */
+#define SEC_PARAM_MIN_KEY_SIZE          7                                           /**< Minimum encryption key size. */
+#define SEC_PARAM_MAX_KEY_SIZE          16                                          /**< Maximum encryption key size. */
+
+#define DEAD_BEEF                       0xDEADBEEF                                  /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
+
+#define BUTTON_1       13
+#define BUTTON_2       14
+#define BUTTON_3       15
+#define BUTTON_4       16
+
+#define RX_PIN_NUMBER  8
+#define TX_PIN_NUMBER  6
+#define CTS_PIN_NUMBER 7
+#define RTS_PIN_NUMBER 5
+
+#define BUTTON_DEBOUNCE_DELAY			50
+
+
+static uint16_t m_conn_handle               = BLE_CONN_HANDLE_INVALID; /**< Handle of the most recent connection, the one negotiated by the Connection Parameters module. */
+static uint8_t  m_link_count                = 0;                       /**< Number of currently connected peers. */
+
+static ble_db_discovery_t        m_ble_db_discovery[BLE_PIXWATCH_C_MAX_LINKS]; /**< DB Discovery instances, one per link. */
+static ble_pixwatch_c_t          m_pixwatch[BLE_PIXWATCH_C_MAX_LINKS];         /**< PixWatch Service client instances, one per link. */
+static ble_ancs_c_t              m_ancs[BLE_PIXWATCH_C_MAX_LINKS];             /**< Apple Notification Center Service client instances, one per link. */
+static ble_asset_t               m_asset;                                      /**< Asset Transfer Service instance. */
+static ble_telemetry_t           m_telemetry;                                  /**< Telemetry Service instance. */
+static dm_application_instance_t m_app_handle;                                 /**< Application identifier allocated by the Device Manager. */
+static dm_handle_t               m_peer_handles[DEVICE_MANAGER_MAX_CONNECTIONS]; /**< Peers that are currently connected, indexed by Device Manager connection ID. */
+static bool                      m_peer_connected[DEVICE_MANAGER_MAX_CONNECTIONS]; /**< Whether the entry in m_peer_handles is in use. */
+
+static app_timer_id_t m_sec_req_timer_id;                              /**< Security request timer. */
+static app_timer_id_t m_realtime_timer_id;                             /**< Real-time timer */
+static app_timer_id_t m_display_timer_id;                              /**< Display start-up delays. */
+static radio_sched_job_id_t m_clock_draw_job_id;                       /**< Clock redraw, run between radio events. */
+
+static uint32_t m_reset_reason;                                        /**< NRF_POWER->RESETREAS at boot. */
+static uint32_t m_uptime;                                              /**< Seconds since reset, counted by the real-time timer from boot. */
+static uint32_t m_wakeups;                                             /**< Main loop wakeups in the current hour. */
+static uint32_t m_wakeups_total;                                       /**< Main loop wakeups since reset. */
+static uint32_t m_wakeups_last_hour;                                   /**< Main loop wakeups per hour over the last full hour. */
+static uint32_t m_hour_start;                                          /**< m_uptime at the start of the current hour. */
+static bool     m_hour_done;                                           /**< m_wakeups_last_hour holds a full hour. */
+static uint32_t m_frame_spi_bytes;                                     /**< SPI bytes of the last clock redraw. */
+static bool     m_warm_boot;                                           /**< The retained state of the previous run was kept. */
+static bool     m_display_ready;                                       /**< Display initialized and first frame drawn. */
+static bool     m_clock_running;                                       /**< current_time advances: from the first link, or as restored at a warm boot. */
+static bool     m_discovery_deferred[BLE_PIXWATCH_C_MAX_LINKS];        /**< DB discovery waits for the state sync on cached handles, per PixWatch client instance. */
+
+/**@brief State read on handles cached from an earlier connection, held until discovery confirms them. */
+typedef struct
+{
+    bool                     pending;   /**< state waits for the discovery of the link. */
+    ble_pixwatch_c_handles_t handles;   /**< Cached handles the state was read on. */
+    ble_pixwatch_c_state_t   state;
+} cached_sync_t;
+
+static cached_sync_t m_cached_sync[BLE_PIXWATCH_C_MAX_LINKS];          /**< Per PixWatch client instance. */
+
+#define SCHED_MAX_EVENT_DATA_SIZE sizeof(app_timer_event_t)            /**< Maximum size of scheduler events. Note that scheduler BLE stack events do not contain any data, as the events are being pulled from the stack in the event handler. */
+#define SCHED_QUEUE_SIZE          10                                   /**< Maximum number of events in the scheduler queue. */
+
+static ble_uuid_t m_adv_uuids[] = {{PIXWATCH_UUID_SERVICE, BLE_UUID_TYPE_VENDOR_BEGIN}}; /**< Universally unique service identifiers. */
+
+/* Current Time */
+time_t current_time = 0;
+
+
+/**@brief Callback function for asserts in the SoftDevice.
+ *
+ * @details This function will be called in case of an assert in the SoftDevice.
+ *
+ * @warning This handler is an example only and does not fit a final product. You need to analyze
+ *          how your product is supposed to react in case of Assert.
+ * @warning On assert from the SoftDevice, the system can only recover on reset.
+ *
+ * @param[in] line_num  Line number of the failing ASSERT call.
+ * @param[in] file_name File name of the failing ASSERT call.
+ */
+void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
+{
+    app_error_handler(DEAD_BEEF, line_num, p_file_name);
+}
+
+
+#ifndef DEBUG
+/**@brief Function for handling errors, replacing the SDK handler.
+ *
+ * @details Records the error in the crash log, which is reported after the reset, and the time
+ *          into the current second, so that the clock restored after the reset keeps its phase.
+ */
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name)
+{
+    crash_log_app_error(error_code, line_num, p_file_name, (uint32_t)__builtin_return_address(0));
+    retained_reset_prepare(NRF_RTC1->COUNTER);
+    NVIC_SystemReset();
+}
+#endif
+
+
+/**@brief Function for handling the Current Time Service errors.
+ *
+ * @param[in]  nrf_error  Error code containing information about what went wrong.
+ */
+static void current_time_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
+
+
+/**@brief Function for handling UART errors.
+ *
+ * @param[in] nrf_error  Error code containing information about what went wrong.
+ */
+static void uart_error_handle(app_uart_evt_t * p_event)
+{
+    if (p_event->evt_type == APP_UART_COMMUNICATION_ERROR)
+    {
+        APP_ERROR_HANDLER(p_event->data.error_communication);
+    }
+    else if (p_event->evt_type == APP_UART_FIFO_ERROR)
+    {
+        APP_ERROR_HANDLER(p_event->data.error_code);
+    }
+    else
+    {
+        console_on_uart_evt(p_event);
+    }
+}
+
+
+/**@brief Function for finding the DB Discovery instance of a connection.
+ *
+ * @param[in] conn_handle  Connection handle, or BLE_CONN_HANDLE_INVALID to find a free instance.
+ *
+ * @return DB Discovery instance, or NULL if none matches.
+ */
+static ble_db_discovery_t * db_discovery_find(uint16_t conn_handle)
+{
+    uint32_t i;
+
+    for (i = 0; i < BLE_PIXWATCH_C_MAX_LINKS; i++)
+    {
+        if (m_ble_db_discovery[i].conn_handle == conn_handle)
+        {
+            return &m_ble_db_discovery[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for starting DB discovery on a link. */
+static void discovery_start(uint16_t conn_handle)
+{
+    ble_db_discovery_t * p_db_discovery = db_discovery_find(conn_handle);
+    uint32_t             err_code;
+
+    if (p_db_discovery != NULL)
+    {
+        err_code = ble_db_discovery_start(p_db_discovery, conn_handle);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for caching the PixWatch Service handles of the peer of a link. */
+static void pixwatch_handles_cache(ble_pixwatch_c_t const * p_pixwatch)
+{
+    ble_pixwatch_c_handles_t handles;
+    dm_handle_t              dm_handle;
+
+    dm_handle.appl_id = m_app_handle;
+    if (dm_handle_get(p_pixwatch->conn_handle, &dm_handle) == NRF_SUCCESS)
+    {
+        ble_pixwatch_c_handles_get(p_pixwatch, &handles);
+        retained_handles_set(dm_handle.device_id, &handles);
+    }
+}
+
+
+/**@brief Function for applying the state read from a phone. */
+static void pixwatch_state_apply(ble_pixwatch_c_state_t const * p_state)
+{
+    if (p_state->valid & (1 << BLE_PIXWATCH_C_FIELD_LOCAL_TIME))
+    {
+        current_time = p_state->local_time;
+    }
+    if (p_state->valid & (1 << BLE_PIXWATCH_C_FIELD_ALARMS))
+    {
+        // Kept for when the phone is away. Skipped if the store is busy; the next sync retries.
+        (void)settings_set(SETTINGS_KEY_ALARMS, p_state->alarms, sizeof(p_state->alarms));
+    }
+}
+
+
+/**@brief Function for applying the state read on cached handles, once discovery has found the
+ *        handles of the link. If the phone moved its characteristics, the values read are not
+ *        theirs: the state is read again.
+ */
+static void pixwatch_cached_sync_confirm(ble_pixwatch_c_t * p_pixwatch)
+{
+    cached_sync_t          * p_cached = &m_cached_sync[p_pixwatch - m_pixwatch];
+    ble_pixwatch_c_handles_t handles;
+
+    if (!p_cached->pending)
+    {
+        return;
+    }
+    p_cached->pending = false;
+
+    ble_pixwatch_c_handles_get(p_pixwatch, &handles);
+    if (memcmp(&handles, &p_cached->handles, sizeof(handles)) == 0)
+    {
+        pixwatch_state_apply(&p_cached->state);
+    }
+    else
+    {
+        DLOG_WARNING("Cached handles of link 0x%x are stale, syncing again.\n", p_pixwatch->conn_handle);
+        (void)ble_pixwatch_c_sync(p_pixwatch);
+    }
+}
+
+
+static void on_pixwatch_c_evt(ble_pixwatch_c_t * p_pixwatch, ble_pixwatch_c_evt_t * p_evt)
+{
+    uint8_t link = p_pixwatch - m_pixwatch;
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_PIXWATCH_C_EVT_DISCOVERY_COMPLETE:
+            DLOG_INFO("Current Time Service discovered on server.\n");
+            pixwatch_cached_sync_confirm(p_pixwatch);
+            pixwatch_handles_cache(p_pixwatch);
+            break;
+
+        case BLE_PIXWATCH_C_EVT_SERVICE_NOT_FOUND:
+            DLOG_WARNING("Current Time Service not found on server.\n");
+            m_cached_sync[link].pending = false;
+            break;
+
+        case BLE_PIXWATCH_C_EVT_DISCONN_COMPLETE:
+            DLOG_INFO("Disconnect Complete.\n");
+            break;
+
+        case BLE_PIXWATCH_C_EVT_LOCAL_TIME:
+            DLOG_INFO("Current Time received from link 0x%x.\n", p_evt->conn_handle);
+            current_time = p_evt->local_time;
+            break;
+
+        case BLE_PIXWATCH_C_EVT_STATE:
+            DLOG_INFO("State received from link 0x%x in %d request(s), fields 0x%x.\n",
+                      p_evt->conn_handle, p_evt->p_state->round_trips, p_evt->p_state->valid);
+            if (m_discovery_deferred[link])
+            {
+                // The sync ran on cached handles; its values wait for discovery to check them.
+                // Discovery also finds ANCS.
+                m_discovery_deferred[link]  = false;
+                m_cached_sync[link].pending = true;
+                m_cached_sync[link].state   = *p_evt->p_state;
+                discovery_start(p_evt->conn_handle);
+            }
+            else
+            {
+                pixwatch_state_apply(p_evt->p_state);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void pixwatch_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
+
+
+/**@brief Function for getting the local time used to timestamp iOS notifications. */
+static uint32_t local_time_get(void)
+{
+    return (uint32_t)current_time;
+}
+
+
+/**@brief Function for handling the Apple Notification Center Service client events.
+ *
+ * @param[in] p_evt  Event received from the ANCS client.
+ */
+static void on_ancs_c_evt(ble_ancs_c_evt_t * p_evt)
+{
+    ble_ancs_c_t * p_ancs;
+    uint32_t       err_code;
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_ANCS_C_EVT_DISCOVER_COMPLETE:
+            DLOG_INFO("Apple Notification Center Service discovered on server.\n");
+            p_ancs = ble_ancs_c_find(p_evt->conn_handle);
+            if (p_ancs == NULL)
+            {
+                break;
+            }
+            err_code = ble_ancs_c_notif_source_notif_enable(p_ancs);
+            APP_ERROR_CHECK(err_code);
+
+            err_code = ble_ancs_c_data_source_notif_enable(p_ancs);
+            APP_ERROR_CHECK(err_code);
+            break;
+
+        default:
+            ancs_notif_on_ancs_evt(p_evt);
+            break;
+    }
+}
+
+
+static void ancs_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
+
+
+/**@brief Function for handling the security request timer time-out.
+ *
+ * @details This function will be called each time the security request timer expires.
+ *
+ * @param[in] p_context  Pointer used for passing some arbitrary information (context) from the
+ *                       app_start_timer() call to the time-out handler.
+ */
+static void sec_req_timeout_handler(void * p_context)
+{
+    uint32_t             err_code;
+    dm_security_status_t status;
+    uint32_t             i;
+
+    for (i = 0; i < DEVICE_MANAGER_MAX_CONNECTIONS; i++)
+    {
+        if (!m_peer_connected[i])
+        {
+            continue;
+        }
+
+        err_code = dm_security_status_req(&m_peer_handles[i], &status);
+        APP_ERROR_CHECK(err_code);
+
+        // If the link is still not secured by the peer, initiate security procedure.
+        if (status == NOT_ENCRYPTED)
+        {
+            err_code = dm_security_setup_req(&m_peer_handles[i]);
+            APP_ERROR_CHECK(err_code);
+        }
+    }
+}
+
+
+/**@brief Function for counting the unread messages in the inbox. */
+static uint16_t unread_count_get(void)
+{
+    inbox_entry_t const * p_entry;
+    uint16_t              count = 0;
+    uint32_t              k;
+
+    for (k = 0; (p_entry = inbox_latest(k)) != NULL; k++)
+    {
+        if (p_entry->flags & INBOX_FLAG_UNREAD)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+
+/**@brief Function for updating the status field of the advertising packet.
+ *
+ * @details A payload the SoftDevice did not take is passed again on the next update.
+ */
+static void adv_status_update(void)
+{
+    uint32_t err_code = adv_payload_status_set(ADV_PAYLOAD_BATTERY_UNKNOWN, unread_count_get());
+
+    if (err_code != NRF_SUCCESS)
+    {
+        DLOG_WARNING("Advertising status not updated, error 0x%x.\n", err_code);
+    }
+}
+
+
+/**@brief Function for opening the newest unread message, which marks it as read. */
+static void message_open(void)
+{
+    inbox_entry_t const * p_entry;
+    uint32_t              err_code;
+    uint32_t              k;
+
+    for (k = 0; (p_entry = inbox_latest(k)) != NULL; k++)
+    {
+        if (p_entry->flags & INBOX_FLAG_UNREAD)
+        {
+            break;
+        }
+    }
+
+    if (p_entry == NULL)
+    {
+        DLOG_INFO("No unread message.\n");
+        return;
+    }
+
+    DLOG_INFO("Message 0x%x of %u bytes, received at %u.\n", p_entry->id, p_entry->length, p_entry->timestamp);
+
+    err_code = inbox_mark_read(k);
+    if (err_code != NRF_SUCCESS)
+    {
+        // Still unread; the next press opens it again.
+        DLOG_WARNING("Message 0x%x not marked as read, error 0x%x.\n", p_entry->id, err_code);
+        return;
+    }
+
+    adv_status_update();
+}
+
+
+static void button_handler(uint8_t pin_no, uint8_t button_action)
+{
+    crash_log_trace(CRASH_LOG_EVT_BUTTON, pin_no | (button_action << 8));
+
+    if(button_action == APP_BUTTON_PUSH)
+    {
+    	uint32_t err_code;
+    	uint32_t i;
+    	struct tm *t;
+    	app_uart_tx_stats_t uart_stats;
+
+        switch(pin_no)
+        {
+            case BUTTON_1:
+                for (i = 0; i < BLE_PIXWATCH_C_MAX_LINKS; i++)
+                {
+                    if (m_pixwatch[i].conn_handle == BLE_CONN_HANDLE_INVALID)
+                    {
+                        continue;
+                    }
+
+                    err_code = ble_pixwatch_c_sync(&m_pixwatch[i]);
+                    if (err_code == NRF_ERROR_NOT_FOUND)
+                    {
+                        DLOG_WARNING("Current Time Service is not discovered on link 0x%x.\r\n", m_pixwatch[i].conn_handle);
+                    }
+                }
+                break;
+
+            case BUTTON_2:
+            	t = localtime(&current_time);
+                DLOG_INFO("Local Time (Unix Time + Local Offset): %d\n", (int) current_time);
+                DLOG_INFO("Year: %d\n",   t->tm_year + 1900);
+                DLOG_INFO("Month: %d\n",   t->tm_mon + 1);
+                DLOG_INFO("Day: %d\n", t->tm_mday);
+                DLOG_INFO("Hour: %d\n",   t->tm_hour);
+                DLOG_INFO("Minute: %d\n",   t->tm_min);
+                DLOG_INFO("Second: %d\n", t->tm_sec);
+                DLOG_INFO("Day of Week: %d\n", t->tm_wday); // Sun=0, Mon=1, Tue=2, Wed=3, Thu=4, Fri=5, Sat=6
+                break;
+
+            case BUTTON_3:
+                app_uart_tx_stats_get(&uart_stats);
+                DLOG_INFO("UART TX: %u bytes in %u transfers.\n", uart_stats.bytes, uart_stats.transfers);
+                break;
+
+            case BUTTON_4:
+                message_open();
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+
+/**@brief Function for drawing the clock. Run between radio events, as it is a long SPI burst. */
+static void clock_draw(void)
+{
+	uint32_t spi_bytes = spiByteCount();
+	struct tm *t;
+
+	if (!m_display_ready)
+	{
+		return;
+	}
+
+	if (!m_clock_running)
+	{
+		// Nothing to show before the first link.
+		return;
+	}
+
+	t = localtime(&current_time);
+
+	putDigit(0, 0, t->tm_hour / 10, BLUE, BLACK);
+	putDigit(4, 0, t->tm_hour % 10, BLUE, BLACK);
+
+	putDigit(12, 0, t->tm_min / 10, BLUE, BLACK);
+	putDigit(16, 0, t->tm_min % 10, BLUE, BLACK);
+
+	putDigit(24, 0, t->tm_sec / 10, BLUE, BLACK);
+	putDigit(28, 0, t->tm_sec % 10, BLUE, BLACK);
+
+	m_frame_spi_bytes = spiByteCount() - spi_bytes;
+}
+
+
+/**@brief Function for recording the periodic history samples. */
+static void history_sample(void)
+{
+    int32_t temperature;
+
+    if (sd_temp_get(&temperature) == NRF_SUCCESS)
+    {
+        // A full block waiting for flash drops the sample; the gap shows in the timestamps.
+        (void)history_append(HISTORY_SERIES_TEMPERATURE, (uint32_t)current_time, temperature);
+    }
+}
+
+
+/**@brief Function for scaling the wakeups counted over some seconds to an hour.
+ *
+ * @return Wakeups per hour, at most UINT16_MAX, the range of the telemetry record. 0 if no time
+ *         passed.
+ */
+static uint32_t wakeups_per_hour(uint32_t wakeups, uint32_t seconds)
+{
+    uint64_t rate;
+
+    if (seconds == 0)
+    {
+        return 0;
+    }
+    rate = ((uint64_t)wakeups * 3600) / seconds;
+    return (uint32_t)MIN(rate, UINT16_MAX);
+}
+
+
+static void realtime_timer_handler(void * p_context)
+{
+	uint32_t i;
+	uint32_t clock;
+
+	m_uptime++;
+	if (m_clock_running)
+	{
+		current_time++;
+		retained_time_set((uint32_t)current_time, NRF_RTC1->COUNTER);
+	}
+
+	// Hours of the clock once it runs, so that they keep their phase across warm boots. An hour
+	// lasts at least a minute: a time sync that moves the clock does not end one as it begins.
+	clock = m_clock_running ? (uint32_t)current_time : m_uptime;
+	if (((clock % 3600) == 0) && ((m_uptime - m_hour_start) >= 60))
+	{
+		m_wakeups_last_hour = wakeups_per_hour(m_wakeups, m_uptime - m_hour_start);
+		m_wakeups           = 0;
+		m_hour_start        = m_uptime;
+		m_hour_done         = true;
+
+		// Hourly record to the phones that enabled telemetry notifications.
+		for (i = 0; i < BLE_PIXWATCH_C_MAX_LINKS; i++)
+		{
+			(void)ble_telemetry_notify(&m_telemetry, m_pixwatch[i].conn_handle);
+		}
+	}
+
+	// Only sent to the SoftDevice when the count changes.
+	adv_status_update();
+
+	if (!m_clock_running)
+	{
+		return;
+	}
+
+	if ((current_time % HISTORY_SAMPLE_INTERVAL) == 0)
+	{
+		history_sample();
+	}
+
+	APP_ERROR_CHECK(radio_sched_job_request(m_clock_draw_job_id));
+}
+
+
+/**@brief Function for converting microseconds to RTC1 ticks for app_timer_start(), rounding up. */
+static uint32_t us_to_ticks(uint32_t us)
+{
+    uint32_t ticks = (uint32_t)(((uint64_t)us * APP_TIMER_CLOCK_FREQ + 999999) /
+                                (1000000 * (APP_TIMER_PRESCALER + 1)));
+
+    return MAX(ticks, APP_TIMER_MIN_TIMEOUT_TICKS);
+}
+
+
+/**@brief Function for ending the boot log once both the first frame and advertising are done. */
+static void boot_finish(void)
+{
+    if ((boot_log_stage_get(BOOT_STAGE_FIRST_PIXEL) == BOOT_LOG_NONE) ||
+        (boot_log_stage_get(BOOT_STAGE_ADVERTISING) == BOOT_LOG_NONE))
+    {
+        return;
+    }
+
+    boot_log_stop();
+    DLOG_INFO("First pixel after %u us, %s boot.\n",
+              boot_log_stage_get(BOOT_STAGE_FIRST_PIXEL),
+              m_warm_boot ? "warm" : "cold");
+}
+
+
+/**@brief Function for the work deferred until the first frame is drawn. */
+static void deferred_init(void)
+{
+    crash_log_report_print();
+    boot_log_stamp(BOOT_STAGE_DEFERRED);
+}
+
+
+/**@brief Function for running the display start-up steps that are due on the boot clock.
+ *
+ * @return Microseconds until the next step is due, or 0 once the first frame is drawn.
+ */
+static uint32_t display_boot_step(void)
+{
+    uint32_t wait;
+
+    if (m_display_ready)
+    {
+        return 0;
+    }
+
+    wait = displayInitRun(boot_log_time_get());
+    if (wait != 0)
+    {
+        return wait;
+    }
+    boot_log_stamp(BOOT_STAGE_DISPLAY_READY);
+
+    // After a warm boot the restored clock is drawn; after a cold boot the screen stays black
+    // until the first time sync.
+    drawRectangle(0, 0, 127, 95, BLACK);
+    m_display_ready = true;
+    if (m_warm_boot)
+    {
+        clock_draw();
+    }
+    boot_log_stamp(BOOT_STAGE_FIRST_PIXEL);
+
+    deferred_init();
+    boot_finish();
+    return 0;
+}
+
+
+/**@brief Function for advancing the display start-up.
+ *
+ * @details The display init sequence waits out the reset pulse and the start-up time of the
+ *          controller with the display timer instead of busy delays, so the rest of the
+ *          initialization runs in the meantime. main() also calls this between initialization
+ *          steps, as the timer handler only runs once main() reaches the main loop. Each call runs
+ *          the steps that are due.
+ */
+static void display_boot_run(void)
+{
+    uint32_t wait;
+    uint32_t err_code;
+
+    wait = display_boot_step();
+    if (wait != 0)
+    {
+        // Ignored if the timer is already running; it then expires earlier and gets restarted.
+        err_code = app_timer_start(m_display_timer_id, us_to_ticks(wait), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for completing the display start-up, polling its steps on the boot clock. */
+static void display_boot_finish(void)
+{
+    uint32_t wait;
+
+    while ((wait = display_boot_step()) != 0)
+    {
+        nrf_delay_us(wait);
+    }
+}
+
+
+/**@brief Function for starting the low frequency crystal, running the display start-up while it
+ *        settles.
+ *
+ * @details sd_softdevice_enable() otherwise starts the crystal itself, and waits for it without
+ *          returning, some 250 ms after a power-on reset: the display timer could not tick then.
+ *          Started here, the wait polls the display steps on the boot clock, which covers both the
+ *          reset pulse and the start-up time of the controller. The SoftDevice then finds the
+ *          clock running. The crystal keeps running across the other resets.
+ */
+static void lfclk_start(void)
+{
+    uint32_t wait;
+
+    if (NRF_CLOCK->LFCLKSTAT & CLOCK_LFCLKSTAT_STATE_Msk)
+    {
+        return;
+    }
+
+    NRF_CLOCK->LFCLKSRC            = CLOCK_LFCLKSRC_SRC_Xtal << CLOCK_LFCLKSRC_SRC_Pos;
+    NRF_CLOCK->EVENTS_LFCLKSTARTED = 0;
+    NRF_CLOCK->TASKS_LFCLKSTART    = 1;
+    while (NRF_CLOCK->EVENTS_LFCLKSTARTED == 0)
+    {
+        wait = display_boot_step();
+        nrf_delay_us((wait == 0) ? LFCLK_POLL_INTERVAL : MIN(wait, LFCLK_POLL_INTERVAL));
+    }
+    NRF_CLOCK->EVENTS_LFCLKSTARTED = 0;
+}
+
+
+/**@brief Function for handling the display start-up timer timeout. */
+static void display_timer_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    display_boot_run();
+}
+
+
+/**@brief Function for the timer initialization.
+ *
+ * @details Initializes the timer module.
+ */
+static void timers_init(void)
+{
+    uint32_t err_code;
+
+    // Initialize timer module, making it use the scheduler
+    APP_TIMER_APPSH_INIT(APP_TIMER_PRESCALER, APP_TIMER_MAX_TIMERS, APP_TIMER_OP_QUEUE_SIZE, true);
+
+    // Create security request timer.
+    err_code = app_timer_create(&m_sec_req_timer_id, APP_TIMER_MODE_SINGLE_SHOT, sec_req_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+
+    // Create real-time timer.
+    err_code = app_timer_create(&m_realtime_timer_id, APP_TIMER_MODE_REPEATED, realtime_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    // Create display start-up timer.
+    err_code = app_timer_create(&m_display_timer_id, APP_TIMER_MODE_SINGLE_SHOT, display_timer_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for the GAP initialization.
+ *
+ * @details This function sets up all the necessary GAP (Generic Access Profile) parameters of the
+ *          device including the device name, appearance, and the preferred connection parameters.
+ */
+static void gap_params_init(void)
+{
+    uint32_t                err_code;
+    ble_gap_conn_params_t   gap_conn_params;
+    ble_gap_conn_sec_mode_t sec_mode;
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
+
+    err_code = sd_ble_gap_device_name_set(&sec_mode,
+                                          (const uint8_t *)DEVICE_NAME,
+                                          strlen(DEVICE_NAME));
+    APP_ERROR_CHECK(err_code);
+
+    // The prebuilt advertising payloads carry the same appearance.
+    err_code = sd_ble_gap_appearance_set(ADV_PAYLOAD_APPEARANCE);
+    APP_ERROR_CHECK(err_code);
+
+    memset(&gap_conn_params, 0, sizeof(gap_conn_params));
+
+    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
+    gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
+    gap_conn_params.slave_latency     = SLAVE_LATENCY;
+    gap_conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+
+    err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+
+/**@brief Function for counting the BLE events dispatched since reset.
+ *
+ * @param[out] p_cycles  CPU cycles spent handling them. May be NULL.
+ */
+static uint32_t ble_event_count(uint32_t * p_cycles)
+{
+    ble_dispatch_stats_t dispatch_stats;
+    uint32_t             count  = 0;
+    uint32_t             cycles = 0;
+    uint16_t             evt_id;
+
+    for (evt_id = BLE_DISPATCH_EVT_ID_MIN; evt_id <= BLE_DISPATCH_EVT_ID_MAX; evt_id++)
+    {
+        if (ble_dispatch_stats_get(evt_id, &dispatch_stats) == NRF_SUCCESS)
+        {
+            count  += dispatch_stats.count;
+            cycles += dispatch_stats.cycles;
+        }
+    }
+
+    if (p_cycles != NULL)
+    {
+        *p_cycles = cycles;
+    }
+    return count;
+}
+
+
+/**@brief Function for filling in a telemetry record with the current counters. */
+static void telemetry_collect(telemetry_record_t * p_record)
+{
+    asset_store_stats_t  store_stats;
+
+    p_record->reset_reason    = m_reset_reason;
+    p_record->sched_queue_hwm = app_sched_queue_utilization_get();
+    p_record->uptime          = m_uptime;
+
+    // Extrapolated from the hour so far until a full hour was counted.
+    p_record->wakeups_per_hour = m_hour_done ? m_wakeups_last_hour
+                                             : wakeups_per_hour(m_wakeups, m_uptime - m_hour_start);
+
+    p_record->spi_bytes_per_frame = m_frame_spi_bytes;
+
+    p_record->ble_events = ble_event_count(NULL);
+
+    asset_store_stats_get(&store_stats);
+    p_record->flash_ops = store_stats.stores + store_stats.page_erases;
+}
+
+
+/**@brief Function for initializing services that will be used by the application.
+ */
+static void services_init(void)
+{
+    uint32_t         err_code;
+    ble_pixwatch_c_init_t pixwatch_init_obj;
+    ble_ancs_c_init_t     ancs_init_obj;
+    ble_asset_init_t      asset_init_obj;
+    ble_telemetry_init_t  telemetry_init_obj;
+    uint8_t               crash_report[CRASH_LOG_REPORT_MAX];
+
+    uint8_t m_pixwatch_uuid_type;
+    ble_uuid_t service_uuid;
+
+    err_code = sd_ble_uuid_vs_add(&ble_pixwatch_base_uuid128, &m_pixwatch_uuid_type);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = sd_ble_uuid_vs_add(&ble_pixwatch_local_time_base_uuid128, &service_uuid.type);
+    APP_ERROR_CHECK(err_code);
+
+    pixwatch_init_obj.evt_handler   = on_pixwatch_c_evt;
+    pixwatch_init_obj.error_handler = pixwatch_error_handler;
+
+    err_code = ble_pixwatch_c_init(m_pixwatch, BLE_PIXWATCH_C_MAX_LINKS, &pixwatch_init_obj);
+    APP_ERROR_CHECK(err_code);
+
+    // The ANCS client registers its own vendor specific UUIDs, after the PixWatch ones.
+    memset(&ancs_init_obj, 0, sizeof(ancs_init_obj));
+    ancs_init_obj.evt_handler   = on_ancs_c_evt;
+    ancs_init_obj.error_handler = ancs_error_handler;
+
+    err_code = ble_ancs_c_init(m_ancs, BLE_PIXWATCH_C_MAX_LINKS, &ancs_init_obj);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = ancs_notif_init(local_time_get, ANCS_FETCH_TIMEOUT);
+    APP_ERROR_CHECK(err_code);
+
+    asset_init_obj.uuid_type = m_pixwatch_uuid_type;
+
+    err_code = ble_asset_init(&m_asset, &asset_init_obj);
+    APP_ERROR_CHECK(err_code);
+
+    telemetry_init_obj.uuid_type = m_pixwatch_uuid_type;
+    telemetry_init_obj.collect   = telemetry_collect;
+    telemetry_init_obj.p_crash   = crash_report;
+    telemetry_init_obj.crash_len = crash_log_report_encode(crash_report);
+
+    err_code = ble_telemetry_init(&m_telemetry, &telemetry_init_obj);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for handling the Connection Parameters module.
+ *
+ * @details This function will be called for all events in the Connection Parameters module that
+ *          are passed to the application.
+ *          @note All this function does is to disconnect. This could have been done by simply
+ *                setting the disconnect_on_fail config parameter, but instead we use the event
+ *                handler mechanism to demonstrate its use.
+ *
+ * @param[in] p_evt  Event received from the Connection Parameters module.
+ */
+static void on_conn_params_evt(ble_conn_params_evt_t * p_evt)
+{
+    uint32_t err_code;
+
+    if (p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
+    {
+        err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for handling a Connection Parameters error.
+ *
+ * @param[in]   nrf_error   Error code containing information about what went wrong.
+ */
+static void conn_params_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
+
+
+/**@brief Function for initializing the Connection Parameters module.
+ */
+static void conn_params_init(void)
+{
+    uint32_t               err_code;
+    ble_conn_params_init_t cp_init;
+
+    memset(&cp_init, 0, sizeof(cp_init));
+
+    cp_init.p_conn_params                  = NULL;
+    cp_init.first_conn_params_update_delay = FIRST_CONN_PARAMS_UPDATE_DELAY;
+    cp_init.next_conn_params_update_delay  = NEXT_CONN_PARAMS_UPDATE_DELAY;
+    cp_init.max_conn_params_update_count   = MAX_CONN_PARAMS_UPDATE_COUNT;
+    cp_init.start_on_notify_cccd_handle    = BLE_GATT_HANDLE_INVALID;
+    cp_init.disconnect_on_fail             = false;
+    cp_init.evt_handler                    = on_conn_params_evt;
+    cp_init.error_handler                  = conn_params_error_handler;
+
+    err_code = ble_conn_params_init(&cp_init);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for dispatching a system event to interested modules.
+ *
+ * @details This function is called from the system event interrupt handler after a system
+ *          event has been received.
+ *
+ * @param[in] sys_evt  System stack event.
+ */
+static void sys_evt_dispatch(uint32_t sys_evt)
+{
+    pstorage_sys_event_handler(sys_evt);
+    ble_advertising_on_sys_evt(sys_evt);
+}
+
+
+/**@brief Function for handling the Device Manager events.
+ *
+ * @param[in] p_evt  Data associated to the Device Manager event.
+ */
+static uint32_t device_manager_evt_handler(dm_handle_t const * p_handle,
+                                           dm_event_t const  * p_event,
+                                           ret_code_t        event_result)
+{
+    uint32_t err_code;
+
+    APP_ERROR_CHECK(event_result);
+
+    ble_ancs_c_on_device_manager_evt(p_handle, p_event);
+
+    switch (p_event->event_id)
+    {
+        case DM_EVT_CONNECTION:
+            m_peer_handles[p_handle->connection_id]   = (*p_handle);
+            m_peer_connected[p_handle->connection_id] = true;
+            err_code      = app_timer_start(m_sec_req_timer_id, SECURITY_REQUEST_DELAY, NULL);
+            APP_ERROR_CHECK(err_code);
+
+            // The clock runs from the first link on, for the phone to set it. The real-time timer
+            // already ticks from boot, for the uptime.
+            m_clock_running = true;
+            break;
+
+        case DM_EVT_DISCONNECTION:
+            m_peer_connected[p_handle->connection_id] = false;
+            break;
+
+        case DM_EVT_LINK_SECURED:
+        {
+            uint16_t                 conn_handle = p_event->event_param.p_gap_param->conn_handle;
+            ble_pixwatch_c_t       * p_pixwatch  = ble_pixwatch_c_find(conn_handle);
+            retained_state_t const * p_retained  = retained_get();
+
+            // A bonded peer seen before gets its state synced on the cached handles first, one
+            // discovery earlier. Discovery follows once the sync is done.
+            if ((p_pixwatch != NULL) &&
+                (p_retained->peer == p_handle->device_id) &&
+                (ble_pixwatch_c_handles_assign(p_pixwatch, &p_retained->handles) == NRF_SUCCESS) &&
+                (ble_pixwatch_c_sync(p_pixwatch) == NRF_SUCCESS))
+            {
+                m_discovery_deferred[p_pixwatch - m_pixwatch]  = true;
+                m_cached_sync[p_pixwatch - m_pixwatch].handles = p_retained->handles;
+                DLOG_INFO("State sync on cached handles, link 0x%x.\n", conn_handle);
+            }
+            else
+            {
+                discovery_start(conn_handle);
+            }
+            break;
+        }
+
+        default:
+            // No implementation needed.
+            break;
+
+    }
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for the Device Manager initialization.
+ *
+ * @param[in] erase_bonds  Indicates whether bonding information should be cleared from
+ *                         persistent storage during initialization of the Device Manager.
+ */
+static void device_manager_init(bool erase_bonds)
+{
+    uint32_t               err_code;
+    dm_init_param_t        init_param = {.clear_persistent_data = erase_bonds};
+    dm_application_param_t register_param;
+
+    // Initialize persistent storage module.
+    err_code = pstorage_init();
+    APP_ERROR_CHECK(err_code);
+
+    err_code = dm_init(&init_param);
+    APP_ERROR_CHECK(err_code);
+
+    memset(&register_param.sec_param, 0, sizeof(ble_gap_sec_params_t));
+
+    register_param.sec_param.bond         = SEC_PARAM_BOND;
+    register_param.sec_param.mitm         = SEC_PARAM_MITM;
+    register_param.sec_param.io_caps      = SEC_PARAM_IO_CAPABILITIES;
+    register_param.sec_param.oob          = SEC_PARAM_OOB;
+    register_param.sec_param.min_key_size = SEC_PARAM_MIN_KEY_SIZE;
+    register_param.sec_param.max_key_size = SEC_PARAM_MAX_KEY_SIZE;
+    register_param.evt_handler            = device_manager_evt_handler;
+    register_param.service_type           = DM_PROTOCOL_CNTXT_GATT_CLI_ID;
+
+    err_code = dm_register(&m_app_handle, &register_param);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for initializing the notification inbox.
+ *
+ * @details Must be called after device_manager_init(), which initializes pstorage.
+ */
+static void inbox_storage_init(void)
+{
+    uint32_t err_code = inbox_init(ancs_notif_on_inbox_append_done);
+
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for initializing the settings store. Registers after the inbox, so the pages of
+ *        the modules registered before keep their place.
+ */
+static void settings_storage_init(void)
+{
+    uint32_t err_code = settings_init();
+
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for initializing the history store. Registers after the settings store. */
+static void history_storage_init(void)
+{
+    uint32_t err_code = history_init();
+
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for putting the chip into sleep mode.
+ *
+ * @note This function will not return.
+ */
+static void sleep_mode_enter(void)
+{
+    // uint32_t err_code = bsp_indication_set(BSP_INDICATE_IDLE);
+    // APP_ERROR_CHECK(err_code);
+
+    // Prepare wakeup buttons.
+    // err_code = bsp_btn_ble_sleep_mode_prepare();
+    // APP_ERROR_CHECK(err_code);
+
+    // Go to system-off mode (this function will not return; wakeup will cause a reset).
+	uint32_t err_code = sd_power_system_off();
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for handling advertising events.
+ *
+ * @details This function will be called for advertising events which are passed to the application.
+ *
+ * @param[in] ble_adv_evt  Advertising event.
+ */
+static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
+{
+    uint32_t err_code;
+
+    crash_log_trace(CRASH_LOG_EVT_ADV, ble_adv_evt);
+    adv_policy_on_adv_evt(ble_adv_evt);
+
+    switch (ble_adv_evt)
+    {
+        case BLE_ADV_EVT_DIRECTED:
+            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_DIRECTED);
+            // APP_ERROR_CHECK(err_code);
+            break;
+        case BLE_ADV_EVT_FAST:
+            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING);
+            // APP_ERROR_CHECK(err_code);
+            err_code = adv_payload_select(ADV_PAYLOAD_DISCOVERABLE);
+            APP_ERROR_CHECK(err_code);
+            break;
+        case BLE_ADV_EVT_SLOW:
+            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_SLOW);
+            // APP_ERROR_CHECK(err_code);
+            err_code = adv_payload_select(ADV_PAYLOAD_DISCOVERABLE);
+            APP_ERROR_CHECK(err_code);
+            break;
+        case BLE_ADV_EVT_FAST_WHITELIST:
+            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_WHITELIST);
+            // APP_ERROR_CHECK(err_code);
+            err_code = adv_payload_select(ADV_PAYLOAD_WHITELIST);
+            APP_ERROR_CHECK(err_code);
+            break;
+        case BLE_ADV_EVT_SLOW_WHITELIST:
+            // err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING_WHITELIST);
+            // APP_ERROR_CHECK(err_code);
+            err_code = ble_advertising_restart_without_whitelist();
+            APP_ERROR_CHECK(err_code);
+            break;
+        case BLE_ADV_EVT_IDLE:
+            // sleep_mode_enter();
+            break;
+
+        case BLE_ADV_EVT_WHITELIST_REQUEST:
+        {
+            ble_gap_whitelist_t whitelist;
+            ble_gap_addr_t    * p_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+            ble_gap_irk_t     * p_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
+
+            whitelist.addr_count = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+            whitelist.irk_count  = BLE_GAP_WHITELIST_IRK_MAX_COUNT;
+            whitelist.pp_addrs   = p_whitelist_addr;
+            whitelist.pp_irks    = p_whitelist_irk;
+
+            err_code = dm_whitelist_create(&m_app_handle, &whitelist);
+            APP_ERROR_CHECK(err_code);
+
+            err_code = ble_advertising_whitelist_reply(&whitelist);
+            APP_ERROR_CHECK(err_code);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for handling the BLE stack events of the application itself.
+ *
+ * @param[in] p_ble_evt  Bluetooth stack event.
+ */
+static void on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+        {
+            uint32_t err_code;
+
+            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            m_link_count++;
+
+            // Keep advertising while there are free links, so a second central can connect
+            // without waiting for the first one to go away. The S132 SoftDevice this firmware is
+            // built against has a single peripheral link: it refuses connectable advertising while
+            // connected with NRF_ERROR_INVALID_STATE, and the second central only gets in on a
+            // SoftDevice with more peripheral links. The per-link modules do not depend on it.
+            if (m_link_count < BLE_PIXWATCH_C_MAX_LINKS)
+            {
+                err_code = adv_policy_start();
+                if (err_code != NRF_ERROR_INVALID_STATE)
+                {
+                    APP_ERROR_CHECK(err_code);
+                }
+            }
+            break;
+        }
+
+        case BLE_GAP_EVT_DISCONNECTED:
+        {
+            ble_pixwatch_c_t * p_pixwatch = ble_pixwatch_c_find(p_ble_evt->evt.gap_evt.conn_handle);
+
+            if (p_pixwatch != NULL)
+            {
+                // A sync or discovery left unfinished must not carry over to the next link.
+                m_discovery_deferred[p_pixwatch - m_pixwatch]  = false;
+                m_cached_sync[p_pixwatch - m_pixwatch].pending = false;
+            }
+            if (m_conn_handle == p_ble_evt->evt.gap_evt.conn_handle)
+            {
+                m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            }
+            if (m_link_count > 0)
+            {
+                m_link_count--;
+            }
+            break;
+        }
+
+        case BLE_GATTS_EVT_SYS_ATTR_MISSING:
+        {
+            uint32_t err_code;
+
+            // The Device Manager keeps the GATT client context only, so it has no CCCD values
+            // to apply: start the link with all notifications off. Until then, the phone's CCCD
+            // writes to the Asset Transfer and Telemetry services are held by the SoftDevice.
+            err_code = sd_ble_gatts_sys_attr_set(p_ble_evt->evt.gatts_evt.conn_handle, NULL, 0, 0);
+            APP_ERROR_CHECK(err_code);
+            break;
+        }
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+static void db_discovery_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_db_discovery_t * p_db_discovery;
+
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED)
+    {
+        // Assign a free instance to the new link.
+        p_db_discovery = db_discovery_find(BLE_CONN_HANDLE_INVALID);
+    }
+    else if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED)
+    {
+        p_db_discovery = db_discovery_find(p_ble_evt->evt.gap_evt.conn_handle);
+    }
+    else
+    {
+        p_db_discovery = db_discovery_find(p_ble_evt->evt.gattc_evt.conn_handle);
+    }
+
+    if (p_db_discovery != NULL)
+    {
+        ble_db_discovery_on_ble_evt(p_db_discovery, p_ble_evt);
+    }
+}
+
+
+static void pixwatch_c_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_pixwatch_c_on_ble_evt(p_ble_evt);
+}
+
+
+static void pixwatch_c_sync_resume(ble_evt_t * p_ble_evt)
+{
+    ble_pixwatch_c_sync_resume(p_ble_evt);
+}
+
+
+static void ancs_c_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_ancs_c_on_ble_evt(p_ble_evt);
+}
+
+
+static void ancs_notif_on_stack_evt(ble_evt_t * p_ble_evt)
+{
+    ancs_notif_on_ble_evt(p_ble_evt);
+}
+
+
+static void asset_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_asset_on_ble_evt(&m_asset, p_ble_evt);
+}
+
+
+static void telemetry_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_telemetry_on_ble_evt(&m_telemetry, p_ble_evt);
+}
+
+
+static void conn_params_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_conn_params_on_ble_evt(p_ble_evt);
+}
+
+
+static void adv_policy_on_stack_evt(ble_evt_t * p_ble_evt)
+{
+    adv_policy_on_ble_evt(p_ble_evt);
+}
+
+
+static void advertising_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_advertising_on_ble_evt(p_ble_evt);
+}
+
+
+/**@brief BLE event dispatch table. Each module is listed with the event IDs it consumes and is
+ *        called only for those, in table order.
+ */
+static const ble_dispatch_module_t m_ble_dispatch_table[] =
+{
+    BLE_DISPATCH_MODULE(dm_ble_evt_handler,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GAP_EVT_SEC_INFO_REQUEST,
+                        BLE_GAP_EVT_SEC_PARAMS_REQUEST,
+                        BLE_GAP_EVT_AUTH_STATUS,
+                        BLE_GAP_EVT_CONN_SEC_UPDATE,
+                        BLE_GATTS_EVT_SYS_ATTR_MISSING,
+                        BLE_GAP_EVT_SEC_REQUEST),
+    BLE_DISPATCH_MODULE(db_discovery_on_ble_evt,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP,
+                        BLE_GATTC_EVT_CHAR_DISC_RSP,
+                        BLE_GATTC_EVT_DESC_DISC_RSP),
+    BLE_DISPATCH_MODULE(adv_policy_on_stack_evt,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED),
+    BLE_DISPATCH_MODULE(on_ble_evt,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GATTS_EVT_SYS_ATTR_MISSING),
+    BLE_DISPATCH_MODULE(conn_params_on_ble_evt,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GATTS_EVT_WRITE,
+                        BLE_GAP_EVT_CONN_PARAM_UPDATE),
+    BLE_DISPATCH_MODULE(pixwatch_c_on_ble_evt,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GATTC_EVT_READ_RSP,
+                        BLE_GATTC_EVT_CHAR_VALS_READ_RSP),
+    BLE_DISPATCH_MODULE(ancs_c_on_ble_evt,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GATTC_EVT_WRITE_RSP,
+                        BLE_GATTC_EVT_HVX),
+    BLE_DISPATCH_MODULE(ancs_notif_on_stack_evt,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GATTC_EVT_WRITE_RSP),
+    BLE_DISPATCH_MODULE(asset_on_ble_evt,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GATTS_EVT_WRITE,
+                        BLE_EVT_TX_COMPLETE),
+    BLE_DISPATCH_MODULE(telemetry_on_ble_evt,
+                        BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST,
+                        BLE_GATTS_EVT_WRITE),
+    // After the other GATT clients, which keep the client of the link if they have more to send.
+    BLE_DISPATCH_MODULE(pixwatch_c_sync_resume,
+                        BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP,
+                        BLE_GATTC_EVT_CHAR_DISC_RSP,
+                        BLE_GATTC_EVT_DESC_DISC_RSP,
+                        BLE_GATTC_EVT_READ_RSP,
+                        BLE_GATTC_EVT_CHAR_VALS_READ_RSP,
+                        BLE_GATTC_EVT_WRITE_RSP,
+                        BLE_GATTC_EVT_TIMEOUT),
+    BLE_DISPATCH_MODULE(advertising_on_ble_evt,
+                        BLE_GAP_EVT_CONNECTED,
+                        BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GAP_EVT_TIMEOUT),
+};
+
+
+/**@brief Function for dispatching a BLE stack event to the modules subscribed to it.
+ *
+ * @details This function is called from the scheduler in the main loop after a BLE stack
+ *          event has been received.
+ *
+ * @param[in] p_ble_evt  Bluetooth stack event.
+ */
+static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
+{
+    // All BLE events of this SoftDevice version carry the connection handle first.
+    crash_log_trace(CRASH_LOG_EVT_BLE, p_ble_evt->header.evt_id | (p_ble_evt->evt.gap_evt.conn_handle << 16));
+    ble_dispatch_on_ble_evt(p_ble_evt);
+}
+
+
+/**@brief Function for initializing the BLE stack.
+ *
+ * @details Initializes the SoftDevice and the BLE event interrupt.
+ */
+static void ble_stack_init(void)
+{
+    uint32_t err_code;
+
+    // Initialize the SoftDevice handler module.
+    SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_XTAL_20_PPM, NULL);
+
+#if defined(S110) || defined(S130) || defined(S132)
+    // Enable BLE stack
+    ble_enable_params_t ble_enable_params;
+    memset(&ble_enable_params, 0, sizeof(ble_enable_params));
+#if (defined(S130) || defined(S132))
+    ble_enable_params.gatts_enable_params.attr_tab_size   = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT;
+#endif
+    ble_enable_params.gatts_enable_params.service_changed = IS_SRVC_CHANGED_CHARACT_PRESENT;
+    err_code = sd_ble_enable(&ble_enable_params);
+    APP_ERROR_CHECK(err_code);
+#endif
+
+    err_code = ble_dispatch_init(m_ble_dispatch_table,
+                                 sizeof(m_ble_dispatch_table) / sizeof(m_ble_dispatch_table[0]));
+    APP_ERROR_CHECK(err_code);
+
+    // Register with the SoftDevice handler module for BLE events.
+    err_code = softdevice_ble_evt_handler_set(ble_evt_dispatch);
+    APP_ERROR_CHECK(err_code);
+
+    // Register with the SoftDevice handler module for BLE events.
+    err_code = softdevice_sys_evt_handler_set(sys_evt_dispatch);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for the Event Scheduler initialization.
+ */
+static void scheduler_init(void)
+{
+    APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
+}
+
+
+/**@brief Function for initializing the scheduling of display updates between radio events. */
+static void radio_sched_setup(void)
+{
+    uint32_t err_code;
+
+    err_code = radio_sched_init(NRF_RADIO_NOTIFICATION_DISTANCE_800US);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = radio_sched_job_create(&m_clock_draw_job_id, clock_draw);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for initializing the advertising functionality.
+ *
+ * @details Encodes the required advertising data and passes it to the stack.
+ *          Also builds a structure to be passed to the stack when starting advertising.
+ */
+static void advertising_init()
+{
+    uint32_t      err_code;
+    ble_advdata_t advdata;
+    ble_advdata_t scanrsp;
+
+    // Build and set advertising data
+    memset(&advdata, 0, sizeof(advdata));
+
+    advdata.name_type                = BLE_ADVDATA_FULL_NAME;
+    advdata.include_appearance       = true;
+    advdata.flags                    = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
+
+    memset(&scanrsp, 0, sizeof(scanrsp));
+    scanrsp.uuids_solicited.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
+    scanrsp.uuids_solicited.p_uuids  = m_adv_uuids;
+
+    // The advertising packet is replaced by a prebuilt adv_payload on every BLE_ADV_EVT_*.
+    adv_payload_init();
+
+    ble_adv_modes_config_t options    = {0};
+    options.ble_adv_whitelist_enabled = BLE_ADV_WHITELIST_ENABLED;
+    options.ble_adv_fast_enabled      = BLE_ADV_FAST_ENABLED;
+    options.ble_adv_fast_interval     = APP_ADV_FAST_INTERVAL;
+    options.ble_adv_fast_timeout      = APP_ADV_FAST_TIMEOUT;
+    options.ble_adv_slow_enabled      = BLE_ADV_SLOW_ENABLED;
+    options.ble_adv_slow_interval     = APP_ADV_SLOW_INTERVAL;
+    options.ble_adv_slow_timeout      = APP_ADV_SLOW_TIMEOUT;
+
+    err_code = ble_advertising_init(&advdata, &scanrsp, &options, on_adv_evt, NULL);
+    APP_ERROR_CHECK(err_code);
+
+    // The fast and slow time-outs above only apply until the policy has a reconnect history.
+    adv_policy_init(&options);
+}
+
+
+static void buttons_init(void) {
+	uint32_t err_code;
+
+	static app_button_cfg_t p_button[] = {
+			{BUTTON_1, false, NRF_GPIO_PIN_PULLUP, button_handler},
+	        {BUTTON_2, false, NRF_GPIO_PIN_PULLUP, button_handler},
+	        {BUTTON_3, false, NRF_GPIO_PIN_PULLUP, button_handler},
+	        {BUTTON_4, false, NRF_GPIO_PIN_PULLUP, button_handler}
+	};
+
+    err_code = app_button_init(p_button, sizeof(p_button) / sizeof(p_button[0]), BUTTON_DEBOUNCE_DELAY);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_button_enable();
+    APP_ERROR_CHECK(err_code);
+}
+
+/**@brief Function for converting RTC1 ticks to milliseconds. */
+static uint32_t ticks_to_ms(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000 * (APP_TIMER_PRESCALER + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+/**@brief Function for reading the RTC1 counter. */
+static uint32_t ticks_get(void)
+{
+    uint32_t ticks;
+
+    (void)app_timer_cnt_get(&ticks);
+    return ticks;
+}
+
+
+/**@brief Counters at the start of a profiling window. */
+static struct
+{
+    bool     active;
+    uint32_t ticks;
+    uint32_t wakeups;
+    uint32_t ble_events;
+    uint32_t ble_cycles;
+    uint32_t spi_bytes;
+    uint32_t log_frames;
+    uint32_t uart_bytes;
+} m_profile;
+
+
+/**@brief Function for reading the counters of a profiling window. The ticks are read last, so
+ *        they cover the other counters.
+ */
+static void profile_counters_get(uint32_t * p_wakeups,
+                                 uint32_t * p_ble_events,
+                                 uint32_t * p_ble_cycles,
+                                 uint32_t * p_spi_bytes,
+                                 uint32_t * p_log_frames,
+                                 uint32_t * p_uart_bytes,
+                                 uint32_t * p_ticks)
+{
+    dlog_stats_t        log_stats;
+    app_uart_tx_stats_t uart_stats;
+
+    dlog_stats_get(&log_stats);
+    app_uart_tx_stats_get(&uart_stats);
+
+    *p_wakeups    = m_wakeups_total;
+    *p_ble_events = ble_event_count(p_ble_cycles);
+    *p_spi_bytes  = spiByteCount();
+    *p_log_frames = log_stats.frames;
+    *p_uart_bytes = uart_stats.bytes;
+    *p_ticks      = ticks_get();
+}
+
+
+static void cmd_sched(uint8_t argc, char * argv[])
+{
+    DLOG_INFO("Scheduler queue: %u of %u free, %u max used.\n",
+              app_sched_queue_space_get(), SCHED_QUEUE_SIZE, app_sched_queue_utilization_get());
+}
+
+
+static void cmd_timers(uint8_t argc, char * argv[])
+{
+    app_timer_info_t info;
+    app_timer_id_t   id;
+
+    for (id = 0; id < APP_TIMER_MAX_TIMERS; id++)
+    {
+        if (app_timer_info_get(id, &info) != NRF_SUCCESS)
+        {
+            continue;
+        }
+
+        if (!info.is_running)
+        {
+            DLOG_INFO("Timer %u: handler 0x%x, stopped.\n", id, (uint32_t)info.p_timeout_handler);
+        }
+        else
+        {
+            DLOG_INFO("Timer %u: handler 0x%x, expires in %u ms, period %u ms.\n",
+                      id,
+                      (uint32_t)info.p_timeout_handler,
+                      ticks_to_ms(info.ticks_to_expire),
+                      (info.mode == APP_TIMER_MODE_REPEATED) ? ticks_to_ms(info.ticks_periodic_interval) : 0);
+        }
+    }
+}
+
+
+static void cmd_spi(uint8_t argc, char * argv[])
+{
+    DLOG_INFO("SPI: %u bytes since reset, %u bytes in the last clock redraw.\n",
+              spiByteCount(), m_frame_spi_bytes);
+}
+
+
+static void cmd_flash(uint8_t argc, char * argv[])
+{
+    asset_store_stats_t store_stats;
+    pstorage_stats_t    pstorage_stats;
+
+    asset_store_stats_get(&store_stats);
+    pstorage_stats_get(&pstorage_stats);
+
+    DLOG_INFO("Asset store: %u of %u bytes free, %u bytes stored.\n",
+              asset_store_free_space(), asset_store_max_length(), store_stats.bytes_stored);
+    DLOG_INFO("Asset store: %u stores, %u page erases, %u stalls.\n",
+              store_stats.stores, store_stats.page_erases, store_stats.stalls);
+    DLOG_INFO("pstorage: %u commands, %u flash writes, %u page erases, %u busy retries.\n",
+              pstorage_stats.commands, pstorage_stats.flash_writes, pstorage_stats.flash_erases,
+              pstorage_stats.busy_retries);
+    DLOG_INFO("pstorage: %u stores merged, %u commands superseded.\n",
+              pstorage_stats.merged, pstorage_stats.superseded);
+    DLOG_INFO("pstorage: %u flash errors, queue high-water mark %u.\n",
+              pstorage_stats.flash_errors, pstorage_stats.queue_hwm);
+}
+
+
+static void cmd_prof(uint8_t argc, char * argv[])
+{
+    uint32_t wakeups;
+    uint32_t ble_events;
+    uint32_t ble_cycles;
+    uint32_t spi_bytes;
+    uint32_t log_frames;
+    uint32_t uart_bytes;
+    uint32_t ticks;
+
+    if ((argc == 2) && (strcmp(argv[1], "start") == 0))
+    {
+        profile_counters_get(&m_profile.wakeups,
+                             &m_profile.ble_events,
+                             &m_profile.ble_cycles,
+                             &m_profile.spi_bytes,
+                             &m_profile.log_frames,
+                             &m_profile.uart_bytes,
+                             &m_profile.ticks);
+        m_profile.active = true;
+        DLOG_INFO("Profiling started.\n");
+    }
+    else if ((argc == 2) && (strcmp(argv[1], "stop") == 0) && m_profile.active)
+    {
+        profile_counters_get(&wakeups, &ble_events, &ble_cycles, &spi_bytes, &log_frames, &uart_bytes, &ticks);
+        m_profile.active = false;
+
+        (void)app_timer_cnt_diff_compute(ticks, m_profile.ticks, &ticks);
+        DLOG_INFO("Profile: %u ms, %u wakeups.\n", ticks_to_ms(ticks), wakeups - m_profile.wakeups);
+        DLOG_INFO("Profile: %u BLE events, %u cycles in their handlers.\n",
+                  ble_events - m_profile.ble_events, ble_cycles - m_profile.ble_cycles);
+        DLOG_INFO("Profile: %u SPI bytes, %u log frames, %u UART bytes.\n",
+                  spi_bytes - m_profile.spi_bytes, log_frames - m_profile.log_frames, uart_bytes - m_profile.uart_bytes);
+    }
+    else
+    {
+        DLOG_WARNING("Usage: prof start, then prof stop.\n");
+    }
+}
+
+
+static void cmd_bench(uint8_t argc, char * argv[])
+{
+    uint32_t fills = (argc > 1) ? strtoul(argv[1], NULL, 0) : 4;
+    uint32_t spi_bytes;
+    uint32_t start;
+    uint32_t ticks;
+    uint32_t ms;
+    uint32_t i;
+
+    fills     = MAX(1, MIN(fills, 32));
+    spi_bytes = spiByteCount();
+    start     = ticks_get();
+
+    for (i = 0; i < fills; i++)
+    {
+        drawRectangle(0, 0, 127, 95, (i & 1) ? BLACK : WHITE);
+    }
+
+    (void)app_timer_cnt_diff_compute(ticks_get(), start, &ticks);
+    spi_bytes = spiByteCount() - spi_bytes;
+    ms        = MAX(ticks_to_ms(ticks), 1);
+
+    DLOG_INFO("Display: %u fills in %u ms, %u bytes, %u kbit/s.\n", fills, ms, spi_bytes, (spi_bytes * 8) / ms);
+
+    drawRectangle(0, 0, 127, 95, BLACK);
+    clock_draw();
+}
+
+
+static void cmd_log(uint8_t argc, char * argv[])
+{
+    if ((argc != 3) ||
+        (dlog_level_set((dlog_module_t)strtoul(argv[1], NULL, 0), strtoul(argv[2], NULL, 0)) != NRF_SUCCESS))
+    {
+        DLOG_WARNING("Usage: log <module> <level>, module 0 to %u, level 0 to %u.\n",
+                     DLOG_MODULE_COUNT - 1, DLOG_LEVEL_DEBUG);
+    }
+}
+
+
+static void cmd_boot(uint8_t argc, char * argv[])
+{
+    DLOG_INFO("%s boot, reset reason 0x%x.\n", m_warm_boot ? "Warm" : "Cold", m_reset_reason);
+    boot_log_print();
+}
+
+
+static void cmd_settings(uint8_t argc, char * argv[])
+{
+    settings_stats_t stats;
+
+    settings_stats_get(&stats);
+
+    DLOG_INFO("Settings: %u sets, %u failed, %u flash bytes, %u page erases.\n",
+              stats.sets, stats.failed, stats.flash_bytes, stats.page_erases);
+    DLOG_INFO("Settings: %u collections, %u records copied.\n", stats.gc_runs, stats.gc_copies);
+    DLOG_INFO("Settings: boot rebuild found %u records, %u torn, in %u cycles.\n",
+              stats.recovered, stats.torn, stats.rebuild_cycles);
+}
+
+
+static void cmd_set(uint8_t argc, char * argv[])
+{
+    uint32_t value;
+    uint32_t err_code;
+
+    if (argc != 3)
+    {
+        DLOG_WARNING("Usage: set <key> <value>.\n");
+        return;
+    }
+
+    value    = strtoul(argv[2], NULL, 0);
+    err_code = settings_set(strtoul(argv[1], NULL, 0), &value, sizeof(value));
+    if (err_code != NRF_SUCCESS)
+    {
+        DLOG_WARNING("Set failed, error 0x%x.\n", err_code);
+    }
+}
+
+
+static void cmd_get(uint8_t argc, char * argv[])
+{
+    uint8_t  value[SETTINGS_VALUE_MAX_LEN];
+    uint8_t  length = sizeof(value);
+    uint32_t word   = 0;
+    uint32_t err_code;
+
+    if (argc != 2)
+    {
+        DLOG_WARNING("Usage: get <key>.\n");
+        return;
+    }
+
+    err_code = settings_get(strtoul(argv[1], NULL, 0), value, &length);
+    if (err_code != NRF_SUCCESS)
+    {
+        DLOG_WARNING("Get failed, error 0x%x.\n", err_code);
+        return;
+    }
+
+    memcpy(&word, value, MIN(length, sizeof(word)));
+    DLOG_INFO("Value: %u bytes, first word 0x%x.\n", length, word);
+}
+
+
+static void cmd_history(uint8_t argc, char * argv[])
+{
+    history_stats_t   stats;
+    history_summary_t summary;
+    uint32_t          minutes = (argc > 1) ? strtoul(argv[1], NULL, 0) : 60;
+    uint32_t          now     = (uint32_t)current_time;
+
+    history_stats_get(&stats);
+    DLOG_INFO("History: %u samples, %u dropped, %u blocks, %u page erases.\n",
+              stats.samples, stats.dropped, stats.blocks, stats.page_erases);
+    DLOG_INFO("History: %u encoded bytes, %u failed.\n", stats.encoded, stats.failed);
+
+    history_summary_get(HISTORY_SERIES_TEMPERATURE, now - MIN(minutes * 60, now), now, &summary);
+    if (summary.count > 0)
+    {
+        DLOG_INFO("Temperature: %u samples, min %d, max %d (0.25 C).\n", summary.count, summary.min, summary.max);
+    }
+}
+
+
+static void cmd_stats(uint8_t argc, char * argv[])
+{
+    radio_sched_stats_t       radio_stats;
+    inbox_stats_t             inbox_stats;
+    ancs_notif_stats_t        ancs_stats;
+    ble_asset_stats_t const * p_asset_stats = &m_asset.stats;
+
+    radio_sched_stats_get(&radio_stats);
+    inbox_stats_get(&inbox_stats);
+    ancs_notif_stats_get(&ancs_stats);
+
+    // The active time is short: converted with a scale of 1000, to microseconds.
+    DLOG_INFO("Radio: %u events, period %u ms, active %u us.\n",
+              radio_stats.radio_events, ticks_to_ms(radio_stats.period),
+              ticks_to_ms(radio_stats.active_time * 1000));
+    DLOG_INFO("Radio: %u job requests, %u runs, %u collisions avoided, %u overruns.\n",
+              radio_stats.requests, radio_stats.runs, radio_stats.collisions_avoided, radio_stats.overruns);
+    DLOG_INFO("Inbox: %u appended, %u dropped, %u payload bytes, %u flash bytes, %u page erases.\n",
+              inbox_stats.appended, inbox_stats.dropped, inbox_stats.payload_bytes, inbox_stats.flash_bytes,
+              inbox_stats.page_erases);
+    DLOG_INFO("Inbox: boot rebuild found %u messages, %u torn.\n", inbox_stats.recovered, inbox_stats.torn);
+    DLOG_INFO("ANCS: %u notifications, %u dropped, %u timeouts, %u control point writes (%u last).\n",
+              ancs_stats.notifications, ancs_stats.dropped, ancs_stats.timeouts, ancs_stats.gatt_ops,
+              ancs_stats.last_gatt_ops);
+    DLOG_INFO("ANCS: app names %u cached, %u requested; %u waited for the inbox.\n",
+              ancs_stats.cache_hits, ancs_stats.cache_misses, ancs_stats.deferred);
+    DLOG_INFO("Asset: %u chunks, %u out of sequence, %u credits, %u notifications deferred.\n",
+              p_asset_stats->chunks, p_asset_stats->out_of_sequence, p_asset_stats->credits_sent,
+              p_asset_stats->notify_deferred);
+    DLOG_INFO("Asset: %u compressed bytes, %u decoded, %u decoder cycles.\n",
+              p_asset_stats->compressed_bytes, p_asset_stats->decoded_bytes, p_asset_stats->decode_cycles);
+}
+
+
+static void cmd_adv(uint8_t argc, char * argv[])
+{
+    adv_policy_stats_t stats;
+
+    adv_policy_stats_get(&stats);
+    DLOG_INFO("Advertising: %u reconnects, average %u s, predicted %u s.\n",
+              stats.reconnects, stats.latency_avg, stats.latency_predicted);
+    DLOG_INFO("Advertising: %u s fast, %u s slow, %u events, about %u uC.\n",
+              stats.fast_seconds, stats.slow_seconds, stats.adv_events, stats.charge_uc);
+}
+
+
+/**@brief Console commands. */
+static const console_cmd_t m_console_cmds[] =
+{
+    {"sched",    "scheduler queue state.",                            cmd_sched},
+    {"timers",   "application timers.",                               cmd_timers},
+    {"spi",      "display SPI byte counts.",                          cmd_spi},
+    {"flash",    "asset store usage and pstorage counters.",          cmd_flash},
+    {"prof",     "prof start|stop: counters over a time window.",     cmd_prof},
+    {"bench",    "bench [n]: time n full screen fills (default 4).",  cmd_bench},
+    {"log",      "log <module> <level>: set a runtime log level.",    cmd_log},
+    {"settings", "settings store statistics.",                        cmd_settings},
+    {"set",      "set <key> <value>: store a 32-bit setting.",        cmd_set},
+    {"get",      "get <key>: read a setting.",                        cmd_get},
+    {"history",  "history [m]: temperature range over m minutes.",    cmd_history},
+    {"stats",    "radio scheduler, inbox, ANCS and asset counters.",  cmd_stats},
+    {"adv",      "advertising policy: reconnect times and energy.",   cmd_adv},
+    {"boot",     "boot stage times of this run.",                     cmd_boot},
+};
+
+
+/**@brief Function for initializing the UART.
+ */
+static void uart_init(void)
+{
+    uint32_t                     err_code;
+    const app_uart_comm_params_t comm_params =
+    {
+        RX_PIN_NUMBER,
+        TX_PIN_NUMBER,
+        0xFF, // UART_PIN_DISCONNECTED
+        0xFF, // UART_PIN_DISCONNECTED
+        APP_UART_FLOW_CONTROL_DISABLED,
+        false,
+        UARTE_BAUDRATE_BAUDRATE_Baud115200 // UARTE (EasyDMA) register value, see nrf_drv_config.h.
+    };
+
+    APP_UART_FIFO_INIT(&comm_params,
+                       UART_RX_BUF_SIZE,
+                       UART_TX_BUF_SIZE,
+                       uart_error_handle,
+                       APP_IRQ_PRIORITY_LOW,
+                       err_code);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**
+ * @brief Database discovery collector initialization.
+ */
+static void db_discovery_init(void)
+{
+    uint32_t i;
+    uint32_t err_code = ble_db_discovery_init();
+
+    APP_ERROR_CHECK(err_code);
+
+    // Mark all instances free; a zeroed instance would otherwise claim connection handle 0.
+    for (i = 0; i < BLE_PIXWATCH_C_MAX_LINKS; i++)
+    {
+        m_ble_db_discovery[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+}
+
+
+/**@brief Function for the power manager.
+ */
+static void power_manage(void)
+{
+    uint32_t err_code = sd_app_evt_wait();
+
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for starting the real-time timer, and restoring the clock after a warm boot.
+ *
+ * @details The timer counts the uptime from boot, and the clock once it runs. It runs from here
+ *          on, whatever the links do: starting it again would move the phase of the seconds. It
+ *          ticks once the SoftDevice starts the low frequency clock.
+ */
+static void realtime_start(void)
+{
+    uint32_t err_code;
+
+    // A warm boot before the clock ever ran has nothing to restore.
+    if (m_warm_boot && (retained_get()->time != 0))
+    {
+        current_time    = retained_time_restore(retained_get());
+        m_clock_running = true;
+    }
+
+    err_code = app_timer_start(m_realtime_timer_id, REALTIME_CLOCK_INTERVAL, NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for application main entry.
+ */
+int main(void)
+{
+    uint32_t err_code;
+    bool     erase_bonds = false;
+
+    boot_log_start();
+
+    // RESETREAS accumulates across resets until cleared; keep this boot's reason for telemetry.
+    m_reset_reason       = NRF_POWER->RESETREAS;
+    NRF_POWER->RESETREAS = m_reset_reason;
+    crash_log_init(m_reset_reason, &m_uptime);
+    m_warm_boot = retained_init(m_reset_reason);
+
+    // The display reset pulse runs while the rest is initialized; display_boot_run() and the
+    // crystal wait in lfclk_start() take the init sequence further whenever its delays are over,
+    // and draw the first frame.
+    spi_master_init();
+    displayInitStart(boot_log_time_get());
+    (void)displayInitRun(boot_log_time_get());
+
+    // Initialize
+    app_trace_init();
+    dlog_init();
+    scheduler_init();
+    timers_init();
+    realtime_start();
+    boot_log_stamp(BOOT_STAGE_TIMERS);
+    display_boot_run();
+
+    buttons_init();
+    uart_init();
+    console_init(m_console_cmds, sizeof(m_console_cmds) / sizeof(m_console_cmds[0]));
+    DLOG_INFO("PixWatch Starting!\n");
+    lfclk_start();
+    if (m_warm_boot)
+    {
+        // The restored clock goes on screen first; the BLE, storage and service init follow.
+        display_boot_finish();
+    }
+    ble_stack_init();
+    boot_log_stamp(BOOT_STAGE_BLE_STACK);
+    display_boot_run();
+
+    device_manager_init(erase_bonds);
+    inbox_storage_init();
+    settings_storage_init();
+    history_storage_init();
+    boot_log_stamp(BOOT_STAGE_STORAGE);
+    display_boot_run();
+
+    db_discovery_init();
+    radio_sched_setup();
+    gap_params_init();
+    services_init();
+    advertising_init();
+    conn_params_init();
+    boot_log_stamp(BOOT_STAGE_SERVICES);
+    display_boot_run();
+
+    // Start execution
+    err_code = adv_policy_start();
+    APP_ERROR_CHECK(err_code);
+    DLOG_INFO("Advertising Started!\n");
+    boot_log_stamp(BOOT_STAGE_ADVERTISING);
+    boot_finish();
+
+    // Enter main loop
+    for (;;)
+    {
+        app_sched_execute();
+        dlog_flush();
+        power_manage();
+        m_wakeups++;
+        m_wakeups_total++;
+    }
+}
+
+
+/**
+ * @}
+ */
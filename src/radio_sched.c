@@ -0,0 +1,268 @@
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_timer.h"
+#include "app_scheduler.h"
+#include "app_util_platform.h"
+#include "ble_radio_notification.h"
+#include "radio_sched.h"
+
+
+/**@brief Job control block. */
+typedef struct
+{
+    radio_sched_job_handler_t handler;   /**< Work to run. */
+    uint32_t                  duration;  /**< Run time of the last run, in RTC1 ticks. */
+    bool                      deferred;  /**< The pending request has been counted as postponed. */
+} job_t;
+
+static job_t               m_jobs[RADIO_SCHED_MAX_JOBS];
+static uint8_t             m_job_count;
+static volatile uint8_t    m_pending;        /**< Bitmask of jobs requested but not run yet. */
+static volatile bool       m_run_posted;     /**< A jobs_run event is in the scheduler queue. */
+static volatile bool       m_radio_active;   /**< Between the active and inactive notifications. */
+static volatile bool       m_window_fresh;   /**< No job has run since the last radio event ended. */
+static volatile uint32_t   m_active_start;   /**< RTC1 counter at the last active notification. */
+static app_timer_id_t      m_retry_timer_id; /**< Posts jobs_run again while jobs wait for a window. */
+static volatile bool       m_retry_armed;
+static radio_sched_stats_t m_stats;
+
+
+static uint32_t ticks_since(uint32_t from)
+{
+    uint32_t now;
+    uint32_t diff;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, from, &diff);
+
+    return diff;
+}
+
+
+/**@brief Function for checking whether a job can run now without overlapping a radio event. */
+static bool window_fits(uint32_t duration, bool window_fresh)
+{
+    uint32_t period      = m_stats.period;
+    uint32_t active_time = m_stats.active_time;
+    uint32_t elapsed;
+
+    if (m_radio_active)
+    {
+        return false;
+    }
+    if (period == 0)
+    {
+        return true;
+    }
+
+    elapsed = ticks_since(m_active_start);
+    if (elapsed >= period)
+    {
+        // No radio event seen when one was due; the radio is idle or its timing changed.
+        return true;
+    }
+    if (duration <= period - elapsed)
+    {
+        return true;
+    }
+
+    // A job longer than any idle window runs at the start of one, where it overlaps the least.
+    return window_fresh && (active_time < period) && (duration > period - active_time);
+}
+
+
+/**@brief Function for retrying the pending jobs after about one period without a radio event to
+ *        end, such as when advertising times out.
+ */
+static void retry_arm(void)
+{
+    if (!m_retry_armed &&
+        (app_timer_start(m_retry_timer_id, MAX(m_stats.period, APP_TIMER_MIN_TIMEOUT_TICKS), NULL) == NRF_SUCCESS))
+    {
+        m_retry_armed = true;
+    }
+}
+
+
+static void jobs_run(void * p_event_data, uint16_t event_size)
+{
+    bool     window_fresh = m_window_fresh;
+    uint32_t radio_events;
+    uint32_t start;
+    uint8_t  i;
+
+    UNUSED_PARAMETER(p_event_data);
+    UNUSED_PARAMETER(event_size);
+
+    m_run_posted   = false;
+    m_window_fresh = false;
+
+    for (i = 0; i < m_job_count; i++)
+    {
+        if ((m_pending & (1 << i)) == 0)
+        {
+            continue;
+        }
+
+        if (!window_fits(m_jobs[i].duration, window_fresh))
+        {
+            // Retried when the next radio event ends, or by the retry timer.
+            if (!m_jobs[i].deferred)
+            {
+                m_jobs[i].deferred = true;
+                m_stats.collisions_avoided++;
+            }
+            continue;
+        }
+
+        m_pending &= ~(1 << i);
+
+        radio_events = m_stats.radio_events;
+        (void)app_timer_cnt_get(&start);
+
+        m_jobs[i].handler();
+
+        m_jobs[i].duration = ticks_since(start);
+        m_stats.runs++;
+
+        if ((m_stats.radio_events != radio_events) || m_radio_active)
+        {
+            m_stats.overruns++;
+        }
+    }
+
+    if (m_pending != 0)
+    {
+        retry_arm();
+    }
+}
+
+
+static void run_post(void)
+{
+    if (!m_run_posted)
+    {
+        m_run_posted = true;
+        if (app_sched_event_put(NULL, 0, jobs_run) != NRF_SUCCESS)
+        {
+            // Queue full; posted again when the next radio event ends.
+            m_run_posted = false;
+            retry_arm();
+        }
+    }
+}
+
+
+static void retry_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    m_retry_armed = false;
+    if (m_pending != 0)
+    {
+        run_post();
+    }
+}
+
+
+/**@brief Function for handling radio notifications, in SWI1 interrupt context. */
+static void on_radio_notification(bool radio_active)
+{
+    uint32_t now;
+    uint32_t diff;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, m_active_start, &diff);
+
+    if (radio_active)
+    {
+        if (m_stats.radio_events > 0)
+        {
+            m_stats.period = diff;
+        }
+        m_active_start = now;
+        m_radio_active = true;
+        m_stats.radio_events++;
+    }
+    else
+    {
+        m_stats.active_time = diff;
+        m_radio_active      = false;
+        m_window_fresh      = true;
+
+        if (m_pending != 0)
+        {
+            run_post();
+        }
+    }
+}
+
+
+uint32_t radio_sched_init(nrf_radio_notification_distance_t distance)
+{
+    uint32_t err_code;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_job_count    = 0;
+    m_pending      = 0;
+    m_run_posted   = false;
+    m_radio_active = false;
+    m_retry_armed  = false;
+
+    err_code = app_timer_create(&m_retry_timer_id, APP_TIMER_MODE_SINGLE_SHOT, retry_timeout_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return ble_radio_notification_init(APP_IRQ_PRIORITY_LOW, distance, on_radio_notification);
+}
+
+
+uint32_t radio_sched_job_create(radio_sched_job_id_t * p_job_id, radio_sched_job_handler_t job_handler)
+{
+    if ((p_job_id == NULL) || (job_handler == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (m_job_count >= RADIO_SCHED_MAX_JOBS)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_jobs[m_job_count].handler  = job_handler;
+    m_jobs[m_job_count].duration = 0;
+    m_jobs[m_job_count].deferred = false;
+
+    *p_job_id = m_job_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t radio_sched_job_request(radio_sched_job_id_t job_id)
+{
+    if (job_id >= m_job_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_stats.requests++;
+
+    if ((m_pending & (1 << job_id)) == 0)
+    {
+        m_jobs[job_id].deferred = false;
+        m_pending              |= (1 << job_id);
+    }
+
+    run_post();
+
+    return NRF_SUCCESS;
+}
+
+
+void radio_sched_stats_get(radio_sched_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
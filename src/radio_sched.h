@@ -0,0 +1,67 @@
+#ifndef RADIO_SCHED_H__
+#define RADIO_SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_soc.h"
+
+#define RADIO_SCHED_MAX_JOBS    4    /**< Maximum number of jobs that can be created. */
+
+
+/**@brief Radio-aware job handler type. Called from the main context (app_scheduler). */
+typedef void (* radio_sched_job_handler_t)(void);
+
+/**@brief Radio-aware job identifier. */
+typedef uint8_t radio_sched_job_id_t;
+
+/**@brief Radio-aware scheduling statistics. Times are in RTC1 ticks. */
+typedef struct
+{
+    uint32_t requests;            /**< Job requests. */
+    uint32_t runs;                /**< Jobs run. */
+    uint32_t collisions_avoided;  /**< Requests postponed because the radio was active or the idle window was too short. */
+    uint32_t overruns;            /**< Jobs during which the radio became active anyway. */
+    uint32_t radio_events;        /**< Radio active notifications. */
+    uint32_t period;              /**< Last measured time between radio events. 0 if unknown. */
+    uint32_t active_time;         /**< Last measured duration of a radio event, including the notification distance. */
+} radio_sched_stats_t;
+
+
+/**@brief Function for initializing the radio-aware scheduler.
+ *
+ * @details Enables radio notifications (SWI1). Jobs are run from the main context in the idle
+ *          time between radio events: right after a radio event, or on request if the next radio
+ *          event is predicted far enough ahead. The prediction uses the measured time between
+ *          radio events, which is the connection interval while connected. A postponed job is
+ *          retried when the next radio event ends, or by a timer about one period later if the
+ *          radio goes quiet. app_timer and app_scheduler must be initialized, with one timer for
+ *          this module, and the BLE stack enabled.
+ *
+ * @param[in] distance  Time between the active notification and the start of the radio event.
+ *
+ * @return NRF_SUCCESS on success, otherwise an error code from app_timer or the SoftDevice.
+ */
+uint32_t radio_sched_init(nrf_radio_notification_distance_t distance);
+
+/**@brief Function for creating a job.
+ *
+ * @param[out] p_job_id     Identifier of the job.
+ * @param[in]  job_handler  Work to run while the radio is idle. Its run time is measured to decide
+ *                          whether it fits in an idle window.
+ *
+ * @retval NRF_SUCCESS      If the job was created.
+ * @retval NRF_ERROR_NULL   If job_handler is NULL.
+ * @retval NRF_ERROR_NO_MEM If RADIO_SCHED_MAX_JOBS jobs exist already.
+ */
+uint32_t radio_sched_job_create(radio_sched_job_id_t * p_job_id, radio_sched_job_handler_t job_handler);
+
+/**@brief Function for requesting a run of a job. Requests of a job already pending are merged.
+ *
+ * @details Must be called from the main context.
+ */
+uint32_t radio_sched_job_request(radio_sched_job_id_t job_id);
+
+/**@brief Function for getting the radio-aware scheduling statistics. */
+void radio_sched_stats_get(radio_sched_stats_t * p_stats);
+
+#endif /* RADIO_SCHED_H__ */
@@ -0,0 +1,86 @@
+#include <string.h>
+#include "nrf.h"
+#include "app_timer.h"
+#include "crc16.h"
+#include "retained.h"
+
+#define RETAINED_MAGIC  0x52544e44  /**< Marks the no-init RAM as written by this module ("RTND"). */
+#define RTC_MASK        0x00FFFFFF
+#define TICKS_PER_SEC   APP_TIMER_CLOCK_FREQ  /**< RTC1 rate, the application runs the app timer unprescaled. */
+
+/**@brief Resets that lose RAM content or the flow of time. Power-on reset leaves RESETREAS empty. */
+#define COLD_RESETS     (POWER_RESETREAS_OFF_Msk | POWER_RESETREAS_LPCOMP_Msk | POWER_RESETREAS_DIF_Msk)
+
+
+/**@brief Content of the no-init RAM. */
+typedef struct
+{
+    uint32_t         magic;
+    retained_state_t state;
+    uint16_t         crc;    /**< CRC-16 of state. */
+} retained_ram_t;
+
+
+static retained_ram_t m_ram __attribute__((section(".noinit")));
+
+
+/**@brief Function for updating the CRC after a change of the state. */
+static void crc_update(void)
+{
+    m_ram.crc = crc16_compute((uint8_t const *)&m_ram.state, sizeof(m_ram.state), NULL);
+}
+
+
+bool retained_init(uint32_t reset_reason)
+{
+    bool warm = (reset_reason != 0)
+             && ((reset_reason & COLD_RESETS) == 0)
+             && (m_ram.magic == RETAINED_MAGIC)
+             && (crc16_compute((uint8_t const *)&m_ram.state, sizeof(m_ram.state), NULL) == m_ram.crc);
+
+    if (!warm)
+    {
+        memset(&m_ram, 0, sizeof(m_ram));
+        m_ram.state.peer = RETAINED_PEER_NONE;
+        m_ram.magic      = RETAINED_MAGIC;
+        crc_update();
+    }
+
+    return warm;
+}
+
+
+retained_state_t const * retained_get(void)
+{
+    return &m_ram.state;
+}
+
+
+void retained_time_set(uint32_t time, uint32_t tick)
+{
+    m_ram.state.time   = time;
+    m_ram.state.tick   = tick;
+    m_ram.state.offset = 0;
+    crc_update();
+}
+
+
+void retained_handles_set(uint8_t peer, ble_pixwatch_c_handles_t const * p_handles)
+{
+    m_ram.state.peer    = peer;
+    m_ram.state.handles = *p_handles;
+    crc_update();
+}
+
+
+void retained_reset_prepare(uint32_t tick)
+{
+    m_ram.state.offset = (tick - m_ram.state.tick) & RTC_MASK;
+    crc_update();
+}
+
+
+uint32_t retained_time_restore(retained_state_t const * p_state)
+{
+    return p_state->time + (p_state->offset + TICKS_PER_SEC / 2) / TICKS_PER_SEC;
+}
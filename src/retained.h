@@ -0,0 +1,63 @@
+#ifndef RETAINED_H__
+#define RETAINED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_pixwatch_c.h"
+
+#define RETAINED_PEER_NONE  0xFF     /**< Device id of the cached handles when none are cached. */
+
+/**@brief State kept across soft resets. */
+typedef struct
+{
+    uint32_t                 time;     /**< Wall time in seconds (current_time). */
+    uint32_t                 tick;     /**< RTC1 counter when time last advanced. */
+    uint32_t                 offset;   /**< RTC1 ticks from the last advance of time to the reset, 0 if unknown. */
+    uint8_t                  peer;     /**< Device Manager device id of the peer of handles, RETAINED_PEER_NONE if none. */
+    ble_pixwatch_c_handles_t handles;  /**< PixWatch Service handles found at the peer by DB discovery. */
+} retained_state_t;
+
+
+/**@brief Function for initializing the retained state.
+ *
+ * @details The state lives in RAM that is not cleared by the startup code, and is checked with a
+ *          magic number and a CRC. It is kept if it is valid and the reset preserved RAM and the
+ *          flow of time: any reset but a power-on reset or a wake-up from System OFF. Otherwise it
+ *          is cleared. Must be called before any other function of the module.
+ *
+ * @param[in] reset_reason  NRF_POWER->RESETREAS at boot.
+ *
+ * @return true if the state of the previous run was kept (warm boot).
+ */
+bool retained_init(uint32_t reset_reason);
+
+/**@brief Function for getting the retained state. */
+retained_state_t const * retained_get(void);
+
+/**@brief Function for recording that the wall time advanced.
+ *
+ * @param[in] time  Wall time in seconds.
+ * @param[in] tick  RTC1 counter.
+ */
+void retained_time_set(uint32_t time, uint32_t tick);
+
+/**@brief Function for caching the PixWatch Service handles of a peer. Only one peer is cached. */
+void retained_handles_set(uint8_t peer, ble_pixwatch_c_handles_t const * p_handles);
+
+/**@brief Function for recording the time into the second when a reset is imminent.
+ *
+ * @details Called from fault context: does not call the SoftDevice. Resets that come without
+ *          warning, like pin resets, leave the offset at 0.
+ *
+ * @param[in] tick  RTC1 counter.
+ */
+void retained_reset_prepare(uint32_t tick);
+
+/**@brief Function for computing the wall time to restore after a warm boot.
+ *
+ * @details Adds the part of a second that had passed at the reset, rounded to the nearest second.
+ *          The time spent in the reset and the boot up to this point is not known and is ignored.
+ */
+uint32_t retained_time_restore(retained_state_t const * p_state);
+
+#endif /* RETAINED_H__ */
@@ -0,0 +1,696 @@
+#include <stddef.h>
+#include <string.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "crc16.h"
+#include "cycle_counter.h"
+#include "pstorage.h"
+#include "settings.h"
+
+#define SETTINGS_PAGE_MAGIC    0x47544553  /**< Marks an opened log page ("SETG"). */
+#define SETTINGS_RECORD_MAGIC  0xA55A      /**< Marks a record header. */
+#define SETTINGS_ERASED_WORD   0xFFFFFFFF  /**< Value of an erased flash word. */
+#define SETTINGS_KEY_INVALID   0xFFFF      /**< Key of an empty index slot. */
+#define SETTINGS_FLAG_DELETED  0x01        /**< Record deletes its key. */
+
+#define INDEX_SLOTS            (2 * SETTINGS_MAX_KEYS)  /**< Hash table size, kept at most half full. */
+#define PAGE_NONE              0xFF
+
+#define WORD_ALIGN(X)          (((X) + 3) & ~3)
+
+STATIC_ASSERT(SETTINGS_PAGE_COUNT >= 2);
+STATIC_ASSERT(IS_POWER_OF_TWO(INDEX_SLOTS));
+
+/**@brief Header at the start of each log page. */
+typedef struct
+{
+    uint32_t magic;    /**< SETTINGS_PAGE_MAGIC. */
+    uint32_t seq;      /**< Page sequence number, incremented each time a page is opened. */
+} page_hdr_t;
+
+/**@brief Header of a record. The value follows, padded to a word boundary.
+ *
+ * @details The CRC covers key, length, flags and value, so a record cut by a reset is detected
+ *          and the record can be copied by garbage collection in a single store.
+ */
+typedef struct
+{
+    uint16_t key;
+    uint8_t  length;   /**< Length of the value in bytes. */
+    uint8_t  flags;    /**< SETTINGS_FLAG_*. */
+    uint16_t crc;
+    uint16_t magic;    /**< SETTINGS_RECORD_MAGIC. */
+} record_hdr_t;
+
+#define RECORD_SIZE(LEN)       (sizeof(record_hdr_t) + WORD_ALIGN(LEN))
+
+/**@brief Page states. */
+typedef enum
+{
+    PAGE_DIRTY,        /**< Holds no indexed records, but must be erased before use. */
+    PAGE_ERASED,       /**< Erased, can be opened without erasing. */
+    PAGE_USED          /**< Opened; may hold live records. */
+} page_state_t;
+
+/**@brief RAM index entry: location of the newest record of a key. */
+typedef struct
+{
+    uint16_t key;      /**< SETTINGS_KEY_INVALID if the slot is empty. */
+    uint16_t offset;   /**< Offset of the record in its page. */
+    uint8_t  page;
+    uint8_t  length;
+    uint8_t  flags;
+} index_entry_t;
+
+
+static pstorage_handle_t m_storage;                        /**< Base handle of the log, one block per page. */
+static uint16_t          m_page_size;                      /**< Flash page size. */
+static bool              m_initialized;
+
+static uint8_t           m_page_state[SETTINGS_PAGE_COUNT];
+static bool              m_write_page_valid;               /**< Whether a page has been opened for writing. */
+static uint8_t           m_write_page;                     /**< Page currently written to. */
+static uint16_t          m_write_offset;                   /**< Next free offset in the write page. */
+static uint32_t          m_write_seq;                      /**< Sequence number of the write page. */
+
+static page_hdr_t        m_page_hdr;                       /**< Source buffer of a page header store. */
+static uint32_t          m_stage[RECORD_SIZE(SETTINGS_VALUE_MAX_LEN) / sizeof(uint32_t)]; /**< Source buffer of a record store. */
+static bool              m_busy;                           /**< A record from m_stage is being written. */
+static index_entry_t     m_pending;                        /**< Index entry of the record being written. */
+
+static uint8_t           m_gc_page = PAGE_NONE;            /**< Page being collected, PAGE_NONE if idle. */
+static bool              m_gc_erasing;                     /**< All live records are copied, the page is being erased. */
+static index_entry_t   * mp_gc_entry;                      /**< Index entry of the record being copied. */
+static uint8_t const   * mp_gc_src;                        /**< Flash address of the record being copied. */
+static uint16_t          m_gc_dst_offset;                  /**< Offset of the copy in the write page. */
+
+static index_entry_t     m_index[INDEX_SLOTS];
+static uint8_t           m_key_count;                      /**< Keys in m_index. A deleted key leaves it. */
+
+static settings_stats_t  m_stats;
+
+
+static uint8_t const * page_address(uint8_t page)
+{
+    return (uint8_t const *)(m_storage.block_id + (uint32_t)page * m_page_size);
+}
+
+
+static uint16_t record_crc(record_hdr_t const * p_hdr, uint8_t const * p_value)
+{
+    uint16_t crc = crc16_compute((uint8_t const *)p_hdr, offsetof(record_hdr_t, crc), NULL);
+
+    return crc16_compute(p_value, p_hdr->length, &crc);
+}
+
+
+/**@brief Function for getting the slot a key is probed from. */
+static uint32_t index_home(uint16_t key)
+{
+    return ((uint32_t)key * 40503) & (INDEX_SLOTS - 1);
+}
+
+
+/**@brief Function for finding the index slot of a key.
+ *
+ * @return Slot holding the key, else the empty slot where it would go.
+ */
+static index_entry_t * index_slot(uint16_t key)
+{
+    uint32_t i = index_home(key);
+
+    // The table is at most half full, so an empty slot ends every probe sequence.
+    while ((m_index[i].key != key) && (m_index[i].key != SETTINGS_KEY_INVALID))
+    {
+        i = (i + 1) & (INDEX_SLOTS - 1);
+    }
+
+    return &m_index[i];
+}
+
+
+/**@brief Function for emptying the slot of a key.
+ *
+ * @details The keys probed past the slot are moved back into it in turn, so that every probe
+ *          sequence still ends at an empty slot without leaving tombstones behind.
+ */
+static void index_remove(index_entry_t * p_slot)
+{
+    uint32_t hole = p_slot - m_index;
+    uint32_t i    = hole;
+    uint32_t home;
+
+    for (;;)
+    {
+        i = (i + 1) & (INDEX_SLOTS - 1);
+        if (m_index[i].key == SETTINGS_KEY_INVALID)
+        {
+            break;
+        }
+
+        // The key can fill the hole unless its probe sequence starts after the hole.
+        home = index_home(m_index[i].key);
+        if (((i - home) & (INDEX_SLOTS - 1)) >= ((i - hole) & (INDEX_SLOTS - 1)))
+        {
+            m_index[hole] = m_index[i];
+            hole          = i;
+        }
+    }
+
+    memset(&m_index[hole], 0xFF, sizeof(m_index[hole]));
+    m_key_count--;
+}
+
+
+/**@brief Function for recording the location of the newest record of a key.
+ *
+ * @details A deleting record removes the key from the index: its older records are all in the
+ *          pages before, which garbage collection erases first, and nothing is left to copy
+ *          forward or to read.
+ *
+ * @return false if the key is new and the index is full.
+ */
+static bool index_put(index_entry_t const * p_entry)
+{
+    index_entry_t * p_slot = index_slot(p_entry->key);
+
+    if (p_entry->flags & SETTINGS_FLAG_DELETED)
+    {
+        if (p_slot->key != SETTINGS_KEY_INVALID)
+        {
+            index_remove(p_slot);
+        }
+        return true;
+    }
+
+    if (p_slot->key == SETTINGS_KEY_INVALID)
+    {
+        if (m_key_count == SETTINGS_MAX_KEYS)
+        {
+            return false;
+        }
+        m_key_count++;
+    }
+
+    *p_slot = *p_entry;
+    return true;
+}
+
+
+/**@brief Function for scanning a log page and indexing its valid records.
+ *
+ * @return Offset of the first free word of the page, or the page size if the page cannot take
+ *         more records.
+ */
+static uint16_t page_scan(uint8_t page)
+{
+    uint8_t const * p_page = page_address(page);
+    uint32_t        offset = sizeof(page_hdr_t);
+
+    while (offset + sizeof(record_hdr_t) <= m_page_size)
+    {
+        record_hdr_t const * p_hdr = (record_hdr_t const *)(p_page + offset);
+        index_entry_t        entry;
+
+        if (*(uint32_t const *)p_hdr == SETTINGS_ERASED_WORD)
+        {
+            return offset;
+        }
+
+        if ((p_hdr->length > SETTINGS_VALUE_MAX_LEN) ||
+            (offset + RECORD_SIZE(p_hdr->length) > m_page_size))
+        {
+            // First word of a record cut while it was programmed; the words after it were not
+            // written. Skipping only this word keeps the rest of the page in use, where the
+            // records of the next boot follow it. Closing the page instead could leave garbage
+            // collection no room to copy the live records of the other page into.
+            m_stats.torn++;
+            offset += sizeof(uint32_t);
+            continue;
+        }
+
+        if ((p_hdr->magic != SETTINGS_RECORD_MAGIC) ||
+            (p_hdr->key == SETTINGS_KEY_INVALID) ||
+            (record_crc(p_hdr, (uint8_t const *)(p_hdr + 1)) != p_hdr->crc))
+        {
+            // Write cut by a reset. Words are written in order, so the length in the first word
+            // is intact and the record can be skipped.
+            m_stats.torn++;
+            offset += RECORD_SIZE(p_hdr->length);
+            continue;
+        }
+
+        entry.key    = p_hdr->key;
+        entry.offset = offset;
+        entry.page   = page;
+        entry.length = p_hdr->length;
+        entry.flags  = p_hdr->flags;
+
+        if (index_put(&entry))
+        {
+            m_stats.recovered++;
+        }
+
+        offset += RECORD_SIZE(p_hdr->length);
+    }
+
+    return offset;
+}
+
+
+static bool page_is_blank(uint8_t page)
+{
+    uint32_t const * p_word = (uint32_t const *)page_address(page);
+    uint32_t         i;
+
+    for (i = 0; i < m_page_size / sizeof(uint32_t); i++)
+    {
+        if (p_word[i] != SETTINGS_ERASED_WORD)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**@brief Function for rebuilding the index from the log pages, oldest page first. Each page is
+ *        read once.
+ */
+static void index_rebuild(void)
+{
+    bool     scanned[SETTINGS_PAGE_COUNT] = {false};
+    uint32_t i;
+
+    for (i = 0; i < SETTINGS_PAGE_COUNT; i++)
+    {
+        page_hdr_t const * p_hdr = (page_hdr_t const *)page_address(i);
+
+        if (p_hdr->magic == SETTINGS_PAGE_MAGIC)
+        {
+            m_page_state[i] = PAGE_USED;
+        }
+        else
+        {
+            m_page_state[i] = page_is_blank(i) ? PAGE_ERASED : PAGE_DIRTY;
+            scanned[i]      = true;
+        }
+    }
+
+    for (;;)
+    {
+        page_hdr_t const * p_oldest = NULL;
+        uint8_t            oldest   = 0;
+
+        for (i = 0; i < SETTINGS_PAGE_COUNT; i++)
+        {
+            page_hdr_t const * p_hdr = (page_hdr_t const *)page_address(i);
+
+            if (!scanned[i] && ((p_oldest == NULL) || ((int32_t)(p_hdr->seq - p_oldest->seq) < 0)))
+            {
+                p_oldest = p_hdr;
+                oldest   = i;
+            }
+        }
+
+        if (p_oldest == NULL)
+        {
+            break;
+        }
+
+        scanned[oldest]    = true;
+        m_write_page_valid = true;
+        m_write_page       = oldest;
+        m_write_seq        = p_oldest->seq;
+        m_write_offset     = page_scan(oldest);
+    }
+}
+
+
+/**@brief Function for opening the page after the write page. The page must hold no live records. */
+static uint32_t page_open(void)
+{
+    uint32_t          err_code;
+    uint8_t           page = m_write_page_valid ? (m_write_page + 1) % SETTINGS_PAGE_COUNT : 0;
+    pstorage_handle_t handle;
+
+    err_code = pstorage_block_identifier_get(&m_storage, page, &handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if (m_page_state[page] != PAGE_ERASED)
+    {
+        err_code = pstorage_clear(&handle, m_page_size);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        m_stats.page_erases++;
+    }
+
+    m_page_hdr.magic = SETTINGS_PAGE_MAGIC;
+    m_page_hdr.seq   = m_write_seq + 1;
+
+    err_code = pstorage_store(&handle, (uint8_t *)&m_page_hdr, sizeof(m_page_hdr), 0);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_page_state[page] = PAGE_USED;
+    m_write_page_valid = true;
+    m_write_page       = page;
+    m_write_seq        = m_page_hdr.seq;
+    m_write_offset     = sizeof(page_hdr_t);
+
+    return NRF_SUCCESS;
+}
+
+
+static void gc_abort(void)
+{
+    m_stats.failed++;
+    m_gc_page    = PAGE_NONE;
+    m_gc_erasing = false;
+}
+
+
+/**@brief Function for copying the next live record of the page being collected, or erasing the
+ *        page once none is left. Called again from the pstorage callback.
+ */
+static void gc_step(void)
+{
+    uint32_t          err_code;
+    pstorage_handle_t handle;
+    uint32_t          size;
+    uint32_t          i;
+
+    for (i = 0; i < INDEX_SLOTS; i++)
+    {
+        index_entry_t * p_entry = &m_index[i];
+
+        if ((p_entry->key == SETTINGS_KEY_INVALID) || (p_entry->page != m_gc_page))
+        {
+            continue;
+        }
+
+        size = RECORD_SIZE(p_entry->length);
+        if (m_write_offset + size > m_page_size)
+        {
+            // Live records always fit in a freshly opened page; the log is corrupt.
+            gc_abort();
+            return;
+        }
+
+        err_code = pstorage_block_identifier_get(&m_storage, m_write_page, &handle);
+        if (err_code == NRF_SUCCESS)
+        {
+            mp_gc_entry     = p_entry;
+            mp_gc_src       = page_address(m_gc_page) + p_entry->offset;
+            m_gc_dst_offset = m_write_offset;
+
+            err_code = pstorage_store(&handle, (uint8_t *)mp_gc_src, size, m_write_offset);
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            gc_abort();
+            return;
+        }
+
+        m_write_offset += size;
+        return;
+    }
+
+    err_code = pstorage_block_identifier_get(&m_storage, m_gc_page, &handle);
+    if (err_code == NRF_SUCCESS)
+    {
+        err_code = pstorage_clear(&handle, m_page_size);
+    }
+    if (err_code != NRF_SUCCESS)
+    {
+        gc_abort();
+        return;
+    }
+
+    m_gc_erasing = true;
+    m_stats.page_erases++;
+}
+
+
+/**@brief Function for starting garbage collection of the page after the write page, if it is in
+ *        use. Keeps a page free for the next page switch.
+ */
+static void gc_start_if_needed(void)
+{
+    uint8_t next;
+
+    if (!m_write_page_valid || m_busy || (m_gc_page != PAGE_NONE))
+    {
+        return;
+    }
+
+    next = (m_write_page + 1) % SETTINGS_PAGE_COUNT;
+    if (m_page_state[next] != PAGE_USED)
+    {
+        return;
+    }
+
+    m_gc_page = next;
+    m_stats.gc_runs++;
+    gc_step();
+}
+
+
+static void pstorage_cb_handler(pstorage_handle_t * p_handle,
+                                uint8_t             op_code,
+                                uint32_t            result,
+                                uint8_t           * p_data,
+                                uint32_t            data_len)
+{
+    if ((result == NRF_SUCCESS) && (op_code == PSTORAGE_STORE_OP_CODE))
+    {
+        m_stats.flash_bytes += data_len;
+    }
+
+    if ((op_code == PSTORAGE_STORE_OP_CODE) && (p_data == (uint8_t *)m_stage))
+    {
+        if (result == NRF_SUCCESS)
+        {
+            // Cannot fail: settings_write() checked the index has room for the key.
+            (void)index_put(&m_pending);
+            m_stats.sets++;
+        }
+        else
+        {
+            m_stats.failed++;
+        }
+        m_busy = false;
+        gc_start_if_needed();
+    }
+    else if ((op_code == PSTORAGE_STORE_OP_CODE) && (m_gc_page != PAGE_NONE) && (p_data == mp_gc_src))
+    {
+        if (result != NRF_SUCCESS)
+        {
+            gc_abort();
+            return;
+        }
+
+        mp_gc_entry->page   = m_write_page;
+        mp_gc_entry->offset = m_gc_dst_offset;
+        m_stats.gc_copies++;
+        gc_step();
+    }
+    else if ((op_code == PSTORAGE_CLEAR_OP_CODE) && m_gc_erasing)
+    {
+        if (result != NRF_SUCCESS)
+        {
+            gc_abort();
+            return;
+        }
+
+        m_page_state[m_gc_page] = PAGE_ERASED;
+        m_gc_page               = PAGE_NONE;
+        m_gc_erasing            = false;
+    }
+    else if (result != NRF_SUCCESS)
+    {
+        // Page erase or header store of page_open().
+        m_stats.failed++;
+    }
+}
+
+
+uint32_t settings_init(void)
+{
+    uint32_t                err_code;
+    uint32_t                start;
+    pstorage_module_param_t param;
+
+    m_page_size = PSTORAGE_FLASH_PAGE_SIZE;
+
+    param.block_size  = m_page_size;
+    param.block_count = SETTINGS_PAGE_COUNT;
+    param.cb          = pstorage_cb_handler;
+
+    err_code = pstorage_register(&param, &m_storage);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    memset(m_index, 0xFF, sizeof(m_index));
+    m_key_count = 0;
+
+    cycle_counter_enable();
+    start = DWT->CYCCNT;
+    index_rebuild();
+    m_stats.rebuild_cycles = DWT->CYCCNT - start;
+
+    m_initialized = true;
+
+    // A reset during garbage collection leaves the page after the write page in use.
+    gc_start_if_needed();
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for appending a record to the log. */
+static uint32_t settings_write(uint16_t key, uint8_t flags, void const * p_value, uint8_t length)
+{
+    uint32_t          err_code;
+    uint16_t          record_size = RECORD_SIZE(length);
+    record_hdr_t    * p_hdr       = (record_hdr_t *)m_stage;
+    index_entry_t   * p_slot;
+    pstorage_handle_t handle;
+
+    if (!m_initialized)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (key == SETTINGS_KEY_INVALID)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (length > SETTINGS_VALUE_MAX_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    // A delete takes no slot.
+    p_slot = index_slot(key);
+    if (!(flags & SETTINGS_FLAG_DELETED) &&
+        (p_slot->key == SETTINGS_KEY_INVALID) && (m_key_count == SETTINGS_MAX_KEYS))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    if (m_busy || (m_gc_page != PAGE_NONE))
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    if (!m_write_page_valid || (m_write_offset + record_size > m_page_size))
+    {
+        if (m_write_page_valid &&
+            (m_page_state[(m_write_page + 1) % SETTINGS_PAGE_COUNT] == PAGE_USED))
+        {
+            // A previous garbage collection failed; retry it.
+            gc_start_if_needed();
+            return NRF_ERROR_BUSY;
+        }
+
+        err_code = page_open();
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+    }
+
+    memset(m_stage, 0xFF, record_size);
+    p_hdr->key    = key;
+    p_hdr->length = length;
+    p_hdr->flags  = flags;
+    p_hdr->magic  = SETTINGS_RECORD_MAGIC;
+    if (length > 0)
+    {
+        memcpy(p_hdr + 1, p_value, length);
+    }
+    p_hdr->crc    = record_crc(p_hdr, (uint8_t const *)(p_hdr + 1));
+
+    err_code = pstorage_block_identifier_get(&m_storage, m_write_page, &handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_pending.key    = key;
+    m_pending.offset = m_write_offset;
+    m_pending.page   = m_write_page;
+    m_pending.length = length;
+    m_pending.flags  = flags;
+
+    m_busy = true;
+
+    err_code = pstorage_store(&handle, (uint8_t *)m_stage, record_size, m_write_offset);
+    if (err_code != NRF_SUCCESS)
+    {
+        m_busy = false;
+        return err_code;
+    }
+
+    m_write_offset += record_size;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t settings_get(uint16_t key, void * p_value, uint8_t * p_length)
+{
+    index_entry_t const * p_slot = index_slot(key);
+
+    if (p_slot->key == SETTINGS_KEY_INVALID)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    if (*p_length < p_slot->length)
+    {
+        *p_length = p_slot->length;
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    *p_length = p_slot->length;
+    memcpy(p_value, page_address(p_slot->page) + p_slot->offset + sizeof(record_hdr_t), p_slot->length);
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t settings_set(uint16_t key, void const * p_value, uint8_t length)
+{
+    return settings_write(key, 0, p_value, length);
+}
+
+
+uint32_t settings_delete(uint16_t key)
+{
+    return settings_write(key, SETTINGS_FLAG_DELETED, NULL, 0);
+}
+
+
+bool settings_busy(void)
+{
+    return m_busy || (m_gc_page != PAGE_NONE);
+}
+
+
+void settings_stats_get(settings_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
@@ -0,0 +1,89 @@
+#ifndef SETTINGS_H__
+#define SETTINGS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SETTINGS_PAGE_COUNT       2      /**< Number of flash pages used as the record log. Must be at least 2. */
+#define SETTINGS_MAX_KEYS         32     /**< Number of distinct keys the RAM index holds. */
+#define SETTINGS_VALUE_MAX_LEN    32     /**< Maximum length of a value in bytes. */
+
+/**@brief Setting keys. Keys are stored in flash, so existing values must not be renumbered. */
+enum
+{
+    SETTINGS_KEY_UTC_OFFSET  = 1,        /**< int32, local time offset from UTC in seconds. */
+    SETTINGS_KEY_BRIGHTNESS  = 2,        /**< uint8, display brightness. */
+    SETTINGS_KEY_WATCH_FACE  = 3,        /**< uint8, selected watch face. */
+    SETTINGS_KEY_ALARMS      = 4,        /**< Alarm table, as ble_pixwatch_c_alarm_t[PIXWATCH_ALARM_COUNT]. */
+    SETTINGS_KEY_USER        = 0x8000    /**< First key free for ad-hoc use, e.g. from the console. */
+};
+
+/**@brief Settings store statistics. */
+typedef struct
+{
+    uint32_t sets;             /**< Records committed by settings_set() and settings_delete(). */
+    uint32_t failed;           /**< Flash operations that failed. */
+    uint32_t flash_bytes;      /**< Bytes written to flash, including garbage collection copies. */
+    uint32_t page_erases;      /**< Pages erased. */
+    uint32_t gc_runs;          /**< Pages garbage collected. */
+    uint32_t gc_copies;        /**< Live records copied by garbage collection. */
+    uint32_t recovered;        /**< Valid records found when the index was rebuilt at boot. */
+    uint32_t torn;             /**< Damaged records that ended a page scan at boot. */
+    uint32_t rebuild_cycles;   /**< CPU cycles the boot time index rebuild took. */
+} settings_stats_t;
+
+
+/**@brief Function for initializing the settings store.
+ *
+ * @details Registers the record log with pstorage and rebuilds the RAM index. Each key's newest
+ *          record wins; records are checked with a CRC, so a write cut by a reset is ignored and
+ *          the previous value stays. The rebuild reads at most SETTINGS_PAGE_COUNT pages once,
+ *          its duration is reported in settings_stats_t.rebuild_cycles. pstorage_init() must have
+ *          been called.
+ *
+ * @retval NRF_SUCCESS If the store was initialized. Otherwise an error code from pstorage.
+ */
+uint32_t settings_init(void);
+
+/**@brief Function for reading a setting.
+ *
+ * @param[in]     key       Key of the setting.
+ * @param[out]    p_value   Buffer for the value.
+ * @param[in,out] p_length  Size of the buffer in, length of the value out.
+ *
+ * @retval NRF_SUCCESS          If the value was read.
+ * @retval NRF_ERROR_NOT_FOUND  If the key has no value.
+ * @retval NRF_ERROR_DATA_SIZE  If the buffer is too small. p_length is set to the value length.
+ */
+uint32_t settings_get(uint16_t key, void * p_value, uint8_t * p_length);
+
+/**@brief Function for writing a setting.
+ *
+ * @details The value is copied and appended to the log as one record. settings_get() returns the
+ *          previous value until the record is in flash. When the write page is full, the next page
+ *          is opened and the oldest page garbage collected in the background: its live records are
+ *          copied forward one by one, then it is erased. Pages are used in turn, so wear spreads
+ *          evenly.
+ *
+ * @retval NRF_SUCCESS             If the write was queued.
+ * @retval NRF_ERROR_INVALID_STATE If the store is not initialized.
+ * @retval NRF_ERROR_INVALID_PARAM If the key is 0xFFFF.
+ * @retval NRF_ERROR_DATA_SIZE     If length exceeds SETTINGS_VALUE_MAX_LEN.
+ * @retval NRF_ERROR_NO_MEM        If the key is new and the index is full. A deleted key leaves the
+ *                                 index once its deleting record is in flash.
+ * @retval NRF_ERROR_BUSY          If a write or a garbage collection is in progress.
+ */
+uint32_t settings_set(uint16_t key, void const * p_value, uint8_t length);
+
+/**@brief Function for deleting a setting. Same return values as settings_set(); deleting a key
+ *        without a value is not an error.
+ */
+uint32_t settings_delete(uint16_t key);
+
+/**@brief Function for checking whether a write or a garbage collection is in progress. */
+bool settings_busy(void);
+
+/**@brief Function for getting the settings store statistics. */
+void settings_stats_get(settings_stats_t * p_stats);
+
+#endif /* SETTINGS_H__ */
@@ -0,0 +1,30 @@
+#include "app_util.h"
+#include "telemetry.h"
+
+#define RESETREAS_LOW_MASK    0x0000000F  /**< RESETPIN, DOG, SREQ, LOCKUP. */
+#define RESETREAS_HIGH_MASK   0x000F0000  /**< OFF, LPCOMP, DIF, NFC. */
+#define RESETREAS_HIGH_SHIFT  12
+
+
+static uint16_t saturate16(uint32_t value)
+{
+    return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
+}
+
+
+uint16_t telemetry_encode(telemetry_record_t const * p_record, uint8_t * p_buf)
+{
+    p_buf[0] = TELEMETRY_VERSION;
+    p_buf[1] = TELEMETRY_RECORD_LEN;
+    p_buf[2] = (uint8_t)((p_record->reset_reason & RESETREAS_LOW_MASK) |
+                         ((p_record->reset_reason & RESETREAS_HIGH_MASK) >> RESETREAS_HIGH_SHIFT));
+    p_buf[3] = (p_record->sched_queue_hwm > UINT8_MAX) ? UINT8_MAX : (uint8_t)p_record->sched_queue_hwm;
+
+    (void)uint32_encode(p_record->uptime, &p_buf[4]);
+    (void)uint16_encode(saturate16(p_record->wakeups_per_hour), &p_buf[8]);
+    (void)uint16_encode(saturate16(p_record->spi_bytes_per_frame), &p_buf[10]);
+    (void)uint32_encode(p_record->ble_events, &p_buf[12]);
+    (void)uint32_encode(p_record->flash_ops, &p_buf[16]);
+
+    return TELEMETRY_RECORD_LEN;
+}
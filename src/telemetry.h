@@ -0,0 +1,46 @@
+#ifndef TELEMETRY_H__
+#define TELEMETRY_H__
+
+#include <stdint.h>
+
+#define TELEMETRY_VERSION       1     /**< Version of the record layout. Fields are only ever appended. */
+#define TELEMETRY_RECORD_LEN    20    /**< Encoded length of a version 1 record; fits in one notification. */
+
+/* Encoded record, little endian:
+ *
+ *   offset  size  field
+ *   0       1     version
+ *   1       1     record length, so older decoders can skip fields appended by later versions
+ *   2       1     reset reason: RESETREAS bits 0-3 (pin, watchdog, soft reset, lockup) in bits 0-3,
+ *                 bits 16-19 (wake from System OFF by GPIO, LPCOMP, debug interface, NFC) in bits 4-7
+ *   3       1     scheduler queue high-water mark
+ *   4       4     uptime, in seconds
+ *   8       2     CPU wakeups in the last hour, saturated
+ *   10      2     SPI bytes of the last display frame, saturated
+ *   12      4     BLE events dispatched
+ *   16      4     flash operations
+ */
+
+/**@brief Telemetry record, before encoding. */
+typedef struct
+{
+    uint32_t reset_reason;         /**< NRF_POWER->RESETREAS at boot. */
+    uint16_t sched_queue_hwm;      /**< Most events seen in the scheduler queue at once. */
+    uint32_t uptime;               /**< Seconds since reset. */
+    uint32_t wakeups_per_hour;     /**< Main loop wakeups in the last hour. */
+    uint32_t spi_bytes_per_frame;  /**< Bytes sent to the display for the last frame. */
+    uint32_t ble_events;           /**< BLE events dispatched since reset. */
+    uint32_t flash_ops;            /**< Flash store and erase operations since reset. */
+} telemetry_record_t;
+
+
+/**@brief Function for encoding a telemetry record.
+ *
+ * @param[in]  p_record  Record to encode.
+ * @param[out] p_buf     Buffer of at least TELEMETRY_RECORD_LEN bytes.
+ *
+ * @return Number of bytes encoded.
+ */
+uint16_t telemetry_encode(telemetry_record_t const * p_record, uint8_t * p_buf);
+
+#endif /* TELEMETRY_H__ */
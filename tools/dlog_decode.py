@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Decode the binary log written by src/dlog.c.
+
+Frames are read from a file or stdin (for example a serial port dump) and the
+format strings are looked up by address in the ELF file of the firmware:
+
+    dlog_decode.py _build/nrf52832_xxaa_s132.out < /dev/ttyACM0
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+HEADER_LEN = 10
+MAX_ARGS = 4
+RTC_HZ = 32768
+LEVELS = "-EWID"
+
+SHT_PROGBITS = 1
+SHF_ALLOC = 0x2
+
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf:
+    """Loadable sections of a 32-bit little-endian ELF file."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            raise ValueError("%s: not a 32-bit little-endian ELF file" % path)
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, flags, addr, offset, size) = struct.unpack_from(
+                "<IIIIII", data, shoff + i * shentsize)
+            if sh_type == SHT_PROGBITS and (flags & SHF_ALLOC) and size:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, address):
+        for base, content in self.sections:
+            if base <= address < base + len(content):
+                end = content.find(b"\0", address - base)
+                if end < 0:
+                    end = len(content)
+                return content[address - base:end].decode("utf-8", "replace")
+        return None
+
+
+def format_message(elf, fmt, args):
+    out = []
+    pos = 0
+    args = list(args)
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        value = args.pop(0) if args else 0
+        spec = "%" + flags + width + ("." + prec if prec else "")
+        if conv in "di":
+            out.append((spec + "d") % (value - (1 << 32) if value & 0x80000000 else value))
+        elif conv == "u":
+            out.append((spec + "d") % value)
+        elif conv == "c":
+            out.append((spec + "c") % chr(value & 0xFF))
+        elif conv == "s":
+            text = elf.string(value)
+            out.append((spec + "s") % (text if text is not None else "<0x%08x>" % value))
+        elif conv == "p":
+            out.append("0x%08x" % value)
+        else:
+            out.append((spec + conv) % value)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def frames(stream):
+    """Yield (seq, rtc, level, fmt_address, args), resynchronizing on DLOG_SYNC."""
+    buf = bytearray()
+    while True:
+        chunk = stream.read1(256) if hasattr(stream, "read1") else stream.read(256)
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            start = buf.find(bytes([SYNC]))
+            if start < 0:
+                buf.clear()
+                break
+            del buf[:start]
+            if len(buf) < 2:
+                break
+            nargs = buf[1] & 0x0F
+            level = (buf[1] >> 4) & 0x07
+            if nargs > MAX_ARGS or level >= len(LEVELS):
+                del buf[:1]
+                continue
+            length = HEADER_LEN + 4 * nargs
+            if len(buf) < length:
+                break
+            seq = buf[2]
+            rtc = buf[3] | (buf[4] << 8) | (buf[5] << 16)
+            address, = struct.unpack_from("<I", buf, 6)
+            args = struct.unpack_from("<%dI" % nargs, buf, HEADER_LEN)
+            del buf[:length]
+            yield seq, rtc, level, address, args
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF file the log was written by")
+    parser.add_argument("input", nargs="?", help="binary log (default: stdin)")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    stream = open(args.input, "rb") if args.input else sys.stdin.buffer
+    expected = None
+
+    for seq, rtc, level, address, values in frames(stream):
+        if expected is not None and seq != expected:
+            print("-- %d frame(s) dropped" % ((seq - expected) & 0xFF))
+        expected = (seq + 1) & 0xFF
+
+        fmt = elf.string(address)
+        if fmt is None:
+            # A misaligned sync byte, or a log from another build.
+            print("-- unknown format string at 0x%08x" % address)
+            continue
+        message = format_message(elf, fmt, values).rstrip("\r\n")
+        print("%10.5f %s %s" % (rtc / RTC_HZ, LEVELS[level], message))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Compress a file for a compressed asset transfer (ASSET_FLAG_COMPRESSED).
+
+The output is the bit stream decoded by src/lz_decoder.c: heatshrink with an
+8-bit window and a 4-bit lookahead. Use -d to decompress a stream again.
+"""
+
+import argparse
+import sys
+
+WINDOW_BITS = 8
+LOOKAHEAD_BITS = 4
+WINDOW_SIZE = 1 << WINDOW_BITS
+MAX_MATCH = 1 << LOOKAHEAD_BITS
+MIN_MATCH = 2  # A back-reference takes 13 bits, two literals 18.
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.nbits = 0
+
+    def put(self, value, count):
+        for i in range(count - 1, -1, -1):
+            self.acc = (self.acc << 1) | ((value >> i) & 1)
+            self.nbits += 1
+            if self.nbits == 8:
+                self.out.append(self.acc)
+                self.acc = 0
+                self.nbits = 0
+
+    def flush(self):
+        # Zero padding is an incomplete back-reference, which the decoder ignores.
+        if self.nbits:
+            self.out.append(self.acc << (8 - self.nbits))
+            self.acc = 0
+            self.nbits = 0
+        return bytes(self.out)
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def get(self, count):
+        if self.pos + count > len(self.data) * 8:
+            return None
+        value = 0
+        for _ in range(count):
+            byte = self.data[self.pos >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+
+def longest_match(data, pos):
+    best_len, best_off = 0, 0
+    limit = min(MAX_MATCH, len(data) - pos)
+    for start in range(max(0, pos - WINDOW_SIZE), pos):
+        length = 0
+        while length < limit and data[start + length] == data[pos + length]:
+            length += 1
+        if length >= best_len:
+            best_len, best_off = length, pos - start
+            if length == limit:
+                break
+    return best_len, best_off
+
+
+def compress(data):
+    bits = BitWriter()
+    pos = 0
+    while pos < len(data):
+        length, offset = longest_match(data, pos)
+        if length >= MIN_MATCH:
+            bits.put(0, 1)
+            bits.put(offset - 1, WINDOW_BITS)
+            bits.put(length - 1, LOOKAHEAD_BITS)
+            pos += length
+        else:
+            bits.put(1, 1)
+            bits.put(data[pos], 8)
+            pos += 1
+    return bits.flush()
+
+
+def decompress(data):
+    bits = BitReader(data)
+    out = bytearray()
+    while True:
+        tag = bits.get(1)
+        if tag is None:
+            break
+        if tag:
+            literal = bits.get(8)
+            if literal is None:
+                break
+            out.append(literal)
+        else:
+            index = bits.get(WINDOW_BITS)
+            count = bits.get(LOOKAHEAD_BITS)
+            if index is None or count is None:
+                break
+            for _ in range(count + 1):
+                # Like the decoder, history before the start of the stream reads as zeros.
+                src = len(out) - (index + 1)
+                out.append(out[src] if src >= 0 else 0)
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', type=argparse.FileType('rb'))
+    parser.add_argument('output', type=argparse.FileType('wb'))
+    parser.add_argument('-d', '--decompress', action='store_true', help='decompress instead')
+    args = parser.parse_args()
+
+    data = args.input.read()
+    if args.decompress:
+        args.output.write(decompress(data))
+        return
+
+    packed = compress(data)
+    if decompress(packed) != data:
+        sys.exit('internal error: round trip failed')
+    args.output.write(packed)
+    ratio = 100.0 * len(packed) / len(data) if data else 0.0
+    print('%d -> %d bytes (%.1f%%); announce length %d in BEGIN'
+          % (len(data), len(packed), ratio, len(data)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Decode telemetry records read from the Telemetry Service (src/telemetry.h).
+
+Records are given as hex strings, one per argument or one per line on stdin,
+as copied from a BLE client app (spaces, dashes and colons are ignored).
+Fields appended by later record versions are reported as extra bytes.
+With --crash, the records are crash reports (src/crash_log.h); file names and
+code addresses can be looked up in the ELF file of the firmware that crashed.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+# version 1 layout after the 2-byte header: (name, struct format)
+FIELDS_V1 = [
+    ("reset_reason", "B"),
+    ("sched_queue_hwm", "B"),
+    ("uptime", "I"),
+    ("wakeups_per_hour", "H"),
+    ("spi_bytes_per_frame", "H"),
+    ("ble_events", "I"),
+    ("flash_ops", "I"),
+]
+
+CRASH_HEADER = "<BBIIIIIIHH"
+CRASH_FIELDS = ["version", "fault", "error_code", "line", "file", "pc", "lr",
+                "uptime", "sched_queue_free", "sched_queue_hwm"]
+FAULTS = ["none", "app error", "hard fault"]
+EVENTS = ["boot", "ble", "button", "adv"]
+RTC_HZ = 32768
+
+RESET_REASONS = ["pin", "watchdog", "soft reset", "lockup",
+                 "gpio wake", "lpcomp wake", "debug interface", "nfc wake"]
+
+
+def decode(record):
+    if len(record) < 2:
+        raise ValueError("record too short")
+    version, length = record[0], record[1]
+    if version < 1:
+        raise ValueError("unknown version %d" % version)
+    if len(record) < length:
+        raise ValueError("record truncated: %d of %d bytes" % (len(record), length))
+
+    fmt = "<" + "".join(f for _, f in FIELDS_V1)
+    known = struct.calcsize(fmt)
+    if length < 2 + known:
+        raise ValueError("record length %d below version 1 layout" % length)
+
+    values = struct.unpack_from(fmt, record, 2)
+    out = {"version": version}
+    out.update({name: value for (name, _), value in zip(FIELDS_V1, values)})
+    out["reset_reason"] = [r for i, r in enumerate(RESET_REASONS) if out["reset_reason"] & (1 << i)]
+    extra = record[2 + known:length]
+    if extra:
+        out["extra"] = extra.hex()
+    return out
+
+
+def decode_crash(record):
+    known = struct.calcsize(CRASH_HEADER)
+    if len(record) < known + 4:
+        raise ValueError("crash report too short")
+    values = struct.unpack_from(CRASH_HEADER, record)
+    out = dict(zip(CRASH_FIELDS, values))
+    if out["version"] < 1:
+        raise ValueError("unknown version %d" % out["version"])
+    out["fault"] = FAULTS[out["fault"]] if out["fault"] < len(FAULTS) else out["fault"]
+    for name in ("error_code", "file", "pc", "lr"):
+        out[name] = "0x%08x" % out[name]
+    if out["fault"] == "hard fault":
+        out["cfsr"] = out.pop("error_code")
+        out["hfsr"] = out.pop("file")
+        del out["line"]
+    out["rtc"] = int.from_bytes(record[known:known + 3], "little") / RTC_HZ
+    count = record[known + 3]
+    events = []
+    for i in range(count):
+        time_id, arg = struct.unpack_from("<II", record, known + 4 + 8 * i)
+        event = time_id >> 24
+        events.append("%.5f %s 0x%x" % ((time_id & 0xFFFFFF) / RTC_HZ,
+                                        EVENTS[event] if event < len(EVENTS) else event, arg))
+    out["trace"] = events
+    return out
+
+
+def parse_hex(text):
+    return bytes.fromhex("".join(c for c in text if c not in " -:\t\r\n"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("records", nargs="*", help="hex encoded records (default: stdin)")
+    parser.add_argument("--json", action="store_true", help="print one JSON object per record")
+    parser.add_argument("--crash", action="store_true", help="decode crash reports instead of records")
+    args = parser.parse_args()
+
+    lines = args.records or [line for line in sys.stdin if line.strip()]
+    for line in lines:
+        fields = (decode_crash if args.crash else decode)(parse_hex(line))
+        if args.json:
+            print(json.dumps(fields))
+        else:
+            print(", ".join("%s=%s" % item for item in fields.items()))
+
+
+if __name__ == "__main__":
+    main()